@@ -57,6 +57,225 @@
 #  define MOD63(a) a %= BASE
 #endif
 
+/*
+  If available, use vector instructions to compute the sums 32 or 64 bytes at
+  a time: SSSE3 or AVX2 on x86-64, selected at run time, or NEON on aarch64.
+  Define NO_ADLER_SIMD to not use them.
+ */
+#ifndef NO_ADLER_SIMD
+#  if defined(__x86_64__) && (defined(__clang__) || \
+      (defined(__GNUC__) && (__GNUC__ > 4 || \
+                             (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#    define ADLER_SSSE3
+#  elif defined(__aarch64__) && defined(__ARM_NEON)
+#    define ADLER_NEON
+#  endif
+#endif
+
+#if defined(ADLER_SSSE3) || defined(ADLER_NEON)
+#  define ADLER_SIMD
+#  define SIMD_MIN 64   /* fewest bytes worth the vector code, which must be
+                           a multiple of the largest block size */
+
+/*
+  Each vector step below takes a block of n bytes b[0..n-1] and updates the
+  sums as adler += b[0] + ... + b[n-1] and sum2 += n * adler_in + n * b[0] +
+  (n - 1) * b[1] + ... + 1 * b[n-1], where adler_in is adler before the block.
+  The byte sums and the weighted byte sums are accumulated in vector lanes, as
+  is the sum of adler_in over the blocks, which is multiplied by n at the end.
+  As for the scalar code, no more than NMAX bytes are summed between modulos,
+  which also keeps every lane from overflowing.
+ */
+#endif
+
+#ifdef ADLER_SSSE3
+
+#include <immintrin.h>
+
+#define SSSE3 __attribute__((target("ssse3")))
+#define AVX2 __attribute__((target("avx2")))
+
+/* Return the sum of the four 32-bit lanes of v. */
+local SSSE3 unsigned long sum_lanes(__m128i v) {
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0x4e));
+    v = _mm_add_epi32(v, _mm_shuffle_epi32(v, 0xb1));
+    return (unsigned)_mm_cvtsi128_si32(v);
+}
+
+/* Update adler with len bytes, a multiple of 32, 32 bytes at a time. */
+local SSSE3 uLong adler32_ssse3(uLong adler, const Bytef *buf, z_size_t len) {
+    unsigned long sum2;
+    unsigned n;
+    z_size_t blocks;
+    __m128i v_s1, v_s2, v_ps, lo, hi;
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i tap1 = _mm_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25,
+                                       24, 23, 22, 21, 20, 19, 18, 17);
+    const __m128i tap2 = _mm_setr_epi8(16, 15, 14, 13, 12, 11, 10, 9,
+                                       8, 7, 6, 5, 4, 3, 2, 1);
+
+    sum2 = (adler >> 16) & 0xffff;
+    adler &= 0xffff;
+    blocks = len >> 5;
+    while (blocks) {
+        n = NMAX >> 5;
+        if (n > blocks)
+            n = (unsigned)blocks;
+        blocks -= n;
+        v_ps = _mm_cvtsi32_si128((int)(adler * n));
+        v_s2 = _mm_cvtsi32_si128((int)sum2);
+        v_s1 = zero;
+        do {
+            lo = _mm_loadu_si128((const __m128i *)buf);
+            hi = _mm_loadu_si128((const __m128i *)(buf + 16));
+            v_ps = _mm_add_epi32(v_ps, v_s1);
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(lo, zero));
+            v_s2 = _mm_add_epi32(v_s2,
+                        _mm_madd_epi16(_mm_maddubs_epi16(lo, tap1), ones));
+            v_s1 = _mm_add_epi32(v_s1, _mm_sad_epu8(hi, zero));
+            v_s2 = _mm_add_epi32(v_s2,
+                        _mm_madd_epi16(_mm_maddubs_epi16(hi, tap2), ones));
+            buf += 32;
+        } while (--n);
+        v_s2 = _mm_add_epi32(v_s2, _mm_slli_epi32(v_ps, 5));
+        adler += sum_lanes(v_s1);
+        sum2 = sum_lanes(v_s2);
+        MOD(adler);
+        MOD(sum2);
+    }
+    return adler | (sum2 << 16);
+}
+
+/* Update adler with len bytes, a multiple of 64, 64 bytes at a time. */
+local AVX2 uLong adler32_avx2(uLong adler, const Bytef *buf, z_size_t len) {
+    unsigned long sum2;
+    unsigned n;
+    z_size_t blocks;
+    __m256i v_s1, v_s2, v_ps, lo, hi;
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i tap1 = _mm256_setr_epi8(64, 63, 62, 61, 60, 59, 58, 57,
+                                          56, 55, 54, 53, 52, 51, 50, 49,
+                                          48, 47, 46, 45, 44, 43, 42, 41,
+                                          40, 39, 38, 37, 36, 35, 34, 33);
+    const __m256i tap2 = _mm256_setr_epi8(32, 31, 30, 29, 28, 27, 26, 25,
+                                          24, 23, 22, 21, 20, 19, 18, 17,
+                                          16, 15, 14, 13, 12, 11, 10, 9,
+                                          8, 7, 6, 5, 4, 3, 2, 1);
+
+    sum2 = (adler >> 16) & 0xffff;
+    adler &= 0xffff;
+    blocks = len >> 6;
+    while (blocks) {
+        n = NMAX >> 6;
+        if (n > blocks)
+            n = (unsigned)blocks;
+        blocks -= n;
+        v_ps = _mm256_setr_epi32((int)(adler * n), 0, 0, 0, 0, 0, 0, 0);
+        v_s2 = _mm256_setr_epi32((int)sum2, 0, 0, 0, 0, 0, 0, 0);
+        v_s1 = zero;
+        do {
+            lo = _mm256_loadu_si256((const __m256i *)buf);
+            hi = _mm256_loadu_si256((const __m256i *)(buf + 32));
+            v_ps = _mm256_add_epi32(v_ps, v_s1);
+            v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(lo, zero));
+            v_s2 = _mm256_add_epi32(v_s2,
+                    _mm256_madd_epi16(_mm256_maddubs_epi16(lo, tap1), ones));
+            v_s1 = _mm256_add_epi32(v_s1, _mm256_sad_epu8(hi, zero));
+            v_s2 = _mm256_add_epi32(v_s2,
+                    _mm256_madd_epi16(_mm256_maddubs_epi16(hi, tap2), ones));
+            buf += 64;
+        } while (--n);
+        v_s2 = _mm256_add_epi32(v_s2, _mm256_slli_epi32(v_ps, 6));
+        adler += sum_lanes(_mm_add_epi32(_mm256_castsi256_si128(v_s1),
+                                         _mm256_extracti128_si256(v_s1, 1)));
+        sum2 = sum_lanes(_mm_add_epi32(_mm256_castsi256_si128(v_s2),
+                                       _mm256_extracti128_si256(v_s2, 1)));
+        MOD(adler);
+        MOD(sum2);
+    }
+    return adler | (sum2 << 16);
+}
+
+/* Vector function selected by adler32_simd_init(), if any. There is no harm
+   if more than one thread does the selection at the same time -- they all
+   store the same values, and a thread that sees adler32_simd_done set before
+   adler32_simd just uses the scalar code that one time. */
+local uLong (*adler32_simd)(uLong, const Bytef *, z_size_t);
+local volatile int adler32_simd_done;
+
+/* Select the widest vector instructions the processor and the operating
+   system support. */
+local void adler32_simd_init(void) {
+    unsigned feat = z_cpu_features();
+
+    if (feat & Z_CPU_AVX2)
+        adler32_simd = adler32_avx2;
+    else if (feat & Z_CPU_SSSE3)
+        adler32_simd = adler32_ssse3;
+    adler32_simd_done = 1;
+}
+
+#endif /* ADLER_SSSE3 */
+
+#ifdef ADLER_NEON
+
+#include <arm_neon.h>
+
+/* Update adler with len bytes, a multiple of 32, 32 bytes at a time. */
+local uLong adler32_neon(uLong adler, const Bytef *buf, z_size_t len) {
+    unsigned long sum2;
+    unsigned n;
+    z_size_t blocks;
+    uint32x4_t v_s1, v_s2, v_ps;
+    uint16x8_t c1, c2, c3, c4;
+    uint8x16_t lo, hi;
+    static const uint16_t taps[32] = {
+        32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17,
+        16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1};
+
+    sum2 = (adler >> 16) & 0xffff;
+    adler &= 0xffff;
+    blocks = len >> 5;
+    while (blocks) {
+        n = NMAX >> 5;
+        if (n > blocks)
+            n = (unsigned)blocks;
+        blocks -= n;
+        v_ps = vsetq_lane_u32((uint32_t)(adler * n), vdupq_n_u32(0), 0);
+        v_s1 = vdupq_n_u32(0);
+        c1 = c2 = c3 = c4 = vdupq_n_u16(0);
+        do {
+            lo = vld1q_u8(buf);
+            hi = vld1q_u8(buf + 16);
+            v_ps = vaddq_u32(v_ps, v_s1);
+            v_s1 = vpadalq_u16(v_s1, vpadalq_u8(vpaddlq_u8(lo), hi));
+            c1 = vaddw_u8(c1, vget_low_u8(lo));
+            c2 = vaddw_u8(c2, vget_high_u8(lo));
+            c3 = vaddw_u8(c3, vget_low_u8(hi));
+            c4 = vaddw_u8(c4, vget_high_u8(hi));
+            buf += 32;
+        } while (--n);
+        v_s2 = vshlq_n_u32(v_ps, 5);
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(c1), vld1_u16(taps));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(c1), vld1_u16(taps + 4));
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(c2), vld1_u16(taps + 8));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(c2), vld1_u16(taps + 12));
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(c3), vld1_u16(taps + 16));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(c3), vld1_u16(taps + 20));
+        v_s2 = vmlal_u16(v_s2, vget_low_u16(c4), vld1_u16(taps + 24));
+        v_s2 = vmlal_u16(v_s2, vget_high_u16(c4), vld1_u16(taps + 28));
+        adler += vaddvq_u32(v_s1);
+        sum2 += vaddvq_u32(v_s2);
+        MOD(adler);
+        MOD(sum2);
+    }
+    return adler | (sum2 << 16);
+}
+
+#endif /* ADLER_NEON */
+
 /* ========================================================================= */
 uLong ZEXPORT adler32_z(uLong adler, const Bytef *buf, z_size_t len) {
     unsigned long sum2;
@@ -67,6 +286,27 @@ uLong ZEXPORT adler32_z(uLong adler, const Bytef *buf, z_size_t len) {
         return 0; // or handle error accordingly
     }
 
+#ifdef ADLER_SIMD
+    /* do the bulk of a long buffer with vector instructions, leaving fewer
+       than SIMD_MIN bytes for the code below */
+    if (len >= SIMD_MIN && buf != Z_NULL) {
+        z_size_t bulk = len & ~(z_size_t)(SIMD_MIN - 1);
+#  ifdef ADLER_SSSE3
+        if (!adler32_simd_done)
+            adler32_simd_init();
+        if (adler32_simd != Z_NULL) {
+            adler = adler32_simd(adler, buf, bulk);
+            buf += bulk;
+            len -= bulk;
+        }
+#  else
+        adler = adler32_neon(adler, buf, bulk);
+        buf += bulk;
+        len -= bulk;
+#  endif
+    }
+#endif
+
     /* split Adler-32 into component sums */
     sum2 = (adler >> 16) & 0xffff;
     adler &= 0xffff;
@@ -131,7 +371,7 @@ uLong ZEXPORT adler32_z(uLong adler, const Bytef *buf, z_size_t len) {
 
 /* ========================================================================= */
 uLong ZEXPORT adler32(uLong adler, const Bytef *buf, uInt len) {
-    if (buf == NULL || len > UINT_MAX - sizeof(buf)) {
+    if (buf != NULL && len > UINT_MAX - sizeof(buf)) {
         return 0;  // Return an error value or handle it as appropriate
     }
     return adler32_z(adler, buf, len);
@@ -201,3 +441,15 @@ uLong ZEXPORT adler32_combine64(uLong adler1, uLong adler2, z_off64_t len2) {
 
     return adler32_combine_(adler1, adler2, len2);
 }
+
+/* ========================================================================= */
+uLong ZEXPORT adler32_combine_vec(uLong adler, const z_check *checks,
+                                  unsigned count) {
+    /* only the lengths modulo BASE matter */
+    while (count--) {
+        adler = adler32_combine_(adler, checks->check,
+                                 (z_off64_t)(checks->len % BASE));
+        checks++;
+    }
+    return adler;
+}
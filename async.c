@@ -0,0 +1,357 @@
+/* async.c -- compress and decompress memory buffers on a pool of threads
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/*
+ *  ALGORITHM
+ *
+ *      compressAsync() and uncompressAsync() append a job to a queue and
+ *      return at once. Worker threads take jobs from the queue in order and
+ *      run each to completion, as compress2() or uncompress2() would, or with
+ *      compressParallel() when the job asks for more than one thread. A
+ *      finished job either has its done callback called on the worker, or is
+ *      appended to a completion queue. One byte is written to a pipe when the
+ *      completion queue becomes non-empty, and is read back when the last job
+ *      is taken from it, so the read end of the pipe, from zlibAsyncFd(), is
+ *      readable exactly when there are jobs to reap, and the pipe can never
+ *      fill. An event loop (poll, epoll, or an io_uring poll) waits on that
+ *      descriptor, and then collects finished jobs with zlibAsyncReap().
+ *
+ *      Without pthreads, or if no worker can be started, each job is run on
+ *      the calling thread by the submitting function, and is then completed
+ *      in the same way.
+ */
+
+#include "zutil.h"
+#include "gzguts.h"     /* for par_cpus() */
+
+#if defined(Z_THREADS) && !defined(_WIN32)
+#  define ASYNC_THREADS
+#  include <errno.h>
+#  include <fcntl.h>
+#  include <pthread.h>
+#  include <unistd.h>
+#endif
+
+#define ASYNC_COMPRESS 1
+#define ASYNC_UNCOMPRESS 2
+
+struct z_async_s {
+    z_job FAR *head, FAR *tail;     /* jobs waiting for a worker */
+    z_job FAR *done, FAR *last;     /* finished jobs waiting to be reaped */
+    unsigned busy;          /* jobs submitted and not yet finished */
+    int stop;               /* true when the workers should exit */
+    int fd[2];              /* completion pipe, or -1 and -1 */
+#ifdef ASYNC_THREADS
+    unsigned threads;       /* number of workers started */
+    pthread_t *tid;         /* worker thread ids */
+    pthread_mutex_t lock;   /* protects everything above */
+    pthread_cond_t work;    /* signaled when a job is queued or at stop */
+    pthread_cond_t idle;    /* signaled when a job finishes */
+#endif
+};
+
+/* ===========================================================================
+ * Compress job as a single deflate stream, as compress2() does, but with the
+ * job's windowBits.
+ */
+local int async_deflate(z_job FAR *job) {
+    z_stream strm;
+    int ret;
+    uLong left = job->destLen, len = job->sourceLen;
+
+    job->destLen = 0;
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    ret = deflateInit2(&strm, job->level, Z_DEFLATED,
+                       job->windowBits ? job->windowBits : MAX_WBITS,
+                       DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+    if (ret != Z_OK)
+        return ret;
+    deflateOneShot(&strm);
+    strm.next_in = (z_const Bytef *)job->source;
+    strm.avail_in = 0;
+    strm.next_out = job->dest;
+    strm.avail_out = 0;
+    do {
+        if (strm.avail_out == 0) {
+            strm.avail_out = left > UINT_MAX ? UINT_MAX : (uInt)left;
+            left -= strm.avail_out;
+        }
+        if (strm.avail_in == 0) {
+            strm.avail_in = len > UINT_MAX ? UINT_MAX : (uInt)len;
+            len -= strm.avail_in;
+        }
+        ret = deflate(&strm, len ? Z_NO_FLUSH : Z_FINISH);
+    } while (ret == Z_OK);
+    job->destLen = strm.total_out;
+    deflateEnd(&strm);
+    return ret == Z_STREAM_END ? Z_OK : ret;
+}
+
+/* ===========================================================================
+ * Decompress job with the job's windowBits, with the results of
+ * uncompress2().
+ */
+local int async_inflate(z_job FAR *job) {
+    z_stream strm;
+    int ret;
+    uLong left = job->destLen, len = job->sourceLen;
+    Byte buf[1];    /* for detection of incomplete stream when destLen == 0 */
+
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    strm.next_in = Z_NULL;
+    strm.avail_in = 0;
+    ret = inflateInit2(&strm, job->windowBits ? job->windowBits : MAX_WBITS);
+    if (ret != Z_OK)
+        return ret;
+    strm.next_in = (z_const Bytef *)job->source;
+    strm.next_out = left ? job->dest : buf;
+    strm.avail_out = 0;
+    if (left == 0)
+        left = 1;
+    do {
+        if (strm.avail_out == 0) {
+            strm.avail_out = left > UINT_MAX ? UINT_MAX : (uInt)left;
+            left -= strm.avail_out;
+        }
+        if (strm.avail_in == 0) {
+            strm.avail_in = len > UINT_MAX ? UINT_MAX : (uInt)len;
+            len -= strm.avail_in;
+        }
+        ret = inflate(&strm, left == 0 && len == 0 ? Z_FINISH : Z_NO_FLUSH);
+    } while (ret == Z_OK);
+    job->sourceLen -= len + strm.avail_in;
+    if (job->destLen)
+        job->destLen = strm.total_out;
+    else if (strm.total_out && ret == Z_BUF_ERROR)
+        left = 1;
+    inflateEnd(&strm);
+    return ret == Z_STREAM_END ? Z_OK :
+           ret == Z_NEED_DICT ? Z_DATA_ERROR :
+           ret == Z_BUF_ERROR && left + strm.avail_out ? Z_DATA_ERROR :
+           ret;
+}
+
+/* ===========================================================================
+ * Run job, setting job->err.
+ */
+local void async_run(z_job FAR *job) {
+    if (job->op == ASYNC_UNCOMPRESS)
+        job->err = async_inflate(job);
+    else if (job->threads > 1)
+        job->err = compressParallel(job->dest, &job->destLen, job->source,
+                                    job->sourceLen, job->level,
+                                    job->windowBits ? job->windowBits :
+                                                      MAX_WBITS,
+                                    job->threads);
+    else
+        job->err = async_deflate(job);
+}
+
+/* ===========================================================================
+ * Complete job, which has been run, by calling its callback, or by putting it
+ * on the done list and making the pipe readable if the list was empty. If the
+ * workers are running, then this is called with the lock held, which is
+ * released for the callback. job is not touched after the callback, since the
+ * callback may free it.
+ */
+local void async_finish(z_asyncp async, z_job FAR *job) {
+    if (job->done != Z_NULL) {
+#ifdef ASYNC_THREADS
+        if (async->threads) {
+            pthread_mutex_unlock(&async->lock);
+            job->done(job);
+            pthread_mutex_lock(&async->lock);
+        }
+        else
+#endif
+            job->done(job);
+    }
+    else {
+        job->next = Z_NULL;
+        if (async->done == Z_NULL) {
+            async->done = job;
+#ifdef ASYNC_THREADS
+            {
+                char one = 1;
+                ssize_t got;
+                do {
+                    got = write(async->fd[1], &one, 1);
+                } while (got < 0 && errno == EINTR);
+            }
+#endif
+        }
+        else
+            async->last->next = job;
+        async->last = job;
+    }
+    async->busy--;
+}
+
+#ifdef ASYNC_THREADS
+/* ===========================================================================
+ * Worker thread: run jobs from the queue until told to stop.
+ */
+local void *async_worker(void *arg) {
+    z_asyncp async = (z_asyncp)arg;
+    z_job FAR *job;
+
+    pthread_mutex_lock(&async->lock);
+    for (;;) {
+        while (async->head == Z_NULL && !async->stop)
+            pthread_cond_wait(&async->work, &async->lock);
+        if (async->head == Z_NULL)
+            break;
+        job = async->head;
+        async->head = job->next;
+        pthread_mutex_unlock(&async->lock);
+        async_run(job);
+        pthread_mutex_lock(&async->lock);
+        async_finish(async, job);
+        pthread_cond_broadcast(&async->idle);
+    }
+    pthread_mutex_unlock(&async->lock);
+    return NULL;
+}
+#endif
+
+/* ========================================================================= */
+z_asyncp ZEXPORT zlibAsyncCreate(int threads) {
+    z_asyncp async;
+
+    async = (z_asyncp)zcalloc(Z_NULL, 1, sizeof(struct z_async_s));
+    if (async == Z_NULL)
+        return Z_NULL;
+    async->head = async->tail = Z_NULL;
+    async->done = async->last = Z_NULL;
+    async->busy = 0;
+    async->stop = 0;
+    async->fd[0] = async->fd[1] = -1;
+#ifdef ASYNC_THREADS
+    if (threads <= 0)
+        threads = (int)par_cpus();
+    async->threads = 0;
+    async->tid = (pthread_t *)zcalloc(Z_NULL, (unsigned)threads,
+                                      sizeof(pthread_t));
+    if (async->tid == NULL || pipe(async->fd)) {
+        if (async->tid != NULL)
+            zcfree(Z_NULL, async->tid);
+        zcfree(Z_NULL, async);
+        return Z_NULL;
+    }
+    fcntl(async->fd[0], F_SETFL, fcntl(async->fd[0], F_GETFL) | O_NONBLOCK);
+    fcntl(async->fd[0], F_SETFD, FD_CLOEXEC);
+    fcntl(async->fd[1], F_SETFD, FD_CLOEXEC);
+    pthread_mutex_init(&async->lock, NULL);
+    pthread_cond_init(&async->work, NULL);
+    pthread_cond_init(&async->idle, NULL);
+    while (async->threads < (unsigned)threads &&
+           pthread_create(async->tid + async->threads, NULL, async_worker,
+                          async) == 0)
+        async->threads++;
+#else
+    (void)threads;
+#endif
+    return async;
+}
+
+/* ===========================================================================
+ * Queue job for op, or run it now if there are no workers.
+ */
+local int async_submit(z_asyncp async, z_job FAR *job, int op) {
+    if (async == Z_NULL || job == Z_NULL)
+        return Z_STREAM_ERROR;
+    job->op = op;
+    job->err = Z_OK;
+    job->next = Z_NULL;
+#ifdef ASYNC_THREADS
+    if (async->threads) {
+        pthread_mutex_lock(&async->lock);
+        if (async->head == Z_NULL)
+            async->head = job;
+        else
+            async->tail->next = job;
+        async->tail = job;
+        async->busy++;
+        pthread_cond_signal(&async->work);
+        pthread_mutex_unlock(&async->lock);
+        return Z_OK;
+    }
+#endif
+    async->busy++;
+    async_run(job);
+    async_finish(async, job);
+    return Z_OK;
+}
+
+/* ========================================================================= */
+int ZEXPORT compressAsync(z_asyncp async, z_job FAR *job) {
+    return async_submit(async, job, ASYNC_COMPRESS);
+}
+
+/* ========================================================================= */
+int ZEXPORT uncompressAsync(z_asyncp async, z_job FAR *job) {
+    return async_submit(async, job, ASYNC_UNCOMPRESS);
+}
+
+/* ========================================================================= */
+int ZEXPORT zlibAsyncFd(z_asyncp async) {
+    return async == Z_NULL ? -1 : async->fd[0];
+}
+
+/* ========================================================================= */
+z_job FAR * ZEXPORT zlibAsyncReap(z_asyncp async, int wait) {
+    z_job FAR *job;
+
+    if (async == Z_NULL)
+        return Z_NULL;
+#ifdef ASYNC_THREADS
+    pthread_mutex_lock(&async->lock);
+    while (wait && async->done == Z_NULL && async->busy)
+        pthread_cond_wait(&async->idle, &async->lock);
+#else
+    (void)wait;
+#endif
+    job = async->done;
+    if (job != Z_NULL) {
+        async->done = job->next;
+#ifdef ASYNC_THREADS
+        if (async->done == Z_NULL) {
+            char one;
+            ssize_t got;
+            do {
+                got = read(async->fd[0], &one, 1);
+            } while (got < 0 && errno == EINTR);
+        }
+#endif
+    }
+#ifdef ASYNC_THREADS
+    pthread_mutex_unlock(&async->lock);
+#endif
+    return job;
+}
+
+/* ========================================================================= */
+void ZEXPORT zlibAsyncDestroy(z_asyncp async) {
+    if (async == Z_NULL)
+        return;
+#ifdef ASYNC_THREADS
+    pthread_mutex_lock(&async->lock);
+    async->stop = 1;
+    pthread_cond_broadcast(&async->work);
+    pthread_mutex_unlock(&async->lock);
+    while (async->threads)
+        pthread_join(async->tid[--async->threads], NULL);
+    pthread_cond_destroy(&async->idle);
+    pthread_cond_destroy(&async->work);
+    pthread_mutex_destroy(&async->lock);
+    zcfree(Z_NULL, async->tid);
+    close(async->fd[0]);
+    close(async->fd[1]);
+#endif
+    zcfree(Z_NULL, async);
+}
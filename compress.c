@@ -5,8 +5,52 @@
 
 /* @(#) $Id$ */
 
-#define ZLIB_INTERNAL
-#include "zlib.h"
+#include "zutil.h"
+
+/* ===========================================================================
+     Compress source to dest with stream, which has been initialized or reset
+   and not yet given any input, and is left at the end of the deflate stream.
+ */
+static int compress_stream(z_streamp stream, Bytef *dest, uLongf *destLen,
+                           const Bytef *source, uLong sourceLen) {
+    int err;
+    uLong left;
+
+    left = *destLen;
+    *destLen = 0;
+
+    deflateOneShot(stream);        /* all of the input is at source */
+
+    stream->next_out = dest;
+    stream->avail_out = 0;
+    stream->next_in = (z_const Bytef *)source;
+    stream->avail_in = 0;
+
+    do {
+        if (stream->avail_out == 0) {
+            if (left > (uLong)UINT_MAX) {
+                stream->avail_out = UINT_MAX;
+                left -= UINT_MAX;
+            } else {
+                stream->avail_out = (uInt)left;
+                left = 0;
+            }
+        }
+        if (stream->avail_in == 0) {
+            if (sourceLen > (uLong)UINT_MAX) {
+                stream->avail_in = UINT_MAX;
+                sourceLen -= UINT_MAX;
+            } else {
+                stream->avail_in = (uInt)sourceLen;
+                sourceLen = 0;
+            }
+        }
+        err = deflate(stream, sourceLen ? Z_NO_FLUSH : Z_FINISH);
+    } while (err == Z_OK);
+
+    *destLen = stream->total_out;
+    return err == Z_STREAM_END ? Z_OK : err;
+}
 
 /* ===========================================================================
      Compresses the source buffer into the destination buffer. The level
@@ -34,50 +78,55 @@ int ZEXPORT compress2(Bytef *dest, uLongf *destLen, const Bytef *source,
     }
 
     z_stream stream;
+    z_poolp cache;
     int err;
-    const uInt max = (uInt)-1;
-    uLong left;
-
-    left = *destLen;
-    *destLen = 0;
 
     stream.zalloc = (alloc_func)0;
     stream.zfree = (free_func)0;
     stream.opaque = (voidpf)0;
 
-    err = deflateInit(&stream, level);
+    /* reuse a state from this thread's cache if zlibStreamCache() enabled */
+    cache = z_stream_cache();
+    err = deflatePoolInit2(&stream, cache, level, Z_DEFLATED, MAX_WBITS,
+                           DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY);
     if (err != Z_OK) return err;
+    err = compress_stream(&stream, dest, destLen, source, sourceLen);
+    deflatePoolEnd(&stream, cache);
+    return err;
+}
 
-    stream.next_out = dest;
-    stream.avail_out = 0;
-    stream.next_in = (z_const Bytef *)source;
-    stream.avail_in = 0;
+/* ===========================================================================
+     Compress each buffer with one deflate state, reset between buffers.
+ */
+int ZEXPORT compressBatch(z_bufp bufs, unsigned count, int level) {
+    z_stream stream;
+    int err, ret;
+    unsigned n;
 
-    do {
-        if (stream.avail_out == 0) {
-            if (left > (uLong)UINT_MAX) {
-                stream.avail_out = UINT_MAX;
-                left -= UINT_MAX;
-            } else {
-                stream.avail_out = (uInt)left;
-                left = 0;
-            }
-        }
-        if (stream.avail_in == 0) {
-            if (sourceLen > (uLong)UINT_MAX) {
-                stream.avail_in = UINT_MAX;
-                sourceLen -= UINT_MAX;
-            } else {
-                stream.avail_in = (uInt)sourceLen;
-                sourceLen = 0;
-            }
-        }
-        err = deflate(&stream, sourceLen ? Z_NO_FLUSH : Z_FINISH);
-    } while (err == Z_OK);
+    if (bufs == NULL && count)
+        return Z_STREAM_ERROR;
+
+    stream.zalloc = (alloc_func)0;
+    stream.zfree = (free_func)0;
+    stream.opaque = (voidpf)0;
 
-    *destLen = stream.total_out;
+    err = deflateInit(&stream, level);
+    if (err != Z_OK) return err;
+    ret = Z_OK;
+    for (n = 0; n < count; n++) {
+        if (n)
+            deflateReset(&stream);
+        if (bufs[n].dest == NULL || bufs[n].source == NULL)
+            bufs[n].err = Z_STREAM_ERROR;
+        else
+            bufs[n].err = compress_stream(&stream, bufs[n].dest,
+                                          &bufs[n].destLen, bufs[n].source,
+                                          bufs[n].sourceLen);
+        if (ret == Z_OK)
+            ret = bufs[n].err;
+    }
     deflateEnd(&stream);
-    return err == Z_STREAM_END ? Z_OK : err;
+    return ret;
 }
 
 /* ===========================================================================
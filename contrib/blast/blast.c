@@ -1,7 +1,7 @@
 /* blast.c
- * Copyright (C) 2003, 2012, 2013 Mark Adler
+ * Copyright (C) 2003, 2012, 2013, 2026 Mark Adler
  * For conditions of distribution and use, see copyright notice in blast.h
- * version 1.3, 24 Aug 2013
+ * version 1.4, 15 Oct 2026
  *
  * blast.c decompresses data compressed by the PKWare Compression Library.
  * This function provides functionality similar to the explode() function of
@@ -27,15 +27,22 @@
  * 1.3  24 Aug 2013     - Return unused input from blast()
  *                      - Fix test code to correctly report unused input
  *                      - Enable the provision of initial input to blast()
+ * 1.4  15 Oct 2026     - Decode with lookup tables when there is enough input
+ *                      - Copy matches with memcpy() instead of byte by byte
  */
 
 #include <stddef.h>             /* for NULL */
 #include <setjmp.h>             /* for setjmp(), longjmp(), and jmp_buf */
+#include <string.h>             /* for memcpy() and memmove() */
 #include "blast.h"              /* prototype for blast() */
 
 #define local static            /* for local function definitions */
 #define MAXBITS 13              /* maximum code length */
 #define MAXWIN 4096             /* maximum window size */
+#define LITBITS 13              /* index bits for literal lookup table */
+#define LENBITS 7               /* index bits for length lookup table */
+#define DISTBITS 8              /* index bits for distance lookup table */
+#define MORE 3                  /* fast() return when input runs low */
 
 /* input and output state */
 struct state {
@@ -241,6 +248,202 @@ local int construct(struct huffman *h, const unsigned char *rep, int n)
     return left;
 }
 
+/*
+ * Given the canonical Huffman code h, fill tab[] with 2^bits entries for
+ * decoding a code by looking up the next bits bits of the stream.  Each entry
+ * is the symbol shifted up four bits, with the length of its code in the low
+ * four bits.  An entry is replicated at every index that has the code in its
+ * low bits, whatever the bits above it.  bits must be at least the longest
+ * code length in h, and for every entry to be filled the code must be
+ * complete, which is true of all three fixed codes.  The codes are assigned
+ * as in decode(), and are inverted and bit-reversed to match the stream.
+ */
+local void table(unsigned short *tab, int bits, struct huffman *h)
+{
+    int len;            /* current code length */
+    int count;          /* number of codes of length len left */
+    int index;          /* index of current symbol in symbol table */
+    int code;           /* current code, in decode() order */
+    int rev;            /* code as it appears in the stream */
+    int n;              /* bit counter, then table index */
+
+    code = index = 0;
+    for (len = 1; len <= bits; len++) {
+        for (count = h->count[len]; count; count--) {
+            rev = 0;
+            for (n = 0; n < len; n++)
+                rev |= (((code >> (len - 1 - n)) & 1) ^ 1) << n;
+            for (n = rev; n < 1 << bits; n += 1 << len)
+                tab[n] = (unsigned short)((h->symbol[index] << 4) | len);
+            code++;
+            index++;
+        }
+        code <<= 1;
+    }
+}
+
+/*
+ * Copy len bytes from dist bytes back in the output, writing the window with
+ * outfun() each time it fills.  Return 1 if outfun() fails, else 0.  A copy
+ * that overlaps itself, i.e. len greater than dist, repeats the last dist
+ * bytes, so after the first dist bytes are copied the source can stay put
+ * while the destination moves ahead, doubling the size of each memcpy().
+ * The distance must have already been checked against the output so far.
+ */
+local int copy(struct state *s, unsigned dist, int len)
+{
+    unsigned char *from, *to;   /* copy pointers */
+    unsigned run;               /* bytes to copy before the end of out[] */
+    unsigned gap;               /* current distance from from to to */
+
+    do {
+        to = s->out + s->next;
+        from = to - dist;
+        run = MAXWIN;
+        if (s->next < dist) {
+            from += run;
+            run = dist;
+        }
+        run -= s->next;
+        if (run > (unsigned)len) run = len;
+        len -= run;
+        s->next += run;
+        if (from >= to)                 /* wrapped around, copy forward */
+            memmove(to, from, run);
+        else {
+            while (run > (gap = (unsigned)(to - from))) {
+                memcpy(to, from, gap);
+                to += gap;
+                run -= gap;
+            }
+            memcpy(to, from, run);
+        }
+        if (s->next == MAXWIN) {
+            if (s->outfun(s->outhow, s->out, s->next)) return 1;
+            s->next = 0;
+            s->first = 0;
+        }
+    } while (len != 0);
+    return 0;
+}
+
+/* Lookup tables built from the fixed codes, see table() */
+local unsigned short littab[1 << LITBITS];
+local unsigned short lentab[1 << LENBITS];
+local unsigned short disttab[1 << DISTBITS];
+
+/* Base lengths and extra bits for the length codes */
+local const short base[16] = {
+    3, 2, 4, 5, 6, 7, 8, 9, 10, 12, 16, 24, 40, 72, 136, 264};
+local const char extra[16] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8};
+
+/*
+ * Decode literals and length/distance pairs using the lookup tables while
+ * there are at least four bytes of input left in s->in, without calling
+ * infun().  This is the same decoding as in decomp(), but with the bits held
+ * in a local bit buffer that is refilled two bytes at a time, and with a code
+ * decoded in one table lookup instead of one bit at a time.  At most 16 bits
+ * are needed for a flag and a literal or length with extra bits, and at most
+ * 14 bits for a distance with extra bits, so at most four bytes are read for
+ * each.  On return, whole bytes that were read but not used are put back in
+ * s->in, leaving less than eight bits in s->bitbuf, as bits() does.
+ *
+ * Return MORE if there is not enough input left to continue, 0 if the end
+ * code was decoded, or 1 or -3 for the errors of the same value from decomp().
+ */
+local int fast(struct state *s, int lit, int dict)
+{
+    unsigned long hold;         /* local bit buffer */
+    unsigned have;              /* number of bits in hold */
+    unsigned here;              /* table entry */
+    unsigned symbol;            /* decoded symbol, extra bits for distance */
+    int len;                    /* length for copy */
+    unsigned dist;              /* distance for copy */
+    int ret;                    /* return value */
+
+    hold = (unsigned long)s->bitbuf;
+    have = (unsigned)s->bitcnt;
+    ret = MORE;
+    while (s->left >= 4) {
+        while (have < 16) {
+            hold |= (unsigned long)(*(s->in)++) << have;
+            s->left--;
+            have += 8;
+        }
+        if (hold & 1) {
+            /* get length */
+            here = lentab[(hold >> 1) & ((1U << LENBITS) - 1)];
+            hold >>= 1 + (here & 15);
+            have -= 1 + (here & 15);
+            symbol = here >> 4;
+            len = base[symbol] + (int)(hold & ((1U << extra[symbol]) - 1));
+            hold >>= extra[symbol];
+            have -= extra[symbol];
+            if (len == 519) {                   /* end code */
+                ret = 0;
+                break;
+            }
+
+            /* get distance */
+            while (have < 16) {
+                hold |= (unsigned long)(*(s->in)++) << have;
+                s->left--;
+                have += 8;
+            }
+            here = disttab[hold & ((1U << DISTBITS) - 1)];
+            hold >>= here & 15;
+            have -= here & 15;
+            symbol = len == 2 ? 2 : dict;
+            dist = ((here >> 4) << symbol) + (hold & ((1U << symbol) - 1));
+            hold >>= symbol;
+            have -= symbol;
+            dist++;
+            if (s->first && dist > s->next) {
+                ret = -3;               /* distance too far back */
+                break;
+            }
+
+            /* copy length bytes from distance bytes back */
+            if (copy(s, dist, len)) {
+                ret = 1;
+                break;
+            }
+        }
+        else {
+            /* get literal and write it */
+            if (lit) {
+                here = littab[(hold >> 1) & ((1U << LITBITS) - 1)];
+                hold >>= 1 + (here & 15);
+                have -= 1 + (here & 15);
+                symbol = here >> 4;
+            }
+            else {
+                symbol = (hold >> 1) & 0xff;
+                hold >>= 9;
+                have -= 9;
+            }
+            s->out[s->next++] = symbol;
+            if (s->next == MAXWIN) {
+                if (s->outfun(s->outhow, s->out, s->next)) {
+                    ret = 1;
+                    break;
+                }
+                s->next = 0;
+                s->first = 0;
+            }
+        }
+    }
+
+    /* return unused whole bytes to the input */
+    s->in -= have >> 3;
+    s->left += have >> 3;
+    have &= 7;
+    s->bitbuf = (int)(hold & ((1U << have) - 1));
+    s->bitcnt = (int)have;
+    return ret;
+}
+
 /*
  * Decode PKWare Compression Library stream.
  *
@@ -286,8 +489,7 @@ local int decomp(struct state *s)
     int symbol;         /* decoded symbol, extra bits for distance */
     int len;            /* length for copy */
     unsigned dist;      /* distance for copy */
-    int copy;           /* copy counter */
-    unsigned char *from, *to;   /* copy pointers */
+    int err;            /* return value from fast() */
     static int virgin = 1;                              /* build tables once */
     static short litcnt[MAXBITS+1], litsym[256];        /* litcode memory */
     static short lencnt[MAXBITS+1], lensym[16];         /* lencode memory */
@@ -307,16 +509,15 @@ local int decomp(struct state *s)
     static const unsigned char lenlen[] = {2, 35, 36, 53, 38, 23};
         /* bit lengths of distance codes 0..63 */
     static const unsigned char distlen[] = {2, 20, 53, 230, 247, 151, 248};
-    static const short base[16] = {     /* base for length codes */
-        3, 2, 4, 5, 6, 7, 8, 9, 10, 12, 16, 24, 40, 72, 136, 264};
-    static const char extra[16] = {     /* extra bits for length codes */
-        0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 7, 8};
 
     /* set up decoding tables (once--might not be thread-safe) */
     if (virgin) {
         construct(&litcode, litlen, sizeof(litlen));
         construct(&lencode, lenlen, sizeof(lenlen));
         construct(&distcode, distlen, sizeof(distlen));
+        table(littab, LITBITS, &litcode);
+        table(lentab, LENBITS, &lencode);
+        table(disttab, DISTBITS, &distcode);
         virgin = 0;
     }
 
@@ -328,6 +529,12 @@ local int decomp(struct state *s)
 
     /* decode literals and length/distance pairs */
     do {
+        /* decode with the lookup tables while there is enough input */
+        if (s->left >= 4) {
+            err = fast(s, lit, dict);
+            if (err != MORE) return err;
+        }
+
         if (bits(s, 1)) {
             /* get length */
             symbol = decode(s, &lencode);
@@ -343,27 +550,7 @@ local int decomp(struct state *s)
                 return -3;              /* distance too far back */
 
             /* copy length bytes from distance bytes back */
-            do {
-                to = s->out + s->next;
-                from = to - dist;
-                copy = MAXWIN;
-                if (s->next < dist) {
-                    from += copy;
-                    copy = dist;
-                }
-                copy -= s->next;
-                if (copy > len) copy = len;
-                len -= copy;
-                s->next += copy;
-                do {
-                    *to++ = *from++;
-                } while (--copy);
-                if (s->next == MAXWIN) {
-                    if (s->outfun(s->outhow, s->out, s->next)) return 1;
-                    s->next = 0;
-                    s->first = 0;
-                }
-            } while (len != 0);
+            if (copy(s, dist, len)) return 1;
         }
         else {
             /* get literal and write it */
@@ -1,6 +1,6 @@
 /* blast.h -- interface for blast.c
-  Copyright (C) 2003, 2012, 2013 Mark Adler
-  version 1.3, 24 Aug 2013
+  Copyright (C) 2003, 2012, 2013, 2026 Mark Adler
+  version 1.4, 15 Oct 2026
 
   This software is provided 'as-is', without any express or implied
   warranty.  In no event will the author be held liable for any damages
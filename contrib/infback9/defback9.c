@@ -0,0 +1,777 @@
+/* defback9.c -- compress to deflate64 using a call-back interface
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/*
+ *  ALGORITHM
+ *
+ *      This is deflate() in miniature, with the few changes that deflate64
+ *      needs.  The input is kept in a buffer of two 64K windows and the
+ *      lookahead for the longest match.  Each three-byte string is hashed
+ *      into head[], and earlier strings with the same hash are chained
+ *      through prev[], as in deflate.c.  Since positions in the buffer need
+ *      more than 16 bits, head[] and prev[] hold unsigned int's.  Levels 1 to
+ *      3 take the longest match found at each position, and levels 4 to 9
+ *      defer each match by one byte to see if the next one is longer, with
+ *      the search limits of deflate.c for each level.
+ *
+ *      Matches may reach back 65535 bytes, instead of the 65536 that
+ *      deflate64 permits, so that a chain can never lead into a slot of
+ *      prev[] that has been reused.  Match lengths past 258 are written with
+ *      length code 285 and its 16 extra bits, up to 65538.
+ *
+ *      The literals and matches of each block are buffered, and then the
+ *      block is written as stored, fixed, or dynamic, whichever is smallest.
+ *      Code lengths are made by Huffman's algorithm, and if any is longer
+ *      than permitted, the frequencies are halved and the code is made again.
+ */
+
+#include "zutil.h"
+#include "defback9.h"
+
+#define WSIZE 65536U            /* deflate64 window size */
+#define WMASK (WSIZE - 1)
+#define MAXDIST (WSIZE - 1)     /* farthest back a match may start */
+#define MINMATCH 3
+#define MAXMATCH 65538U         /* longest match, code 285 with 16 extra bits */
+#define LOOK (MAXMATCH + MINMATCH)
+#define WBUF (2 * WSIZE + LOOK) /* input buffer size */
+#define HBITS 16
+#define HSIZE (1U << HBITS)
+#define NIL 0
+#define TOO_FAR 4096            /* farthest back for a match of three */
+#define SYMS 16384U             /* literals and matches per block */
+#define OUTSIZE 16384U          /* output buffer size */
+
+#define LCODES 286              /* literal/length codes */
+#define DCODES 32               /* distance codes */
+#define BLCODES 19              /* code length codes */
+#define MAXBITS 15
+#define MAXBLBITS 7
+#define END_BLOCK 256
+
+/* Search parameters for each level, those of deflate.c.  For levels 1 to 3,
+   lazy is the longest match whose strings are inserted in the hash table. */
+local const struct {
+    unsigned short good, lazy, nice, chain;
+} config9[10] = {
+/*      good lazy nice chain */
+/* 0 */ {0,    0,   0,    0},       /* stored blocks */
+/* 1 */ {4,    4,   8,    4},       /* longest match */
+/* 2 */ {4,    5,  16,    8},
+/* 3 */ {4,    6,  32,   32},
+/* 4 */ {4,    4,  16,   16},       /* lazy matches */
+/* 5 */ {8,   16,  32,   32},
+/* 6 */ {8,   16, 128,  128},
+/* 7 */ {8,   32, 128,  256},
+/* 8 */ {32, 128, 258, 1024},
+/* 9 */ {32, 258, 258, 4096}};
+
+/* order of the code length code lengths in a dynamic block header */
+local const unsigned char order9[BLCODES] = {
+    16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+typedef struct {
+    unsigned short len;         /* literal, or match length - 3 */
+    unsigned short dist;        /* match distance, or 0 for a literal */
+} sym9;
+
+struct defback9_state {
+    z_stream FAR *strm;
+    unsigned good, lazy, nice, chain;   /* search parameters */
+    int level;
+
+        /* input */
+    in_func in;
+    void FAR *in_desc;
+    z_const unsigned char FAR *next;    /* input from in() not yet used */
+    unsigned avail;
+    int eof;                    /* true when in() has returned zero */
+    unsigned strstart;          /* position in buf[] being compressed */
+    unsigned end;               /* end of the input in buf[] */
+    unsigned match_start;       /* start of the last match found */
+    long block_start;           /* start of the block, negative if slid out */
+
+        /* block */
+    sym9 sym[SYMS];             /* literals and matches of the block */
+    unsigned nsym;
+    unsigned lfreq[LCODES];     /* literal/length code frequencies */
+    unsigned dfreq[DCODES];     /* distance code frequencies */
+    unsigned long xbits;        /* total extra bits of the lengths and
+                                   distances */
+
+        /* output */
+    out_func out;
+    void FAR *out_desc;
+    int err;                    /* true if out() returned non-zero */
+    unsigned long bits;         /* bits not yet written, up to 23 */
+    int nbits;
+    unsigned have;              /* bytes in obuf[] */
+    unsigned char obuf[OUTSIZE];
+
+        /* fixed codes */
+    unsigned char flen[LCODES + 2];     /* with the two unused codes, */
+    unsigned short fcode[LCODES + 2];   /*   which are in the fixed code */
+    unsigned char fdlen[DCODES];
+    unsigned short fdcode[DCODES];
+
+        /* strings */
+    unsigned head[HSIZE];       /* most recent position of each hash */
+    unsigned prev[WSIZE];       /* previous position with the same hash */
+    unsigned char buf[WBUF];
+};
+
+/* ===========================================================================
+ * Return the length code for a match of length l + 3, and its extra bits.
+ */
+local unsigned len_sym(unsigned l, unsigned *xbits, unsigned *xval) {
+    unsigned n;
+
+    if (l > 255) {
+        *xbits = 16;
+        *xval = l;
+        return 285;
+    }
+    if (l < 8) {
+        *xbits = 0;
+        *xval = 0;
+        return 257 + l;
+    }
+    n = 3;
+    while (l >> (n + 1))
+        n++;
+    *xbits = n - 2;
+    *xval = l & ((1U << (n - 2)) - 1);
+    return 257 + 4 * (n - 1) + ((l >> (n - 2)) & 3);
+}
+
+/* ===========================================================================
+ * Return the distance code for a distance of d + 1, and its extra bits.
+ */
+local unsigned dist_sym(unsigned d, unsigned *xbits, unsigned *xval) {
+    unsigned n;
+
+    if (d < 4) {
+        *xbits = 0;
+        *xval = 0;
+        return d;
+    }
+    n = 2;
+    while (d >> (n + 1))
+        n++;
+    *xbits = n - 1;
+    *xval = d & ((1U << (n - 1)) - 1);
+    return 2 * n + ((d >> (n - 1)) & 1);
+}
+
+/* ===========================================================================
+ * Set len[0..n-1] to the Huffman code lengths for freq[0..n-1], with none
+ * longer than limit.  At least two frequencies must not be zero.
+ */
+local void huff_lengths(const unsigned *freq, unsigned n, unsigned limit,
+                        unsigned char *len) {
+    unsigned f[LCODES], leaf[LCODES];
+    unsigned long w[2 * LCODES];
+    unsigned par[2 * LCODES], dep[2 * LCODES];
+    unsigned m, i, j, k, a, b, node, max;
+
+    for (i = 0; i < n; i++)
+        f[i] = freq[i];
+    for (;;) {
+        /* sort the symbols that are used by frequency */
+        m = 0;
+        for (i = 0; i < n; i++) {
+            len[i] = 0;
+            if (f[i]) {
+                k = m++;
+                while (k && f[leaf[k - 1]] > f[i]) {
+                    leaf[k] = leaf[k - 1];
+                    k--;
+                }
+                leaf[k] = i;
+            }
+        }
+
+        /* combine the two lightest of the leaves and the nodes made so far,
+           which are both in order of weight */
+        for (i = 0; i < m; i++)
+            w[i] = f[leaf[i]];
+        i = 0;
+        j = m;
+        for (node = m; node < 2 * m - 1; node++) {
+            a = i < m && (j == node || w[i] <= w[j]) ? i++ : j++;
+            b = i < m && (j == node || w[i] <= w[j]) ? i++ : j++;
+            w[node] = w[a] + w[b];
+            par[a] = par[b] = node;
+        }
+
+        /* the depth of each leaf is its code length */
+        dep[2 * m - 2] = 0;
+        for (k = 2 * m - 2; k-- > 0;)
+            dep[k] = dep[par[k]] + 1;
+        max = 0;
+        for (i = 0; i < m; i++) {
+            len[leaf[i]] = (unsigned char)dep[i];
+            if (dep[i] > max)
+                max = dep[i];
+        }
+        if (max <= limit)
+            return;
+
+        /* too long -- flatten the frequencies and try again */
+        for (i = 0; i < n; i++)
+            if (f[i])
+                f[i] = (f[i] >> 1) | 1;
+    }
+}
+
+/* ===========================================================================
+ * Set code[] to the canonical codes for the code lengths len[0..n-1], with
+ * their bits reversed for writing from the least significant bit.
+ */
+local void huff_codes(const unsigned char *len, unsigned n,
+                      unsigned short *code) {
+    unsigned count[MAXBITS + 1], next[MAXBITS + 1];
+    unsigned i, b, c, r;
+
+    for (b = 0; b <= MAXBITS; b++)
+        count[b] = 0;
+    for (i = 0; i < n; i++)
+        count[len[i]]++;
+    count[0] = 0;
+    c = 0;
+    for (b = 1; b <= MAXBITS; b++) {
+        c = (c + count[b - 1]) << 1;
+        next[b] = c;
+    }
+    for (i = 0; i < n; i++)
+        if (len[i]) {
+            c = next[len[i]]++;
+            r = 0;
+            for (b = len[i]; b; b--) {
+                r = (r << 1) | (c & 1);
+                c >>= 1;
+            }
+            code[i] = (unsigned short)r;
+        }
+}
+
+/* ===========================================================================
+ * Make at least two of freq[0..n-1] not zero, for huff_lengths().
+ */
+local void two_codes(unsigned *freq, unsigned n) {
+    unsigned i, used = 0;
+
+    for (i = 0; i < n; i++)
+        used += freq[i] != 0;
+    for (i = 0; used < 2; i++)
+        if (freq[i] == 0) {
+            freq[i] = 1;
+            used++;
+        }
+}
+
+/* ===========================================================================
+ * Write out the buffered output.
+ */
+local void flush_out(struct defback9_state FAR *s) {
+    if (s->have && !s->err) {
+        if (s->out(s->out_desc, s->obuf, s->have))
+            s->err = 1;
+        else
+            s->strm->total_out += s->have;
+    }
+    s->have = 0;
+}
+
+/* ===========================================================================
+ * Write the low n bits of val, n <= 16.
+ */
+local void put_bits(struct defback9_state FAR *s, unsigned val, int n) {
+    s->bits |= (unsigned long)val << s->nbits;
+    s->nbits += n;
+    while (s->nbits >= 8) {
+        s->obuf[s->have++] = (unsigned char)s->bits;
+        if (s->have == OUTSIZE)
+            flush_out(s);
+        s->bits >>= 8;
+        s->nbits -= 8;
+    }
+}
+
+/* ===========================================================================
+ * Write the buffered literals and matches with the given codes, and the end
+ * of the block.
+ */
+local void put_syms(struct defback9_state FAR *s, const unsigned char *llen,
+                    const unsigned short *lcode, const unsigned char *dlen,
+                    const unsigned short *dcode) {
+    unsigned i, c, xbits, xval;
+
+    for (i = 0; i < s->nsym; i++) {
+        if (s->sym[i].dist == 0)
+            put_bits(s, lcode[s->sym[i].len], llen[s->sym[i].len]);
+        else {
+            c = len_sym(s->sym[i].len, &xbits, &xval);
+            put_bits(s, lcode[c], llen[c]);
+            if (xbits)
+                put_bits(s, xval, (int)xbits);
+            c = dist_sym(s->sym[i].dist - 1U, &xbits, &xval);
+            put_bits(s, dcode[c], dlen[c]);
+            if (xbits)
+                put_bits(s, xval, (int)xbits);
+        }
+    }
+    put_bits(s, lcode[END_BLOCK], llen[END_BLOCK]);
+}
+
+/* ===========================================================================
+ * Write len bytes at data as stored blocks, the last one final if last.
+ */
+local void put_stored(struct defback9_state FAR *s, const unsigned char *data,
+                      unsigned long len, int last) {
+    unsigned n, i;
+
+    do {
+        n = len > 65535 ? 65535 : (unsigned)len;
+        len -= n;
+        put_bits(s, last && len == 0, 3);
+        if (s->nbits)
+            put_bits(s, 0, 8 - s->nbits);
+        put_bits(s, n, 16);
+        put_bits(s, ~n & 0xffff, 16);
+        for (i = 0; i < n; i++)
+            put_bits(s, data[i], 8);
+        data += n;
+    } while (len);
+}
+
+/* ===========================================================================
+ * Write the block of buffered literals and matches, which ends at pos in
+ * buf[], as stored, fixed, or dynamic, whichever is smallest, and start a new
+ * block at pos.
+ */
+local void flush_block(struct defback9_state FAR *s, unsigned pos, int last) {
+    unsigned lf[LCODES], df[DCODES], blf[BLCODES];
+    unsigned char lens[LCODES + DCODES], bllen[BLCODES];
+    unsigned short lcode[LCODES], dcode[DCODES], blcode[BLCODES];
+    unsigned char rle[LCODES + DCODES], rlex[LCODES + DCODES];
+    unsigned nlit, ndist, nbl, nrle, i, j, run;
+    unsigned long dyn, fix, stored, bytes;
+
+    s->lfreq[END_BLOCK] = 1;
+    bytes = s->block_start < 0 ? 0 : (unsigned long)(pos - s->block_start);
+
+    /* make the dynamic code */
+    for (i = 0; i < LCODES; i++)
+        lf[i] = s->lfreq[i];
+    for (i = 0; i < DCODES; i++)
+        df[i] = s->dfreq[i];
+    two_codes(lf, LCODES);
+    two_codes(df, DCODES);
+    huff_lengths(lf, LCODES, MAXBITS, lens);
+    huff_lengths(df, DCODES, MAXBITS, lens + LCODES);
+    nlit = LCODES;
+    while (nlit > 257 && lens[nlit - 1] == 0)
+        nlit--;
+    ndist = DCODES;
+    while (ndist > 1 && lens[LCODES + ndist - 1] == 0)
+        ndist--;
+    for (i = 0; i < ndist; i++)
+        lens[nlit + i] = lens[LCODES + i];
+
+    /* run-length encode the code lengths with codes 16, 17, and 18 */
+    for (i = 0; i < BLCODES; i++)
+        blf[i] = 0;
+    nrle = 0;
+    for (i = 0; i < nlit + ndist; i += run) {
+        run = 1;
+        while (i + run < nlit + ndist && lens[i + run] == lens[i])
+            run++;
+        j = run;
+        if (lens[i] == 0) {
+            for (; j >= 11; j -= rlex[nrle++] + 11U) {
+                rle[nrle] = 18;
+                rlex[nrle] = (unsigned char)((j > 138 ? 138 : j) - 11);
+            }
+            if (j >= 3) {
+                rle[nrle] = 17;
+                rlex[nrle++] = (unsigned char)(j - 3);
+                j = 0;
+            }
+        }
+        else {
+            rle[nrle] = lens[i];
+            rlex[nrle++] = 0;
+            for (j--; j >= 3; j -= rlex[nrle++] + 3U) {
+                rle[nrle] = 16;
+                rlex[nrle] = (unsigned char)((j > 6 ? 6 : j) - 3);
+            }
+        }
+        while (j--) {
+            rle[nrle] = lens[i];
+            rlex[nrle++] = 0;
+        }
+    }
+    for (i = 0; i < nrle; i++)
+        blf[rle[i]]++;
+    two_codes(blf, BLCODES);
+    huff_lengths(blf, BLCODES, MAXBLBITS, bllen);
+    nbl = BLCODES;
+    while (nbl > 4 && bllen[order9[nbl - 1]] == 0)
+        nbl--;
+
+    /* compare the sizes in bits */
+    dyn = 3 + 14 + 3 * nbl + s->xbits;
+    for (i = 0; i < nrle; i++)
+        dyn += bllen[rle[i]] + (rle[i] == 16 ? 2U : rle[i] == 17 ? 3U :
+                                rle[i] == 18 ? 7U : 0U);
+    fix = 3 + s->xbits;
+    for (i = 0; i < LCODES; i++) {
+        dyn += (unsigned long)s->lfreq[i] * (i < nlit ? lens[i] : 0);
+        fix += (unsigned long)s->lfreq[i] * s->flen[i];
+    }
+    for (i = 0; i < DCODES; i++) {
+        dyn += (unsigned long)s->dfreq[i] * (i < ndist ? lens[nlit + i] : 0);
+        fix += (unsigned long)s->dfreq[i] * 5;
+    }
+    stored = (bytes + 5 * (bytes / 65535 + 1)) << 3;
+
+    /* write the block */
+    if (s->block_start >= 0 && (s->level == 0 ||
+                                (stored <= dyn + 7 && stored <= fix + 7)))
+        put_stored(s, s->buf + s->block_start, bytes, last);
+    else if (fix <= dyn) {
+        put_bits(s, 2U + (unsigned)last, 3);
+        put_syms(s, s->flen, s->fcode, s->fdlen, s->fdcode);
+    }
+    else {
+        put_bits(s, 4U + (unsigned)last, 3);
+        put_bits(s, nlit - 257, 5);
+        put_bits(s, ndist - 1, 5);
+        put_bits(s, nbl - 4, 4);
+        for (i = 0; i < nbl; i++)
+            put_bits(s, bllen[order9[i]], 3);
+        huff_codes(bllen, BLCODES, blcode);
+        for (i = 0; i < nrle; i++) {
+            put_bits(s, blcode[rle[i]], bllen[rle[i]]);
+            if (rle[i] >= 16)
+                put_bits(s, rlex[i], rle[i] == 16 ? 2 : rle[i] == 17 ? 3 : 7);
+        }
+        huff_codes(lens, nlit, lcode);
+        huff_codes(lens + nlit, ndist, dcode);
+        put_syms(s, lens, lcode, lens + nlit, dcode);
+    }
+    if (last && s->nbits)
+        put_bits(s, 0, 8 - s->nbits);
+
+    /* start a new block */
+    s->nsym = 0;
+    s->xbits = 0;
+    for (i = 0; i < LCODES; i++)
+        s->lfreq[i] = 0;
+    for (i = 0; i < DCODES; i++)
+        s->dfreq[i] = 0;
+    s->block_start = (long)pos;
+}
+
+/* ===========================================================================
+ * Buffer a literal, or a match of length len at distance dist.
+ */
+local void tally_lit(struct defback9_state FAR *s, unsigned c) {
+    s->sym[s->nsym].len = (unsigned short)c;
+    s->sym[s->nsym++].dist = 0;
+    s->lfreq[c]++;
+}
+
+local void tally_match(struct defback9_state FAR *s, unsigned dist,
+                       unsigned len) {
+    unsigned xbits, xval;
+
+    s->sym[s->nsym].len = (unsigned short)(len - MINMATCH);
+    s->sym[s->nsym++].dist = (unsigned short)dist;
+    s->lfreq[len_sym(len - MINMATCH, &xbits, &xval)]++;
+    s->xbits += xbits;
+    s->dfreq[dist_sym(dist - 1, &xbits, &xval)]++;
+    s->xbits += xbits;
+}
+
+/* ===========================================================================
+ * Insert the string at pos in the hash table, and return the previous
+ * position with the same hash, or NIL.  There must be MINMATCH bytes at pos.
+ */
+local unsigned insert(struct defback9_state FAR *s, unsigned pos) {
+    const unsigned char *p = s->buf + pos;
+    unsigned h, m;
+
+    h = ((((unsigned long)p[0] << 16) | ((unsigned long)p[1] << 8) | p[2]) *
+         2654435761UL & 0xffffffffUL) >> (32 - HBITS);
+    m = s->head[h];
+    s->prev[pos & WMASK] = m;
+    s->head[h] = pos;
+    return m;
+}
+
+/* ===========================================================================
+ * Return the length of the longest match at strstart along the chain that
+ * starts at cur, and set match_start to its start, if longer than best.
+ * Otherwise return best.
+ */
+local unsigned longest(struct defback9_state FAR *s, unsigned cur,
+                       unsigned best) {
+    const unsigned char *scan = s->buf + s->strstart, *m;
+    unsigned chain = s->chain, len, nice, max;
+    unsigned limit = s->strstart > MAXDIST ? s->strstart - MAXDIST : NIL;
+
+    max = s->end - s->strstart;
+    if (max > MAXMATCH)
+        max = MAXMATCH;
+    if (best >= max)
+        return best;
+    nice = s->nice < max ? s->nice : max;
+    if (best >= s->good)
+        chain >>= 2;
+    do {
+        m = s->buf + cur;
+        if (m[best] != scan[best] || m[0] != scan[0] || m[1] != scan[1])
+            continue;
+        len = 2;
+        while (len + 8 <= max && zmemcmp(m + len, scan + len, 8) == 0)
+            len += 8;
+        while (len < max && m[len] == scan[len])
+            len++;
+        if (len > best) {
+            s->match_start = cur;
+            best = len;
+            if (len >= nice)
+                break;
+        }
+    } while ((cur = s->prev[cur & WMASK]) > limit && --chain != 0);
+    return best;
+}
+
+/* ===========================================================================
+ * Fill buf[] from the input, first sliding it down by a window if strstart
+ * has gone past two windows.  Positions in head[] and prev[] that slide out
+ * are set to NIL.
+ */
+local void fill(struct defback9_state FAR *s) {
+    unsigned n, *p;
+
+    if (s->strstart >= 2 * WSIZE) {
+        memmove(s->buf, s->buf + WSIZE, s->end - WSIZE);
+        s->strstart -= WSIZE;
+        s->end -= WSIZE;
+        s->match_start -= WSIZE;
+        s->block_start -= (long)WSIZE;
+        for (p = s->head; p < s->head + HSIZE; p++)
+            *p = *p >= WSIZE ? *p - WSIZE : NIL;
+        for (p = s->prev; p < s->prev + WSIZE; p++)
+            *p = *p >= WSIZE ? *p - WSIZE : NIL;
+    }
+    while (s->end < WBUF && !s->eof) {
+        if (s->avail == 0) {
+            s->avail = s->in(s->in_desc, &s->next);
+            if (s->avail == 0) {
+                s->eof = 1;
+                break;
+            }
+        }
+        n = WBUF - s->end < s->avail ? WBUF - s->end : s->avail;
+        zmemcpy(s->buf + s->end, s->next, n);
+        s->next += n;
+        s->avail -= n;
+        s->end += n;
+        s->strm->total_in += n;
+    }
+}
+
+/* ===========================================================================
+ * Compress taking the longest match at each position, or with level 0 only
+ * literals for stored blocks.
+ */
+local void compress_fast(struct defback9_state FAR *s) {
+    unsigned head, len, stop;
+
+    for (;;) {
+        if (s->end - s->strstart < LOOK && !s->eof)
+            fill(s);
+        if (s->strstart == s->end)
+            break;
+        len = 0;
+        if (s->level && s->end - s->strstart >= MINMATCH) {
+            head = insert(s, s->strstart);
+            if (head != NIL && head + MAXDIST >= s->strstart)
+                len = longest(s, head, MINMATCH - 1);
+        }
+        if (len >= MINMATCH) {
+            tally_match(s, s->strstart - s->match_start, len);
+            if (len <= s->lazy) {
+                stop = s->strstart + len;
+                while (++s->strstart < stop)
+                    if (s->strstart + MINMATCH <= s->end)
+                        insert(s, s->strstart);
+            }
+            else
+                s->strstart += len;
+        }
+        else
+            tally_lit(s, s->buf[s->strstart++]);
+        if (s->nsym == SYMS) {
+            flush_block(s, s->strstart, 0);
+            if (s->err)
+                return;
+        }
+    }
+    flush_block(s, s->strstart, 1);
+}
+
+/* ===========================================================================
+ * Compress with lazy matching, taking a match only if the match at the next
+ * position is not longer.
+ */
+local void compress_lazy(struct defback9_state FAR *s) {
+    unsigned head, len = MINMATCH - 1, prev_len, prev_match, stop;
+    int avail = 0;              /* true if the byte before strstart is not
+                                   yet written */
+
+    for (;;) {
+        if (s->end - s->strstart < LOOK && !s->eof)
+            fill(s);
+        if (s->strstart == s->end)
+            break;
+        prev_len = len;
+        prev_match = s->match_start;
+        len = MINMATCH - 1;
+        if (s->end - s->strstart >= MINMATCH) {
+            head = insert(s, s->strstart);
+            if (head != NIL && head + MAXDIST >= s->strstart &&
+                prev_len < s->lazy) {
+                len = longest(s, head, prev_len);
+                if (len == MINMATCH &&
+                    s->strstart - s->match_start > TOO_FAR)
+                    len = MINMATCH - 1;
+            }
+        }
+        if (prev_len >= MINMATCH && len <= prev_len) {
+            /* the match at the previous position is the better one */
+            tally_match(s, s->strstart - 1 - prev_match, prev_len);
+            stop = s->strstart - 1 + prev_len;
+            while (++s->strstart < stop)
+                if (s->strstart + MINMATCH <= s->end)
+                    insert(s, s->strstart);
+            avail = 0;
+            len = MINMATCH - 1;
+        }
+        else {
+            if (avail)
+                tally_lit(s, s->buf[s->strstart - 1]);
+            avail = 1;
+            s->strstart++;
+        }
+        if (s->nsym == SYMS) {
+            flush_block(s, s->strstart - (unsigned)avail, 0);
+            if (s->err)
+                return;
+        }
+    }
+    if (avail)
+        tally_lit(s, s->buf[s->strstart - 1]);
+    flush_block(s, s->strstart, 1);
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateBack9Init_(z_stream FAR *strm, int level,
+                              const char *version, int stream_size) {
+    struct defback9_state FAR *s;
+    unsigned i;
+
+    if (version == Z_NULL || version[0] != ZLIB_VERSION[0] ||
+        stream_size != (int)(sizeof(z_stream)))
+        return Z_VERSION_ERROR;
+    if (level == Z_DEFAULT_COMPRESSION)
+        level = 6;
+    if (strm == Z_NULL || level < 0 || level > 9)
+        return Z_STREAM_ERROR;
+    strm->msg = Z_NULL;
+    if (strm->zalloc == (alloc_func)0) {
+        strm->zalloc = zcalloc;
+        strm->opaque = (voidpf)0;
+    }
+    if (strm->zfree == (free_func)0) strm->zfree = zcfree;
+    s = (struct defback9_state FAR *)ZALLOC(strm, 1,
+                                            sizeof(struct defback9_state));
+    if (s == Z_NULL) return Z_MEM_ERROR;
+    s->strm = strm;
+    s->level = level;
+    s->good = config9[level].good;
+    s->lazy = config9[level].lazy;
+    s->nice = config9[level].nice;
+    s->chain = config9[level].chain;
+    for (i = 0; i < LCODES + 2; i++)
+        s->flen[i] = i < 144 ? 8 : i < 256 ? 9 : i < 280 ? 7 : 8;
+    huff_codes(s->flen, LCODES + 2, s->fcode);
+    for (i = 0; i < DCODES; i++)
+        s->fdlen[i] = 5;
+    huff_codes(s->fdlen, DCODES, s->fdcode);
+    strm->state = (voidpf)s;
+    return Z_OK;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateBack9(z_stream FAR *strm, in_func in, void FAR *in_desc,
+                         out_func out, void FAR *out_desc) {
+    struct defback9_state FAR *s;
+    unsigned i;
+
+    if (strm == Z_NULL || strm->state == Z_NULL || in == Z_NULL ||
+        out == Z_NULL)
+        return Z_STREAM_ERROR;
+    s = (struct defback9_state FAR *)strm->state;
+    strm->msg = Z_NULL;
+
+    /* start a new stream */
+    s->in = in;
+    s->in_desc = in_desc;
+    s->next = strm->next_in;
+    s->avail = s->next != Z_NULL ? strm->avail_in : 0;
+    s->eof = 0;
+    s->strstart = s->end = 0;
+    s->match_start = 0;
+    s->block_start = 0;
+    s->nsym = 0;
+    s->xbits = 0;
+    for (i = 0; i < LCODES; i++)
+        s->lfreq[i] = 0;
+    for (i = 0; i < DCODES; i++)
+        s->dfreq[i] = 0;
+    zmemzero((Bytef *)s->head, sizeof(s->head));
+    s->out = out;
+    s->out_desc = out_desc;
+    s->err = 0;
+    s->bits = 0;
+    s->nbits = 0;
+    s->have = 0;
+
+    if (s->level >= 4)
+        compress_lazy(s);
+    else
+        compress_fast(s);
+    flush_out(s);
+    strm->next_in = s->next;
+    strm->avail_in = s->avail;
+    if (s->err) {
+        strm->msg = (char *)"output error";
+        return Z_BUF_ERROR;
+    }
+    return Z_STREAM_END;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateBack9End(z_stream FAR *strm) {
+    if (strm == Z_NULL || strm->state == Z_NULL || strm->zfree == (free_func)0)
+        return Z_STREAM_ERROR;
+    ZFREE(strm, strm->state);
+    strm->state = Z_NULL;
+    return Z_OK;
+}
@@ -0,0 +1,58 @@
+/* defback9.h -- header for using deflateBack9 functions
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/*
+ * This header file and defback9.c provide an encoder for PKWare's deflate64
+ * compression method (method 9), the counterpart of inflateBack9().  These
+ * functions are not supported.  This should be compiled with zlib, since it
+ * uses zutil.h and zutil.o.  It needs int's of at least 32 bits.
+ *
+ * Deflate64 is deflate with a 64K window, distance codes 30 and 31 for
+ * distances of 32769 to 65536, and length code 285 redefined as lengths of 3
+ * to 65538 with 16 extra bits.  deflateBack9() finds matches up to 65535
+ * back, and of up to 65538 bytes, with the same hash chains and search
+ * parameters as deflate() for the same level.  It compresses better than
+ * deflate() on large inputs with repeats more than 32K apart or long runs,
+ * and about 5% better on large text, but takes up to twice the time at high
+ * levels, since there are twice as many earlier strings to search.  The
+ * result is raw deflate64 data with no header or trailer, as is stored in a
+ * zip entry with method 9.  Only inflateBack9(), zip tools that support method
+ * 9, and the like can decompress it.
+ *
+ * deflateBack9Init() takes the compression level, 0 to 9 or
+ * Z_DEFAULT_COMPRESSION, where 0 writes only stored blocks.  It returns Z_OK,
+ * Z_MEM_ERROR if the state of about 800K could not be allocated,
+ * Z_STREAM_ERROR for a bad level or a null strm, or Z_VERSION_ERROR.
+ *
+ * deflateBack9() compresses all of the input and writes all of the output
+ * using the in() and out() functions of inflateBack(), with the roles of in
+ * and out as they are for deflate.  strm->next_in and strm->avail_in, if
+ * next_in is not Z_NULL, are compressed before anything from in().  in()
+ * returning zero ends the input.  out() is given at most 16K at a time.
+ * deflateBack9() returns Z_STREAM_END when all of the data has been written,
+ * Z_BUF_ERROR if out() returned non-zero, or Z_STREAM_ERROR for a bad strm.
+ * total_in and total_out are updated.  deflateBack9() can be called again
+ * with the same state to compress another stream.
+ *
+ * zlib.h must be included before this header file.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+ZEXTERN int ZEXPORT deflateBack9(z_stream FAR *strm,
+                                 in_func in, void FAR *in_desc,
+                                 out_func out, void FAR *out_desc);
+ZEXTERN int ZEXPORT deflateBack9End(z_stream FAR *strm);
+ZEXTERN int ZEXPORT deflateBack9Init_(z_stream FAR *strm, int level,
+                                      const char *version,
+                                      int stream_size);
+#define deflateBack9Init(strm, level) \
+        deflateBack9Init_((strm), (level), \
+        ZLIB_VERSION, sizeof(z_stream))
+
+#ifdef __cplusplus
+}
+#endif
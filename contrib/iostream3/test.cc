@@ -7,6 +7,7 @@
 
 #include "zfstream.h"
 #include <iostream>      // for cout
+#include <vector>        // for bulk buffers
 
 int main() {
 
@@ -45,6 +46,29 @@ int main() {
   }
   inf.close();
 
+  // Bulk writes and reads bypass the stream buffer
+  std::vector<char> big(1 << 20), back(big.size());
+  for (std::size_t i = 0; i < big.size(); i++)
+    big[i] = "The quick brown fox sidestepped the lazy canine\n"[i % 48];
+  outf.rdbuf()->pubsetbuf(0,65536);
+  outf.open("test3.txt.gz");
+  outf.write(&big[0], big.size());
+  outf.close();
+  inf.rdbuf()->pubsetbuf(0,65536);
+  inf.open("test3.txt.gz");
+  inf.read(&back[0], back.size());
+  std::cout << "\nRead " << inf.gcount() << " bytes back from 'test3.txt.gz' in bulk: "
+            << (back == big ? "match" : "MISMATCH") << "\n";
+  inf.close();
+
+#if __cplusplus >= 201103L
+  // Streams can be moved, taking the open file with them
+  gzifstream first("test1.txt.gz");
+  gzifstream second(std::move(first));
+  second.getline(buf,80,'\n');
+  std::cout << "\nFirst line of 'test1.txt.gz' through a moved stream:\n" << buf << "\n";
+#endif
+
   return 0;
 
 }
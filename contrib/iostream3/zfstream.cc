@@ -8,13 +8,21 @@
  */
 
 #include "zfstream.h"
-#include <cstring>          // for strcpy, strcat, strlen (mode strings)
+#include <cstring>          // for strcpy, strcat, strlen (mode strings), memcpy
 #include <cstdio>           // for BUFSIZ
+#if __cplusplus >= 201103L
+#include <utility>          // for std::move
+#endif
 
 // Internal buffer sizes (default and "unbuffered" versions)
-#define BIGBUFSIZE BUFSIZ
+#ifndef BIGBUFSIZE
+#  define BIGBUFSIZE BUFSIZ
+#endif
 #define SMALLBUFSIZE 1
 
+// Largest length passed to gzread or gzwrite at once (they return an int)
+#define MAXCHUNK (1U << 30)
+
 /*****************************************************************************/
 
 // Default constructor
@@ -38,6 +46,53 @@ gzfilebuf::~gzfilebuf()
   this->disable_buffer();
 }
 
+#if __cplusplus >= 201103L
+// Move constructor takes over file and buffer, leaving other closed
+gzfilebuf::gzfilebuf(gzfilebuf&& other)
+: std::streambuf(other), file(other.file), io_mode(other.io_mode),
+  own_fd(other.own_fd), buffer(other.buffer),
+  buffer_size(other.buffer_size), own_buffer(other.own_buffer)
+{
+  other.file = NULL;
+  other.own_fd = false;
+  other.buffer = NULL;
+  other.buffer_size = BIGBUFSIZE;
+  other.own_buffer = true;
+  other.setg(0, 0, 0);
+  other.setp(0, 0);
+}
+
+// Move assignment releases own file and buffer, then takes over other's
+gzfilebuf&
+gzfilebuf::operator=(gzfilebuf&& other)
+{
+  if (this != &other)
+  {
+    // Same cleanup as the destructor
+    this->sync();
+    if (own_fd)
+      this->close();
+    this->disable_buffer();
+    // Take over the buffer pointers, file and buffer
+    std::streambuf::operator=(other);
+    file = other.file;
+    io_mode = other.io_mode;
+    own_fd = other.own_fd;
+    buffer = other.buffer;
+    buffer_size = other.buffer_size;
+    own_buffer = other.own_buffer;
+    other.file = NULL;
+    other.own_fd = false;
+    other.buffer = NULL;
+    other.buffer_size = BIGBUFSIZE;
+    other.own_buffer = true;
+    other.setg(0, 0, 0);
+    other.setp(0, 0);
+  }
+  return *this;
+}
+#endif
+
 // Set compression level and strategy
 int
 gzfilebuf::setcompression(int comp_level,
@@ -261,6 +316,64 @@ gzfilebuf::overflow(int_type c)
     return c;
 }
 
+// Read characters, large requests straight from gzipped file
+std::streamsize
+gzfilebuf::xsgetn(char_type* s,
+                  std::streamsize n)
+{
+  // Small reads (and reads that will fail) go through the get area
+  if (n < buffer_size || !this->is_open() || !(io_mode & std::ios_base::in))
+    return std::streambuf::xsgetn(s, n);
+
+  // Hand over what is left in the get area (never more than n here)
+  std::streamsize bytes_read = 0;
+  if (this->gptr() && (this->gptr() < this->egptr()))
+  {
+    bytes_read = this->egptr() - this->gptr();
+    memcpy(s, this->gptr(), bytes_read);
+    this->setg(buffer, buffer, buffer);
+  }
+
+  // Read the rest from gzipped file, bypassing the get area
+  while (bytes_read < n)
+  {
+    std::streamsize left = n - bytes_read;
+    unsigned len = left > MAXCHUNK ? MAXCHUNK : unsigned(left);
+    int got = gzread(file, s + bytes_read, len);
+    // Indicates error or EOF
+    if (got <= 0)
+      break;
+    bytes_read += got;
+  }
+  return bytes_read;
+}
+
+// Write characters, large requests straight to gzipped file
+std::streamsize
+gzfilebuf::xsputn(const char_type* s,
+                  std::streamsize n)
+{
+  // Small writes (and writes that will fail) go through the put area
+  if (n < buffer_size || !this->is_open() || !(io_mode & std::ios_base::out))
+    return std::streambuf::xsputn(s, n);
+
+  // Put area goes out first to keep the characters in order
+  if (this->sync() == -1)
+    return 0;
+
+  // Write all of s to gzipped file, bypassing the put area
+  std::streamsize bytes_written = 0;
+  while (bytes_written < n)
+  {
+    std::streamsize left = n - bytes_written;
+    unsigned len = left > MAXCHUNK ? MAXCHUNK : unsigned(left);
+    if (gzwrite(file, s + bytes_written, len) != int(len))
+      break;
+    bytes_written += len;
+  }
+  return bytes_written;
+}
+
 // Assign new buffer
 std::streambuf*
 gzfilebuf::setbuf(char_type* p,
@@ -275,10 +388,11 @@ gzfilebuf::setbuf(char_type* p,
   // This follows from [27.5.2.4.3]/12 (gptr needs to point at something, it seems)
   if (!p || !n)
   {
-    // Replace existing buffer (if any) with small internal buffer
+    // Replace existing buffer (if any) with internal buffer of size n,
+    // which is the small "unbuffered" one if n is 0
     this->disable_buffer();
     buffer = NULL;
-    buffer_size = 0;
+    buffer_size = (p || n < 0) ? 0 : n;
     own_buffer = true;
     this->enable_buffer();
   }
@@ -393,6 +507,22 @@ gzifstream::gzifstream(int fd,
   this->attach(fd, mode);
 }
 
+#if __cplusplus >= 201103L
+// Move constructor takes over state and stream buffer
+gzifstream::gzifstream(gzifstream&& other)
+: std::istream(std::move(other)), sb(std::move(other.sb))
+{ this->set_rdbuf(&sb); }
+
+// Move assignment takes over state and stream buffer
+gzifstream&
+gzifstream::operator=(gzifstream&& other)
+{
+  std::istream::operator=(std::move(other));
+  sb = std::move(other.sb);
+  return *this;
+}
+#endif
+
 // Open file and go into fail() state if unsuccessful
 void
 gzifstream::open(const char* name,
@@ -448,6 +578,22 @@ gzofstream::gzofstream(int fd,
   this->attach(fd, mode);
 }
 
+#if __cplusplus >= 201103L
+// Move constructor takes over state and stream buffer
+gzofstream::gzofstream(gzofstream&& other)
+: std::ostream(std::move(other)), sb(std::move(other.sb))
+{ this->set_rdbuf(&sb); }
+
+// Move assignment takes over state and stream buffer
+gzofstream&
+gzofstream::operator=(gzofstream&& other)
+{
+  std::ostream::operator=(std::move(other));
+  sb = std::move(other.sb);
+  return *this;
+}
+#endif
+
 // Open file and go into fail() state if unsuccessful
 void
 gzofstream::open(const char* name,
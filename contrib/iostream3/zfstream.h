@@ -34,6 +34,26 @@ public:
   virtual
   ~gzfilebuf();
 
+#if __cplusplus >= 201103L
+  /**
+   *  @brief  Move constructor.
+   *  @param  other  Stream buffer to take the file and buffer from.
+   *
+   *  The moved-from buffer is left closed, with no buffer.
+  */
+  gzfilebuf(gzfilebuf&& other);
+
+  /**
+   *  @brief  Move assignment.
+   *  @param  other  Stream buffer to take the file and buffer from.
+   *  @return  *this.
+   *
+   *  Any file open on this buffer is closed first, as by the destructor.
+  */
+  gzfilebuf&
+  operator=(gzfilebuf&& other);
+#endif
+
   /**
    *  @brief  Set compression level and strategy on the fly.
    *  @param  comp_level  Compression level (see zlib.h for allowed values)
@@ -124,13 +144,42 @@ protected:
   virtual int_type
   overflow(int_type c = traits_type::eof());
 
+  /**
+   *  @brief  Read characters from gzipped file.
+   *  @param  s  Where to put the characters.
+   *  @param  n  Number of characters wanted.
+   *  @return  Number of characters read.
+   *
+   *  Reads of at least a buffer's worth go straight from the gzipped
+   *  file into s, after what is left in the get area. Smaller reads go
+   *  through the get area.
+  */
+  virtual std::streamsize
+  xsgetn(char_type* s,
+         std::streamsize n);
+
+  /**
+   *  @brief  Write characters to gzipped file.
+   *  @param  s  Characters to write.
+   *  @param  n  Number of characters.
+   *  @return  Number of characters written.
+   *
+   *  Writes of at least a buffer's worth flush the put area and then go
+   *  straight from s to the gzipped file. Smaller writes go through the
+   *  put area.
+  */
+  virtual std::streamsize
+  xsputn(const char_type* s,
+         std::streamsize n);
+
   /**
    *  @brief  Installs external stream buffer.
    *  @param  p  Pointer to char buffer.
    *  @param  n  Size of external buffer.
    *  @return  @c this on success, NULL on failure.
    *
-   *  Call setbuf(0,0) to enable unbuffered output.
+   *  Call setbuf(0,0) to enable unbuffered output, or setbuf(0,n) to
+   *  use an internal buffer of n characters.
   */
   virtual std::streambuf*
   setbuf(char_type* p,
@@ -209,8 +258,8 @@ private:
   /**
    *  @brief  Stream buffer size.
    *
-   *  Defaults to system default buffer size (typically 8192 bytes).
-   *  Modified by setbuf.
+   *  Defaults to system default buffer size (typically 8192 bytes),
+   *  unless BIGBUFSIZE is defined. Modified by setbuf.
   */
   std::streamsize buffer_size;
 
@@ -255,6 +304,24 @@ public:
   gzifstream(int fd,
              std::ios_base::openmode mode = std::ios_base::in);
 
+#if __cplusplus >= 201103L
+  /**
+   *  @brief  Move constructor.
+   *  @param  other  Stream to take the state and gzipped file from.
+  */
+  gzifstream(gzifstream&& other);
+
+  /**
+   *  @brief  Move assignment.
+   *  @param  other  Stream to take the state and gzipped file from.
+   *  @return  *this.
+   *
+   *  Any file open on this stream is closed first.
+  */
+  gzifstream&
+  operator=(gzifstream&& other);
+#endif
+
   /**
    *  Obtain underlying stream buffer.
   */
@@ -344,6 +411,24 @@ public:
   gzofstream(int fd,
              std::ios_base::openmode mode = std::ios_base::out);
 
+#if __cplusplus >= 201103L
+  /**
+   *  @brief  Move constructor.
+   *  @param  other  Stream to take the state and gzipped file from.
+  */
+  gzofstream(gzofstream&& other);
+
+  /**
+   *  @brief  Move assignment.
+   *  @param  other  Stream to take the state and gzipped file from.
+   *  @return  *this.
+   *
+   *  Any file open on this stream is closed first.
+  */
+  gzofstream&
+  operator=(gzofstream&& other);
+#endif
+
   /**
    *  Obtain underlying stream buffer.
   */
@@ -28,6 +28,17 @@
 
 #include "ioapi.h"
 
+/* memory-mapped reading, if mmap() is available -- define NO_MMAP to use
+   stdio instead with fill_mmap64_filefunc() */
+#if !defined(NO_MMAP) && !defined(_WIN32)
+#  define IOAPI_MMAP
+#  include <string.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif
+
 voidpf call_zopen64 (const zlib_filefunc64_32_def* pfilefunc, const void*filename, int mode) {
     if (pfilefunc->zfile_func64.zopen64_file != NULL)
         return (*(pfilefunc->zfile_func64.zopen64_file)) (pfilefunc->zfile_func64.opaque,filename,mode);
@@ -219,6 +230,173 @@ void fill_fopen_filefunc(zlib_filefunc_def* pzlib_filefunc_def) {
     pzlib_filefunc_def->opaque = NULL;
 }
 
+#ifdef IOAPI_MMAP
+/* a file opened by mmap64_file_func(), mapped whole */
+typedef struct
+{
+    unsigned char* base;        /* start of the mapping, NULL if empty */
+    ZPOS64_T size;              /* length of the file */
+    ZPOS64_T pos;               /* current position in the file */
+    int owner;                  /* true if closing this unmaps the file */
+} mmap_stream;
+
+static voidpf ZCALLBACK mmap64_file_func(voidpf opaque, const void* filename, int mode) {
+    int fd;
+    struct stat st;
+    void* base = NULL;
+    mmap_stream* stream;
+    (void)opaque;
+
+    /* the mapping is read-only */
+    if (filename == NULL ||
+        (mode & ZLIB_FILEFUNC_MODE_READWRITEFILTER) != ZLIB_FILEFUNC_MODE_READ)
+        return NULL;
+    fd = open((const char*)filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || (ZPOS64_T)(size_t)st.st_size != (ZPOS64_T)st.st_size)
+    {
+        close(fd);
+        return NULL;
+    }
+    if (st.st_size)
+    {
+        base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (base == MAP_FAILED)
+        {
+            close(fd);
+            return NULL;
+        }
+    }
+    close(fd);
+    stream = (mmap_stream*)malloc(sizeof(mmap_stream));
+    if (stream == NULL)
+    {
+        if (base != NULL)
+            munmap(base, (size_t)st.st_size);
+        return NULL;
+    }
+    stream->base = (unsigned char*)base;
+    stream->size = (ZPOS64_T)st.st_size;
+    stream->pos = 0;
+    stream->owner = 1;
+    return stream;
+}
+
+static uLong ZCALLBACK mmap_read_file_func(voidpf opaque, voidpf stream, void* buf, uLong size) {
+    mmap_stream* map = (mmap_stream*)stream;
+    (void)opaque;
+    if (map->pos >= map->size)
+        return 0;
+    if (size > map->size - map->pos)
+        size = (uLong)(map->size - map->pos);
+    memcpy(buf, map->base + map->pos, (size_t)size);
+    map->pos += size;
+    return size;
+}
+
+static uLong ZCALLBACK mmap_write_file_func(voidpf opaque, voidpf stream, const void* buf, uLong size) {
+    (void)opaque;
+    (void)stream;
+    (void)buf;
+    (void)size;
+    return 0;
+}
+
+static ZPOS64_T ZCALLBACK mmap_tell64_file_func(voidpf opaque, voidpf stream) {
+    (void)opaque;
+    return ((mmap_stream*)stream)->pos;
+}
+
+static long ZCALLBACK mmap_seek64_file_func(voidpf opaque, voidpf stream, ZPOS64_T offset, int origin) {
+    mmap_stream* map = (mmap_stream*)stream;
+    ZPOS64_T from;
+    (void)opaque;
+    switch (origin)
+    {
+    case ZLIB_FILEFUNC_SEEK_CUR :
+        from = map->pos;
+        break;
+    case ZLIB_FILEFUNC_SEEK_END :
+        from = map->size;
+        break;
+    case ZLIB_FILEFUNC_SEEK_SET :
+        from = 0;
+        break;
+    default: return -1;
+    }
+    if (offset > map->size - from)
+        return -1;
+    map->pos = from + offset;
+    return 0;
+}
+
+static int ZCALLBACK mmap_close_file_func(voidpf opaque, voidpf stream) {
+    mmap_stream* map = (mmap_stream*)stream;
+    int ret = 0;
+    (void)opaque;
+    if (map->owner && map->base != NULL)
+        ret = munmap(map->base, (size_t)map->size);
+    free(map);
+    return ret;
+}
+
+static int ZCALLBACK mmap_error_file_func(voidpf opaque, voidpf stream) {
+    (void)opaque;
+    (void)stream;
+    return 0;
+}
+#endif
+
+const void* call_zmap64(const zlib_filefunc64_32_def* pfilefunc, voidpf filestream, ZPOS64_T offset, ZPOS64_T size) {
+#ifdef IOAPI_MMAP
+    const mmap_stream* map = (const mmap_stream*)filestream;
+    if (pfilefunc->zfile_func64.zread_file == mmap_read_file_func &&
+        offset <= map->size && size <= map->size - offset)
+        return map->base == NULL ? (const void*)"" : map->base + offset;
+#else
+    (void)pfilefunc;
+    (void)filestream;
+    (void)offset;
+    (void)size;
+#endif
+    return NULL;
+}
+
+voidpf call_zshare64(const zlib_filefunc64_32_def* pfilefunc, voidpf filestream) {
+#ifdef IOAPI_MMAP
+    if (pfilefunc->zfile_func64.zread_file == mmap_read_file_func)
+    {
+        mmap_stream* view = (mmap_stream*)malloc(sizeof(mmap_stream));
+        if (view != NULL)
+        {
+            *view = *(mmap_stream*)filestream;
+            view->owner = 0;
+        }
+        return view;
+    }
+#else
+    (void)pfilefunc;
+    (void)filestream;
+#endif
+    return NULL;
+}
+
+void fill_mmap64_filefunc(zlib_filefunc64_def* pzlib_filefunc_def) {
+#ifdef IOAPI_MMAP
+    pzlib_filefunc_def->zopen64_file = mmap64_file_func;
+    pzlib_filefunc_def->zread_file = mmap_read_file_func;
+    pzlib_filefunc_def->zwrite_file = mmap_write_file_func;
+    pzlib_filefunc_def->ztell64_file = mmap_tell64_file_func;
+    pzlib_filefunc_def->zseek64_file = mmap_seek64_file_func;
+    pzlib_filefunc_def->zclose_file = mmap_close_file_func;
+    pzlib_filefunc_def->zerror_file = mmap_error_file_func;
+    pzlib_filefunc_def->opaque = NULL;
+#else
+    fill_fopen64_filefunc(pzlib_filefunc_def);
+#endif
+}
+
 void fill_fopen64_filefunc(zlib_filefunc64_def* pzlib_filefunc_def) {
     pzlib_filefunc_def->zopen64_file = fopen64_file_func;
     pzlib_filefunc_def->zread_file = fread_file_func;
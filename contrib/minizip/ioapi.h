@@ -176,6 +176,13 @@ typedef struct zlib_filefunc64_def_s
 void fill_fopen64_filefunc(zlib_filefunc64_def* pzlib_filefunc_def);
 void fill_fopen_filefunc(zlib_filefunc_def* pzlib_filefunc_def);
 
+/* Read-only functions that map the whole file into memory, so that reads are
+   copies from the mapping and stored entries can be used in place with
+   unzGetCurrentFileMapped(), and so that unzOpenReader() can give each thread
+   its own position in one mapping.  Where mmap() is not available, or if compiled
+   with NO_MMAP, this fills in the fopen64 functions instead. */
+void fill_mmap64_filefunc(zlib_filefunc64_def* pzlib_filefunc_def);
+
 /* now internal definition, only for zip.c and unzip.h */
 typedef struct zlib_filefunc64_32_def_s
 {
@@ -196,6 +203,8 @@ typedef struct zlib_filefunc64_32_def_s
 voidpf call_zopen64(const zlib_filefunc64_32_def* pfilefunc,const void*filename,int mode);
 long call_zseek64(const zlib_filefunc64_32_def* pfilefunc,voidpf filestream, ZPOS64_T offset, int origin);
 ZPOS64_T call_ztell64(const zlib_filefunc64_32_def* pfilefunc,voidpf filestream);
+const void* call_zmap64(const zlib_filefunc64_32_def* pfilefunc,voidpf filestream, ZPOS64_T offset, ZPOS64_T size);
+voidpf call_zshare64(const zlib_filefunc64_32_def* pfilefunc,voidpf filestream);
 
 void fill_zlib_filefunc64_32_def_from_filefunc32(zlib_filefunc64_32_def* p_filefunc64_32,const zlib_filefunc_def* p_filefunc32);
 
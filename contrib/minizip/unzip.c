@@ -151,6 +151,25 @@ typedef struct
 } file_in_zip64_read_info_s;
 
 
+/* unz64_name_index is a hash table of the names in the central directory,
+   built by unzBuildNameIndex() for unzLocateFile() */
+typedef struct
+{
+    ZPOS64_T num_file;            /* number of the file in the zipfile */
+    ZPOS64_T pos_in_central_dir;  /* pos of the file in the central dir */
+    size_t name;                  /* offset of its name in names */
+    uLong hash;                   /* hash of the name with letters folded */
+} unz64_name_entry;
+
+typedef struct
+{
+    unz64_name_entry* entry;      /* the files, in central directory order */
+    char* names;                  /* their null-terminated names */
+    size_t* slot;                 /* 1 + index in entry, or 0 if empty */
+    size_t mask;                  /* number of slots less one */
+} unz64_name_index;
+
+
 /* unz64_s contain internal information about the zipfile
 */
 typedef struct
@@ -177,6 +196,10 @@ typedef struct
 
     int isZip64;
 
+    unz64_name_index* name_index;  /* hashed names, or NULL if not built */
+    int shared_index;              /* true if name_index belongs to the
+                                      unzFile this reader was opened from */
+
 #    ifndef NOUNCRYPT
     unsigned long keys[3];     /* keys defining the pseudo-random sequence */
     const z_crc_t* pcrc_32_tab;
@@ -285,6 +308,9 @@ local int strcmpcasenosensitive_internal(const char* fileName1, const char* file
 
 #ifndef STRCMPCASENOSENTIVEFUNCTION
 #define STRCMPCASENOSENTIVEFUNCTION strcmpcasenosensitive_internal
+#define INDEXCASENOSENSITIVE 1 /* the name index hash folds the same way */
+#else
+#define INDEXCASENOSENSITIVE 0
 #endif
 
 /*
@@ -653,6 +679,8 @@ local unzFile unzOpenInternal(const void *path,
     us.central_pos = central_pos;
     us.pfile_in_zip_read = NULL;
     us.encrypted = 0;
+    us.name_index = NULL;
+    us.shared_index = 0;
 
 
     s=(unz64_s*)ALLOC(sizeof(unz64_s));
@@ -699,6 +727,16 @@ extern unzFile ZEXPORT unzOpen64(const void *path) {
     return unzOpenInternal(path, NULL, 1);
 }
 
+local void unz64local_FreeNameIndex(unz64_name_index* index) {
+    if (index != NULL)
+    {
+        free(index->entry);
+        free(index->names);
+        free(index->slot);
+        free(index);
+    }
+}
+
 /*
   Close a ZipFile opened with unzOpen.
   If there is files inside the .Zip opened with unzOpenCurrentFile (see later),
@@ -713,12 +751,42 @@ extern int ZEXPORT unzClose(unzFile file) {
     if (s->pfile_in_zip_read!=NULL)
         unzCloseCurrentFile(file);
 
+    if (!s->shared_index)
+        unz64local_FreeNameIndex(s->name_index);
     ZCLOSE64(s->z_filefunc, s->filestream);
     free(s);
     return UNZ_OK;
 }
 
 
+/*
+  Open another handle on a zipfile opened with fill_mmap64_filefunc(), with
+    its own current file and position, sharing the mapping and any name index.
+  return NULL if the zipfile is not mapped or if out of memory. */
+extern unzFile ZEXPORT unzOpenReader(unzFile file) {
+    unz64_s* s;
+    unz64_s* reader;
+    if (file==NULL)
+        return NULL;
+    s=(unz64_s*)file;
+
+    reader=(unz64_s*)ALLOC(sizeof(unz64_s));
+    if (reader==NULL)
+        return NULL;
+    *reader=*s;
+    reader->filestream=call_zshare64(&s->z_filefunc, s->filestream);
+    if (reader->filestream==NULL)
+    {
+        free(reader);
+        return NULL;
+    }
+    reader->pfile_in_zip_read=NULL;
+    reader->encrypted=0;
+    reader->shared_index=1;
+    return (unzFile)reader;
+}
+
+
 /*
   Write info about the ZipFile in the *pglobal_info structure.
   No preparation of the structure is needed
@@ -1098,6 +1166,130 @@ extern int ZEXPORT unzGoToNextFile(unzFile file) {
 }
 
 
+/* Hash a file name, folding letters as strcmpcasenosensitive_internal() does,
+   so that names equal under either comparison have the same hash. */
+local uLong unz64local_HashName(const char* name) {
+    uLong hash = 2166136261UL;
+    for (; *name; name++)
+    {
+        char c = *name;
+        if ((c>='a') && (c<='z'))
+            c -= 0x20;
+        hash = ((hash ^ (unsigned char)c) * 16777619UL) & 0xffffffffUL;
+    }
+    return hash;
+}
+
+/*
+  Build the hash index of the file names by reading the central directory
+    once, replacing any previous index.
+*/
+extern int ZEXPORT unzBuildNameIndex(unzFile file) {
+    unz64_s* s;
+    unz64_name_index* index;
+    unsigned char* dir;
+    ZPOS64_T count, max, at, i;
+    size_t size, used, k;
+    int err = UNZ_OK;
+
+    if (file==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz64_s*)file;
+
+    /* read the whole central directory */
+    size = (size_t)s->size_central_dir;
+    if ((ZPOS64_T)size != s->size_central_dir || size + 1 == 0)
+        return UNZ_INTERNALERROR;
+    dir = (unsigned char*)ALLOC(size + 1);
+    if (dir == NULL)
+        return UNZ_INTERNALERROR;
+    if (ZSEEK64(s->z_filefunc, s->filestream,
+                s->offset_central_dir + s->byte_before_the_zipfile,
+                ZLIB_FILEFUNC_SEEK_SET) != 0 ||
+        ZREAD64(s->z_filefunc, s->filestream, dir, (uLong)size) != size)
+    {
+        free(dir);
+        return UNZ_ERRNO;
+    }
+
+    /* list the entries, the names copied after each other from the directory
+       and null-terminated (the names together with their terminators fit in
+       the directory, since each entry there is at least 46 bytes more) */
+    max = size / SIZECENTRALDIRITEM;
+    if (s->gi.number_entry != 0xffff && s->gi.number_entry < max)
+        max = s->gi.number_entry;   /* 2^16 files overflow hack, as above */
+    index = (unz64_name_index*)ALLOC(sizeof(unz64_name_index));
+    if (index == NULL)
+    {
+        free(dir);
+        return UNZ_INTERNALERROR;
+    }
+    index->entry = (unz64_name_entry*)ALLOC((size_t)(max ? max : 1) * sizeof(unz64_name_entry));
+    index->names = (char*)ALLOC(size + 1);
+    index->slot = NULL;
+    if (index->entry == NULL || index->names == NULL)
+        err = UNZ_INTERNALERROR;
+    count = 0;
+    at = 0;
+    used = 0;
+    while (err == UNZ_OK && count < max && size - at >= SIZECENTRALDIRITEM)
+    {
+        const unsigned char* p = dir + at;
+        uLong size_name = p[28] + ((uLong)p[29] << 8);
+        uLong size_rest = p[30] + ((uLong)p[31] << 8) + p[32] + ((uLong)p[33] << 8);
+        if (p[0] != 0x50 || p[1] != 0x4b || p[2] != 0x01 || p[3] != 0x02 ||
+            size - at - SIZECENTRALDIRITEM < size_name + size_rest)
+        {
+            err = UNZ_BADZIPFILE;
+            break;
+        }
+        index->entry[count].num_file = count;
+        index->entry[count].pos_in_central_dir = s->offset_central_dir + at;
+        index->entry[count].name = used;
+        memcpy(index->names + used, p + SIZECENTRALDIRITEM, size_name);
+        index->names[used + size_name] = '\0';
+        index->entry[count].hash = unz64local_HashName(index->names + used);
+        used += size_name + 1;
+        at += SIZECENTRALDIRITEM + size_name + size_rest;
+        count++;
+    }
+    free(dir);
+    if (err == UNZ_OK && s->gi.number_entry != 0xffff && count != s->gi.number_entry)
+        err = UNZ_BADZIPFILE;
+
+    /* hash the entries into a table at most half full, in order, so that of
+       equal names the first in the directory is found first */
+    if (err == UNZ_OK)
+    {
+        for (k = 2; k < 2 * count && k << 1 > k; k <<= 1)
+            ;
+        if (k < 2 * count ||
+            (index->slot = (size_t*)calloc(k, sizeof(size_t))) == NULL)
+            err = UNZ_INTERNALERROR;
+        else
+        {
+            index->mask = k - 1;
+            for (i = 0; i < count; i++)
+            {
+                k = (size_t)index->entry[i].hash & index->mask;
+                while (index->slot[k])
+                    k = (k + 1) & index->mask;
+                index->slot[k] = (size_t)i + 1;
+            }
+        }
+    }
+    if (err != UNZ_OK)
+    {
+        unz64local_FreeNameIndex(index);
+        return err;
+    }
+    if (!s->shared_index)
+        unz64local_FreeNameIndex(s->name_index);
+    s->name_index = index;
+    s->shared_index = 0;
+    return UNZ_OK;
+}
+
 /*
   Try locate the file szFileName in the zipfile.
   For the iCaseSensitivity signification, see unzStringFileNameCompare
@@ -1129,6 +1321,37 @@ extern int ZEXPORT unzLocateFile(unzFile file, const char *szFileName, int iCase
     if (!s->current_file_ok)
         return UNZ_END_OF_LIST_OF_FILE;
 
+    /* Look up the name in the index if there is one.  The hash folds letters
+       as the default case-insensitive comparison does, so a replacement
+       comparison could match names with other hashes -- in that case look
+       through the directory for case-insensitive lookups instead. */
+    if (s->name_index != NULL &&
+        (iCaseSensitivity == 1 ||
+         (iCaseSensitivity == 0 && CASESENSITIVITYDEFAULTVALUE == 1) ||
+         INDEXCASENOSENSITIVE))
+    {
+        const unz64_name_index* index = s->name_index;
+        uLong hash = unz64local_HashName(szFileName);
+        size_t k = (size_t)hash & index->mask;
+        for (; index->slot[k]; k = (k + 1) & index->mask)
+        {
+            const unz64_name_entry* entry = index->entry + index->slot[k] - 1;
+            if (entry->hash == hash &&
+                unzStringFileNameCompare(index->names + entry->name,
+                                         szFileName, iCaseSensitivity) == 0)
+            {
+                s->num_file = entry->num_file;
+                s->pos_in_central_dir = entry->pos_in_central_dir;
+                err = unz64local_GetCurrentFileInfoInternal(file, &s->cur_file_info,
+                                                           &s->cur_file_info_internal,
+                                                           NULL,0,NULL,0,NULL,0);
+                s->current_file_ok = (err == UNZ_OK);
+                return err;
+            }
+        }
+        return UNZ_END_OF_LIST_OF_FILE;
+    }
+
     /* Save the current state */
     num_fileSaved = s->num_file;
     pos_in_central_dirSaved = s->pos_in_central_dir;
@@ -1293,6 +1516,7 @@ local int unz64local_CheckCurrentFileCoherencyHeader(unz64_s* s, uInt* piSizeVar
 /* #ifdef HAVE_BZIP2 */
                          (s->cur_file_info.compression_method!=Z_BZIP2ED) &&
 /* #endif */
+                         (s->cur_file_info.compression_method!=Z_DEFLATE64ED) &&
                          (s->cur_file_info.compression_method!=Z_DEFLATED))
         err=UNZ_BADZIPFILE;
 
@@ -1399,6 +1623,7 @@ extern int ZEXPORT unzOpenCurrentFile3(unzFile file, int* method,
 /* #ifdef HAVE_BZIP2 */
         (s->cur_file_info.compression_method!=Z_BZIP2ED) &&
 /* #endif */
+        (s->cur_file_info.compression_method!=Z_DEFLATE64ED) &&
         (s->cur_file_info.compression_method!=Z_DEFLATED))
 
         err=UNZ_BADZIPFILE;
@@ -1440,7 +1665,8 @@ extern int ZEXPORT unzOpenCurrentFile3(unzFile file, int* method,
       pfile_in_zip_read_info->raw=1;
 #endif
     }
-    else if ((s->cur_file_info.compression_method==Z_DEFLATED) && (!raw))
+    else if ((s->cur_file_info.compression_method==Z_DEFLATED ||
+              s->cur_file_info.compression_method==Z_DEFLATE64ED) && (!raw))
     {
       pfile_in_zip_read_info->stream.zalloc = (alloc_func)0;
       pfile_in_zip_read_info->stream.zfree = (free_func)0;
@@ -1448,7 +1674,9 @@ extern int ZEXPORT unzOpenCurrentFile3(unzFile file, int* method,
       pfile_in_zip_read_info->stream.next_in = 0;
       pfile_in_zip_read_info->stream.avail_in = 0;
 
-      err=inflateInit2(&pfile_in_zip_read_info->stream, -MAX_WBITS);
+      err=inflateInit2(&pfile_in_zip_read_info->stream,
+                       s->cur_file_info.compression_method==Z_DEFLATE64ED ?
+                       -16 : -MAX_WBITS);
       if (err == Z_OK)
         pfile_in_zip_read_info->stream_initialised=Z_DEFLATED;
       else
@@ -1535,6 +1763,42 @@ extern ZPOS64_T ZEXPORT unzGetCurrentFileZStreamPos64(unzFile file) {
 
 /** Addition for GDAL : END */
 
+/*
+  Get the data of the current file in place, if it is stored (method 0),
+    not encrypted, and the zipfile was opened with fill_mmap64_filefunc().
+*/
+extern int ZEXPORT unzGetCurrentFileMapped(unzFile file, const void** pbuf, ZPOS64_T* plen) {
+    unz64_s* s;
+    uInt iSizeVar;
+    ZPOS64_T offset_local_extrafield;
+    uInt size_local_extrafield;
+    const void* data;
+
+    if (file==NULL || pbuf==NULL || plen==NULL)
+        return UNZ_PARAMERROR;
+    s=(unz64_s*)file;
+    *pbuf = NULL;
+    *plen = 0;
+    if (!s->current_file_ok)
+        return UNZ_PARAMERROR;
+    if (s->cur_file_info.compression_method != 0 ||
+        (s->cur_file_info.flag & 1) != 0 ||
+        s->cur_file_info.compressed_size != s->cur_file_info.uncompressed_size)
+        return UNZ_PARAMERROR;
+
+    if (unz64local_CheckCurrentFileCoherencyHeader(s,&iSizeVar, &offset_local_extrafield,&size_local_extrafield)!=UNZ_OK)
+        return UNZ_BADZIPFILE;
+    data = call_zmap64(&s->z_filefunc, s->filestream,
+                       s->cur_file_info_internal.offset_curfile + SIZEZIPLOCALHEADER +
+                       iSizeVar + s->byte_before_the_zipfile,
+                       s->cur_file_info.compressed_size);
+    if (data == NULL)
+        return UNZ_PARAMERROR;
+    *pbuf = data;
+    *plen = s->cur_file_info.compressed_size;
+    return UNZ_OK;
+}
+
 /*
   Read bytes from the current file.
   buf contain buffer where data must be copied
@@ -60,6 +60,7 @@ extern "C" {
 #endif
 
 #define Z_BZIP2ED 12
+#define Z_DEFLATE64ED 9
 
 #if defined(STRICTUNZIP) || defined(STRICTZIPUNZIP)
 /* like the STRICT of WIN32, we define a pointer that cannot be converted
@@ -202,6 +203,19 @@ extern int ZEXPORT unzClose(unzFile file);
     these files MUST be closed with unzCloseCurrentFile before call unzClose.
   return UNZ_OK if there is no problem. */
 
+extern unzFile ZEXPORT unzOpenReader(unzFile file);
+/*
+  Open a reader on a zipfile opened with unzOpen2_64() using functions from
+    fill_mmap64_filefunc().  The reader is an unzFile with its own current
+    file and its own file opened with unzOpenCurrentFile(), which shares the
+    mapping, the central directory information and the index from
+    unzBuildNameIndex() with file.  Each thread can use its own reader at the
+    same time as other threads use theirs, with no locking.  file itself
+    should then be used only to open readers.  Build the index, if wanted,
+    before opening the readers.
+  Close a reader with unzClose(), before file is closed.
+  return NULL if file is not mapped, or if there is not enough memory. */
+
 extern int ZEXPORT unzGetGlobalInfo(unzFile file,
                                     unz_global_info *pglobal_info);
 
@@ -251,6 +265,24 @@ extern int ZEXPORT unzLocateFile(unzFile file,
   UNZ_END_OF_LIST_OF_FILE if the file is not found
 */
 
+extern int ZEXPORT unzBuildNameIndex(unzFile file);
+/*
+  Read the central directory once and build a hash table of the file names
+    in memory, after which unzLocateFile() finds a name in constant time
+    instead of reading through the central directory, for both
+    case-sensitive and case-insensitive lookups.  The first of several files
+    with the same name is found, as without the index.  Call this right after
+    unzOpen() for archives that will have many names looked up.  The index is
+    freed by unzClose().
+
+  return value :
+  UNZ_OK if the index was built
+  UNZ_ERRNO if the central directory could not be read
+  UNZ_BADZIPFILE if the central directory is not as expected
+  UNZ_INTERNALERROR if there was not enough memory
+  On an error, unzLocateFile() continues to work without an index.
+*/
+
 
 /* ****************************************** */
 /* Ryan supplied functions */
@@ -326,6 +358,23 @@ extern ZPOS64_T ZEXPORT unzGetCurrentFileZStreamPos64(unzFile file);
 
 /** Addition for GDAL : END */
 
+extern int ZEXPORT unzGetCurrentFileMapped(unzFile file,
+                                           const void** pbuf,
+                                           ZPOS64_T* plen);
+/*
+  Get a pointer to the data of the current file in the zipfile, without
+    copying or opening it, when the file is stored (method 0) and not
+    encrypted, and the zipfile was opened with unzOpen2_64() using functions
+    from fill_mmap64_filefunc().  *pbuf is set to the data and *plen to its
+    length.  The pointer remains valid until unzClose().  The crc-32 of the
+    data is not checked -- compare crc32() of the data with the crc in
+    unz_file_info64 if needed.
+  return UNZ_OK on success, UNZ_BADZIPFILE if the local header is invalid, or
+    UNZ_PARAMERROR if the file is not stored, is encrypted, or the zipfile is
+    not mapped, in which case use unzOpenCurrentFile() and
+    unzReadCurrentFile() as usual.
+*/
+
 
 /***************************************************************************/
 /* for reading the content of the current zipfile, you can open it, read data
@@ -38,6 +38,12 @@
 #else
 #   include <errno.h>
 #endif
+#if defined(_WIN32) && !defined(NO_THREADS)
+#  define NO_THREADS
+#endif
+#ifndef NO_THREADS
+#  include <pthread.h>
+#endif
 
 
 #ifndef local
@@ -101,6 +107,7 @@ const char zip_copyright[] =" zip 1.01 Copyright 1998-2004 Gilles Vollant - http
 #define ENDHEADERMAGIC      (0x06054b50)
 #define ZIP64ENDHEADERMAGIC      (0x6064b50)
 #define ZIP64ENDLOCHEADERMAGIC   (0x7064b50)
+#define DATADESCRIPTORMAGIC (0x08074b50)
 
 #define FLAG_LOCALHEADER_OFFSET (0x06)
 #define CRC_LOCALHEADER_OFFSET  (0x0e)
@@ -182,6 +189,7 @@ typedef struct
     ZPOS64_T begin_pos;            /* position of the beginning of the zipfile */
     ZPOS64_T add_position_when_writing_offset;
     ZPOS64_T number_entry;
+    int streaming;              /* 1 if opened with APPEND_STATUS_STREAM */
 
 #ifndef NO_ADDFILEINEXISTINGZIP
     char *globalcomment;
@@ -1047,6 +1055,61 @@ local int LoadCentralDirectoryRecord(zip64_internal* pziinit) {
 
 
 /************************************************************/
+/* The zipfile stream of APPEND_STATUS_STREAM: the caller's stream, and the
+   number of bytes written to it, which serves as the position.  Seeking is
+   refused, so that nothing can require the caller's stream to seek. */
+typedef struct
+{
+    zlib_filefunc64_32_def z_filefunc;  /* functions of the caller's stream */
+    voidpf filestream;                  /* the caller's stream */
+    ZPOS64_T pos;                       /* number of bytes written */
+} zip_stream;
+
+local uLong ZCALLBACK zip64local_streamRead(voidpf opaque, voidpf stream, void* buf, uLong size) {
+    (void)opaque;
+    (void)stream;
+    (void)buf;
+    (void)size;
+    return 0;
+}
+
+local uLong ZCALLBACK zip64local_streamWrite(voidpf opaque, voidpf stream, const void* buf, uLong size) {
+    zip_stream* zs = (zip_stream*)stream;
+    uLong ret;
+    (void)opaque;
+    ret = ZWRITE64(zs->z_filefunc, zs->filestream, buf, size);
+    zs->pos += ret;
+    return ret;
+}
+
+local ZPOS64_T ZCALLBACK zip64local_streamTell(voidpf opaque, voidpf stream) {
+    (void)opaque;
+    return ((zip_stream*)stream)->pos;
+}
+
+local long ZCALLBACK zip64local_streamSeek(voidpf opaque, voidpf stream, ZPOS64_T offset, int origin) {
+    (void)opaque;
+    (void)stream;
+    (void)offset;
+    (void)origin;
+    return -1;
+}
+
+local int ZCALLBACK zip64local_streamClose(voidpf opaque, voidpf stream) {
+    zip_stream* zs = (zip_stream*)stream;
+    int ret;
+    (void)opaque;
+    ret = ZCLOSE64(zs->z_filefunc, zs->filestream);
+    free(zs);
+    return ret;
+}
+
+local int ZCALLBACK zip64local_streamError(voidpf opaque, voidpf stream) {
+    zip_stream* zs = (zip_stream*)stream;
+    (void)opaque;
+    return ZERROR64(zs->z_filefunc, zs->filestream);
+}
+
 extern zipFile ZEXPORT zipOpen3(const void *pathname, int append, zipcharpc* globalcomment, zlib_filefunc64_32_def* pzlib_filefunc64_32_def) {
     zip64_internal ziinit;
     zip64_internal* zi;
@@ -1061,6 +1124,8 @@ extern zipFile ZEXPORT zipOpen3(const void *pathname, int append, zipcharpc* glo
 
     ziinit.filestream = ZOPEN64(ziinit.z_filefunc,
                   pathname,
+                  (append == APPEND_STATUS_STREAM) ?
+                  (ZLIB_FILEFUNC_MODE_WRITE | ZLIB_FILEFUNC_MODE_CREATE) :
                   (append == APPEND_STATUS_CREATE) ?
                   (ZLIB_FILEFUNC_MODE_READ | ZLIB_FILEFUNC_MODE_WRITE | ZLIB_FILEFUNC_MODE_CREATE) :
                     (ZLIB_FILEFUNC_MODE_READ | ZLIB_FILEFUNC_MODE_WRITE | ZLIB_FILEFUNC_MODE_EXISTING));
@@ -1068,6 +1133,33 @@ extern zipFile ZEXPORT zipOpen3(const void *pathname, int append, zipcharpc* glo
     if (ziinit.filestream == NULL)
         return NULL;
 
+    ziinit.streaming = 0;
+    if (append == APPEND_STATUS_STREAM)
+    {
+        zip_stream* zs = (zip_stream*)ALLOC(sizeof(zip_stream));
+        if (zs == NULL)
+        {
+            ZCLOSE64(ziinit.z_filefunc,ziinit.filestream);
+            return NULL;
+        }
+        zs->z_filefunc = ziinit.z_filefunc;
+        zs->filestream = ziinit.filestream;
+        zs->pos = 0;
+        ziinit.z_filefunc.zfile_func64.zopen64_file = NULL;
+        ziinit.z_filefunc.zfile_func64.zread_file = zip64local_streamRead;
+        ziinit.z_filefunc.zfile_func64.zwrite_file = zip64local_streamWrite;
+        ziinit.z_filefunc.zfile_func64.ztell64_file = zip64local_streamTell;
+        ziinit.z_filefunc.zfile_func64.zseek64_file = zip64local_streamSeek;
+        ziinit.z_filefunc.zfile_func64.zclose_file = zip64local_streamClose;
+        ziinit.z_filefunc.zfile_func64.zerror_file = zip64local_streamError;
+        ziinit.z_filefunc.zfile_func64.opaque = NULL;
+        ziinit.z_filefunc.zopen32_file = NULL;
+        ziinit.z_filefunc.ztell32_file = NULL;
+        ziinit.z_filefunc.zseek32_file = NULL;
+        ziinit.filestream = zs;
+        ziinit.streaming = 1;
+    }
+
     if (append == APPEND_STATUS_CREATEAFTER)
         ZSEEK64(ziinit.z_filefunc,ziinit.filestream,0,SEEK_END);
 
@@ -1326,6 +1418,13 @@ extern int ZEXPORT zipOpenNewFileInZip4_64(zipFile file, const char* filename, c
       zi->ci.flag |= 6;
     if (password != NULL)
       zi->ci.flag |= 1;
+    if (zi->streaming)
+    {
+      /* crc and sizes follow the data, and the encryption header is checked
+         against the high byte of the time instead of the crc */
+      zi->ci.flag |= 8;
+      crcForCrypting = zi->ci.dosDate << 16;
+    }
 
     zi->ci.crc32 = 0;
     zi->ci.method = method;
@@ -1697,6 +1796,30 @@ extern int ZEXPORT zipWriteInFileInZip(zipFile file, const void* buf, unsigned i
     return err;
 }
 
+/* Write the data descriptor that follows the data of an entry whose local
+   header has bit 3 of the flag set.  The sizes are eight bytes if the local
+   header has a Zip64 extra field, and four bytes otherwise. */
+local int Write_DataDescriptor(zip64_internal* zi, uLong crc, ZPOS64_T compressed_size, ZPOS64_T uncompressed_size) {
+  int nbByte = zi->ci.zip64 ? 8 : 4;
+  int err;
+
+  if (!zi->ci.zip64 && (compressed_size >= 0xffffffff || uncompressed_size >= 0xffffffff))
+    return ZIP_BADZIPFILE; // Caller passed zip64 = 0, so no room for zip64 info -> fatal
+
+  err = zip64local_putValue(&zi->z_filefunc,zi->filestream,(uLong)DATADESCRIPTORMAGIC,4);
+
+  if (err==ZIP_OK)
+    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,crc,4);
+
+  if (err==ZIP_OK)
+    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,compressed_size,nbByte);
+
+  if (err==ZIP_OK)
+    err = zip64local_putValue(&zi->z_filefunc,zi->filestream,uncompressed_size,nbByte);
+
+  return err;
+}
+
 extern int ZEXPORT zipCloseFileInZipRaw(zipFile file, uLong uncompressed_size, uLong crc32) {
     return zipCloseFileInZipRaw64 (file, uncompressed_size, crc32);
 }
@@ -1888,7 +2011,9 @@ extern int ZEXPORT zipCloseFileInZipRaw64(zipFile file, ZPOS64_T uncompressed_si
 
     free(zi->ci.central_header);
 
-    if (err==ZIP_OK)
+    if (err==ZIP_OK && zi->streaming)
+        err = Write_DataDescriptor(zi, crc32, compressed_size, uncompressed_size);
+    else if (err==ZIP_OK)
     {
         // Update the LocalFileHeader with the new values.
 
@@ -1940,6 +2065,275 @@ extern int ZEXPORT zipCloseFileInZip(zipFile file) {
     return zipCloseFileInZipRaw (file,0,0);
 }
 
+/* An entry of zipWriteInZipParallel() once it has been compressed: the data
+   to write as is, or NULL with the error in err. */
+typedef struct
+{
+    unsigned char* out;     /* compressed data, or the entry's own data */
+    ZPOS64_T out_len;       /* length of out */
+    uLong crc;              /* crc-32 of the uncompressed data */
+    int data_type;          /* Z_ASCII or Z_BINARY, from deflate() */
+    int own;                /* true if out was allocated */
+    int done;               /* true once the compression is complete */
+    int err;                /* ZIP_OK, or an error from the compression */
+} zip_packed;
+
+/* Shared state between the thread appending the entries to the zip file in
+   order, and the threads compressing the entries ahead of it. */
+typedef struct
+{
+    zip_entry* entries;     /* the entries to write */
+    zip_packed* packed;     /* their compressed forms */
+    unsigned count;         /* number of entries */
+    unsigned next;          /* next entry to compress */
+    unsigned written;       /* number of entries written */
+    unsigned ahead;         /* most entries compressed before being written */
+    int stop;               /* true to abandon the remaining entries */
+#ifndef NO_THREADS
+    pthread_mutex_t lock;   /* protects next, written, stop, and done */
+    pthread_cond_t work;    /* signaled when written or stop changes */
+    pthread_cond_t ready;   /* signaled when an entry is done */
+#endif
+} zip_parallel;
+
+/* Compress the uncompressed data of entry into packed.  Stored entries are
+   written from the entry's data without a copy. */
+local void zip64local_packEntry(const zip_entry* entry, zip_packed* packed) {
+    ZPOS64_T left;
+    uLong bound, room;
+    z_stream stream;
+    int err;
+
+    packed->crc = crc32_z(0, (const Bytef*)entry->buf, (z_size_t)entry->size);
+    packed->data_type = Z_BINARY;
+    packed->err = ZIP_OK;
+    if (entry->method == 0)
+    {
+        packed->out = (unsigned char*)(uintptr_t)entry->buf;
+        packed->out_len = entry->size;
+        packed->own = 0;
+        return;
+    }
+
+    /* deflate as zipOpenNewFileInZip64() would, into one buffer of the
+       largest size that the compressed data can have */
+    packed->own = 1;
+    packed->out = NULL;
+    stream.zalloc = (alloc_func)0;
+    stream.zfree = (free_func)0;
+    stream.opaque = (voidpf)0;
+    if (deflateInit2(&stream, entry->level, Z_DEFLATED, -MAX_WBITS,
+                     DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        packed->err = ZIP_INTERNALERROR;
+        return;
+    }
+    bound = deflateBound(&stream, (uLong)entry->size);
+    if ((ZPOS64_T)(uLong)entry->size != entry->size || bound < entry->size ||
+        (packed->out = (unsigned char*)ALLOC(bound)) == NULL)
+    {
+        deflateEnd(&stream);
+        packed->err = ZIP_INTERNALERROR;
+        return;
+    }
+    stream.next_in = (Bytef*)(uintptr_t)entry->buf;
+    stream.avail_in = 0;
+    stream.next_out = packed->out;
+    left = entry->size;
+    do
+    {
+        room = bound - (uLong)(stream.next_out - packed->out);
+        if (stream.avail_in == 0)
+        {
+            stream.avail_in = left > 0x40000000 ? 0x40000000 : (uInt)left;
+            left -= stream.avail_in;
+        }
+        stream.avail_out = room > 0x40000000 ? 0x40000000 : (uInt)room;
+        err = deflate(&stream, left ? Z_NO_FLUSH : Z_FINISH);
+    } while (err == Z_OK);
+    packed->out_len = (ZPOS64_T)(stream.next_out - packed->out);
+    packed->data_type = stream.data_type;
+    deflateEnd(&stream);
+    if (err != Z_STREAM_END)
+    {
+        free(packed->out);
+        packed->out = NULL;
+        packed->err = ZIP_INTERNALERROR;
+    }
+}
+
+/* Append a compressed entry to the zip file as a raw entry. */
+local int zip64local_writeEntry(zipFile file, const zip_entry* entry, const zip_packed* packed) {
+    zip64_internal* zi = (zip64_internal*)file;
+    int err;
+
+    err = zipOpenNewFileInZip4_64(file, entry->filename, entry->zipfi,
+                                  entry->extrafield_local, entry->size_extrafield_local,
+                                  entry->extrafield_global, entry->size_extrafield_global,
+                                  entry->comment, entry->method, entry->level, 1,
+                                  -MAX_WBITS, DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY,
+                                  NULL, 0, VERSIONMADEBY, 0, entry->zip64);
+    if (err != ZIP_OK)
+        return err;
+
+    /* the open buffered nothing, so write the data straight to the file */
+    if (ZWRITE64(zi->z_filefunc, zi->filestream, packed->out, packed->out_len) != packed->out_len)
+        err = ZIP_ERRNO;
+    zi->ci.totalCompressedData += packed->out_len;
+    zi->ci.stream.data_type = packed->data_type;
+    if (err == ZIP_OK)
+        err = zipCloseFileInZipRaw64(file, entry->size, packed->crc);
+    else
+        zipCloseFileInZipRaw64(file, entry->size, packed->crc);
+    return err;
+}
+
+#ifndef NO_THREADS
+/* Compress entries in order, no more than ahead past the last written. */
+local void* zip64local_packThread(void* arg) {
+    zip_parallel* par = (zip_parallel*)arg;
+    unsigned i;
+
+    pthread_mutex_lock(&par->lock);
+    for (;;)
+    {
+        while (!par->stop && par->next < par->count &&
+               par->next - par->written >= par->ahead)
+            pthread_cond_wait(&par->work, &par->lock);
+        if (par->stop || par->next >= par->count)
+            break;
+        i = par->next++;
+        pthread_mutex_unlock(&par->lock);
+        zip64local_packEntry(par->entries + i, par->packed + i);
+        pthread_mutex_lock(&par->lock);
+        par->packed[i].done = 1;
+        pthread_cond_broadcast(&par->ready);
+    }
+    pthread_mutex_unlock(&par->lock);
+    return NULL;
+}
+#endif
+
+extern int ZEXPORT zipWriteInZipParallel(zipFile file, zip_entry* entries, unsigned count, int threads) {
+    zip64_internal* zi;
+    zip_parallel par;
+    unsigned i;
+    int err = ZIP_OK;
+#ifndef NO_THREADS
+    pthread_t* pool = NULL;
+    int started = 0;
+#endif
+
+    if (file == NULL || (entries == NULL && count))
+        return ZIP_PARAMERROR;
+    zi = (zip64_internal*)file;
+    for (i = 0; i < count; i++)
+        if ((entries[i].method != 0 && entries[i].method != Z_DEFLATED) ||
+            (entries[i].buf == NULL && entries[i].size))
+            return ZIP_PARAMERROR;
+    if (zi->in_opened_file_inzip == 1)
+    {
+        err = zipCloseFileInZip(file);
+        if (err != ZIP_OK)
+            return err;
+    }
+    if (count == 0)
+        return ZIP_OK;
+
+    par.entries = entries;
+    par.count = count;
+    par.next = 0;
+    par.written = 0;
+    par.stop = 0;
+    if (threads < 1)
+        threads = 1;
+    if ((unsigned)threads > count)
+        threads = (int)count;
+    par.ahead = 2 * (unsigned)threads;
+    par.packed = (zip_packed*)calloc(count, sizeof(zip_packed));
+    if (par.packed == NULL)
+        return ZIP_INTERNALERROR;
+
+#ifndef NO_THREADS
+    /* start the compressing threads, or compress in this thread if only one
+       is requested or none could be started */
+    if (threads > 1)
+    {
+        pthread_mutex_init(&par.lock, NULL);
+        pthread_cond_init(&par.work, NULL);
+        pthread_cond_init(&par.ready, NULL);
+        pool = (pthread_t*)ALLOC(threads * sizeof(pthread_t));
+        if (pool != NULL)
+            while (started < threads &&
+                   pthread_create(pool + started, NULL, zip64local_packThread, &par) == 0)
+                started++;
+        if (started == 0)
+        {
+            free(pool);
+            pool = NULL;
+            pthread_cond_destroy(&par.ready);
+            pthread_cond_destroy(&par.work);
+            pthread_mutex_destroy(&par.lock);
+        }
+    }
+#endif
+
+    /* append the entries in order as they are compressed */
+    for (i = 0; i < count; i++)
+    {
+        zip_packed* packed = par.packed + i;
+#ifndef NO_THREADS
+        if (started)
+        {
+            pthread_mutex_lock(&par.lock);
+            while (!packed->done)
+                pthread_cond_wait(&par.ready, &par.lock);
+            pthread_mutex_unlock(&par.lock);
+        }
+        else
+#endif
+            zip64local_packEntry(entries + i, packed);
+        err = packed->err;
+        if (err == ZIP_OK)
+            err = zip64local_writeEntry(file, entries + i, packed);
+        if (packed->own)
+            free(packed->out);
+        packed->out = NULL;
+        entries[i].err = err;
+#ifndef NO_THREADS
+        if (started)
+        {
+            pthread_mutex_lock(&par.lock);
+            par.written++;
+            if (err != ZIP_OK)
+                par.stop = 1;
+            pthread_cond_broadcast(&par.work);
+            pthread_mutex_unlock(&par.lock);
+        }
+#endif
+        if (err != ZIP_OK)
+            break;
+    }
+
+#ifndef NO_THREADS
+    /* wait for the threads, and free what they compressed past an error */
+    if (started)
+    {
+        while (started)
+            pthread_join(pool[--started], NULL);
+        free(pool);
+        pthread_cond_destroy(&par.ready);
+        pthread_cond_destroy(&par.work);
+        pthread_mutex_destroy(&par.lock);
+        for (; i < count; i++)
+            if (par.packed[i].own)
+                free(par.packed[i].out);
+    }
+#endif
+    free(par.packed);
+    return err;
+}
+
 local int Write_Zip64EndOfCentralDirectoryLocator(zip64_internal* zi, ZPOS64_T zip64eocd_pos_inzip) {
   int err = ZIP_OK;
   ZPOS64_T pos = zip64eocd_pos_inzip - zi->add_position_when_writing_offset;
@@ -112,6 +112,7 @@ typedef const char* zipcharpc;
 #define APPEND_STATUS_CREATE        (0)
 #define APPEND_STATUS_CREATEAFTER   (1)
 #define APPEND_STATUS_ADDINZIP      (2)
+#define APPEND_STATUS_STREAM        (3)
 
 extern zipFile ZEXPORT zipOpen(const char *pathname, int append);
 extern zipFile ZEXPORT zipOpen64(const void *pathname, int append);
@@ -124,6 +125,12 @@ extern zipFile ZEXPORT zipOpen64(const void *pathname, int append);
          (useful if the file contain a self extractor code)
      if the file pathname exist and append==APPEND_STATUS_ADDINZIP, we will
        add files in existing zip (be sure you don't add file that doesn't exist)
+     if append==APPEND_STATUS_STREAM, the zipfile is written from start to
+       end with no seeks or tells, so it can be a pipe, a socket, or a stream
+       with only open, write, and close functions.  Each file in the zip is
+       then followed by a data descriptor with its crc and sizes, as flagged
+       by bit 3 of its flag.  Open files with zip64 = 1 if they can reach
+       4 GB; the data descriptor then has eight-byte sizes.
      If the zipfile cannot be opened, the return value is NULL.
      Else, the return value is a zipFile Handle, usable with other function
        of this zip package.
@@ -326,6 +333,44 @@ extern int ZEXPORT zipCloseFileInZipRaw64(zipFile file,
                                           ZPOS64_T uncompressed_size,
                                           uLong crc32);
 
+/* An entry for zipWriteInZipParallel() */
+typedef struct
+{
+    const char* filename;           /* name in the zip file, or NULL for "-" */
+    const zip_fileinfo* zipfi;      /* date and attributes, or NULL */
+    const void* extrafield_local;   /* as for zipOpenNewFileInZip64() */
+    uInt size_extrafield_local;
+    const void* extrafield_global;
+    uInt size_extrafield_global;
+    const char* comment;            /* comment, or NULL */
+    int method;                     /* 0 to store, or Z_DEFLATED */
+    int level;                      /* compression level */
+    int zip64;                      /* as for zipOpenNewFileInZip64() */
+    const void* buf;                /* the uncompressed contents */
+    ZPOS64_T size;                  /* length of buf */
+    int err;                        /* set to the result for this entry */
+} zip_entry;
+
+extern int ZEXPORT zipWriteInZipParallel(zipFile file,
+                                         zip_entry* entries,
+                                         unsigned count,
+                                         int threads);
+/*
+  Add count entries to the zipfile, in order, compressing them on threads
+    threads at a time.  Each entry is given whole in memory, and is written
+    as zipOpenNewFileInZip64(), zipWriteInFileInZip() of all of buf, and then
+    zipCloseFileInZip() would write it, with the same zip64 handling.  The
+    compressed entries are appended to the file by the calling thread, no more
+    than 2 * threads entries ahead of the last one written, which bounds the
+    memory used for compressed data.  The entries' buffers must remain
+    unchanged until zipWriteInZipParallel() returns.  Encryption is not
+    supported.  Without pthreads, or if compiled with NO_THREADS, the entries
+    are compressed one at a time by the calling thread.
+  Returns ZIP_OK, or the error of the first entry that could not be written,
+    after which no more entries are written.  The result for each entry that
+    was attempted is saved in its err member.
+ */
+
 extern int ZEXPORT zipAlreadyThere(zipFile file,
                                    char const* name);
 /*
@@ -47,6 +47,10 @@
 #  include <sys/stat.h>
 #  include <unistd.h>
 #  include <utime.h>
+#  ifndef NO_THREADS
+#    define PIPELINE
+#    include <pthread.h>
+#  endif
 #endif
 
 
@@ -380,34 +384,481 @@ int matchname (int arg,int argc,char **argv,char *fname)
 }
 
 
+/* pipelined extraction */
+/*
+ * The archive is decompressed by its own thread into a ring of large spans.
+ * The tar headers are parsed in place in the spans, and the file contents
+ * are handed to writer threads as pieces of the spans, without copying. A
+ * span is reused once the parser and all of the writes from it are done.
+ * Each file goes to one writer, picked by a hash of its name, so the pieces
+ * of a file, and any later entry with the same name, are written in order,
+ * while different files are created and written concurrently. With no
+ * threads, the same code decompresses a span at a time and writes inline.
+ */
+
+#define SPANSIZE  (1L << 20)    /* bytes per span, a multiple of BLOCKSIZE */
+#define SPANS     8             /* spans in the ring */
+#define WRITERS   4             /* default number of writer threads */
+#define MAXWRITERS 64
+
+#define WOPEN   1               /* write job opens the file first */
+#define WCLOSE  2               /* write job closes the file after */
+
+struct span
+{
+  char        *data;
+  int          len;             /* bytes in data, < SPANSIZE if last */
+  int          last;            /* true if the end of input or an error */
+  const char  *msg;             /* gzread() error message, or NULL */
+  int          refs;            /* parser and pending writes using data */
+};
+
+struct out_file
+{
+  char        *fname;
+  FILE        *fp;
+  int          mode;
+  time_t       time;
+  int          writer;          /* writer thread for this file */
+};
+
+struct write_job
+{
+  struct write_job *next;
+  struct out_file  *file;
+  int               flags;      /* WOPEN and/or WCLOSE */
+  struct span      *span;       /* span holding data, or NULL */
+  char             *data;
+  unsigned          len;
+};
+
+struct pipeline;
+
+struct writer
+{
+  struct pipeline  *pl;
+  struct write_job *head, *tail;
+#ifdef PIPELINE
+  pthread_t         tid;
+  pthread_cond_t    work;       /* signaled when a job is queued or at stop */
+#endif
+};
+
+struct pipeline
+{
+  gzFile            in;
+  struct span       span[SPANS];
+  unsigned          spans;      /* spans in use */
+  unsigned          filled;     /* spans filled by the decompressor thread */
+  unsigned          taken;      /* spans taken by the parser */
+  int               pos;        /* parser offset in the current span */
+  int               threaded;   /* true if there is a decompressor thread */
+  int               stop;       /* true when the threads should exit */
+  int               writers;    /* number of writer threads */
+  struct writer    *writer;
+  struct attr_item *attributes;
+#ifdef PIPELINE
+  pthread_t         tid;
+  pthread_mutex_t   lock;       /* protects the counts, refs, and queues */
+  pthread_cond_t    more;       /* signaled when a span is filled */
+  pthread_cond_t    freed;      /* signaled when a span is released */
+#endif
+};
+
+void pipe_lock(struct pipeline *pl)
+{
+#ifdef PIPELINE
+  pthread_mutex_lock(&pl->lock);
+#else
+  (void)pl;
+#endif
+}
+
+void pipe_unlock(struct pipeline *pl)
+{
+#ifdef PIPELINE
+  pthread_mutex_unlock(&pl->lock);
+#else
+  (void)pl;
+#endif
+}
+
+
+/* decompress the next span of the archive into s */
+
+void span_fill(struct pipeline *pl,struct span *s)
+{
+  int err;
+
+  s->len = gzread(pl->in, s->data, SPANSIZE);
+  s->last = s->len != SPANSIZE;
+  s->msg = NULL;
+  if (s->last)
+    {
+      const char *msg = gzerror(pl->in, &err);
+
+      if (s->len < 0 || (err != Z_OK && err != Z_BUF_ERROR))
+        s->msg = msg;
+      if (s->len < 0)
+        s->len = 0;
+    }
+}
+
+
+/* drop one use of s, making it available to refill when it has none left */
+
+void span_release(struct pipeline *pl,struct span *s)
+{
+  pipe_lock(pl);
+#ifdef PIPELINE
+  if (--s->refs == 0 && pl->threaded)
+    pthread_cond_signal(&pl->freed);
+#else
+  s->refs--;
+#endif
+  pipe_unlock(pl);
+}
+
+
+/* create, write, and close a file as directed by one write job */
+
+void write_file(struct pipeline *pl,struct out_file *file,int flags,
+                char *data,unsigned len)
+{
+  if (flags & WOPEN)
+    {
+      file->fp = fopen(file->fname,"wb");
+      if (file->fp == NULL) {
+        /* try creating directory */
+        char *p = strrchr(file->fname, '/');
+        if (p != NULL) {
+          *p = '\0';
+          makedir(file->fname);
+          *p = '/';
+          file->fp = fopen(file->fname,"wb");
+        }
+      }
+      if (file->fp != NULL)
+        printf("Extracting %s\n",file->fname);
+      else
+        fprintf(stderr, "%s: Couldn't create %s\n",prog,file->fname);
+    }
+  if (len && file->fp != NULL &&
+      fwrite(data,sizeof(char),len,file->fp) != len)
+    {
+      fprintf(stderr,
+        "%s: Error writing %s -- skipping\n",prog,file->fname);
+      fclose(file->fp);
+      file->fp = NULL;
+      remove(file->fname);
+    }
+  if (flags & WCLOSE)
+    {
+      if (file->fp != NULL)
+        {
+          fclose(file->fp);
+          pipe_lock(pl);
+          push_attr(&pl->attributes,file->fname,file->mode,file->time);
+          pipe_unlock(pl);
+        }
+      free(file->fname);
+      free(file);
+    }
+}
+
+
+#ifdef PIPELINE
+
+/* decompressor thread: fill spans in ring order as they are freed */
+
+void *decompress_thread(void *arg)
+{
+  struct pipeline *pl = (struct pipeline *)arg;
+  struct span *s;
+  int stop;
+
+  do
+    {
+      s = pl->span + pl->filled % SPANS;
+      pthread_mutex_lock(&pl->lock);
+      while (s->refs && !pl->stop)
+        pthread_cond_wait(&pl->freed, &pl->lock);
+      stop = pl->stop;
+      pthread_mutex_unlock(&pl->lock);
+      if (stop)
+        break;
+      span_fill(pl, s);
+      pthread_mutex_lock(&pl->lock);
+      s->refs = 1;
+      pl->filled++;
+      pthread_cond_signal(&pl->more);
+      pthread_mutex_unlock(&pl->lock);
+    }
+  while (!s->last);
+  return NULL;
+}
+
+
+/* writer thread: run write jobs from its queue until told to stop */
+
+void *write_thread(void *arg)
+{
+  struct writer *w = (struct writer *)arg;
+  struct pipeline *pl = w->pl;
+  struct write_job *job;
+
+  pthread_mutex_lock(&pl->lock);
+  while (1)
+    {
+      while (w->head == NULL && !pl->stop)
+        pthread_cond_wait(&w->work, &pl->lock);
+      if (w->head == NULL)
+        break;
+      job = w->head;
+      w->head = job->next;
+      pthread_mutex_unlock(&pl->lock);
+      write_file(pl, job->file, job->flags, job->data, job->len);
+      pthread_mutex_lock(&pl->lock);
+      if (job->span != NULL && --job->span->refs == 0)
+        pthread_cond_signal(&pl->freed);
+      free(job);
+    }
+  pthread_mutex_unlock(&pl->lock);
+  return NULL;
+}
+
+#endif
+
+
+/* start decompressing in, with a thread if threads is true, and with up to */
+/* writers threads for file writes */
+
+void pipeline_start(struct pipeline *pl,gzFile in,int threads,int writers)
+{
+  unsigned i;
+
+  memset(pl, 0, sizeof(struct pipeline));
+  pl->in = in;
+#ifdef PIPELINE
+  pthread_mutex_init(&pl->lock, NULL);
+  pthread_cond_init(&pl->more, NULL);
+  pthread_cond_init(&pl->freed, NULL);
+  if (writers > MAXWRITERS)
+    writers = MAXWRITERS;
+  if (threads && writers > 0)
+    {
+      pl->writer = (struct writer *)calloc(writers, sizeof(struct writer));
+      if (pl->writer == NULL)
+        error("Out of memory");
+      while (pl->writers < writers)
+        {
+          struct writer *w = pl->writer + pl->writers;
+
+          w->pl = pl;
+          pthread_cond_init(&w->work, NULL);
+          if (pthread_create(&w->tid, NULL, write_thread, w) != 0)
+            {
+              pthread_cond_destroy(&w->work);
+              break;
+            }
+          pl->writers++;
+        }
+    }
+  pl->spans = threads ? SPANS : 1;
+#else
+  (void)threads;
+  (void)writers;
+  pl->spans = 1;
+#endif
+  for (i = 0; i < pl->spans; i++)
+    {
+      pl->span[i].data = (char *)malloc(SPANSIZE);
+      if (pl->span[i].data == NULL)
+        error("Out of memory");
+    }
+#ifdef PIPELINE
+  if (threads &&
+      pthread_create(&pl->tid, NULL, decompress_thread, pl) == 0)
+    pl->threaded = 1;
+#endif
+}
+
+
+/* let the writers finish, stop the threads, and free the spans */
+
+void pipeline_end(struct pipeline *pl)
+{
+  unsigned i;
+
+#ifdef PIPELINE
+  pthread_mutex_lock(&pl->lock);
+  pl->stop = 1;
+  pthread_cond_broadcast(&pl->freed);
+  for (i = 0; i < (unsigned)pl->writers; i++)
+    pthread_cond_signal(&pl->writer[i].work);
+  pthread_mutex_unlock(&pl->lock);
+  if (pl->threaded)
+    pthread_join(pl->tid, NULL);
+  for (i = 0; i < (unsigned)pl->writers; i++)
+    {
+      pthread_join(pl->writer[i].tid, NULL);
+      pthread_cond_destroy(&pl->writer[i].work);
+    }
+  free(pl->writer);
+  pthread_cond_destroy(&pl->freed);
+  pthread_cond_destroy(&pl->more);
+  pthread_mutex_destroy(&pl->lock);
+#endif
+  for (i = 0; i < pl->spans; i++)
+    free(pl->span[i].data);
+}
+
+
+/* point *data at up to want bytes of the archive, rounded up to whole */
+/* blocks, and return the number of bytes there -- return 0 at the end */
+/* of the input, or -1 on a read error, with the message in *data */
+
+int tar_next(struct pipeline *pl,char **data,int want)
+{
+  struct span *s = NULL;
+  int got;
+
+  if (pl->taken)
+    s = pl->span + (pl->taken - 1) % pl->spans;
+  while (s == NULL || pl->pos == s->len)
+    {
+      if (s != NULL)
+        {
+          if (s->last)
+            {
+              *data = (char *)s->msg;
+              return s->msg != NULL ? -1 : 0;
+            }
+          span_release(pl, s);
+        }
+      s = pl->span + pl->taken % pl->spans;
+#ifdef PIPELINE
+      if (pl->threaded)
+        {
+          pthread_mutex_lock(&pl->lock);
+          while (pl->filled == pl->taken)
+            pthread_cond_wait(&pl->more, &pl->lock);
+          pthread_mutex_unlock(&pl->lock);
+        }
+      else
+#endif
+        {
+          span_fill(pl, s);
+          s->refs = 1;
+        }
+      pl->taken++;
+      pl->pos = 0;
+    }
+  got = s->len - pl->pos;
+  if (want < got)
+    got = (want + BLOCKSIZE - 1) & ~(BLOCKSIZE - 1);
+  *data = s->data + pl->pos;
+  pl->pos += got;
+  return got;
+}
+
+
+/* write len bytes at data, which were returned by the last tar_next(), to */
+/* file, opening and closing it as directed by flags */
+
+void tar_write(struct pipeline *pl,struct out_file *file,int flags,
+               char *data,unsigned len)
+{
+#ifdef PIPELINE
+  if (pl->writers)
+    {
+      struct writer *w = pl->writer + file->writer;
+      struct write_job *job;
+
+      job = (struct write_job *)malloc(sizeof(struct write_job));
+      if (job == NULL)
+        error("Out of memory");
+      job->next = NULL;
+      job->file = file;
+      job->flags = flags;
+      job->span = len ? pl->span + (pl->taken - 1) % pl->spans : NULL;
+      job->data = data;
+      job->len = len;
+      pthread_mutex_lock(&pl->lock);
+      if (job->span != NULL)
+        job->span->refs++;
+      if (w->head == NULL)
+        w->head = job;
+      else
+        w->tail->next = job;
+      w->tail = job;
+      pthread_cond_signal(&w->work);
+      pthread_mutex_unlock(&pl->lock);
+      return;
+    }
+#endif
+  write_file(pl, file, flags, data, len);
+}
+
+
+/* make a file to extract, assigned to a writer by its name */
+
+struct out_file *out_file_new(struct pipeline *pl,char *fname,int mode,
+                              time_t time)
+{
+  struct out_file *file;
+  unsigned hash = 0;
+  char *p;
+
+  file = (struct out_file *)malloc(sizeof(struct out_file));
+  if (file == NULL || (file->fname = strdup(fname)) == NULL)
+    error("Out of memory");
+  file->fp = NULL;
+  file->mode = mode;
+  file->time = time;
+  for (p = fname; *p; p++)
+    hash = hash * 31 + (unsigned char)*p;
+  file->writer = pl->writers ? (int)(hash % pl->writers) : 0;
+  return file;
+}
+
+
 /* tar file list or extract */
 
-int tar (gzFile in,int action,int arg,int argc,char **argv)
+int tar (gzFile in,int action,int arg,int argc,char **argv,int writers)
 {
-  union  tar_buffer buffer;
+  union  tar_buffer *buffer;
+  char   *block;
   int    len;
-  int    err;
   int    getheader = 1;
   int    remaining = 0;
-  FILE   *outfile = NULL;
+  struct out_file *outfile = NULL;
+  int    outflags = 0;
   char   fname[BLOCKSIZE];
   int    tarmode;
   time_t tartime;
-  struct attr_item *attributes = NULL;
+  struct pipeline pl;
 
+  pipeline_start(&pl, in, writers > 0,
+                 action == TGZ_EXTRACT ? writers : 0);
   if (action == TGZ_LIST)
     printf("    date      time     size                       file\n"
            " ---------- -------- --------- -------------------------------------\n");
   while (1)
     {
-      len = gzread(in, &buffer, BLOCKSIZE);
+      len = tar_next(&pl, &block, getheader >= 1 ? BLOCKSIZE : remaining);
       if (len < 0)
-        error(gzerror(in, &err));
+        {
+          pipeline_end(&pl);
+          error(block);
+        }
+      buffer = (union tar_buffer *)block;
       /*
        * Always expect complete blocks to process
        * the tar information.
        */
-      if (len != BLOCKSIZE)
+      if (len == 0 || len % BLOCKSIZE != 0 ||
+          (getheader >= 1 && len != BLOCKSIZE))
         {
           action = TGZ_INVALID; /* force error exit */
           remaining = 0;        /* force I/O cleanup */
@@ -423,20 +874,20 @@ int tar (gzFile in,int action,int arg,int argc,char **argv)
            * or the end-of-tar block,
            * we are done
            */
-          if (len == 0 || buffer.header.name[0] == 0)
+          if (len == 0 || buffer->header.name[0] == 0)
             break;
 
-          tarmode = getoct(buffer.header.mode,8);
-          tartime = (time_t)getoct(buffer.header.mtime,12);
+          tarmode = getoct(buffer->header.mode,8);
+          tartime = (time_t)getoct(buffer->header.mtime,12);
           if (tarmode == -1 || tartime == (time_t)-1)
             {
-              buffer.header.name[0] = 0;
+              buffer->header.name[0] = 0;
               action = TGZ_INVALID;
             }
 
           if (getheader == 1)
             {
-              strncpy(fname,buffer.header.name,SHORTNAMESIZE);
+              strncpy(fname,buffer->header.name,SHORTNAMESIZE);
               if (fname[SHORTNAMESIZE-1] != 0)
                   fname[SHORTNAMESIZE] = 0;
             }
@@ -445,15 +896,18 @@ int tar (gzFile in,int action,int arg,int argc,char **argv)
               /*
                * The file name is longer than SHORTNAMESIZE
                */
-              if (strncmp(fname,buffer.header.name,SHORTNAMESIZE-1) != 0)
+              if (strncmp(fname,buffer->header.name,SHORTNAMESIZE-1) != 0)
+                {
+                  pipeline_end(&pl);
                   error("bad long name");
+                }
               getheader = 1;
             }
 
           /*
            * Act according to the type flag
            */
-          switch (buffer.header.typeflag)
+          switch (buffer->header.typeflag)
             {
             case DIRTYPE:
               if (action == TGZ_LIST)
@@ -461,12 +915,14 @@ int tar (gzFile in,int action,int arg,int argc,char **argv)
               if (action == TGZ_EXTRACT)
                 {
                   makedir(fname);
-                  push_attr(&attributes,fname,tarmode,tartime);
+                  pipe_lock(&pl);
+                  push_attr(&pl.attributes,fname,tarmode,tartime);
+                  pipe_unlock(&pl);
                 }
               break;
             case REGTYPE:
             case AREGTYPE:
-              remaining = getoct(buffer.header.size,12);
+              remaining = getoct(buffer->header.size,12);
               if (remaining == -1)
                 {
                   action = TGZ_INVALID;
@@ -478,21 +934,8 @@ int tar (gzFile in,int action,int arg,int argc,char **argv)
                 {
                   if (matchname(arg,argc,argv,fname))
                     {
-                      outfile = fopen(fname,"wb");
-                      if (outfile == NULL) {
-                        /* try creating directory */
-                        char *p = strrchr(fname, '/');
-                        if (p != NULL) {
-                          *p = '\0';
-                          makedir(fname);
-                          *p = '/';
-                          outfile = fopen(fname,"wb");
-                        }
-                      }
-                      if (outfile != NULL)
-                        printf("Extracting %s\n",fname);
-                      else
-                        fprintf(stderr, "%s: Couldn't create %s",prog,fname);
+                      outfile = out_file_new(&pl,fname,tarmode,tartime);
+                      outflags = WOPEN;
                     }
                   else
                     outfile = NULL;
@@ -501,15 +944,24 @@ int tar (gzFile in,int action,int arg,int argc,char **argv)
               break;
             case GNUTYPE_LONGLINK:
             case GNUTYPE_LONGNAME:
-              remaining = getoct(buffer.header.size,12);
+              remaining = getoct(buffer->header.size,12);
               if (remaining < 0 || remaining >= BLOCKSIZE)
                 {
                   action = TGZ_INVALID;
                   break;
                 }
-              len = gzread(in, fname, BLOCKSIZE);
+              len = tar_next(&pl, &block, BLOCKSIZE);
               if (len < 0)
-                error(gzerror(in, &err));
+                {
+                  pipeline_end(&pl);
+                  error(block);
+                }
+              if (len != BLOCKSIZE)
+                {
+                  action = TGZ_INVALID;
+                  break;
+                }
+              memcpy(fname, block, BLOCKSIZE);
               if (fname[BLOCKSIZE-1] != 0 || (int)strlen(fname) > remaining)
                 {
                   action = TGZ_INVALID;
@@ -525,20 +977,18 @@ int tar (gzFile in,int action,int arg,int argc,char **argv)
         }
       else
         {
-          unsigned int bytes = (remaining > BLOCKSIZE) ? BLOCKSIZE : remaining;
+          unsigned int bytes = (remaining > len) ? len : remaining;
 
-          if (outfile != NULL)
+          remaining -= bytes;
+          if (outfile != NULL && bytes)
             {
-              if (fwrite(&buffer,sizeof(char),bytes,outfile) != bytes)
-                {
-                  fprintf(stderr,
-                    "%s: Error writing %s -- skipping\n",prog,fname);
-                  fclose(outfile);
-                  outfile = NULL;
-                  remove(fname);
-                }
+              tar_write(&pl, outfile,
+                        outflags | (remaining == 0 ? WCLOSE : 0),
+                        block, bytes);
+              outflags = 0;
+              if (remaining == 0)
+                outfile = NULL;
             }
-          remaining -= bytes;
         }
 
       if (remaining == 0)
@@ -546,10 +996,8 @@ int tar (gzFile in,int action,int arg,int argc,char **argv)
           getheader = 1;
           if (outfile != NULL)
             {
-              fclose(outfile);
+              tar_write(&pl, outfile, outflags | WCLOSE, NULL, 0);
               outfile = NULL;
-              if (action != TGZ_INVALID)
-                push_attr(&attributes,fname,tarmode,tartime);
             }
         }
 
@@ -558,15 +1006,17 @@ int tar (gzFile in,int action,int arg,int argc,char **argv)
        */
       if (action == TGZ_INVALID)
         {
+          pipeline_end(&pl);
           error("broken archive");
           break;
         }
     }
 
   /*
-   * Restore file modes and time stamps
+   * Wait for the writes, and restore file modes and time stamps
    */
-  restore_attr(&attributes);
+  pipeline_end(&pl);
+  restore_attr(&pl.attributes);
 
   if (gzclose(in) != Z_OK)
     error("failed gzclose");
@@ -579,13 +1029,16 @@ int tar (gzFile in,int action,int arg,int argc,char **argv)
 
 void help(int exitval)
 {
-  printf("untgz version 0.2.1\n"
+  printf("untgz version 0.3\n"
          "  using zlib version %s\n\n",
          zlibVersion());
   printf("Usage: untgz file.tgz            extract all files\n"
          "       untgz file.tgz fname ...  extract selected files\n"
          "       untgz -l file.tgz         list archive contents\n"
-         "       untgz -h                  display this help\n");
+         "       untgz -h                  display this help\n"
+         "       -j n before the file.tgz uses n threads to write files\n"
+         "       (default %d), or with n = 0 does all of the work serially\n",
+         WRITERS);
   exit(exitval);
 }
 
@@ -600,6 +1053,7 @@ int main(int argc,char **argv)
 {
     int         action = TGZ_EXTRACT;
     int         arg = 1;
+    int         writers = WRITERS;
     char        *TGZfile;
     gzFile      f;
 
@@ -624,6 +1078,16 @@ int main(int argc,char **argv)
     if (argc == 1)
       help(0);
 
+    if (strcmp(argv[arg],"-j") == 0)
+      {
+        if (arg + 2 >= argc)
+          help(1);
+        writers = atoi(argv[arg + 1]);
+        if (writers < 0)
+          help(1);
+        arg += 2;
+      }
+
     if (strcmp(argv[arg],"-l") == 0)
       {
         action = TGZ_LIST;
@@ -649,13 +1113,13 @@ int main(int argc,char **argv)
       {
       case TGZ_LIST:
       case TGZ_EXTRACT:
-        f = gzopen(TGZfile,"rb");
+        f = gzopen(TGZfile,writers ? "rbm" : "rb");
         if (f == NULL)
           {
             fprintf(stderr,"%s: Couldn't gzopen %s\n",prog,TGZfile);
             return 1;
           }
-        exit(tar(f, action, arg, argc, argv));
+        exit(tar(f, action, arg, argc, argv, writers));
       break;
 
       default:
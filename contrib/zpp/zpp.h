@@ -0,0 +1,558 @@
+/*
+ * A header-only C++11 interface to deflate and inflate
+ *
+ * Move-only deflater and inflater objects own their z_stream, and free it
+ * when destroyed.  They work on spans of bytes, either a step at a time
+ * like deflate() and inflate(), or on a whole buffer at once.  reset()
+ * keeps the allocated state for the next buffer, and the one-shot calls
+ * reset by themselves, so one object can serve any number of buffers.
+ *
+ * The wrapper (raw, zlib, or gzip) is a template parameter, and memory for
+ * the stream comes from an allocator that is also a template parameter.
+ *
+ * Errors throw zpp::error, or std::bad_alloc when zlib runs out of memory.
+ */
+
+#ifndef ZPP_H
+#define ZPP_H
+
+#include <cstddef>
+#include <climits>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "zlib.h"
+
+namespace zpp {
+
+/*****************************************************************************/
+
+/**
+ *  @brief  Framing around the deflate data, fixed at compile time.
+ *
+ *  raw has no header and no check value, zlib has the zlib header and
+ *  an adler32 trailer, and gzip has the gzip header and a crc32 trailer.
+*/
+enum class wrapper { raw, zlib, gzip };
+
+/**
+ *  @brief  Exception for zlib errors other than running out of memory.
+*/
+class error : public std::runtime_error
+{
+public:
+  error(int code, const char* msg = NULL)
+  : std::runtime_error(msg != NULL ? msg : zError(code)), code_(code)
+  { }
+
+  //  The zlib return code, e.g. Z_DATA_ERROR.
+  int
+  code() const noexcept { return code_; }
+
+private:
+  int code_;
+};
+
+/**
+ *  @brief  Contiguous bytes, as a pointer and a length.
+ *
+ *  Converts from anything with byte-sized data() and size(), such as
+ *  std::vector<char>, std::string, or another span, and from arrays.
+*/
+template<typename T>
+  class span
+  {
+    static_assert(sizeof(T) == 1, "zpp::span is for bytes");
+
+  public:
+    span() noexcept : ptr_(NULL), len_(0) { }
+
+    span(T* p, std::size_t n) noexcept : ptr_(p), len_(n) { }
+
+    template<typename C,
+             typename = decltype(reinterpret_cast<T*>(std::declval<C&>().data())),
+             typename = typename std::enable_if<
+               sizeof(*std::declval<C&>().data()) == 1>::type>
+      span(C&& c) noexcept
+      : ptr_(reinterpret_cast<T*>(c.data())), len_(c.size())
+      { }
+
+    template<std::size_t N>
+      span(T (&a)[N]) noexcept : ptr_(a), len_(N) { }
+
+    T*
+    data() const noexcept { return ptr_; }
+
+    std::size_t
+    size() const noexcept { return len_; }
+
+    bool
+    empty() const noexcept { return len_ == 0; }
+
+    //  The bytes after the first off.
+    span
+    subspan(std::size_t off) const noexcept
+    { return span(ptr_ + off, len_ - off); }
+
+  private:
+    T* ptr_;
+    std::size_t len_;
+  };
+
+typedef span<const unsigned char> const_bytes;
+typedef span<unsigned char> mutable_bytes;
+
+/*****************************************************************************/
+
+namespace detail {
+
+// windowBits for deflateInit2() and inflateInit2() that select the wrapper
+template<wrapper W> struct window_bits;
+template<> struct window_bits<wrapper::raw>
+{ static int of(int bits) { return -bits; } };
+template<> struct window_bits<wrapper::zlib>
+{ static int of(int bits) { return bits; } };
+template<> struct window_bits<wrapper::gzip>
+{ static int of(int bits) { return bits + 16; } };
+
+// Throw for a zlib error.  Z_BUF_ERROR is only no progress, and not thrown.
+inline void
+check(int ret, const z_stream& strm)
+{
+  if (ret == Z_MEM_ERROR)
+    throw std::bad_alloc();
+  if (ret < 0 && ret != Z_BUF_ERROR)
+    throw error(ret, strm.msg);
+}
+
+// The z_stream on the free store, so that moving the owner does not move it
+// (deflate and inflate state points back at it), together with the allocator
+// that zalloc and zfree use.
+template<typename Alloc>
+  struct stream
+  {
+    typedef std::allocator_traits<Alloc> traits;
+    typedef typename traits::template rebind_alloc<stream> self_alloc;
+    typedef typename traits::template rebind_alloc<std::max_align_t> block_alloc;
+    typedef std::allocator_traits<self_alloc> self_traits;
+    typedef std::allocator_traits<block_alloc> block_traits;
+
+    z_stream strm;
+    Alloc alloc;
+
+    explicit
+    stream(const Alloc& a) : alloc(a)
+    {
+      strm.zalloc = &stream::zalloc;
+      strm.zfree = &stream::zfree;
+      strm.opaque = this;
+      strm.next_in = Z_NULL;
+      strm.avail_in = 0;
+    }
+
+    static stream*
+    create(const Alloc& a)
+    {
+      self_alloc sa(a);
+      stream* s = self_traits::allocate(sa, 1);
+      ::new (static_cast<void*>(s)) stream(a);
+      return s;
+    }
+
+    static void
+    destroy(stream* s)
+    {
+      self_alloc sa(s->alloc);
+      s->~stream();
+      self_traits::deallocate(sa, s, 1);
+    }
+
+    // Blocks are preceded by their length in max_align_t units, which the
+    // allocator needs back when freeing
+    static voidpf
+    zalloc(voidpf opaque, uInt items, uInt size)
+    {
+      stream* s = static_cast<stream*>(opaque);
+      block_alloc ba(s->alloc);
+      std::size_t n = 1 + ((std::size_t)items * size + sizeof(std::max_align_t) - 1) /
+                          sizeof(std::max_align_t);
+      try
+      {
+        std::max_align_t* p = block_traits::allocate(ba, n);
+        *reinterpret_cast<std::size_t*>(p) = n;
+        return p + 1;
+      }
+      catch (...)
+      {
+        return Z_NULL;
+      }
+    }
+
+    static void
+    zfree(voidpf opaque, voidpf address)
+    {
+      stream* s = static_cast<stream*>(opaque);
+      block_alloc ba(s->alloc);
+      std::max_align_t* p = static_cast<std::max_align_t*>(address) - 1;
+      block_traits::deallocate(ba, p, *reinterpret_cast<std::size_t*>(p));
+    }
+
+    // Point strm at in and out (at most UINT_MAX of each at a time)
+    void
+    load(const_bytes in, mutable_bytes out)
+    {
+      strm.next_in = const_cast<Bytef*>(in.data());
+      strm.avail_in = in.size() > UINT_MAX ? UINT_MAX : (uInt)in.size();
+      strm.next_out = out.data();
+      strm.avail_out = out.size() > UINT_MAX ? UINT_MAX : (uInt)out.size();
+    }
+
+    // Move in and out past what was consumed and produced
+    void
+    advance(const_bytes& in, mutable_bytes& out) const
+    {
+      in = in.subspan(strm.next_in - in.data());
+      out = out.subspan(strm.next_out - out.data());
+    }
+  };
+
+} // namespace detail
+
+/*****************************************************************************/
+
+/**
+ *  @brief  Move-only owner of a deflate stream.
+ *  @param  W  Wrapper written around the deflate data.
+ *  @param  Alloc  Allocator for the stream's memory.
+*/
+template<wrapper W = wrapper::zlib,
+         typename Alloc = std::allocator<unsigned char> >
+  class basic_deflater
+  {
+    typedef detail::stream<Alloc> stream_type;
+
+  public:
+    /**
+     *  @brief  Set up a deflate stream, as deflateInit2() does.
+     *  @param  level  Compression level (see zlib.h for allowed values).
+     *  @param  window_bits  Base two logarithm of the window size, 9..15.
+     *  @param  mem_level  Memory for the internal state, 1..9.
+     *  @param  strategy  Compression strategy (see zlib.h).
+     *  @param  alloc  Allocator to get the stream's memory from.
+    */
+    explicit
+    basic_deflater(int level = Z_DEFAULT_COMPRESSION,
+                   int window_bits = MAX_WBITS,
+                   int mem_level = 8,
+                   int strategy = Z_DEFAULT_STRATEGY,
+                   const Alloc& alloc = Alloc())
+    : s_(stream_type::create(alloc))
+    {
+      int ret = deflateInit2(&s_->strm, level, Z_DEFLATED,
+                             detail::window_bits<W>::of(window_bits),
+                             mem_level, strategy);
+      if (ret != Z_OK)
+        this->fail(ret);
+    }
+
+    basic_deflater(basic_deflater&& other) noexcept : s_(other.s_)
+    { other.s_ = NULL; }
+
+    basic_deflater&
+    operator=(basic_deflater&& other) noexcept
+    {
+      std::swap(s_, other.s_);
+      return *this;
+    }
+
+    basic_deflater(const basic_deflater&) = delete;
+    basic_deflater& operator=(const basic_deflater&) = delete;
+
+    ~basic_deflater()
+    {
+      if (s_ != NULL)
+      {
+        deflateEnd(&s_->strm);
+        stream_type::destroy(s_);
+      }
+    }
+
+    /**
+     *  @brief  Start a new stream, keeping the allocated state and settings.
+    */
+    void
+    reset()
+    { detail::check(deflateReset(&s_->strm), s_->strm); }
+
+    /**
+     *  @brief  Compress a step, as deflate() does.
+     *  @param  in  Input, advanced past what was consumed.
+     *  @param  out  Output space, advanced past what was written.
+     *  @param  flush  Z_NO_FLUSH, Z_SYNC_FLUSH, Z_FINISH, etc.
+     *  @return  Z_OK, Z_STREAM_END, or Z_BUF_ERROR if no progress was possible.
+    */
+    int
+    deflate(const_bytes& in,
+            mutable_bytes& out,
+            int flush = Z_NO_FLUSH)
+    {
+      s_->load(in, out);
+      // With more input than a z_stream holds, only finish on the last part
+      int ret = ::deflate(&s_->strm,
+                          s_->strm.avail_in < in.size() && flush == Z_FINISH ?
+                          Z_NO_FLUSH : flush);
+      s_->advance(in, out);
+      detail::check(ret, s_->strm);
+      return ret;
+    }
+
+    /**
+     *  @brief  Largest compressed size for len bytes of input.
+    */
+    std::size_t
+    bound(std::size_t len) const
+    { return deflateBound(&s_->strm, (uLong)len); }
+
+    /**
+     *  @brief  Compress all of in into out, starting a new stream.
+     *  @return  Number of bytes written to out.
+     *
+     *  Throws error with code Z_BUF_ERROR if out is too small, which
+     *  cannot happen if it has room for bound(in.size()) bytes.
+    */
+    std::size_t
+    compress(const_bytes in,
+             mutable_bytes out)
+    {
+      this->reset();
+      std::size_t room = out.size();
+      int ret;
+      do {
+        ret = this->deflate(in, out, Z_FINISH);
+      } while (ret == Z_OK && !out.empty());
+      if (ret != Z_STREAM_END)
+        throw error(Z_BUF_ERROR, "output buffer too small");
+      return room - out.size();
+    }
+
+    /**
+     *  @brief  Compress all of in, starting a new stream.
+     *  @return  Container of the compressed data.
+    */
+    template<typename Container = std::vector<unsigned char> >
+      Container
+      compress(const_bytes in)
+      {
+        Container out;
+        out.resize(this->bound(in.size()));
+        out.resize(this->compress(in, mutable_bytes(
+                   reinterpret_cast<unsigned char*>(&out[0]), out.size())));
+        return out;
+      }
+
+    /**
+     *  @brief  The underlying z_stream, for anything not wrapped here.
+    */
+    z_stream&
+    native() noexcept { return s_->strm; }
+
+  private:
+    // Free the stream after a failed deflateInit2() and throw
+    void
+    fail(int ret)
+    {
+      const char* msg = s_->strm.msg;
+      stream_type::destroy(s_);
+      if (ret == Z_MEM_ERROR)
+        throw std::bad_alloc();
+      throw error(ret, msg);
+    }
+
+    stream_type* s_;
+  };
+
+/*****************************************************************************/
+
+/**
+ *  @brief  Move-only owner of an inflate stream.
+ *  @param  W  Wrapper expected around the deflate data.
+ *  @param  Alloc  Allocator for the stream's memory.
+*/
+template<wrapper W = wrapper::zlib,
+         typename Alloc = std::allocator<unsigned char> >
+  class basic_inflater
+  {
+    typedef detail::stream<Alloc> stream_type;
+
+  public:
+    /**
+     *  @brief  Set up an inflate stream, as inflateInit2() does.
+     *  @param  window_bits  Base two logarithm of the largest window, 8..15.
+     *  @param  alloc  Allocator to get the stream's memory from.
+    */
+    explicit
+    basic_inflater(int window_bits = MAX_WBITS,
+                   const Alloc& alloc = Alloc())
+    : s_(stream_type::create(alloc))
+    {
+      int ret = inflateInit2(&s_->strm, detail::window_bits<W>::of(window_bits));
+      if (ret != Z_OK)
+        this->fail(ret);
+    }
+
+    basic_inflater(basic_inflater&& other) noexcept : s_(other.s_)
+    { other.s_ = NULL; }
+
+    basic_inflater&
+    operator=(basic_inflater&& other) noexcept
+    {
+      std::swap(s_, other.s_);
+      return *this;
+    }
+
+    basic_inflater(const basic_inflater&) = delete;
+    basic_inflater& operator=(const basic_inflater&) = delete;
+
+    ~basic_inflater()
+    {
+      if (s_ != NULL)
+      {
+        inflateEnd(&s_->strm);
+        stream_type::destroy(s_);
+      }
+    }
+
+    /**
+     *  @brief  Start a new stream, keeping the allocated state and window.
+    */
+    void
+    reset()
+    { detail::check(inflateReset(&s_->strm), s_->strm); }
+
+    /**
+     *  @brief  Decompress a step, as inflate() does.
+     *  @param  in  Input, advanced past what was consumed.
+     *  @param  out  Output space, advanced past what was written.
+     *  @param  flush  Z_NO_FLUSH, Z_SYNC_FLUSH, Z_FINISH, or Z_BLOCK.
+     *  @return  Z_OK, Z_STREAM_END, Z_NEED_DICT, or Z_BUF_ERROR if no
+     *           progress was possible.
+    */
+    int
+    inflate(const_bytes& in,
+            mutable_bytes& out,
+            int flush = Z_NO_FLUSH)
+    {
+      s_->load(in, out);
+      int ret = ::inflate(&s_->strm, flush);
+      s_->advance(in, out);
+      detail::check(ret, s_->strm);
+      return ret;
+    }
+
+    /**
+     *  @brief  Decompress one stream from in into out, starting anew.
+     *  @return  Number of bytes written to out.
+     *
+     *  Anything in in after the end of the stream is ignored.  Throws
+     *  error with code Z_BUF_ERROR if out is too small, or Z_DATA_ERROR
+     *  if in ends before the stream does.
+    */
+    std::size_t
+    decompress(const_bytes in,
+               mutable_bytes out)
+    {
+      this->reset();
+      std::size_t room = out.size();
+      int ret;
+      do {
+        ret = this->inflate(in, out);
+      } while (ret == Z_OK);
+      this->finished(ret, out);
+      return room - out.size();
+    }
+
+    /**
+     *  @brief  Decompress one stream from in, starting anew.
+     *  @param  size_hint  Expected decompressed size, if known.
+     *  @return  Container of the decompressed data.
+    */
+    template<typename Container = std::vector<unsigned char> >
+      Container
+      decompress(const_bytes in,
+                 std::size_t size_hint = 0)
+      {
+        this->reset();
+        Container out;
+        std::size_t have = 0;
+        out.resize(size_hint > 0 ? size_hint :
+                   in.size() < 256 ? 1024 : in.size() * 4);
+        for (;;)
+        {
+          if (have == out.size())
+            out.resize(out.size() * 2);
+          mutable_bytes room(reinterpret_cast<unsigned char*>(&out[0]) + have,
+                             out.size() - have);
+          int ret = this->inflate(in, room);
+          have = out.size() - room.size();
+          if (ret == Z_STREAM_END)
+            break;
+          // There was room, so anything else is out of input or a dictionary
+          if (ret != Z_OK)
+            this->finished(ret, room);
+        }
+        out.resize(have);
+        return out;
+      }
+
+    /**
+     *  @brief  The underlying z_stream, for anything not wrapped here.
+    */
+    z_stream&
+    native() noexcept { return s_->strm; }
+
+  private:
+    // Free the stream after a failed inflateInit2() and throw
+    void
+    fail(int ret)
+    {
+      const char* msg = s_->strm.msg;
+      stream_type::destroy(s_);
+      if (ret == Z_MEM_ERROR)
+        throw std::bad_alloc();
+      throw error(ret, msg);
+    }
+
+    // Throw unless ret from inflate() ended the stream, given the output
+    // space that was left
+    void
+    finished(int ret, mutable_bytes out) const
+    {
+      if (ret == Z_NEED_DICT)
+        throw error(ret, "dictionary needed");
+      if (ret != Z_STREAM_END)
+      {
+        if (out.empty())
+          throw error(Z_BUF_ERROR, "output buffer too small");
+        throw error(Z_DATA_ERROR, "incomplete stream");
+      }
+    }
+
+    stream_type* s_;
+  };
+
+/*****************************************************************************/
+
+typedef basic_deflater<wrapper::zlib> deflater;
+typedef basic_deflater<wrapper::gzip> gzip_deflater;
+typedef basic_deflater<wrapper::raw> raw_deflater;
+
+typedef basic_inflater<wrapper::zlib> inflater;
+typedef basic_inflater<wrapper::gzip> gzip_inflater;
+typedef basic_inflater<wrapper::raw> raw_inflater;
+
+} // namespace zpp
+
+#endif // ZPP_H
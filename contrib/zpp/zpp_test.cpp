@@ -0,0 +1,159 @@
+/*
+ * Test program for the zpp deflater and inflater
+ */
+
+#include "zpp.h"
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Allocator that counts the bytes it has outstanding
+static std::size_t outstanding = 0;
+
+template<typename T>
+  struct counting_allocator
+  {
+    typedef T value_type;
+
+    counting_allocator() { }
+    template<typename U>
+      counting_allocator(const counting_allocator<U>&) { }
+
+    T*
+    allocate(std::size_t n)
+    {
+      outstanding += n * sizeof(T);
+      return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void
+    deallocate(T* p, std::size_t n)
+    {
+      outstanding -= n * sizeof(T);
+      ::operator delete(p);
+    }
+  };
+
+template<typename T, typename U>
+  bool operator==(const counting_allocator<T>&, const counting_allocator<U>&)
+  { return true; }
+template<typename T, typename U>
+  bool operator!=(const counting_allocator<T>&, const counting_allocator<U>&)
+  { return false; }
+
+static void
+require(bool ok, const char* what)
+{
+  if (!ok)
+  {
+    std::cerr << "failed: " << what << std::endl;
+    std::exit(1);
+  }
+}
+
+// Compress and decompress text with wrapper W through the one-shot calls
+template<zpp::wrapper W>
+  static void
+  round_trip(const std::string& text, const char* what)
+  {
+    zpp::basic_deflater<W> def(6);
+    zpp::basic_inflater<W> inf;
+    for (int i = 0; i < 3; i++)   // reused after the first
+    {
+      std::vector<unsigned char> comp = def.compress(text);
+      std::string back = inf.template decompress<std::string>(comp);
+      require(back == text, what);
+    }
+  }
+
+int main() {
+
+  std::string text;
+  for (int i = 0; i < 20000; i++)
+    text += "The quick brown fox sidestepped the lazy canine " + std::to_string(i % 97) + "\n";
+
+  round_trip<zpp::wrapper::raw>(text, "raw round trip");
+  round_trip<zpp::wrapper::zlib>(text, "zlib round trip");
+  round_trip<zpp::wrapper::gzip>(text, "gzip round trip");
+  round_trip<zpp::wrapper::zlib>(std::string(), "empty round trip");
+
+  // The zlib wrapper is what uncompress() reads
+  zpp::deflater def;
+  std::vector<unsigned char> comp = def.compress(text);
+  std::vector<unsigned char> back(text.size());
+  uLongf len = back.size();
+  require(uncompress(&back[0], &len, &comp[0], comp.size()) == Z_OK &&
+          std::string(back.begin(), back.end()) == text, "uncompress");
+
+  // Step at a time through small buffers, then moved mid-stream
+  zpp::gzip_deflater gdef;
+  std::vector<unsigned char> gz;
+  zpp::const_bytes in(text);
+  unsigned char buf[100];
+  int ret;
+  do {
+    zpp::mutable_bytes out(buf);
+    ret = gdef.deflate(in, out, in.size() > 1000 ? Z_NO_FLUSH : Z_FINISH);
+    gz.insert(gz.end(), buf, out.data());
+    if (in.size() < text.size() / 2)
+    {
+      zpp::gzip_deflater moved(std::move(gdef));
+      gdef = std::move(moved);
+    }
+  } while (ret != Z_STREAM_END);
+  zpp::gzip_inflater ginf;
+  require(ginf.decompress<std::string>(gz, text.size()) == text, "steps");
+
+  // Fixed output buffers
+  std::vector<unsigned char> room(def.bound(text.size()));
+  std::size_t got = def.compress(text, room);
+  require(got == comp.size(), "compress into buffer");
+  zpp::inflater inf;
+  require(inf.decompress(zpp::const_bytes(&room[0], got), back) == text.size(),
+          "decompress into buffer");
+  try
+  {
+    std::vector<unsigned char> small(text.size() - 1);
+    inf.decompress(comp, small);
+    require(false, "small buffer");
+  }
+  catch (const zpp::error& e)
+  {
+    require(e.code() == Z_BUF_ERROR, "small buffer code");
+  }
+
+  // Damaged and incomplete input
+  try
+  {
+    comp[comp.size() / 2] ^= 0x55;
+    inf.decompress(comp);
+    require(false, "damaged input");
+  }
+  catch (const zpp::error& e)
+  {
+    require(e.code() == Z_DATA_ERROR, "damaged input code");
+  }
+  try
+  {
+    inf.decompress(zpp::const_bytes(&room[0], got - 8));
+    require(false, "incomplete input");
+  }
+  catch (const zpp::error& e)
+  {
+    require(e.code() == Z_DATA_ERROR, "incomplete input code");
+  }
+
+  // Injected allocator gets all of the stream's memory back
+  {
+    zpp::basic_deflater<zpp::wrapper::zlib, counting_allocator<unsigned char> > cdef(9);
+    zpp::basic_inflater<zpp::wrapper::zlib, counting_allocator<unsigned char> > cinf;
+    require(outstanding > 0, "allocator used");
+    require(cinf.decompress<std::string>(cdef.compress(text)) == text, "allocator round trip");
+  }
+  require(outstanding == 0, "allocator released");
+
+  std::cout << "zpp test OK" << std::endl;
+  return 0;
+
+}
@@ -103,6 +103,31 @@
 #  define ARMCRC32
 #endif
 
+/*
+  If available, use the carry-less multiply instructions, PCLMULQDQ and
+  VPCLMULQDQ on x86-64 or PMULL on little-endian ARMv8, to fold the data into
+  a CRC. These are detected at run time, so that the same compiled code runs on
+  processors with or without them. Define NO_CRC_FOLD to not use them.
+ */
+#if defined(W) && W == 8 && !defined(ARMCRC32) && !defined(MAKECRCH) && \
+    !defined(NO_CRC_FOLD)
+#  if defined(__x86_64__) && (defined(__clang__) || \
+      (defined(__GNUC__) && (__GNUC__ > 4 || \
+                             (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#    define CRC_FOLD
+#    define CRC_PCLMUL
+#    if (defined(__clang__) && __clang_major__ >= 6) || \
+        (!defined(__clang__) && __GNUC__ >= 8)
+#      define CRC_VPCLMUL
+#    endif
+#  elif defined(__aarch64__) && defined(__AARCH64EL__) && \
+        defined(__linux__) && !defined(Z_SOLO) && \
+        (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 8))
+#    define CRC_FOLD
+#    define CRC_PMULL
+#  endif
+#endif
+
 #if defined(W) && (!defined(ARMCRC32) || defined(DYNAMIC_CRC_TABLE))
 /*
   Swap the bytes in a z_word_t to convert between little and big endian. Any
@@ -740,6 +765,228 @@ local z_word_t crc_word_big(z_word_t data) {
 
 #endif
 
+#ifdef CRC_FOLD
+/* =========================================================================
+ * Fold the data into a CRC using carry-less multiplication, per "Fast CRC
+ * Computation for Generic Polynomials Using PCLMULQDQ Instruction" by Gopal,
+ * et al. (Intel, 2009). Each 128-bit lane of the message is multiplied by x^d
+ * modulo p(x), in two 64-bit halves, and exclusive-ored with the lane d bits
+ * later, until a 128-bit remainder is left that has the same CRC as the
+ * message. The CRC of that remainder is then computed with crc_word().
+ *
+ * The constants are x^(d+32) and x^(d-32) modulo p(x), reflected and shifted
+ * left one bit, for fold distances d of 128, 512, and 2048 bits.
+ */
+#define K128_LO 0x1751997d0
+#define K128_HI 0x0ccaa009e
+#define K512_LO 0x154442bd4
+#define K512_HI 0x1c6e41596
+#define K2048_LO 0x11542778a
+#define K2048_HI 0x1322d1430
+
+#define FOLD_MIN 64         /* fewest bytes worth folding */
+
+/* Fold function selected by crc_fold_init(), or NULL if none is available.
+   It requires that len be a multiple of 16 and at least FOLD_MIN. There is no
+   harm if more than one thread does the selection at the same time, as for
+   adler32_simd in adler32.c, so there is no need for once() here. */
+local z_crc_t (*crc_fold)(z_crc_t, const unsigned char FAR *, z_size_t);
+local volatile int crc_fold_done;
+
+/* Return the CRC of a 128-bit remainder, given as two little-endian words. */
+local z_crc_t fold_crc(z_word_t lo, z_word_t hi) {
+    return crc_word(hi ^ crc_word(lo));
+}
+
+#ifdef CRC_PCLMUL
+
+#include <immintrin.h>
+
+#define PCLMUL __attribute__((target("sse2,pclmul")))
+#define VPCLMUL __attribute__((target("sse2,pclmul,avx512f,vpclmulqdq")))
+
+/* Fold x forward by the distance for k, and add y. */
+local PCLMUL __m128i fold128(__m128i x, __m128i k, __m128i y) {
+    return _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x, k, 0x00),
+                                       _mm_clmulepi64_si128(x, k, 0x11)), y);
+}
+
+/* Fold 64 bytes at a time in four lanes, then 16 bytes at a time in one. */
+local PCLMUL z_crc_t crc_pclmul(z_crc_t crc, const unsigned char FAR *buf,
+                                z_size_t len) {
+    __m128i k, x0, x1, x2, x3;
+    z_word_t rem[2];
+
+    x0 = _mm_loadu_si128((const __m128i *)buf);
+    x0 = _mm_xor_si128(x0, _mm_cvtsi32_si128((int)crc));
+    x1 = _mm_loadu_si128((const __m128i *)(buf + 16));
+    x2 = _mm_loadu_si128((const __m128i *)(buf + 32));
+    x3 = _mm_loadu_si128((const __m128i *)(buf + 48));
+    buf += 64;
+    len -= 64;
+    k = _mm_set_epi64x(K512_HI, K512_LO);
+    while (len >= 64) {
+        x0 = fold128(x0, k, _mm_loadu_si128((const __m128i *)buf));
+        x1 = fold128(x1, k, _mm_loadu_si128((const __m128i *)(buf + 16)));
+        x2 = fold128(x2, k, _mm_loadu_si128((const __m128i *)(buf + 32)));
+        x3 = fold128(x3, k, _mm_loadu_si128((const __m128i *)(buf + 48)));
+        buf += 64;
+        len -= 64;
+    }
+    k = _mm_set_epi64x(K128_HI, K128_LO);
+    x0 = fold128(x0, k, x1);
+    x0 = fold128(x0, k, x2);
+    x0 = fold128(x0, k, x3);
+    while (len) {
+        x0 = fold128(x0, k, _mm_loadu_si128((const __m128i *)buf));
+        buf += 16;
+        len -= 16;
+    }
+    _mm_storeu_si128((__m128i *)rem, x0);
+    return fold_crc(rem[0], rem[1]);
+}
+
+#ifdef CRC_VPCLMUL
+
+/* Fold each of the four 128-bit lanes of x forward by the distance for k, and
+   add y. */
+local VPCLMUL __m512i fold512(__m512i x, __m512i k, __m512i y) {
+    return _mm512_ternarylogic_epi64(_mm512_clmulepi64_epi128(x, k, 0x00),
+                                     _mm512_clmulepi64_epi128(x, k, 0x11),
+                                     y, 0x96);
+}
+
+/* Fold 256 bytes at a time in sixteen lanes, then 64 bytes at a time in four,
+   then 16 bytes at a time in one. */
+local VPCLMUL z_crc_t crc_vpclmul(z_crc_t crc, const unsigned char FAR *buf,
+                                  z_size_t len) {
+    __m512i k, z0, z1, z2, z3;
+    __m128i j, x0;
+    z_word_t rem[2];
+
+    if (len < 256)
+        return crc_pclmul(crc, buf, len);
+    z0 = _mm512_loadu_si512((const void *)buf);
+    z0 = _mm512_xor_si512(z0, _mm512_inserti32x4(_mm512_setzero_si512(),
+                                          _mm_cvtsi32_si128((int)crc), 0));
+    z1 = _mm512_loadu_si512((const void *)(buf + 64));
+    z2 = _mm512_loadu_si512((const void *)(buf + 128));
+    z3 = _mm512_loadu_si512((const void *)(buf + 192));
+    buf += 256;
+    len -= 256;
+    k = _mm512_broadcast_i32x4(_mm_set_epi64x(K2048_HI, K2048_LO));
+    while (len >= 256) {
+        z0 = fold512(z0, k, _mm512_loadu_si512((const void *)buf));
+        z1 = fold512(z1, k, _mm512_loadu_si512((const void *)(buf + 64)));
+        z2 = fold512(z2, k, _mm512_loadu_si512((const void *)(buf + 128)));
+        z3 = fold512(z3, k, _mm512_loadu_si512((const void *)(buf + 192)));
+        buf += 256;
+        len -= 256;
+    }
+    k = _mm512_broadcast_i32x4(_mm_set_epi64x(K512_HI, K512_LO));
+    z0 = fold512(z0, k, z1);
+    z0 = fold512(z0, k, z2);
+    z0 = fold512(z0, k, z3);
+    while (len >= 64) {
+        z0 = fold512(z0, k, _mm512_loadu_si512((const void *)buf));
+        buf += 64;
+        len -= 64;
+    }
+    j = _mm_set_epi64x(K128_HI, K128_LO);
+    x0 = fold128(_mm512_castsi512_si128(z0), j,
+                 _mm512_extracti32x4_epi32(z0, 1));
+    x0 = fold128(x0, j, _mm512_extracti32x4_epi32(z0, 2));
+    x0 = fold128(x0, j, _mm512_extracti32x4_epi32(z0, 3));
+    while (len) {
+        x0 = fold128(x0, j, _mm_loadu_si128((const __m128i *)buf));
+        buf += 16;
+        len -= 16;
+    }
+    _mm_storeu_si128((__m128i *)rem, x0);
+    return fold_crc(rem[0], rem[1]);
+}
+
+#endif /* CRC_VPCLMUL */
+
+/* Select the widest fold the processor and the operating system support. */
+local void crc_fold_init(void) {
+    unsigned feat = z_cpu_features();
+
+    if (feat & Z_CPU_PCLMUL) {
+        crc_fold = crc_pclmul;
+#ifdef CRC_VPCLMUL
+        if (feat & Z_CPU_VPCLMUL)
+            crc_fold = crc_vpclmul;
+#endif
+    }
+    crc_fold_done = 1;
+}
+
+#else /* CRC_PMULL */
+
+#include <arm_neon.h>
+
+#ifdef __clang__
+#  define PMULL __attribute__((target("crypto")))
+#else
+#  define PMULL __attribute__((target("+crypto")))
+#endif
+
+/* Fold x forward by the distance for k, and add y. */
+local PMULL uint64x2_t fold128(uint64x2_t x, uint64x2_t k, uint64x2_t y) {
+    poly128_t lo, hi;
+
+    lo = vmull_p64((poly64_t)vgetq_lane_u64(x, 0),
+                   (poly64_t)vgetq_lane_u64(k, 0));
+    hi = vmull_high_p64(vreinterpretq_p64_u64(x), vreinterpretq_p64_u64(k));
+    return veorq_u64(veorq_u64(vreinterpretq_u64_p128(lo),
+                               vreinterpretq_u64_p128(hi)), y);
+}
+
+/* Fold 64 bytes at a time in four lanes, then 16 bytes at a time in one. */
+local PMULL z_crc_t crc_pmull(z_crc_t crc, const unsigned char FAR *buf,
+                              z_size_t len) {
+    uint64x2_t k, x0, x1, x2, x3;
+
+    x0 = vld1q_u64((const uint64_t *)buf);
+    x0 = veorq_u64(x0, vcombine_u64(vcreate_u64(crc), vcreate_u64(0)));
+    x1 = vld1q_u64((const uint64_t *)(buf + 16));
+    x2 = vld1q_u64((const uint64_t *)(buf + 32));
+    x3 = vld1q_u64((const uint64_t *)(buf + 48));
+    buf += 64;
+    len -= 64;
+    k = vcombine_u64(vcreate_u64(K512_LO), vcreate_u64(K512_HI));
+    while (len >= 64) {
+        x0 = fold128(x0, k, vld1q_u64((const uint64_t *)buf));
+        x1 = fold128(x1, k, vld1q_u64((const uint64_t *)(buf + 16)));
+        x2 = fold128(x2, k, vld1q_u64((const uint64_t *)(buf + 32)));
+        x3 = fold128(x3, k, vld1q_u64((const uint64_t *)(buf + 48)));
+        buf += 64;
+        len -= 64;
+    }
+    k = vcombine_u64(vcreate_u64(K128_LO), vcreate_u64(K128_HI));
+    x0 = fold128(x0, k, x1);
+    x0 = fold128(x0, k, x2);
+    x0 = fold128(x0, k, x3);
+    while (len) {
+        x0 = fold128(x0, k, vld1q_u64((const uint64_t *)buf));
+        buf += 16;
+        len -= 16;
+    }
+    return fold_crc(vgetq_lane_u64(x0, 0), vgetq_lane_u64(x0, 1));
+}
+
+/* Use PMULL if the processor has it. */
+local void crc_fold_init(void) {
+    if (z_cpu_features() & Z_CPU_PMULL)
+        crc_fold = crc_pmull;
+    crc_fold_done = 1;
+}
+
+#endif /* CRC_PCLMUL */
+
+#endif /* CRC_FOLD */
+
 /* ========================================================================= */
 unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
                               z_size_t len) {
@@ -753,6 +1000,21 @@ unsigned long ZEXPORT crc32_z(unsigned long crc, const unsigned char FAR *buf,
     /* Pre-condition the CRC */
     crc = (~crc) & 0xffffffff;
 
+#ifdef CRC_FOLD
+    /* If provided enough bytes and the instructions are there, fold the data
+       16 bytes at a time, leaving the rest to the code below. */
+    if (!crc_fold_done)
+        crc_fold_init();
+    if (crc_fold != Z_NULL && len >= FOLD_MIN) {
+        z_size_t fold;
+
+        fold = len & ~(z_size_t)15;
+        crc = crc_fold((z_crc_t)crc, buf, fold);
+        buf += fold;
+        len -= fold;
+    }
+#endif
+
 #ifdef W
 
     /* If provided enough bytes, do a braided CRC calculation. */
@@ -1106,3 +1368,95 @@ uLong ZEXPORT crc32_combine_op(uLong crc1, uLong crc2, uLong op) {
     }
     return multmodp(op, crc1) ^ (crc2 & 0xffffffff);
 }
+
+/* ========================================================================= */
+void ZEXPORT crc32_combine_init(z_combinep ctx) {
+    ctx->used = 0;
+    ctx->next = 0;
+}
+
+/*
+  Return the operator for len from the cache in ctx, or generate it and put it
+  in the cache, replacing the cached operators in turn once all are used. The
+  most recently used operator is checked first.
+ */
+local z_crc_t combine_op(z_combinep ctx, z_size_t len) {
+    unsigned n, last;
+    z_crc_t op;
+
+    last = (ctx->next + 7) & 7;
+    if (ctx->used && ctx->len[last] == len)
+        return (z_crc_t)ctx->op[last];
+    for (n = 0; n < ctx->used; n++)
+        if (ctx->len[n] == len)
+            return (z_crc_t)ctx->op[n];
+#ifdef DYNAMIC_CRC_TABLE
+    once(&made, make_crc_table);
+#endif /* DYNAMIC_CRC_TABLE */
+    op = x2nmodp((z_off64_t)len, 3);
+    n = ctx->next;
+    ctx->len[n] = len;
+    ctx->op[n] = op;
+    ctx->next = (n + 1) & 7;
+    if (ctx->used < 8)
+        ctx->used++;
+    return op;
+}
+
+/* ========================================================================= */
+uLong ZEXPORT crc32_combine_ctx(z_combinep ctx, uLong crc1, uLong crc2,
+                                z_size_t len2) {
+    return multmodp(combine_op(ctx, len2), (z_crc_t)crc1) ^
+           (crc2 & 0xffffffff);
+}
+
+/*
+  Fill mul[][] with the products of op and each byte in each position of a
+  CRC, so that multmodp(op, crc) is the exclusive-or of four table entries.
+ */
+local void combine_table(z_crc_t mul[][256], z_crc_t op) {
+    unsigned k, b;
+
+    for (k = 0; k < 4; k++) {
+        mul[k][0] = 0;
+        for (b = 1; b < 256; b <<= 1)
+            mul[k][b] = multmodp(op, (z_crc_t)b << (k << 3));
+        for (b = 3; b < 256; b++)
+            if (b & (b - 1))
+                mul[k][b] = mul[k][b & (b - 1)] ^ mul[k][b & (0 - b)];
+    }
+}
+
+/* Pieces left at which a run of the same length gets a table for its operator
+   in crc32_combine_vec(), paying back the 32 multmodp() calls to build it */
+#define COMBINE_RUN 64
+
+/* ========================================================================= */
+uLong ZEXPORT crc32_combine_vec(uLong crc, const z_check *checks,
+                                unsigned count) {
+    z_combine ctx;
+    z_crc_t val, op;
+    z_crc_t mul[4][256];        /* products for the operator of mullen */
+    z_size_t mullen = 0;        /* length with its operator in mul[][] */
+    int have = 0;               /* true if mul[][] is filled */
+
+    crc32_combine_init(&ctx);
+    val = (z_crc_t)crc;
+    for (; count; count--, checks++) {
+        if (have && checks->len == mullen) {
+            val = mul[0][val & 0xff] ^ mul[1][(val >> 8) & 0xff] ^
+                  mul[2][(val >> 16) & 0xff] ^ mul[3][val >> 24] ^
+                  (z_crc_t)checks->check;
+            continue;
+        }
+        op = combine_op(&ctx, checks->len);
+        if (count >= COMBINE_RUN && checks[1].len == checks->len) {
+            /* a run of the same length, as for equal chunks */
+            combine_table(mul, op);
+            mullen = checks->len;
+            have = 1;
+        }
+        val = multmodp(op, val) ^ (z_crc_t)checks->check;
+    }
+    return val;
+}
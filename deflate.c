@@ -73,10 +73,13 @@ typedef block_state (*compress_func)(deflate_state *s, int flush);
 local block_state deflate_stored(deflate_state *s, int flush);
 local block_state deflate_fast(deflate_state *s, int flush);
 #ifndef FASTEST
+local block_state deflate_medium(deflate_state *s, int flush);
 local block_state deflate_slow(deflate_state *s, int flush);
+local block_state deflate_optimal(deflate_state *s, int flush);
 #endif
 local block_state deflate_rle(deflate_state *s, int flush);
 local block_state deflate_huff(deflate_state *s, int flush);
+local block_state deflate_quick(deflate_state *s, int flush);
 
 /* ===========================================================================
  * Local data
@@ -90,8 +93,11 @@ local block_state deflate_huff(deflate_state *s, int flush);
 #endif
 /* Matches of length 3 are discarded if their distance exceeds TOO_FAR */
 
+/* Maximum stored block length in deflate format (not including header). */
+#define MAX_STORED 65535
+
 /* Values for max_lazy_match, good_match and max_chain_length, depending on
- * the desired pack level (0..9). The values given below have been tuned to
+ * the desired pack level (0..10). The values given below have been tuned to
  * exclude worst case performance for pathological files. Better values may be
  * found for specific files.
  */
@@ -109,25 +115,109 @@ local const config configuration_table[2] = {
 /* 0 */ {0,    0,  0,    0, deflate_stored},  /* store only */
 /* 1 */ {4,    4,  8,    4, deflate_fast}}; /* max speed, no lazy matches */
 #else
-local const config configuration_table[10] = {
+local const config configuration_table[11] = {
 /*      good lazy nice chain */
 /* 0 */ {0,    0,  0,    0, deflate_stored},  /* store only */
 /* 1 */ {4,    4,  8,    4, deflate_fast}, /* max speed, no lazy matches */
 /* 2 */ {4,    5, 16,    8, deflate_fast},
 /* 3 */ {4,    6, 32,   32, deflate_fast},
 
-/* 4 */ {4,    4, 16,   16, deflate_slow},  /* lazy matches */
-/* 5 */ {8,   16, 32,   32, deflate_slow},
+/* 4 */ {4,   16, 16,   16, deflate_medium},  /* one-step lookahead */
+/* 5 */ {8,   16, 32,   32, deflate_slow},     /* lazy matches */
 /* 6 */ {8,   16, 128, 128, deflate_slow},
 /* 7 */ {8,   32, 128, 256, deflate_slow},
 /* 8 */ {32, 128, 258, 1024, deflate_slow},
-/* 9 */ {32, 258, 258, 4096, deflate_slow}}; /* max compression */
+/* 9 */ {32, 258, 258, 4096, deflate_slow},  /* max compression */
+
+/* 10 */ {0,   15, 258, 4096, deflate_optimal}};  /* optimal parsing */
 #endif
 
 /* Note: the deflate() code requires max_lazy >= MIN_MATCH and max_chain >= 4
- * For deflate_fast() (levels <= 3) good is ignored and lazy has a different
- * meaning.
+ * For deflate_fast() (levels <= 3) and deflate_medium() (level 4) good is
+ * ignored and lazy has a different meaning. For deflate_optimal() (level 10)
+ * good is ignored and lazy is the number of parsing passes.
+ */
+
+#if !defined(Z_SOLO) && !defined(FASTEST)
+#  define DEFLATE_ADAPT
+
+/* The search parameters that deflateThroughput() steps through, slowest last.
+ * A stream only moves among the contiguous entries with the compress function
+ * of its level, so that the parsing state carries over from one deflate()
+ * call to the next. Levels 1..3 start at entries 0..2 and levels 5..9 at
+ * entries 5..9. Entries 3 and 4 extend the lazy levels below level 5.
+ */
+local const config adapt_table[ADAPT_STEPS] = {
+/*      good lazy nice chain */
+/* 0 */ {4,    4,  8,    4, deflate_fast},
+/* 1 */ {4,    5, 16,    8, deflate_fast},
+/* 2 */ {4,    6, 32,   32, deflate_fast},
+/* 3 */ {4,    4,  8,    4, deflate_slow},
+/* 4 */ {4,    8, 16,    8, deflate_slow},
+/* 5 */ {8,   16, 32,   32, deflate_slow},
+/* 6 */ {8,   16, 128, 128, deflate_slow},
+/* 7 */ {8,   32, 128, 256, deflate_slow},
+/* 8 */ {32, 128, 258, 1024, deflate_slow},
+/* 9 */ {32, 258, 258, 4096, deflate_slow}};
+
+#define ADAPT_BYTES 131072
+/* input bytes compressed between decisions of deflate_adapt() */
+
+/* ===========================================================================
+ * Start deflateThroughput() adaptation at the parameters of the level, and
+ * forget the rates measured before. Levels without a run of entries in
+ * adapt_table are not adapted.
+ */
+local void adapt_start(deflate_state *s) {
+    s->adapt_step = s->level >= 1 && s->level <= 3 ? s->level - 1 :
+                    s->level >= 5 && s->level <= 9 ? s->level : -1;
+    s->adapt_in = 0;
+    s->adapt_us = 0;
+    zmemzero((Bytef *)s->adapt_seen, sizeof(s->adapt_seen));
+}
+#endif
+
+#define OPT_CHUNK 8192
+/* number of input bytes parsed at a time by deflate_optimal() */
+
+#define OPT_PAIRS 8
+/* most match lengths kept by deflate_optimal() at each position */
+
+#define d_index(dist) ((dist) < 256 ? (dist) : 256 + ((dist) >> 7))
+/* index of the code for distance dist + 1 in _dist_code[], and in the costs
+   of deflate_optimal() */
+
+/* Matches and parse for deflate_optimal(). At each position of a chunk of the
+ * input, the matches are kept as the closest match for each of up to
+ * OPT_PAIRS increasing lengths. All shorter lengths, down to MIN_MATCH, can
+ * use the closest match that is at least that long. The parse is a list of
+ * symbols, each a match length and distance, or a length of one and distance
+ * zero for a literal.
  */
+typedef struct opt_state_s {
+    uch pairs[OPT_CHUNK];               /* number of matches at position */
+    ush mlen[OPT_CHUNK][OPT_PAIRS];     /* increasing match lengths */
+    ush mdist[OPT_CHUNK][OPT_PAIRS];    /* and their distances */
+    uInt cost[OPT_CHUNK + 1];           /* least cost to reach position */
+    ush from[OPT_CHUNK + 1];            /* length of the last symbol there */
+    ush from_dist[OPT_CHUNK + 1];       /* and its distance */
+    ush try_len[OPT_CHUNK];             /* parse from the last pass */
+    ush try_dist[OPT_CHUNK];
+    ush len[OPT_CHUNK];                 /* best parse, being tallied */
+    ush dist[OPT_CHUNK];
+    unsigned count;                     /* number of symbols in the parse */
+    unsigned next;                      /* next symbol to tally */
+    uch lit_cost[LITERALS];             /* costs in bits of each literal, */
+    uch len_cost[MAX_MATCH + 1];        /* match length, */
+    uch dist_cost[512];                 /* and distance, as d_code() */
+} FAR opt_state;
+
+#define RAND_SPAN 4096
+/* input bytes looked at for randomness at a time */
+
+#define RAND_WAIT (4 * RAND_SPAN)
+#define RAND_WAIT_MAX (32 * RAND_SPAN)
+/* first and longest waits after input that was not random */
 
 /* rank Z_BLOCK between Z_NO_FLUSH and Z_PARTIAL_FLUSH */
 #define RANK(f) (((f) * 2) - ((f) > 4 ? 9 : 0))
@@ -140,6 +230,16 @@ local const config configuration_table[10] = {
  */
 #define UPDATE_HASH(s,h,c) (h = (((h) << s->hash_shift) ^ (c)) & s->hash_mask)
 
+/* ===========================================================================
+ * Return the index into head[] for the hash value h.  For the default
+ * Z_HASH_SHIFT, h is the index.  For Z_HASH_MULTIPLY, UPDATE_HASH() keeps the
+ * last MIN_MATCH bytes in h, and the index is the high hash_bits bits of the
+ * low 32 bits of h times a large odd constant.  Every input bit affects the
+ * index, where the shift-xor hash drops the high bits of the oldest byte.
+ */
+#define HASH_INDEX(s,h) \
+    ((uInt)(((ulg)(h) * s->hash_mul) & 0xffffffffUL) >> s->hash_out)
+
 
 /* ===========================================================================
  * Insert string str in the dictionary and set match_head to the previous head
@@ -154,13 +254,14 @@ local const config configuration_table[10] = {
 #ifdef FASTEST
 #define INSERT_STRING(s, str, match_head) \
    (UPDATE_HASH(s, s->ins_h, s->window[(str) + (MIN_MATCH-1)]), \
-    match_head = s->head[s->ins_h], \
-    s->head[s->ins_h] = (Pos)(str))
+    match_head = s->head[HASH_INDEX(s, s->ins_h)], \
+    s->head[HASH_INDEX(s, s->ins_h)] = (Pos)(str))
 #else
 #define INSERT_STRING(s, str, match_head) \
    (UPDATE_HASH(s, s->ins_h, s->window[(str) + (MIN_MATCH-1)]), \
-    match_head = s->prev[(str) & s->w_mask] = s->head[s->ins_h], \
-    s->head[s->ins_h] = (Pos)(str))
+    match_head = s->prev[(str) & s->w_mask] = \
+        s->head[HASH_INDEX(s, s->ins_h)], \
+    s->head[HASH_INDEX(s, s->ins_h)] = (Pos)(str))
 #endif
 
 /* ===========================================================================
@@ -174,6 +275,114 @@ local const config configuration_table[10] = {
                  (unsigned)(s->hash_size - 1)*sizeof(*s->head)); \
     } while (0)
 
+/* ===========================================================================
+ * Clear only the head[] entries that the strings in the window could have set,
+ * for a reset after only a little data.  This recomputes the hash for each
+ * position in the window, with one UPDATE_HASH() per byte as INSERT_STRING()
+ * does, so it relies on hash_shift pushing each byte out of the hash after
+ * MIN_MATCH updates.
+ */
+local void clear_hash_used(deflate_state *s) {
+    ulg have = (ulg)s->strstart + s->lookahead;
+    ulg str;
+    uInt h = 0;
+
+    if (have > s->high_water)
+        have = s->high_water;
+    if (have < MIN_MATCH)
+        return;
+    UPDATE_HASH(s, h, s->window[0]);
+    UPDATE_HASH(s, h, s->window[1]);
+#if MIN_MATCH != 3
+    Call UPDATE_HASH() MIN_MATCH-3 more times
+#endif
+    for (str = 0; str + MIN_MATCH <= have; str++) {
+        UPDATE_HASH(s, h, s->window[str + MIN_MATCH-1]);
+        s->head[HASH_INDEX(s, h)] = NIL;
+    }
+}
+
+/*
+  If available, slide the hash tables eight or 16 entries at a time with
+  saturating vector subtracts, which leave NIL for positions that fall out of
+  the window: SSE2 on x86-64, or AVX2 if selected at run time, or NEON on
+  aarch64.  The table sizes are powers of two no less than 256, so there is no
+  remainder.  Define NO_SLIDE_SIMD to use the scalar loops.
+ */
+#ifndef NO_SLIDE_SIMD
+#  if defined(__x86_64__) && (defined(__clang__) || \
+      (defined(__GNUC__) && (__GNUC__ > 4 || \
+                             (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#    define SLIDE_SSE2
+#  elif defined(__aarch64__) && defined(__ARM_NEON)
+#    define SLIDE_NEON
+#  endif
+#endif
+
+#ifdef SLIDE_SSE2
+
+#include <immintrin.h>
+
+/* Slide the n entries at p down by wsize, eight at a time. */
+local void slide_sse2(Posf *p, unsigned n, uInt wsize) {
+    const __m128i w = _mm_set1_epi16((short)wsize);
+
+    do {
+        _mm_storeu_si128((__m128i *)p,
+                         _mm_subs_epu16(_mm_loadu_si128((__m128i *)p), w));
+        p += 8;
+    } while (n -= 8);
+}
+
+/* Slide the n entries at p down by wsize, 16 at a time. */
+local __attribute__((target("avx2")))
+void slide_avx2(Posf *p, unsigned n, uInt wsize) {
+    const __m256i w = _mm256_set1_epi16((short)wsize);
+
+    do {
+        _mm256_storeu_si256((__m256i *)p,
+                        _mm256_subs_epu16(_mm256_loadu_si256((__m256i *)p), w));
+        p += 16;
+    } while (n -= 16);
+}
+
+/* Kernel selected by slide_simd_init(). As for adler32_simd, there is no harm
+   if more than one thread does the selection at the same time. */
+local void (*slide_simd)(Posf *, unsigned, uInt) = slide_sse2;
+local volatile int slide_simd_done;
+
+/* Use AVX2 if the processor and the operating system support it. */
+local void slide_simd_init(void) {
+    if (z_cpu_features() & Z_CPU_AVX2)
+        slide_simd = slide_avx2;
+    slide_simd_done = 1;
+}
+
+/* Slide the n entries at p down by wsize. */
+local void slide_table(Posf *p, unsigned n, uInt wsize) {
+    if (!slide_simd_done)
+        slide_simd_init();
+    slide_simd(p, n, wsize);
+}
+#  define SLIDE_SIMD
+
+#elif defined(SLIDE_NEON)
+
+#include <arm_neon.h>
+
+/* Slide the n entries at p down by wsize, eight at a time. */
+local void slide_table(Posf *p, unsigned n, uInt wsize) {
+    const uint16x8_t w = vdupq_n_u16((uint16_t)wsize);
+
+    do {
+        vst1q_u16(p, vqsubq_u16(vld1q_u16(p), w));
+        p += 8;
+    } while (n -= 8);
+}
+#  define SLIDE_SIMD
+
+#endif
+
 /* ===========================================================================
  * Slide the hash table when sliding the window down (could be avoided with 32
  * bit values at the expense of memory usage). We slide even when level == 0 to
@@ -185,9 +394,22 @@ local const config configuration_table[10] = {
 #  endif
 #endif
 local void slide_hash(deflate_state *s) {
+    uInt wsize = s->w_size;
+
+    s->hash_stale = 1;
+    Stat(s->stats.slides++);
+    Probe1(slide_hash, wsize);
+#ifdef SLIDE_SIMD
+
+    Assert(NIL == 0 && (s->hash_size & 15) == 0 && (wsize & 15) == 0,
+           "cannot slide tables with vectors");
+    slide_table(s->head, s->hash_size, wsize);
+#  ifndef FASTEST
+    slide_table(s->prev, wsize, wsize);
+#  endif
+#else
     unsigned n, m;
     Posf *p;
-    uInt wsize = s->w_size;
 
     n = s->hash_size;
     p = &s->head[n];
@@ -206,6 +428,7 @@ local void slide_hash(deflate_state *s) {
          */
     } while (--n);
 #endif
+#endif
 }
 
 /* ===========================================================================
@@ -226,7 +449,8 @@ local unsigned read_buf(z_streamp strm, Bytef *buf, unsigned size) {
     if (strm->avail_in < len || UINT_MAX - strm->avail_in < len) return 0; // Prevent underflow and overflow
     strm->avail_in -= len;
 
-    zmemcpy(buf, strm->next_in, len);
+    if (buf != strm->next_in)       /* else the window is the input */
+        zmemcpy(buf, strm->next_in, len);
     if (strm->state->wrap == 1) {
         strm->adler = adler32(strm->adler, buf, len);
     }
@@ -245,11 +469,25 @@ local unsigned read_buf(z_streamp strm, Bytef *buf, unsigned size) {
     return len;
 }
 
+/* ===========================================================================
+ * Stop using the input as the window for deflateOneShot(), by copying the
+ * window contents so far to the allocated window.  The positions are the same.
+ */
+local void window_own(deflate_state *s) {
+    ulg have = (ulg)s->strstart + s->lookahead;
+
+    zmemcpy(s->window_buf, s->window, (unsigned)have);
+    s->window = s->window_buf;
+    s->high_water = have;
+    s->direct = 0;
+}
+
 /* ===========================================================================
  * Fill the window when the lookahead becomes insufficient.
  * Updates strstart and lookahead.
  *
- * IN assertion: lookahead < MIN_LOOKAHEAD
+ * IN assertion: lookahead < MIN_LOOKAHEAD, or for deflate_optimal(), there
+ *    is room in the window to read more, or to slide it
  * OUT assertions: strstart <= window_size-MIN_LOOKAHEAD
  *    At least one byte has been read, or avail_in == 0; reads are
  *    performed for at least two bytes (required for the zip translate_eol
@@ -260,9 +498,31 @@ local void fill_window(deflate_state *s) {
     unsigned more;    /* Amount of free space at the end of the window. */
     uInt wsize = s->w_size;
 
-    Assert(s->lookahead < MIN_LOOKAHEAD, "already enough lookahead");
+    Assert(s->lookahead < MIN_LOOKAHEAD ||
+           (ulg)s->strstart + s->lookahead < s->window_size ||
+           s->strstart >= wsize + MAX_DIST(s), "already enough lookahead");
+
+    /* After deflateOneShot(), use the input as the window from the start --
+       the input then always ends at window + strstart + lookahead */
+    if (s->direct == 1) {
+        s->direct = 0;
+        if (s->strstart == 0 && s->lookahead == 0 &&
+            s->strm->avail_in > MAX_MATCH) {
+            s->window = (Bytef *)s->strm->next_in;
+            s->direct = 2;
+        }
+    }
 
     do {
+        /* The matching can read up to MAX_MATCH bytes past the lookahead,
+           so keep that many bytes of input unread while using the input as
+           the window, and copy the window to its own memory before reading
+           the end of the input, or if some other input has been provided. */
+        if (s->direct == 2 && (s->strm->avail_in <= MAX_MATCH ||
+                               s->strm->next_in !=
+                               s->window + s->strstart + s->lookahead))
+            window_own(s);
+
         more = (unsigned)(s->window_size -(ulg)s->lookahead -(ulg)s->strstart);
 
         /* Deal with !@#$% 64K limit: */
@@ -283,10 +543,14 @@ local void fill_window(deflate_state *s) {
          */
         if (s->strstart >= wsize + MAX_DIST(s)) {
 
-            zmemcpy(s->window, s->window + wsize, (unsigned)wsize - more);
+            if (s->direct == 2)
+                s->window += wsize;
+            else
+                zmemcpy(s->window, s->window + wsize, (unsigned)wsize - more);
             s->match_start -= wsize;
             s->strstart    -= wsize; /* we now have strstart >= MAX_DIST */
             s->block_start -= (long) wsize;
+            s->rand_next = s->rand_next > wsize ? s->rand_next - wsize : 0;
             if (s->insert > s->strstart)
                 s->insert = s->strstart;
             slide_hash(s);
@@ -305,10 +569,13 @@ local void fill_window(deflate_state *s) {
          * Otherwise, window_size == 2*WSIZE so more >= 2.
          * If there was sliding, more >= WSIZE. So in all cases, more >= 2.
          */
-        Assert(more >= 2, "more < 2");
+        Assert(more >= 2 || s->lookahead >= MIN_LOOKAHEAD, "more < 2");
 
+        if (s->direct == 2 && more > s->strm->avail_in - MAX_MATCH)
+            more = s->strm->avail_in - MAX_MATCH;
         n = read_buf(s->strm, s->window + s->strstart + s->lookahead, more);
         s->lookahead += n;
+        Probe2(fill_window, n, s->lookahead);
 
         /* Initialize the hash value now that we have some input: */
         if (s->lookahead + s->insert >= MIN_MATCH) {
@@ -321,9 +588,9 @@ local void fill_window(deflate_state *s) {
             while (s->insert) {
                 UPDATE_HASH(s, s->ins_h, s->window[str + MIN_MATCH-1]);
 #ifndef FASTEST
-                s->prev[str & s->w_mask] = s->head[s->ins_h];
+                s->prev[str & s->w_mask] = s->head[HASH_INDEX(s, s->ins_h)];
 #endif
-                s->head[s->ins_h] = (Pos)str;
+                s->head[HASH_INDEX(s, s->ins_h)] = (Pos)str;
                 str++;
                 s->insert--;
                 if (s->lookahead + s->insert < MIN_MATCH)
@@ -343,7 +610,7 @@ local void fill_window(deflate_state *s) {
      * time through here.  WIN_INIT is set to MAX_MATCH since the longest match
      * routines allow scanning to strstart + MAX_MATCH, ignoring lookahead.
      */
-    if (s->high_water < s->window_size) {
+    if (s->high_water < s->window_size && s->direct != 2) {
         ulg curr = s->strstart + (ulg)(s->lookahead);
         ulg init;
 
@@ -386,8 +653,257 @@ int ZEXPORT deflateInit_(z_streamp strm, int level, const char *version,
 int ZEXPORT deflateInit2_(z_streamp strm, int level, int method,
                           int windowBits, int memLevel, int strategy,
                           const char *version, int stream_size) {
+    return deflatePoolInit2_(strm, Z_NULL, level, method, windowBits,
+                             memLevel, strategy, version, stream_size);
+}
+
+#ifndef MAXSEG_64K
+/* ===========================================================================
+ * The window, prev, head, and pending_buf arrays are carved out of the same
+ * allocation as the deflate_state, each aligned to a cache line.  The array
+ * sizes are multiples of a 4K page, so each array starts one cache line
+ * further into a page than the one before it, in order to keep the starts of
+ * the arrays from competing for the same cache sets.  On 16-bit machines with
+ * 64K segments, each array is allocated separately.
+ */
+#define LINE 64
+
+/* Return the size of the single allocation for the given parameters. */
+local ulg deflate_size(uInt w_bits, uInt hash_bits, uInt lit_bufsize) {
+    return sizeof(deflate_state) + (LINE - 1) + 3 * LINE +
+           ((ulg)2 << w_bits) + ((ulg)sizeof(Pos) << w_bits) +
+           ((ulg)sizeof(Pos) << hash_bits) + (ulg)lit_bufsize * LIT_BUFS;
+}
+
+/* Point the tree descriptors of s at its own trees, after s is copied. */
+local void deflate_relink(deflate_state *s) {
+    s->l_desc.dyn_tree = s->dyn_ltree;
+    s->d_desc.dyn_tree = s->dyn_dtree;
+    s->bl_desc.dyn_tree = s->bl_tree;
+}
+
+/* Point the arrays of s into the allocation that starts with s. */
+local void deflate_carve(deflate_state *s) {
+    Bytef *p = (Bytef *)s + sizeof(deflate_state);
+
+    p += (LINE - (z_size_t)p % LINE) % LINE;
+    s->window_buf = p;
+    p += 2 * (ulg)s->w_size + LINE;
+    s->prev = (Posf *)p;
+    p += s->w_size * sizeof(Pos) + LINE;
+    s->head = (Posf *)p;
+    p += s->hash_size * sizeof(Pos) + LINE;
+    s->pending_buf = (uchf *)p;
+}
+
+/* Copy the state ss and its buffers to ds, the start of an allocation of
+ * deflate_size() bytes for the sizes of ss.  ds->strm and ds->opt are left
+ * the same as for ss, for the caller to replace.
+ */
+local void deflate_dup(deflate_state *ds, deflate_state *ss) {
+    zmemcpy((voidpf)ds, (voidpf)ss, sizeof(deflate_state));
+    ds->share = Z_NULL;
+
+    deflate_carve(ds);
+    ds->window = ds->window_buf;
+    if (ss->direct == 2) {
+        /* copy only what is in the window -- the rest is not ours to read */
+        ds->high_water = (ulg)ss->strstart + ss->lookahead;
+        ds->direct = 0;
+        zmemcpy(ds->window, ss->window, (unsigned)ds->high_water);
+    }
+    else
+        zmemcpy(ds->window, ss->window, ds->w_size * 2 * sizeof(Byte));
+    zmemcpy((voidpf)ds->prev, (voidpf)ss->prev, ds->w_size * sizeof(Pos));
+    zmemcpy((voidpf)ds->head, (voidpf)ss->head, ds->hash_size * sizeof(Pos));
+    zmemcpy(ds->pending_buf, ss->pending_buf, ds->lit_bufsize * LIT_BUFS);
+
+    ds->pending_out = ds->pending_buf + (ss->pending_out - ss->pending_buf);
+#ifdef LIT_MEM
+    ds->d_buf = (ushf *)(ds->pending_buf + (ds->lit_bufsize << 1));
+    ds->l_buf = ds->pending_buf + (ds->lit_bufsize << 2);
+#else
+    ds->sym_buf = ds->pending_buf + ds->lit_bufsize;
+#endif
+    deflate_relink(ds);
+}
+
+/* ===========================================================================
+ * Release the buffers of the stream if it is between messages, keeping only
+ * the state and the last window's worth of history.  The match buffers of
+ * level 10 are released too, since their parse has all been tallied.  Return
+ * Z_OK if it was released, Z_BUF_ERROR if it is not between messages, or
+ * Z_MEM_ERROR.
+ */
+local int deflate_idle(z_streamp strm) {
+    deflate_state *s = strm->state;
+    deflate_state *ns;
+    deflate_share FAR *share = s->share;
+    uInt keep, delta;
+
+    if (s->idle)
+        return Z_OK;
+    if (s->pending || s->lookahead || s->match_available || s->sym_next ||
+        s->block_start != (long)s->strstart || s->block_open ||
+        s->split_keep || s->fit != FIT_OFF || s->offloaded > 0 ||
+        s->direct == 2 || (s->opt != Z_NULL && s->opt->next < s->opt->count))
+        return Z_BUF_ERROR;
+    keep = s->strstart < s->w_size ? s->strstart : s->w_size;
+    ns = (deflate_state *) ZALLOC(strm, 1, sizeof(deflate_state) + keep);
+    if (ns == Z_NULL) return Z_MEM_ERROR;
+    zmemcpy((voidpf)ns, (voidpf)s, sizeof(deflate_state));
+    ns->window = (Bytef *)(ns + 1);
+    zmemcpy(ns->window, s->window + s->strstart - keep, keep);
+
+    /* move the history to the start of the window */
+    delta = s->strstart - keep;
+    ns->strstart = keep;
+    ns->block_start = (long)keep;
+    ns->rand_next = ns->rand_next > delta ? ns->rand_next - delta : 0;
+    ns->window_buf = Z_NULL;
+    ns->prev = Z_NULL;
+    ns->head = Z_NULL;
+    ns->pending_buf = Z_NULL;
+    ns->pending_out = Z_NULL;
+    ns->share = Z_NULL;
+    ns->idle = 1;
+    deflate_relink(ns);
+
+    if (s->opt != Z_NULL) {
+        ZFREE(strm, s->opt);
+        ns->opt = Z_NULL;
+    }
+    if (share != Z_NULL && --share->refs == 0) {
+        ZFREE(strm, share->block);
+        ZFREE(strm, share);
+    }
+    ZFREE(strm, s);
+    strm->state = (struct internal_state FAR *)ns;
+    return Z_OK;
+}
+
+/* ===========================================================================
+ * Give a stream released by deflate_idle() its buffers back, with its history
+ * at the start of the window.  The history is inserted into the emptied hash
+ * table by fill_window() when there is more input, as for the strings left by
+ * deflate_stored().
+ */
+local int deflate_wake(z_streamp strm) {
+    deflate_state *s = strm->state;
+    deflate_state *ns;
+    uInt keep = s->strstart;
+
+    ns = (deflate_state *) ZALLOC(strm, 1, (uInt)deflate_size(s->w_bits,
+                                       s->hash_bits, s->lit_bufsize));
+    if (ns == Z_NULL) return Z_MEM_ERROR;
+    zmemcpy((voidpf)ns, (voidpf)s, sizeof(deflate_state));
+    if (ns->level == Z_OPTIMAL_COMPRESSION) {
+        ns->opt = (opt_state *) ZALLOC(strm, 1, sizeof(opt_state));
+        if (ns->opt == Z_NULL) {
+            ZFREE(strm, ns);
+            return Z_MEM_ERROR;
+        }
+        ns->opt->count = ns->opt->next = 0;
+    }
+    ns->idle = 0;
+    deflate_carve(ns);
+    ns->window = ns->window_buf;
+    zmemcpy(ns->window, s->window, keep);
+    ns->high_water = keep;
+    CLEAR_HASH(ns);
+    ns->hash_stale = 0;
+    ns->insert = keep;
+    ns->pending_out = ns->pending_buf;
+#ifdef LIT_MEM
+    ns->d_buf = (ushf *)(ns->pending_buf + (ns->lit_bufsize << 1));
+    ns->l_buf = ns->pending_buf + (ns->lit_bufsize << 2);
+#else
+    ns->sym_buf = ns->pending_buf + ns->lit_bufsize;
+#endif
+    deflate_relink(ns);
+    ZFREE(strm, s);
+    strm->state = (struct internal_state FAR *)ns;
+    return Z_OK;
+}
+#endif
+
+/* ===========================================================================
+ * Give the stream a state with buffers of its own if it shares its buffers
+ * with streams from deflateFork(), or if deflateIdle() released them.  This
+ * must be done before anything in the state or its buffers is changed.  The
+ * last of the sharing streams moves back into the allocation with the
+ * buffers, and the others copy them.
+ */
+local int deflate_unshare(z_streamp strm) {
+    deflate_state *s = strm->state;
+#ifndef MAXSEG_64K
+    deflate_state *ns;
+    deflate_share FAR *share = s->share;
+
+    if (s->idle)
+        return deflate_wake(strm);
+    if (share == Z_NULL)
+        return Z_OK;
+    if (share->refs == 1) {
+        ns = (deflate_state *)share->block;
+        zmemcpy((voidpf)ns, (voidpf)s, sizeof(deflate_state));
+        ns->share = Z_NULL;
+        deflate_relink(ns);
+        ZFREE(strm, share);
+    }
+    else {
+        ns = (deflate_state *) ZALLOC(strm, 1, (uInt)deflate_size(s->w_bits,
+                                           s->hash_bits, s->lit_bufsize));
+        if (ns == Z_NULL) return Z_MEM_ERROR;
+        deflate_dup(ns, s);
+        share->refs--;
+    }
+    ZFREE(strm, s);
+    strm->state = (struct internal_state FAR *)ns;
+#else
+    (void)s;
+#endif
+    return Z_OK;
+}
+
+/* =========================================================================
+ * Free a deflate state held by a stream pool, with all of its buffers.
+ */
+local void deflate_release(z_pooled FAR *item) {
+    deflate_state *s = (deflate_state *)item->state;
+
+#ifdef MAXSEG_64K
+    item->zfree(item->opaque, s->pending_buf);
+    item->zfree(item->opaque, s->head);
+    item->zfree(item->opaque, s->prev);
+    item->zfree(item->opaque, s->window_buf);
+#endif
+    item->zfree(item->opaque, s);
+}
+
+/* ===========================================================================
+ * Return the stream pool key for a state with the given sizes.  States from
+ * deflateInit2() and deflateInit3() with the same sizes share a key.
+ */
+local unsigned deflate_key(uInt w_bits, uInt hash_bits, uInt lit_bufsize) {
+    unsigned lit_bits = 0;
+
+    while ((1U << lit_bits) < lit_bufsize)
+        lit_bits++;
+    return (w_bits << 9) + (hash_bits << 4) + lit_bits;
+}
+
+/* ===========================================================================
+ * Initialize a deflate stream with a hash table of 2^hash_bits entries and a
+ * symbol buffer of 2^lit_bits symbols, taking the state from pool if it has
+ * one of those sizes.
+ */
+local int deflate_init(z_streamp strm, z_poolp pool, int level, int method,
+                       int windowBits, int hash_bits, int lit_bits,
+                       int strategy, const char *version, int stream_size) {
     deflate_state *s;
     int wrap = 1;
+    int reused;
     static const char my_version[] = ZLIB_VERSION;
 
     if (version == Z_NULL || version[0] != my_version[0] ||
@@ -430,17 +946,39 @@ int ZEXPORT deflateInit2_(z_streamp strm, int level, int method,
         windowBits -= 16;
     }
 #endif
-    if (memLevel < 1 || memLevel > MAX_MEM_LEVEL || method != Z_DEFLATED ||
-        windowBits < 8 || windowBits > 15 || level < 0 || level > 9 ||
-        strategy < 0 || strategy > Z_FIXED || (windowBits == 8 && wrap != 1)) {
+    if (hash_bits < 8 || hash_bits > MAX_HASH_BITS ||
+        lit_bits < 7 || lit_bits > MAX_MEM_LEVEL + 6 || method != Z_DEFLATED ||
+        windowBits < 8 || windowBits > 15 || level < 0 ||
+        level > Z_OPTIMAL_COMPRESSION || strategy < 0 || strategy > Z_QUICK ||
+        (windowBits == 8 && wrap != 1)) {
         return Z_STREAM_ERROR;
     }
     if (windowBits == 8) windowBits = 9;  /* until 256-byte window bug fixed */
-    s = (deflate_state *) ZALLOC(strm, 1, sizeof(deflate_state));
+
+    /* a pooled state already has all of its buffers, sized by the key */
+    s = (deflate_state *)z_pool_take(pool, strm, Z_POOL_DEFLATE,
+                                     deflate_key((uInt)windowBits,
+                                                 (uInt)hash_bits,
+                                                 1U << lit_bits));
+    reused = s != Z_NULL;
+    if (!reused)
+#ifdef MAXSEG_64K
+        s = (deflate_state *) ZALLOC(strm, 1, sizeof(deflate_state));
+#else
+        s = (deflate_state *) ZALLOC(strm, 1, (uInt)deflate_size(
+                (uInt)windowBits, (uInt)hash_bits, 1U << lit_bits));
+#endif
     if (s == Z_NULL) return Z_MEM_ERROR;
     strm->state = (struct internal_state FAR *)s;
     s->strm = strm;
     s->status = INIT_STATE;     /* to pass state test in deflateReset() */
+    s->share = Z_NULL;
+    s->idle = 0;
+    s->compact = 0;
+    zmemzero((Bytef *)&s->offload, sizeof(z_offload));
+    s->offloaded = 0;
+    s->adapt_rate = 0;
+    s->adapt_step = -1;
 
     s->wrap = wrap;
     s->gzhead = Z_NULL;
@@ -448,18 +986,28 @@ int ZEXPORT deflateInit2_(z_streamp strm, int level, int method,
     s->w_size = 1 << s->w_bits;
     s->w_mask = s->w_size - 1;
 
-    s->hash_bits = (uInt)memLevel + 7;
+    s->hash_bits = (uInt)hash_bits;
     s->hash_size = 1 << s->hash_bits;
     s->hash_mask = s->hash_size - 1;
     s->hash_shift =  ((s->hash_bits + MIN_MATCH-1) / MIN_MATCH);
+    s->hash_mul = 1;
+    s->hash_out = 0;
 
-    s->window = (Bytef *) ZALLOC(strm, s->w_size, 2*sizeof(Byte));
-    s->prev   = (Posf *)  ZALLOC(strm, s->w_size, sizeof(Pos));
-    s->head   = (Posf *)  ZALLOC(strm, s->hash_size, sizeof(Pos));
+    s->lit_bufsize = 1 << lit_bits;     /* 16K elements by default */
 
-    s->high_water = 0;      /* nothing written to s->window yet */
+    if (!reused) {
+#ifdef MAXSEG_64K
+        s->window_buf = (Bytef *) ZALLOC(strm, s->w_size, 2*sizeof(Byte));
+        s->prev   = (Posf *)  ZALLOC(strm, s->w_size, sizeof(Pos));
+        s->head   = (Posf *)  ZALLOC(strm, s->hash_size, sizeof(Pos));
+        s->pending_buf = (uchf *) ZALLOC(strm, s->lit_bufsize, LIT_BUFS);
+#else
+        deflate_carve(s);
+#endif
+    }
+    s->window = s->window_buf;
 
-    s->lit_bufsize = 1 << (memLevel + 6); /* 16K elements by default */
+    s->high_water = 0;      /* nothing written to s->window yet */
 
     /* We overlay pending_buf and sym_buf. This works since the average size
      * for length/distance pairs over any compressed block is assured to be 31
@@ -500,11 +1048,15 @@ int ZEXPORT deflateInit2_(z_streamp strm, int level, int method,
      * symbols from which it is being constructed.
      */
 
-    s->pending_buf = (uchf *) ZALLOC(strm, s->lit_bufsize, LIT_BUFS);
     s->pending_buf_size = (ulg)s->lit_bufsize * 4;
 
+    s->opt = Z_NULL;
+    if (level == Z_OPTIMAL_COMPRESSION)
+        s->opt = (opt_state *) ZALLOC(strm, 1, sizeof(opt_state));
+
     if (s->window == Z_NULL || s->prev == Z_NULL || s->head == Z_NULL ||
-        s->pending_buf == Z_NULL) {
+        s->pending_buf == Z_NULL ||
+        (level == Z_OPTIMAL_COMPRESSION && s->opt == Z_NULL)) {
         s->status = FINISH_STATE;
         strm->msg = ERR_MSG(Z_MEM_ERROR);
         deflateEnd (strm);
@@ -513,10 +1065,10 @@ int ZEXPORT deflateInit2_(z_streamp strm, int level, int method,
 #ifdef LIT_MEM
     s->d_buf = (ushf *)(s->pending_buf + (s->lit_bufsize << 1));
     s->l_buf = s->pending_buf + (s->lit_bufsize << 2);
-    s->sym_end = s->lit_bufsize - 1;
+    s->sym_max = s->lit_bufsize - 1;
 #else
     s->sym_buf = s->pending_buf + s->lit_bufsize;
-    s->sym_end = (s->lit_bufsize - 1) * 3;
+    s->sym_max = (s->lit_bufsize - 1) * 3;
 #endif
     /* We avoid equality with lit_bufsize*3 because of wraparound at 64K
      * on 16 bit machines and because stored blocks are restricted to
@@ -526,10 +1078,54 @@ int ZEXPORT deflateInit2_(z_streamp strm, int level, int method,
     s->level = level;
     s->strategy = strategy;
     s->method = (Byte)method;
+    if (!reused)
+        s->hash_stale = 1;      /* head[] is not initialized */
 
     return deflateReset(strm);
 }
 
+/* ========================================================================= */
+int ZEXPORT deflatePoolInit2_(z_streamp strm, z_poolp pool, int level,
+                              int method, int windowBits, int memLevel,
+                              int strategy, const char *version,
+                              int stream_size) {
+    return deflate_init(strm, pool, level, method, windowBits, memLevel + 7,
+                        memLevel + 6, strategy, version, stream_size);
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateInit3_(z_streamp strm, z_poolp pool, int level,
+                          int strategy, const z_deflate_config FAR *config,
+                          const char *version, int stream_size) {
+    int ret;
+
+    if (config == Z_NULL) return Z_STREAM_ERROR;
+    ret = deflate_init(strm, pool, level, Z_DEFLATED, config->windowBits,
+                       config->hashBits, config->symBits, strategy, version,
+                       stream_size);
+    if (ret == Z_OK && (config->good_length || config->max_lazy ||
+                        config->nice_length || config->max_chain))
+        ret = deflateTune(strm, config->good_length, config->max_lazy,
+                          config->nice_length, config->max_chain);
+    return ret;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateInitCompact_(z_streamp strm, int level, int windowBits,
+                                const char *version, int stream_size) {
+    int bits, ret;
+
+    /* hash table and symbol buffer an eighth of the window in entries */
+    bits = windowBits < 0 ? -windowBits :
+           windowBits > 15 ? windowBits - 16 : windowBits;
+    bits = bits < 11 ? 8 : bits - 3;
+    ret = deflate_init(strm, Z_NULL, level, Z_DEFLATED, windowBits, bits, bits,
+                       Z_DEFAULT_STRATEGY, version, stream_size);
+    if (ret == Z_OK)
+        strm->state->compact = 1;
+    return ret;
+}
+
 /* =========================================================================
  * Check for a valid deflate stream state. Return 0 if ok, 1 if not.
  */
@@ -564,6 +1160,7 @@ int ZEXPORT deflateSetDictionary(z_streamp strm, const Bytef *dictionary,
 
     if (deflateStateCheck(strm) || dictionary == Z_NULL)
         return Z_STREAM_ERROR;
+    if (deflate_unshare(strm) != Z_OK) return Z_MEM_ERROR;
     s = strm->state;
     wrap = s->wrap;
     if (wrap == 2 || (wrap == 1 && s->status != INIT_STATE) || s->lookahead)
@@ -573,6 +1170,7 @@ int ZEXPORT deflateSetDictionary(z_streamp strm, const Bytef *dictionary,
     if (wrap == 1)
         strm->adler = adler32(strm->adler, dictionary, dictLength);
     s->wrap = 0;                    /* avoid computing Adler-32 in read_buf */
+    s->direct = 0;                  /* the dictionary is not the input */
 
     /* if dictionary would fill window, just replace the history */
     if (dictLength >= s->w_size) {
@@ -598,9 +1196,9 @@ int ZEXPORT deflateSetDictionary(z_streamp strm, const Bytef *dictionary,
         do {
             UPDATE_HASH(s, s->ins_h, s->window[str + MIN_MATCH-1]);
 #ifndef FASTEST
-            s->prev[str & s->w_mask] = s->head[s->ins_h];
+            s->prev[str & s->w_mask] = s->head[HASH_INDEX(s, s->ins_h)];
 #endif
-            s->head[s->ins_h] = (Pos)str;
+            s->head[HASH_INDEX(s, s->ins_h)] = (Pos)str;
             str++;
         } while (--n);
         s->strstart = str;
@@ -654,6 +1252,98 @@ int ZEXPORT deflateGetDictionary(z_streamp strm, Bytef *dictionary,
 }
 
 /* ========================================================================= */
+int ZEXPORT deflateCompileDictionary(z_streamp strm, const Bytef *dictionary,
+                                     uInt dictLength, z_dictp *dict) {
+    deflate_state *s;
+    z_dictp d;
+    int ret;
+
+    if (deflateStateCheck(strm) || dict == Z_NULL)
+        return Z_STREAM_ERROR;
+    s = strm->state;
+    if (s->strstart != 0 || s->lookahead != 0 || s->insert != 0)
+        return Z_STREAM_ERROR;
+    ret = deflateSetDictionary(strm, dictionary, dictLength);
+    if (ret != Z_OK)
+        return ret;
+    s = strm->state;                /* may have been moved by the above */
+
+    /* take a snapshot of the window and hash tables */
+    d = (z_dictp)ZALLOC(strm, 1, sizeof(struct z_dict_s) +
+                        (s->hash_size + s->strstart) * sizeof(Pos) +
+                        s->strstart);
+    if (d == Z_NULL)
+        return Z_MEM_ERROR;
+    d->w_bits = s->w_bits;
+    d->hash_bits = s->hash_bits;
+    d->hash_shift = s->hash_shift;
+    d->hash_mul = s->hash_mul;
+    d->size = s->strstart;
+    d->insert = s->insert;
+    d->ins_h = s->ins_h;
+    d->adler = adler32(1L, dictionary, dictLength);
+    d->zfree = strm->zfree;
+    d->opaque = strm->opaque;
+    d->head = (ushf *)(d + 1);
+    d->prev = d->head + s->hash_size;
+    d->window = (Bytef *)(d->prev + d->size);
+    zmemcpy((Bytef *)d->head, (Bytef *)s->head, s->hash_size * sizeof(Pos));
+    zmemcpy((Bytef *)d->prev, (Bytef *)s->prev, d->size * sizeof(Pos));
+    zmemcpy(d->window, s->window, d->size);
+    *dict = d;
+    return Z_OK;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateUseDictionary(z_streamp strm, z_dictp dict) {
+    deflate_state *s;
+
+    if (deflateStateCheck(strm) || dict == Z_NULL)
+        return Z_STREAM_ERROR;
+    if (deflate_unshare(strm) != Z_OK) return Z_MEM_ERROR;
+    s = strm->state;
+    if (s->wrap == 2 || s->status != INIT_STATE || s->strstart != 0 ||
+        s->lookahead != 0 || s->insert != 0 || s->w_bits != dict->w_bits ||
+        s->hash_bits != dict->hash_bits ||
+        s->hash_shift != dict->hash_shift || s->hash_mul != dict->hash_mul)
+        return Z_STREAM_ERROR;
+
+    /* the same state that deflateSetDictionary() would leave */
+    if (s->wrap == 1)
+        strm->adler = dict->adler;
+    s->direct = 0;
+    s->window = s->window_buf;
+    zmemcpy(s->window, dict->window, dict->size);
+    zmemcpy((Bytef *)s->head, (Bytef *)dict->head,
+            s->hash_size * sizeof(Pos));
+    zmemcpy((Bytef *)s->prev, (Bytef *)dict->prev, dict->size * sizeof(Pos));
+    if (s->high_water < dict->size)
+        s->high_water = dict->size;
+    s->ins_h = dict->ins_h;
+    s->strstart = dict->size;
+    s->block_start = (long)s->strstart;
+    s->insert = dict->insert;
+    s->match_length = s->prev_length = MIN_MATCH-1;
+    s->match_available = 0;
+    return Z_OK;
+}
+
+/* ========================================================================= */
+void ZEXPORT deflateFreeDictionary(z_dictp dict) {
+    if (dict != Z_NULL)
+        dict->zfree(dict->opaque, (voidpf)dict);
+}
+
+/* ========================================================================= */
+/* ===========================================================================
+ * Take the stream back from the backend of deflateOffload(), if it has it.
+ */
+local void deflate_unload(deflate_state *s) {
+    if (s->offloaded > 0 && s->offload.end != Z_NULL)
+        s->offload.end(s->offload.opaque, s->strm);
+    s->offloaded = 0;
+}
+
 int ZEXPORT deflateResetKeep(z_streamp strm) {
     deflate_state *s;
 
@@ -664,6 +1354,7 @@ int ZEXPORT deflateResetKeep(z_streamp strm) {
     if (strm == NULL || strm->state == NULL) {
         return Z_STREAM_ERROR;
     }
+    if (deflate_unshare(strm) != Z_OK) return Z_MEM_ERROR;
 
     strm->total_in = strm->total_out = 0;
     strm->msg = Z_NULL; /* use zfree if we ever allocate msg dynamically */
@@ -695,6 +1386,14 @@ int ZEXPORT deflateResetKeep(z_streamp strm) {
         strm->adler = adler32(0L, Z_NULL, 0);
     }
     s->last_flush = -2;
+    s->fit = FIT_OFF;
+    deflate_unload(s);
+#ifdef ZLIB_STATS
+    zmemzero((Bytef *)&s->stats, sizeof(z_stats));
+    s->tree_ticks = 0;
+#endif
+    if (s->opt != Z_NULL)
+        s->opt->count = s->opt->next = 0;
 
     _tr_init(s);
 
@@ -714,7 +1413,16 @@ local void lm_init(deflate_state *s) {
     }
     s->window_size = (ulg)2L * s->w_size;
 
-    CLEAR_HASH(s);
+    /* After a little data, clearing just what was used is faster.  The input
+       used by deflateOneShot() may be gone, so that always clears in full. */
+    if (s->hash_stale || s->window != s->window_buf ||
+        (ulg)s->strstart + s->lookahead > (s->hash_size >> 3))
+        CLEAR_HASH(s);
+    else
+        clear_hash_used(s);
+    s->hash_stale = 0;
+    s->window = s->window_buf;
+    s->direct = 0;
 
     if (s->level < 0 || s->level >= sizeof(configuration_table) / sizeof(configuration_table[0])) {
         return; // Validate level index
@@ -724,6 +1432,14 @@ local void lm_init(deflate_state *s) {
     s->good_match       = configuration_table[s->level].good_length;
     s->nice_match       = configuration_table[s->level].nice_length;
     s->max_chain_length = configuration_table[s->level].max_chain;
+#ifdef DEFLATE_ADAPT
+    if (s->adapt_rate && s->adapt_step >= 0) {
+        s->max_lazy_match   = adapt_table[s->adapt_step].max_lazy;
+        s->good_match       = adapt_table[s->adapt_step].good_length;
+        s->nice_match       = adapt_table[s->adapt_step].nice_length;
+        s->max_chain_length = adapt_table[s->adapt_step].max_chain;
+    }
+#endif
 
     s->strstart = 0;
     s->block_start = 0L;
@@ -732,6 +1448,10 @@ local void lm_init(deflate_state *s) {
     s->match_length = s->prev_length = MIN_MATCH-1;
     s->match_available = 0;
     s->ins_h = 0;
+    s->block_open = 0;
+    s->rand_next = 0;
+    s->rand_wait = RAND_WAIT;
+    s->rand_left = 0;
 }
 
 /* ========================================================================= */
@@ -766,12 +1486,29 @@ int ZEXPORT deflatePending(z_streamp strm, unsigned *pending, int *bits) {
     return Z_OK;
 }
 
+/* ========================================================================= */
+int ZEXPORT deflateGetStats(z_streamp strm, z_stats *stats) {
+    if (deflateStateCheck(strm) || stats == Z_NULL) return Z_STREAM_ERROR;
+#ifdef ZLIB_STATS
+    *stats = strm->state->stats;
+#  ifndef Z_SOLO
+    stats->tree_usec = (uLong)((double)strm->state->tree_ticks * 1000000 /
+                               CLOCKS_PER_SEC);
+#  endif
+    return Z_OK;
+#else
+    zmemzero((Bytef *)stats, sizeof(z_stats));
+    return Z_VERSION_ERROR;
+#endif
+}
+
 /* ========================================================================= */
 int ZEXPORT deflatePrime(z_streamp strm, int bits, int value) {
     deflate_state *s;
     int put;
 
     if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+    if (deflate_unshare(strm) != Z_OK) return Z_MEM_ERROR;
     s = strm->state;
 #ifdef LIT_MEM
     if (bits < 0 || bits > 16 ||
@@ -788,7 +1525,7 @@ int ZEXPORT deflatePrime(z_streamp strm, int bits, int value) {
         if (put > bits)
             put = bits;
         if (s->bi_valid + put > sizeof(s->bi_buf) * 8) return Z_BUF_ERROR;  // Prevent overflow
-        s->bi_buf |= (ush)((value & ((1 << put) - 1)) << s->bi_valid);
+        s->bi_buf |= (bitbuf)(value & ((1 << put) - 1)) << s->bi_valid;
         s->bi_valid += put;
         _tr_flush_bits(s);
         value >>= put;
@@ -803,6 +1540,7 @@ int ZEXPORT deflateParams(z_streamp strm, int level, int strategy) {
     compress_func func;
 
     if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+    if (deflate_unshare(strm) != Z_OK) return Z_MEM_ERROR;
     s = strm->state;
 
 #ifdef FASTEST
@@ -810,9 +1548,16 @@ int ZEXPORT deflateParams(z_streamp strm, int level, int strategy) {
 #else
     if (level == Z_DEFAULT_COMPRESSION) level = 6;
 #endif
-    if (level < 0 || level > 9 || strategy < 0 || strategy > Z_FIXED) {
+    if (level < 0 || level > Z_OPTIMAL_COMPRESSION || strategy < 0 ||
+        strategy > Z_QUICK) {
         return Z_STREAM_ERROR;
     }
+    if (level == Z_OPTIMAL_COMPRESSION && s->opt == Z_NULL) {
+        s->opt = (opt_state *) ZALLOC(strm, 1, sizeof(opt_state));
+        if (s->opt == Z_NULL)
+            return Z_MEM_ERROR;
+        s->opt->count = s->opt->next = 0;
+    }
 
     // Ensure level is within valid range
     if (level < 0 || level > (int)(sizeof(configuration_table) / sizeof(configuration_table[0]) - 1)) {
@@ -827,7 +1572,9 @@ int ZEXPORT deflateParams(z_streamp strm, int level, int strategy) {
         int err = deflate(strm, Z_BLOCK);
         if (err == Z_STREAM_ERROR)
             return err;
-        if (strm->avail_in || (s->strstart - s->block_start) + s->lookahead < 0)
+        if (strm->avail_in || (s->strstart - s->block_start) + s->lookahead ||
+            s->block_open ||
+            (s->opt != Z_NULL && s->opt->next < s->opt->count))
             return Z_BUF_ERROR;
     }
     if (s->level != level) {
@@ -848,8 +1595,15 @@ int ZEXPORT deflateParams(z_streamp strm, int level, int strategy) {
         } else {
             return Z_STREAM_ERROR;
         }
+#ifdef DEFLATE_ADAPT
+        if (s->adapt_rate)
+            adapt_start(s);
+#endif
     }
     s->strategy = strategy;
+    if (s->direct == 2 &&
+        configuration_table[s->level].func == deflate_stored)
+        window_own(s);              /* deflate_stored() writes the window */
     return Z_OK;
 }
 
@@ -871,54 +1625,109 @@ int ZEXPORT deflateTune(z_streamp strm, int good_length, int max_lazy,
     return Z_OK;
 }
 
-/* =========================================================================
- * For the default windowBits of 15 and memLevel of 8, this function returns a
- * close to exact, as well as small, upper bound on the compressed size. This
- * is an expansion of ~0.03%, plus a small constant.
- *
- * For any setting other than those defaults for windowBits and memLevel, one
- * of two worst case bounds is returned. This is at most an expansion of ~4% or
- * ~13%, plus a small constant.
- *
- * Both the 0.03% and 4% derive from the overhead of stored blocks. The first
- * one is for stored blocks of 16383 bytes (memLevel == 8), whereas the second
- * is for stored blocks of 127 bytes (the worst case memLevel == 1). The
- * expansion results from five bytes of header for each stored block.
- *
- * The larger expansion of 13% results from a window size less than or equal to
- * the symbols buffer size (windowBits <= memLevel + 7). In that case some of
- * the data being compressed may have slid out of the sliding window, impeding
- * a stored block from being emitted. Then the only choice is a fixed or
- * dynamic block, where a fixed block limits the maximum expansion to 9 bits
- * per 8-bit byte, plus 10 bits for every block. The smallest block size for
- * which this can occur is 255 (memLevel == 2).
- *
- * Shifts are used to approximate divisions, for speed.
- */
-uLong ZEXPORT deflateBound(z_streamp strm, uLong sourceLen) {
+/* ========================================================================= */
+int ZEXPORT deflateThroughput(z_streamp strm, uLong rate) {
+#ifdef DEFLATE_ADAPT
     deflate_state *s;
-    uLong fixedlen, storelen, wraplen;
-
-    if (sourceLen > ULONG_MAX - (sourceLen >> 3) - (sourceLen >> 8) - (sourceLen >> 9) - 4) {
-        return ULONG_MAX; // Avoid integer overflow
-    }
-    fixedlen = sourceLen + (sourceLen >> 3) + (sourceLen >> 8) +
-               (sourceLen >> 9) + 4;
 
-    if (sourceLen > ULONG_MAX - (sourceLen >> 5) - (sourceLen >> 7) - (sourceLen >> 11) - 7) {
-        return ULONG_MAX; // Avoid integer overflow
+    if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+    s = strm->state;
+    if (rate == 0) {
+        if (s->adapt_rate && s->adapt_step >= 0) {
+            /* back to the parameters of the level */
+            s->max_lazy_match   = configuration_table[s->level].max_lazy;
+            s->good_match       = configuration_table[s->level].good_length;
+            s->nice_match       = configuration_table[s->level].nice_length;
+            s->max_chain_length = configuration_table[s->level].max_chain;
+        }
+        s->adapt_rate = 0;
+        s->adapt_step = -1;
+        return Z_OK;
     }
-    storelen = sourceLen + (sourceLen >> 5) + (sourceLen >> 7) +
-               (sourceLen >> 11) + 7;
+    if (s->adapt_rate == 0)
+        adapt_start(s);
+    s->adapt_rate = rate;
+    return Z_OK;
+#else
+    if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+    (void)rate;
+    return Z_VERSION_ERROR;
+#endif
+}
 
-    if (deflateStateCheck(strm))
-        return (fixedlen > storelen ? fixedlen : storelen) + 18;
+/* ========================================================================= */
+int ZEXPORT deflateHash(z_streamp strm, int hash) {
+    deflate_state *s;
 
+    if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
     s = strm->state;
-    switch (s->wrap < 0 ? -s->wrap : s->wrap) {
-    case 0:
-        wraplen = 0;
-        break;
+
+    /* the hash can only be changed before any strings are in the table */
+    if (s->strstart != 0 || s->lookahead != 0 || s->insert != 0)
+        return Z_STREAM_ERROR;
+    switch (hash) {
+    case Z_HASH_SHIFT:
+        s->hash_mask = s->hash_size - 1;
+        s->hash_shift = ((s->hash_bits + MIN_MATCH-1) / MIN_MATCH);
+        s->hash_mul = 1;
+        s->hash_out = 0;
+        break;
+    case Z_HASH_MULTIPLY:
+        /* the key needs MIN_MATCH*8 bits, and longest_match() does not
+           compare the third bytes, which is only safe if equal indices and
+           equal first two bytes imply equal third bytes -- for this
+           multiplier, that is true with ten or more hash bits */
+        if (sizeof(uInt) < 4 || s->hash_bits < 10)
+            return Z_STREAM_ERROR;
+        s->hash_mask = (uInt)((1UL << (MIN_MATCH * 8)) - 1);
+        s->hash_shift = 8;
+        s->hash_mul = 2654435761UL; /* 2^32 / golden ratio, rounded to odd */
+        s->hash_out = 32 - s->hash_bits;
+        break;
+    default:
+        return Z_STREAM_ERROR;
+    }
+    s->ins_h = 0;
+    return Z_OK;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateOneShot(z_streamp strm) {
+    deflate_state *s;
+
+    if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+    s = strm->state;
+    if (s->strstart != 0 || s->lookahead != 0 || s->insert != 0)
+        return Z_STREAM_ERROR;
+    s->direct = 1;
+    return Z_OK;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateOffload(z_streamp strm, const z_offload FAR *offload) {
+    deflate_state *s;
+
+    if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+    s = strm->state;
+    if (s->offloaded > 0) return Z_STREAM_ERROR;
+    if (offload == Z_NULL)
+        zmemzero((Bytef *)&s->offload, sizeof(z_offload));
+    else
+        s->offload = *offload;
+    return Z_OK;
+}
+
+/* =========================================================================
+ * Return the number of bytes in the zlib or gzip header and trailer of s, or
+ * ULONG_MAX if that overflows.
+ */
+local uLong wrap_length(deflate_state *s) {
+    uLong wraplen;
+
+    switch (s->wrap < 0 ? -s->wrap : s->wrap) {
+    case 0:
+        wraplen = 0;
+        break;
     case 1:
         wraplen = 6 + (s->strstart ? 4 : 0);
         break;
@@ -956,16 +1765,148 @@ uLong ZEXPORT deflateBound(z_streamp strm, uLong sourceLen) {
     default:
         wraplen = 18;
     }
+    return wraplen;
+}
+
+/* =========================================================================
+ * With the stream's parameters, this function returns a close to exact, as
+ * well as small, upper bound on the compressed size. That is the input plus
+ * five bytes of header for each stored block, if the input does not compress,
+ * plus a small constant.
+ *
+ * The stored blocks are as long as the blocks of symbols, which end when the
+ * symbol buffer fills with one literal for each byte. That is lit_bufsize - 1
+ * bytes, 16383 for the default memLevel of 8, for an expansion of ~0.03%, and
+ * 127 bytes for the worst case memLevel == 1 (or symBits == 7 for
+ * deflateInit3()), for ~4%. For level 0, they are the smaller of the window
+ * and the pending buffer, less five.
+ *
+ * This requires that a block of literals fits in the window after a slide, so
+ * that the block is still there to be stored. If not, for windows that are
+ * small for their symbols buffer, some of the data being compressed may have
+ * slid out of the sliding window, impeding a stored block from being emitted.
+ * Then the only choice is a fixed or dynamic block, where a fixed block limits
+ * the maximum expansion to 9 bits per 8-bit byte, plus 10 bits for every
+ * block, for ~13%. The smallest block size for which this can occur is 255
+ * (memLevel == 2).
+ *
+ * Without a stream, the larger of the ~4% and ~13% bounds is returned, using
+ * shifts to approximate divisions.
+ */
+uLong ZEXPORT deflateBound(z_streamp strm, uLong sourceLen) {
+    deflate_state *s;
+    uLong fixedlen, storelen, wraplen, block;
+
+    if (sourceLen > ULONG_MAX - (sourceLen >> 3) - (sourceLen >> 8) - (sourceLen >> 9) - 4) {
+        return ULONG_MAX; // Avoid integer overflow
+    }
+    fixedlen = sourceLen + (sourceLen >> 3) + (sourceLen >> 8) +
+               (sourceLen >> 9) + 4;
+
+    if (sourceLen > ULONG_MAX - (sourceLen >> 5) - (sourceLen >> 7) - (sourceLen >> 11) - 7) {
+        return ULONG_MAX; // Avoid integer overflow
+    }
+    storelen = sourceLen + (sourceLen >> 5) + (sourceLen >> 7) +
+               (sourceLen >> 11) + 7;
 
-    if (s->w_bits != 15 || s->hash_bits != 8 + 7)
-        return (s->w_bits <= s->hash_bits && s->level ? fixedlen : storelen) +
-               wraplen;
+    if (deflateStateCheck(strm))
+        return (fixedlen > storelen ? fixedlen : storelen) + 18;
+
+    s = strm->state;
+    wraplen = wrap_length(s);
+    if (wraplen == ULONG_MAX)
+        return ULONG_MAX;
+
+    /* Z_QUICK only emits fixed blocks */
+    if (s->strategy == Z_QUICK && s->level)
+        return fixedlen + wraplen;
+
+    /* length of the shortest stored blocks, but the last */
+    if (s->level == 0)
+        block = s->pending_buf_size - 5 < s->w_size ?
+                s->pending_buf_size - 5 : s->w_size;
+    else if (s->lit_bufsize - 1 <= MAX_DIST(s))
+        block = s->lit_bufsize - 1;
+    else
+        return fixedlen + wraplen;
 
-    if (sourceLen > ULONG_MAX - (sourceLen >> 12) - (sourceLen >> 14) - (sourceLen >> 25) - 13 + 6) {
+    if (sourceLen > ULONG_MAX - 5 * (sourceLen / block) - 7 - wraplen) {
         return ULONG_MAX; // Avoid integer overflow
     }
-    return sourceLen + (sourceLen >> 12) + (sourceLen >> 14) +
-           (sourceLen >> 25) + 13 - 6 + wraplen;
+    return sourceLen + 5 * (sourceLen / block) + 7 + wraplen;
+}
+
+
+/* =========================================================================
+ * The estimate is of the output so far, the bits of the current block from its
+ * symbol frequencies, or as stored if that is less, and the lookahead at the
+ * same number of bits per byte as the block, plus the empty last block and the
+ * rest of the header and trailer. The stored size is exact, since deflate()
+ * at level 0 with all of the input and enough output makes stored blocks of
+ * 65535 bytes, but the last.
+ */
+int ZEXPORT deflateEstimate(z_streamp strm, uLong *estimate, uLong *stored) {
+    deflate_state *s;
+    uLong wraplen, in;
+    ulg covered, block, bits;
+
+    if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+    s = strm->state;
+    wraplen = wrap_length(s);
+    if (stored != Z_NULL) {
+        in = strm->total_in;
+        *stored = in + 5 * (in / 65535 + (in % 65535 != 0 || in == 0)) +
+                  (s->wrap == 1 || s->wrap == -1 ? 6 : wraplen);
+    }
+    if (estimate == Z_NULL)
+        return Z_OK;
+    *estimate = strm->total_out + s->pending;
+    if (s->status == FINISH_STATE)
+        return Z_OK;
+
+    /* deflate_quick() sends the symbols as it goes */
+    covered = s->strategy == Z_QUICK && s->level ? 0 :
+              (ulg)((long)s->strstart - s->block_start);
+    block = covered ? (covered << 3) + 40 : 0;
+    if (s->level && s->sym_next) {
+        bits = _tr_estimate(s);
+        if (bits < block)
+            block = bits;
+    }
+    bits = s->bi_valid + block + 10;
+    if (covered)    /* at the block's rate, in sixteenths of a bit */
+        bits += (s->lookahead * ((block << 4) / covered)) >> 4;
+    else
+        bits += (ulg)s->lookahead << 3;
+    *estimate += (bits + 7) >> 3;
+    if (s->status == BUSY_STATE)
+        *estimate += s->wrap == 2 ? 8 : s->wrap == 1 ? 4 : 0;
+    else
+        *estimate += wraplen;
+    return Z_OK;
+}
+
+/* ========================================================================= */
+uLong ZEXPORT deflateMemory(int windowBits, int memLevel) {
+    if (windowBits < 0)
+        windowBits = -windowBits;
+#ifdef GZIP
+    else if (windowBits > 15)
+        windowBits -= 16;
+#endif
+    if (windowBits < 8 || windowBits > 15 ||
+        memLevel < 1 || memLevel > MAX_MEM_LEVEL)
+        return 0;
+    if (windowBits == 8) windowBits = 9;
+#ifdef MAXSEG_64K
+    return sizeof(deflate_state) + ((uLong)2 << windowBits) +
+           ((uLong)sizeof(Pos) << windowBits) +
+           ((uLong)sizeof(Pos) << (memLevel + 7)) +
+           ((uLong)LIT_BUFS << (memLevel + 6));
+#else
+    return deflate_size((uInt)windowBits, (uInt)memLevel + 7,
+                        1U << (memLevel + 6));
+#endif
 }
 
 /* =========================================================================
@@ -1017,14 +1958,70 @@ local void flush_pending(z_streamp strm) {
                                 s->pending - (beg)); \
     } while (0)
 
+/* =========================================================================
+ * Give the raw deflate data of the stream to the backend of deflateOffload()
+ * when the header has been written, if it has the stream or can be offered
+ * it, and account for the input that it consumes and the output that it
+ * writes. Return Z_BUF_ERROR if the backend declined the stream, for deflate
+ * to compress it instead, or else what the backend returned.
+ */
+local int deflate_offload(z_streamp strm, int flush) {
+    deflate_state *s = strm->state;
+    z_const Bytef *next = strm->next_in;
+    Bytef *put = strm->next_out;
+    uInt in;
+    int ret;
+
+    if (s->offloaded == 0) {
+        /* only offer a stream with nothing compressed or primed yet */
+        s->offloaded = -1;
+        if (s->strstart || s->lookahead || s->insert || s->block_start ||
+            s->bi_valid)
+            return Z_BUF_ERROR;
+    }
+    ret = s->offload.deflate(s->offload.opaque, strm, flush, s->level,
+                             s->strategy, (int)s->w_bits);
+    in = (uInt)(strm->next_in - next);
+    if (s->offloaded < 0) {
+        if (ret == Z_BUF_ERROR && in == 0 && strm->next_out == put)
+            return Z_BUF_ERROR;
+        s->offloaded = 1;
+    }
+    strm->total_in += in;
+    strm->total_out += (uLong)(strm->next_out - put);
+    if (in) {
+#ifdef GZIP
+        if (s->wrap == 2)
+            strm->adler = crc32(strm->adler, next, in);
+        else
+#endif
+        if (s->wrap == 1)
+            strm->adler = adler32(strm->adler, next, in);
+    }
+    return ret == Z_BUF_ERROR ? Z_OK : ret;
+}
+
+/* ===========================================================================
+ * Compress with the function for the level and strategy.
+ */
+local block_state deflate_blocks(deflate_state *s, int flush) {
+    return s->level == 0 ? deflate_stored(s, flush) :
+           s->strategy == Z_HUFFMAN_ONLY ? deflate_huff(s, flush) :
+           s->strategy == Z_RLE ? deflate_rle(s, flush) :
+           s->strategy == Z_QUICK ? deflate_quick(s, flush) :
+           (*(configuration_table[s->level].func))(s, flush);
+}
+
 /* ========================================================================= */
-int ZEXPORT deflate(z_streamp strm, int flush) {
+local int deflate_run(z_streamp strm, int flush) {
     int old_flush; /* value of flush param for previous deflate call */
     deflate_state *s;
 
-    if (deflateStateCheck(strm) || flush > Z_BLOCK || flush < 0) {
+    if (deflateStateCheck(strm) || flush < 0 ||
+        (flush > Z_BLOCK && flush != Z_LATENCY_FLUSH)) {
         return Z_STREAM_ERROR;
     }
+    if (deflate_unshare(strm) != Z_OK) return Z_MEM_ERROR;
     s = strm->state;
 
     if (strm->next_out == Z_NULL ||
@@ -1125,7 +2122,7 @@ int ZEXPORT deflate(z_streamp strm, int flush) {
             put_byte(s, 0);
             put_byte(s, 0);
             put_byte(s, 0);
-            put_byte(s, s->level == 9 ? 2 :
+            put_byte(s, s->level >= 9 ? 2 :
                      (s->strategy >= Z_HUFFMAN_ONLY || s->level < 2 ?
                       4 : 0));
             put_byte(s, OS_CODE);
@@ -1152,7 +2149,7 @@ int ZEXPORT deflate(z_streamp strm, int flush) {
             put_byte(s, (Byte)((s->gzhead->time >> 8) & 0xff));
             put_byte(s, (Byte)((s->gzhead->time >> 16) & 0xff));
             put_byte(s, (Byte)((s->gzhead->time >> 24) & 0xff));
-            put_byte(s, s->level == 9 ? 2 :
+            put_byte(s, s->level >= 9 ? 2 :
                      (s->strategy >= Z_HUFFMAN_ONLY || s->level < 2 ?
                       4 : 0));
             put_byte(s, s->gzhead->os & 0xff);
@@ -1268,16 +2265,31 @@ int ZEXPORT deflate(z_streamp strm, int flush) {
     }
 #endif
 
+    /* Let the backend compress, if it has the stream or takes it now. It
+     * decides for itself what to do with repeated flushes.
+     */
+    if (s->status == BUSY_STATE && s->offloaded >= 0 &&
+        s->offload.deflate != Z_NULL) {
+        int ret = deflate_offload(strm, flush);
+
+        if (s->offloaded > 0) {
+            if (ret != Z_STREAM_END) {
+                s->last_flush = -1;
+                return ret;
+            }
+            s->status = FINISH_STATE;
+        }
+    }
+
     /* Start a new block or continue the current one.
      */
     if (strm->avail_in != 0 || s->lookahead != 0 ||
         (flush != Z_NO_FLUSH && s->status != FINISH_STATE)) {
         block_state bstate;
 
-        bstate = s->level == 0 ? deflate_stored(s, flush) :
-                 s->strategy == Z_HUFFMAN_ONLY ? deflate_huff(s, flush) :
-                 s->strategy == Z_RLE ? deflate_rle(s, flush) :
-                 (*(configuration_table[s->level].func))(s, flush);
+        if (s->split_keep)
+            _tr_split_restore(s);
+        bstate = deflate_blocks(s, flush);
 
         if (bstate == finish_started || bstate == finish_done) {
             s->status = FINISH_STATE;
@@ -1298,6 +2310,8 @@ int ZEXPORT deflate(z_streamp strm, int flush) {
         if (bstate == block_done) {
             if (flush == Z_PARTIAL_FLUSH) {
                 _tr_align(s);
+            } else if (flush == Z_LATENCY_FLUSH) {
+                _tr_sync(s);
             } else if (flush != Z_BLOCK) { /* FULL_FLUSH or SYNC_FLUSH */
     if (s != NULL) {
         _tr_stored_block(s, (char*)0, 0L, 0);
@@ -1355,6 +2369,232 @@ int ZEXPORT deflate(z_streamp strm, int flush) {
     return s->pending != 0 ? Z_OK : Z_STREAM_END;
 }
 
+#ifdef DEFLATE_ADAPT
+/* ===========================================================================
+ * Account for in bytes of input compressed in us microseconds, and once
+ * ADAPT_BYTES have been seen, move to the next slower search parameters if
+ * they are expected to keep up with the target rate, or to the next faster
+ * ones if the current ones do not. The expected rate of a step is the rate
+ * last measured there, scaled by how the current rate compares with the last
+ * one measured at the current step, to follow changes in the data. A step not
+ * yet tried is taken when running at twice the target or more.
+ */
+local void deflate_adapt(deflate_state *s, ulg in, ulg us) {
+    int step = s->adapt_step;
+    ulg last;
+    double rate, next;
+
+    s->adapt_in += in;
+    s->adapt_us += us;
+    if (s->adapt_in < ADAPT_BYTES)
+        return;
+    rate = s->adapt_us ? s->adapt_in * 1e6 / s->adapt_us : 4e9;
+    if (rate > 4e9)
+        rate = 4e9;
+    s->adapt_in = s->adapt_us = 0;
+    last = s->adapt_seen[step];
+    s->adapt_seen[step] = last ? (last >> 1) + ((ulg)rate >> 1) : (ulg)rate;
+
+    if (rate < s->adapt_rate) {
+        if (step > 0 && adapt_table[step - 1].func == adapt_table[step].func)
+            step--;
+    }
+    else if (step + 1 < ADAPT_STEPS &&
+             adapt_table[step + 1].func == adapt_table[step].func) {
+        next = s->adapt_seen[step + 1];
+        next = next ? next * rate / s->adapt_seen[step] : rate / 2;
+        if (next >= s->adapt_rate)
+            step++;
+    }
+    if (step != s->adapt_step) {
+        s->adapt_step = step;
+        s->max_lazy_match   = adapt_table[step].max_lazy;
+        s->good_match       = adapt_table[step].good_length;
+        s->nice_match       = adapt_table[step].nice_length;
+        s->max_chain_length = adapt_table[step].max_chain;
+    }
+}
+
+/* ===========================================================================
+ * Run deflate, timing it for deflate_adapt() if deflateThroughput() is on.
+ */
+local int deflate_timed(z_streamp strm, int flush) {
+    uLong in;
+    ulg start;
+    int ret;
+
+    if (deflateStateCheck(strm) || strm->state->adapt_rate == 0 ||
+        strm->state->adapt_step < 0)
+        return deflate_run(strm, flush);
+    in = strm->total_in;
+    start = z_micros();
+    ret = deflate_run(strm, flush);
+    deflate_adapt(strm->state, strm->total_in - in, z_micros() - start);
+    return ret;
+}
+#else
+#  define deflate_timed deflate_run
+#endif
+
+/* ===========================================================================
+ * Run deflate, and then release the buffers of a deflateInitCompact() stream
+ * if the flush has left it between messages.
+ */
+local int deflate_call(z_streamp strm, int flush) {
+    int ret;
+
+    ret = deflate_timed(strm, flush);
+#ifndef MAXSEG_64K
+    if ((ret == Z_OK || ret == Z_STREAM_END || ret == Z_BUF_ERROR) &&
+        strm->state->compact && (flush == Z_SYNC_FLUSH ||
+                                 flush == Z_FULL_FLUSH || flush == Z_FINISH))
+        deflate_idle(strm);
+#endif
+    return ret;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflate(z_streamp strm, int flush) {
+#ifdef ZLIB_PROBES
+    int ret;
+    uLong in, out;
+
+    if (strm == Z_NULL)
+        return deflate_call(strm, flush);
+    in = strm->total_in;
+    out = strm->total_out;
+    Probe3(deflate_entry, strm->avail_in, strm->avail_out, flush);
+    ret = deflate_call(strm, flush);
+    Probe3(deflate_return, ret, strm->total_in - in, strm->total_out - out);
+    return ret;
+#else
+    return deflate_call(strm, flush);
+#endif
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateIdle(z_streamp strm) {
+    if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+#ifdef MAXSEG_64K
+    return Z_STREAM_ERROR;
+#else
+    return deflate_idle(strm);
+#endif
+}
+
+/* ========================================================================= */
+uLong ZEXPORT deflateFootprint(z_streamp strm) {
+    deflate_state *s;
+    uLong size;
+
+    if (deflateStateCheck(strm)) return 0;
+    s = strm->state;
+#ifdef MAXSEG_64K
+    size = sizeof(deflate_state) + ((uLong)2 << s->w_bits) +
+           ((uLong)sizeof(Pos) << s->w_bits) +
+           ((uLong)sizeof(Pos) << s->hash_bits) +
+           (uLong)s->lit_bufsize * LIT_BUFS;
+#else
+    if (s->idle)
+        size = sizeof(deflate_state) + s->strstart;
+    else {
+        size = deflate_size(s->w_bits, s->hash_bits, s->lit_bufsize);
+        if (s->share != Z_NULL)     /* the buffers are counted in full */
+            size += sizeof(deflate_state) + sizeof(deflate_share);
+    }
+#endif
+    if (s->opt != Z_NULL)
+        size += sizeof(opt_state);
+    return size;
+}
+
+/* ========================================================================= */
+int ZEXPORT deflateFitBlock(z_streamp strm, uLong target) {
+    deflate_state *s;
+    z_const Bytef *next;
+    uInt avail, used;
+    uLong in, out, trailer, check;
+    ulg bits;
+    int ret;
+
+    if (deflateStateCheck(strm) || strm->next_out == Z_NULL ||
+        (strm->avail_in != 0 && strm->next_in == Z_NULL))
+        return Z_STREAM_ERROR;
+    s = strm->state;
+    if (s->status == FINISH_STATE || s->lookahead != 0 || s->split_keep ||
+        s->strategy == Z_QUICK || s->offloaded > 0)
+        return Z_STREAM_ERROR;
+    trailer = s->wrap == 2 ? 8 : s->wrap == 1 ? 4 : 0;
+    if (strm->avail_out < target || target < trailer)
+        return Z_BUF_ERROR;
+    if (s->offloaded == 0)
+        s->offloaded = -1;      /* the backend does not fit blocks */
+
+    /* Write the header, if not written yet */
+    in = strm->total_in;
+    out = strm->total_out;
+    avail = strm->avail_in;
+    strm->avail_in = 0;
+    ret = deflate(strm, Z_NO_FLUSH);
+    strm->avail_in = avail;
+    s = strm->state;                /* may have been moved by deflate() */
+    if ((ret != Z_OK && ret != Z_BUF_ERROR) || s->status != BUSY_STATE)
+        return Z_BUF_ERROR;
+    s->fit_room = (ulg)(out + target - trailer) << 3;
+    bits = ((ulg)(strm->total_out + s->pending) << 3) + s->bi_valid;
+
+    /* Stored blocks only need enough input taken for the room */
+    if (s->level == 0) {
+        ulg first = ((bits + 3 + 7) >> 3) + 4, room, len, blocks = 1;
+
+        if (first > s->fit_room >> 3)
+            return Z_BUF_ERROR;
+        room = (s->fit_room >> 3) - first;
+        len = room;
+        while (len > blocks * MAX_STORED) {
+            blocks++;
+            len = room > 5 * (blocks - 1) ? room - 5 * (blocks - 1) : 0;
+        }
+        if (len > avail)
+            len = avail;
+        strm->avail_in = (uInt)len;
+        ret = deflate(strm, Z_FINISH);
+        strm->avail_in += avail - (uInt)len;
+        return ret;
+    }
+    if (bits + FIT_EMPTY > s->fit_room)
+        return Z_BUF_ERROR;
+
+    /* Compress until the last block that fits is sent */
+    next = strm->next_in;
+    check = strm->adler;
+    _tr_fit(s);
+    deflate_blocks(s, Z_FINISH);
+    Assert(s->fit == FIT_DONE, "last block not sent");
+    s->fit = FIT_OFF;
+    used = avail - (uInt)s->fit_rest;
+
+    /* Account for only the input used, and write the trailer */
+    if (used != avail) {
+        strm->total_in = in + used;
+#ifdef GZIP
+        if (s->wrap == 2)
+            strm->adler = crc32(check, next, used);
+        else
+#endif
+        if (s->wrap == 1)
+            strm->adler = adler32(check, next, used);
+    }
+    strm->avail_in = 0;
+    s->lookahead = 0;
+    s->hash_stale = 1;          /* head[] has strings past strstart */
+    s->status = FINISH_STATE;
+    ret = deflate(strm, Z_FINISH);
+    strm->next_in = next + used;
+    strm->avail_in = avail - used;
+    return ret;
+}
+
 /* ========================================================================= */
 int ZEXPORT deflateEnd(z_streamp strm) {
     int status;
@@ -1363,12 +2603,21 @@ int ZEXPORT deflateEnd(z_streamp strm) {
     if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
 
     status = strm->state->status;
+    deflate_unload(strm->state);
 
+    if (strm->state->opt != Z_NULL) TRY_FREE(strm, strm->state->opt);
+    if (strm->state->share != Z_NULL &&
+        --strm->state->share->refs == 0) {
+        ZFREE(strm, strm->state->share->block);
+        ZFREE(strm, strm->state->share);
+    }
+#ifdef MAXSEG_64K
     /* Deallocate in reverse order of allocations: */
     if (strm->state->pending_buf != Z_NULL) TRY_FREE(strm, strm->state->pending_buf);
     if (strm->state->head != Z_NULL) TRY_FREE(strm, strm->state->head);
     if (strm->state->prev != Z_NULL) TRY_FREE(strm, strm->state->prev);
-    if (strm->state->window != Z_NULL) TRY_FREE(strm, strm->state->window);
+    if (strm->state->window_buf != Z_NULL) TRY_FREE(strm, strm->state->window_buf);
+#endif
 
     ZFREE(strm, strm->state);
     strm->state = Z_NULL;
@@ -1376,68 +2625,307 @@ int ZEXPORT deflateEnd(z_streamp strm) {
     return status == BUSY_STATE ? Z_DATA_ERROR : Z_OK;
 }
 
-/* =========================================================================
- * Copy the source state to the destination state.
- * To simplify the source, this is not supported for 16-bit MSDOS (which
- * doesn't have enough memory anyway to duplicate compression states).
+/* ========================================================================= */
+int ZEXPORT deflatePoolEnd(z_streamp strm, z_poolp pool) {
+    deflate_state *s;
+    int status;
+
+    if (deflateStateCheck(strm)) return Z_STREAM_ERROR;
+    s = strm->state;
+    status = s->status;
+    deflate_unload(s);
+    if (s->opt != Z_NULL) {             /* not kept in the pool */
+        ZFREE(strm, s->opt);
+        s->opt = Z_NULL;
+    }
+    if (s->share == Z_NULL && !s->idle && pool != Z_NULL) {
+        /* leave head[] all NIL if that is cheap, while the window still has
+           the strings that were hashed, so deflatePoolInit2() need not clear
+           all of it */
+        if (!s->hash_stale && s->window == s->window_buf &&
+            (ulg)s->strstart + s->lookahead <= (s->hash_size >> 3)) {
+            clear_hash_used(s);
+            s->strstart = 0;
+            s->lookahead = 0;
+        }
+        else
+            s->hash_stale = 1;
+    }
+    if (s->share != Z_NULL || s->idle ||    /* not a whole allocation */
+        !z_pool_put(pool, strm, Z_POOL_DEFLATE,
+                    deflate_key(s->w_bits, s->hash_bits, s->lit_bufsize),
+                    deflate_release))
+        return deflateEnd(strm);
+    return status == BUSY_STATE ? Z_DATA_ERROR : Z_OK;
+}
+
+/* =========================================================================
+ * Copy the source state to the destination state.
+ * To simplify the source, this is not supported for 16-bit MSDOS (which
+ * doesn't have enough memory anyway to duplicate compression states).
+ */
+int ZEXPORT deflateCopy(z_streamp dest, z_streamp source) {
+#ifdef MAXSEG_64K
+    (void)dest;
+    (void)source;
+    return Z_STREAM_ERROR;
+#else
+    deflate_state *ds;
+    deflate_state *ss;
+
+
+    if (deflateStateCheck(source) || dest == Z_NULL ||
+        source->state->offloaded > 0) {
+        return Z_STREAM_ERROR;
+    }
+
+    ss = source->state;
+
+    zmemcpy((voidpf)dest, (voidpf)source, sizeof(z_stream));
+
+    if (ss->idle) {
+        /* copy the state and its history, and leave the copy idle too */
+        ds = (deflate_state *) ZALLOC(dest, 1,
+                                      sizeof(deflate_state) + ss->strstart);
+        if (ds == Z_NULL) return Z_MEM_ERROR;
+        zmemcpy((voidpf)ds, (voidpf)ss, sizeof(deflate_state) + ss->strstart);
+        ds->window = (Bytef *)(ds + 1);
+        deflate_relink(ds);
+    }
+    else {
+        ds = (deflate_state *) ZALLOC(dest, 1, (uInt)deflate_size(ss->w_bits,
+                                            ss->hash_bits, ss->lit_bufsize));
+        if (ds == Z_NULL) return Z_MEM_ERROR;
+        /* following zmemcpy do not work for 16-bit MSDOS */
+        deflate_dup(ds, ss);
+    }
+    dest->state = (struct internal_state FAR *) ds;
+    ds->strm = dest;
+    ds->opt = Z_NULL;
+
+    if (ss->opt != Z_NULL) {
+        ds->opt = (opt_state *) ZALLOC(dest, 1, sizeof(opt_state));
+        if (ds->opt == Z_NULL) {
+            deflateEnd(dest);
+            return Z_MEM_ERROR;
+        }
+        zmemcpy((voidpf)ds->opt, (voidpf)ss->opt, sizeof(opt_state));
+    }
+
+    return Z_OK;
+#endif /* MAXSEG_64K */
+}
+
+/* =========================================================================
+ * Make dest a copy of source that shares the source buffers until either
+ * stream next changes them.  A source that owns its buffers moves to a new
+ * allocation for just the state, leaving the buffers where they are for the
+ * sharing states to point at.  As for deflateCopy(), this is not supported
+ * for 16-bit MSDOS.
+ */
+int ZEXPORT deflateFork(z_streamp dest, z_streamp source) {
+#ifdef MAXSEG_64K
+    (void)dest;
+    (void)source;
+    return Z_STREAM_ERROR;
+#else
+    deflate_state *ds;
+    deflate_state *ss;
+    deflate_share FAR *share;
+
+    if (deflateStateCheck(source) || dest == Z_NULL ||
+        source->state->offloaded > 0) {
+        return Z_STREAM_ERROR;
+    }
+
+    ss = source->state;
+    if (ss->direct == 2 ||              /* the window is the caller's input */
+        ss->idle)                       /* a copy is as small as a fork */
+        return deflateCopy(dest, source);
+
+    ds = (deflate_state *) ZALLOC(source, 1, sizeof(deflate_state));
+    if (ds == Z_NULL) return Z_MEM_ERROR;
+    zmemcpy((voidpf)ds, (voidpf)ss, sizeof(deflate_state));
+    ds->opt = Z_NULL;
+    if (ss->opt != Z_NULL) {
+        ds->opt = (opt_state *) ZALLOC(source, 1, sizeof(opt_state));
+        if (ds->opt == Z_NULL) {
+            ZFREE(source, ds);
+            return Z_MEM_ERROR;
+        }
+        zmemcpy((voidpf)ds->opt, (voidpf)ss->opt, sizeof(opt_state));
+    }
+
+    share = ss->share;
+    if (share == Z_NULL) {
+        /* move the source state out of the allocation with its buffers */
+        share = (deflate_share FAR *) ZALLOC(source, 1, sizeof(deflate_share));
+        ss = (deflate_state *) ZALLOC(source, 1, sizeof(deflate_state));
+        if (share == Z_NULL || ss == Z_NULL) {
+            if (ss != Z_NULL) ZFREE(source, ss);
+            if (share != Z_NULL) ZFREE(source, share);
+            if (ds->opt != Z_NULL) ZFREE(source, ds->opt);
+            ZFREE(source, ds);
+            return Z_MEM_ERROR;
+        }
+        share->refs = 1;
+        share->block = (voidpf)source->state;
+        zmemcpy((voidpf)ss, (voidpf)source->state, sizeof(deflate_state));
+        ss->share = share;
+        deflate_relink(ss);
+        source->state = (struct internal_state FAR *) ss;
+        ds->share = share;
+    }
+    share->refs++;
+
+    zmemcpy((voidpf)dest, (voidpf)source, sizeof(z_stream));
+    dest->state = (struct internal_state FAR *) ds;
+    ds->strm = dest;
+    deflate_relink(ds);
+    return Z_OK;
+#endif /* MAXSEG_64K */
+}
+
+/*
+  If available, compare strings in longest_match() many bytes at a time: 32
+  with AVX2 if the compiler is targeting it, eight with 64-bit words on other
+  little-endian 64-bit machines with GCC or clang, or 16 with SSE2 on other x86
+  targets.  Where both are available, the word compare is used instead of
+  SSE2, since most matches are short and it measured faster.  Define
+  NO_MATCH_SIMD to use the original byte or UNALIGNED_OK comparisons.
+ */
+#ifndef NO_MATCH_SIMD
+#  if defined(__AVX2__)
+#    define MATCH_AVX2
+#  elif (defined(__GNUC__) || defined(__clang__)) && defined(HAVE_MEMCPY) && \
+        defined(__LP64__) && defined(__BYTE_ORDER__) && \
+        __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#    define MATCH_WORD
+#  elif defined(__SSE2__) || defined(_M_X64) || \
+        (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#    define MATCH_SSE2
+#  endif
+#endif
+
+#if defined(MATCH_AVX2) || defined(MATCH_WORD) || defined(MATCH_SSE2)
+#  define MATCH_SIMD
+
+#ifdef _MSC_VER
+#include <intrin.h>
+local unsigned match_ctz(unsigned long x) {
+    unsigned long n;
+
+    _BitScanForward(&n, x);
+    return (unsigned)n;
+}
+#else
+#  define match_ctz(x) ((unsigned)__builtin_ctz(x))
+#endif
+
+#if defined(MATCH_AVX2) || defined(MATCH_SSE2)
+#include <immintrin.h>
+#endif
+
+/* ===========================================================================
+ * Return the number of leading bytes that are equal in the MAX_MATCH-2 bytes
+ * at scan and match.  All MAX_MATCH-2 bytes of both must be readable, but
+ * need not be valid input.
  */
-int ZEXPORT deflateCopy(z_streamp dest, z_streamp source) {
-#ifdef MAXSEG_64K
-    (void)dest;
-    (void)source;
-    return Z_STREAM_ERROR;
+local unsigned compare_match(const Bytef *scan, const Bytef *match) {
+    unsigned len = 0;
+#if defined(MATCH_AVX2)
+    do {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(scan + len));
+        __m256i b = _mm256_loadu_si256((const __m256i *)(match + len));
+        unsigned ne = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+
+        if (ne)
+            return len + match_ctz(ne);
+        len += 32;
+    } while (len < MAX_MATCH-2);
+#elif defined(MATCH_SSE2)
+    do {
+        __m128i a = _mm_loadu_si128((const __m128i *)(scan + len));
+        __m128i b = _mm_loadu_si128((const __m128i *)(match + len));
+        unsigned ne = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) ^
+                      0xffff;
+
+        if (ne)
+            return len + match_ctz(ne);
+        len += 16;
+    } while (len < MAX_MATCH-2);
 #else
-    deflate_state *ds;
-    deflate_state *ss;
+    do {
+        unsigned long long a, b;
+
+        zmemcpy(&a, scan + len, sizeof(a));
+        zmemcpy(&b, match + len, sizeof(b));
+        if (a != b)
+            return len + ((unsigned)__builtin_ctzll(a ^ b) >> 3);
+        len += 8;
+    } while (len < MAX_MATCH-2);
+#endif
+    return MAX_MATCH-2;
+}
+#else /* !(MATCH_AVX2 || MATCH_WORD || MATCH_SSE2) */
+local unsigned compare_match(const Bytef *scan, const Bytef *match) {
+    unsigned len = 0;
 
+    while (len < MAX_MATCH-2 && scan[len] == match[len])
+        len++;
+    return len;
+}
+#endif /* MATCH_AVX2 || MATCH_WORD || MATCH_SSE2 */
 
-    if (deflateStateCheck(source) || dest == Z_NULL) {
-        return Z_STREAM_ERROR;
+/* ===========================================================================
+ * Return the number of leading bytes of the max bytes at scan that are equal
+ * to c, comparing many at a time against copies of c where compare_match()
+ * does.  Only the max bytes at scan are read.
+ */
+local unsigned rle_run(const Bytef *scan, unsigned c, unsigned max) {
+    unsigned len = 0;
+#if defined(MATCH_AVX2)
+    __m256i b = _mm256_set1_epi8((char)c);
+
+    while (len + 32 <= max) {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(scan + len));
+        unsigned ne = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(a, b));
+
+        if (ne)
+            return len + match_ctz(ne);
+        len += 32;
     }
+#elif defined(MATCH_SSE2)
+    __m128i b = _mm_set1_epi8((char)c);
 
-    ss = source->state;
-
-    zmemcpy((voidpf)dest, (voidpf)source, sizeof(z_stream));
+    while (len + 16 <= max) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(scan + len));
+        unsigned ne = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) ^
+                      0xffff;
 
-    ds = (deflate_state *) ZALLOC(dest, 1, sizeof(deflate_state));
-    if (ds == Z_NULL) return Z_MEM_ERROR;
-    dest->state = (struct internal_state FAR *) ds;
-    zmemcpy((voidpf)ds, (voidpf)ss, sizeof(deflate_state));
-    ds->strm = dest;
+        if (ne)
+            return len + match_ctz(ne);
+        len += 16;
+    }
+#elif defined(MATCH_WORD)
+    unsigned long long b = 0x0101010101010101ULL * c;
 
-    ds->window = (Bytef *) ZALLOC(dest, ds->w_size, 2*sizeof(Byte));
-    ds->prev   = (Posf *)  ZALLOC(dest, ds->w_size, sizeof(Pos));
-    ds->head   = (Posf *)  ZALLOC(dest, ds->hash_size, sizeof(Pos));
-    ds->pending_buf = (uchf *) ZALLOC(dest, ds->lit_bufsize, LIT_BUFS);
+    while (len + 8 <= max) {
+        unsigned long long a;
 
-    if (ds->window == Z_NULL || ds->prev == Z_NULL || ds->head == Z_NULL ||
-        ds->pending_buf == Z_NULL) {
-        deflateEnd (dest);
-        return Z_MEM_ERROR;
+        zmemcpy(&a, scan + len, sizeof(a));
+        if (a != b)
+            return len + ((unsigned)__builtin_ctzll(a ^ b) >> 3);
+        len += 8;
     }
-    /* following zmemcpy do not work for 16-bit MSDOS */
-    zmemcpy(ds->window, ss->window, ds->w_size * 2 * sizeof(Byte));
-    zmemcpy((voidpf)ds->prev, (voidpf)ss->prev, ds->w_size * sizeof(Pos));
-    zmemcpy((voidpf)ds->head, (voidpf)ss->head, ds->hash_size * sizeof(Pos));
-    zmemcpy(ds->pending_buf, ss->pending_buf, ds->lit_bufsize * LIT_BUFS);
-
-    ds->pending_out = ds->pending_buf + (ss->pending_out - ss->pending_buf);
-#ifdef LIT_MEM
-    ds->d_buf = (ushf *)(ds->pending_buf + (ds->lit_bufsize << 1));
-    ds->l_buf = ds->pending_buf + (ds->lit_bufsize << 2);
-#else
-    ds->sym_buf = ds->pending_buf + ds->lit_bufsize;
 #endif
-
-    ds->l_desc.dyn_tree = ds->dyn_ltree;
-    ds->d_desc.dyn_tree = ds->dyn_dtree;
-    ds->bl_desc.dyn_tree = ds->bl_tree;
-
-    return Z_OK;
-#endif /* MAXSEG_64K */
+    while (len < max && scan[len] == c)
+        len++;
+    return len;
 }
 
 #ifndef FASTEST
+
 /* ===========================================================================
  * Set match_start to the longest match starting at the given string and
  * return its length. Matches shorter or equal to prev_length are discarded,
@@ -1462,7 +2950,10 @@ local uInt longest_match(deflate_state *s, IPos cur_match) {
     Posf *prev = s->prev;
     uInt wmask = s->w_mask;
 
-#ifdef UNALIGNED_OK
+#if defined(MATCH_SIMD)
+    register Byte scan_end1  = scan[best_len - 1];
+    register Byte scan_end   = scan[best_len];
+#elif defined(UNALIGNED_OK)
     /* Compare two bytes at a time. Note: this is not always beneficial.
      * Try with and without -DUNALIGNED_OK to check.
      */
@@ -1494,6 +2985,7 @@ local uInt longest_match(deflate_state *s, IPos cur_match) {
 
     do {
         Assert(cur_match < s->strstart, "no future");
+        Stat(s->stats.chains++);
         match = s->window + cur_match;
 
         /* Skip to next match if the match length cannot increase
@@ -1504,7 +2996,21 @@ local uInt longest_match(deflate_state *s, IPos cur_match) {
          * However the length of the match is limited to the lookahead, so
          * the output of deflate is not affected by the uninitialized values.
          */
-#if (defined(UNALIGNED_OK) && MAX_MATCH == 258)
+#if defined(MATCH_SIMD)
+        if (match[best_len]     != scan_end  ||
+            match[best_len - 1] != scan_end1 ||
+            *match              != *scan     ||
+            match[1]            != scan[1])      continue;
+
+        /* Compare the rest of the strings many bytes at a time.  This
+         * includes scan[2] and match[2], which costs nothing here.  The
+         * strings are limited to MAX_MATCH, and the window has at least
+         * MIN_LOOKAHEAD readable bytes from strstart, so the reads stay in
+         * the window.
+         */
+        len = 2 + (int)compare_match(scan + 2, match + 2);
+
+#elif (defined(UNALIGNED_OK) && MAX_MATCH == 258)
         /* This code assumes sizeof(unsigned short) == 2. Do not use
          * UNALIGNED_OK if your compiler uses a different size.
          */
@@ -1576,7 +3082,7 @@ local uInt longest_match(deflate_state *s, IPos cur_match) {
             s->match_start = cur_match;
             best_len = len;
             if (len >= nice_match) break;
-#ifdef UNALIGNED_OK
+#if defined(UNALIGNED_OK) && !defined(MATCH_SIMD)
             scan_end = *(ushf*)(scan + best_len - 1);
 #else
             scan_end1  = scan[best_len - 1];
@@ -1610,6 +3116,7 @@ local uInt longest_match(deflate_state *s, IPos cur_match) {
            "need lookahead");
 
     Assert(cur_match < s->strstart, "no future");
+    Stat(s->stats.chains++);
 
     match = s->window + cur_match;
 
@@ -1706,22 +3213,22 @@ local void check_match(deflate_state *s, IPos start, IPos match, int length) {
                    (charf *)Z_NULL), \
                 (ulg)((long)s->strstart - s->block_start), \
                 (last)); \
-   s->block_start = s->strstart; \
+   s->block_start = (long)(s->strstart - s->split_tail); \
    flush_pending(s->strm); \
+   if (s->split_keep && s->pending == 0) _tr_split_restore(s); \
    Tracev((stderr,"[FLUSH]")); \
 }
 
-/* Same but force premature exit if necessary. */
+/* Same but force premature exit if necessary, or once deflateFitBlock() has
+   sent the last block. */
 #define FLUSH_BLOCK(s, last) { \
     if ((s) == NULL || (s)->strm == NULL) return need_more; \
     if ((last) != 0 && (last) != 1) return need_more; \
     FLUSH_BLOCK_ONLY(s, last); \
-    if ((s)->strm->avail_out == 0) return (last) ? finish_started : need_more; \
+    if ((s)->strm->avail_out == 0 || (s)->fit == FIT_DONE) \
+        return (last) ? finish_started : need_more; \
 }
 
-/* Maximum stored block length in deflate format (not including header). */
-#define MAX_STORED 65535
-
 /* Minimum of a and b. */
 #define MIN(a, b) ((a) > (b) ? (b) : (a))
 
@@ -1742,8 +3249,9 @@ local void check_match(deflate_state *s, IPos start, IPos match, int length) {
  */
 local block_state deflate_stored(deflate_state *s, int flush) {
     /* Smallest worthy block size when not flushing or finishing. By default
-     * this is 32K. This can be as small as 507 bytes for memLevel == 1. For
-     * large input and output buffers, the stored block size will be larger.
+     * this is 32K. This can be as small as 507 bytes for memLevel == 1, or
+     * symBits == 7 for deflateInit3(). For large input and output buffers,
+     * the stored block size will be larger.
      */
     unsigned min_block = MIN(s->pending_buf_size - 5, s->w_size);
 
@@ -1838,6 +3346,7 @@ local block_state deflate_stored(deflate_state *s, int flush) {
          */
         if (used >= s->w_size) {    /* supplant the previous history */
             s->matches = 2;         /* clear hash */
+            s->hash_stale = 1;
             zmemcpy(s->window, s->strm->next_in - s->w_size, s->w_size);
             s->strstart = s->w_size;
             s->insert = s->strstart;
@@ -1847,6 +3356,7 @@ local block_state deflate_stored(deflate_state *s, int flush) {
                 /* Slide the window down. */
                 s->strstart -= s->w_size;
                 zmemcpy(s->window, s->window + s->w_size, s->strstart);
+                s->hash_stale = 1;
                 if (s->matches < 2)
                     s->matches++;   /* add a pending slide_hash() */
                 if (s->insert > s->strstart)
@@ -1874,6 +3384,7 @@ local block_state deflate_stored(deflate_state *s, int flush) {
     have = s->window_size - s->strstart;
     if (s->strm->avail_in > have && s->block_start >= (long)s->w_size) {
         /* Slide the window down. */
+        s->hash_stale = 1;
         s->block_start -= s->w_size;
         s->strstart -= s->w_size;
         zmemcpy(s->window, s->window + s->w_size, s->strstart);
@@ -1918,6 +3429,113 @@ local block_state deflate_stored(deflate_state *s, int flush) {
     return last ? finish_started : need_more;
 }
 
+/* ===========================================================================
+ * Return true if the RAND_SPAN bytes at strstart look random, so that looking
+ * for matches there would be a waste of time. The bytes must be spread evenly
+ * over all 256 values, with a sum of the squares of their counts no more than
+ * about 10% over that of random bytes, which is an order-2 entropy of at least
+ * 7.78 bits per byte. Then few of the strings of four bytes can be seen
+ * before, either in the span itself, with a small hash table of the last
+ * place each was seen, or, for every 64th of them, in the window, with the
+ * deflate hash table. That is not an exhaustive search, but matches are rarely
+ * alone -- compressible input has many of them.
+ */
+local int rand_check(deflate_state *s) {
+    Bytef *p = s->window + s->strstart;
+    uInt count[256], n;
+    ulg sum = 0, want;
+    ush last[1024];             /* one more than last position of string */
+    uInt hits = 0, h;
+    unsigned cur, was;
+    IPos match;
+
+    for (n = 0; n < 256; n++)
+        count[n] = 0;
+    for (n = 0; n < RAND_SPAN; n++)
+        count[p[n]]++;
+    for (n = 0; n < 256; n++)
+        sum += (ulg)count[n] * count[n];
+    want = (ulg)RAND_SPAN * RAND_SPAN / 256;
+    if (sum > want + want / 10 + RAND_SPAN)
+        return 0;
+
+    zmemzero(last, sizeof(last));
+    for (n = 0; n + 3 < RAND_SPAN; n++) {
+        cur = p[n] + ((unsigned)p[n + 1] << 8);
+        h = (uInt)(((cur + ((ulg)p[n + 2] << 16) + ((ulg)p[n + 3] << 24)) *
+                    0x9e3779b1UL & 0xffffffffUL) >> 22);
+        was = last[h];
+        if (was && zmemcmp(p + was - 1, p + n, 4) == 0)
+            hits++;
+        last[h] = (ush)(n + 1);
+        if ((n & 63) == 0) {
+            h = 0;
+            UPDATE_HASH(s, h, p[n]);
+            UPDATE_HASH(s, h, p[n + 1]);
+            UPDATE_HASH(s, h, p[n + 2]);
+            match = s->head[HASH_INDEX(s, h)];
+            if (match != NIL && match < s->strstart &&
+                s->strstart + n - match <= MAX_DIST(s) &&
+                zmemcmp(s->window + match, p + n, 4) == 0)
+                hits += 64;
+        }
+    }
+    return hits <= RAND_SPAN / 32;
+}
+
+/* ===========================================================================
+ * Return true if the input at strstart looks random, and set rand_left to
+ * send RAND_SPAN bytes of it as literals. Otherwise set rand_next to where to
+ * look again, waiting longer each time, up to RAND_WAIT_MAX. If there is not
+ * enough lookahead, look again once the window has been filled. This is not
+ * used for small windows.
+ */
+local int rand_look(deflate_state *s) {
+    int small = s->w_size < 2 * RAND_SPAN;
+
+    if (!small && s->lookahead < RAND_SPAN + MIN_MATCH) {
+        s->rand_next = s->strstart + s->lookahead;
+        return 0;
+    }
+    if (!small && rand_check(s)) {
+        s->rand_left = RAND_SPAN;
+        return 1;
+    }
+    s->rand_next = s->strstart + s->rand_wait;
+    if (s->rand_wait < RAND_WAIT_MAX)
+        s->rand_wait <<= 1;
+    return 0;
+}
+
+/* ===========================================================================
+ * Send the random input found by rand_look() as literals, until rand_left is
+ * zero or the block must be ended. Return true if the block must be ended.
+ * The strings are still inserted in the hash table, so that a copy of the
+ * random input later on can be found. The input after it is looked at right
+ * away.
+ */
+local int rand_literals(deflate_state *s) {
+    int bflush = 0;
+
+    do {
+        /* insert without keeping the old head, as fill_window() does */
+        UPDATE_HASH(s, s->ins_h, s->window[s->strstart + (MIN_MATCH-1)]);
+#ifndef FASTEST
+        s->prev[s->strstart & s->w_mask] = s->head[HASH_INDEX(s, s->ins_h)];
+#endif
+        s->head[HASH_INDEX(s, s->ins_h)] = (Pos)s->strstart;
+        _tr_tally_lit(s, s->window[s->strstart], bflush);
+        s->strstart++;
+        s->lookahead--;
+    } while (--s->rand_left && !bflush);
+    if (s->rand_left == 0) {
+        s->rand_next = s->strstart;
+        s->rand_wait = RAND_WAIT;
+    }
+    s->match_length = s->prev_length = MIN_MATCH-1;
+    return bflush;
+}
+
 /* ===========================================================================
  * Compress as much as possible from the input stream, return the current
  * block state.
@@ -1943,6 +3561,13 @@ local block_state deflate_fast(deflate_state *s, int flush) {
             if (s->lookahead == 0) break; /* flush the current block */
         }
 
+        /* Send random input as literals without looking for matches. */
+        if (s->rand_left || (s->strstart >= s->rand_next && rand_look(s))) {
+            if (rand_literals(s))
+                FLUSH_BLOCK(s, 0);
+            continue;
+        }
+
         /* Insert the string window[strstart .. strstart + 2] in the
          * dictionary, and set hash_head to the head of the hash chain:
          */
@@ -2018,6 +3643,159 @@ local block_state deflate_fast(deflate_state *s, int flush) {
     return block_done;
 }
 
+#ifndef FASTEST
+/* ===========================================================================
+ * Insert the string at strstart in the dictionary, and look for the longest
+ * match with it.  Return the length of the match, or 1 for no match, which
+ * means that the byte at strstart is to be sent as a literal.  Set *start to
+ * the start of the match.  This is for deflate_medium().
+ */
+local uInt medium_match(deflate_state *s, IPos *start) {
+    IPos hash_head = NIL;   /* head of the hash chain */
+    uInt len = 1;
+
+    if (s->lookahead >= MIN_MATCH) {
+        INSERT_STRING(s, s->strstart, hash_head);
+    }
+    if (hash_head != NIL && s->strstart - hash_head <= MAX_DIST(s)) {
+        len = longest_match(s, hash_head);
+        *start = s->match_start;
+        if (len < MIN_MATCH ||
+            (len <= 5 && s->strategy == Z_FILTERED) ||
+            (len == MIN_MATCH && s->strstart - *start > TOO_FAR))
+            len = 1;
+    }
+    return len;
+}
+
+/* ===========================================================================
+ * Between deflate_fast() and deflate_slow() in speed and compression. Like
+ * deflate_fast(), each position gets one search for a match, and matches are
+ * taken greedily.  Before a match or literal is sent, the match following it
+ * is searched for, and if that next match can be extended backwards to cover
+ * all but at most one byte of the current one, then the current one is
+ * dropped, or reduced to a literal.  The next match is saved in match_length
+ * and match_start for the next iteration (and deflate() call), with
+ * match_available set to one plus the number of bytes it was extended
+ * backwards.  Strings in matches are inserted in the hash table if the match
+ * length is at most max_insert_length, as for deflate_fast().
+ */
+local block_state deflate_medium(deflate_state *s, int flush) {
+    IPos hash_head;       /* head of the hash chain */
+    int bflush;           /* set if current block must be flushed */
+    uInt cur_len;         /* current match length, or 1 for a literal */
+    IPos start = 0;       /* start of the current match */
+    IPos cur;             /* position of the current match or literal */
+    uInt skip;            /* strings after cur already in the hash table */
+    uInt back;            /* bytes that the next match extends backwards */
+
+    for (;;) {
+        /* Make sure that we always have enough lookahead, except
+         * at the end of the input file, as for deflate_fast().
+         */
+        if (s->lookahead < MIN_LOOKAHEAD) {
+            fill_window(s);
+            if (s->lookahead < MIN_LOOKAHEAD && flush == Z_NO_FLUSH) {
+                return need_more;
+            }
+            if (s->lookahead == 0) break; /* flush the current block */
+        }
+
+        /* Send random input as literals, as for deflate_fast(). */
+        if (!s->match_available && (s->rand_left ||
+            (s->strstart >= s->rand_next && rand_look(s)))) {
+            if (rand_literals(s))
+                FLUSH_BLOCK(s, 0);
+            continue;
+        }
+
+        /* Take the match found at strstart last time, or look for one. */
+        skip = 0;
+        if (s->match_available) {
+            cur_len = s->match_length;
+            start = s->match_start;
+            skip = (uInt)s->match_available - 1;
+            s->match_length = MIN_MATCH-1;
+            s->match_available = 0;
+        } else
+            cur_len = medium_match(s, &start);
+
+        /* Move past the current match or literal, inserting the strings in
+         * the match if it is not too long.  If the match was extended
+         * backwards, then ins_h is for the string at strstart + skip, so
+         * continue from there.
+         */
+        cur = s->strstart;
+        s->lookahead -= cur_len;
+        if (cur_len >= MIN_MATCH && cur_len <= s->max_insert_length &&
+            s->lookahead >= MIN_MATCH) {
+            s->strstart += skip;
+            back = cur_len - 1 - skip; /* through strstart in table */
+            do {
+                s->strstart++;
+                INSERT_STRING(s, s->strstart, hash_head);
+            } while (--back != 0);
+            (void)hash_head;    /* only the next search uses the chains */
+            s->strstart++;
+        } else if (cur_len >= MIN_MATCH) {
+            s->strstart += cur_len;
+            s->ins_h = s->window[s->strstart];
+            UPDATE_HASH(s, s->ins_h, s->window[s->strstart + 1]);
+#if MIN_MATCH != 3
+            Call UPDATE_HASH() MIN_MATCH-3 more times
+#endif
+        } else
+            s->strstart++;
+
+        /* With enough lookahead for another match, find the next match now.
+         * See if it extends backwards far enough to replace the current
+         * match or literal, except possibly for its first byte.
+         */
+        back = 0;
+        if (s->lookahead >= MIN_LOOKAHEAD) {
+            s->match_length = medium_match(s, &s->match_start);
+            s->match_available = 1;
+            if (s->match_length >= MIN_MATCH) {
+                Bytef *scan = s->window + s->strstart;
+                Bytef *match = s->window + s->match_start;
+
+                while (back < cur_len && back < s->match_start &&
+                       s->match_length + back < MAX_MATCH &&
+                       scan[-1 - (int)back] == match[-1 - (int)back])
+                    back++;
+                if (back + 1 < cur_len)
+                    back = 0;
+                s->strstart -= back;
+                s->lookahead += back;
+                s->match_start -= back;
+                s->match_length += back;
+                s->match_available = 1 + (int)back;
+                cur_len -= back;
+            }
+        }
+
+        /* Send what is left of the current match or literal. */
+        bflush = 0;
+        if (cur_len >= MIN_MATCH) {
+            check_match(s, cur, start, cur_len);
+            _tr_tally_dist(s, cur - start, cur_len - MIN_MATCH, bflush);
+        } else if (cur_len) {
+            Tracevv((stderr,"%c", s->window[cur]));
+            _tr_tally_lit(s, s->window[cur], bflush);
+        }
+        if (bflush) FLUSH_BLOCK(s, 0);
+    }
+    s->insert = s->strstart < MIN_MATCH-1 ? s->strstart : MIN_MATCH-1;
+    if (flush == Z_FINISH) {
+        FLUSH_BLOCK(s, 1);
+        return finish_done;
+    }
+    if (s->sym_next)
+        FLUSH_BLOCK(s, 0);
+    return block_done;
+}
+#endif /* !FASTEST */
+
 #ifndef FASTEST
 /* ===========================================================================
  * Same as above, but achieves better compression. We use a lazy
@@ -2043,6 +3821,14 @@ local block_state deflate_slow(deflate_state *s, int flush) {
             if (s->lookahead == 0) break; /* flush the current block */
         }
 
+        /* Send random input as literals, as for deflate_fast(). */
+        if (!s->match_available && (s->rand_left ||
+            (s->strstart >= s->rand_next && rand_look(s)))) {
+            if (rand_literals(s))
+                FLUSH_BLOCK(s, 0);
+            continue;
+        }
+
         /* Insert the string window[strstart .. strstart + 2] in the
          * dictionary, and set hash_head to the head of the hash chain:
          */
@@ -2129,7 +3915,8 @@ local block_state deflate_slow(deflate_state *s, int flush) {
                 } else {
                     return -1; // Indicate an error to avoid underflow
                 }
-                if (s->strm->avail_out == 0) return need_more;
+                if (s->strm->avail_out == 0 || s->fit == FIT_DONE)
+                    return need_more;
             } else {
                 return -1; // Indicate an error for out-of-bounds access
             }
@@ -2153,7 +3940,226 @@ local block_state deflate_slow(deflate_state *s, int flush) {
         FLUSH_BLOCK(s, 1);
         return finish_done;
     }
-    if (s->sym_next)
+    while (s->sym_next)     /* twice if that literal ended a block early */
+        FLUSH_BLOCK(s, 0);
+    return block_done;
+}
+
+/* ===========================================================================
+ * Find the matches for deflate_optimal() at the string cur, starting with the
+ * hash chain at cur_match, and no longer than max. Save the lengths and
+ * distances of the closest matches for increasing lengths in len[] and
+ * dist[], and return the number of them. If there are more than OPT_PAIRS,
+ * the last one is replaced by each longer match, which then also serves the
+ * shorter lengths of the ones it replaced.
+ */
+local unsigned opt_matches(deflate_state *s, IPos cur, IPos cur_match,
+                           unsigned max, ushf *len, ushf *dist) {
+    unsigned chain_length = s->max_chain_length;
+    unsigned nice_match = (unsigned)s->nice_match < max ?
+                          (unsigned)s->nice_match : max;
+    unsigned best = MIN_MATCH - 1;      /* longest match so far */
+    unsigned n = 0;                     /* number of matches saved */
+    unsigned k;
+    Bytef *scan = s->window + cur;
+    Bytef *match;
+    IPos limit = cur > (IPos)MAX_DIST(s) ? cur - (IPos)MAX_DIST(s) : NIL;
+
+    while (cur_match > limit && chain_length-- != 0) {
+        Assert(cur_match < cur, "no future");
+        Stat(s->stats.chains++);
+        match = s->window + cur_match;
+        if (match[best] == scan[best] && match[0] == scan[0] &&
+            match[1] == scan[1]) {
+            k = 2;
+#ifdef MATCH_SIMD
+            if (max == MAX_MATCH)       /* all MAX_MATCH bytes are input */
+                k += compare_match(scan + 2, match + 2);
+            else
+#endif
+                while (k < max && match[k] == scan[k])
+                    k++;
+            if (k > best) {
+                best = k;
+                if (n == OPT_PAIRS)
+                    n--;
+                len[n] = (ush)k;
+                dist[n++] = (ush)(cur - cur_match);
+                if (k >= nice_match)
+                    break;
+            }
+        }
+        cur_match = s->prev[cur_match & s->w_mask];
+    }
+    return n;
+}
+
+/* ===========================================================================
+ * Find the least cost parse of the n bytes at strstart with the current
+ * costs, and save it in try_len[] and try_dist[]. Return the number of
+ * symbols in the parse.
+ */
+local unsigned opt_path(deflate_state *s, unsigned n) {
+    opt_state *o = s->opt;
+    Bytef *buf = s->window + s->strstart;
+    uInt *cost = o->cost;
+    uInt here, dcost, c;
+    unsigned i, k, len, end, count;
+
+    cost[0] = 0;
+    for (i = 1; i <= n; i++)
+        cost[i] = (uInt)-1;
+    for (i = 0; i < n; i++) {
+        here = cost[i];
+        c = here + o->lit_cost[buf[i]];
+        if (c < cost[i + 1]) {
+            cost[i + 1] = c;
+            o->from[i + 1] = 1;
+            o->from_dist[i + 1] = 0;
+        }
+        len = MIN_MATCH;
+        for (k = 0; k < o->pairs[i] && len <= n - i; k++) {
+            end = o->mlen[i][k] < n - i ? o->mlen[i][k] : n - i;
+            dcost = here + o->dist_cost[d_index(o->mdist[i][k] - 1)];
+            for (; len <= end; len++) {
+                c = dcost + o->len_cost[len];
+                if (c < cost[i + len]) {
+                    cost[i + len] = c;
+                    o->from[i + len] = (ush)len;
+                    o->from_dist[i + len] = o->mdist[i][k];
+                }
+            }
+        }
+    }
+
+    /* Follow the parse back from the end, and save it in order */
+    count = 0;
+    for (i = n; i; i -= o->from[i])
+        count++;
+    k = count;
+    for (i = n; i; i -= o->from[i]) {
+        k--;
+        o->try_len[k] = o->from[i];
+        o->try_dist[k] = o->from_dist[i];
+    }
+    return count;
+}
+
+/* ===========================================================================
+ * Parse the next n bytes at strstart for deflate_optimal(), inserting them in
+ * the hash table. The matches at each position are found once. The first
+ * parse uses the costs of the fixed codes, and each parse after that uses the
+ * costs of the dynamic codes that the parse before would get. The parse with
+ * the fewest bits with its own codes is kept in len[] and dist[].
+ */
+local void opt_parse(deflate_state *s, unsigned n) {
+    opt_state *o = s->opt;
+    Bytef *buf = s->window + s->strstart;
+    IPos hash_head;
+    unsigned i, k, count, pass, passes;
+    ulg bits, best = (ulg)-1, last = 0;
+
+    for (i = 0; i < n; i++) {
+        unsigned have = s->lookahead - i;
+
+        o->pairs[i] = 0;
+        if (have >= MIN_MATCH) {
+            INSERT_STRING(s, s->strstart + i, hash_head);
+            o->pairs[i] = (uch)opt_matches(s, s->strstart + i, hash_head,
+                                           have < MAX_MATCH ? have : MAX_MATCH,
+                                           o->mlen[i], o->mdist[i]);
+        }
+    }
+
+    _tr_opt_cost(s, buf, Z_NULL, Z_NULL, 0,
+                 o->lit_cost, o->len_cost, o->dist_cost);
+    passes = s->strategy == Z_FIXED || s->max_opt_passes == 0 ? 1 :
+             s->max_opt_passes;
+    for (pass = 0; pass < passes; pass++) {
+        count = opt_path(s, n);
+
+        /* Cost the parse with its own codes, which the next pass uses */
+        bits = 0;
+        if (passes > 1) {
+            _tr_opt_cost(s, buf, o->try_len, o->try_dist, count,
+                         o->lit_cost, o->len_cost, o->dist_cost);
+            for (i = 0, k = 0; k < count; i += o->try_len[k++])
+                bits += o->try_len[k] == 1 ? o->lit_cost[buf[i]] :
+                        o->len_cost[o->try_len[k]] +
+                        o->dist_cost[d_index(o->try_dist[k] - 1)];
+        }
+        if (bits < best) {
+            best = bits;
+            o->count = count;
+            zmemcpy((Bytef *)o->len, (Bytef *)o->try_len, count * sizeof(ush));
+            zmemcpy((Bytef *)o->dist, (Bytef *)o->try_dist,
+                    count * sizeof(ush));
+        }
+        if (bits == last)               /* the parse has settled */
+            break;
+        last = bits;
+    }
+    o->next = 0;
+}
+
+/* ===========================================================================
+ * For level 10, find the least cost sequence of literals and matches for each
+ * chunk of input, as costed by the codes that the sequence itself would get.
+ * This is much slower than deflate_slow(), and usually gives a few percent
+ * less compressed data. The chunks are as long as OPT_CHUNK, or as much as
+ * the window holds, so that the compressed data does not depend on how the
+ * input is provided.
+ */
+local block_state deflate_optimal(deflate_state *s, int flush) {
+    opt_state *o = s->opt;
+    unsigned n, length, distance;
+    int bflush;                 /* set if current block must be flushed */
+
+    for (;;) {
+        /* Tally the symbols of the last parse */
+        while (o->next < o->count) {
+            length = o->len[o->next];
+            distance = o->dist[o->next++];
+            if (length == 1) {
+                Tracevv((stderr,"%c", s->window[s->strstart]));
+                _tr_tally_lit(s, s->window[s->strstart], bflush);
+            }
+            else {
+                check_match(s, s->strstart, s->strstart - distance,
+                            (int)length);
+                _tr_tally_dist(s, distance, length - MIN_MATCH, bflush);
+            }
+            s->strstart += length;
+            s->lookahead -= length;
+            if (bflush) FLUSH_BLOCK(s, 0);
+        }
+
+        /* Get a chunk of input and the lookahead for its matches, or as much
+         * as the window holds, or the rest of the input for a flush.
+         */
+        while (s->lookahead < OPT_CHUNK + MIN_LOOKAHEAD &&
+               s->strm->avail_in != 0 &&
+               ((ulg)s->strstart + s->lookahead < s->window_size ||
+                s->strstart >= s->w_size + MAX_DIST(s)))
+            fill_window(s);
+        if (s->lookahead >= OPT_CHUNK + MIN_LOOKAHEAD)
+            n = OPT_CHUNK;
+        else if (s->strm->avail_in != 0)
+            n = s->lookahead - MIN_LOOKAHEAD;   /* the window is full */
+        else if (flush == Z_NO_FLUSH)
+            return need_more;
+        else if (s->lookahead == 0)
+            break;
+        else
+            n = s->lookahead < OPT_CHUNK ? s->lookahead : OPT_CHUNK;
+        opt_parse(s, n);
+    }
+    s->insert = s->strstart < MIN_MATCH-1 ? s->strstart : MIN_MATCH-1;
+    if (flush == Z_FINISH) {
+        FLUSH_BLOCK(s, 1);
+        return finish_done;
+    }
+    while (s->sym_next)
         FLUSH_BLOCK(s, 0);
     return block_done;
 }
@@ -2167,7 +4173,7 @@ local block_state deflate_slow(deflate_state *s, int flush) {
 local block_state deflate_rle(deflate_state *s, int flush) {
     int bflush;             /* set if current block must be flushed */
     uInt prev;              /* byte at distance one to match */
-    Bytef *scan, *strend;   /* scan goes up to strend for length of run */
+    Bytef *scan;            /* start of the run */
 
     for (;;) {
         /* Make sure that we always have enough lookahead, except
@@ -2182,31 +4188,17 @@ local block_state deflate_rle(deflate_state *s, int flush) {
             if (s->lookahead == 0) break; /* flush the current block */
         }
 
-        /* See how many times the previous byte repeats */
+        /* See how many times the previous byte repeats, checking the first
+           three bytes one at a time to get quickly past literals */
         s->match_length = 0;
         if (s->lookahead >= MIN_MATCH && s->strstart > 0) {
-            scan = s->window + s->strstart - 1;
-            prev = *scan;
-            if (prev == *++scan && prev == *++scan && prev == *++scan) {
-                strend = s->window + s->strstart + MAX_MATCH;
-
-                if (strend > s->window + s->window_size) {
-                    strend = s->window + s->window_size;
-                }
-
-                do {
-                } while (prev == *++scan && prev == *++scan &&
-                         prev == *++scan && prev == *++scan &&
-                         prev == *++scan && prev == *++scan &&
-                         prev == *++scan && prev == *++scan &&
-                         scan < strend);
-
-                s->match_length = MAX_MATCH - (uInt)(strend - scan);
-                if (s->match_length > s->lookahead)
-                    s->match_length = s->lookahead;
-            }
-            Assert(scan <= s->window + (uInt)(s->window_size - 1),
-                   "wild scan");
+            scan = s->window + s->strstart;
+            prev = scan[-1];
+            if (prev == scan[0] && prev == scan[1] && prev == scan[2])
+                s->match_length = MIN_MATCH +
+                    rle_run(scan + MIN_MATCH, prev,
+                            (s->lookahead < MAX_MATCH ? s->lookahead :
+                                                        MAX_MATCH) - MIN_MATCH);
         }
 
         /* Emit match if have run of MIN_MATCH or longer, else emit literal */
@@ -2217,6 +4209,19 @@ local block_state deflate_rle(deflate_state *s, int flush) {
 
             s->lookahead -= s->match_length;
             s->strstart += s->match_length;
+
+            /* A run that filled the match may go on.  Tally what follows of
+               it here while the lookahead is enough, which is what the next
+               time around would do, without its checks. */
+            while (s->match_length == MAX_MATCH && !bflush &&
+                   s->lookahead >= MAX_MATCH &&
+                   (s->match_length = rle_run(s->window + s->strstart, prev,
+                                              MAX_MATCH)) >= MIN_MATCH) {
+                check_match(s, s->strstart, s->strstart - 1, s->match_length);
+                _tr_tally_dist(s, 1, s->match_length - MIN_MATCH, bflush);
+                s->lookahead -= s->match_length;
+                s->strstart += s->match_length;
+            }
             s->match_length = 0;
         } else {
             /* No match, output a literal byte */
@@ -2246,6 +4251,7 @@ local block_state deflate_rle(deflate_state *s, int flush) {
  */
 local block_state deflate_huff(deflate_state *s, int flush) {
     int bflush;             /* set if current block must be flushed */
+    uInt n;                 /* number of literals to tally */
 
     for (;;) {
         /* Make sure that we have a literal to write. */
@@ -2258,12 +4264,15 @@ local block_state deflate_huff(deflate_state *s, int flush) {
             }
         }
 
-        /* Output a literal byte */
+        /* Output as many literal bytes as there are, up to the next check
+           for the end of the block */
         s->match_length = 0;
-        Tracevv((stderr,"%c", s->window[s->strstart]));
-        _tr_tally_lit(s, s->window[s->strstart], bflush);
-        s->lookahead--;
-        s->strstart++;
+        n = (s->sym_end - s->sym_next) / SYM_SIZE;
+        if (n > s->lookahead)
+            n = s->lookahead;
+        bflush = _tr_tally_lits(s, s->window + s->strstart, n);
+        s->lookahead -= n;
+        s->strstart += n;
         if (bflush) FLUSH_BLOCK(s, 0);
     }
     s->insert = 0;
@@ -2275,3 +4284,103 @@ local block_state deflate_huff(deflate_state *s, int flush) {
         FLUSH_BLOCK(s, 0);
     return block_done;
 }
+
+/* ===========================================================================
+ * For Z_QUICK, look for a match at only the most recent string with the same
+ * hash, and send the symbols immediately using the static trees.  Do not
+ * insert the strings inside of matches.  A block is ended only when deflate()
+ * is asked to flush or finish, which limits this to block flushes at the end
+ * of a deflate() call.  The bits go directly to pending_buf, which is flushed
+ * whenever it is close to full, since there is no sym_buf to save.
+ */
+local block_state deflate_quick(deflate_state *s, int flush) {
+    IPos hash_head;         /* head of the hash chain */
+    unsigned len;           /* length of the current match */
+    int last = flush == Z_FINISH;
+
+    if (last && s->block_open != 2) {
+        /* end any non-last block, and start the last one */
+        if (s->block_open) {
+            _tr_quick_end(s, 0);
+            s->block_open = 0;
+        }
+        _tr_quick_start(s, 1);
+        s->block_open = 2;
+        s->block_start = (long)s->strstart;
+    }
+
+    for (;;) {
+        /* Make sure that there is room in pending_buf for the longest
+         * symbol or the end of the block, plus what bi_buf may need to write
+         * out with it.
+         */
+        if (s->pending + 16 > s->pending_buf_size) {
+            flush_pending(s->strm);
+            if (s->strm->avail_out == 0)
+                return need_more;
+        }
+
+        /* Make sure that we always have enough lookahead, except at the end
+         * of the input file, as for deflate_fast().
+         */
+        if (s->lookahead < MIN_LOOKAHEAD) {
+            fill_window(s);
+            if (s->lookahead < MIN_LOOKAHEAD && flush == Z_NO_FLUSH)
+                return need_more;
+            if (s->lookahead == 0) break; /* end the current block */
+        }
+        if (s->block_open == 0) {
+            /* start a block only once there is data for it */
+            _tr_quick_start(s, 0);
+            s->block_open = 1;
+            s->block_start = (long)s->strstart;
+        }
+
+        /* Insert the string window[strstart .. strstart + 2] in the
+         * dictionary, and see if the previous string with the same hash is a
+         * match.
+         */
+        len = 0;
+        if (s->lookahead >= MIN_MATCH) {
+            INSERT_STRING(s, s->strstart, hash_head);
+            if (hash_head != NIL &&
+                s->strstart - hash_head <= MAX_DIST(s)) {
+                Bytef *scan = s->window + s->strstart;
+                Bytef *match = s->window + hash_head;
+
+                if (scan[0] == match[0] && scan[1] == match[1]) {
+                    len = 2 + compare_match(scan + 2, match + 2);
+                    if (len > s->lookahead)
+                        len = s->lookahead;
+                }
+            }
+        }
+        if (len >= MIN_MATCH) {
+            check_match(s, s->strstart, hash_head, len);
+            _tr_quick_dist(s, s->strstart - hash_head, len - MIN_MATCH);
+            s->lookahead -= len;
+            s->strstart += len;
+            s->ins_h = s->window[s->strstart];
+            UPDATE_HASH(s, s->ins_h, s->window[s->strstart + 1]);
+#if MIN_MATCH != 3
+            Call UPDATE_HASH() MIN_MATCH-3 more times
+#endif
+        } else {
+            /* No match, output a literal byte */
+            Tracevv((stderr,"%c", s->window[s->strstart]));
+            _tr_quick_lit(s, s->window[s->strstart]);
+            s->lookahead--;
+            s->strstart++;
+        }
+    }
+    s->insert = s->strstart < MIN_MATCH-1 ? s->strstart : MIN_MATCH-1;
+    if (s->block_open) {
+        _tr_quick_end(s, last);
+        s->block_open = 0;
+        s->block_start = (long)s->strstart;
+        flush_pending(s->strm);
+        if (s->strm->avail_out == 0)
+            return last ? finish_started : need_more;
+    }
+    return last ? finish_done : block_done;
+}
@@ -23,6 +23,13 @@
 #  define GZIP
 #endif
 
+/* define ZLIB_STATS when compiling to have deflate and inflate count the
+   blocks, symbols, and search effort reported by deflateGetStats() and
+   inflateGetStats().  The counters cost nothing when it is not defined. */
+#if defined(ZLIB_STATS) && !defined(Z_SOLO)
+#  include <time.h>
+#endif
+
 /* define LIT_MEM to slightly increase the speed of deflate (order 1% to 2%) at
    the cost of a larger memory footprint */
 /* #define LIT_MEM */
@@ -52,7 +59,29 @@
 #define MAX_BITS 15
 /* All codes must not exceed MAX_BITS bits */
 
-#define Buf_size 16
+#ifdef MAXSEG_64K
+#  define MAX_HASH_BITS (MAX_MEM_LEVEL + 7)
+#else
+#  define MAX_HASH_BITS 24
+#endif
+/* Largest hash table for deflateInit3(), as log2 of the number of entries.
+ * deflateInit2() stops at memLevel + 7. At 24 bits the Z_HASH_SHIFT hash is
+ * the three bytes of the string, so a chain never has a collision.
+ */
+
+/* On 64-bit machines, accumulate the output bits in 64 bits instead of 16, so
+ * they are written to pending_buf eight bytes at a time. Define NO_BI_BUF64 to
+ * always use 16 bits.
+ */
+#if defined(Z_U8) && !defined(NO_BI_BUF64) && \
+    (defined(__LP64__) || defined(_WIN64))
+#  define BI_BUF64
+typedef Z_U8 bitbuf;
+#  define Buf_size 64
+#else
+typedef ush bitbuf;
+#  define Buf_size 16
+#endif
 /* size of bit buffer in bi_buf */
 
 #define INIT_STATE    42    /* zlib header -> BUSY_STATE */
@@ -101,6 +130,14 @@ typedef unsigned IPos;
  * save space in the various tables. IPos is used only for parameter passing.
  */
 
+/* Buffers shared by states from deflateFork(), which are in the allocation
+ * of the state they were carved out for.
+ */
+typedef struct deflate_share_s {
+    unsigned refs;      /* number of states sharing the buffers */
+    voidpf block;       /* the allocation that holds the buffers */
+} FAR deflate_share;
+
 typedef struct internal_state {
     z_streamp strm;      /* pointer back to this zlib stream */
     int   status;        /* as the name implies */
@@ -127,9 +164,13 @@ typedef struct internal_state {
      * wSize-MAX_MATCH bytes, but this ensures that IO is always
      * performed with a length multiple of the block size. Also, it limits
      * the window size to 64K, which is quite useful on MSDOS.
-     * To do: use the user input buffer as sliding window.
+     * After deflateOneShot(), window can point into the user input buffer
+     * instead, in which case it is slid by moving the pointer.
      */
 
+    Bytef *window_buf;  /* allocated window, the same as window normally */
+    int direct;         /* 1 after deflateOneShot(), 2 if window is input */
+
     ulg window_size;
     /* Actual size of window: 2*wSize, except when the user input buffer
      * is directly used as sliding window.
@@ -155,6 +196,9 @@ typedef struct internal_state {
      *   hash_shift * MIN_MATCH >= hash_bits
      */
 
+    ulg   hash_mul;       /* multiplier for ins_h to head[] index, or 1 */
+    uInt  hash_out;       /* bits to drop from the product, or 0 */
+
     long block_start;
     /* Window position at the beginning of the current output block. Gets
      * negative when the window is moved backwards.
@@ -181,15 +225,20 @@ typedef struct internal_state {
     uInt max_lazy_match;
     /* Attempt to find a better match only when the current match is strictly
      * smaller than this value. This mechanism is used only for compression
-     * levels >= 4.
+     * levels >= 5.
      */
 #   define max_insert_length  max_lazy_match
     /* Insert new strings in the hash table only if the match length is not
      * greater than this length. This saves time but degrades compression.
-     * max_insert_length is used only for compression levels <= 3.
+     * max_insert_length is used only for compression levels <= 4.
+     */
+#   define max_opt_passes  max_lazy_match
+    /* Number of times deflate_optimal() parses each chunk of input, each time
+     * with the costs from the codes for the parse before. This is used only
+     * for compression level 10.
      */
 
-    int level;    /* compression level (1..9) */
+    int level;    /* compression level (0..10) */
     int strategy; /* favor or force Huffman coding*/
 
     uInt good_match;
@@ -223,12 +272,15 @@ typedef struct internal_state {
 
 #ifdef LIT_MEM
 #   define LIT_BUFS 5
+#   define SYM_SIZE 1
     ushf *d_buf;          /* buffer for distances */
     uchf *l_buf;          /* buffer for literals/lengths */
 #else
 #   define LIT_BUFS 4
+#   define SYM_SIZE 3
     uchf *sym_buf;        /* buffer for distances and literals/lengths */
 #endif
+/* SYM_SIZE is the sym_next increment for each symbol */
 
     uInt  lit_bufsize;
     /* Size of match buffer for literals/lengths.  There are 4 reasons for
@@ -251,7 +303,49 @@ typedef struct internal_state {
      */
 
     uInt sym_next;      /* running index in symbol buffer */
-    uInt sym_end;       /* symbol table full when sym_next reaches this */
+    uInt sym_end;       /* check for the end of the block at this sym_next */
+    uInt sym_max;       /* symbol table full when sym_next reaches this */
+
+#   define SPLIT_TYPES 10
+    uInt split_seen[SPLIT_TYPES];
+    /* Numbers of the symbols of each type in the current block as of the last
+     * check by _tr_block_end(), which ends the block early if the symbols
+     * since then are distributed differently.
+     */
+    uInt sym_seen;      /* sym_next at that check */
+    uInt sym_split;     /* if not zero, end the block at this sym_next */
+    uInt split_tail;    /* input bytes of the symbols past sym_split */
+    uInt split_keep;    /* sym_next length of the symbols in split_buf */
+
+#   define SPLIT_STEP 512
+    /* number of symbols between the checks of _tr_block_end() */
+    uch split_buf[SPLIT_STEP * 3];
+    /* The symbols past sym_split, which start the next block. They are moved
+     * here while the block is sent, since the output in pending_buf may cover
+     * them in sym_buf, and are moved back once the output is flushed.
+     */
+
+    int fit;            /* deflateFitBlock() progress, or FIT_OFF */
+#   define FIT_OFF 0
+#   define FIT_ON 1     /* checking that the block so far fits */
+#   define FIT_END 2    /* the last block ends at fit_sym */
+#   define FIT_DONE 3   /* the last block has been sent */
+#   define FIT_EMPTY 10 /* bits in an empty block with static trees */
+    ulg fit_room;       /* bits of output that the last block must end by */
+    uInt fit_ok;        /* sym_next of the longest start known to fit */
+    ulg fit_len;        /* input bytes covered by the symbols up to fit_ok */
+    uInt fit_sym;       /* sym_next where the last block ends, for FIT_END */
+    ulg fit_rest;       /* input bytes left uncompressed, for FIT_DONE */
+
+#   define ADAPT_STEPS 10
+    ulg adapt_rate;     /* deflateThroughput() target in bytes/s, or 0 */
+    int adapt_step;     /* index of the search parameters in use, or -1 */
+    ulg adapt_in;       /* input bytes since the last adjustment */
+    ulg adapt_us;       /* microseconds in deflate() for those bytes */
+    ulg adapt_seen[ADAPT_STEPS];
+    /* The last measured rate in bytes/s for each set of search parameters, or
+     * 0 if not tried yet.
+     */
 
     ulg opt_len;        /* bit length of current block with optimal trees */
     ulg static_len;     /* bit length of current block with static trees */
@@ -263,13 +357,13 @@ typedef struct internal_state {
     ulg bits_sent;      /* bit length of compressed data sent mod 2^32 */
 #endif
 
-    ush bi_buf;
+    bitbuf bi_buf;
     /* Output buffer. bits are inserted starting at the bottom (least
      * significant bits).
      */
     int bi_valid;
-    /* Number of valid bits in bi_buf.  All bits above the last valid bit
-     * are always zero.
+    /* Number of valid bits in bi_buf, less than Buf_size.  All bits above the
+     * last valid bit are always zero.
      */
 
     ulg high_water;
@@ -279,6 +373,58 @@ typedef struct internal_state {
      * updated to the new high water mark.
      */
 
+    int block_open;
+    /* For deflate_quick(), 0 if no block is open, 1 if a block is open, or 2
+     * if the last block is open.
+     */
+
+    int hash_stale;
+    /* True if head[] may hold strings that have since been moved in or out of
+     * the window, in which case deflateReset() clears all of head[] instead of
+     * just the entries for the strings in the window.
+     */
+
+    struct opt_state_s FAR *opt;
+    /* For deflate_optimal(), the matches and the parse of the current chunk
+     * of input. This is allocated only for level 10, and is otherwise Z_NULL.
+     */
+
+    uInt rand_next;     /* strstart at which to look for random input next */
+    uInt rand_wait;     /* bytes to wait after input that was not random */
+    uInt rand_left;     /* bytes of random input left to send as literals */
+    /* deflate_fast(), deflate_medium(), and deflate_slow() send input that
+     * looks random as literals, as for Z_HUFFMAN_ONLY, without looking for
+     * matches. The next look after input that was not random is rand_wait
+     * bytes later, which doubles each time, up to a limit, so that
+     * compressible input is rarely looked at.
+     */
+
+    deflate_share FAR *share;
+    /* For a state from deflateFork(), the buffers it shares with other
+     * states, or Z_NULL if it has its own. A sharing state is allocated
+     * alone, and gets buffers of its own before it next changes them.
+     */
+
+    int idle;
+    /* True if deflateIdle() has released the window, hash tables, and
+     * pending buffer. The state is then allocated alone, followed by the last
+     * strstart bytes of the window, which window points to, and gets its
+     * buffers back before it next changes them.
+     */
+    int compact;        /* true to idle after each flush that permits it */
+
+    z_offload offload;
+    int offloaded;
+    /* The backend from deflateOffload(), and 1 if it has the stream, -1 if it
+     * declined the stream or could not be offered it, or 0 if it has not been
+     * offered the stream yet.
+     */
+
+#ifdef ZLIB_STATS
+    z_stats stats;      /* counts returned by deflateGetStats() */
+    ulg tree_ticks;     /* clock() ticks spent building trees */
+#endif
+
 } FAR deflate_state;
 
 /* Output a byte on the stream.
@@ -304,12 +450,28 @@ typedef struct internal_state {
         /* in trees.c */
 void ZLIB_INTERNAL _tr_init(deflate_state *s);
 int ZLIB_INTERNAL _tr_tally(deflate_state *s, unsigned dist, unsigned lc);
+int ZLIB_INTERNAL _tr_tally_lits(deflate_state *s, const Bytef *buf,
+                                 unsigned n);
 void ZLIB_INTERNAL _tr_flush_block(deflate_state *s, charf *buf,
                                    ulg stored_len, int last);
+int ZLIB_INTERNAL _tr_block_end(deflate_state *s);
+void ZLIB_INTERNAL _tr_split_restore(deflate_state *s);
+void ZLIB_INTERNAL _tr_fit(deflate_state *s);
 void ZLIB_INTERNAL _tr_flush_bits(deflate_state *s);
 void ZLIB_INTERNAL _tr_align(deflate_state *s);
+void ZLIB_INTERNAL _tr_sync(deflate_state *s);
 void ZLIB_INTERNAL _tr_stored_block(deflate_state *s, charf *buf,
                                     ulg stored_len, int last);
+void ZLIB_INTERNAL _tr_quick_start(deflate_state *s, int last);
+void ZLIB_INTERNAL _tr_quick_lit(deflate_state *s, unsigned c);
+void ZLIB_INTERNAL _tr_quick_dist(deflate_state *s, unsigned dist,
+                                  unsigned lc);
+void ZLIB_INTERNAL _tr_quick_end(deflate_state *s, int last);
+void ZLIB_INTERNAL _tr_opt_cost(deflate_state *s, const Bytef *buf,
+                                const ushf *plen, const ushf *pdist,
+                                unsigned count, uchf *lit, uchf *len,
+                                uchf *dist);
+ulg ZLIB_INTERNAL _tr_estimate(deflate_state *s);
 
 #define d_code(dist) \
    ((dist) < 256 ? _dist_code[dist] : _dist_code[256+((dist)>>7)])
@@ -335,7 +497,7 @@ void ZLIB_INTERNAL _tr_stored_block(deflate_state *s, charf *buf,
     s->d_buf[s->sym_next] = 0; \
     s->l_buf[s->sym_next++] = cc; \
     s->dyn_ltree[cc].Freq++; \
-    flush = (s->sym_next == s->sym_end); \
+    flush = (s->sym_next == s->sym_end && _tr_block_end(s)); \
    }
 # define _tr_tally_dist(s, distance, length, flush) \
   { uch len = (uch)(length); \
@@ -345,7 +507,7 @@ void ZLIB_INTERNAL _tr_stored_block(deflate_state *s, charf *buf,
     dist--; \
     s->dyn_ltree[_length_code[len]+LITERALS+1].Freq++; \
     s->dyn_dtree[d_code(dist)].Freq++; \
-    flush = (s->sym_next == s->sym_end); \
+    flush = (s->sym_next == s->sym_end && _tr_block_end(s)); \
   }
 #else
 # define _tr_tally_lit(s, c, flush) \
@@ -354,7 +516,7 @@ void ZLIB_INTERNAL _tr_stored_block(deflate_state *s, charf *buf,
     s->sym_buf[s->sym_next++] = 0; \
     s->sym_buf[s->sym_next++] = cc; \
     s->dyn_ltree[cc].Freq++; \
-    flush = (s->sym_next == s->sym_end); \
+    flush = (s->sym_next == s->sym_end && _tr_block_end(s)); \
    }
 # define _tr_tally_dist(s, distance, length, flush) \
   { uch len = (uch)(length); \
@@ -365,7 +527,7 @@ void ZLIB_INTERNAL _tr_stored_block(deflate_state *s, charf *buf,
     dist--; \
     s->dyn_ltree[_length_code[len]+LITERALS+1].Freq++; \
     s->dyn_dtree[d_code(dist)].Freq++; \
-    flush = (s->sym_next == s->sym_end); \
+    flush = (s->sym_next == s->sym_end && _tr_block_end(s)); \
   }
 #endif
 #else
@@ -1,7 +1,7 @@
 /* gzappend -- command to append to a gzip file
 
   Copyright (C) 2003, 2012 Mark Adler, all rights reserved
-  version 1.2, 11 Oct 2012
+  version 1.3, 15 Oct 2026
 
   This software is provided 'as-is', without any express or implied
   warranty.  In no event will the author be held liable for any damages
@@ -41,6 +41,10 @@
  *                        (Why you ask?  Because it was fun to write!)
  * 1.2  11 Oct 2012     - Fix for proper z_const usage
  *                      - Check for input buffer malloc failure
+ * 1.3  15 Oct 2026     - Add -r to keep an append point record at the end
+ *                      - Use the record when there is one instead of
+ *                        decompressing the whole gzip file
+ *                      - Truncate the gzip file after the new trailer
  */
 
 /*
@@ -75,6 +79,21 @@
    append is simply compressed using deflate, and written to the gzip file.
    When that is complete, the new CRC-32 and uncompressed length are written
    as the trailer of the gzip file.
+
+   Decompressing the whole gzip file takes time in proportion to its size,
+   which for a large log can be much more than the time to compress what is
+   appended.  The -r option avoids that for later appends.  It ends the deflate
+   stream with an empty stored block, and follows the gzip file with an "append
+   point" record: the bit offset of the last block bit, the offset of the
+   trailer, the CRC-32 and length, and the last 32K of uncompressed data,
+   itself compressed.  The record is an empty gzip member with the append point
+   in the extra field, so the file still decompresses to the same data with
+   gzip or zlib.  When gzappend finds a record that matches the trailer before
+   it, it uses that instead of decompressing the file, so the append takes
+   time in proportion to only the appended data.  The record is then updated
+   after the new trailer, with or without -r.  If the file was changed by
+   something else, such as appending another gzip member, then the record no
+   longer matches and gzappend decompresses the file as before.
  */
 
 #include <stdio.h>
@@ -88,6 +107,8 @@
 #define LGCHUNK 14
 #define CHUNK (1U << LGCHUNK)
 #define DSIZE 32768U
+#define RECHEAD 57U             /* record bytes other than the window */
+#define RECMAX (22U + 65535U)   /* largest record, with an extra field */
 
 /* print an error message and terminate with extreme prejudice */
 local void bye(char *msg1, char *msg2)
@@ -252,17 +273,155 @@ local void gzheader(file *in)
     if (flags & 2) skip(in, 2);
 }
 
+/* where and how to continue the deflate stream in a gzip file */
+typedef struct {
+    off_t mark;                 /* bit offset in file of the last block bit */
+    off_t end;                  /* offset of the gzip trailer */
+    int left;                   /* unused bits in the byte before end */
+    unsigned long crc;          /* CRC-32 of the uncompressed data */
+    unsigned long tot;          /* length of the uncompressed data */
+    unsigned have;              /* bytes of uncompressed data in window */
+    unsigned char *window;      /* last DSIZE bytes of uncompressed data */
+    int record;                 /* true to write an append point record */
+} point;
+
+/* get a four-byte unsigned integer, little-endian, from buf */
+local unsigned long get4(unsigned char *buf)
+{
+    return buf[0] + ((unsigned)buf[1] << 8) + ((unsigned long)buf[2] << 16) +
+           ((unsigned long)buf[3] << 24);
+}
+
+/* put a four-byte unsigned integer, little-endian, in buf */
+local void put4(unsigned char *buf, unsigned long val)
+{
+    int n;
+
+    for (n = 0; n < 4; n++) {
+        buf[n] = (unsigned char)val;
+        val >>= 8;
+    }
+}
+
+/* get an eight-byte file offset, little-endian, from buf */
+local off_t get8(unsigned char *buf)
+{
+    int n;
+    off_t val;
+
+    val = 0;
+    for (n = 7; n >= 0; n--)
+        val = (val << 8) + buf[n];
+    return val;
+}
+
+/* put an eight-byte file offset, little-endian, in buf */
+local void put8(unsigned char *buf, off_t val)
+{
+    int n;
+
+    for (n = 0; n < 8; n++) {
+        buf[n] = (unsigned char)val;
+        val >>= 8;
+    }
+}
+
+/* read len bytes at offset pos in in to buf, return true if all were read */
+local int readat(file *in, off_t pos, unsigned char *buf, unsigned len)
+{
+    int got;
+
+    if (lseek(in->fd, pos, SEEK_SET) == -1)
+        return 0;
+    while (len) {
+        got = read(in->fd, buf, len);
+        if (got <= 0)
+            return 0;
+        buf += got;
+        len -= (unsigned)got;
+    }
+    return 1;
+}
+
+/* look for an append point record at the end of in, and if there is one that
+   matches the trailer it points to, load it into pt and return true -- the
+   record is an empty gzip member with an extra field holding the subfield
+   "Ap", whose data is the bit offset of the last block bit (8 bytes), the
+   offset of the trailer (8), the unused bits in the byte before the trailer
+   (1), the CRC-32 (4), the length (4), the length of the window (2), the raw
+   deflate compressed window, and finally the length of the record (4), which
+   is where the record can be found from the end of the file */
+local int gzrecord(file *in, point *pt)
+{
+    int ret;
+    unsigned len;
+    off_t size;
+    unsigned char tail[14], *rec, *data;
+    z_stream strm;
+
+    /* get the record length from the end of the file */
+    size = lseek(in->fd, 0L, SEEK_END);
+    if (size < (off_t)RECHEAD || !readat(in, size - 14, tail, 14) ||
+        memcmp(tail + 4, "\3\0\0\0\0\0\0\0\0\0", 10) != 0)
+        return 0;
+    len = (unsigned)get4(tail);
+    if (len < RECHEAD || len > RECMAX || (off_t)len > size)
+        return 0;
+
+    /* read and check the record */
+    rec = malloc(len);
+    if (rec == NULL) bye("out of memory", "");
+    data = rec + 16;
+    ret = readat(in, size - len, rec, len) &&
+          memcmp(rec, "\37\213\10\4", 4) == 0 &&
+          rec[10] + ((unsigned)rec[11] << 8) == len - 22 &&
+          rec[12] == 'A' && rec[13] == 'p' &&
+          rec[14] + ((unsigned)rec[15] << 8) == len - 26;
+    if (ret) {
+        pt->mark = get8(data);
+        pt->end = get8(data + 8);
+        pt->left = data[16];
+        pt->crc = get4(data + 17);
+        pt->tot = get4(data + 21);
+        pt->have = data[25] + ((unsigned)data[26] << 8);
+        ret = pt->end + 8 == size - len && pt->left < 8 &&
+              pt->have <= DSIZE && pt->mark >= 0 && pt->mark < 8 * pt->end &&
+              readat(in, pt->end, tail, 8) && get4(tail) == pt->crc &&
+              get4(tail + 4) == pt->tot;
+    }
+
+    /* decompress the window */
+    if (ret) {
+        strm.zalloc = Z_NULL;
+        strm.zfree = Z_NULL;
+        strm.opaque = Z_NULL;
+        if (inflateInit2(&strm, -15) != Z_OK)
+            bye("out of memory", " or library mismatch");
+        strm.next_in = data + 27;
+        strm.avail_in = len - RECHEAD;
+        strm.next_out = pt->window;
+        strm.avail_out = DSIZE;
+        ret = inflate(&strm, Z_FINISH) == Z_STREAM_END &&
+              strm.total_out == pt->have;
+        inflateEnd(&strm);
+    }
+    free(rec);
+    return ret;
+}
+
 /* decompress gzip file "name", return strm with a deflate stream ready to
    continue compression of the data in the gzip file, and return a file
    descriptor pointing to where to write the compressed data -- the deflate
-   stream is initialized to compress using level "level" */
-local int gzscan(char *name, z_stream *strm, int level)
+   stream is initialized to compress using level "level" -- if the gzip file
+   ends with a good append point record, use that instead of decompressing,
+   and set pt->record to keep one */
+local int gzscan(char *name, z_stream *strm, int level, point *pt)
 {
     int ret, lastbit, left, full;
     unsigned have;
-    unsigned long crc, tot;
+    unsigned long crc;
     unsigned char *window;
-    off_t lastoff, end;
+    off_t lastoff;
     file gz;
 
     /* open gzip file */
@@ -274,120 +433,210 @@ local int gzscan(char *name, z_stream *strm, int level)
     gz.size = LGCHUNK;
     gz.left = 0;
 
-    /* skip gzip header */
-    gzheader(&gz);
-
-    /* prepare to decompress */
-    window = malloc(DSIZE);
-    if (window == NULL) bye("out of memory", "");
-    strm->zalloc = Z_NULL;
-    strm->zfree = Z_NULL;
-    strm->opaque = Z_NULL;
-    ret = inflateInit2(strm, -15);
-    if (ret != Z_OK) bye("out of memory", " or library mismatch");
-
-    /* decompress the deflate stream, saving append information */
-    lastbit = 0;
-    lastoff = lseek(gz.fd, 0L, SEEK_CUR) - gz.left;
-    left = 0;
-    strm->avail_in = gz.left;
-    strm->next_in = gz.next;
-    crc = crc32(0L, Z_NULL, 0);
-    have = full = 0;
-    do {
-        /* if needed, get more input */
-        if (strm->avail_in == 0) {
-            readmore(&gz);
-            strm->avail_in = gz.left;
-            strm->next_in = gz.next;
-        }
-
-        /* set up output to next available section of sliding window */
-        strm->avail_out = DSIZE - have;
-        strm->next_out = window + have;
-
-        /* inflate and check for errors */
-        ret = inflate(strm, Z_BLOCK);
-        if (ret == Z_STREAM_ERROR) bye("internal stream error!", "");
-        if (ret == Z_MEM_ERROR) bye("out of memory", "");
-        if (ret == Z_DATA_ERROR)
-            bye("invalid compressed data--format violated in", name);
-
-        /* update crc and sliding window pointer */
-        crc = crc32(crc, window + have, DSIZE - have - strm->avail_out);
-        if (strm->avail_out)
-            have = DSIZE - strm->avail_out;
-        else {
-            have = 0;
-            full = 1;
-        }
+    /* use the append point record if there is one */
+    if (gzrecord(&gz, pt))
+        pt->record = 1;
+    else {
+        /* skip gzip header */
+        lseek(gz.fd, 0L, SEEK_SET);
+        gzheader(&gz);
+
+        /* prepare to decompress */
+        window = pt->window;
+        strm->zalloc = Z_NULL;
+        strm->zfree = Z_NULL;
+        strm->opaque = Z_NULL;
+        ret = inflateInit2(strm, -15);
+        if (ret != Z_OK) bye("out of memory", " or library mismatch");
+
+        /* decompress the deflate stream, saving append information */
+        lastbit = 0;
+        lastoff = lseek(gz.fd, 0L, SEEK_CUR) - gz.left;
+        left = 0;
+        strm->avail_in = gz.left;
+        strm->next_in = gz.next;
+        crc = crc32(0L, Z_NULL, 0);
+        have = full = 0;
+        do {
+            /* if needed, get more input */
+            if (strm->avail_in == 0) {
+                readmore(&gz);
+                strm->avail_in = gz.left;
+                strm->next_in = gz.next;
+            }
 
-        /* process end of block */
-        if (strm->data_type & 128) {
-            if (strm->data_type & 64)
-                left = strm->data_type & 0x1f;
+            /* set up output to next available section of sliding window */
+            strm->avail_out = DSIZE - have;
+            strm->next_out = window + have;
+
+            /* inflate and check for errors */
+            ret = inflate(strm, Z_BLOCK);
+            if (ret == Z_STREAM_ERROR) bye("internal stream error!", "");
+            if (ret == Z_MEM_ERROR) bye("out of memory", "");
+            if (ret == Z_DATA_ERROR)
+                bye("invalid compressed data--format violated in", name);
+
+            /* update crc and sliding window pointer */
+            crc = crc32(crc, window + have, DSIZE - have - strm->avail_out);
+            if (strm->avail_out)
+                have = DSIZE - strm->avail_out;
             else {
-                lastbit = strm->data_type & 0x1f;
-                lastoff = lseek(gz.fd, 0L, SEEK_CUR) - strm->avail_in;
+                have = 0;
+                full = 1;
             }
+
+            /* process end of block */
+            if (strm->data_type & 128) {
+                if (strm->data_type & 64)
+                    left = strm->data_type & 0x1f;
+                else {
+                    lastbit = strm->data_type & 0x1f;
+                    lastoff = lseek(gz.fd, 0L, SEEK_CUR) - strm->avail_in;
+                }
+            }
+        } while (ret != Z_STREAM_END);
+        inflateEnd(strm);
+        gz.left = strm->avail_in;
+        gz.next = strm->next_in;
+
+        /* save the location of the end of the compressed data */
+        pt->end = lseek(gz.fd, 0L, SEEK_CUR) - gz.left;
+
+        /* check gzip trailer and save total for deflate */
+        if (crc != read4(&gz))
+            bye("invalid compressed data--crc mismatch in ", name);
+        pt->tot = strm->total_out;
+        if ((pt->tot & 0xffffffffUL) != read4(&gz))
+            bye("invalid compressed data--length mismatch in", name);
+
+        /* if not at end of file, warn */
+        if (gz.left || readin(&gz))
+            fprintf(stderr,
+                "gzappend warning: junk at end of gzip file overwritten\n");
+
+        /* if window wrapped, build dictionary from window by rotating */
+        if (full) {
+            rotate(window, DSIZE, have);
+            have = DSIZE;
         }
-    } while (ret != Z_STREAM_END);
-    inflateEnd(strm);
-    gz.left = strm->avail_in;
-    gz.next = strm->next_in;
-
-    /* save the location of the end of the compressed data */
-    end = lseek(gz.fd, 0L, SEEK_CUR) - gz.left;
-
-    /* check gzip trailer and save total for deflate */
-    if (crc != read4(&gz))
-        bye("invalid compressed data--crc mismatch in ", name);
-    tot = strm->total_out;
-    if ((tot & 0xffffffffUL) != read4(&gz))
-        bye("invalid compressed data--length mismatch in", name);
-
-    /* if not at end of file, warn */
-    if (gz.left || readin(&gz))
-        fprintf(stderr,
-            "gzappend warning: junk at end of gzip file overwritten\n");
+
+        /* save the append point */
+        pt->mark = 8 * lastoff - lastbit;
+        pt->left = left;
+        pt->crc = crc;
+        pt->have = have;
+    }
 
     /* clear last block bit */
-    lseek(gz.fd, lastoff - (lastbit != 0), SEEK_SET);
+    lseek(gz.fd, pt->mark >> 3, SEEK_SET);
     if (read(gz.fd, gz.buf, 1) != 1) bye("reading after seek on ", name);
-    *gz.buf = (unsigned char)(*gz.buf ^ (1 << ((8 - lastbit) & 7)));
+    *gz.buf = (unsigned char)(*gz.buf ^ (1 << (pt->mark & 7)));
     lseek(gz.fd, -1L, SEEK_CUR);
     if (write(gz.fd, gz.buf, 1) != 1) bye("writing after seek to ", name);
 
-    /* if window wrapped, build dictionary from window by rotating */
-    if (full) {
-        rotate(window, DSIZE, have);
-        have = DSIZE;
-    }
-
     /* set up deflate stream with window, crc, total_in, and leftover bits */
     ret = deflateInit2(strm, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
     if (ret != Z_OK) bye("out of memory", "");
-    deflateSetDictionary(strm, window, have);
-    strm->adler = crc;
-    strm->total_in = tot;
-    if (left) {
-        lseek(gz.fd, --end, SEEK_SET);
+    deflateSetDictionary(strm, pt->window, pt->have);
+    strm->adler = pt->crc;
+    strm->total_in = pt->tot;
+    if (pt->left) {
+        lseek(gz.fd, --pt->end, SEEK_SET);
         if (read(gz.fd, gz.buf, 1) != 1) bye("reading after seek on ", name);
-        deflatePrime(strm, 8 - left, *gz.buf);
+        deflatePrime(strm, 8 - pt->left, *gz.buf);
     }
-    lseek(gz.fd, end, SEEK_SET);
+    lseek(gz.fd, pt->end, SEEK_SET);
 
     /* clean up and return */
-    free(window);
     free(gz.buf);
     return gz.fd;
 }
 
+/* save the last DSIZE bytes of the uncompressed data in pt->window -- len
+   must be no more than DSIZE */
+local void keep(point *pt, unsigned char *buf, unsigned len)
+{
+    if (pt->have + len > DSIZE) {
+        memmove(pt->window, pt->window + pt->have + len - DSIZE, DSIZE - len);
+        pt->have = DSIZE - len;
+    }
+    memcpy(pt->window + pt->have, buf, len);
+    pt->have += len;
+}
+
+/* write len bytes from buf to gzip file gd */
+local void writeall(int gd, unsigned char *buf, unsigned len)
+{
+    int ret;
+
+    while (len) {
+        ret = write(gd, buf, len);
+        if (ret == -1) bye("writing gzip file", "");
+        buf += ret;
+        len -= (unsigned)ret;
+    }
+}
+
+/* write an append point record for pt to gzip file gd, the format of which is
+   described at gzrecord() */
+local void gzpoint(int gd, point *pt)
+{
+    int ret;
+    unsigned len;
+    unsigned char *rec, *data;
+    z_stream strm;
+
+    /* compress the window */
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    ret = deflateInit2(&strm, 9, Z_DEFLATED, -15, 9, Z_DEFAULT_STRATEGY);
+    if (ret != Z_OK) bye("out of memory", "");
+    len = RECHEAD + (unsigned)deflateBound(&strm, pt->have);
+    rec = malloc(len);
+    if (rec == NULL) bye("out of memory", "");
+    data = rec + 16;
+    strm.next_in = pt->window;
+    strm.avail_in = pt->have;
+    strm.next_out = data + 27;
+    strm.avail_out = len - RECHEAD;
+    ret = deflate(&strm, Z_FINISH);
+    if (ret != Z_STREAM_END) bye("internal stream error!", "");
+    len = RECHEAD + (unsigned)strm.total_out;
+    deflateEnd(&strm);
+
+    /* gzip header with an extra field */
+    memcpy(rec, "\37\213\10\4\0\0\0\0\0\377", 10);
+    rec[10] = (unsigned char)(len - 22);
+    rec[11] = (unsigned char)((len - 22) >> 8);
+    rec[12] = 'A';
+    rec[13] = 'p';
+    rec[14] = (unsigned char)(len - 26);
+    rec[15] = (unsigned char)((len - 26) >> 8);
+
+    /* append point, window length, and record length */
+    put8(data, pt->mark);
+    put8(data + 8, pt->end);
+    data[16] = (unsigned char)pt->left;
+    put4(data + 17, pt->crc);
+    put4(data + 21, pt->tot);
+    data[25] = (unsigned char)pt->have;
+    data[26] = (unsigned char)(pt->have >> 8);
+    put4(rec + len - 14, len);
+
+    /* empty deflate data and gzip trailer */
+    memcpy(rec + len - 10, "\3\0\0\0\0\0\0\0\0\0", 10);
+    writeall(gd, rec, len);
+    free(rec);
+}
+
 /* append file "name" to gzip file gd using deflate stream strm -- if last
-   is true, then finish off the deflate stream at the end */
-local void gztack(char *name, int gd, z_stream *strm, int last)
+   is true, then finish off the deflate stream at the end, and if pt->record
+   is true, then follow it with an append point record */
+local void gztack(char *name, int gd, z_stream *strm, int last, point *pt)
 {
-    int fd, len, ret;
+    int fd, len, ret, flush;
+    off_t end;
     unsigned left;
     unsigned char *in, *out;
 
@@ -417,13 +666,21 @@ local void gztack(char *name, int gd, z_stream *strm, int last)
         }
         strm->avail_in = (unsigned)len;
         strm->next_in = in;
-        if (len) strm->adler = crc32(strm->adler, in, (unsigned)len);
+        if (len) {
+            strm->adler = crc32(strm->adler, in, (unsigned)len);
+            if (pt->record)
+                keep(pt, in, (unsigned)len);
+        }
 
-        /* compress and write all available output */
+        /* compress and write all available output -- with a record, end on
+           a byte boundary so that an empty last stored block can follow */
+        flush = Z_NO_FLUSH;
+        if (last && len == 0)
+            flush = pt->record ? Z_SYNC_FLUSH : Z_FINISH;
         do {
             strm->avail_out = CHUNK;
             strm->next_out = out;
-            ret = deflate(strm, last && len == 0 ? Z_FINISH : Z_NO_FLUSH);
+            ret = deflate(strm, flush);
             left = CHUNK - strm->avail_out;
             while (left) {
                 len = write(gd, out + CHUNK - strm->avail_out - left, left);
@@ -436,6 +693,15 @@ local void gztack(char *name, int gd, z_stream *strm, int last)
     /* write trailer after last entry */
     if (last) {
         deflateEnd(strm);
+        if (pt->record) {
+            end = lseek(gd, 0L, SEEK_CUR);
+            writeall(gd, (unsigned char *)"\1\0\0\377\377", 5);
+            pt->mark = 8 * end;
+            pt->end = end + 5;
+            pt->left = 0;
+            pt->crc = strm->adler;
+            pt->tot = strm->total_in & 0xffffffffUL;
+        }
         out[0] = (unsigned char)(strm->adler);
         out[1] = (unsigned char)(strm->adler >> 8);
         out[2] = (unsigned char)(strm->adler >> 16);
@@ -450,6 +716,10 @@ local void gztack(char *name, int gd, z_stream *strm, int last)
             if (ret == -1) bye("writing gzip file", "");
             len -= ret;
         } while (len);
+        if (pt->record)
+            gzpoint(gd, pt);
+        if (ftruncate(gd, lseek(gd, 0L, SEEK_CUR)) == -1)
+            bye("truncating gzip file", "");
         close(gd);
     }
 
@@ -467,6 +737,7 @@ int main(int argc, char **argv)
 {
     int gd, level;
     z_stream strm;
+    point pt;
 
     /* ignore command name */
     argc--; argv++;
@@ -474,31 +745,41 @@ int main(int argc, char **argv)
     /* provide usage if no arguments */
     if (*argv == NULL) {
         printf(
-            "gzappend 1.2 (11 Oct 2012) Copyright (C) 2003, 2012 Mark Adler\n"
+            "gzappend 1.3 (15 Oct 2026) Copyright (C) 2003, 2012 Mark Adler\n"
                );
         printf(
-            "usage: gzappend [-level] file.gz [ addthis [ andthis ... ]]\n");
+            "usage: gzappend [-level] [-r] file.gz [ addthis [ andthis ... ]]\n"
+              );
+        printf(
+            "  -r  keep an append point record to make later appends fast\n");
         return 0;
     }
 
-    /* set compression level */
+    /* set compression level and whether to write an append point record */
     level = Z_DEFAULT_COMPRESSION;
-    if (argv[0][0] == '-') {
-        if (argv[0][1] < '0' || argv[0][1] > '9' || argv[0][2] != 0)
+    pt.record = 0;
+    while (argv[0][0] == '-') {
+        if (argv[0][1] == 'r' && argv[0][2] == 0)
+            pt.record = 1;
+        else if (argv[0][1] < '0' || argv[0][1] > '9' || argv[0][2] != 0)
             bye("invalid compression level", "");
-        level = argv[0][1] - '0';
+        else
+            level = argv[0][1] - '0';
         if (*++argv == NULL) bye("no gzip file name after options", "");
     }
 
     /* prepare to append to gzip file */
-    gd = gzscan(*argv++, &strm, level);
+    pt.window = malloc(DSIZE);
+    if (pt.window == NULL) bye("out of memory", "");
+    gd = gzscan(*argv++, &strm, level, &pt);
 
     /* append files on command line, or from stdin if none */
     if (*argv == NULL)
-        gztack(NULL, gd, &strm, 1);
+        gztack(NULL, gd, &strm, 1, &pt);
     else
         do {
-            gztack(*argv, gd, &strm, argv[1] == NULL);
+            gztack(*argv, gd, &strm, argv[1] == NULL, &pt);
         } while (*++argv != NULL);
+    free(pt.window);
     return 0;
 }
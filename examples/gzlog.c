@@ -2,7 +2,7 @@
  * gzlog.c
  * Copyright (C) 2004, 2008, 2012, 2016, 2019 Mark Adler, all rights reserved
  * For conditions of distribution and use, see copyright notice in gzlog.h
- * version 2.3, 25 May 2019
+ * version 2.4, 14 Oct 2026
  */
 
 /*
@@ -22,6 +22,13 @@
    gzlog maintains another auxiliary file with the last 32K of data from the
    compressed portion, which is preloaded for the compression of the subsequent
    data.  This minimizes the impact to the compression ratio of appending.
+
+   gzlog_write() may be called from several threads at once on the same gzlog
+   object.  The data from calls that arrive while another append is being
+   written out are gathered into a batch, and the whole batch is then appended
+   by one of those calls as a single append operation, with a single update of
+   the extra field and the one set of fsync() calls.  Each call returns once
+   the batch holding its data is in the log.
  */
 
 /*
@@ -207,6 +214,17 @@
    - Replace foo.dict with foo.temp.
    - Write over the extra field, marking foo.gz as complete.
 
+   Group commit procedure (within one process):
+   - Under a mutex, copy the data to write to the end of the staging batch and
+     add the caller to the list of callers waiting on that batch.
+   - Wait while another thread is committing.  If, once woken, our batch has
+     not yet been committed, then become the committer: take the staging batch,
+     start a new empty one for later callers, and release the mutex.
+   - Apply the main procedure above to the whole batch.  Reacquire the mutex,
+     give every caller on the batch's list the result, and wake them all.
+   - gzlog_compress() waits in the same way for any commit to complete, and
+     holds off commits while it compresses.
+
    Recovery procedure:
    - If not a replace recovery, read in the foo.add file, and provide that data
      to the appropriate recovery below.  If there is no foo.add file, provide
@@ -235,6 +253,9 @@
 #include <sys/stat.h>   /* stat */
 #include <sys/time.h>   /* utimes */
 #include "zlib.h"       /* crc32 */
+#ifndef GZLOG_NO_THREADS
+#  include <pthread.h>  /* pthread_mutex_*, pthread_cond_* */
+#endif
 
 #include "gzlog.h"      /* header for external access */
 
@@ -254,6 +275,20 @@ typedef unsigned long ulong;
 #   define BAIL(n)
 #endif
 
+/* serialize the gzlog_write() calls of threads on the same gzlog object, or
+   not at all if compiled with GZLOG_NO_THREADS */
+#ifdef GZLOG_NO_THREADS
+#   define LOCK(log)
+#   define UNLOCK(log)
+#   define WAIT(log)
+#   define WAKE(log)
+#else
+#   define LOCK(log) pthread_mutex_lock(&(log)->mutex)
+#   define UNLOCK(log) pthread_mutex_unlock(&(log)->mutex)
+#   define WAIT(log) pthread_cond_wait(&(log)->done, &(log)->mutex)
+#   define WAKE(log) pthread_cond_broadcast(&(log)->done)
+#endif
+
 /* how old the lock file can be in seconds before considering it stale */
 #define PATIENCE 300
 
@@ -284,6 +319,21 @@ typedef unsigned long ulong;
 #define PUT4(p,a) do {PUT2(p,a);PUT2(p+2,a>>16);} while(0)
 #define PUT8(p,a) do {PUT4(p,a);PUT4(p+4,a>>32);} while(0)
 
+/* a gzlog_write() call waiting for its data to be committed */
+struct log_wait {
+    int ret;                /* result of the commit, set when done */
+    int done;               /* true once the batch has been committed */
+    struct log_wait *next;  /* next caller waiting on the same batch */
+};
+
+/* data from gzlog_write() calls to be appended as one operation */
+struct log_batch {
+    unsigned char *data;    /* allocated staging buffer */
+    size_t len;             /* bytes of data staged */
+    size_t size;            /* allocated size of data */
+    struct log_wait *wait;  /* callers whose data is in this batch */
+};
+
 /* internal structure for log information */
 #define LOGID "\106\035\172"    /* should be three non-zero characters */
 struct log {
@@ -300,6 +350,13 @@ struct log {
     ulong tcrc;     /* crc of total data */
     ulong tlen;     /* length (modulo 2^32) of total data */
     time_t lock;    /* last modify time of our lock file */
+    struct log_batch batch[2];  /* staging batch and batch being committed */
+    int stage;      /* index in batch[] of the staging batch */
+    int busy;       /* true while a thread is committing or compressing */
+#ifndef GZLOG_NO_THREADS
+    pthread_mutex_t mutex;      /* protects batch[], stage, and busy */
+    pthread_cond_t done;        /* signaled when busy is cleared */
+#endif
 };
 
 /* gzip header for gzlog */
@@ -889,6 +946,9 @@ gzlog *gzlog_open(char *path)
     }
     strcpy(log->path, path);
     log->end = log->path + n;
+    memset(log->batch, 0, sizeof(log->batch));
+    log->stage = 0;
+    log->busy = 0;
 
     /* gain exclusive access and verify log file -- may perform a
        recovery operation if needed */
@@ -897,27 +957,25 @@ gzlog *gzlog_open(char *path)
         free(log);
         return NULL;
     }
+#ifndef GZLOG_NO_THREADS
+    pthread_mutex_init(&log->mutex, NULL);
+    pthread_cond_init(&log->done, NULL);
+#endif
 
     /* return pointer to log structure */
     return log;
 }
 
-/* gzlog_compress() return values:
-    0: all good
-   -1: file i/o error (usually access issue)
-   -2: memory allocation failure
-   -3: invalid log pointer argument */
-int gzlog_compress(gzlog *logd)
+/* Compress the uncompressed data in the log.  This is gzlog_compress() for
+   an object that is not busy, and so has exclusive use of the foo.* files
+   among the threads of this process.  Return 0 on success, -1 on a file i/o
+   error, or -2 on a memory allocation failure. */
+local int log_compact(struct log *log)
 {
     int fd, ret;
     uint block;
     size_t len, next;
     unsigned char *data, buf[5];
-    struct log *log = logd;
-
-    /* check arguments */
-    if (log == NULL || strcmp(log->id, LOGID))
-        return -3;
 
     /* see if we lost the lock -- if so get it again and reload the extra
        field information (it probably changed), recover last operation if
@@ -989,21 +1047,12 @@ int gzlog_compress(gzlog *logd)
     return -1;
 }
 
-/* gzlog_write() return values:
-    0: all good
-   -1: file i/o error (usually access issue)
-   -2: memory allocation failure
-   -3: invalid log pointer argument */
-int gzlog_write(gzlog *logd, void *data, size_t len)
+/* Append len bytes from data to the log, which is not busy, and compress the
+   log if the uncompressed data has reached TRIGGER.  This is the main
+   procedure, with the same return values as gzlog_write(). */
+local int log_add(struct log *log, unsigned char *data, size_t len)
 {
     int fd, ret;
-    struct log *log = logd;
-
-    /* check arguments */
-    if (log == NULL || strcmp(log->id, LOGID))
-        return -3;
-    if (data == NULL || len <= 0)
-        return 0;
 
     /* see if we lost the lock -- if so get it again and reload the extra
        field information (it probably changed), recover last operation if
@@ -1035,7 +1084,130 @@ int gzlog_write(gzlog *logd, void *data, size_t len)
         return 0;
 
     /* time to compress */
-    return gzlog_compress(log);
+    return log_compact(log);
+}
+
+/* Copy len bytes from data to the end of the staging batch, growing it as
+   needed.  Return 0 on success, or -2 if memory could not be allocated.  This
+   is called with the mutex held. */
+local int log_stage(struct log *log, void *data, size_t len)
+{
+    size_t size;
+    unsigned char *grow;
+    struct log_batch *batch = log->batch + log->stage;
+
+    if (batch->size - batch->len < len) {
+        size = batch->size ? batch->size : 4096;
+        while (size - batch->len < len) {
+            if (size << 1 < size)
+                return -2;
+            size <<= 1;
+        }
+        grow = realloc(batch->data, size);
+        if (grow == NULL)
+            return -2;
+        batch->data = grow;
+        batch->size = size;
+    }
+    memcpy(batch->data + batch->len, data, len);
+    batch->len += len;
+    return 0;
+}
+
+/* Commit the staging batch to the log while callers can stage the next batch,
+   and then give all of the callers waiting on the batch the result.  This is
+   called with the mutex held and the log not busy. */
+local void log_commit(struct log *log)
+{
+    int ret;
+    struct log_batch *batch;
+    struct log_wait *wait;
+
+    /* take the staging batch, let others start the next one */
+    batch = log->batch + log->stage;
+    log->stage ^= 1;
+    log->busy = 1;
+    UNLOCK(log);
+
+    /* append the whole batch as one operation */
+    ret = log_add(log, batch->data, batch->len);
+
+    /* report to everyone in the batch, and let the next committer go */
+    LOCK(log);
+    for (wait = batch->wait; wait != NULL; wait = wait->next) {
+        wait->ret = ret;
+        wait->done = 1;
+    }
+    batch->wait = NULL;
+    batch->len = 0;
+    log->busy = 0;
+    WAKE(log);
+}
+
+/* gzlog_compress() return values:
+    0: all good
+   -1: file i/o error (usually access issue)
+   -2: memory allocation failure
+   -3: invalid log pointer argument */
+int gzlog_compress(gzlog *logd)
+{
+    int ret;
+    struct log *log = logd;
+
+    /* check arguments */
+    if (log == NULL || strcmp(log->id, LOGID))
+        return -3;
+
+    /* wait for any commit in progress, and hold off others while compressing
+       -- staged data will be committed afterwards by its callers */
+    LOCK(log);
+    while (log->busy)
+        WAIT(log);
+    log->busy = 1;
+    UNLOCK(log);
+    ret = log_compact(log);
+    LOCK(log);
+    log->busy = 0;
+    WAKE(log);
+    UNLOCK(log);
+    return ret;
+}
+
+/* gzlog_write() return values:
+    0: all good
+   -1: file i/o error (usually access issue)
+   -2: memory allocation failure
+   -3: invalid log pointer argument */
+int gzlog_write(gzlog *logd, void *data, size_t len)
+{
+    struct log_wait self;
+    struct log *log = logd;
+
+    /* check arguments */
+    if (log == NULL || strcmp(log->id, LOGID))
+        return -3;
+    if (data == NULL || len <= 0)
+        return 0;
+
+    /* stage the data in the next batch to commit */
+    LOCK(log);
+    if (log_stage(log, data, len)) {
+        UNLOCK(log);
+        return -2;
+    }
+    self.ret = 0;
+    self.done = 0;
+    self.next = log->batch[log->stage].wait;
+    log->batch[log->stage].wait = &self;
+
+    /* wait for the commit in progress, if any, after which either our batch
+       has been committed by another caller, or it's up to us to do it */
+    while (log->busy && !self.done)
+        WAIT(log);
+    if (!self.done)
+        log_commit(log);
+    UNLOCK(log);
+    return self.ret;
 }
 
 /* gzlog_close() return values:
@@ -1049,10 +1221,21 @@ int gzlog_close(gzlog *logd)
     if (log == NULL || strcmp(log->id, LOGID))
         return -3;
 
-    /* close the log file and release the lock */
+    /* wait for a compress in progress, if any, then close the log file and
+       release the lock */
+    LOCK(log);
+    while (log->busy)
+        WAIT(log);
+    UNLOCK(log);
     log_close(log);
 
     /* free structure and return */
+    free(log->batch[0].data);
+    free(log->batch[1].data);
+#ifndef GZLOG_NO_THREADS
+    pthread_mutex_destroy(&log->mutex);
+    pthread_cond_destroy(&log->done);
+#endif
     if (log->path != NULL)
         free(log->path);
     strcpy(log->id, "bad");
@@ -1,6 +1,6 @@
 /* gzlog.h
   Copyright (C) 2004, 2008, 2012 Mark Adler, all rights reserved
-  version 2.2, 14 Aug 2012
+  version 2.4, 14 Oct 2026
 
   This software is provided 'as-is', without any express or implied
   warranty.  In no event will the author be held liable for any damages
@@ -29,6 +29,8 @@
                      gzlog_write() now always leaves the log file as valid gzip
    2.1   8 Jul 2012  Fix argument checks in gzlog_compress() and gzlog_write()
    2.2  14 Aug 2012  Clean up signed comparisons
+   2.4  14 Oct 2026  Allow gzlog_write() from several threads, with the data
+                     from concurrent calls appended together as one operation
  */
 
 /*
@@ -73,19 +75,24 @@ gzlog *gzlog_open(char *path);
    it was not created by gzlog_open()).  This function will write data to the
    file uncompressed, until 1 MB has been accumulated, at which time that data
    will be compressed.  The log file will be a valid gzip file upon successful
-   return. */
+   return.  gzlog_write() may be called from several threads at once with the
+   same log, in which case the data from calls made while another append is in
+   progress are appended together by one of those calls, and each call returns
+   with the result of that append.  Compile with -DGZLOG_NO_THREADS to leave
+   out the pthread locking. */
 int gzlog_write(gzlog *log, void *data, size_t len);
 
 /* Force compression of any uncompressed data in the log.  This should be used
    sparingly, if at all.  The main application would be when a log file will
    not be appended to again.  If this is used to compress frequently while
    appending, it will both significantly increase the execution time and
-   reduce the compression ratio.  The return codes are the same as for
-   gzlog_write(). */
+   reduce the compression ratio.  It may be called while other threads are in
+   gzlog_write().  The return codes are the same as for gzlog_write(). */
 int gzlog_compress(gzlog *log);
 
 /* Close a gzlog object.  Return zero on success, -3 if the log argument is
-   invalid.  The log object is freed, and so cannot be referenced again. */
+   invalid.  The log object is freed, and so cannot be referenced again.  No
+   other thread may be using the log when it is closed. */
 int gzlog_close(gzlog *log);
 
 #endif
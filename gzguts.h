@@ -31,6 +31,7 @@
 
 #include <stdio.h>
 #include "zlib.h"
+#include "zprobe.h"
 #ifdef STDC
 #  include <string.h>
 #  include <stdlib.h>
@@ -136,6 +137,33 @@
 #  endif
 #endif
 
+/* asynchronous i/o uses a helper thread, which needs pthreads -- define
+   NO_THREADS to always do the i/o on the calling thread */
+#if !defined(NO_THREADS) && defined(HAVE_PTHREAD) && !defined(_WIN32)
+#  define GZ_ASYNC
+#  include <errno.h>
+#  include <pthread.h>
+#endif
+
+/* the preferred i/o size of a file is used to choose a default buffer size */
+#if defined(Z_HAVE_UNISTD_H) && !defined(_WIN32)
+#  define GZ_BLKSIZE
+#  include <sys/stat.h>
+#endif
+
+/* memory-mapped input for reading regular files, if mmap() is available --
+   define NO_MMAP to always read() the input */
+#if !defined(NO_MMAP) && defined(Z_HAVE_UNISTD_H) && !defined(_WIN32)
+#  define GZ_MMAP
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#endif
+
+/* positioned reads, so that several threads can read the input at once */
+#if defined(Z_HAVE_UNISTD_H) && !defined(_WIN32)
+#  define GZ_PREAD
+#endif
+
 /* provide prototypes for these when building zlib without LFS */
 #if !defined(_LARGEFILE64_SOURCE) || _LFS64_LARGEFILE-0 == 0
     ZEXTERN gzFile ZEXPORT gzopen64(const char *, const char *);
@@ -155,6 +183,32 @@
    twice this must be able to fit in an unsigned type) */
 #define GZBUFSIZE 8192
 
+/* largest default i/o buffer size, when chosen from the preferred i/o size of
+   the file or when grown while reading */
+#define GZBUFMAX 131072
+
+/* default distance between random access points in uncompressed data, and
+   the window size that is saved for each point */
+#define GZSPAN 1048576
+#define GZWINSIZE 32768U
+
+/* smallest gzwritev() fragment handed to deflate() in place instead of being
+   copied to the input buffer */
+#ifndef GZIOVMIN
+#  define GZIOVMIN 4096
+#endif
+
+/* when decompressing in parallel, compressed bytes to look through for gzip
+   headers per thread, and the most uncompressed data per thread held in
+   memory before writing it out */
+#define GZPSCAN 1048576
+#define GZPHOLD 16777216
+
+/* most blocks listed in each empty gzip member that gzwrite() appends to a
+   member written in block mode (see gzsetblock()), so that the list fits in
+   the 64K extra field */
+#define GZBLOCKS 8187
+
 /* gzip modes, also provide a little integrity check on the passed structure */
 #define GZ_NONE 0
 #define GZ_READ 7247
@@ -178,19 +232,39 @@ typedef struct {
     int fd;                 /* file descriptor */
     char *path;             /* path or fd for error messages */
     unsigned size;          /* buffer size, zero if not allocated yet */
-    unsigned want;          /* requested buffer size, default is GZBUFSIZE */
+    unsigned want;          /* requested buffer size, 0 to choose one */
     unsigned char *in;      /* input buffer (double-sized when writing) */
     unsigned char *out;     /* output buffer (double-sized when reading) */
     int direct;             /* 0 if processing gzip, 1 if transparent */
+    int async;              /* true if a helper thread does the file i/o */
+    struct gz_async_s *job; /* helper thread and its buffers, if started */
         /* just for reading */
     int how;                /* 0: get header, 1: copy, 2: decompress */
     z_off64_t start;        /* where the gzip data started, for rewinding */
     int eof;                /* true if end of input file reached */
     int past;               /* true if read requested past end */
+    int grow;               /* true if the buffers may grow while reading */
+    int full;               /* true if the last load filled the input buffer */
+    int want_map;           /* true if memory-mapped input was requested */
+    unsigned char *map;     /* mapping of the whole input file, or NULL */
+    z_off64_t map_size;     /* length of the mapping */
+    z_off64_t map_next;     /* offset of the next byte to load from it */
+    struct gz_index_s *index;   /* random access points, or NULL */
+    int raw;                /* true if inflating raw from an access point */
+    unsigned trailer;       /* gzip trailer bytes left to skip after that */
+    unsigned char *line;    /* gzgetline() buffer for lines across refills */
+    z_size_t linesize;      /* allocated size of line */
         /* just for writing */
     int level;              /* compression level */
     int strategy;           /* compression strategy */
     int reset;              /* true if a reset is pending after a Z_FINISH */
+    unsigned block;         /* uncompressed bytes per block, or 0 */
+    unsigned left;          /* bytes left to compress in the current block */
+    z_off64_t clen;         /* compressed length of this member so far */
+    z_off64_t ulen;         /* uncompressed length of this member so far */
+    z_off64_t *blocks;      /* offsets of the blocks after the first */
+    unsigned nblocks;       /* number of offsets at blocks */
+    unsigned maxblocks;     /* number of offsets allocated */
         /* seek request */
     z_off64_t skip;         /* amount to skip (already rewound if backwards) */
     int seek;               /* true if seek request pending */
@@ -208,6 +282,36 @@ void ZLIB_INTERNAL gz_error(gz_statep, int, const char *);
 char ZLIB_INTERNAL *gz_strwinerror(DWORD error);
 #endif
 
+/* move the file offset, see gzlib.c */
+z_off64_t ZLIB_INTERNAL gz_seekfd(gz_statep, z_off64_t, int);
+
+/* seek using the random access index, see gzread.c */
+int ZLIB_INTERNAL gz_index_seek(gz_statep, z_off64_t);
+
+/* default buffer size for the file, see gzlib.c */
+unsigned ZLIB_INTERNAL gz_autosize(gz_statep);
+
+/* run jobs on a pool of threads, and count the processors, see parallel.c */
+typedef void (*par_func)(voidpf, unsigned);
+void ZLIB_INTERNAL par_run(unsigned, unsigned, par_func, voidpf);
+unsigned ZLIB_INTERNAL par_cpus(void);
+
+/* the stream cache of the calling thread, or Z_NULL, see zutil.c */
+z_poolp ZLIB_INTERNAL z_stream_cache(void);
+
+/* inflate a single deflate stream using several threads, see infpar.c */
+int ZLIB_INTERNAL par_inflate(const unsigned char *, z_size_t, unsigned,
+                              int (*)(voidpf, const unsigned char *, z_size_t),
+                              voidpf, z_size_t *, uLong *, z_size_t *);
+
+/* asynchronous i/o, see gzlib.c */
+void ZLIB_INTERNAL gz_async_start(gz_statep);
+int ZLIB_INTERNAL gz_async_read(gz_statep, unsigned char *, unsigned,
+                                unsigned *);
+int ZLIB_INTERNAL gz_async_write(gz_statep);
+int ZLIB_INTERNAL gz_async_wait(gz_statep);
+void ZLIB_INTERNAL gz_async_end(gz_statep);
+
 /* GT_OFF(x), where x is an unsigned value, is true if x > maximum z_off64_t
    value -- needed when comparing unsigned to z_off64_t, which is signed
    (possible z_off64_t types off_t, off64_t, and long are all signed) */
@@ -72,15 +72,36 @@ local void gz_reset(gz_statep state) {
         state->eof = 0;             /* not at end of file */
         state->past = 0;            /* have not read past end yet */
         state->how = LOOK;          /* look for gzip header */
+        state->raw = 0;             /* not inflating from an access point */
+        state->trailer = 0;         /* no gzip trailer to skip */
     }
     else                            /* for writing ... */
         state->reset = 0;           /* no deflateReset pending */
     state->seek = 0;                /* no seek request pending */
+    state->skip = 0;                /* checked by gzflush() even if no seek */
     gz_error(state, Z_OK, NULL);    /* clear error */
     state->x.pos = 0;               /* no uncompressed data yet */
     state->strm.avail_in = 0;       /* no input data yet */
 }
 
+/* Move the file offset as lseek() would, or the offset in the mapping if the
+   input is memory mapped.  Wait for the helper thread first if there is one.
+   Return the resulting offset, or -1 on failure. */
+z_off64_t ZLIB_INTERNAL gz_seekfd(gz_statep state, z_off64_t offset,
+                                  int whence) {
+    if (state->map != NULL) {
+        if (whence == SEEK_CUR)
+            offset += state->map_next;
+        if (offset < 0)
+            return -1;
+        state->map_next = offset < state->map_size ? offset : state->map_size;
+        return offset;
+    }
+    if (gz_async_wait(state) == -1)
+        return -1;
+    return LSEEK(state->fd, offset, whence);
+}
+
 /* Open a gzip file either by name or file descriptor. */
 local gzFile gz_open(const void *path, int fd, const char *mode) {
     gz_statep state;
@@ -102,7 +123,7 @@ local gzFile gz_open(const void *path, int fd, const char *mode) {
     if (state == NULL)
         return NULL;
     state->size = 0;            /* no buffers allocated yet */
-    state->want = GZBUFSIZE;    /* requested buffer size */
+    state->want = 0;            /* buffer size to be chosen */
     state->msg = NULL;          /* no error message yet */
 
     /* interpret mode */
@@ -110,6 +131,19 @@ local gzFile gz_open(const void *path, int fd, const char *mode) {
     state->level = Z_DEFAULT_COMPRESSION;
     state->strategy = Z_DEFAULT_STRATEGY;
     state->direct = 0;
+    state->async = 0;
+    state->job = NULL;
+    state->want_map = 0;
+    state->map = NULL;
+    state->grow = 0;
+    state->full = 0;
+    state->index = NULL;
+    state->line = NULL;
+    state->linesize = 0;
+    state->block = 0;
+    state->blocks = NULL;
+    state->nblocks = 0;
+    state->maxblocks = 0;
     while (*mode) {
         if (*mode >= '0' && *mode <= '9')
             state->level = *mode - '0';
@@ -156,6 +190,12 @@ local gzFile gz_open(const void *path, int fd, const char *mode) {
             case 'T':
                 state->direct = 1;
                 break;
+            case 'A':
+                state->async = 1;
+                break;
+            case 'm':
+                state->want_map = 1;
+                break;
             default:        /* could consider as an error, but just ignore */
                 ;
             }
@@ -345,6 +385,46 @@ int ZEXPORT gzbuffer(gzFile file, unsigned size) {
     return 0;
 }
 
+/* -- see zlib.h -- */
+int ZEXPORT gzsetasync(gzFile file, int async) {
+    gz_statep state;
+
+    /* get internal structure and check integrity */
+    if (file == NULL)
+        return -1;
+    state = (gz_statep)file;
+    if (state->mode != GZ_READ && state->mode != GZ_WRITE)
+        return -1;
+
+    /* make sure we haven't already allocated memory */
+    if (state->size != 0)
+        return -1;
+
+    /* set the mode -- the helper thread is started when the buffers are */
+    state->async = async != 0;
+    return 0;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT gzsetblock(gzFile file, unsigned size) {
+    gz_statep state;
+
+    /* get internal structure and check integrity */
+    if (file == NULL)
+        return -1;
+    state = (gz_statep)file;
+    if (state->mode != GZ_WRITE)
+        return -1;
+
+    /* make sure we haven't already allocated memory */
+    if (state->size != 0)
+        return -1;
+
+    /* set the block size, used when compression starts */
+    state->block = size;
+    return 0;
+}
+
 /* -- see zlib.h -- */
 int ZEXPORT gzrewind(gzFile file) {
     gz_statep state;
@@ -364,7 +444,7 @@ int ZEXPORT gzrewind(gzFile file) {
         return -1;
 
     /* back up and start over */
-    if (LSEEK(state->fd, state->start, SEEK_SET) == -1)
+    if (gz_seekfd(state, state->start, SEEK_SET) == -1)
         return -1;
     gz_reset(state);
     return 0;
@@ -401,7 +481,7 @@ z_off64_t ZEXPORT gzseek64(gzFile file, z_off64_t offset, int whence) {
     /* if within raw area while reading, just go there */
     if (state->mode == GZ_READ && state->how == COPY &&
             state->x.pos + offset >= 0) {
-        ret = LSEEK(state->fd, offset - (z_off64_t)state->x.have, SEEK_CUR);
+        ret = gz_seekfd(state, offset - (z_off64_t)state->x.have, SEEK_CUR);
         if (ret == -1)
             return -1;
         state->x.have = 0;
@@ -414,6 +494,17 @@ z_off64_t ZEXPORT gzseek64(gzFile file, z_off64_t offset, int whence) {
         return state->x.pos;
     }
 
+    /* if reading with an index, start from the access point at or before the
+       target, if that is better than rewinding or skipping from here */
+    if (state->mode == GZ_READ && state->index != NULL &&
+            state->x.pos + offset >= 0) {
+        int used = gz_index_seek(state, state->x.pos + offset);
+        if (used == -1)
+            return -1;
+        if (used)
+            return state->x.pos + state->skip;
+    }
+
     /* calculate skip amount, rewinding if needed for back seek when reading */
     if (offset < 0) {
         if (state->mode != GZ_READ)         /* writing -- can't go backwards */
@@ -487,7 +578,7 @@ z_off64_t ZEXPORT gzoffset64(gzFile file) {
         return -1;
 
     /* compute and return effective offset in file */
-    offset = LSEEK(state->fd, 0, SEEK_CUR);
+    offset = gz_seekfd(state, 0, SEEK_CUR);
     if (offset == -1)
         return -1;
     if (state->mode == GZ_READ) {           /* reading */
@@ -601,6 +692,22 @@ void ZLIB_INTERNAL gz_error(gz_statep state, int err, const char *msg) {
 #endif
 }
 
+/* Return the buffer size to use for the file when gzbuffer() was not called:
+   GZBUFSIZE, or the preferred i/o size of the file if that is larger, up to
+   GZBUFMAX. */
+unsigned ZLIB_INTERNAL gz_autosize(gz_statep state) {
+    unsigned size = GZBUFSIZE;
+#ifdef GZ_BLKSIZE
+    struct stat st;
+
+    if (fstat(state->fd, &st) == 0 && st.st_blksize > GZBUFSIZE)
+        size = st.st_blksize < GZBUFMAX ? (unsigned)st.st_blksize : GZBUFMAX;
+#else
+    (void)state;
+#endif
+    return size;
+}
+
 /* portably return maximum value for an int (when limits.h presumed not
    available) -- we need to do this to cover cases where 2's complement not
    used, since C standard permits 1's complement and sign-bit representations,
@@ -621,3 +728,306 @@ unsigned ZLIB_INTERNAL gz_intmax(void) {
     return q >> 1;
 #endif
 }
+
+#ifdef GZ_ASYNC
+
+/* Helper thread for asynchronous i/o.  The calling thread posts one job at a
+   time, either a read of up to len bytes into buf, or a write of len bytes
+   from buf, and collects its result before posting the next.  When reading,
+   the helper fills one buffer while the caller consumes the other.  When
+   writing, the output buffer is handed to the helper and replaced by the
+   spare buffer, so that compression continues while the data is written. */
+struct gz_async_s {
+    pthread_t tid;          /* helper thread */
+    pthread_mutex_t lock;   /* protects busy and quit */
+    pthread_cond_t cond;    /* signaled when busy or quit changes */
+    int busy;               /* true while the helper owns the job */
+    int quit;               /* true to make the helper return */
+    int posted;             /* true if a job has not been collected */
+        /* the job */
+    int fd;                 /* file descriptor */
+    int write;              /* true to write, false to read */
+    unsigned char *buf;     /* data to write or where to read it */
+    unsigned len;           /* number of bytes to write or to read */
+    unsigned got;           /* number of bytes read */
+    int eof;                /* true if the read reached end of file */
+    int err;                /* errno of a failed read() or write(), or 0 */
+        /* the buffers */
+    unsigned char *spare;   /* buffer not in use by the calling thread */
+    unsigned char *data;    /* reading: buffer of prefetched data */
+    unsigned char *next;    /* reading: next prefetched byte to deliver */
+    unsigned have;          /* reading: number of bytes at next */
+    int done;               /* reading: end of file reached by the helper */
+};
+typedef struct gz_async_s gz_async;
+
+/* Do the read() or write() for the current job -- loop since neither is
+   guaranteed to transfer the number of bytes requested. */
+local void gz_async_io(gz_async *job) {
+    int ret;
+    unsigned put, max = ((unsigned)-1 >> 2) + 1;
+
+    job->got = 0;
+    while (job->got < job->len) {
+        put = job->len - job->got;
+        if (put > max)
+            put = max;
+        ret = job->write ? write(job->fd, job->buf + job->got, put) :
+                           read(job->fd, job->buf + job->got, put);
+        if (ret < 0) {
+            job->err = errno;
+            return;
+        }
+        if (ret == 0) {
+            if (job->write)
+                job->err = EIO;
+            job->eof = 1;
+            return;
+        }
+        job->got += (unsigned)ret;
+    }
+}
+
+/* Run jobs until told to quit. */
+local void *gz_async_run(void *arg) {
+    gz_async *job = (gz_async *)arg;
+
+    pthread_mutex_lock(&job->lock);
+    for (;;) {
+        while (!job->busy && !job->quit)
+            pthread_cond_wait(&job->cond, &job->lock);
+        if (!job->busy)
+            break;
+        pthread_mutex_unlock(&job->lock);
+        gz_async_io(job);
+        pthread_mutex_lock(&job->lock);
+        job->busy = 0;
+        pthread_cond_signal(&job->cond);
+    }
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+/* Hand a job to the helper thread.  The previous job must be collected. */
+local void gz_async_post(gz_async *job, int write, unsigned char *buf,
+                         unsigned len) {
+    job->write = write;
+    job->buf = buf;
+    job->len = len;
+    job->eof = 0;
+    job->err = 0;
+    pthread_mutex_lock(&job->lock);
+    job->busy = 1;
+    pthread_cond_signal(&job->cond);
+    pthread_mutex_unlock(&job->lock);
+    job->posted = 1;
+}
+
+/* Wait for the posted job to complete.  Return -1 and set the error in state
+   if it failed, otherwise 0. */
+local int gz_async_collect(gz_statep state) {
+    gz_async *job = state->job;
+
+    pthread_mutex_lock(&job->lock);
+    while (job->busy)
+        pthread_cond_wait(&job->cond, &job->lock);
+    pthread_mutex_unlock(&job->lock);
+    job->posted = 0;
+    if (job->err) {
+        errno = job->err;
+        gz_error(state, Z_ERRNO, zstrerror());
+        return -1;
+    }
+    return 0;
+}
+
+/* Start the helper thread once the buffers have been allocated, using buffers
+   of state->size bytes.  If it can't be started, then clear state->async so
+   that the file i/o is done on the calling thread. */
+void ZLIB_INTERNAL gz_async_start(gz_statep state) {
+    gz_async *job;
+
+    state->job = NULL;
+    job = (gz_async *)malloc(sizeof(gz_async));
+    if (job != NULL) {
+        job->busy = 0;
+        job->quit = 0;
+        job->posted = 0;
+        job->fd = state->fd;
+        job->have = 0;
+        job->done = 0;
+        job->spare = (unsigned char *)malloc(state->size);
+        job->data = state->mode == GZ_READ ?
+                    (unsigned char *)malloc(state->size) : NULL;
+        if (job->spare != NULL &&
+                (job->data != NULL || state->mode != GZ_READ)) {
+            pthread_mutex_init(&job->lock, NULL);
+            pthread_cond_init(&job->cond, NULL);
+            if (pthread_create(&job->tid, NULL, gz_async_run, job) == 0) {
+                state->job = job;
+                return;
+            }
+            pthread_cond_destroy(&job->cond);
+            pthread_mutex_destroy(&job->lock);
+        }
+        free(job->data);
+        free(job->spare);
+        free(job);
+    }
+    state->async = 0;
+}
+
+/* Deliver len bytes of prefetched input to buf, or fewer at end of file, and
+   return the number delivered in *have.  This replaces the read() loop in
+   gz_load(), and sets state->eof the same way.  Return -1 on a read error,
+   otherwise 0. */
+int ZLIB_INTERNAL gz_async_read(gz_statep state, unsigned char *buf,
+                                unsigned len, unsigned *have) {
+    unsigned n;
+    unsigned char *swap;
+    gz_async *job = state->job;
+
+    *have = 0;
+    while (*have < len) {
+        if (job->have == 0) {
+            /* get the next buffer of data from the helper */
+            if (job->done)
+                break;
+            if (!job->posted)
+                gz_async_post(job, 0, job->spare, state->size);
+            if (gz_async_collect(state) == -1)
+                return -1;
+            swap = job->data;
+            job->data = job->spare;
+            job->spare = swap;
+            job->next = job->data;
+            job->have = job->got;
+            job->done = job->eof;
+
+            /* start reading the buffer after that */
+            if (!job->done)
+                gz_async_post(job, 0, job->spare, state->size);
+            continue;
+        }
+        n = len - *have;
+        if (n > job->have)
+            n = job->have;
+        memcpy(buf + *have, job->next, n);
+        job->next += n;
+        job->have -= n;
+        *have += n;
+    }
+    if (*have < len)
+        state->eof = 1;
+    return 0;
+}
+
+/* Write the compressed data from state->x.next to strm.next_out in the
+   background, and replace the output buffer with the spare one.  Return -1 if
+   the previous write failed, otherwise 0. */
+int ZLIB_INTERNAL gz_async_write(gz_statep state) {
+    unsigned char *swap;
+    gz_async *job = state->job;
+    z_streamp strm = &(state->strm);
+
+    if (strm->next_out == state->x.next)
+        return 0;
+    if (job->posted && gz_async_collect(state) == -1)
+        return -1;
+    gz_async_post(job, 1, state->x.next,
+                  (unsigned)(strm->next_out - state->x.next));
+    swap = state->out;
+    state->out = job->spare;
+    job->spare = swap;
+    strm->avail_out = state->size;
+    strm->next_out = state->out;
+    state->x.next = state->out;
+    return 0;
+}
+
+/* Wait for the helper to finish its job, so that the file offset is where the
+   calling thread expects it.  When reading, this discards the prefetched data
+   and moves the file offset back to the first byte not yet delivered.  Return
+   -1 on a write error or if the offset can't be moved back, otherwise 0. */
+int ZLIB_INTERNAL gz_async_wait(gz_statep state) {
+    z_off64_t back;
+    gz_async *job = state->job;
+
+    if (job == NULL)
+        return 0;
+    if (state->mode != GZ_READ)
+        return job->posted ? gz_async_collect(state) : 0;
+
+    /* reading -- a failed read is left to be reported by the next read */
+    back = job->have;
+    if (job->posted) {
+        pthread_mutex_lock(&job->lock);
+        while (job->busy)
+            pthread_cond_wait(&job->cond, &job->lock);
+        pthread_mutex_unlock(&job->lock);
+        if (job->err)
+            return -1;
+        back += job->got;
+    }
+    if (back && LSEEK(state->fd, -back, SEEK_CUR) == -1)
+        return -1;
+    job->posted = 0;
+    job->have = 0;
+    job->done = 0;
+    return 0;
+}
+
+/* Stop the helper thread and free its buffers.  A pending write is completed
+   first, and any error from it is left in state. */
+void ZLIB_INTERNAL gz_async_end(gz_statep state) {
+    gz_async *job = state->job;
+
+    if (job == NULL)
+        return;
+    if (job->posted)
+        gz_async_collect(state);
+    pthread_mutex_lock(&job->lock);
+    job->quit = 1;
+    pthread_cond_signal(&job->cond);
+    pthread_mutex_unlock(&job->lock);
+    pthread_join(job->tid, NULL);
+    pthread_cond_destroy(&job->cond);
+    pthread_mutex_destroy(&job->lock);
+    free(job->data);
+    free(job->spare);
+    free(job);
+    state->job = NULL;
+}
+
+#else /* !GZ_ASYNC */
+
+/* Without threads, the file i/o is always done on the calling thread. */
+void ZLIB_INTERNAL gz_async_start(gz_statep state) {
+    state->job = NULL;
+    state->async = 0;
+}
+
+int ZLIB_INTERNAL gz_async_read(gz_statep state, unsigned char *buf,
+                                unsigned len, unsigned *have) {
+    (void)buf;
+    (void)len;
+    *have = 0;
+    gz_error(state, Z_STREAM_ERROR, "no asynchronous i/o");
+    return -1;
+}
+
+int ZLIB_INTERNAL gz_async_write(gz_statep state) {
+    gz_error(state, Z_STREAM_ERROR, "no asynchronous i/o");
+    return -1;
+}
+
+int ZLIB_INTERNAL gz_async_wait(gz_statep state) {
+    (void)state;
+    return 0;
+}
+
+void ZLIB_INTERNAL gz_async_end(gz_statep state) {
+    (void)state;
+}
+
+#endif /* GZ_ASYNC */
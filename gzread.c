@@ -5,6 +5,39 @@
 
 #include "gzguts.h"
 
+/* Map the whole input file into memory, if it is a regular file, so that the
+   input can be inflated from the mapping without copying it.  Leave state->map
+   NULL to use read() instead, e.g. for a pipe or if mmap() fails. */
+local void gz_map(gz_statep state) {
+#ifdef GZ_MMAP
+    struct stat st;
+    void *map;
+
+    if (fstat(state->fd, &st) == -1 || !S_ISREG(st.st_mode) ||
+            st.st_size <= state->start ||
+            (z_off64_t)(size_t)st.st_size != (z_off64_t)st.st_size)
+        return;
+    map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, state->fd, 0);
+    if (map == MAP_FAILED)
+        return;
+    (void)posix_madvise(map, (size_t)st.st_size, POSIX_MADV_SEQUENTIAL);
+    state->map = (unsigned char *)map;
+    state->map_size = (z_off64_t)st.st_size;
+    state->map_next = state->start;
+#else
+    (void)state;
+#endif
+}
+
+/* Remove the mapping of the input file, if any. */
+local void gz_unmap(gz_statep state) {
+#ifdef GZ_MMAP
+    if (state->map != NULL)
+        munmap(state->map, (size_t)state->map_size);
+#endif
+    state->map = NULL;
+}
+
 /* Use read() to load a buffer -- return -1 on error, otherwise 0.  Read from
    state->fd, and update state->eof, state->err, and state->msg as appropriate.
    This function needs to loop on read(), since read() is not guaranteed to
@@ -18,6 +51,18 @@ local int gz_load(gz_statep state, unsigned char *buf, unsigned len,
         gz_error(state, Z_ERRNO, "Invalid input parameters");
         return -1;
     }
+    if (state->map != NULL) {
+        *have = state->map_size - state->map_next < len ?
+                (unsigned)(state->map_size - state->map_next) : len;
+        memcpy(buf, state->map + state->map_next, *have);
+        state->map_next += *have;
+        if (*have < len)
+            state->eof = 1;
+        Probe2(gz_load, len, *have);
+        return 0;
+    }
+    if (state->async && state->job != NULL)
+        return gz_async_read(state, buf, len, have);
 
     *have = 0;
     do {
@@ -37,6 +82,46 @@ local int gz_load(gz_statep state, unsigned char *buf, unsigned len,
     } while (*have < len && ret != 0);
     if (ret == 0)
         state->eof = 1;
+    Probe2(gz_load, len, *have);
+    return 0;
+}
+
+/* Read up to len bytes at offset off of the gzip data into buf, putting the
+   number read in *have -- return -1 on error, otherwise 0.  The file offset is
+   not used, so that several threads can read at once, unless pread() is not
+   available, in which case there must only be one thread. */
+local int gz_pread(gz_statep state, unsigned char *buf, unsigned len,
+                   z_off64_t off, unsigned *have) {
+    int ret;
+    unsigned get, max = ((unsigned)-1 >> 2) + 1;
+
+    off += state->start;
+    *have = 0;
+    if (state->map != NULL) {
+        if (off < state->map_size) {
+            *have = state->map_size - off < len ?
+                    (unsigned)(state->map_size - off) : len;
+            memcpy(buf, state->map + off, *have);
+        }
+        return 0;
+    }
+#ifndef GZ_PREAD
+    if (gz_seekfd(state, off, SEEK_SET) == -1)
+        return -1;
+#endif
+    do {
+        get = len - *have;
+        if (get > max)
+            get = max;
+#ifdef GZ_PREAD
+        ret = (int)pread(state->fd, buf + *have, get, off + *have);
+#else
+        ret = read(state->fd, buf + *have, get);
+#endif
+        if (ret < 0)
+            return -1;
+        *have += (unsigned)ret;
+    } while (*have < len && ret != 0);
     return 0;
 }
 
@@ -53,6 +138,23 @@ local int gz_avail(gz_statep state) {
 
     if (state->err != Z_OK && state->err != Z_BUF_ERROR)
         return -1;
+    if (state->map != NULL) {
+        /* give inflate the mapping directly, up to max bytes at a time --
+           next_in plus avail_in is always at map_next */
+        unsigned max = ((unsigned)-1 >> 2) + 1;
+        if (state->eof == 0) {
+            if (strm->avail_in == 0)
+                strm->next_in = state->map + state->map_next;
+            got = max - strm->avail_in;
+            if (state->map_size - state->map_next <= got) {
+                got = (unsigned)(state->map_size - state->map_next);
+                state->eof = 1;
+            }
+            strm->avail_in += got;
+            state->map_next += got;
+        }
+        return 0;
+    }
     if (state->eof == 0) {
         if (strm->avail_in) {       /* copy what's there to the start */
             if (strm->avail_in > state->size) // Check for out-of-bounds
@@ -71,6 +173,7 @@ local int gz_avail(gz_statep state) {
             return -1;
         if (got > state->size - strm->avail_in) // Check for overflow
             return -1;
+        state->full = got == state->size - strm->avail_in;
         strm->avail_in += got;
         strm->next_in = state->in;
     }
@@ -91,6 +194,12 @@ local int gz_look(gz_statep state) {
 
     /* allocate read buffers and inflate memory */
     if (state->size == 0) {
+        /* choose the buffer size and allow it to grow if gzbuffer() didn't */
+        state->grow = state->want == 0;
+        state->full = 0;
+        if (state->want == 0)
+            state->want = gz_autosize(state);
+
         /* allocate buffers */
         state->in = (unsigned char *)malloc(state->want);
         state->out = (unsigned char *)malloc(state->want << 1);
@@ -115,6 +224,35 @@ local int gz_look(gz_statep state) {
             gz_error(state, Z_MEM_ERROR, "out of memory");
             return -1;
         }
+
+        /* map the input or start the helper thread, if requested */
+        if (state->want_map)
+            gz_map(state);
+        if (state->async && state->map == NULL)
+            gz_async_start(state);
+        else
+            state->async = 0;
+    }
+
+    /* after inflating raw deflate data from an access point, skip the gzip
+       trailer -- it can't be checked, since the start of the member was not
+       decompressed */
+    while (state->trailer) {
+        unsigned n;
+
+        if (strm->avail_in == 0) {
+            if (gz_avail(state) == -1)
+                return -1;
+            if (strm->avail_in == 0) {
+                state->trailer = 0;
+                gz_error(state, Z_BUF_ERROR, "unexpected end of file");
+                return 0;
+            }
+        }
+        n = strm->avail_in < state->trailer ? strm->avail_in : state->trailer;
+        strm->avail_in -= n;
+        strm->next_in += n;
+        state->trailer -= n;
     }
 
     /* get at least the magic bytes in the input buffer */
@@ -134,7 +272,7 @@ local int gz_look(gz_statep state) {
        single byte is sufficient indication that it is not a gzip file) */
     if (strm->avail_in > 1 &&
             strm->next_in[0] == 31 && strm->next_in[1] == 139) {
-        inflateReset(strm);
+        inflateReset2(strm, 15 + 16);   /* in case raw from an access point */
         state->how = GZIP;
         state->direct = 0;
         return 0;
@@ -149,6 +287,18 @@ local int gz_look(gz_statep state) {
         return 0;
     }
 
+    /* doing raw i/o from a mapping -- put the leftover input back, since there
+       can be more of it than fits in the output buffer */
+    if (state->map != NULL) {
+        state->map_next -= strm->avail_in;
+        state->eof = 0;
+        strm->avail_in = 0;
+        state->x.have = 0;
+        state->how = COPY;
+        state->direct = 1;
+        return 0;
+    }
+
     /* doing raw i/o, copy any leftover input to output -- this assumes that
        the output buffer is larger than the input buffer, which also assures
        space for gzungetc() */
@@ -161,6 +311,38 @@ local int gz_look(gz_statep state) {
     return 0;
 }
 
+/* Double the buffer sizes, up to GZBUFMAX, if the buffer size was not set by
+   gzbuffer() and the last load from the file filled the input buffer.  This
+   reduces the number of reads when there is a lot of input.  state->x.have
+   must be 0, and the buffers are not changed if the allocation fails. */
+local void gz_grow(gz_statep state) {
+    unsigned size;
+    unsigned char *in, *out;
+    z_streamp strm = &(state->strm);
+
+    if (!state->grow || !state->full || state->size >= GZBUFMAX ||
+            state->job != NULL || state->map != NULL)
+        return;
+    state->full = 0;
+    size = state->size << 1;
+    out = (unsigned char *)malloc(size << 1);
+    if (out == NULL)
+        return;
+    in = (unsigned char *)malloc(size);
+    if (in == NULL) {
+        free(out);
+        return;
+    }
+    if (strm->avail_in)
+        memcpy(in, strm->next_in, strm->avail_in);
+    strm->next_in = in;
+    free(state->in);
+    free(state->out);
+    state->in = in;
+    state->out = out;
+    state->size = size;
+}
+
 /* Decompress from input to the provided next_out and avail_out in the state.
    On return, state->x.have and state->x.next point to the just decompressed
    data.  If the gzip stream completes, state->how is reset to LOOK to look for
@@ -218,8 +400,13 @@ local int gz_decomp(gz_statep state) {
     state->x.next = strm->next_out - state->x.have;
 
     /* if the gzip stream completed successfully, look for another */
-    if (ret == Z_STREAM_END)
+    if (ret == Z_STREAM_END) {
         state->how = LOOK;
+        if (state->raw) {
+            state->raw = 0;
+            state->trailer = 8;
+        }
+    }
 
     /* good decompression */
     return 0;
@@ -234,6 +421,7 @@ local int gz_decomp(gz_statep state) {
 local int gz_fetch(gz_statep state) {
     z_streamp strm = &(state->strm);
 
+    gz_grow(state);
     do {
         switch(state->how) {
         case LOOK:      /* -> LOOK, COPY (only if never GZIP), or GZIP */
@@ -365,6 +553,7 @@ local z_size_t gz_read(gz_statep state, voidp buf, z_size_t len) {
         else {  /* state->how == GZIP */
             if ((char *)buf + n < (char *)buf)  // Check for overflow
                 return 0;
+            gz_grow(state);
             state->strm.avail_out = n;
             state->strm.next_out = (unsigned char *)buf;
             if (gz_decomp(state) == -1)
@@ -463,6 +652,57 @@ z_size_t ZEXPORT gzfread(voidp buf, z_size_t size, z_size_t nitems,
     return len ? gz_read(state, buf, len) / size : 0;
 }
 
+/* -- see zlib.h -- */
+z_size_t ZEXPORT gzreadv(gzFile file, const z_iovec *iov, unsigned count) {
+    unsigned i;
+    z_size_t len, got, total;
+    gz_statep state;
+
+    /* get internal structure */
+    if (file == NULL)
+        return 0;
+    state = (gz_statep)file;
+
+    /* check that we're reading and that there's no (serious) error */
+    if (state->mode != GZ_READ ||
+            (state->err != Z_OK && state->err != Z_BUF_ERROR))
+        return 0;
+
+    /* check the fragments, and that their total fits in a z_size_t */
+    if (iov == NULL && count)
+        return 0;
+    total = 0;
+    for (i = 0; i < count; i++) {
+        if (iov[i].base == NULL && iov[i].len) {
+            gz_error(state, Z_STREAM_ERROR, "iov fragment has no room");
+            return 0;
+        }
+        len = total + iov[i].len;
+        if (len < total) {
+            gz_error(state, Z_STREAM_ERROR, "request does not fit in a size_t");
+            return 0;
+        }
+        total = len;
+    }
+
+    /* fill each fragment in turn, stopping early at the end of the input or on
+       an error -- gz_read() decompresses straight into fragments of at least
+       twice the buffer size, and copies from the output buffer into smaller
+       ones, which is faster since inflate() copies its output to the window
+       regardless, and slows down when given little room */
+    total = 0;
+    for (i = 0; i < count; i++) {
+        len = iov[i].len;
+        if (len == 0)
+            continue;
+        got = gz_read(state, iov[i].base, len);
+        total += got;
+        if (got < len)
+            break;
+    }
+    return total;
+}
+
 /* -- see zlib.h -- */
 #ifdef Z_PREFIX_SET
 #  undef z_gzgetc
@@ -647,6 +887,87 @@ char * ZEXPORT gzgets(gzFile file, char *buf, int len) {
     return str;
 }
 
+/* -- see zlib.h -- */
+z_size_t ZEXPORT gzgetline(gzFile file, const char **line) {
+    unsigned n;
+    z_size_t got, size;
+    unsigned char *eol, *grow;
+    gz_statep state;
+
+    /* check parameters and get internal structure */
+    if (file == NULL || line == NULL)
+        return 0;
+    state = (gz_statep)file;
+    *line = NULL;
+
+    /* check that we're reading and that there's no (serious) error */
+    if (state->mode != GZ_READ ||
+        (state->err != Z_OK && state->err != Z_BUF_ERROR))
+        return 0;
+
+    /* process a skip request */
+    if (state->seek) {
+        state->seek = 0;
+        if (gz_skip(state, state->skip) == -1)
+            return 0;
+    }
+
+    /* assure that something is in the output buffer */
+    if (state->x.have == 0 && gz_fetch(state) == -1)
+        return 0;
+    if (state->x.have == 0) {
+        state->past = 1;
+        return 0;
+    }
+
+    /* if the whole line is in the output buffer, return it in place */
+    eol = (unsigned char *)memchr(state->x.next, '\n', state->x.have);
+    if (eol != NULL) {
+        n = (unsigned)(eol - state->x.next) + 1;
+        *line = (const char *)state->x.next;
+        state->x.next += n;
+        state->x.have -= n;
+        state->x.pos += n;
+        return n;
+    }
+
+    /* otherwise gather the line in the line buffer, refilling the output
+       buffer until the end-of-line or the end of the file */
+    got = 0;
+    do {
+        n = state->x.have;
+        eol = (unsigned char *)memchr(state->x.next, '\n', n);
+        if (eol != NULL)
+            n = (unsigned)(eol - state->x.next) + 1;
+        if (state->linesize - got < n) {
+            size = state->linesize ? state->linesize : state->size;
+            while (size - got < n && size << 1 > size)
+                size <<= 1;
+            grow = size - got < n ? NULL :
+                   (unsigned char *)realloc(state->line, size);
+            if (grow == NULL) {
+                gz_error(state, Z_MEM_ERROR, "out of memory");
+                return 0;
+            }
+            state->line = grow;
+            state->linesize = size;
+        }
+        memcpy(state->line + got, state->x.next, n);
+        state->x.next += n;
+        state->x.have -= n;
+        state->x.pos += n;
+        got += n;
+        if (eol != NULL)
+            break;
+        if (gz_fetch(state) == -1)
+            return 0;
+        if (state->x.have == 0)
+            state->past = 1;            /* last line has no end-of-line */
+    } while (state->x.have);
+    *line = (const char *)state->line;
+    return got;
+}
+
 /* -- see zlib.h -- */
 int ZEXPORT gzdirect(gzFile file) {
     gz_statep state;
@@ -669,6 +990,1232 @@ int ZEXPORT gzdirect(gzFile file) {
     return state->direct;
 }
 
+/* Random access index.  An access point can be made at the start of any
+   deflate block, by saving the offset of that block in the compressed data,
+   and its starting bit, and the 32K bytes of uncompressed data that precede
+   it.  inflate can then start there, in raw mode, using inflatePrime() for the
+   bits and inflateSetDictionary() for the window.  This is examples/zran.c
+   made part of the library, for gzip files only.  The windows are kept
+   compressed as raw deflate data, which makes the index several times smaller,
+   and only the window of the access point used for a seek is decompressed. */
+typedef struct {
+    z_off64_t out;          /* offset in the uncompressed data */
+    z_off64_t in;           /* offset of the first full byte in the file,
+                               relative to state->start */
+    int bits;               /* 0, or number of bits (1-7) from byte at in-1 */
+    int start;              /* true if at the start of a gzip member */
+    unsigned dict;          /* number of bytes of preceding uncompressed data */
+    unsigned size;          /* number of bytes at window, deflated if < dict */
+    unsigned char *window;  /* the preceding data, possibly compressed */
+} gz_point;
+
+struct gz_index_s {
+    int have;               /* number of access points in list */
+    int size;               /* number of access points allocated */
+    z_off64_t length;       /* length of the uncompressed data */
+    gz_point *list;         /* the access points, in increasing order */
+    unsigned char *win;     /* decompressed window for a seek, or NULL */
+    z_stream strm;          /* inflate engine for the windows */
+};
+typedef struct gz_index_s gz_index;
+
+/* Allocate and initialize an empty index, or return NULL if out of memory. */
+local gz_index *gz_index_new(void) {
+    gz_index *index;
+
+    index = (gz_index *)malloc(sizeof(gz_index));
+    if (index != NULL) {
+        index->have = 0;
+        index->size = 0;
+        index->list = NULL;
+        index->win = NULL;
+        index->strm.state = Z_NULL;
+    }
+    return index;
+}
+
+/* Free an index. */
+local void gz_index_free(gz_index *index) {
+    if (index != NULL) {
+        while (index->have)
+            free(index->list[--index->have].window);
+        free(index->list);
+        free(index->win);
+        if (index->strm.state != Z_NULL)
+            inflateEnd(&index->strm);
+        free(index);
+    }
+}
+
+/* Return room for another access point at the end of index, or NULL if out
+   of memory.  index->have is not updated. */
+local gz_point *gz_index_next(gz_index *index) {
+    gz_point *point;
+
+    if (index->have == index->size) {
+        if (index->size > INT_MAX / 2)
+            return NULL;
+        index->size = index->size ? index->size << 1 : 8;
+        point = (gz_point *)realloc(index->list,
+                                    sizeof(gz_point) * (size_t)index->size);
+        if (point == NULL)
+            return NULL;
+        index->list = point;
+    }
+    return index->list + index->have;
+}
+
+/* Add an access point to index, with the last dict bytes of uncompressed data
+   from the circular window win, which has next bytes written at its end.  The
+   window is compressed with def into tmp, which has room for GZWINSIZE bytes,
+   but is stored as is if that doesn't make it smaller.  Return -1 if out of
+   memory, otherwise 0. */
+local int gz_index_add(gz_index *index, z_off64_t in, z_off64_t out, int bits,
+                       unsigned dict, const unsigned char *win, unsigned next,
+                       z_streamp def, unsigned char *tmp) {
+    int ret;
+    unsigned copy;
+    gz_point *point;
+
+    point = gz_index_next(index);
+    if (point == NULL)
+        return -1;
+    point->out = out;
+    point->in = in;
+    point->bits = bits;
+    point->start = dict == 0;       /* no window only at a member start */
+    point->dict = dict;
+    copy = next < dict ? next : dict;
+
+    /* compress the older part of the window and then the newer part */
+    ret = Z_BUF_ERROR;
+    if (dict > 1 && deflateReset(def) == Z_OK) {
+        def->next_out = tmp;
+        def->avail_out = dict - 1;
+        def->next_in = (z_const Bytef *)win + GZWINSIZE - (dict - copy);
+        def->avail_in = dict - copy;
+        ret = deflate(def, Z_NO_FLUSH);
+        if (ret == Z_OK) {
+            def->next_in = (z_const Bytef *)win + next - copy;
+            def->avail_in = copy;
+            ret = deflate(def, Z_FINISH);
+        }
+    }
+    point->size = ret == Z_STREAM_END ? dict - 1 - def->avail_out : dict;
+    point->window = (unsigned char *)malloc(point->size ? point->size : 1);
+    if (point->window == NULL)
+        return -1;
+    if (point->size < dict)
+        memcpy(point->window, tmp, point->size);
+    else {
+        memcpy(point->window + dict - copy, win + next - copy, copy);
+        memcpy(point->window, win + GZWINSIZE - (dict - copy), dict - copy);
+    }
+    index->have++;
+    return 0;
+}
+
+/* Decompress the compressed window of point to win, using strm, which must
+   be a freshly reset raw inflate engine.  Return 0 on success, or -1 if the
+   compressed window is invalid. */
+local int gz_window(z_streamp strm, gz_point *point, unsigned char *win) {
+    int ret;
+
+    strm->next_in = point->window;
+    strm->avail_in = point->size;
+    strm->next_out = win;
+    strm->avail_out = point->dict;
+    ret = inflate(strm, Z_FINISH);
+    return ret == Z_STREAM_END && strm->avail_out == 0 ? 0 : -1;
+}
+
+/* Return the uncompressed window of point, decompressing it if needed, or
+   NULL if out of memory or the compressed window is invalid. */
+local const unsigned char *gz_index_window(gz_index *index, gz_point *point) {
+    if (point->size == point->dict)
+        return point->window;
+    if (index->win == NULL) {
+        index->win = (unsigned char *)malloc(GZWINSIZE);
+        if (index->win == NULL)
+            return NULL;
+    }
+    if (index->strm.state == Z_NULL) {
+        index->strm.zalloc = Z_NULL;
+        index->strm.zfree = Z_NULL;
+        index->strm.opaque = Z_NULL;
+        index->strm.avail_in = 0;
+        index->strm.next_in = Z_NULL;
+        if (inflateInit2(&index->strm, -15) != Z_OK) {
+            index->strm.state = Z_NULL;
+            return NULL;
+        }
+    }
+    else
+        inflateReset(&index->strm);
+    return gz_window(&index->strm, point, index->win) ? NULL : index->win;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT gzindex_build(gzFile file, z_off_t span) {
+    int ret, bits;
+    unsigned have, got, dict;
+    unsigned char *buf, *win, *tmp;
+    z_off64_t totin, totout, beg, last;
+    z_stream strm, def;
+    gz_index *index;
+    gz_statep state;
+
+    /* get internal structure */
+    if (file == NULL)
+        return Z_STREAM_ERROR;
+    state = (gz_statep)file;
+
+    /* check that we're reading and that there's no error */
+    if (state->mode != GZ_READ ||
+            (state->err != Z_OK && state->err != Z_BUF_ERROR))
+        return Z_STREAM_ERROR;
+    if (span <= 0)
+        span = GZSPAN;
+
+    /* start from the beginning of the file */
+    if (gzrewind(file) == -1)
+        return Z_ERRNO;
+
+    /* allocate the index, the input buffer, the window and a buffer for its
+       compression, and the inflate and deflate engines */
+    index = gz_index_new();
+    buf = (unsigned char *)malloc(GZBUFSIZE);
+    win = (unsigned char *)malloc(GZWINSIZE);
+    tmp = (unsigned char *)malloc(GZWINSIZE);
+    strm.zalloc = def.zalloc = Z_NULL;
+    strm.zfree = def.zfree = Z_NULL;
+    strm.opaque = def.opaque = Z_NULL;
+    strm.avail_in = 0;
+    strm.next_in = Z_NULL;
+    ret = Z_MEM_ERROR;
+    if (index != NULL && buf != NULL && win != NULL && tmp != NULL) {
+        ret = inflateInit2(&strm, 15 + 16);
+        if (ret == Z_OK) {
+            ret = deflateInit2(&def, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15,
+                               DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+            if (ret != Z_OK)
+                inflateEnd(&strm);
+        }
+    }
+    if (ret != Z_OK) {
+        free(tmp);
+        free(win);
+        free(buf);
+        gz_index_free(index);
+        return ret;
+    }
+
+    /* decompress the whole file a block at a time, adding an access point
+       at the first block boundary every span bytes of uncompressed data */
+    totin = totout = beg = last = 0;
+    strm.avail_out = 0;
+    do {
+        /* get more input, making sure that there is a gzip header first */
+        if (strm.avail_in == 0) {
+            if (gz_load(state, buf, GZBUFSIZE, &got) == -1) {
+                ret = Z_ERRNO;
+                break;
+            }
+            strm.avail_in = got;
+            strm.next_in = buf;
+            totin += got;
+            if (totin == got && (got < 2 || buf[0] != 31 || buf[1] != 139)) {
+                ret = Z_DATA_ERROR;
+                break;
+            }
+        }
+
+        /* decompress into the window, which takes the output circularly */
+        if (strm.avail_out == 0) {
+            strm.avail_out = GZWINSIZE;
+            strm.next_out = win;
+        }
+        have = strm.avail_out;
+        ret = inflate(&strm, Z_BLOCK);
+        totout += have - strm.avail_out;
+
+        /* at the end of a header or of a non-last block, add a point there if
+           it's the first one, or if span bytes went by since the last one */
+        if ((strm.data_type & 0xc0) == 0x80 &&
+                (index->have == 0 || totout - last >= span)) {
+            bits = strm.data_type & 7;
+            dict = totout - beg > GZWINSIZE ? GZWINSIZE :
+                                              (unsigned)(totout - beg);
+            if (gz_index_add(index, totin - strm.avail_in, totout, bits, dict,
+                             win, GZWINSIZE - strm.avail_out, &def,
+                             tmp) == -1) {
+                ret = Z_MEM_ERROR;
+                break;
+            }
+            last = totout;
+        }
+
+        /* continue with another gzip member, if there is one, and otherwise
+           ignore any trailing garbage, as gzread() does */
+        if (ret == Z_STREAM_END) {
+            if (strm.avail_in < 2 && !state->eof) {
+                if (strm.avail_in)
+                    buf[0] = strm.next_in[0];
+                if (gz_load(state, buf + strm.avail_in,
+                            GZBUFSIZE - strm.avail_in, &got) == -1) {
+                    ret = Z_ERRNO;
+                    break;
+                }
+                strm.avail_in += got;
+                strm.next_in = buf;
+                totin += got;
+            }
+            if (strm.avail_in > 1 &&
+                    strm.next_in[0] == 31 && strm.next_in[1] == 139) {
+                ret = inflateReset(&strm);
+                beg = totout;
+            }
+        }
+        else if (ret == Z_BUF_ERROR && strm.avail_in == 0 && !state->eof)
+            ret = Z_OK;         /* just need more input */
+    } while (ret == Z_OK);
+    deflateEnd(&def);
+    inflateEnd(&strm);
+    free(tmp);
+    free(win);
+    free(buf);
+
+    /* replace the index on success, and return to the start of the file */
+    if (ret == Z_NEED_DICT)
+        ret = Z_DATA_ERROR;
+    if (ret == Z_STREAM_END) {
+        index->length = totout;
+        gz_index_free(state->index);
+        state->index = index;
+        ret = index->have;
+    }
+    else
+        gz_index_free(index);
+    if (gzrewind(file) == -1 && ret >= 0)
+        ret = Z_ERRNO;
+    return ret;
+}
+
+/* Write n bytes of val, least significant first, to out. */
+local void gz_put(FILE *out, z_off64_t val, int n) {
+    while (n--) {
+        putc((int)(val & 0xff), out);
+        val >>= 8;
+    }
+}
+
+/* Read n bytes, least significant first, from in.  Set *err if there aren't
+   enough bytes. */
+local z_off64_t gz_get(FILE *in, int n, int *err) {
+    int ch, i;
+    z_off64_t val = 0;
+
+    for (i = 0; i < n; i++) {
+        ch = getc(in);
+        if (ch == EOF) {
+            *err = 1;
+            return 0;
+        }
+        val += (z_off64_t)ch << (i << 3);
+    }
+    return val;
+}
+
+/* index file format: the magic string and a version digit, the uncompressed
+   length and number of points, and then each point as out, in, bits, dict,
+   size (version 2), and size window bytes, all little-endian -- in version 3,
+   8 is added to bits for a point at the start of a member, before which that
+   was the same as dict being zero, and in version 1, size is not there and the
+   windows are not compressed */
+#define GZ_INDEX_MAGIC "gzrandx"
+#define GZ_INDEX_VERSION '3'
+
+/* -- see zlib.h -- */
+int ZEXPORT gzindex_save(gzFile file, const char *path) {
+    int n;
+    FILE *out;
+    gz_point *point;
+    gz_statep state;
+
+    /* get internal structure */
+    if (file == NULL || path == NULL)
+        return Z_STREAM_ERROR;
+    state = (gz_statep)file;
+    if (state->mode != GZ_READ || state->index == NULL)
+        return Z_STREAM_ERROR;
+
+    /* write the index */
+    out = fopen(path, "wb");
+    if (out == NULL)
+        return Z_ERRNO;
+    fputs(GZ_INDEX_MAGIC, out);
+    putc(GZ_INDEX_VERSION, out);
+    gz_put(out, state->index->length, 8);
+    gz_put(out, state->index->have, 4);
+    for (n = 0; n < state->index->have; n++) {
+        point = state->index->list + n;
+        gz_put(out, point->out, 8);
+        gz_put(out, point->in, 8);
+        gz_put(out, point->bits + (point->start ? 8 : 0), 1);
+        gz_put(out, point->dict, 4);
+        gz_put(out, point->size, 4);
+        fwrite(point->window, 1, point->size, out);
+    }
+    n = ferror(out);
+    return fclose(out) || n ? Z_ERRNO : Z_OK;
+}
+
+/* Get n bytes, least significant first, from buf. */
+local z_off64_t gz_getle(const unsigned char *buf, int n) {
+    z_off64_t val = 0;
+
+    while (n--)
+        val = (val << 8) + buf[n];
+    return val;
+}
+
+/* Make index from the lists of blocks that gzwrite() puts after each member
+   in block mode, as described in gzwrite.c, reading them backwards from the
+   end of the file to the start.  The access points are the block starts,
+   where no window is needed.  Return Z_OK, Z_DATA_ERROR if the file doesn't
+   end with a list or a list is invalid, Z_ERRNO on a read error, or
+   Z_MEM_ERROR if out of memory. */
+local int gz_index_blocks(gz_statep state, gz_index *index) {
+    int ret = Z_OK, n;
+    unsigned got, head, size, first, m, i;
+    z_off64_t end, at, back, length, total = 0, in;
+    unsigned char *buf, *list;
+    gz_point *point, swap;
+
+    if (state->map != NULL)
+        end = state->map_size;
+    else if ((end = gz_seekfd(state, 0, SEEK_END)) == -1)
+        return Z_ERRNO;
+    end -= state->start;
+    buf = (unsigned char *)malloc(48 + 8 * GZBLOCKS);
+    if (buf == NULL)
+        return Z_MEM_ERROR;
+    in = end;
+    while (ret == Z_OK && end > 0) {
+        /* get the empty gzip member that ends at end */
+        ret = Z_DATA_ERROR;
+        if (end < 14 || gz_pread(state, buf, 14, end - 14, &got) == -1 ||
+                got != 14 || memcmp(buf + 4, "\003\0\0\0\0\0\0\0\0\0", 10))
+            break;
+        head = (unsigned)gz_getle(buf, 4);
+        if (head < 56 || head > 48 + 8 * GZBLOCKS || head % 8 ||
+                head > end - 10)
+            break;
+        at = end - 10 - head;
+        if (gz_pread(state, buf, head, at, &got) == -1 || got != head)
+            break;
+        m = (unsigned)gz_getle(buf + 24, 4);
+        if (memcmp(buf, "\037\213\010\004", 4) ||
+                gz_getle(buf + 10, 2) != head - 12 || buf[12] != 'Z' ||
+                buf[13] != 'I' || gz_getle(buf + 14, 2) != head - 16 ||
+                head != 48 + 8 * m || gz_getle(buf + head - 4, 4) != head)
+            break;
+        size = (unsigned)gz_getle(buf + 16, 4);
+        first = (unsigned)gz_getle(buf + 20, 4);
+        list = buf + 28;
+        back = gz_getle(list + 8 * m, 8);
+        length = gz_getle(list + 8 * m + 8, 8);
+        if (size == 0 || back > at || length < 0)
+            break;
+
+        /* add its blocks, last first, with out relative to the end for now */
+        ret = Z_OK;
+        for (i = m; i-- && ret == Z_OK;) {
+            point = gz_index_next(index);
+            if (point == NULL) {
+                ret = Z_MEM_ERROR;
+                break;
+            }
+            point->out = (z_off64_t)size * (first + i);
+            point->in = at - back + gz_getle(list + 8 * i, 8);
+            if ((point->out >= length && first + i) ||
+                    point->in <= at - back || point->in >= in) {
+                ret = Z_DATA_ERROR;
+                break;
+            }
+            in = point->in;
+            point->out -= total + length;
+            point->bits = 0;
+            point->start = first + i == 0;
+            point->dict = 0;
+            point->size = 0;
+            point->window = (unsigned char *)malloc(1);
+            if (point->window == NULL)
+                ret = Z_MEM_ERROR;
+            else
+                index->have++;
+        }
+
+        /* go to the list before this one, or to the end of the member before
+           this member if this was its first list */
+        if (first) {
+            end = at;
+        }
+        else {
+            end = at - back;
+            total += length;
+        }
+    }
+    free(buf);
+    if (ret != Z_OK)
+        return ret;
+
+    /* put the access points in order, now that the total length is known */
+    for (n = 0; n < index->have - 1 - n; n++) {
+        swap = index->list[n];
+        index->list[n] = index->list[index->have - 1 - n];
+        index->list[index->have - 1 - n] = swap;
+    }
+    for (n = 0; n < index->have; n++)
+        index->list[n].out += total;
+    index->length = total;
+    return index->have ? Z_OK : Z_DATA_ERROR;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT gzindex_load(gzFile file, const char *path) {
+    int err = 0, have;
+    char magic[sizeof(GZ_INDEX_MAGIC)];
+    FILE *in;
+    gz_point *point;
+    gz_index *index;
+    gz_statep state;
+
+    /* get internal structure */
+    if (file == NULL)
+        return Z_STREAM_ERROR;
+    state = (gz_statep)file;
+    if (state->mode != GZ_READ)
+        return Z_STREAM_ERROR;
+
+    /* with no path, get the index from the block lists in the file, and go
+       back to the start of the file */
+    if (path == NULL) {
+        index = gz_index_new();
+        if (index == NULL)
+            return Z_MEM_ERROR;
+        have = gz_index_blocks(state, index);
+        if (have == Z_OK) {
+            gz_index_free(state->index);
+            state->index = index;
+            have = index->have;
+        }
+        else
+            gz_index_free(index);
+        if (gzrewind(file) == -1 && have >= 0)
+            have = Z_ERRNO;
+        return have;
+    }
+
+    /* read and check the header */
+    in = fopen(path, "rb");
+    if (in == NULL)
+        return Z_ERRNO;
+    index = gz_index_new();
+    if (index == NULL) {
+        fclose(in);
+        return Z_MEM_ERROR;
+    }
+    if (fread(magic, 1, sizeof(magic), in) != sizeof(magic) ||
+            memcmp(magic, GZ_INDEX_MAGIC, sizeof(magic) - 1) ||
+            magic[sizeof(magic) - 1] < '1' ||
+            magic[sizeof(magic) - 1] > GZ_INDEX_VERSION)
+        err = 1;
+    index->length = gz_get(in, 8, &err);
+    have = (int)gz_get(in, 4, &err);
+    if (err || index->length < 0 || have < 1 ||
+            (size_t)have > (size_t)-1 / sizeof(gz_point)) {
+        gz_index_free(index);
+        fclose(in);
+        return Z_DATA_ERROR;
+    }
+
+    /* read the access points, checking that they are in order */
+    index->size = have;
+    index->list = (gz_point *)malloc(sizeof(gz_point) * (size_t)have);
+    if (index->list == NULL) {
+        gz_index_free(index);
+        fclose(in);
+        return Z_MEM_ERROR;
+    }
+    while (index->have < have) {
+        point = index->list + index->have;
+        point->out = gz_get(in, 8, &err);
+        point->in = gz_get(in, 8, &err);
+        point->bits = (int)gz_get(in, 1, &err);
+        point->dict = (unsigned)gz_get(in, 4, &err);
+        point->start = point->dict == 0;
+        if (magic[sizeof(magic) - 1] > '2') {
+            point->start = point->bits >> 3;
+            point->bits &= ~8;
+        }
+        point->size = magic[sizeof(magic) - 1] == '1' ? point->dict :
+                      (unsigned)gz_get(in, 4, &err);
+        if (err || point->bits > 7 || point->dict > GZWINSIZE ||
+                point->size > point->dict ||
+                point->out > index->length || point->in < 0 ||
+                (index->have == 0 ? point->out != 0 :
+                 point->out < point[-1].out || point->in < point[-1].in) ||
+                (point->bits && point->in == 0)) {
+            err = Z_DATA_ERROR;
+            break;
+        }
+        point->window = (unsigned char *)malloc(point->size ? point->size : 1);
+        if (point->window == NULL) {
+            err = Z_MEM_ERROR;
+            break;
+        }
+        index->have++;
+        if (fread(point->window, 1, point->size, in) != point->size) {
+            err = Z_DATA_ERROR;
+            break;
+        }
+    }
+    fclose(in);
+    if (err) {
+        gz_index_free(index);
+        return err;
+    }
+
+    /* replace the index */
+    gz_index_free(state->index);
+    state->index = index;
+    return index->have;
+}
+
+/* Use the index to go to the access point at or before the uncompressed
+   offset target, and request a skip from there to target.  Return 1 if that
+   was done, 0 if the index doesn't apply or would not save any decompression,
+   or -1 on error. */
+int ZLIB_INTERNAL gz_index_seek(gz_statep state, z_off64_t target) {
+    int lo, hi, mid, ch = 0;
+    unsigned got;
+    unsigned char byte;
+    const unsigned char *window;
+    gz_point *point;
+    gz_index *index = state->index;
+    z_streamp strm = &(state->strm);
+
+    /* the index is only for gzip data, so find out if that's what this is */
+    if (state->how == LOOK && state->x.have == 0 && gz_look(state) == -1)
+        return -1;
+    if (state->direct || target > index->length)
+        return 0;
+
+    /* find the access point closest to but not after target */
+    lo = -1;
+    hi = index->have;
+    point = index->list;
+    while (hi - lo > 1) {
+        mid = (lo + hi) >> 1;
+        if (target < point[mid].out)
+            hi = mid;
+        else
+            lo = mid;
+    }
+    point += lo;
+
+    /* if that's not after here and the target is ahead, just skip to it */
+    if (point->out <= state->x.pos && target >= state->x.pos)
+        return 0;
+
+    /* go to the access point and prime inflate with its bits and window */
+    window = gz_index_window(index, point);
+    if (window == NULL) {
+        gz_error(state, Z_MEM_ERROR, "could not decompress access point window");
+        return -1;
+    }
+    if (gz_seekfd(state, state->start + point->in - (point->bits ? 1 : 0),
+                  SEEK_SET) == -1)
+        return -1;
+    state->x.have = 0;
+    state->eof = 0;
+    state->past = 0;
+    state->trailer = 0;
+    strm->avail_in = 0;
+    gz_error(state, Z_OK, NULL);
+    if (point->bits) {
+        if (gz_load(state, &byte, 1, &got) == -1)
+            return -1;
+        if (got == 0) {
+            gz_error(state, Z_BUF_ERROR, "unexpected end of file");
+            return -1;
+        }
+        ch = byte;
+    }
+    if (inflateReset2(strm, -15) != Z_OK ||
+            (point->bits &&
+             inflatePrime(strm, point->bits, ch >> (8 - point->bits)) != Z_OK) ||
+            (point->dict &&
+             inflateSetDictionary(strm, window, point->dict) != Z_OK)) {
+        gz_error(state, Z_STREAM_ERROR, "could not start at access point");
+        return -1;
+    }
+    state->how = GZIP;
+    state->raw = 1;
+    state->x.pos = point->out;
+    state->skip = target - point->out;
+    state->seek = state->skip != 0;
+    return 1;
+}
+
+/* Parallel decompression.  The gzip data is cut into parts that can be
+   decompressed independently, and the parts are decompressed in waves of one
+   part per thread, with the output of each wave written in order.  If file has
+   an index, then the parts are the spans between its access points, otherwise
+   they are the gzip members, which are found by looking ahead for gzip headers
+   and decompressing from each one that might be a member at the same time.
+   Those that turn out not to start where the member before them ended are
+   discarded.  A member that starts at an access point or that is longer than
+   GZPHOLD is checked by combining the CRC-32s of its pieces, otherwise
+   inflate() checks it as usual. */
+typedef struct {
+    z_stream strm;          /* inflate engine for this part */
+    unsigned char *buf;     /* input buffer, if the input is not mapped */
+    unsigned char *win;     /* decompressed window of an access point */
+    unsigned char *out;     /* decompressed data */
+    size_t size;            /* allocated bytes at out */
+    size_t have;            /* decompressed bytes at out */
+    z_off64_t next;         /* offset of the next input to read */
+    int ret;                /* Z_OK or an error */
+        /* starting at a gzip header */
+    z_off64_t in;           /* offset of the gzip header */
+    int done;               /* true if the end of the member was reached */
+    z_off64_t end;          /* offset after the member, once done */
+        /* starting at an access point */
+    gz_point *point;        /* the access point */
+    size_t len;             /* bytes of output up to the next access point */
+    int last;               /* true to go on to the end of the member there */
+    int ended;              /* true if the member at the point ended */
+    size_t head;            /* bytes of output from that member */
+    uLong crc;              /* CRC-32 of those bytes */
+    uLong check;            /* CRC-32 from the member's trailer */
+    uLong isize;            /* length from the member's trailer */
+    size_t tail;            /* bytes of output from a member in progress */
+    uLong part;             /* CRC-32 of those bytes */
+} gz_part;
+
+typedef struct {
+    gz_statep state;        /* file being decompressed */
+    gz_part *part;          /* parts in this wave */
+} gz_wave;
+
+/* Give the inflate engine of part more input from part->next -- return -1 on
+   error, otherwise 0.  avail_in is left zero at the end of the input. */
+local int gz_part_input(gz_statep state, gz_part *part) {
+    unsigned got, max = ((unsigned)-1 >> 2) + 1;
+    z_off64_t left;
+
+    if (state->map != NULL) {
+        left = state->map_size - state->start - part->next;
+        got = left <= 0 ? 0 : left < max ? (unsigned)left : max;
+        part->strm.next_in = state->map + state->start + part->next;
+    }
+    else {
+        if (gz_pread(state, part->buf, GZBUFMAX, part->next, &got) == -1)
+            return -1;
+        part->strm.next_in = part->buf;
+    }
+    part->strm.avail_in = got;
+    part->next += got;
+    return 0;
+}
+
+/* Get the next byte of input for part into *byte -- return Z_OK, Z_ERRNO, or
+   Z_BUF_ERROR at the end of the input. */
+local int gz_part_byte(gz_statep state, gz_part *part, unsigned char *byte) {
+    if (part->strm.avail_in == 0) {
+        if (gz_part_input(state, part) == -1)
+            return Z_ERRNO;
+        if (part->strm.avail_in == 0)
+            return Z_BUF_ERROR;
+    }
+    part->strm.avail_in--;
+    *byte = *part->strm.next_in++;
+    return Z_OK;
+}
+
+/* Decompress the gzip member in progress in part, appending to part->out until
+   the end of the member, or until there are hold bytes at out.  Set part->done
+   and part->end at the end of the member.  Return Z_OK or an error. */
+local int gz_part_inflate(gz_statep state, gz_part *part, size_t hold) {
+    int ret;
+    unsigned max = ((unsigned)-1 >> 2) + 1, room;
+    size_t size;
+    unsigned char *out;
+    z_streamp strm = &part->strm;
+
+    while (part->have < hold) {
+        if (part->have == part->size) {
+            size = part->size ? part->size << 1 : GZBUFMAX;
+            if (size > hold)
+                size = hold;
+            out = (unsigned char *)realloc(part->out, size);
+            if (out == NULL)
+                return Z_MEM_ERROR;
+            part->out = out;
+            part->size = size;
+        }
+        if (strm->avail_in == 0) {
+            if (gz_part_input(state, part) == -1)
+                return Z_ERRNO;
+            if (strm->avail_in == 0)
+                return Z_BUF_ERROR;
+        }
+        room = part->size - part->have < max ?
+               (unsigned)(part->size - part->have) : max;
+        strm->next_out = part->out + part->have;
+        strm->avail_out = room;
+        ret = inflate(strm, Z_NO_FLUSH);
+        part->have += room - strm->avail_out;
+        if (ret == Z_STREAM_END) {
+            part->done = 1;
+            part->end = part->next - strm->avail_in;
+            return Z_OK;
+        }
+        if (ret != Z_OK)
+            return ret == Z_NEED_DICT ? Z_DATA_ERROR : ret;
+    }
+    return Z_OK;
+}
+
+/* Decompress up to GZPHOLD bytes of the gzip member that may start at
+   part->in. */
+local void gz_part_member(voidpf arg, unsigned job) {
+    gz_wave *wave = (gz_wave *)arg;
+    gz_part *part = wave->part + job;
+
+    part->have = 0;
+    part->done = 0;
+    part->next = part->in;
+    part->strm.avail_in = 0;
+    part->ret = inflateReset2(&part->strm, 15 + 16);
+    if (part->ret == Z_OK)
+        part->ret = gz_part_inflate(wave->state, part, GZPHOLD);
+}
+
+/* Decompress the part->len bytes from the access point part->point, and then
+   the rest of the member if part->last is true.  Any members that end in the
+   part get their CRC-32 and length compared with their trailer later, or by
+   inflate() for those that start in the part too. */
+local void gz_part_point(voidpf arg, unsigned job) {
+    gz_wave *wave = (gz_wave *)arg;
+    gz_part *part = wave->part + job;
+    gz_point *point = part->point;
+    z_streamp strm = &part->strm;
+    int ret, raw = 1, open = 1;
+    unsigned max = ((unsigned)-1 >> 2) + 1, room, n;
+    size_t start = 0;
+    unsigned char byte, trailer[8];
+    const unsigned char *window = point->window;
+
+    part->have = 0;
+    part->ended = 0;
+    part->next = point->in - (point->bits ? 1 : 0);
+    ret = inflateReset2(strm, -15);
+    if (ret == Z_OK && point->size < point->dict) {
+        ret = gz_window(strm, point, part->win) ? Z_DATA_ERROR :
+                                                  inflateReset(strm);
+        window = part->win;
+    }
+    strm->avail_in = 0;
+    if (ret == Z_OK && point->bits) {
+        ret = gz_part_byte(wave->state, part, &byte);
+        if (ret == Z_OK)
+            ret = inflatePrime(strm, point->bits, byte >> (8 - point->bits));
+    }
+    if (ret == Z_OK && point->dict)
+        ret = inflateSetDictionary(strm, window, point->dict);
+
+    /* decompress len bytes, and then until the end of the member if last,
+       expecting no more output then */
+    while (ret == Z_OK && (part->have < part->len || (part->last && open))) {
+        if (strm->avail_in == 0) {
+            if (gz_part_input(wave->state, part) == -1) {
+                ret = Z_ERRNO;
+                break;
+            }
+            if (strm->avail_in == 0) {
+                ret = Z_BUF_ERROR;
+                break;
+            }
+        }
+        room = part->len - part->have < max ?
+               (unsigned)(part->len - part->have) : max;
+        strm->next_out = room ? part->out + part->have : &byte;
+        strm->avail_out = room ? room : 1;
+        ret = inflate(strm, Z_NO_FLUSH);
+        if (room == 0 && strm->avail_out == 0) {
+            ret = Z_DATA_ERROR;         /* index doesn't match the data */
+            break;
+        }
+        part->have += room - (room ? strm->avail_out : 0);
+        if (ret == Z_NEED_DICT)
+            ret = Z_DATA_ERROR;
+        if (ret != Z_STREAM_END)
+            continue;
+
+        /* at the end of a member that started before the access point, save
+           its trailer to check later -- if it started here, then inflate()
+           has already checked it */
+        if (raw) {
+            for (n = 0; n < 8 && ret == Z_STREAM_END; n++)
+                if (gz_part_byte(wave->state, part, trailer + n) != Z_OK)
+                    ret = Z_BUF_ERROR;
+            if (ret != Z_STREAM_END)
+                break;
+            part->crc = crc32_z(0L, part->out, part->have);
+            part->head = part->have;
+            part->check = trailer[0] + ((uLong)trailer[1] << 8) +
+                          ((uLong)trailer[2] << 16) + ((uLong)trailer[3] << 24);
+            part->isize = trailer[4] + ((uLong)trailer[5] << 8) +
+                          ((uLong)trailer[6] << 16) + ((uLong)trailer[7] << 24);
+            part->ended = 1;
+            raw = 0;
+        }
+        open = 0;
+        ret = Z_OK;
+
+        /* if there's more output for this part, then it's another member */
+        if (part->have < part->len) {
+            ret = inflateReset2(strm, 15 + 16);
+            start = part->have;
+            open = 1;
+        }
+    }
+
+    /* note the CRC-32 of the output from a member that didn't end here */
+    part->tail = 0;
+    part->part = 0;
+    if (ret == Z_OK && raw) {
+        part->crc = crc32_z(0L, part->out, part->have);
+        part->head = part->have;
+    }
+    else if (ret == Z_OK && open) {
+        part->tail = part->have - start;
+        part->part = strm->adler;
+    }
+    part->ret = ret;
+}
+
+/* Write len bytes at buf to fd -- return -1 on error, otherwise 0. */
+local int gz_put_fd(int fd, const unsigned char *buf, size_t len) {
+    int ret;
+    unsigned put, max = ((unsigned)-1 >> 2) + 1;
+
+    while (len) {
+        put = len < max ? (unsigned)len : max;
+        ret = write(fd, buf, put);
+        if (ret <= 0)
+            return -1;
+        buf += ret;
+        len -= (unsigned)ret;
+    }
+    return 0;
+}
+
+/* Put the offsets of up to max possible gzip headers from from to before to
+   in part[].in.  Return the number found, or -1 on a read error. */
+local int gz_scan(gz_statep state, unsigned char *buf, z_off64_t from,
+                  z_off64_t to, gz_part *part, int max) {
+    int found = 0;
+    unsigned got, i;
+    z_off64_t left;
+    const unsigned char *p;
+
+    while (from < to && found < max) {
+        left = to - from + 9;
+        if (state->map != NULL) {
+            if (state->map_size - state->start - from < left)
+                left = state->map_size - state->start - from;
+            got = left <= 0 ? 0 : left < GZBUFMAX ? (unsigned)left : GZBUFMAX;
+            p = state->map + state->start + from;
+        }
+        else {
+            if (gz_pread(state, buf, left < GZBUFMAX ? (unsigned)left :
+                                     GZBUFMAX, from, &got) == -1)
+                return -1;
+            p = buf;
+        }
+        if (got < 10)
+            break;
+        for (i = 0; i < got - 9 && found < max; i++)
+            if (p[i] == 31 && p[i + 1] == 139 && p[i + 2] == 8 &&
+                    (p[i + 3] & 0xe0) == 0 &&
+                    (p[i + 8] == 0 || p[i + 8] == 2 || p[i + 8] == 4))
+                part[found++].in = from + i;
+        from += got - 9;
+    }
+    return found;
+}
+
+/* Write len bytes at buf to the file descriptor at arg for par_inflate() --
+   return non-zero on error. */
+local int gz_put_spec(voidpf arg, const unsigned char *buf, z_size_t len) {
+    return gz_put_fd(*(int *)arg, buf, len);
+}
+
+/* Decompress the single long member at *pos of the mapped gzip data using
+   threads threads, splitting its deflate data where block boundaries are
+   guessed to be, writing it to fd and updating *pos. Return Z_STREAM_ERROR
+   without writing anything if the member can't be split. */
+local int gz_par_spec(gz_statep state, int fd, gz_part *part, int threads,
+                      z_off64_t *pos) {
+    int ret;
+    unsigned char dummy;
+    const unsigned char *buf;
+    z_off64_t left;
+    z_size_t head, used, total;
+    uLong crc;
+    z_streamp strm = &part[0].strm;
+
+    /* find the length of the gzip header, and check that the deflate data
+       starts on a byte boundary after it */
+    buf = state->map + state->start + *pos;
+    left = (z_off64_t)state->map_size - state->start - *pos;
+    if ((z_off64_t)(z_size_t)left != left)
+        return Z_STREAM_ERROR;
+    ret = inflateReset2(strm, 15 + 16);
+    if (ret != Z_OK)
+        return ret;
+    strm->next_in = (z_const Bytef *)buf;
+    strm->avail_in = left < UINT_MAX ? (uInt)left : UINT_MAX;
+    strm->next_out = &dummy;
+    strm->avail_out = 1;
+    ret = inflate(strm, Z_BLOCK);
+    if (ret != Z_OK || strm->data_type != 128)
+        return Z_STREAM_ERROR;
+    head = (z_size_t)strm->total_in;
+
+    /* decompress the deflate data and check the trailer */
+    ret = par_inflate(buf + head, (z_size_t)left - head, (unsigned)threads,
+                      gz_put_spec, &fd, &used, &crc, &total);
+    if (ret != Z_OK)
+        return ret;
+    buf += head + used;
+    if ((z_size_t)left - head - used < 8)
+        return Z_BUF_ERROR;
+    if (crc != (buf[0] | ((uLong)buf[1] << 8) | ((uLong)buf[2] << 16) |
+                ((uLong)buf[3] << 24)) ||
+            (total & 0xffffffff) != (buf[4] | ((uLong)buf[5] << 8) |
+                                     ((uLong)buf[6] << 16) |
+                                     ((uLong)buf[7] << 24)))
+        return Z_DATA_ERROR;
+    *pos += (z_off64_t)(head + used + 8);
+    return Z_OK;
+}
+
+/* Decompress the members of the gzip data in waves, writing them to fd. */
+local int gz_par_members(gz_statep state, int fd, gz_part *part,
+                         int threads) {
+    int ret = Z_OK, n, j;
+    unsigned got;
+    unsigned char head[2];
+    z_off64_t pos = 0, most = 0;
+    gz_wave wave;
+
+    wave.state = state;
+    wave.part = part;
+    for (;;) {
+        /* stop if there isn't another member, ignoring any trailing garbage
+           as gzread() does */
+        if (gz_pread(state, head, 2, pos, &got) == -1)
+            return Z_ERRNO;
+        if (got < 2 || head[0] != 31 || head[1] != 139)
+            return pos ? Z_OK : Z_DATA_ERROR;
+
+        /* decompress the member at pos and from the next possible headers,
+           looking ahead further for longer members */
+        part[0].in = pos;
+        n = gz_scan(state, part[0].buf, pos + 1, pos + (z_off64_t)threads *
+                    (most > GZPSCAN ? most : GZPSCAN), part + 1, threads - 1);
+        if (n == -1)
+            return Z_ERRNO;
+
+        /* with no other member in sight, try to split this one */
+        if (n == 0 && threads > 1 && state->map != NULL) {
+            ret = gz_par_spec(state, fd, part, threads, &pos);
+            if (ret == Z_OK)
+                continue;
+            if (ret != Z_STREAM_ERROR)
+                return ret;
+            ret = Z_OK;
+        }
+        par_run((unsigned)threads, (unsigned)n + 1, gz_part_member, &wave);
+
+        /* write the members that follow each other from pos, finishing a long
+           one here */
+        for (j = 0; j <= n && part[j].in <= pos; j++) {
+            if (part[j].in < pos)
+                continue;
+            ret = part[j].ret;
+            while (ret == Z_OK) {
+                if (gz_put_fd(fd, part[j].out, part[j].have) == -1)
+                    return Z_ERRNO;
+                if (part[j].done)
+                    break;
+                part[j].have = 0;
+                ret = gz_part_inflate(state, part + j, part[j].size);
+            }
+            if (ret != Z_OK)
+                return ret;
+            if (part[j].end - pos > most)
+                most = part[j].end - pos;
+            pos = part[j].end;
+        }
+    }
+}
+
+/* Decompress the gzip data from the access points of its index in waves,
+   writing it to fd and checking each member. */
+local int gz_par_index(gz_statep state, int fd, gz_part *part, int threads) {
+    int ret = Z_OK, k = 0, n, j;
+    uLong crc = 0;
+    z_off64_t len = 0, span;
+    unsigned char *out;
+    gz_index *index = state->index;
+    gz_wave wave;
+
+    wave.state = state;
+    wave.part = part;
+    while (k < index->have) {
+        for (n = 0; n < threads && k < index->have; n++, k++) {
+            part[n].point = index->list + k;
+            span = (k + 1 < index->have ? index->list[k + 1].out :
+                    index->length) - index->list[k].out;
+            if (span < 0 || (z_off64_t)(size_t)span != span)
+                return Z_DATA_ERROR;
+            part[n].len = (size_t)span;
+            part[n].last = k + 1 == index->have || index->list[k + 1].start;
+            if (part[n].size < part[n].len) {
+                out = (unsigned char *)realloc(part[n].out, part[n].len);
+                if (out == NULL)
+                    return Z_MEM_ERROR;
+                part[n].out = out;
+                part[n].size = part[n].len;
+            }
+        }
+        par_run((unsigned)threads, (unsigned)n, gz_part_point, &wave);
+        for (j = 0; j < n; j++) {
+            if (part[j].ret != Z_OK)
+                return part[j].ret;
+            crc = crc32_combine(crc, part[j].crc, (z_off_t)part[j].head);
+            len += (z_off64_t)part[j].head;
+            if (part[j].ended) {
+                if (crc != part[j].check || (len & 0xffffffff) != part[j].isize)
+                    return Z_DATA_ERROR;
+                crc = part[j].part;
+                len = (z_off64_t)part[j].tail;
+            }
+            if (gz_put_fd(fd, part[j].out, part[j].have) == -1)
+                return Z_ERRNO;
+        }
+    }
+    return ret;
+}
+
+/* -- see zlib.h -- */
+int ZEXPORT gzuncompressParallel(gzFile file, int fd, int threads) {
+    int ret, n;
+    gz_part *part;
+    gz_statep state;
+
+    /* get internal structure */
+    if (file == NULL || fd < 0)
+        return Z_STREAM_ERROR;
+    state = (gz_statep)file;
+
+    /* check that we're reading and that there's no error */
+    if (state->mode != GZ_READ ||
+            (state->err != Z_OK && state->err != Z_BUF_ERROR))
+        return Z_STREAM_ERROR;
+
+    /* start from the beginning of the file, and find out what's there */
+    if (gzrewind(file) == -1)
+        return Z_ERRNO;
+    if (gz_look(state) == -1)
+        return state->err;
+
+    /* copy data that isn't gzip on this thread */
+    if (state->how != GZIP) {
+        unsigned char *buf;
+
+        buf = (unsigned char *)malloc(GZBUFMAX);
+        if (buf == NULL)
+            return Z_MEM_ERROR;
+        ret = Z_OK;
+        while ((n = gzread(file, buf, GZBUFMAX)) > 0)
+            if (gz_put_fd(fd, buf, (size_t)n) == -1) {
+                ret = Z_ERRNO;
+                break;
+            }
+        if (n == -1)
+            ret = state->err;
+        free(buf);
+        if (gzrewind(file) == -1 && ret == Z_OK)
+            ret = Z_ERRNO;
+        return ret;
+    }
+
+    /* allocate an inflate engine and buffers for each thread */
+    if (threads <= 0)
+        threads = (int)par_cpus();
+#ifndef GZ_PREAD
+    if (state->map == NULL)
+        threads = 1;
+#endif
+    part = (gz_part *)calloc((unsigned)threads, sizeof(gz_part));
+    if (part == NULL)
+        return Z_MEM_ERROR;
+    ret = Z_OK;
+    for (n = 0; n < threads && ret == Z_OK; n++) {
+        part[n].strm.zalloc = Z_NULL;
+        part[n].strm.zfree = Z_NULL;
+        part[n].strm.opaque = Z_NULL;
+        part[n].strm.avail_in = 0;
+        part[n].strm.next_in = Z_NULL;
+        ret = inflateInit2(&part[n].strm, 15 + 16);
+        if (ret != Z_OK) {
+            part[n].strm.state = Z_NULL;
+            break;
+        }
+        if (state->map == NULL &&
+                (part[n].buf = (unsigned char *)malloc(GZBUFMAX)) == NULL)
+            ret = Z_MEM_ERROR;
+        if (state->index != NULL &&
+                (part[n].win = (unsigned char *)malloc(GZWINSIZE)) == NULL)
+            ret = Z_MEM_ERROR;
+    }
+
+    /* decompress, from the index if there is one */
+    if (ret == Z_OK)
+        ret = state->index != NULL ? gz_par_index(state, fd, part, threads) :
+                                     gz_par_members(state, fd, part, threads);
+    for (n = 0; n < threads; n++) {
+        if (part[n].strm.state != Z_NULL)
+            inflateEnd(&part[n].strm);
+        free(part[n].out);
+        free(part[n].win);
+        free(part[n].buf);
+    }
+    free(part);
+
+    /* return to the start of the file */
+    if (gzrewind(file) == -1 && ret == Z_OK)
+        ret = Z_ERRNO;
+    return ret;
+}
+
 /* -- see zlib.h -- */
 int ZEXPORT gzclose_r(gzFile file) {
     int ret, err;
@@ -684,6 +2231,10 @@ int ZEXPORT gzclose_r(gzFile file) {
         return Z_STREAM_ERROR;
 
     /* free memory and close file */
+    gz_async_end(state);
+    gz_unmap(state);
+    gz_index_free(state->index);
+    free(state->line);
     if (state->size) {
         if (state->size < 0 || state->size > INT_MAX) /* Check for integer overflow */
             return Z_STREAM_ERROR;
@@ -5,6 +5,113 @@
 
 #include "gzguts.h"
 
+/* Start keeping track of the blocks of a new gzip member, for block mode. */
+local void gz_begin(gz_statep state) {
+    state->left = state->block;
+    state->clen = 0;
+    state->ulen = 0;
+    state->nblocks = 0;
+}
+
+/* Write len bytes at buf to the output file, after the compressed data that
+   is already there.  Return -1 on a write error, otherwise 0. */
+local int gz_put_out(gz_statep state, const unsigned char *buf, unsigned len) {
+    int writ;
+
+    while (len) {
+        writ = write(state->fd, buf, len);
+        if (writ < 0) {
+            gz_error(state, Z_ERRNO, zstrerror());
+            return -1;
+        }
+        buf += writ;
+        len -= (unsigned)writ;
+    }
+    return 0;
+}
+
+/* Put n bytes of val at buf, least significant first. */
+local void gz_putle(unsigned char *buf, z_off64_t val, int n) {
+    while (n--) {
+        *buf++ = (unsigned char)(val & 0xff);
+        val >>= 8;
+    }
+}
+
+/* Note the offset in the member of the block starting now, in block mode.
+   Return -1 if out of memory, otherwise 0. */
+local int gz_block_add(gz_statep state) {
+    z_off64_t *blocks;
+
+    if (state->nblocks == state->maxblocks) {
+        if (state->maxblocks > UINT_MAX / 2 / sizeof(z_off64_t)) {
+            gz_error(state, Z_MEM_ERROR, "out of memory");
+            return -1;
+        }
+        state->maxblocks = state->maxblocks ? state->maxblocks << 1 : 64;
+        blocks = (z_off64_t *)realloc(state->blocks,
+                                      state->maxblocks * sizeof(z_off64_t));
+        if (blocks == NULL) {
+            gz_error(state, Z_MEM_ERROR, "out of memory");
+            return -1;
+        }
+        state->blocks = blocks;
+    }
+    state->blocks[state->nblocks++] = state->clen;
+    state->left = state->block;
+    return 0;
+}
+
+/* Write the list of blocks of the member just completed in block mode, as one
+   or more empty gzip members that follow it, each listing up to GZBLOCKS
+   blocks in its extra field.  The extra field has one subfield, with ID "ZI",
+   and its data is, all little-endian: the block size (4 bytes), the number of
+   the first block listed (4), the number of blocks listed, m (4), the offset
+   of each listed block from the start of the member (8 * m), the distance
+   back from the start of this empty member to the start of the member (8),
+   the uncompressed length of the member (8), and the length of this empty
+   member's gzip header (4).  Since the empty deflate stream and the trailer
+   take the ten bytes after that, gzindex_load() can find the lists by reading
+   backwards from the end of the file, without decompressing anything.
+   Return -1 on error, otherwise 0. */
+local int gz_block_index(gz_statep state) {
+    int ret = 0;
+    unsigned count, first, m, i, head;
+    z_off64_t back;
+    unsigned char *buf, *next;
+
+    buf = (unsigned char *)malloc(58 + 8 * GZBLOCKS);
+    if (buf == NULL) {
+        gz_error(state, Z_MEM_ERROR, "out of memory");
+        return -1;
+    }
+    count = state->nblocks + 1;
+    back = state->clen;
+    for (first = 0; first < count && ret == 0; first += m) {
+        m = count - first < GZBLOCKS ? count - first : GZBLOCKS;
+        head = 48 + 8 * m;
+        memcpy(buf, "\037\213\010\004\0\0\0\0\0\377", 10);
+        gz_putle(buf + 10, head - 12, 2);
+        buf[12] = 'Z';
+        buf[13] = 'I';
+        gz_putle(buf + 14, head - 16, 2);
+        gz_putle(buf + 16, state->block, 4);
+        gz_putle(buf + 20, first, 4);
+        gz_putle(buf + 24, m, 4);
+        next = buf + 28;
+        for (i = first; i < first + m; i++, next += 8)     /* 10: header */
+            gz_putle(next, i ? state->blocks[i - 1] : 10, 8);
+        gz_putle(next, back, 8);
+        gz_putle(next + 8, state->ulen, 8);
+        gz_putle(next + 16, head, 4);
+        memcpy(next + 20, "\003\0\0\0\0\0\0\0\0\0", 10);
+        ret = gz_put_out(state, buf, head + 10);
+        back += head + 10;
+    }
+    free(buf);
+    return ret;
+}
+
 /* Initialize state for writing a gzip file.  Mark initialization by setting
    state->size to non-zero.  Return -1 on a memory allocation failure, or 0 on
    success. */
@@ -12,6 +119,10 @@ local int gz_init(gz_statep state) {
     int ret;
     z_streamp strm = &(state->strm);
 
+    /* choose the buffer size if gzbuffer() didn't */
+    if (state->want == 0)
+        state->want = gz_autosize(state);
+
     /* allocate input buffer (double size for gzprintf) */
     state->in = (unsigned char *)malloc(state->want << 1);
     if (state->in == NULL) {
@@ -33,8 +144,9 @@ local int gz_init(gz_statep state) {
         strm->zalloc = Z_NULL;
         strm->zfree = Z_NULL;
         strm->opaque = Z_NULL;
-        ret = deflateInit2(strm, state->level, Z_DEFLATED,
-                           MAX_WBITS + 16, DEF_MEM_LEVEL, state->strategy);
+        ret = deflatePoolInit2(strm, z_stream_cache(), state->level,
+                               Z_DEFLATED, MAX_WBITS + 16, DEF_MEM_LEVEL,
+                               state->strategy);
         if (ret != Z_OK) {
             free(state->out);
             free(state->in);
@@ -46,6 +158,15 @@ local int gz_init(gz_statep state) {
 
     /* mark state as initialized */
     state->size = state->want;
+    gz_begin(state);
+
+    /* start the helper thread if requested, only needed if compressing */
+    if (state->async) {
+        if (state->direct)
+            state->async = 0;
+        else
+            gz_async_start(state);
+    }
 
     /* initialize write buffer if compressing */
     if (!state->direct) {
@@ -73,6 +194,8 @@ local int gz_comp(gz_statep state, int flush) {
 
     /* write directly if requested */
     if (state->direct) {
+        if (gz_async_wait(state) == -1)
+            return -1;
         while (strm->avail_in) {
             put = strm->avail_in > max ? max : strm->avail_in;
             if ((unsigned)(strm->next_in + put) < (unsigned)strm->next_in) {
@@ -101,8 +224,26 @@ local int gz_comp(gz_statep state, int flush) {
             return 0;
         deflateReset(strm);
         state->reset = 0;
+        gz_begin(state);
     }
 
+    /* in block mode, end each block of state->block bytes with a full flush,
+       so that decompression can start at the next one without a dictionary */
+    if (state->block) {
+        while (strm->avail_in > state->left) {
+            unsigned more = strm->avail_in - state->left;
+
+            strm->avail_in = state->left;
+            if (gz_comp(state, Z_FULL_FLUSH) == -1)
+                return -1;
+            strm->avail_in = more;
+            if (gz_block_add(state) == -1)
+                return -1;
+        }
+        state->left -= strm->avail_in;
+    }
+    state->ulen += strm->avail_in;
+
     /* run deflate() on provided input until it produces no more output */
     ret = Z_OK;
     do {
@@ -110,6 +251,8 @@ local int gz_comp(gz_statep state, int flush) {
            doing Z_FINISH then don't write until we get to Z_STREAM_END */
         if (strm->avail_out == 0 || (flush != Z_NO_FLUSH &&
             (flush != Z_FINISH || ret == Z_STREAM_END))) {
+            if (state->async && gz_async_write(state) == -1)
+                return -1;
             while (strm->next_out > state->x.next) {
                 if ((unsigned)(strm->next_out - state->x.next) > (unsigned)(int)max) {
                     put = max;
@@ -151,11 +294,21 @@ local int gz_comp(gz_statep state, int flush) {
             return -1;
         }
         have -= strm->avail_out;
+        state->clen += have;
+        Probe2(gz_comp, flush, have);
     } while (have);
 
-    /* if that completed a deflate stream, allow another to start */
-    if (flush == Z_FINISH)
+    /* if flushing, make sure that the data has made it to the file */
+    if (flush != Z_NO_FLUSH && state->async && gz_async_wait(state) == -1)
+        return -1;
+
+    /* if that completed a deflate stream, list its blocks in block mode, and
+       allow another to start */
+    if (flush == Z_FINISH) {
+        if (state->block && gz_block_index(state) == -1)
+            return -1;
         state->reset = 1;
+    }
 
     /* all done, no errors */
     return 0;
@@ -191,6 +344,35 @@ local int gz_zero(gz_statep state, z_off64_t len) {
     return 0;
 }
 
+/* Compress len bytes from buf directly, after whatever is in the input
+   buffer, without copying them to the input buffer.  Return -1 on error, or 0
+   on success. */
+local int gz_direct(gz_statep state, voidpc buf, z_size_t len) {
+    /* consume whatever's left in the input buffer */
+    if (state->strm.avail_in && gz_comp(state, Z_NO_FLUSH) == -1)
+        return -1;
+
+    /* directly compress user buffer to file */
+    state->strm.next_in = (z_const Bytef *)buf;
+    do {
+        unsigned n = (unsigned)-1;
+        if (n > len)
+            n = (unsigned)len;
+
+        state->strm.avail_in = n;
+        state->x.pos += n;
+        if (state->x.pos < n) { // Check for overflow
+            return -1;
+        }
+
+        if (gz_comp(state, Z_NO_FLUSH) == -1)
+            return -1;
+
+        len -= n;
+    } while (len);
+    return 0;
+}
+
 /* Write len bytes from buf to file.  Return the number of bytes written.  If
    the returned value is less than len, then there was an error. */
 local z_size_t gz_write(gz_statep state, voidpc buf, z_size_t len) {
@@ -248,30 +430,8 @@ local z_size_t gz_write(gz_statep state, voidpc buf, z_size_t len) {
                 return 0;
         } while (len);
     }
-    else {
-        /* consume whatever's left in the input buffer */
-        if (state->strm.avail_in && gz_comp(state, Z_NO_FLUSH) == -1)
-            return 0;
-
-        /* directly compress user buffer to file */
-        state->strm.next_in = (z_const Bytef *)buf;
-        do {
-            unsigned n = (unsigned)-1;
-            if (n > len)
-                n = (unsigned)len;
-
-            state->strm.avail_in = n;
-            state->x.pos += n;
-            if (state->x.pos < n) { // Check for overflow
-                return 0;
-            }
-
-            if (gz_comp(state, Z_NO_FLUSH) == -1)
-                return 0;
-
-            len -= n;
-        } while (len);
-    }
+    else if (gz_direct(state, buf, len) == -1)
+        return 0;
 
     /* input was all buffered or compressed */
     return put;
@@ -326,6 +486,67 @@ z_size_t ZEXPORT gzfwrite(voidpc buf, z_size_t size, z_size_t nitems,
     return len ? gz_write(state, buf, len) / size : 0;
 }
 
+/* -- see zlib.h -- */
+z_size_t ZEXPORT gzwritev(gzFile file, const z_iovec *iov, unsigned count) {
+    unsigned i;
+    z_size_t len, put = 0;
+    gz_statep state;
+
+    /* get internal structure */
+    if (file == NULL)
+        return 0;
+    state = (gz_statep)file;
+
+    /* check that we're writing and that there's no error */
+    if (state->mode != GZ_WRITE || state->err != Z_OK)
+        return 0;
+
+    /* check the fragments, and that their total fits in a z_size_t */
+    if (iov == NULL && count)
+        return 0;
+    for (i = 0; i < count; i++) {
+        if (iov[i].base == NULL && iov[i].len) {
+            gz_error(state, Z_STREAM_ERROR, "iov fragment has no data");
+            return 0;
+        }
+        len = put + iov[i].len;
+        if (len < put) {
+            gz_error(state, Z_STREAM_ERROR, "request does not fit in a size_t");
+            return 0;
+        }
+        put = len;
+    }
+    if (put == 0)
+        return 0;
+
+    /* allocate memory if this is the first time through */
+    if (state->size == 0 && gz_init(state) == -1)
+        return 0;
+
+    /* check for seek request */
+    if (state->seek) {
+        state->seek = 0;
+        if (gz_zero(state, state->skip) == -1)
+            return 0;
+    }
+
+    /* give deflate() each fragment where it is, except that small ones are
+       gathered in the input buffer, since each deflate() call costs more than
+       copying a few bytes */
+    for (i = 0; i < count; i++) {
+        len = iov[i].len;
+        if (len == 0)
+            continue;
+        if (len < GZIOVMIN && len < state->size) {
+            if (gz_write(state, iov[i].base, len) != len)
+                return 0;
+        }
+        else if (gz_direct(state, iov[i].base, len) == -1)
+            return 0;
+    }
+    return put;
+}
+
 /* -- see zlib.h -- */
 int ZEXPORT gzputc(gzFile file, int c) {
     unsigned have;
@@ -644,7 +865,7 @@ int ZEXPORT gzsetparams(gzFile file, int level, int strategy) {
         return Z_STREAM_ERROR;
 
     /* check for valid compression level and strategy */
-    if (level < Z_NO_COMPRESSION || level > Z_BEST_COMPRESSION)
+    if (level < Z_NO_COMPRESSION || level > Z_OPTIMAL_COMPRESSION)
         return Z_STREAM_ERROR;
     if (strategy < Z_DEFAULT_STRATEGY || strategy > Z_FIXED)
         return Z_STREAM_ERROR;
@@ -663,9 +884,18 @@ int ZEXPORT gzsetparams(gzFile file, int level, int strategy) {
     /* change compression parameters for subsequent input */
     if (state->size) {
         /* flush previous input with previous parameters before changing */
+        unsigned have;
+        int ret;
+
         if (strm->avail_in && gz_comp(state, Z_BLOCK) == -1)
             return state->err;
-        deflateParams(strm, level, strategy);
+        have = strm->avail_out;
+        ret = deflateParams(strm, level, strategy);
+        state->clen += have - strm->avail_out;
+        if (ret == Z_MEM_ERROR) {
+            gz_error(state, Z_MEM_ERROR, "out of memory");
+            return state->err;
+        }
     }
     state->level = level;
     state->strategy = strategy;
@@ -698,14 +928,16 @@ int ZEXPORT gzclose_w(gzFile file) {
     /* flush, free memory, and close file */
     if (gz_comp(state, Z_FINISH) == -1)
         ret = state->err;
+    gz_async_end(state);
     if (state->size) {
         if (!state->direct) {
-            if (deflateEnd(&(state->strm)) != Z_OK)
+            if (deflatePoolEnd(&(state->strm), z_stream_cache()) != Z_OK)
                 ret = Z_STREAM_ERROR;
             free(state->out);
         }
         free(state->in);
     }
+    free(state->blocks);
     gz_error(state, Z_OK, NULL);
     free(state->path);
     if (close(state->fd) == -1)
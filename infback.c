@@ -60,6 +60,8 @@ int ZEXPORT inflateBackInit_(z_streamp strm, int windowBits,
     state->wnext = 0;
     state->whave = 0;
     state->sane = 1;
+    state->slack = 0;
+    state->def64 = 0;
     return Z_OK;
 }
 
@@ -155,11 +157,36 @@ local void fixedtables(struct inflate_state FAR *state) {
     } while (0)
 
 /* Assure that some input is available.  If input is requested, but denied,
-   then return a Z_BUF_ERROR from inflateBack(). */
+   then return a Z_BUF_ERROR from inflateBack().  For inflateBackRing(), the
+   input is taken from the fragments at vec, up to what fits in have at a
+   time, and the output so far is written out before in() is called for more
+   fragments. */
 #define PULL() \
     do { \
         if (have == 0) { \
-            have = in(in_desc, &next); \
+            if (vin != Z_NULL) { \
+                while (vecs && vec->len == 0) { \
+                    vec++; \
+                    vecs--; \
+                } \
+                if (vecs == 0) { \
+                    SPAN(); \
+                    vecs = vin(in_desc, &vec); \
+                    while (vecs && vec->len == 0) { \
+                        vec++; \
+                        vecs--; \
+                    } \
+                } \
+                if (vecs) { \
+                    have = vec->len < (unsigned)-1 ? (unsigned)vec->len : \
+                                                     (unsigned)-1; \
+                    next = (z_const unsigned char FAR *)vec->base; \
+                    vec->base = (unsigned char FAR *)vec->base + have; \
+                    vec->len -= have; \
+                } \
+            } \
+            else \
+                have = in(in_desc, &next); \
             if (have == 0) { \
                 next = Z_NULL; \
                 ret = Z_BUF_ERROR; \
@@ -206,15 +233,31 @@ local void fixedtables(struct inflate_state FAR *state) {
     } while (0)
 
 /* Assure that some output space is available, by writing out the window
-   if it's full.  If the write fails, return from inflateBack() with a
-   Z_BUF_ERROR. */
+   from done if it's full.  If the write fails, return from inflateBack()
+   with a Z_BUF_ERROR. */
 #define ROOM() \
     do { \
         if (left == 0) { \
+            unsigned char FAR *span = done; \
             put = state->window; \
+            done = put; \
             left = state->wsize; \
             state->whave = left; \
-            if (out(out_desc, put, left)) { \
+            if (out(out_desc, span, (unsigned)(put + left - span))) { \
+                ret = Z_BUF_ERROR; \
+                goto inf_leave; \
+            } \
+        } \
+    } while (0)
+
+/* Write out the output from done to put, if any.  If the write fails, return
+   from inflateBack() with a Z_BUF_ERROR. */
+#define SPAN() \
+    do { \
+        if (put != done) { \
+            unsigned char FAR *span = done; \
+            done = put; \
+            if (out(out_desc, span, (unsigned)(put - span))) { \
                 ret = Z_BUF_ERROR; \
                 goto inf_leave; \
             } \
@@ -247,12 +290,23 @@ local void fixedtables(struct inflate_state FAR *state) {
    error, or Z_MEM_ERROR if it could not allocate memory for the state.
    inflateBack() can also return Z_STREAM_ERROR if the input parameters
    are not correct, i.e. strm is Z_NULL or the state was not initialized.
+
+   inflate_back() does the work for both inflateBack() and inflateBackRing().
+   Exactly one of in and vin is not Z_NULL.  The output is written to the
+   size bytes at ring, which is used as the window in place of the one
+   provided to inflateBackInit() for this call.
  */
-int ZEXPORT inflateBack(z_streamp strm, in_func in, void FAR *in_desc,
-                        out_func out, void FAR *out_desc) {
+local int inflate_back(z_streamp strm, in_func in, in_vec_func vin,
+                       void FAR *in_desc, out_func out, void FAR *out_desc,
+                       unsigned char FAR *ring, unsigned size) {
     struct inflate_state FAR *state;
     z_const unsigned char FAR *next;    /* next input */
+    z_iovec FAR *vec;           /* input fragment for inflateBackRing() */
+    unsigned vecs;              /* fragments left at vec */
+    unsigned char FAR *window;  /* window from inflateBackInit() */
+    unsigned wsize;             /* its size */
     unsigned char FAR *put;     /* next output */
+    unsigned char FAR *done;    /* output not yet written out starts here */
     unsigned have, left;        /* available input and output */
     unsigned long hold;         /* bit buffer */
     unsigned bits;              /* bits in bit buffer */
@@ -265,21 +319,24 @@ int ZEXPORT inflateBack(z_streamp strm, in_func in, void FAR *in_desc,
     static const unsigned short order[19] = /* permutation of code lengths */
         {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
 
-    /* Check that the strm exists and that the state was initialized */
-    if (strm == Z_NULL || strm->state == Z_NULL)
-        return Z_STREAM_ERROR;
+    /* Reset the state, using ring as the window */
     state = (struct inflate_state FAR *)strm->state;
-
-    /* Reset the state */
+    window = state->window;
+    wsize = state->wsize;
+    state->window = ring;
+    state->wsize = size;
     strm->msg = Z_NULL;
     state->mode = TYPE;
     state->last = 0;
     state->whave = 0;
     next = strm->next_in;
     have = next != Z_NULL ? strm->avail_in : 0;
+    vec = Z_NULL;
+    vecs = 0;
     hold = 0;
     bits = 0;
     put = state->window;
+    done = put;
     left = state->wsize;
 
     /* Inflate until end of block marked as last */
@@ -623,18 +680,49 @@ int ZEXPORT inflateBack(z_streamp strm, in_func in, void FAR *in_desc,
             goto inf_leave;
         }
 
-    /* Write leftover output and return unused input */
+    /* Write leftover output and return unused input, giving back the unused
+       part of the current fragment */
   inf_leave:
-    if (left < state->wsize) {
-        if (out(out_desc, state->window, state->wsize - left) &&
+    if (put != done) {
+        if (out(out_desc, done, (unsigned)(put - done)) &&
             ret == Z_STREAM_END)
             ret = Z_BUF_ERROR;
     }
+    if (vec != Z_NULL && have) {
+        vec->base = (voidp)next;
+        vec->len += have;
+    }
     strm->next_in = next;
     strm->avail_in = have;
+    state->window = window;
+    state->wsize = wsize;
     return ret;
 }
 
+int ZEXPORT inflateBack(z_streamp strm, in_func in, void FAR *in_desc,
+                        out_func out, void FAR *out_desc) {
+    struct inflate_state FAR *state;
+
+    /* Check that the strm exists and that the state was initialized */
+    if (strm == Z_NULL || strm->state == Z_NULL)
+        return Z_STREAM_ERROR;
+    state = (struct inflate_state FAR *)strm->state;
+    return inflate_back(strm, in, Z_NULL, in_desc, out, out_desc,
+                        state->window, state->wsize);
+}
+
+int ZEXPORT inflateBackRing(z_streamp strm, in_vec_func in, void FAR *in_desc,
+                            out_func out, void FAR *out_desc,
+                            unsigned char FAR *ring, unsigned size) {
+    /* Check that the strm exists, that the state was initialized, and that
+       the ring can hold a full window */
+    if (strm == Z_NULL || strm->state == Z_NULL || in == Z_NULL ||
+        ring == Z_NULL || size < 32768U)
+        return Z_STREAM_ERROR;
+    return inflate_back(strm, Z_NULL, in, in_desc, out, out_desc,
+                        ring, size);
+}
+
 int ZEXPORT inflateBackEnd(z_streamp strm) {
     if (strm == Z_NULL || strm->state == Z_NULL || strm->zfree == (free_func)0)
         return Z_STREAM_ERROR;
@@ -12,6 +12,146 @@
 #  pragma message("Assembler code may have bugs -- use at your own risk")
 #else
 
+/*
+   Match copies from the output are done INFLATE_CHUNK bytes at a time with
+   fixed-size memcpy() calls, which compilers turn into single wide loads and
+   stores, when there is room in the output buffer (plus any slack promised with
+   inflateSlack()) for chunk_copy() to write past the end of the match.  The
+   bytes written past the end of a match are overwritten by later output, or
+   are left as undefined contents of the unused output buffer.
+ */
+#ifdef HAVE_MEMCPY
+#  if defined(__AVX__)
+#    define INFLATE_CHUNK 32
+#  elif defined(__SSE2__) || defined(_M_X64) || defined(__ARM_NEON)
+#    define INFLATE_CHUNK 16
+#  else
+#    define INFLATE_CHUNK 8
+#  endif
+#endif
+
+#ifdef INFLATE_CHUNK
+/*
+   Copy len bytes to out from dist bytes back, and return out + len.  This can
+   write up to INFLATE_CHUNK - 1 bytes past out + len.  A distance less than
+   INFLATE_CHUNK is first doubled, by copying the repeating pattern after
+   itself, until it is at least INFLATE_CHUNK or the copy is done.  So no copy
+   here has overlapping source and destination.
+ */
+local unsigned char FAR *chunk_copy(unsigned char FAR *out, unsigned dist,
+                                    unsigned len) {
+    unsigned char FAR *end = out + len;
+
+    while (dist < INFLATE_CHUNK) {
+        if (len <= dist) {
+            zmemcpy(out, out - dist, len);
+            return end;
+        }
+        zmemcpy(out, out - dist, dist);
+        out += dist;
+        len -= dist;
+        dist <<= 1;
+    }
+    for (;;) {
+        zmemcpy(out, out - dist, INFLATE_CHUNK);
+        if (len <= INFLATE_CHUNK)
+            break;
+        out += INFLATE_CHUNK;
+        len -= INFLATE_CHUNK;
+    }
+    return end;
+}
+#endif
+
+/*
+   On 64-bit little-endian processors, hold is refilled with eight bytes at a
+   time, whenever there are at least eight bytes of input left.  That leaves at
+   least 56 bits in hold.  56 bits is enough for a whole length/distance pair,
+   or for three or more literals, before the next refill.  The refill can also
+   load bits into hold above the count in bits.  Those are the correct next
+   input bits, so the byte-at-a-time refills use |= instead of +=, which gives
+   the same result.
+ */
+#if defined(Z_U8) && defined(HAVE_MEMCPY) && \
+    (defined(__x86_64__) || defined(_M_X64) || \
+     (defined(__aarch64__) && defined(__AARCH64EL__)))
+#  define INFLATE_HOLD64
+   typedef Z_U8 hold_t;
+#  define REFILL() \
+    do { \
+        hold_t word; \
+        zmemcpy((Bytef *)&word, in, sizeof(word)); \
+        hold |= word << bits; \
+        in += (63 - bits) >> 3; \
+        bits |= 56; \
+    } while (0)
+#else
+   typedef unsigned long hold_t;
+#endif
+
+/*
+   On x86-64 processors with AVX-512BW and BMI2, found at run time, a copy of
+   inflate_fast() compiled for those extensions is used.  The compiler uses the
+   BMI2 shrx and bzhi instructions to take codes and extra bits from hold.
+   Matches longer than 32 bytes at distances of 64 or more are copied 64 bytes
+   at a time.  Shorter matches still use chunk_copy(), since the wider stores
+   measured slower for them, by defeating store-to-load forwarding to the next
+   match.  Near the end of the output, where there is no room for chunk_copy()
+   to write past the match, wide_copy() masks its last store to the bytes of
+   the match instead of falling back to copying a byte at a time.  Define
+   NO_INFLATE_WIDE to not use any of this.
+ */
+#if defined(INFLATE_HOLD64) && defined(INFLATE_CHUNK) && defined(__x86_64__) && \
+    !defined(NO_INFLATE_WIDE)
+#  if (defined(__clang__) && __clang_major__ >= 6) || \
+      (!defined(__clang__) && defined(__GNUC__) && __GNUC__ >= 8)
+#    define INFLATE_WIDE
+#  endif
+#endif
+
+#ifdef INFLATE_WIDE
+
+#include <immintrin.h>
+
+#define WIDE __attribute__((target("avx512f,avx512bw,bmi2")))
+
+/* Copy len bytes to out from dist bytes back, writing nothing past out + len,
+   and return out + len.  The source and destination of each load and store
+   do not overlap. */
+local WIDE unsigned char FAR *wide_copy(unsigned char FAR *out, unsigned dist,
+                                        unsigned len) {
+    unsigned char FAR *end = out + len;
+    __mmask64 mask;
+
+    while (dist < 64) {
+        mask = _bzhi_u64(~(Z_U8)0, len < dist ? len : dist);
+        _mm512_mask_storeu_epi8(out, mask,
+                                _mm512_maskz_loadu_epi8(mask, out - dist));
+        if (len <= dist)
+            return end;
+        out += dist;
+        len -= dist;
+        dist <<= 1;
+    }
+    while (len > 64) {
+        _mm512_storeu_si512((void *)out,
+                            _mm512_loadu_si512((const void *)(out - dist)));
+        out += 64;
+        len -= 64;
+    }
+    mask = _bzhi_u64(~(Z_U8)0, len);
+    _mm512_mask_storeu_epi8(out, mask,
+                            _mm512_maskz_loadu_epi8(mask, out - dist));
+    return end;
+}
+
+/* The decoder below is compiled twice, once for the wide processors with vec
+   set to one, so it must be inlined into each. */
+#  define FAST_BODY local __inline__ __attribute__((always_inline)) void
+#else
+#  define FAST_BODY local void
+#endif
+
 /*
    Decode literal, length, and distance codes and write out the resulting
    literal and match bytes until either not enough input or output is
@@ -23,7 +163,7 @@
    Entry assumptions:
 
         state->mode == LEN
-        strm->avail_in >= 6
+        strm->avail_in >= 6 (7 for Deflate64)
         strm->avail_out >= 258
         start >= strm->avail_out
         state->bits < 8
@@ -40,20 +180,29 @@
       length code, 5 bits for the length extra, 15 bits for the distance code,
       and 13 bits for the distance extra.  This totals 48 bits, or six bytes.
       Therefore if strm->avail_in >= 6, then there is enough input to avoid
-      checking for available input while decoding.
+      checking for available input while decoding.  Deflate64 has 14-bit
+      distance extras, for 49 bits or seven bytes.  Its length code 285 takes
+      16 extra bits, which are left to inflate() to decode.
 
     - The maximum bytes that a single length/distance pair can output is 258
       bytes, which is the maximum length that can be coded.  inflate_fast()
       requires strm->avail_out >= 258 for each loop to avoid checking for
       output space.
  */
-void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start) {
+FAST_BODY inflate_fast_body(z_streamp strm, unsigned start, int vec) {
     struct inflate_state FAR *state;
     z_const unsigned char FAR *in;      /* local strm->next_in */
     z_const unsigned char FAR *last;    /* have enough input while in < last */
+    unsigned margin;            /* input bytes kept back from last, less one */
+#ifdef INFLATE_HOLD64
+    z_const unsigned char FAR *wide;    /* can refill eight bytes if in < wide */
+#endif
     unsigned char FAR *out;     /* local strm->next_out */
     unsigned char FAR *beg;     /* inflate()'s initial strm->next_out */
     unsigned char FAR *end;     /* while out < end, enough space available */
+#ifdef INFLATE_CHUNK
+    unsigned char FAR *limit;   /* end of output writable by chunk_copy() */
+#endif
 #ifdef INFLATE_STRICT
     unsigned dmax;              /* maximum distance from zlib header */
 #endif
@@ -61,13 +210,17 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start) {
     unsigned whave;             /* valid bytes in the window */
     unsigned wnext;             /* window write index */
     unsigned char FAR *window;  /* allocated sliding window, if wsize != 0 */
-    unsigned long hold;         /* local strm->hold */
+    hold_t hold;                /* local strm->hold */
     unsigned bits;              /* local strm->bits */
     code const FAR *lcode;      /* local strm->lencode */
     code const FAR *dcode;      /* local strm->distcode */
     unsigned lmask;             /* mask for first level of length codes */
     unsigned dmask;             /* mask for first level of distance codes */
     code const *here;           /* retrieved table entry */
+#ifdef INFLATE_HOLD64
+    code look;                  /* next length/literal code, if ahead */
+    int ahead;                  /* true if look is the next code */
+#endif
     unsigned op;                /* code bits, operation, extra bits, or */
                                 /*  window position, window bytes to copy */
     unsigned len;               /* match length, unused bytes */
@@ -77,10 +230,17 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start) {
     /* copy state to local variables */
     state = (struct inflate_state FAR *)strm->state;
     in = strm->next_in;
-    last = in + (strm->avail_in - 5);
+    margin = state->def64 ? 6 : 5;
+    last = in + (strm->avail_in - margin);
+#ifdef INFLATE_HOLD64
+    wide = strm->avail_in >= 8 ? in + (strm->avail_in - 7) : in;
+#endif
     out = strm->next_out;
     beg = out - (start - strm->avail_out);
     end = out + (strm->avail_out - 257);
+#ifdef INFLATE_CHUNK
+    limit = out + strm->avail_out + state->slack;
+#endif
 #ifdef INFLATE_STRICT
     dmax = state->dmax;
 #endif
@@ -97,11 +257,24 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start) {
 
     /* decode literals and length/distances until end-of-block or not enough
        input data or output space */
+#ifdef INFLATE_HOLD64
+    ahead = 0;
+#endif
     do {
+#ifdef INFLATE_HOLD64
+        if (ahead) {
+            ahead = 0;
+            here = &look;
+            goto dolen;
+        }
+        if (in < wide)
+            REFILL();
+        else
+#endif
         if (bits < 15) {
-            hold += (unsigned long)(*in++) << bits;
+            hold |= (hold_t)(*in++) << bits;
             bits += 8;
-            hold += (unsigned long)(*in++) << bits;
+            hold |= (hold_t)(*in++) << bits;
             bits += 8;
         }
         here = lcode + (hold & lmask);
@@ -114,6 +287,7 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start) {
             Tracevv((stderr, here->val >= 0x20 && here->val < 0x7f ?
                     "inflate:         literal '%c'\n" :
                     "inflate:         literal 0x%02x\n", here->val));
+            Stat(state->stats.literals++);
             *out++ = (unsigned char)(here->val);
         }
         else if (op & 16) {                     /* length base */
@@ -121,18 +295,25 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start) {
             op &= 15;                           /* number of extra bits */
             if (op) {
                 if (bits < op) {
-                    hold += (unsigned long)(*in++) << bits;
+                    hold |= (hold_t)(*in++) << bits;
                     bits += 8;
                 }
                 len += (unsigned)hold & ((1U << op) - 1);
                 hold >>= op;
                 bits -= op;
             }
+            else if (len == 0) {                /* Deflate64 length 285 */
+                state->length = 3;
+                state->extra = 16;
+                state->back = 0;
+                state->mode = LENEXT;
+                break;
+            }
             Tracevv((stderr, "inflate:         length %u\n", len));
             if (bits < 15) {
-                hold += (unsigned long)(*in++) << bits;
+                hold |= (hold_t)(*in++) << bits;
                 bits += 8;
-                hold += (unsigned long)(*in++) << bits;
+                hold |= (hold_t)(*in++) << bits;
                 bits += 8;
             }
             here = dcode + (hold & dmask);
@@ -145,10 +326,10 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start) {
                 dist = (unsigned)(here->val);
                 op &= 15;                       /* number of extra bits */
                 if (bits < op) {
-                    hold += (unsigned long)(*in++) << bits;
+                    hold |= (hold_t)(*in++) << bits;
                     bits += 8;
                     if (bits < op) {
-                        hold += (unsigned long)(*in++) << bits;
+                        hold |= (hold_t)(*in++) << bits;
                         bits += 8;
                     }
                 }
@@ -163,6 +344,16 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start) {
                 hold >>= op;
                 bits -= op;
                 Tracevv((stderr, "inflate:         distance %u\n", dist));
+                Stat(state->stats.matches++; state->stats.match_bytes += len);
+#ifdef INFLATE_HOLD64
+                /* look up the next code now, so that the load is not held
+                   up by branches in the copy */
+                if (in < wide) {
+                    REFILL();
+                    look = lcode[hold & lmask];
+                    ahead = 1;
+                }
+#endif
                 op = (unsigned)(out - beg);     /* max distance in output */
                 if (dist > op) {                /* see if copy from window */
                     op = dist - op;             /* distance back in window */
@@ -201,7 +392,7 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start) {
                             do {
                                 *out++ = *from++;
                             } while (--op);
-                            from = out - dist;  /* rest from output */
+                            goto direct;        /* rest from output */
                         }
                     }
                     else if (wnext < op) {      /* wrap around window */
@@ -219,7 +410,7 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start) {
                                 do {
                                     *out++ = *from++;
                                 } while (--op);
-                                from = out - dist;      /* rest from output */
+                                goto direct;            /* rest from output */
                             }
                         }
                     }
@@ -230,7 +421,7 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start) {
                             do {
                                 *out++ = *from++;
                             } while (--op);
-                            from = out - dist;  /* rest from output */
+                            goto direct;        /* rest from output */
                         }
                     }
                     while (len > 2) {
@@ -246,13 +437,40 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start) {
                     }
                 }
                 else {
+                  direct:
+#ifdef INFLATE_WIDE
+                    if (vec && len > 32 && dist >= 64 &&
+                        (unsigned)(limit - out) >= len + 64) {
+                        from = out - dist;
+                        for (;;) {
+                            zmemcpy(out, from, 64);
+                            if (len <= 64)
+                                break;
+                            out += 64;
+                            from += 64;
+                            len -= 64;
+                        }
+                        out += len;
+                        continue;
+                    }
+                    if (vec && (unsigned)(limit - out) < len + INFLATE_CHUNK) {
+                        out = wide_copy(out, dist, len);
+                        continue;
+                    }
+#endif
+#ifdef INFLATE_CHUNK
+                    if ((unsigned)(limit - out) >= len + INFLATE_CHUNK) {
+                        out = chunk_copy(out, dist, len);
+                        continue;
+                    }
+#endif
                     from = out - dist;          /* copy direct from output */
-                    do {                        /* minimum length is three */
+                    while (len > 2) {
                         *out++ = *from++;
                         *out++ = *from++;
                         *out++ = *from++;
                         len -= 3;
-                    } while (len > 2);
+                    }
                     if (len) {
                         *out++ = *from++;
                         if (len > 1)
@@ -298,14 +516,53 @@ void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start) {
     /* update state and return */
     strm->next_in = in;
     strm->next_out = out;
-    strm->avail_in = (unsigned)(in < last ? 5 + (last - in) : 5 - (in - last));
+    strm->avail_in = (unsigned)(in < last ? margin + (last - in) :
+                                margin - (in - last));
     strm->avail_out = (unsigned)(out < end ?
                                  257 + (end - out) : 257 - (out - end));
-    state->hold = hold;
+    state->hold = (unsigned long)hold;
     state->bits = bits;
+    (void)vec;
     return;
 }
 
+#ifdef INFLATE_WIDE
+
+local WIDE void inflate_fast_wide(z_streamp strm, unsigned start) {
+    inflate_fast_body(strm, start, 1);
+}
+
+local void inflate_fast_std(z_streamp strm, unsigned start) {
+    inflate_fast_body(strm, start, 0);
+}
+
+/* Decoder selected by inflate_fast_init().  As for the kernels in adler32.c
+   and crc32.c, there is no harm if more than one thread selects at once. */
+local void (*inflate_fast_sel)(z_streamp, unsigned) = inflate_fast_std;
+local volatile int inflate_fast_done;
+
+local void inflate_fast_init(void) {
+    unsigned need = Z_CPU_AVX512 | Z_CPU_AVX512BW | Z_CPU_BMI2;
+
+    if ((z_cpu_features() & need) == need)
+        inflate_fast_sel = inflate_fast_wide;
+    inflate_fast_done = 1;
+}
+
+void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start) {
+    if (!inflate_fast_done)
+        inflate_fast_init();
+    inflate_fast_sel(strm, start);
+}
+
+#else
+
+void ZLIB_INTERNAL inflate_fast(z_streamp strm, unsigned start) {
+    inflate_fast_body(strm, start, 0);
+}
+
+#endif
+
 /*
    inflate_fast() speedups that turned out slower (on a PowerPC G3 750CXe):
    - Using bit fields for code structure
@@ -103,6 +103,61 @@ local int inflateStateCheck(z_streamp strm) {
     return 0;
 }
 
+/* Take the stream back from the backend of inflateOffload(), if it has it. */
+local void inflate_unload(struct inflate_state FAR *state) {
+    if (state->offloaded > 0 && state->offload.end != Z_NULL)
+        state->offload.end(state->offload.opaque, state->strm);
+    state->offloaded = 0;
+}
+
+/*
+   Give the state a window and wide table space of its own if it shares them
+   with states from inflateFork(), before either is written.  The last of the
+   sharing states keeps them.  Return true if the copy could not be allocated.
+ */
+local int inflate_unshare(z_streamp strm) {
+    struct inflate_state FAR *state;
+    unsigned char FAR *window;
+    code FAR *wide;
+
+    state = (struct inflate_state FAR *)strm->state;
+    if (state->share == Z_NULL) return 0;
+    if (*state->share == 1) {
+        ZFREE(strm, state->share);
+        state->share = Z_NULL;
+        return 0;
+    }
+    window = Z_NULL;
+    if (state->window != Z_NULL) {
+        window = (unsigned char FAR *)
+                 ZALLOC(strm, 1U << state->wbits, sizeof(unsigned char));
+        if (window == Z_NULL) return 1;
+        zmemcpy(window, state->window, 1U << state->wbits);
+    }
+    wide = Z_NULL;
+    if (state->wide != Z_NULL) {
+        wide = (code FAR *)ZALLOC(strm, ENOUGH_WIDE, sizeof(code));
+        if (wide == Z_NULL) {
+            if (window != Z_NULL) ZFREE(strm, window);
+            return 1;
+        }
+        zmemcpy((voidpf)wide, (voidpf)state->wide, ENOUGH_WIDE * sizeof(code));
+        if (state->lencode >= state->wide &&
+            state->lencode <= state->wide + ENOUGH_WIDE - 1) {
+            state->lencode = wide + (state->lencode - state->wide);
+            state->distcode = wide + (state->distcode - state->wide);
+        }
+        if (state->next >= state->wide &&
+            state->next <= state->wide + ENOUGH_WIDE)
+            state->next = wide + (state->next - state->wide);
+    }
+    (*state->share)--;
+    state->share = Z_NULL;
+    state->window = window;
+    state->wide = wide;
+    return 0;
+}
+
 int ZEXPORT inflateResetKeep(z_streamp strm) {
     struct inflate_state FAR *state;
 
@@ -129,6 +184,10 @@ int ZEXPORT inflateResetKeep(z_streamp strm) {
     state->lencode = state->distcode = state->next = state->codes;
     state->sane = 1;
     state->back = -1;
+    inflate_unload(state);
+#ifdef ZLIB_STATS
+    zmemzero((Bytef *)&state->stats, sizeof(z_stats));
+#endif
     Tracev((stderr, "inflate: reset\n"));
     return Z_OK;
 }
@@ -147,19 +206,21 @@ int ZEXPORT inflateReset(z_streamp strm) {
 }
 
 int ZEXPORT inflateReset2(z_streamp strm, int windowBits) {
-    int wrap;
+    int wrap, def64;
     struct inflate_state FAR *state;
 
     /* get the state */
     if (inflateStateCheck(strm)) return Z_STREAM_ERROR;
     state = (struct inflate_state FAR *)strm->state;
 
-    /* extract wrap request from windowBits parameter */
+    /* extract wrap request from windowBits parameter, -16 is raw Deflate64 */
+    def64 = 0;
     if (windowBits < 0) {
-        if (windowBits < -15)
+        if (windowBits < -16)
             return Z_STREAM_ERROR;
         wrap = 0;
         windowBits = -windowBits;
+        def64 = windowBits == 16;
     }
     else {
         if (windowBits > 32767)  // Prevent potential overflow
@@ -174,9 +235,10 @@ int ZEXPORT inflateReset2(z_streamp strm, int windowBits) {
     }
 
     /* set number of window bits, free window if different */
-    if (windowBits && (windowBits < 8 || windowBits > 15))
+    if (windowBits && (windowBits < 8 || (windowBits > 15 && !def64)))
         return Z_STREAM_ERROR;
     if (state->window != Z_NULL && state->wbits != (unsigned)windowBits) {
+        if (inflate_unshare(strm)) return Z_MEM_ERROR;
         ZFREE(strm, state->window);
         state->window = Z_NULL;
     }
@@ -184,11 +246,30 @@ int ZEXPORT inflateReset2(z_streamp strm, int windowBits) {
     /* update state and reset the rest of it */
     state->wrap = wrap;
     state->wbits = (unsigned)windowBits;
+    state->def64 = def64;
     return inflateReset(strm);
 }
 
 int ZEXPORT inflateInit2_(z_streamp strm, int windowBits,
                           const char *version, int stream_size) {
+    return inflatePoolInit2_(strm, Z_NULL, windowBits, version, stream_size);
+}
+
+/*
+   Free an inflate state held by a stream pool, with its window and tables.
+ */
+local void inflate_release(z_pooled FAR *item) {
+    struct inflate_state FAR *state;
+
+    state = (struct inflate_state FAR *)item->state;
+    if (state->window != Z_NULL) item->zfree(item->opaque, state->window);
+    if (state->wide != Z_NULL) item->zfree(item->opaque, state->wide);
+    if (state->scratch != Z_NULL) item->zfree(item->opaque, state->scratch);
+    item->zfree(item->opaque, state);
+}
+
+int ZEXPORT inflatePoolInit2_(z_streamp strm, z_poolp pool, int windowBits,
+                              const char *version, int stream_size) {
     int ret;
     struct inflate_state FAR *state;
 
@@ -211,19 +292,32 @@ int ZEXPORT inflateInit2_(z_streamp strm, int windowBits,
 #else
         strm->zfree = zcfree;
 #endif
+    /* a pooled state keeps its window, which inflateReset2() frees if the
+       size is different, and its wide table space */
     state = (struct inflate_state FAR *)
-            ZALLOC(strm, 1, sizeof(struct inflate_state));
-    if (state == Z_NULL) return Z_MEM_ERROR;
-    Tracev((stderr, "inflate: allocated\n"));
+            z_pool_take(pool, strm, Z_POOL_INFLATE, 0);
+    if (state == Z_NULL) {
+        state = (struct inflate_state FAR *)
+                ZALLOC(strm, 1, sizeof(struct inflate_state));
+        if (state == Z_NULL) return Z_MEM_ERROR;
+        Tracev((stderr, "inflate: allocated\n"));
+        state->window = Z_NULL;
+        state->wide = Z_NULL;
+        state->share = Z_NULL;
+        state->scratch = Z_NULL;
+    }
     strm->state = (struct internal_state FAR *)state;
     state->strm = strm;
-    state->window = Z_NULL;
+    state->slack = 0;
+    state->verify = 0;
+    zmemzero((Bytef *)&state->offload, sizeof(z_offload));
+    state->offloaded = 0;
+    state->rootlen = 9;
+    state->rootdist = 6;
     state->mode = HEAD;     /* to pass state test in inflateReset2() */
     ret = inflateReset2(strm, windowBits);
-    if (ret != Z_OK) {
-        ZFREE(strm, state);
-        strm->state = Z_NULL;
-    }
+    if (ret != Z_OK)
+        inflateEnd(strm);
     return ret;
 }
 
@@ -268,8 +362,8 @@ int ZEXPORT inflatePrime(z_streamp strm, int bits, int value) {
 local void fixedtables(struct inflate_state FAR *state) {
 #ifdef BUILDFIXED
     static int virgin = 1;
-    static code *lenfix, *distfix;
-    static code fixed[544];
+    static code *lenfix, *distfix, *lenfix64, *distfix64;
+    static code fixed[544], fixed64[544];
 
     /* build fixed huffman tables if first call (may not be thread safe) */
     if (virgin) {
@@ -300,15 +394,33 @@ local void fixedtables(struct inflate_state FAR *state) {
             return;
         }
 
+        /* the same for Deflate64, which gives meaning to length code 285 and
+           distance codes 30 and 31 */
+        sym = 0;
+        while (sym < 144) state->lens[sym++] = 8;
+        while (sym < 256) state->lens[sym++] = 9;
+        while (sym < 280) state->lens[sym++] = 7;
+        while (sym < 288) state->lens[sym++] = 8;
+        next = fixed64;
+        lenfix64 = next;
+        bits = 9;
+        inflate_table(LENS64, state->lens, 288, &(next), &(bits), state->work);
+        sym = 0;
+        while (sym < 32) state->lens[sym++] = 5;
+        distfix64 = next;
+        bits = 5;
+        inflate_table(DISTS64, state->lens, 32, &(next), &(bits), state->work);
+
         /* do this just once */
         virgin = 0;
     }
 #else /* !BUILDFIXED */
 #   include "inffixed.h"
+#   include "inffix64.h"
 #endif /* BUILDFIXED */
-    state->lencode = lenfix;
+    state->lencode = state->def64 ? lenfix64 : lenfix;
     state->lenbits = 9;
-    state->distcode = distfix;
+    state->distcode = state->def64 ? distfix64 : distfix;
     state->distbits = 5;
 }
 
@@ -338,6 +450,7 @@ void makefixed(void)
     unsigned low, size;
     struct inflate_state state;
 
+    state.def64 = 0;
     fixedtables(&state);
     puts("    /* inffixed.h -- table for decoding fixed codes");
     puts("     * Generated automatically by makefixed().");
@@ -349,18 +462,10 @@ void makefixed(void)
     puts("     */");
     puts("");
     size = 1U << 9;
-    if (size > sizeof(state.lencode) / sizeof(state.lencode[0])) {
-        fprintf(stderr, "Error: lencode table size is out of bounds\n");
-        return;
-    }
     printf("    static const code lenfix[%u] = {", size);
     low = 0;
     for (;;) {
         if ((low % 7) == 0) printf("\n        ");
-        if (low >= size) {
-            fprintf(stderr, "Error: lencode index out of bounds\n");
-            return;
-        }
         printf("{%u,%u,%d}", (low & 127) == 99 ? 64 : state.lencode[low].op,
                state.lencode[low].bits, state.lencode[low].val);
         if (++low == size) break;
@@ -368,18 +473,54 @@ void makefixed(void)
     }
     puts("\n    };");
     size = 1U << 5;
-    if (size > sizeof(state.distcode) / sizeof(state.distcode[0])) {
-        fprintf(stderr, "Error: distcode table size is out of bounds\n");
-        return;
-    }
     printf("\n    static const code distfix[%u] = {", size);
     low = 0;
     for (;;) {
         if ((low % 6) == 0) printf("\n        ");
-        if (low >= size) {
-            fprintf(stderr, "Error: distcode index out of bounds\n");
-            return;
-        }
+        printf("{%u,%u,%d}", state.distcode[low].op, state.distcode[low].bits,
+               state.distcode[low].val);
+        if (++low == size) break;
+        putchar(',');
+    }
+    puts("\n    };");
+}
+
+/*
+   Write out the inffix64.h that is #include'd above, with the fixed code
+   tables for Deflate64, in the same way as makefixed() for inffixed.h.
+ */
+void makefixed64(void)
+{
+    unsigned low, size;
+    struct inflate_state state;
+
+    state.def64 = 1;
+    fixedtables(&state);
+    puts("    /* inffix64.h -- table for decoding Deflate64 fixed codes");
+    puts("     * Generated automatically by makefixed64().");
+    puts("     */");
+    puts("");
+    puts("    /* WARNING: this file should *not* be used by applications.");
+    puts("       It is part of the implementation of this library and is");
+    puts("       subject to change. Applications should only use zlib.h.");
+    puts("     */");
+    puts("");
+    size = 1U << 9;
+    printf("    static const code lenfix64[%u] = {", size);
+    low = 0;
+    for (;;) {
+        if ((low % 7) == 0) printf("\n        ");
+        printf("{%u,%u,%d}", (low & 127) == 99 ? 64 : state.lencode[low].op,
+               state.lencode[low].bits, state.lencode[low].val);
+        if (++low == size) break;
+        putchar(',');
+    }
+    puts("\n    };");
+    size = 1U << 5;
+    printf("\n    static const code distfix64[%u] = {", size);
+    low = 0;
+    for (;;) {
+        if ((low % 6) == 0) printf("\n        ");
         printf("{%u,%u,%d}", state.distcode[low].op, state.distcode[low].bits,
                state.distcode[low].val);
         if (++low == size) break;
@@ -389,6 +530,49 @@ void makefixed(void)
 }
 #endif /* MAKEFIXED */
 
+/* check function to use adler32() for zlib or crc32() for gzip */
+#ifdef GUNZIP
+#  define UPDATE_CHECK(check, buf, len) \
+    (state->flags ? crc32(check, buf, len) : adler32(check, buf, len))
+#else
+#  define UPDATE_CHECK(check, buf, len) adler32(check, buf, len)
+#endif
+
+/*
+   Copy len bytes from src to dst, and if check is true, update the check value
+   with them.  The check value is computed on pieces of CHECK_CHUNK bytes just
+   before they are copied, so that each byte is read for the copy while it is
+   still in the L1 cache from the check, rather than going over all of the
+   bytes twice.
+ */
+#define CHECK_CHUNK 4096
+
+/* Size of the output space allocated for inflateVerify() */
+#ifdef MAXSEG_64K
+#  define VERIFY_SCRATCH 32768U
+#else
+#  define VERIFY_SCRATCH 131072U
+#endif
+
+local void window_copy(struct inflate_state FAR *state, unsigned char FAR *dst,
+                       const unsigned char FAR *src, unsigned len,
+                       int check) {
+    unsigned chunk;
+
+    if (!check) {
+        zmemcpy(dst, src, len);
+        return;
+    }
+    while (len) {
+        chunk = len < CHECK_CHUNK ? len : CHECK_CHUNK;
+        state->check = UPDATE_CHECK(state->check, src, chunk);
+        zmemcpy(dst, src, chunk);
+        dst += chunk;
+        src += chunk;
+        len -= chunk;
+    }
+}
+
 /*
    Update the window with the last wsize (normally 32K) bytes written before
    returning.  If window does not exist yet, create it.  This is only called
@@ -402,8 +586,12 @@ void makefixed(void)
    upon return from inflate(), and since all distances after the first 32K of
    output will fall in the output data, making match copies simpler and faster.
    The advantage may be dependent on the size of the processor's data caches.
+
+   If check is true, then the check value is also updated with all copy bytes,
+   with the bytes that go into the window checked as they are copied.
  */
-local int updatewindow(z_streamp strm, const Bytef *end, unsigned copy) {
+local int updatewindow(z_streamp strm, const Bytef *end, unsigned copy,
+                       int check) {
     struct inflate_state FAR *state;
     unsigned dist;
 
@@ -426,17 +614,22 @@ local int updatewindow(z_streamp strm, const Bytef *end, unsigned copy) {
 
     /* copy state->wsize or less output bytes into the circular window */
     if (copy >= state->wsize) {
-        zmemcpy(state->window, end - state->wsize, state->wsize);
+        if (check && copy > state->wsize)
+            state->check = UPDATE_CHECK(state->check, end - copy,
+                                        copy - state->wsize);
+        window_copy(state, state->window, end - state->wsize, state->wsize,
+                    check);
         state->wnext = 0;
         state->whave = state->wsize;
     }
     else {
         dist = state->wsize - state->wnext;
         if (dist > copy) dist = copy;
-        zmemcpy(state->window + state->wnext, end - copy, dist);
+        window_copy(state, state->window + state->wnext, end - copy, dist,
+                    check);
         copy -= dist;
         if (copy) {
-            zmemcpy(state->window, end - copy, copy);
+            window_copy(state, state->window, end - copy, copy, check);
             state->wnext = copy;
             state->whave = state->wsize;
         }
@@ -451,14 +644,6 @@ local int updatewindow(z_streamp strm, const Bytef *end, unsigned copy) {
 
 /* Macros for inflate(): */
 
-/* check function to use adler32() for zlib or crc32() for gzip */
-#ifdef GUNZIP
-#  define UPDATE_CHECK(check, buf, len) \
-    (state->flags ? crc32(check, buf, len) : adler32(check, buf, len))
-#else
-#  define UPDATE_CHECK(check, buf, len) adler32(check, buf, len)
-#endif
-
 /* check macros for header crc */
 #ifdef GUNZIP
 #  define CRC2(check, word) \
@@ -625,7 +810,37 @@ local int updatewindow(z_streamp strm, const Bytef *end, unsigned copy) {
    will return Z_BUF_ERROR if it has not reached the end of the stream.
  */
 
-int ZEXPORT inflate(z_streamp strm, int flush) {
+/*
+   Give the deflate data at strm->next_in to the backend of inflateOffload() at
+   the start of a block, if it has the stream or can be offered it.  Return
+   Z_BUF_ERROR if the backend declined the stream, for inflate to decode it
+   instead, or else what the backend returned.
+ */
+local int inflate_offload(z_streamp strm, int flush) {
+    struct inflate_state FAR *state;
+    z_const unsigned char FAR *next = strm->next_in;
+    unsigned char FAR *put = strm->next_out;
+    int ret;
+
+    state = (struct inflate_state FAR *)strm->state;
+    if (state->offloaded == 0) {
+        /* only offer a stream with nothing decoded or primed yet */
+        state->offloaded = -1;
+        if (state->bits || state->whave || state->def64)
+            return Z_BUF_ERROR;
+    }
+    ret = state->offload.inflate(state->offload.opaque, strm, flush,
+                                 (int)state->wbits);
+    if (state->offloaded < 0) {
+        if (ret == Z_BUF_ERROR && strm->next_in == next &&
+            strm->next_out == put)
+            return Z_BUF_ERROR;
+        state->offloaded = 1;
+    }
+    return ret == Z_BUF_ERROR ? Z_OK : ret;
+}
+
+local int inflate_run(z_streamp strm, int flush) {
     struct inflate_state FAR *state;
     z_const unsigned char FAR *next;    /* next input */
     unsigned char FAR *put;     /* next output */
@@ -639,6 +854,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
     code last;                  /* parent table entry */
     unsigned len;               /* length to copy for repeats, bits to drop */
     int ret;                    /* return code */
+    int windowed;               /* true if updatewindow() did the check */
 #ifdef GUNZIP
     unsigned char hbuf[4];      /* buffer for gzip header crc calculation */
 #endif
@@ -648,6 +864,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
     if (inflateStateCheck(strm) || strm->next_out == Z_NULL ||
         (strm->next_in == Z_NULL && strm->avail_in != 0))
         return Z_STREAM_ERROR;
+    if (inflate_unshare(strm)) return Z_MEM_ERROR;
 
     state = (struct inflate_state FAR *)strm->state;
     if (state->mode == TYPE) state->mode = TYPEDO;      /* skip check */
@@ -863,6 +1080,24 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             if (flush == Z_BLOCK || flush == Z_TREES) goto inf_leave;
                 /* fallthrough */
         case TYPEDO:
+            if (state->offloaded >= 0 && state->offload.inflate != Z_NULL) {
+                RESTORE();
+                ret = inflate_offload(strm, flush);
+                LOAD();
+                if (state->offloaded > 0) {
+                    if (ret == Z_STREAM_END) {  /* backend did the rest */
+                        ret = Z_OK;
+                        state->mode = CHECK;
+                        break;
+                    }
+                    if (ret == Z_DATA_ERROR)
+                        state->mode = BAD;
+                    else
+                        goto inf_leave;
+                    break;
+                }
+                ret = Z_OK;
+            }
             if (state->last) {
                 BYTEBITS();
                 state->mode = CHECK;
@@ -873,12 +1108,14 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             DROPBITS(1);
             switch (BITS(2)) {
             case 0:                             /* stored block */
+                Stat(state->stats.stored++);
                 Tracev((stderr, "inflate:     stored block%s\n",
                         state->last ? " (last)" : ""));
                 state->mode = STORED;
                 break;
             case 1:                             /* fixed block */
                 fixedtables(state);
+                Stat(state->stats.fixed++);
                 Tracev((stderr, "inflate:     fixed codes block%s\n",
                         state->last ? " (last)" : ""));
                 state->mode = LEN_;             /* decode codes */
@@ -888,6 +1125,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
                 }
                 break;
             case 2:                             /* dynamic block */
+                Stat(state->stats.dynamic++);
                 Tracev((stderr, "inflate:     dynamic codes block%s\n",
                         state->last ? " (last)" : ""));
                 state->mode = TABLE;
@@ -942,7 +1180,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             state->ncode = BITS(4) + 4;
             DROPBITS(4);
 #ifndef PKZIP_BUG_WORKAROUND
-            if (state->nlen > 286 || state->ndist > 30) {
+            if (state->nlen > 286 || state->ndist > (state->def64 ? 32 : 30)) {
                 strm->msg = (char *)"too many length or distance symbols";
                 state->mode = BAD;
                 break;
@@ -1033,12 +1271,14 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             }
 
             /* build code tables -- note: do not change the lenbits or distbits
-               values here (9 and 6) without reading the comments in inftrees.h
+               values (9 and 6, or up to 11 and 8 from inflateTune() with the
+               wide space) without reading the comments in inftrees.h
                concerning the ENOUGH constants, which depend on those values */
-            state->next = state->codes;
+            state->next = state->wide != Z_NULL ? state->wide : state->codes;
             state->lencode = (const code FAR *)(state->next);
-            state->lenbits = 9;
-            ret = inflate_table(LENS, state->lens, state->nlen, &(state->next),
+            state->lenbits = state->rootlen;
+            ret = inflate_table(state->def64 ? LENS64 : LENS, state->lens,
+                                state->nlen, &(state->next),
                                 &(state->lenbits), state->work);
             if (ret) {
                 strm->msg = (char *)"invalid literal/lengths set";
@@ -1046,8 +1286,9 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
                 break;
             }
             state->distcode = (const code FAR *)(state->next);
-            state->distbits = 6;
-            ret = inflate_table(DISTS, state->lens + state->nlen, state->ndist,
+            state->distbits = state->rootdist;
+            ret = inflate_table(state->def64 ? DISTS64 : DISTS,
+                            state->lens + state->nlen, state->ndist,
                             &(state->next), &(state->distbits), state->work);
             if (ret) {
                 strm->msg = (char *)"invalid distances set";
@@ -1062,7 +1303,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             state->mode = LEN;
                 /* fallthrough */
         case LEN:
-            if (have >= 6 && left >= 258) {
+            if (have >= (state->def64 ? 7 : 6) && left >= 258) {
                 RESTORE();
                 inflate_fast(strm, out);
                 LOAD();
@@ -1094,6 +1335,7 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
                 Tracevv((stderr, here.val >= 0x20 && here.val < 0x7f ?
                         "inflate:         literal '%c'\n" :
                         "inflate:         literal 0x%02x\n", here.val));
+                Stat(state->stats.literals++);
                 state->mode = LIT;
                 break;
             }
@@ -1109,6 +1351,10 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
                 break;
             }
             state->extra = (unsigned)(here.op) & 15;
+            if (state->length == 0) {           /* Deflate64 length 285 */
+                state->length = 3;
+                state->extra = 16;
+            }
             state->mode = LENEXT;
                 /* fallthrough */
         case LENEXT:
@@ -1165,6 +1411,8 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
             }
 #endif
             Tracevv((stderr, "inflate:         distance %u\n", state->offset));
+            Stat(state->stats.matches++;
+                 state->stats.match_bytes += state->length);
             state->mode = MATCH;
                 /* fallthrough */
         case MATCH:
@@ -1279,20 +1527,27 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
      */
   inf_leave:
     RESTORE();
+    windowed = 0;
     if (state->wsize || (out != strm->avail_out && state->mode < BAD &&
-            (state->mode < CHECK || flush != Z_FINISH)))
-        if (updatewindow(strm, strm->next_out, out - strm->avail_out)) {
+            (state->mode < CHECK || flush != Z_FINISH))) {
+        if (updatewindow(strm, strm->next_out, out - strm->avail_out,
+                         state->wrap & 4)) {
             state->mode = MEM;
             return Z_MEM_ERROR;
         }
+        windowed = 1;
+    }
     in -= strm->avail_in;
     out -= strm->avail_out;
     strm->total_in += in;
     strm->total_out += out;
     state->total += out;
-    if ((state->wrap & 4) && out)
-        strm->adler = state->check =
-            UPDATE_CHECK(state->check, strm->next_out - out, out);
+    if ((state->wrap & 4) && out) {
+        if (!windowed)
+            state->check = UPDATE_CHECK(state->check, strm->next_out - out,
+                                        out);
+        strm->adler = state->check;
+    }
     strm->data_type = (int)state->bits + (state->last ? 64 : 0) +
                       (state->mode == TYPE ? 128 : 0) +
                       (state->mode == LEN_ || state->mode == COPY_ ? 256 : 0);
@@ -1301,18 +1556,107 @@ int ZEXPORT inflate(z_streamp strm, int flush) {
     return ret;
 }
 
+/*
+   Decode for inflateVerify() into the scratch space instead of next_out, as
+   many times as it takes to fill it, until the input is used up, the end of
+   the stream or a block with Z_BLOCK or Z_TREES is reached, or there is an
+   error.  The last window of output is kept by updatewindow() and the check
+   value computed as for any output, but the output is not written anywhere
+   else.  next_out and avail_out are left as they are.  The return value is
+   what a single inflate() call with unlimited output space would return.
+ */
+local int inflate_verify(z_streamp strm, int flush) {
+    struct inflate_state FAR *state;
+    unsigned char FAR *next_out;
+    uInt avail_out;
+    uLong in, out;
+    unsigned slack;
+    int ret;
+
+    if (inflateStateCheck(strm))
+        return Z_STREAM_ERROR;
+    state = (struct inflate_state FAR *)strm->state;
+    if (state->scratch == Z_NULL) {
+        state->scratch = (unsigned char FAR *)
+                         ZALLOC(strm, VERIFY_SCRATCH, sizeof(unsigned char));
+        if (state->scratch == Z_NULL) return Z_MEM_ERROR;
+    }
+    next_out = strm->next_out;
+    avail_out = strm->avail_out;
+    slack = state->slack;
+    state->slack = 0;
+    in = strm->total_in;
+    out = strm->total_out;
+    do {
+        strm->next_out = state->scratch;
+        strm->avail_out = VERIFY_SCRATCH;
+        ret = inflate_run(strm, flush);
+    } while ((ret == Z_OK || ret == Z_BUF_ERROR) && strm->avail_out == 0);
+    strm->next_out = next_out;
+    strm->avail_out = avail_out;
+    state->slack = slack;
+    if (ret == Z_BUF_ERROR && flush != Z_FINISH &&
+        (strm->total_in != in || strm->total_out != out))
+        ret = Z_OK;
+    return ret;
+}
+
+/* ========================================================================= */
+int ZEXPORT inflate(z_streamp strm, int flush) {
+#ifdef ZLIB_PROBES
+    int ret;
+    uLong in, out;
+
+    if (strm == Z_NULL)
+        return inflate_run(strm, flush);
+    in = strm->total_in;
+    out = strm->total_out;
+    Probe3(inflate_entry, strm->avail_in, strm->avail_out, flush);
+    ret = inflateStateCheck(strm) ||
+          !((struct inflate_state FAR *)strm->state)->verify ?
+          inflate_run(strm, flush) : inflate_verify(strm, flush);
+    Probe3(inflate_return, ret, strm->total_in - in, strm->total_out - out);
+    return ret;
+#else
+    if (inflateStateCheck(strm) ||
+        !((struct inflate_state FAR *)strm->state)->verify)
+        return inflate_run(strm, flush);
+    return inflate_verify(strm, flush);
+#endif
+}
+
 int ZEXPORT inflateEnd(z_streamp strm) {
     struct inflate_state FAR *state;
     if (strm == Z_NULL || strm->state == Z_NULL || inflateStateCheck(strm))
         return Z_STREAM_ERROR;
     state = (struct inflate_state FAR *)strm->state;
+    inflate_unload(state);
+    if (state->share != Z_NULL && --*state->share != 0) {
+        state->window = Z_NULL;         /* still in use by another state */
+        state->wide = Z_NULL;
+    }
+    else if (state->share != Z_NULL)
+        ZFREE(strm, state->share);
     if (state->window != Z_NULL) ZFREE(strm, state->window);
+    if (state->wide != Z_NULL) ZFREE(strm, state->wide);
+    if (state->scratch != Z_NULL) ZFREE(strm, state->scratch);
     ZFREE(strm, strm->state);
     strm->state = Z_NULL;
     Tracev((stderr, "inflate: end\n"));
     return Z_OK;
 }
 
+int ZEXPORT inflatePoolEnd(z_streamp strm, z_poolp pool) {
+    if (inflateStateCheck(strm))
+        return Z_STREAM_ERROR;
+    inflate_unload((struct inflate_state FAR *)strm->state);
+    if (((struct inflate_state FAR *)strm->state)->share != Z_NULL ||
+        !z_pool_put(pool, strm, Z_POOL_INFLATE, 0, inflate_release))
+        return inflateEnd(strm);
+    Tracev((stderr, "inflate: pooled\n"));
+    return Z_OK;
+}
+
 int ZEXPORT inflateGetDictionary(z_streamp strm, Bytef *dictionary,
                                  uInt *dictLength) {
     struct inflate_state FAR *state;
@@ -1365,7 +1709,8 @@ int ZEXPORT inflateSetDictionary(z_streamp strm, const Bytef *dictionary,
 
     /* copy dictionary to window using updatewindow(), which will amend the
        existing dictionary if appropriate */
-    ret = updatewindow(strm, dictionary + dictLength, dictLength);
+    if (inflate_unshare(strm)) return Z_MEM_ERROR;
+    ret = updatewindow(strm, dictionary + dictLength, dictLength, 0);
     if (ret) {
         state->mode = MEM;
         return Z_MEM_ERROR;
@@ -1375,6 +1720,32 @@ int ZEXPORT inflateSetDictionary(z_streamp strm, const Bytef *dictionary,
     return Z_OK;
 }
 
+int ZEXPORT inflateUseDictionary(z_streamp strm, z_dictp dict) {
+    struct inflate_state FAR *state;
+
+    /* check state */
+    if (inflateStateCheck(strm) || dict == Z_NULL) return Z_STREAM_ERROR;
+    state = (struct inflate_state FAR *)strm->state;
+    if (state->wrap != 0 && state->mode != DICT)
+        return Z_STREAM_ERROR;
+
+    /* the identifier was computed when the dictionary was compiled */
+    if (state->mode == DICT && dict->adler != state->check)
+        return Z_DATA_ERROR;
+
+    /* deflate used at most the last window of the dictionary, which is what
+       was kept, so that is all inflate needs */
+    if (inflate_unshare(strm)) return Z_MEM_ERROR;
+    if (dict->size &&
+        updatewindow(strm, dict->window + dict->size, dict->size, 0)) {
+        state->mode = MEM;
+        return Z_MEM_ERROR;
+    }
+    state->havedict = 1;
+    Tracev((stderr, "inflate:   compiled dictionary set\n"));
+    return Z_OK;
+}
+
 int ZEXPORT inflateGetHeader(z_streamp strm, gz_headerp head) {
     struct inflate_state FAR *state;
 
@@ -1389,6 +1760,74 @@ int ZEXPORT inflateGetHeader(z_streamp strm, gz_headerp head) {
     return Z_OK;
 }
 
+/*
+   If available, look for the 0, 0, 0xff, 0xff pattern at 16 positions at a
+   time, comparing four overlapping vectors with the four pattern bytes: SSE2
+   on x86-64, or NEON on aarch64.  Compressed data rarely has a run of two
+   0xff bytes, so nearly all of the input is passed over this way.  Define
+   NO_SYNC_SIMD to compare one position at a time.
+ */
+#ifndef NO_SYNC_SIMD
+#  if defined(__x86_64__) || defined(_M_X64)
+#    define SYNC_SSE2
+#    include <emmintrin.h>
+#  elif defined(__aarch64__) && defined(__ARM_NEON)
+#    define SYNC_NEON
+#    include <arm_neon.h>
+#  endif
+#endif
+
+/*
+   Return the offset of the first 0, 0, 0xff, 0xff pattern in buf[0..len-1]
+   that starts at or after next, or len if there is none.
+ */
+local z_size_t syncfind(const unsigned char FAR *buf, z_size_t next,
+                        z_size_t len) {
+#if defined(SYNC_SSE2)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i ones = _mm_set1_epi8(-1);
+    int hits;
+
+    while (len - next >= 19) {
+        hits = _mm_movemask_epi8(_mm_and_si128(
+            _mm_and_si128(
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(buf + next)),
+                               zero),
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(buf + next +
+                                                                 1)), zero)),
+            _mm_and_si128(
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(buf + next +
+                                                                 2)), ones),
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(buf + next +
+                                                                 3)), ones))));
+        if (hits) {
+            while ((hits & 1) == 0) {
+                hits >>= 1;
+                next++;
+            }
+            return next;
+        }
+        next += 16;
+    }
+#elif defined(SYNC_NEON)
+    while (len - next >= 19) {
+        if (vmaxvq_u8(vandq_u8(
+                vandq_u8(vceqzq_u8(vld1q_u8(buf + next)),
+                         vceqzq_u8(vld1q_u8(buf + next + 1))),
+                vandq_u8(vceqq_u8(vld1q_u8(buf + next + 2), vdupq_n_u8(0xff)),
+                         vceqq_u8(vld1q_u8(buf + next + 3),
+                                  vdupq_n_u8(0xff))))))
+            break;              /* the loop below finds which position */
+        next += 16;
+    }
+#endif
+    for (; len - next >= 4; next++)
+        if (buf[next + 3] == 0xff && buf[next + 2] == 0xff &&
+            buf[next + 1] == 0 && buf[next] == 0)
+            return next;
+    return len;
+}
+
 /*
    Search buf[0..len-1] for the pattern: 0, 0, 0xff, 0xff.  Return when found
    or when out of input.  When called, *have is the number of pattern bytes
@@ -1412,16 +1851,22 @@ local unsigned syncsearch(unsigned FAR *have, const unsigned char FAR *buf,
     got = *have;
     next = 0;
     while (next < len && got < 4) {
+        if (got == 0 && len - next > 4) {
+            /* a pattern wholly in buf, else only the last three bytes can
+               start a partial pattern */
+            next = (unsigned)syncfind(buf, next, len);
+            if (next < len) {
+                *have = 4;
+                return next + 4;
+            }
+            next = len - 3;
+        }
         if ((int)(buf[next]) == (got < 2 ? 0 : 0xff))
             got++;
         else if (buf[next])
             got = 0;
         else
             got = 4 - got;
-        
-        if (next + 1 < next) { // Check for unsigned integer overflow
-            break;
-        }
         next++;
     }
     *have = got;
@@ -1480,6 +1925,22 @@ int ZEXPORT inflateSync(z_streamp strm) {
     return Z_OK;
 }
 
+unsigned ZEXPORT inflateSyncScan(const Bytef *buf, z_size_t len,
+                                 z_size_t *points, unsigned max) {
+    z_size_t next;
+    unsigned n;
+
+    if (buf == Z_NULL || (points == Z_NULL && max != 0))
+        return 0;
+    n = 0;
+    next = 0;
+    while (n < max && (next = syncfind(buf, next, len)) < len) {
+        next += 4;
+        points[n++] = next;
+    }
+    return n;
+}
+
 /*
    Returns true if inflate is currently at the end of a block generated by
    Z_SYNC_FLUSH or Z_FULL_FLUSH. This function is used by one PPP
@@ -1501,15 +1962,17 @@ int ZEXPORT inflateCopy(z_streamp dest, z_streamp source) {
     struct inflate_state FAR *state;
     struct inflate_state FAR *copy;
     unsigned char FAR *window;
+    code FAR *wide;
     unsigned wsize;
 
     /* check input */
     if (inflateStateCheck(source) || dest == Z_NULL || source == Z_NULL || source->state == Z_NULL)
         return Z_STREAM_ERROR;
     state = (struct inflate_state FAR *)source->state;
+    if (state->offloaded > 0) return Z_STREAM_ERROR;
 
     /* check wbits range to avoid excessive memory allocation */
-    if (state->wbits > 15) return Z_STREAM_ERROR;
+    if (state->wbits > (state->def64 ? 16U : 15U)) return Z_STREAM_ERROR;
 
     /* allocate space */
     copy = (struct inflate_state FAR *)
@@ -1524,6 +1987,16 @@ int ZEXPORT inflateCopy(z_streamp dest, z_streamp source) {
             return Z_MEM_ERROR;
         }
     }
+    wide = Z_NULL;
+    if (state->wide != Z_NULL) {
+        wide = (code FAR *)ZALLOC(source, ENOUGH_WIDE, sizeof(code));
+        if (wide == Z_NULL) {
+            if (window != Z_NULL) ZFREE(source, window);
+            ZFREE(source, copy);
+            return Z_MEM_ERROR;
+        }
+        zmemcpy((voidpf)wide, (voidpf)state->wide, ENOUGH_WIDE * sizeof(code));
+    }
 
     /* copy state */
     zmemcpy((voidpf)dest, (voidpf)source, sizeof(z_stream));
@@ -1534,7 +2007,19 @@ int ZEXPORT inflateCopy(z_streamp dest, z_streamp source) {
         copy->lencode = copy->codes + (state->lencode - state->codes);
         copy->distcode = copy->codes + (state->distcode - state->codes);
     }
-    copy->next = copy->codes + (state->next - state->codes);
+    else if (wide != Z_NULL && state->lencode >= state->wide &&
+             state->lencode <= state->wide + ENOUGH_WIDE - 1) {
+        copy->lencode = wide + (state->lencode - state->wide);
+        copy->distcode = wide + (state->distcode - state->wide);
+    }
+    if (wide != Z_NULL && state->next >= state->wide &&
+        state->next <= state->wide + ENOUGH_WIDE)
+        copy->next = wide + (state->next - state->wide);
+    else
+        copy->next = copy->codes + (state->next - state->codes);
+    copy->wide = wide;
+    copy->share = Z_NULL;
+    copy->scratch = Z_NULL;
     if (window != Z_NULL) {
         wsize = 1U << state->wbits;
         zmemcpy(window, state->window, wsize);
@@ -1544,6 +2029,48 @@ int ZEXPORT inflateCopy(z_streamp dest, z_streamp source) {
     return Z_OK;
 }
 
+int ZEXPORT inflateFork(z_streamp dest, z_streamp source) {
+    struct inflate_state FAR *state;
+    struct inflate_state FAR *copy;
+
+    /* check input */
+    if (inflateStateCheck(source) || dest == Z_NULL)
+        return Z_STREAM_ERROR;
+    state = (struct inflate_state FAR *)source->state;
+    if (state->offloaded > 0) return Z_STREAM_ERROR;
+
+    /* allocate space, and count the sharing of the window and tables */
+    copy = (struct inflate_state FAR *)
+           ZALLOC(source, 1, sizeof(struct inflate_state));
+    if (copy == Z_NULL) return Z_MEM_ERROR;
+    if (state->share == Z_NULL &&
+        (state->window != Z_NULL || state->wide != Z_NULL)) {
+        state->share = (unsigned FAR *)ZALLOC(source, 1, sizeof(unsigned));
+        if (state->share == Z_NULL) {
+            ZFREE(source, copy);
+            return Z_MEM_ERROR;
+        }
+        *state->share = 1;
+    }
+    if (state->share != Z_NULL)
+        ++*state->share;
+
+    /* copy state, with the window and wide tables left shared */
+    zmemcpy((voidpf)dest, (voidpf)source, sizeof(z_stream));
+    zmemcpy((voidpf)copy, (voidpf)state, sizeof(struct inflate_state));
+    copy->strm = dest;
+    if (state->lencode >= state->codes &&
+        state->lencode <= state->codes + ENOUGH - 1) {
+        copy->lencode = copy->codes + (state->lencode - state->codes);
+        copy->distcode = copy->codes + (state->distcode - state->codes);
+    }
+    if (state->next >= state->codes && state->next <= state->codes + ENOUGH)
+        copy->next = copy->codes + (state->next - state->codes);
+    copy->scratch = Z_NULL;
+    dest->state = (struct internal_state FAR *)copy;
+    return Z_OK;
+}
+
 int ZEXPORT inflateUndermine(z_streamp strm, int subvert) {
     struct inflate_state FAR *state;
 
@@ -1560,6 +2087,57 @@ int ZEXPORT inflateUndermine(z_streamp strm, int subvert) {
 #endif
 }
 
+int ZEXPORT inflateSlack(z_streamp strm, unsigned slack) {
+    struct inflate_state FAR *state;
+
+    if (inflateStateCheck(strm)) return Z_STREAM_ERROR;
+    state = (struct inflate_state FAR *)strm->state;
+    state->slack = slack;
+    return Z_OK;
+}
+
+int ZEXPORT inflateVerify(z_streamp strm, int verify) {
+    struct inflate_state FAR *state;
+
+    if (inflateStateCheck(strm)) return Z_STREAM_ERROR;
+    state = (struct inflate_state FAR *)strm->state;
+    state->verify = verify != 0;
+    return Z_OK;
+}
+
+int ZEXPORT inflateOffload(z_streamp strm, const z_offload FAR *offload) {
+    struct inflate_state FAR *state;
+
+    if (inflateStateCheck(strm)) return Z_STREAM_ERROR;
+    state = (struct inflate_state FAR *)strm->state;
+    if (state->offloaded > 0) return Z_STREAM_ERROR;
+    if (offload == Z_NULL)
+        zmemzero((Bytef *)&state->offload, sizeof(z_offload));
+    else
+        state->offload = *offload;
+    return Z_OK;
+}
+
+int ZEXPORT inflateTune(z_streamp strm, int lenbits, int distbits) {
+    struct inflate_state FAR *state;
+
+    if (inflateStateCheck(strm)) return Z_STREAM_ERROR;
+    state = (struct inflate_state FAR *)strm->state;
+    if (lenbits < 9 || lenbits > 11 || distbits < 6 || distbits > 8)
+        return Z_STREAM_ERROR;
+
+    /* the wide space, once allocated, is kept until inflateEnd(), since the
+       current tables may be in it */
+    if ((lenbits > 9 || distbits > 6) && state->wide == Z_NULL) {
+        if (inflate_unshare(strm)) return Z_MEM_ERROR;
+        state->wide = (code FAR *)ZALLOC(strm, ENOUGH_WIDE, sizeof(code));
+        if (state->wide == Z_NULL) return Z_MEM_ERROR;
+    }
+    state->rootlen = (unsigned)lenbits;
+    state->rootdist = (unsigned)distbits;
+    return Z_OK;
+}
+
 int ZEXPORT inflateValidate(z_streamp strm, int check) {
     struct inflate_state FAR *state;
     
@@ -1575,6 +2153,17 @@ int ZEXPORT inflateValidate(z_streamp strm, int check) {
     return Z_OK;
 }
 
+int ZEXPORT inflateGetStats(z_streamp strm, z_stats *stats) {
+    if (inflateStateCheck(strm) || stats == Z_NULL) return Z_STREAM_ERROR;
+#ifdef ZLIB_STATS
+    *stats = ((struct inflate_state FAR *)strm->state)->stats;
+    return Z_OK;
+#else
+    zmemzero((Bytef *)stats, sizeof(z_stats));
+    return Z_VERSION_ERROR;
+#endif
+}
+
 long ZEXPORT inflateMark(z_streamp strm) {
     struct inflate_state FAR *state;
     unsigned long result;
@@ -1609,7 +2198,11 @@ unsigned long ZEXPORT inflateCodesUsed(z_streamp strm) {
     struct inflate_state FAR *state;
     if (inflateStateCheck(strm)) return (unsigned long)-1;
     state = (struct inflate_state FAR *)strm->state;
-    if (state == NULL || state->next < state->codes) return (unsigned long)-1;
+    if (state == NULL) return (unsigned long)-1;
+    if (state->wide != Z_NULL && state->next >= state->wide &&
+        state->next <= state->wide + ENOUGH_WIDE)
+        return (unsigned long)(state->next - state->wide);
+    if (state->next < state->codes) return (unsigned long)-1;
     size_t diff = (size_t)(state->next - state->codes);
     if (diff > ULONG_MAX) return (unsigned long)-1;
     return (unsigned long)diff;
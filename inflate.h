@@ -78,7 +78,8 @@ typedef enum {
  */
 
 /* State maintained between inflate() calls -- approximately 7K bytes, not
-   including the allocated sliding window, which is up to 32K bytes. */
+   including the allocated sliding window, which is up to 32K bytes, or 64K
+   bytes for Deflate64. */
 struct inflate_state {
     z_streamp strm;             /* pointer back to this zlib stream */
     inflate_mode mode;          /* current inflate mode */
@@ -123,4 +124,20 @@ struct inflate_state {
     int sane;                   /* if false, allow invalid distance too far */
     int back;                   /* bits back of last unprocessed length/lit */
     unsigned was;               /* initial length of match */
+    unsigned slack;             /* writable bytes past the output buffer */
+    int verify;                 /* true to decode without writing output */
+    unsigned char FAR *scratch; /* output space for verify, if allocated */
+    code FAR *wide;             /* space for larger tables, else Z_NULL */
+    unsigned FAR *share;        /* number of states from inflateFork()
+                                   sharing window and wide, else Z_NULL */
+    unsigned rootlen;           /* root index bits for literal/length tables */
+    unsigned rootdist;          /* root index bits for distance tables */
+    int def64;                  /* true for raw Deflate64 (windowBits -16) */
+    z_offload offload;          /* backend from inflateOffload() */
+    int offloaded;              /* 1 if the backend has the stream, -1 if it
+                                   declined or could not be offered it, 0 if
+                                   it has not been offered it yet */
+#ifdef ZLIB_STATS
+    z_stats stats;              /* counts returned by inflateGetStats() */
+#endif
 };
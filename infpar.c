@@ -0,0 +1,590 @@
+/* infpar.c -- inflate a single deflate stream using several threads
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/*
+ *  ALGORITHM
+ *
+ *      Nothing in a deflate stream without flush points says where a block
+ *      starts, short of decoding everything before it, and a match can copy
+ *      from as far as 32K back into the output of earlier blocks. The stream
+ *      is cut into parts of SPEC_CHUNK compressed bytes anyway, which are
+ *      decoded in waves of one part per thread. The first part of a wave
+ *      starts where the wave before it ended. Every other part guesses where
+ *      its first block starts, by trying each bit position from the start of
+ *      the part for a dynamic block header with complete codes, and decoding
+ *      from there until the data proves invalid. Matches that reach back past
+ *      the start of a part, into output that is not known yet, are decoded as
+ *      markers of the window positions they copy. Each part decodes up to the
+ *      first block boundary at or after the start of the next part.
+ *
+ *      A part is then kept only if it starts at the very bit where the part
+ *      before it ended, since that proves that its guess was a true block
+ *      boundary. The windows of the kept parts are made in order from the
+ *      last 32K of output of the part before, the markers are replaced with
+ *      window bytes, and the output is delivered in order. The next wave
+ *      starts where the last kept part ended, so a wrong guess costs only the
+ *      time spent on the parts that were not kept, never the result.
+ *
+ *      Each decoded symbol takes two bytes, a literal or 256 plus a window
+ *      offset. A part is cut short at a block boundary after SPEC_MAX
+ *      symbols, in which case the part after it is not kept. That bounds the
+ *      memory used for highly compressed data.
+ */
+
+#include "zutil.h"
+#include "inftrees.h"
+#include "inffixed.h"
+
+#define SPEC_CHUNK 1048576UL
+/* Compressed bytes per part. */
+
+#define SPEC_MAX 4194304UL
+/* Symbols after which a part is cut short at the next block boundary. */
+
+#define SPEC_WIN 32768U
+/* Window size, which is the farthest that a match can reach back. */
+
+/* run jobs on a pool of threads, see parallel.c */
+void ZLIB_INTERNAL par_run(unsigned, unsigned, void (*)(voidpf, unsigned),
+                           voidpf);
+
+/* One part of the deflate stream, with its code tables and output */
+typedef struct {
+    unsigned short lens[320];   /* code lengths */
+    unsigned short work[288];   /* work area for inflate_table() */
+    code codes[ENOUGH];         /* dynamic tables */
+    z_size_t from;              /* byte offset where the part starts */
+    z_size_t in;                /* bit offset of its first block */
+    z_size_t end;               /* bit offset after its last whole block */
+    int last;                   /* true if it ended with the final block */
+    int ret;                    /* Z_OK or an error */
+    unsigned short *sym;        /* decoded literals and window markers */
+    z_size_t size;              /* allocated symbols at sym */
+    z_size_t have;              /* symbols at sym */
+    unsigned char *out;         /* the symbols resolved to bytes */
+    z_size_t room;              /* allocated bytes at out */
+    unsigned char win[SPEC_WIN];    /* output before the part */
+    unsigned wlen;              /* valid bytes at the end of win */
+    uLong crc;                  /* CRC-32 of the output */
+} spec_part;
+
+typedef struct {
+    const unsigned char *buf;   /* deflate stream */
+    z_size_t len;               /* its length */
+    spec_part *part;            /* parts of the wave */
+} spec_wave;
+
+/*
+   On 64-bit little-endian processors, hold is refilled with eight bytes at a
+   time while there are at least eight bytes of input left, as in join.c.
+ */
+#if defined(Z_U8) && defined(HAVE_MEMCPY) && \
+    (defined(__x86_64__) || defined(_M_X64) || \
+     (defined(__aarch64__) && defined(__AARCH64EL__)))
+#  define SPEC_HOLD64
+   typedef Z_U8 hold_t;
+#  define REFILL() \
+    do { \
+        hold_t word; \
+        zmemcpy((Bytef *)&word, next, sizeof(word)); \
+        hold |= word << bits; \
+        next += (63 - bits) >> 3; \
+        bits |= 56; \
+    } while (0)
+#else
+   typedef unsigned long hold_t;
+#endif
+
+/* Bit buffer macros, like those in join.c, on the local variables next, end,
+   hold, and bits of spec_decode(), which return Z_BUF_ERROR from
+   spec_decode() if the input runs out */
+#define PULLBYTE() \
+    do { \
+        if (next == end) return Z_BUF_ERROR; \
+        hold |= (hold_t)(*next++) << bits; \
+        bits += 8; \
+    } while (0)
+#define NEEDBITS(n) \
+    do { \
+        while (bits < (unsigned)(n)) PULLBYTE(); \
+    } while (0)
+#define BITS(n) \
+    ((unsigned)hold & ((1U << (n)) - 1))
+#define DROPBITS(n) \
+    do { \
+        hold >>= (n); \
+        bits -= (unsigned)(n); \
+    } while (0)
+
+/* Position of the next bit in the input, counted from buf */
+#define BITPOS() \
+    ((z_size_t)(next - buf) * 8 - bits)
+
+/* Decode one code with the table t of root bits into here, pulling input as
+   needed, and with a second-level lookup if needed, as inflate() does */
+#define DECODE(here, t, root) \
+    do { \
+        for (;;) { \
+            here = (t)[BITS(root)]; \
+            if ((unsigned)(here.bits) <= bits) break; \
+            PULLBYTE(); \
+        } \
+        if (here.op && (here.op & 0xf0) == 0) { \
+            code last_ = here; \
+            for (;;) { \
+                here = (t)[last_.val + (BITS(last_.bits + last_.op) >> \
+                                        last_.bits)]; \
+                if ((unsigned)(last_.bits + here.bits) <= bits) break; \
+                PULLBYTE(); \
+            } \
+            DROPBITS(last_.bits); \
+        } \
+        DROPBITS(here.bits); \
+    } while (0)
+
+/* ===========================================================================
+ * Make room in p for at least n more symbols. Return true if out of memory.
+ */
+local int spec_room(spec_part *p, z_size_t n) {
+    z_size_t size;
+    unsigned short *sym;
+
+    if (p->size - p->have >= n)
+        return 0;
+    size = p->size ? p->size : 65536;
+    while (size - p->have < n)
+        size <<= 1;
+    sym = (unsigned short *)realloc(p->sym, size * sizeof(unsigned short));
+    if (sym == NULL)
+        return 1;
+    p->sym = sym;
+    p->size = size;
+    return 0;
+}
+
+/* ===========================================================================
+ * Decode the blocks of the len bytes of deflate data at buf from the bit
+ * offset p->end, until a block starts at or after the bit offset stop, or the
+ * final block is decoded, or there are SPEC_MAX symbols. The symbols are
+ * appended to p->sym, and p->end is updated after each block. Return Z_OK,
+ * Z_DATA_ERROR if the data is invalid, Z_BUF_ERROR if it ends in a block, or
+ * Z_MEM_ERROR.
+ */
+local int spec_decode(spec_part *p, const unsigned char *buf, z_size_t len,
+                      z_size_t stop) {
+    const unsigned char *next;  /* next input byte */
+    const unsigned char *end;   /* end of input */
+    hold_t hold;                /* bit buffer */
+    unsigned bits;              /* bits in bit buffer */
+    unsigned type, nlen, ndist, ncode, have, lenbits, distbits, op, copy;
+    unsigned dist;
+    z_size_t out;
+    unsigned short *sym;
+    unsigned short *from;
+    code here;
+    code const FAR *lcode;
+    code const FAR *dcode;
+    code FAR *codes;
+    static const unsigned short order[19] =
+        {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+    next = buf + (p->end >> 3);
+    end = buf + len;
+    hold = 0;
+    bits = 0;
+    if (p->end & 7) {
+        PULLBYTE();
+        DROPBITS(p->end & 7);
+    }
+    while (p->end < stop && !p->last && p->have < SPEC_MAX) {
+        /* block header */
+        NEEDBITS(3);
+        p->last = (int)BITS(1);
+        DROPBITS(1);
+        type = BITS(2);
+        DROPBITS(2);
+
+        if (type == 0) {
+            /* stored block -- go to the byte boundary and copy the data */
+            DROPBITS(bits & 7);
+            next -= bits >> 3;
+            hold = 0;
+            bits = 0;
+            if (end - next < 4)
+                return Z_BUF_ERROR;
+            copy = next[0] + ((unsigned)next[1] << 8);
+            if ((copy ^ 0xffff) != next[2] + ((unsigned)next[3] << 8))
+                return Z_DATA_ERROR;
+            next += 4;
+            if ((z_size_t)(end - next) < copy)
+                return Z_BUF_ERROR;
+            if (spec_room(p, copy))
+                return Z_MEM_ERROR;
+            sym = p->sym + p->have;
+            p->have += copy;
+            while (copy--)
+                *sym++ = *next++;
+            p->end = BITPOS();
+            continue;
+        }
+        if (type == 1) {
+            lcode = lenfix;
+            lenbits = 9;
+            dcode = distfix;
+            distbits = 5;
+        }
+        else if (type == 2) {
+            /* dynamic block -- read the code lengths and build the tables,
+               as inflate() does */
+            NEEDBITS(14);
+            nlen = BITS(5) + 257;
+            DROPBITS(5);
+            ndist = BITS(5) + 1;
+            DROPBITS(5);
+            ncode = BITS(4) + 4;
+            DROPBITS(4);
+            if (nlen > 286 || ndist > 30)
+                return Z_DATA_ERROR;
+            for (have = 0; have < ncode; have++) {
+                NEEDBITS(3);
+                p->lens[order[have]] = (unsigned short)BITS(3);
+                DROPBITS(3);
+            }
+            while (have < 19)
+                p->lens[order[have++]] = 0;
+            codes = p->codes;
+            lcode = (code const FAR *)codes;
+            lenbits = 7;
+            if (inflate_table(CODES, p->lens, 19, &codes, &lenbits, p->work))
+                return Z_DATA_ERROR;
+            have = 0;
+            while (have < nlen + ndist) {
+                DECODE(here, lcode, lenbits);
+                if (here.val < 16)
+                    p->lens[have++] = here.val;
+                else {
+                    if (here.val == 16) {
+                        NEEDBITS(2);
+                        if (have == 0)
+                            return Z_DATA_ERROR;
+                        op = p->lens[have - 1];
+                        copy = 3 + BITS(2);
+                        DROPBITS(2);
+                    }
+                    else if (here.val == 17) {
+                        NEEDBITS(3);
+                        op = 0;
+                        copy = 3 + BITS(3);
+                        DROPBITS(3);
+                    }
+                    else {
+                        NEEDBITS(7);
+                        op = 0;
+                        copy = 11 + BITS(7);
+                        DROPBITS(7);
+                    }
+                    if (have + copy > nlen + ndist)
+                        return Z_DATA_ERROR;
+                    while (copy--)
+                        p->lens[have++] = (unsigned short)op;
+                }
+            }
+            if (p->lens[256] == 0)
+                return Z_DATA_ERROR;
+            codes = p->codes;
+            lcode = (code const FAR *)codes;
+            lenbits = 9;
+            if (inflate_table(LENS, p->lens, nlen, &codes, &lenbits, p->work))
+                return Z_DATA_ERROR;
+            dcode = (code const FAR *)codes;
+            distbits = 6;
+            if (inflate_table(DISTS, p->lens + nlen, ndist, &codes, &distbits,
+                              p->work))
+                return Z_DATA_ERROR;
+        }
+        else
+            return Z_DATA_ERROR;
+
+        /* decode the literals and matches up to the end-of-block code, with
+           markers for the bytes copied from before the part */
+        out = p->have;
+        for (;;) {
+            if (p->size - out < MAX_MATCH) {
+                p->have = out;
+                if (spec_room(p, MAX_MATCH))
+                    return Z_MEM_ERROR;
+            }
+            sym = p->sym;
+#ifdef SPEC_HOLD64
+            if (bits < 48 && end - next >= 8)
+                REFILL();
+#endif
+            DECODE(here, lcode, lenbits);
+            op = here.op;
+            if (op == 0) {
+                sym[out++] = here.val;
+                continue;
+            }
+            if (op & 32)
+                break;
+            if (op & 64)
+                return Z_DATA_ERROR;
+            op &= 15;
+            NEEDBITS(op);
+            copy = here.val + BITS(op);
+            DROPBITS(op);
+            DECODE(here, dcode, distbits);
+            if (here.op & 64)
+                return Z_DATA_ERROR;
+            op = here.op & 15;
+            NEEDBITS(op);
+            dist = here.val + BITS(op);
+            DROPBITS(op);
+            if (dist > out) {
+                if (dist - out > SPEC_WIN)
+                    return Z_DATA_ERROR;
+                op = 256 + SPEC_WIN - (unsigned)(dist - out);
+                while (copy && op < 256 + SPEC_WIN) {
+                    sym[out++] = (unsigned short)op++;
+                    copy--;
+                }
+            }
+            if (copy) {
+                from = sym + out - dist;
+                while (copy--)
+                    sym[out++] = *from++;
+            }
+        }
+        p->have = out;
+        p->end = BITPOS();
+    }
+    return Z_OK;
+}
+
+/* ===========================================================================
+ * Return true if the bit offset at in buf[0..len-1] could start a dynamic
+ * block that is not the final block, judging by its first 13 bits.
+ */
+local int spec_head(const unsigned char *buf, z_size_t len, z_size_t at) {
+    z_size_t i = at >> 3;
+    uLong v;
+
+    if (len - i < 4)
+        return 0;
+    v = ((uLong)buf[i] | ((uLong)buf[i + 1] << 8) |
+         ((uLong)buf[i + 2] << 16) | ((uLong)buf[i + 3] << 24)) >> (at & 7);
+    return (v & 7) == 4 && ((v >> 3) & 31) < 30 && ((v >> 8) & 31) < 30;
+}
+
+/* ===========================================================================
+ * Return the byte offset of the length of a stored block that is not the
+ * final block if one could start at the bit offset at in buf[0..len-1], with
+ * zero bits up to the length, or zero if not. A stored block is decoded the
+ * same from any bit offset that returns the same non-zero value.
+ */
+local z_size_t spec_stored(const unsigned char *buf, z_size_t len,
+                           z_size_t at) {
+    z_size_t i = (at + 10) >> 3;
+    unsigned v;
+
+    if (i >= len || len - i < 4)
+        return 0;
+    v = (buf[at >> 3] | ((unsigned)buf[(at >> 3) + 1] << 8)) >> (at & 7);
+    if (v & ((1U << ((i << 3) - at)) - 1))
+        return 0;
+    return (buf[i] ^ buf[i + 2]) == 0xff && (buf[i + 1] ^ buf[i + 3]) == 0xff ?
+           i : 0;
+}
+
+/* ===========================================================================
+ * Decode a part of the wave. The first part starts at the known bit offset
+ * in part->in. The others look for the first bit offset from part->from that
+ * could start a dynamic or stored block, and that decodes without error up to
+ * the next part.
+ */
+local void spec_run(voidpf arg, unsigned job) {
+    spec_wave *wave = (spec_wave *)arg;
+    spec_part *p = wave->part + job;
+    z_size_t stop, at, lim, store, tried;
+
+    stop = (p->from + SPEC_CHUNK) << 3;
+    p->have = 0;
+    p->last = 0;
+    if (job == 0) {
+        p->end = p->in;
+        p->ret = spec_decode(p, wave->buf, wave->len, stop);
+        return;
+    }
+    lim = wave->len - p->from < SPEC_CHUNK ? wave->len : p->from + SPEC_CHUNK;
+    tried = 0;
+    for (at = p->from << 3; at < lim << 3; at++) {
+        if (!spec_head(wave->buf, wave->len, at)) {
+            store = spec_stored(wave->buf, wave->len, at);
+            if (store == 0 || store == tried)
+                continue;
+            tried = store;
+        }
+        p->in = p->end = at;
+        p->have = 0;
+        p->last = 0;
+        p->ret = spec_decode(p, wave->buf, wave->len, stop);
+        if (p->ret == Z_OK || p->ret == Z_MEM_ERROR)
+            return;
+    }
+    p->ret = Z_DATA_ERROR;
+}
+
+/* ===========================================================================
+ * Put the last SPEC_WIN bytes of output up to the end of part p in win,
+ * resolving the markers with the window of p, and return how many of them
+ * are valid.
+ */
+local unsigned spec_window(spec_part *p, unsigned char *win) {
+    z_size_t n, i;
+    unsigned keep, s;
+    const unsigned short *sym;
+
+    n = p->have < SPEC_WIN ? p->have : SPEC_WIN;
+    keep = SPEC_WIN - (unsigned)n;
+    if (keep)
+        zmemcpy(win, p->win + SPEC_WIN - keep, keep);
+    sym = p->sym + p->have - n;
+    for (i = 0; i < n; i++) {
+        s = sym[i];
+        win[keep + i] = s < 256 ? (unsigned char)s : p->win[s - 256];
+    }
+    return p->wlen + n < SPEC_WIN ? p->wlen + (unsigned)n : SPEC_WIN;
+}
+
+/* ===========================================================================
+ * Resolve the symbols of a part to bytes, and compute their CRC-32.
+ */
+local void spec_resolve(voidpf arg, unsigned job) {
+    spec_wave *wave = (spec_wave *)arg;
+    spec_part *p = wave->part + job;
+    z_size_t i;
+    unsigned s, low = 256 + SPEC_WIN - p->wlen;
+    unsigned char *out;
+
+    if (p->room < p->have) {
+        out = (unsigned char *)realloc(p->out, p->have);
+        if (out == NULL) {
+            p->ret = Z_MEM_ERROR;
+            return;
+        }
+        p->out = out;
+        p->room = p->have;
+    }
+    for (i = 0; i < p->have; i++) {
+        s = p->sym[i];
+        if (s < 256)
+            p->out[i] = (unsigned char)s;
+        else if (s >= low)
+            p->out[i] = p->win[s - 256];
+        else {
+            p->ret = Z_DATA_ERROR;      /* distance too far back */
+            return;
+        }
+    }
+    p->crc = crc32_z(0L, p->out, p->have);
+}
+
+/* ===========================================================================
+ * Inflate the raw deflate stream in buf[0..len-1] using up to threads
+ * threads, delivering the output in order to put(arg, data, length), which
+ * returns non-zero to abort. On success, *used is set to the number of bytes
+ * of deflate data, *crc to the CRC-32 of the output, and *total to its
+ * length. Return Z_OK, Z_DATA_ERROR, Z_BUF_ERROR if the deflate data ends
+ * early, Z_MEM_ERROR, Z_ERRNO if put() aborted, or Z_STREAM_ERROR before any
+ * output if threads is less than two, if the input is too short to be worth
+ * splitting, or if it is too long to count its bits in a z_size_t.
+ */
+int ZLIB_INTERNAL par_inflate(const unsigned char *buf, z_size_t len,
+                              unsigned threads,
+                              int (*put)(voidpf, const unsigned char *,
+                                         z_size_t),
+                              voidpf arg, z_size_t *used, uLong *crc,
+                              z_size_t *total) {
+    int ret;
+    unsigned n, k, j, width;
+    z_size_t pos;
+    spec_wave wave;
+    spec_part *part;
+
+    if (threads < 2 || len < 2 * SPEC_CHUNK || len > ((z_size_t)-1 >> 4))
+        return Z_STREAM_ERROR;
+    part = (spec_part *)calloc(threads, sizeof(spec_part));
+    if (part == NULL)
+        return Z_MEM_ERROR;
+    wave.buf = buf;
+    wave.len = len;
+    wave.part = part;
+
+    *crc = crc32(0L, Z_NULL, 0);
+    *total = 0;
+    pos = 0;
+    width = threads;
+    part[0].wlen = 0;
+    for (;;) {
+        /* decode a wave of parts, the first from pos */
+        for (n = 0; n < width; n++) {
+            part[n].from = (pos >> 3) + n * SPEC_CHUNK;
+            if (n && part[n].from >= len)
+                break;
+        }
+        part[0].in = pos;
+        par_run(threads, n, spec_run, &wave);
+        ret = part[0].ret;
+        if (ret != Z_OK)
+            break;
+
+        /* keep the parts that start where the part before them ended, and
+           give each its window -- if not even the second part could be
+           decoded from anywhere, then stop guessing, since looking through
+           data with no block boundaries to find is slow */
+        for (k = 1; k < n && part[k].ret == Z_OK && !part[k - 1].last &&
+                    (part[k].in == part[k - 1].end ||
+                     (spec_stored(buf, len, part[k].in) &&
+                      spec_stored(buf, len, part[k].in) ==
+                      spec_stored(buf, len, part[k - 1].end))); k++)
+            part[k].wlen = spec_window(part + k - 1, part[k].win);
+        if (n > 1 && part[1].ret == Z_DATA_ERROR)
+            width = 1;
+        par_run(threads, k, spec_resolve, &wave);
+
+        /* deliver the output in order */
+        for (j = 0; j < k; j++) {
+            ret = part[j].ret;
+            if (ret != Z_OK)
+                break;
+            if (part[j].have && put(arg, part[j].out, part[j].have)) {
+                ret = Z_ERRNO;
+                break;
+            }
+            *crc = crc32_combine(*crc, part[j].crc, (z_off_t)part[j].have);
+            *total += part[j].have;
+        }
+        if (ret != Z_OK)
+            break;
+        if (part[k - 1].last) {
+            *used = (part[k - 1].end + 7) >> 3;
+            break;
+        }
+        pos = part[k - 1].end;
+        if (k > 1) {
+            part[0].wlen = spec_window(part + k - 1, part[0].win);
+            continue;
+        }
+        part[1].wlen = spec_window(part, part[1].win);     /* no overlap */
+        zmemcpy(part[0].win, part[1].win, SPEC_WIN);
+        part[0].wlen = part[1].wlen;
+    }
+
+    for (j = 0; j < threads; j++) {
+        free(part[j].sym);
+        free(part[j].out);
+    }
+    free(part);
+    return ret;
+}
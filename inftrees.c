@@ -66,6 +66,17 @@ int ZLIB_INTERNAL inflate_table(codetype type, unsigned short FAR *lens,
         16, 16, 16, 16, 17, 17, 18, 18, 19, 19, 20, 20, 21, 21, 22, 22,
         23, 23, 24, 24, 25, 25, 26, 26, 27, 27,
         28, 28, 29, 29, 64, 64};
+    static const unsigned short lbase64[31] = { /* Deflate64 length base */
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+        35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 0, 0, 0};
+    static const unsigned short dbase64[32] = { /* Deflate64 distance base */
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+        257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+        8193, 12289, 16385, 24577, 32769, 49153};
+    static const unsigned short dext64[32] = { /* Deflate64 distance extra */
+        16, 16, 16, 16, 17, 17, 18, 18, 19, 19, 20, 20, 21, 21, 22, 22,
+        23, 23, 24, 24, 25, 25, 26, 26, 27, 27,
+        28, 28, 29, 29, 30, 30};
 
     /*
        Process a set of code lengths to create a canonical Huffman code.  The
@@ -162,8 +173,9 @@ int ZLIB_INTERNAL inflate_table(codetype type, unsigned short FAR *lens,
 
        used keeps track of how many table entries have been allocated from the
        provided *table space.  It is checked for LENS and DIST tables against
-       the constants ENOUGH_LENS and ENOUGH_DISTS to guard against changes in
-       the initial root table size constants.  See the comments in inftrees.h
+       the constants ENOUGH_LENS (ENOUGH_LENS_WIDE for a root over 9 bits) and
+       ENOUGH_DISTS to guard against changes in the initial root table size
+       constants.  See the comments in inftrees.h
        for more information.
 
        sym increments through all symbols, and the loop terminates when
@@ -183,6 +195,16 @@ int ZLIB_INTERNAL inflate_table(codetype type, unsigned short FAR *lens,
         extra = lext;
         match = 257;
         break;
+    case LENS64:
+        base = lbase64;         /* length 285 has base 0 for 3 + 16 bits */
+        extra = lext;
+        match = 257;
+        break;
+    case DISTS64:
+        base = dbase64;
+        extra = dext64;
+        match = 0;
+        break;
     default:    /* DISTS */
         base = dbase;
         extra = dext;
@@ -201,8 +223,9 @@ int ZLIB_INTERNAL inflate_table(codetype type, unsigned short FAR *lens,
     mask = used - 1;            /* mask for comparing low */
 
     /* check available table space */
-    if ((type == LENS && used > ENOUGH_LENS) ||
-        (type == DISTS && used > ENOUGH_DISTS))
+    if (((type == LENS || type == LENS64) &&
+         used > (root > 9 ? ENOUGH_LENS_WIDE : ENOUGH_LENS)) ||
+        ((type == DISTS || type == DISTS64) && used > ENOUGH_DISTS))
         return 1;
 
     /* process all codes and make table entries */
@@ -270,8 +293,9 @@ int ZLIB_INTERNAL inflate_table(codetype type, unsigned short FAR *lens,
 
             /* check for enough space */
             used += 1U << curr;
-            if ((type == LENS && used > ENOUGH_LENS) ||
-                (type == DISTS && used > ENOUGH_DISTS))
+            if (((type == LENS || type == LENS64) &&
+                 used > (root > 9 ? ENOUGH_LENS_WIDE : ENOUGH_LENS)) ||
+                ((type == DISTS || type == DISTS64) && used > ENOUGH_DISTS))
                 return 1;
 
             /* point entry in root table to sub-table */
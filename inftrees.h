@@ -33,28 +33,43 @@ typedef struct {
     0001eeee - length or distance, eeee is the number of extra bits
     01100000 - end of block
     01000000 - invalid code
+
+   For Deflate64 (LENS64), length code 285 has op 00010000 and val 0, since
+   its 16 extra bits do not fit in eeee.  The decoder uses base 3 and 16 extra
+   bits for that entry.  No other length has a base of 0.
  */
 
 /* Maximum size of the dynamic table.  The maximum number of code structures is
-   1444, which is the sum of 852 for literal/length codes and 592 for distance
+   1446, which is the sum of 852 for literal/length codes and 594 for distance
    codes.  These values were found by exhaustive searches using the program
    examples/enough.c found in the zlib distribution.  The arguments to that
    program are the number of symbols, the initial root table size, and the
    maximum bit length of a code.  "enough 286 9 15" for literal/length codes
-   returns 852, and "enough 30 6 15" for distance codes returns 592. The
-   initial root table size (9 or 6) is found in the fifth argument of the
-   inflate_table() calls in inflate.c and infback.c.  If the root table size is
-   changed, then these maximum sizes would be need to be recalculated and
-   updated. */
+   returns 852, and "enough 32 6 15" for the 32 Deflate64 distance codes
+   returns 594 (592 for the 30 deflate distance codes).  The initial root
+   table size (9 or 6) is found in the fifth argument of the inflate_table()
+   calls in inflate.c and infback.c.  If the root table size is changed, then
+   these maximum sizes would be need to be recalculated and updated. */
 #define ENOUGH_LENS 852
-#define ENOUGH_DISTS 592
+#define ENOUGH_DISTS 594
 #define ENOUGH (ENOUGH_LENS+ENOUGH_DISTS)
 
+/* Maximum size of the dynamic table with the larger root tables that can be
+   requested with inflateTune(), which are kept in a separate allocation of
+   ENOUGH_WIDE codes.  "enough 286 11 15" returns 2340 for a literal/length
+   root table size of 11 (and "enough 286 10 15" returns 1332).  "enough 30 7
+   15" and "enough 30 8 15" both return 400, and "enough 32 7 15" and "enough
+   32 8 15" both return 402, less than ENOUGH_DISTS. */
+#define ENOUGH_LENS_WIDE 2340
+#define ENOUGH_WIDE (ENOUGH_LENS_WIDE+ENOUGH_DISTS)
+
 /* Type of code to build for inflate_table() */
 typedef enum {
     CODES,
     LENS,
-    DISTS
+    DISTS,
+    LENS64,     /* Deflate64 lengths */
+    DISTS64     /* Deflate64 distances */
 } codetype;
 
 int ZLIB_INTERNAL inflate_table(codetype type, unsigned short FAR *lens,
@@ -0,0 +1,897 @@
+/* join.c -- join zlib streams or gzip members without recompressing them
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/*
+ *  ALGORITHM
+ *
+ *      Deflate blocks are simply strung together, so two deflate streams can
+ *      be joined by clearing the last-block bit of the final block of the
+ *      first stream and appending the second. The first stream has to end on
+ *      a byte boundary for the second to be appended as is. If it does not,
+ *      then an empty stored block is added after its final block, which pads
+ *      it to a byte boundary, just as a Z_SYNC_FLUSH does. The check value of
+ *      the joined data is made from the check values in the trailers with
+ *      crc32_combine() or adler32_combine().
+ *
+ *      Finding the final block, and where it ends, requires decoding the
+ *      Huffman codes of each stream. That is done by scan(), which decodes the
+ *      codes and skips over the extra bits, but does not copy anything or keep
+ *      a window, and skips stored blocks altogether. This takes a fraction of
+ *      the time of inflate(). The data is otherwise assumed to be valid, since
+ *      the check values are not verified -- that would need a full inflate.
+ *      Only what scan() needs to find its way through the data is checked,
+ *      along with the lengths in the gzip trailers.
+ *
+ *      gzipNormalize() does the same for the members of a gzip stream as the
+ *      input arrives from in(), but as gznorm does, it shifts each member's
+ *      data to follow the last at any bit, and starts stored blocks on a byte
+ *      boundary, instead of padding. The copying is done as scan() reaches
+ *      each block header, and before each new input buffer, so nothing is
+ *      held back. Bytes are copied eight at a time with a shift, or given to
+ *      out() as they are when no shift is needed.
+ */
+
+#include "zutil.h"
+#include "inftrees.h"
+#include "inffixed.h"
+
+/*
+   On 64-bit little-endian processors, hold is refilled with eight bytes at a
+   time while there are at least eight bytes of input left, as in inffast.c.
+   That leaves at least 56 bits in hold, which is more than the 48 bits that a
+   length/distance pair can use, so the codes can then be decoded without
+   checking for input.  The refill loads bits into hold above the count in
+   bits, which are the correct next input bits, so PULLBYTE() uses |=.
+ */
+#if defined(Z_U8) && defined(HAVE_MEMCPY) && \
+    (defined(__x86_64__) || defined(_M_X64) || \
+     (defined(__aarch64__) && defined(__AARCH64EL__)))
+#  define JOIN_HOLD64
+   typedef Z_U8 hold_t;
+#  define REFILL() \
+    do { \
+        hold_t word; \
+        zmemcpy((Bytef *)&word, next, sizeof(word)); \
+        hold |= word << bits; \
+        next += (63 - bits) >> 3; \
+        bits |= 56; \
+    } while (0)
+#else
+   typedef unsigned long hold_t;
+#endif
+
+typedef struct join_norm_s join_norm;
+
+/* Space for the code tables used by scan(), and its input */
+typedef struct {
+    unsigned short lens[320];   /* code lengths */
+    unsigned short work[288];   /* work area for inflate_table() */
+    code codes[ENOUGH];         /* dynamic tables */
+    const unsigned char FAR *buf;   /* input, where bit positions are from */
+    const unsigned char FAR *next;  /* next input byte */
+    const unsigned char FAR *end;   /* end of input */
+    hold_t hold;                /* bit buffer */
+    unsigned bits;              /* bits in bit buffer */
+    join_norm *norm;            /* gzipNormalize() state, or NULL */
+} join_scan;
+
+/* Sizes for gzipNormalize() */
+#define JOIN_OUT 16384          /* output buffer */
+#define JOIN_DIRECT 256         /* aligned copies this long skip the buffer */
+#define JOIN_PIECE 0x1000000UL  /* most input used at once, so that bit
+                                   offsets fit in a long */
+
+/* State of gzipNormalize(). The deflate data is copied from the input, from
+   the bit offset from, counted from scan.buf, to where each block header is
+   changed. Offsets before scan.buf are in lead, which has the bits that were
+   in the bit buffer when scan.buf was loaded. */
+struct join_norm_s {
+    join_scan scan;             /* scanner and input */
+    in_func in;                 /* input function and descriptor */
+    void FAR *in_desc;
+    out_func out;               /* output function and descriptor */
+    void FAR *out_desc;
+    unsigned left;              /* input from in() after scan.end */
+    int copy;                   /* true while copying deflate data */
+    long from;                  /* bit offset of the input not yet copied */
+    hold_t lead;                /* bits before scan.buf */
+    unsigned lead_bits;         /* number of bits in lead */
+    unsigned long ohold;        /* output bits not yet in obuf */
+    unsigned obits;             /* number of bits in ohold */
+    unsigned ohave;             /* bytes in obuf */
+    unsigned char obuf[JOIN_OUT];   /* output buffer */
+};
+
+local int norm_more(join_norm *n);
+local int norm_block(join_norm *n, int final, unsigned type);
+
+/* Load and save the input state of scan() */
+#define LOAD() \
+    do { \
+        next = s->next; \
+        end = s->end; \
+        hold = s->hold; \
+        bits = s->bits; \
+    } while (0)
+#define SAVE() \
+    do { \
+        s->next = next; \
+        s->end = end; \
+        s->hold = hold; \
+        s->bits = bits; \
+    } while (0)
+
+/* Get more input for scan() from gzipNormalize(), or return from scan() with
+   Z_DATA_ERROR if the input has run out, or Z_BUF_ERROR if out() failed */
+#define MORE() \
+    do { \
+        if (s->norm == NULL) return Z_DATA_ERROR; \
+        SAVE(); \
+        ret = norm_more(s->norm); \
+        if (ret != Z_OK) return ret; \
+        LOAD(); \
+    } while (0)
+
+/* Bit buffer macros, like those in inflate.c, on the local variables next,
+   end, hold, and bits of scan() */
+#define PULLBYTE() \
+    do { \
+        if (next == end) MORE(); \
+        hold |= (hold_t)(*next++) << bits; \
+        bits += 8; \
+    } while (0)
+#define NEEDBITS(n) \
+    do { \
+        while (bits < (unsigned)(n)) PULLBYTE(); \
+    } while (0)
+#define BITS(n) \
+    ((unsigned)hold & ((1U << (n)) - 1))
+#define DROPBITS(n) \
+    do { \
+        hold >>= (n); \
+        bits -= (unsigned)(n); \
+    } while (0)
+
+/* Position of the next bit in the input, counted from s->buf */
+#define BITPOS() \
+    ((uLong)(next - s->buf) * 8 - bits)
+
+/* Decode one code with the table t of root bits into here, pulling input as
+   needed, and with a second-level lookup if needed, as inflate() does */
+#define DECODE(here, t, root) \
+    do { \
+        for (;;) { \
+            here = (t)[BITS(root)]; \
+            if ((unsigned)(here.bits) <= bits) break; \
+            PULLBYTE(); \
+        } \
+        if (here.op && (here.op & 0xf0) == 0) { \
+            code last_ = here; \
+            for (;;) { \
+                here = (t)[last_.val + (BITS(last_.bits + last_.op) >> \
+                                        last_.bits)]; \
+                if ((unsigned)(last_.bits + here.bits) <= bits) break; \
+                PULLBYTE(); \
+            } \
+            DROPBITS(last_.bits); \
+        } \
+        DROPBITS(here.bits); \
+    } while (0)
+
+/* Decode one code with the table t of root bits into here, when there are
+   enough bits in hold for any code, as inflate_fast() does */
+#define FASTDECODE(here, t, root) \
+    do { \
+        here = (t)[BITS(root)]; \
+        if (here.op && (here.op & 0xf0) == 0) { \
+            DROPBITS(here.bits); \
+            here = (t)[here.val + BITS(here.op)]; \
+        } \
+        DROPBITS(here.bits); \
+    } while (0)
+
+/* ===========================================================================
+ * Scan the deflate data at s->next, up to s->end, or with more input from
+ * gzipNormalize() if s->norm is not NULL. On success, *last is set to the bit
+ * position of the last-block bit of the final block, *end to the bit position
+ * just after that block, and *total to the length of the uncompressed data,
+ * and the input state is saved in s. Return Z_OK, or Z_DATA_ERROR if the
+ * deflate data is invalid or incomplete, or what norm_block() or norm_more()
+ * returned if not Z_OK.
+ */
+local int scan(join_scan *s, uLong *last, uLong *stop, z_off_t *total) {
+    const unsigned char FAR *next;  /* next input byte */
+    const unsigned char FAR *end;   /* end of input */
+    hold_t hold;                /* bit buffer */
+    unsigned bits;              /* bits in bit buffer */
+    int final, ret;
+    unsigned type, nlen, ndist, ncode, have, lenbits, distbits, op, copy;
+    unsigned dist;
+    z_off_t out;
+    code here;
+    code const FAR *lcode;
+    code const FAR *dcode;
+    code FAR *codes;
+    static const unsigned short order[19] =
+        {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+    LOAD();
+    out = 0;
+    do {
+        /* block header */
+        *last = BITPOS();
+        NEEDBITS(3);
+        final = (int)BITS(1);
+        type = BITS(3) >> 1;
+        if (s->norm != NULL) {
+            if (final && type == 1)
+                NEEDBITS(10);           /* to see if it is empty */
+            SAVE();
+            ret = norm_block(s->norm, final, type);
+            if (ret != Z_OK)
+                return ret;
+        }
+        DROPBITS(3);
+
+        if (type == 0) {
+            /* stored block -- go to the byte boundary and skip the data */
+            DROPBITS(bits & 7);
+            NEEDBITS(32);
+            copy = BITS(16);
+            DROPBITS(16);
+            if ((copy ^ 0xffff) != BITS(16))
+                return Z_DATA_ERROR;
+            DROPBITS(16);
+            out += copy;
+            while (copy && bits) {
+                DROPBITS(8);
+                copy--;
+            }
+            if (copy)
+                hold = 0;               /* drop any bits of *next */
+            while ((unsigned long)(end - next) < copy) {
+                copy -= (unsigned)(end - next);
+                next = end;
+                MORE();
+            }
+            next += copy;
+            continue;
+        }
+        if (type == 1) {
+            lcode = lenfix;
+            lenbits = 9;
+            dcode = distfix;
+            distbits = 5;
+        }
+        else if (type == 2) {
+            /* dynamic block -- read the code lengths and build the tables,
+               as inflate() does */
+            NEEDBITS(14);
+            nlen = BITS(5) + 257;
+            DROPBITS(5);
+            ndist = BITS(5) + 1;
+            DROPBITS(5);
+            ncode = BITS(4) + 4;
+            DROPBITS(4);
+            if (nlen > 286 || ndist > 30)
+                return Z_DATA_ERROR;
+            for (have = 0; have < ncode; have++) {
+                NEEDBITS(3);
+                s->lens[order[have]] = (unsigned short)BITS(3);
+                DROPBITS(3);
+            }
+            while (have < 19)
+                s->lens[order[have++]] = 0;
+            codes = s->codes;
+            lcode = (code const FAR *)codes;
+            lenbits = 7;
+            if (inflate_table(CODES, s->lens, 19, &codes, &lenbits, s->work))
+                return Z_DATA_ERROR;
+            have = 0;
+            while (have < nlen + ndist) {
+                DECODE(here, lcode, lenbits);
+                if (here.val < 16)
+                    s->lens[have++] = here.val;
+                else {
+                    if (here.val == 16) {
+                        NEEDBITS(2);
+                        if (have == 0)
+                            return Z_DATA_ERROR;
+                        op = s->lens[have - 1];
+                        copy = 3 + BITS(2);
+                        DROPBITS(2);
+                    }
+                    else if (here.val == 17) {
+                        NEEDBITS(3);
+                        op = 0;
+                        copy = 3 + BITS(3);
+                        DROPBITS(3);
+                    }
+                    else {
+                        NEEDBITS(7);
+                        op = 0;
+                        copy = 11 + BITS(7);
+                        DROPBITS(7);
+                    }
+                    if (have + copy > nlen + ndist)
+                        return Z_DATA_ERROR;
+                    while (copy--)
+                        s->lens[have++] = (unsigned short)op;
+                }
+            }
+            if (s->lens[256] == 0)
+                return Z_DATA_ERROR;
+            codes = s->codes;
+            lcode = (code const FAR *)codes;
+            lenbits = 9;
+            if (inflate_table(LENS, s->lens, nlen, &codes, &lenbits, s->work))
+                return Z_DATA_ERROR;
+            dcode = (code const FAR *)codes;
+            distbits = 6;
+            if (inflate_table(DISTS, s->lens + nlen, ndist, &codes, &distbits,
+                              s->work))
+                return Z_DATA_ERROR;
+        }
+        else
+            return Z_DATA_ERROR;
+
+        /* run through the codes up to the end-of-block code, counting the
+           output bytes and checking that distances stay in the data */
+        for (;;) {
+#ifdef JOIN_HOLD64
+            if (bits < 48 && end - next >= 8)
+                REFILL();
+            if (bits >= 48) {
+                FASTDECODE(here, lcode, lenbits);
+                op = here.op;
+                if (op == 0) {
+                    out++;
+                    continue;
+                }
+                if (op & 32)
+                    break;
+                if (op & 64)
+                    return Z_DATA_ERROR;
+                op &= 15;
+                copy = here.val + BITS(op);
+                DROPBITS(op);
+                FASTDECODE(here, dcode, distbits);
+                if (here.op & 64)
+                    return Z_DATA_ERROR;
+                op = here.op & 15;
+                dist = here.val + BITS(op);
+                DROPBITS(op);
+                if ((z_off_t)dist > out)
+                    return Z_DATA_ERROR;
+                out += copy;
+                continue;
+            }
+#endif
+            DECODE(here, lcode, lenbits);
+            op = here.op;
+            if (op == 0) {
+                out++;
+                continue;
+            }
+            if (op & 32)
+                break;
+            if (op & 64)
+                return Z_DATA_ERROR;
+            op &= 15;
+            NEEDBITS(op);
+            copy = here.val + BITS(op);
+            DROPBITS(op);
+            DECODE(here, dcode, distbits);
+            if (here.op & 64)
+                return Z_DATA_ERROR;
+            op = here.op & 15;
+            NEEDBITS(op);
+            dist = here.val + BITS(op);
+            DROPBITS(op);
+            if ((z_off_t)dist > out)
+                return Z_DATA_ERROR;
+            out += copy;
+        }
+    } while (!final);
+    *stop = BITPOS();
+    *total = out;
+    SAVE();
+    return Z_OK;
+}
+
+/* ===========================================================================
+ * Return the length of the zlib (wrap == 1) or gzip (wrap == 2) header at
+ * buf, or zero if it is not a valid header of that kind.
+ */
+local uLong join_head(const unsigned char *buf, uLong len, int wrap) {
+    uLong have;
+    unsigned flags, n;
+
+    if (wrap == 1)
+        return len >= 2 && (buf[0] & 0xf) == Z_DEFLATED &&
+               (buf[0] >> 4) <= 7 && (buf[1] & 0x20) == 0 &&
+               ((unsigned)buf[0] << 8 | buf[1]) % 31 == 0 ? 2 : 0;
+    if (len < 10 || buf[0] != 31 || buf[1] != 139 || buf[2] != Z_DEFLATED ||
+        (buf[3] & 0xe0))
+        return 0;
+    flags = buf[3];
+    have = 10;
+    if (flags & 4) {                    /* extra field */
+        if (len - have < 2)
+            return 0;
+        n = buf[have] + ((unsigned)buf[have + 1] << 8);
+        have += 2;
+        if (len - have < n)
+            return 0;
+        have += n;
+    }
+    for (n = 8; n <= 16; n <<= 1)       /* file name, then comment */
+        if (flags & n) {
+            do {
+                if (have == len)
+                    return 0;
+            } while (buf[have++]);
+        }
+    if (flags & 2) {                    /* header crc */
+        if (len - have < 2)
+            return 0;
+        have += 2;
+    }
+    return have;
+}
+
+/* Get a four-byte check value or length, little-endian for gzip */
+local uLong join_get4(const unsigned char *p, int wrap) {
+    return wrap == 2 ?
+        (uLong)p[0] | ((uLong)p[1] << 8) | ((uLong)p[2] << 16) |
+            ((uLong)p[3] << 24) :
+        ((uLong)p[0] << 24) | ((uLong)p[1] << 16) | ((uLong)p[2] << 8) |
+            (uLong)p[3];
+}
+
+/* Put a four-byte check value or length, little-endian for gzip */
+local void join_put4(unsigned char *p, uLong val, int wrap) {
+    int n;
+
+    for (n = 0; n < 4; n++) {
+        p[wrap == 2 ? n : 3 - n] = (unsigned char)val;
+        val >>= 8;
+    }
+}
+
+/* ========================================================================= */
+int ZEXPORT compressJoin(Bytef *dest, uLongf *destLen,
+                         const Bytef * const *sources, const uLong *sourceLens,
+                         unsigned count) {
+    join_scan *s;
+    int wrap, ret;
+    unsigned n, pad, cinfo;
+    uLong size, have, head, last, end, bytes, check, part;
+    z_off_t total, length;
+    const unsigned char *buf;
+
+    if (dest == Z_NULL || destLen == Z_NULL || sources == Z_NULL ||
+        sourceLens == Z_NULL || count == 0)
+        return Z_STREAM_ERROR;
+    for (n = 0; n < count; n++)
+        if (sources[n] == Z_NULL)
+            return Z_STREAM_ERROR;
+    wrap = sourceLens[0] >= 2 && sources[0][0] == 31 &&
+           sources[0][1] == 139 ? 2 : 1;
+    s = (join_scan *)malloc(sizeof(join_scan));
+    if (s == NULL)
+        return Z_MEM_ERROR;
+
+    size = *destLen;
+    have = 0;
+    check = 0;
+    length = 0;
+    cinfo = 0;
+    ret = Z_OK;
+    for (n = 0; n < count; n++) {
+        /* find the header, the end of the deflate data, and the trailer */
+        buf = sources[n];
+        head = join_head(buf, sourceLens[n], wrap);
+        if (head == 0) {
+            ret = Z_DATA_ERROR;
+            break;
+        }
+        s->buf = s->next = buf + head;
+        s->end = buf + sourceLens[n];
+        s->hold = 0;
+        s->bits = 0;
+        s->norm = NULL;
+        ret = scan(s, &last, &end, &total);
+        if (ret != Z_OK)
+            break;
+        bytes = (end + 7) >> 3;
+        if (sourceLens[n] - head - bytes != (wrap == 2 ? 8 : 4) ||
+            (wrap == 2 &&
+             join_get4(buf + head + bytes + 4, 2) != ((uLong)total & 0xffffffff))) {
+            ret = Z_DATA_ERROR;
+            break;
+        }
+        part = join_get4(buf + head + bytes, wrap);
+        if (wrap == 1 && (unsigned)(buf[0] >> 4) > cinfo)
+            cinfo = buf[0] >> 4;
+
+        /* copy the header of the first stream, and the deflate data of each,
+           with the last-block bit cleared and an empty stored block after
+           the final block if it does not end on a byte boundary */
+        pad = n == count - 1 || (end & 7) == 0 ? 0 : (end & 7) > 5 ? 5 : 4;
+        if (size - have < (n ? 0 : head) + bytes + pad) {
+            ret = Z_BUF_ERROR;
+            break;
+        }
+        if (n == 0) {
+            zmemcpy(dest, buf, head);
+            have = head;
+            check = part;
+        }
+        else
+            check = wrap == 2 ? crc32_combine(check, part, total) :
+                                adler32_combine(check, part, total);
+        zmemcpy(dest + have, buf + head, bytes);
+        if (n < count - 1) {
+            dest[have + (last >> 3)] &= ~(1 << (last & 7));
+            if (end & 7) {
+                dest[have + bytes - 1] &= (1 << (end & 7)) - 1;
+                if (pad == 5)
+                    dest[have + bytes++] = 0;
+                dest[have + bytes++] = 0;
+                dest[have + bytes++] = 0;
+                dest[have + bytes++] = 0xff;
+                dest[have + bytes++] = 0xff;
+            }
+        }
+        have += bytes;
+        length += total;
+    }
+    free(s);
+
+    /* write the trailer, and for zlib make the window size in the header
+       large enough for all of the streams */
+    if (ret == Z_OK) {
+        if (size - have < (wrap == 2 ? 8 : 4))
+            return Z_BUF_ERROR;
+        join_put4(dest + have, check, wrap);
+        have += 4;
+        if (wrap == 2) {
+            join_put4(dest + have, (uLong)length & 0xffffffff, 2);
+            have += 4;
+        }
+        else {
+            dest[0] = (Bytef)((cinfo << 4) | Z_DEFLATED);
+            dest[1] &= 0xe0;
+            dest[1] |= 31 - ((unsigned)dest[0] << 8 | dest[1]) % 31;
+        }
+        *destLen = have;
+    }
+    return ret;
+}
+
+/* ===========================================================================
+ * Write the output buffer with out(). Return Z_OK, or Z_BUF_ERROR if out()
+ * failed.
+ */
+local int norm_flush(join_norm *n) {
+    if (n->ohave && n->out(n->out_desc, n->obuf, n->ohave))
+        return Z_BUF_ERROR;
+    n->ohave = 0;
+    return Z_OK;
+}
+
+/* ===========================================================================
+ * Write the low len bits of val, where len is at most 16.
+ */
+local int norm_bits(join_norm *n, unsigned long val, unsigned len) {
+    n->ohold |= (val & ((1UL << len) - 1)) << n->obits;
+    n->obits += len;
+    while (n->obits >= 8) {
+        if (n->ohave == JOIN_OUT && norm_flush(n) != Z_OK)
+            return Z_BUF_ERROR;
+        n->obuf[n->ohave++] = (unsigned char)n->ohold;
+        n->ohold >>= 8;
+        n->obits -= 8;
+    }
+    return Z_OK;
+}
+
+/* ===========================================================================
+ * Write the len bytes at p after the bits in ohold, which shifts each byte up
+ * by obits. Long runs that need no shift are given to out() as they are.
+ */
+local int norm_bytes(join_norm *n, const unsigned char FAR *p, unsigned len) {
+    unsigned shift = n->obits;
+
+    if (shift == 0 && len >= JOIN_DIRECT) {
+        if (norm_flush(n) != Z_OK ||
+            n->out(n->out_desc, (unsigned char FAR *)p, len))
+            return Z_BUF_ERROR;
+        return Z_OK;
+    }
+#ifdef JOIN_HOLD64
+    while (len >= 8) {
+        hold_t word, put;
+
+        if (JOIN_OUT - n->ohave < 8 && norm_flush(n) != Z_OK)
+            return Z_BUF_ERROR;
+        zmemcpy((Bytef *)&word, p, sizeof(word));
+        put = (hold_t)n->ohold | (word << shift);
+        zmemcpy(n->obuf + n->ohave, (Bytef *)&put, sizeof(put));
+        n->ohave += 8;
+        n->ohold = shift ? (unsigned long)(word >> (64 - shift)) : 0;
+        p += 8;
+        len -= 8;
+    }
+#endif
+    while (len--) {
+        if (n->ohave == JOIN_OUT && norm_flush(n) != Z_OK)
+            return Z_BUF_ERROR;
+        n->ohold |= (unsigned long)(*p++) << shift;
+        n->obuf[n->ohave++] = (unsigned char)n->ohold;
+        n->ohold >>= 8;
+    }
+    return Z_OK;
+}
+
+/* ===========================================================================
+ * Copy the input bits from n->from up to the bit offset to.
+ */
+local int norm_copy(join_norm *n, long to) {
+    long at = n->from;
+    const unsigned char FAR *p;
+    unsigned len;
+    int ret = Z_OK;
+
+    if (at >= to)
+        return Z_OK;
+    n->from = to;
+
+    /* bits that were in the bit buffer when the input was loaded */
+    while (at < 0 && at < to && ret == Z_OK) {
+        len = (unsigned)((to < 0 ? to : 0) - at);
+        if (len > 16)
+            len = 16;
+        ret = norm_bits(n, (unsigned long)(n->lead >> (n->lead_bits + at)),
+                        len);
+        at += len;
+    }
+    if (at >= to || ret != Z_OK)
+        return ret;
+
+    /* bits in the input, with the bytes between copied in bulk */
+    p = n->scan.buf + (at >> 3);
+    if (at & 7) {
+        len = 8 - (unsigned)(at & 7);
+        if (len > to - at)
+            len = (unsigned)(to - at);
+        ret = norm_bits(n, (unsigned long)(*p++ >> (at & 7)), len);
+        at += len;
+        if (at >= to || ret != Z_OK)
+            return ret;
+    }
+    len = (unsigned)((to - at) >> 3);
+    ret = norm_bytes(n, p, len);
+    if (ret == Z_OK && ((to - at) & 7))
+        ret = norm_bits(n, p[len], (unsigned)((to - at) & 7));
+    return ret;
+}
+
+/* ===========================================================================
+ * Load more input, after copying the deflate data up to where it was used.
+ * Return Z_OK, Z_DATA_ERROR at the end of the input, or Z_BUF_ERROR if out()
+ * failed.
+ */
+local int norm_more(join_norm *n) {
+    join_scan *s = &n->scan;
+    long size = (long)(s->end - s->buf) * 8;
+    z_const unsigned char FAR *got;
+    const unsigned char FAR *next;
+    unsigned len;
+    int ret;
+
+    if (n->copy) {
+        ret = norm_copy(n, size - (long)s->bits);
+        if (ret != Z_OK)
+            return ret;
+        n->from -= size;
+    }
+    n->lead = s->hold;
+    n->lead_bits = s->bits;
+    if (n->left) {
+        next = s->end;
+        len = n->left;
+    }
+    else {
+        len = n->in(n->in_desc, &got);
+        if (len == 0 || got == Z_NULL)
+            return Z_DATA_ERROR;
+        next = got;
+    }
+    n->left = len > JOIN_PIECE ? len - (unsigned)JOIN_PIECE : 0;
+    s->buf = s->next = next;
+    s->end = next + (len - n->left);
+    return Z_OK;
+}
+
+/* ===========================================================================
+ * Copy the deflate data up to the header of a block, and write the header
+ * with the last-block bit cleared. A stored block is started at a byte
+ * boundary, and a final empty block with fixed codes is dropped. scan() has
+ * saved its state with the header at the bottom of the bit buffer.
+ */
+local int norm_block(join_norm *n, int final, unsigned type) {
+    join_scan *s = &n->scan;
+    long at = (long)(s->next - s->buf) * 8 - (long)s->bits;
+    int ret;
+
+    ret = norm_copy(n, at);
+    if (ret != Z_OK)
+        return ret;
+    if (final && type == 1 && (s->hold & 0x3ff) == 3) {
+        n->from = at + 10;
+        return Z_OK;
+    }
+    ret = norm_bits(n, type << 1, 3);
+    if (type == 0) {
+        if (ret == Z_OK && n->obits)
+            ret = norm_bits(n, 0, 8 - n->obits);
+        n->from = (at + 3 + 7) & ~7L;
+    }
+    else
+        n->from = at + 3;
+    return ret;
+}
+
+/* ===========================================================================
+ * Return the next byte of a gzip header or trailer, or -1 at the end of the
+ * input. The bit buffer must be at a byte boundary.
+ */
+local int norm_byte(join_norm *n) {
+    join_scan *s = &n->scan;
+    int c;
+
+    if (s->bits) {
+        c = (int)(s->hold & 0xff);
+        s->hold >>= 8;
+        s->bits -= 8;
+        return c;
+    }
+    s->hold = 0;                        /* drop any bits of *next */
+    if (s->next == s->end && norm_more(n) != Z_OK)
+        return -1;
+    return *s->next++;
+}
+
+/* ===========================================================================
+ * Skip len bytes of a gzip header, or through a zero byte if len is zero.
+ */
+local int norm_skip(join_norm *n, unsigned len) {
+    int c;
+
+    do {
+        c = norm_byte(n);
+        if (c == -1)
+            return Z_DATA_ERROR;
+    } while (len ? --len != 0 : c != 0);
+    return Z_OK;
+}
+
+/* ===========================================================================
+ * Get a four-byte little-endian value from a gzip trailer into *val.
+ */
+local int norm_get4(join_norm *n, uLong *val) {
+    int c, k;
+
+    *val = 0;
+    for (k = 0; k < 32; k += 8) {
+        c = norm_byte(n);
+        if (c == -1)
+            return Z_DATA_ERROR;
+        *val |= (uLong)c << k;
+    }
+    return Z_OK;
+}
+
+/* ========================================================================= */
+int ZEXPORT gzipNormalize(in_func in, void FAR *in_desc,
+                          out_func out, void FAR *out_desc) {
+    join_norm *n;
+    join_scan *s;
+    int ret, c, k;
+    unsigned flags;
+    uLong last, stop, crc, len, check, size;
+    z_off_t total;
+
+    if (in == Z_NULL || out == Z_NULL)
+        return Z_STREAM_ERROR;
+    n = (join_norm *)malloc(sizeof(join_norm));
+    if (n == NULL)
+        return Z_MEM_ERROR;
+    s = &n->scan;
+    s->buf = s->next = s->end = n->obuf;
+    s->hold = 0;
+    s->bits = 0;
+    s->norm = n;
+    n->in = in;
+    n->in_desc = in_desc;
+    n->out = out;
+    n->out_desc = out_desc;
+    n->left = 0;
+    n->copy = 0;
+    n->from = 0;
+    n->lead = 0;
+    n->lead_bits = 0;
+    n->ohold = 0;
+    n->obits = 0;
+    n->ohave = 0;
+
+    /* gzip header with no name, time, or extra flags, and OS unknown */
+    ret = norm_bytes(n, (const unsigned char FAR *)
+                        "\037\213\010\0\0\0\0\0\0\377", 10);
+    crc = 0;
+    len = 0;
+    while (ret == Z_OK) {
+        /* skip the gzip header of the next member, if any */
+        c = norm_byte(n);
+        if (c == -1)
+            break;
+        if (c != 31 || norm_byte(n) != 139 || norm_byte(n) != Z_DEFLATED ||
+            ((c = norm_byte(n)) & 0xe0) != 0) {
+            ret = Z_DATA_ERROR;
+            break;
+        }
+        flags = (unsigned)c;
+        ret = norm_skip(n, 6);
+        if (ret == Z_OK && (flags & 4)) {           /* extra field */
+            c = norm_byte(n);
+            k = norm_byte(n);
+            ret = c == -1 || k == -1 ? Z_DATA_ERROR :
+                  c + k == 0 ? Z_OK : norm_skip(n, (unsigned)(c + (k << 8)));
+        }
+        for (k = 8; k <= 16; k <<= 1)               /* name, then comment */
+            if (ret == Z_OK && (flags & k))
+                ret = norm_skip(n, 0);
+        if (ret == Z_OK && (flags & 2))             /* header crc */
+            ret = norm_skip(n, 2);
+        if (ret != Z_OK)
+            break;
+
+        /* copy the deflate data, changing the block headers */
+        n->copy = 1;
+        n->from = (long)(s->next - s->buf) * 8 - (long)s->bits;
+        ret = scan(s, &last, &stop, &total);
+        if (ret == Z_OK)
+            ret = norm_copy(n, (long)(s->next - s->buf) * 8 - (long)s->bits);
+        n->copy = 0;
+        if (ret != Z_OK)
+            break;
+
+        /* combine the check value and length from the trailer */
+        s->hold >>= s->bits & 7;
+        s->bits -= s->bits & 7;
+        ret = norm_get4(n, &check);
+        if (ret == Z_OK)
+            ret = norm_get4(n, &size);
+        if (ret == Z_OK && size != ((uLong)total & 0xffffffff))
+            ret = Z_DATA_ERROR;
+        crc = crc32_combine(crc, check, total);
+        len += size;
+    }
+
+    /* end with an empty last block with fixed codes, and the trailer */
+    if (ret == Z_OK) {
+        ret = norm_bits(n, 3, 10);
+        if (ret == Z_OK && n->obits)
+            ret = norm_bits(n, 0, 8 - n->obits);
+        for (k = 0; k < 64 && ret == Z_OK; k += 8)
+            ret = norm_bits(n, (k < 32 ? crc >> k : len >> (k - 32)) & 0xff,
+                            8);
+        if (ret == Z_OK)
+            ret = norm_flush(n);
+    }
+    free(n);
+    return ret;
+}
@@ -0,0 +1,670 @@
+/* parallel.c -- compress a memory buffer using several threads
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/*
+ *  ALGORITHM
+ *
+ *      The input is cut into chunks of PAR_CHUNK bytes, and each chunk is
+ *      compressed as raw deflate data by its own z_stream. The dictionary of
+ *      every chunk but the first is set to the window's worth of input that
+ *      precedes it, so almost nothing is lost in compression with respect to
+ *      a single deflate stream. Every chunk but the last is ended with
+ *      Z_SYNC_FLUSH, which leaves the deflate data on a byte boundary without
+ *      setting the last-block bit, so the compressed chunks can simply be
+ *      concatenated. The check value of the whole input is made from the
+ *      check values of the chunks with crc32_combine() or adler32_combine().
+ *      The result is a single gzip member or zlib stream that any inflate()
+ *      can decode.
+ *
+ *      The compressed data depends only on the input and the parameters, not
+ *      on the number of threads used. Chunks are compressed in waves of one
+ *      chunk per thread, so the memory used is proportional to the number of
+ *      threads and not to the length of the input.
+ *
+ *  WORKERS
+ *
+ *      All of the parallel functions run their jobs with par_run(). The
+ *      threads that it starts are kept waiting for the next call, up to the
+ *      number set by zlibWorkers(), instead of being started and stopped for
+ *      every wave. Each kept worker has a pool of one deflate state that
+ *      par_compress() reuses from one chunk to the next. The state is
+ *      allocated by the worker that uses it, so with the usual first-touch
+ *      placement its memory is on that worker's NUMA node, and with affinity
+ *      on, the worker stays on one processor and so on that node. Jobs are
+ *      taken from a shared counter by whichever thread is free, so a slow
+ *      chunk does not hold up the others. An application can instead supply
+ *      its own threads with zlibExecutor().
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#  define _GNU_SOURCE   /* for CPU_SET() and pthread_setaffinity_np() */
+#endif
+
+#include "zutil.h"
+
+#ifdef Z_THREADS
+#  ifdef _WIN32
+#    ifndef WIN32_LEAN_AND_MEAN
+#      define WIN32_LEAN_AND_MEAN
+#    endif
+#    include <windows.h>
+#  else
+#    define PAR_KEEP    /* keep workers between calls */
+#    include <pthread.h>
+#    include <unistd.h>
+#    ifdef __linux__
+#      include <sched.h>
+#    endif
+#  endif
+#endif
+
+#define PAR_CHUNK 131072UL
+/* Uncompressed bytes per chunk. This is large enough that the cost of the
+   dictionary and the sync flush marker for each chunk is negligible. */
+
+/* ===========================================================================
+ * Run jobs 0..jobs-1 of func on up to threads threads, including the calling
+ * thread. Return when all of the jobs have completed. If threads cannot be
+ * created, then the remaining jobs are run on the calling thread. This is
+ * also used by gzuncompressParallel() in gzread.c and by par_inflate() in
+ * infpar.c.
+ */
+typedef void (*job_func)(voidpf arg, unsigned job);
+
+typedef struct {
+    job_func func;          /* function to run */
+    voidpf arg;             /* argument common to all jobs */
+    unsigned jobs;          /* number of jobs */
+#ifdef Z_THREADS
+#  ifdef _WIN32
+    volatile LONG next;     /* next job to run, less one */
+#  else
+    unsigned next;          /* next job to run */
+    pthread_mutex_t lock;   /* protect next */
+#  endif
+#endif
+} job_list;
+
+#ifdef Z_THREADS
+/* The executor set by zlibExecutor(), if any. */
+local z_executor par_exec = Z_NULL;
+local voidpf par_opaque = Z_NULL;
+
+int ZEXPORT zlibExecutor(z_executor exec, voidpf opaque) {
+    par_opaque = opaque;
+    par_exec = exec;
+    return Z_OK;
+}
+
+/* Take the next job from list, or return list->jobs if there are none left. */
+local unsigned next_job(job_list *list) {
+    unsigned job;
+
+#  ifdef _WIN32
+    job = (unsigned)InterlockedIncrement(&list->next);
+#  else
+    pthread_mutex_lock(&list->lock);
+    job = list->next;
+    if (job < list->jobs)
+        list->next++;
+    pthread_mutex_unlock(&list->lock);
+#  endif
+    return job < list->jobs ? job : list->jobs;
+}
+
+/* Run jobs from list until there are none left. */
+#  ifdef _WIN32
+local DWORD WINAPI run_list(LPVOID arg) {
+#  else
+local void *run_list(void *arg) {
+#  endif
+    job_list *list = (job_list *)arg;
+    unsigned job;
+
+    while ((job = next_job(list)) < list->jobs)
+        list->func(list->arg, job);
+    return 0;
+}
+
+/* run_list() with the type given to an executor. */
+local void run_exec(voidpf arg) {
+    run_list(arg);
+}
+
+#else /* !Z_THREADS */
+
+int ZEXPORT zlibExecutor(z_executor exec, voidpf opaque) {
+    (void)exec;
+    (void)opaque;
+    return Z_STREAM_ERROR;
+}
+
+#endif
+
+#ifdef PAR_KEEP
+/* The kept workers. Only one par_run() at a time can use them. Another that
+   starts while they are in use starts threads of its own. */
+typedef struct {
+    pthread_t tid;          /* thread id */
+    unsigned index;         /* position in the pool, for affinity */
+    z_poolp states;         /* deflate states for par_compress() */
+} par_worker;
+
+local struct {
+    pthread_mutex_t lock;   /* protects everything below */
+    pthread_cond_t work;    /* signaled when there is a list or at stop */
+    pthread_cond_t done;    /* signaled when busy goes to zero or at idle */
+    par_worker **worker;    /* workers started */
+    unsigned made;          /* number of workers started */
+    int keep;               /* maximum workers to keep, -1 for no limit */
+    int affinity;           /* true to pin each worker to a processor */
+    job_list *list;         /* list being run, or NULL when idle */
+    unsigned want;          /* workers still to be enlisted on list */
+    unsigned busy;          /* workers running list */
+    int stop;               /* true when the workers should exit */
+} par_pool = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+    PTHREAD_COND_INITIALIZER, NULL, 0, -1, 0, NULL, 0, 0, 0
+};
+
+/* Key for the par_worker of the calling thread. */
+local pthread_key_t par_key;
+local pthread_once_t par_once = PTHREAD_ONCE_INIT;
+local int par_keyed;
+
+local void par_key_init(void) {
+    par_keyed = pthread_key_create(&par_key, NULL) == 0;
+}
+
+/* Pin the calling thread to the index'th processor, modulo the number of
+   processors, of those it is allowed to run on. */
+local void par_pin(unsigned index) {
+#  if defined(__linux__) && defined(CPU_SET)
+    cpu_set_t set;
+    int cpu, count;
+
+    if (sched_getaffinity(0, sizeof(set), &set))
+        return;
+    count = CPU_COUNT(&set);
+    if (count < 2)
+        return;
+    index %= (unsigned)count;
+    for (cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        if (CPU_ISSET(cpu, &set) && index-- == 0) {
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+            return;
+        }
+#  else
+    (void)index;
+#  endif
+}
+
+/* Kept worker thread: run the lists it is given until told to stop. */
+local void *par_work(void *arg) {
+    par_worker *me = (par_worker *)arg;
+    job_list *list;
+
+    if (par_pool.affinity)
+        par_pin(me->index);
+    me->states = zlibPoolCreate(1);
+    if (par_keyed)
+        pthread_setspecific(par_key, me);
+    pthread_mutex_lock(&par_pool.lock);
+    for (;;) {
+        while (!par_pool.stop && (par_pool.list == NULL || par_pool.want == 0))
+            pthread_cond_wait(&par_pool.work, &par_pool.lock);
+        if (par_pool.stop)
+            break;
+        par_pool.want--;
+        par_pool.busy++;
+        list = par_pool.list;
+        pthread_mutex_unlock(&par_pool.lock);
+        run_list(list);
+        pthread_mutex_lock(&par_pool.lock);
+        if (--par_pool.busy == 0)
+            pthread_cond_broadcast(&par_pool.done);
+    }
+    pthread_mutex_unlock(&par_pool.lock);
+    zlibPoolDestroy(me->states);
+    return NULL;
+}
+
+/* Enlist up to helpers kept workers to run list, starting more as needed and
+   allowed. Return the number enlisted, which is zero if the workers are in
+   use by another par_run(). */
+local unsigned par_enlist(job_list *list, unsigned helpers) {
+    par_worker *me, **grow;
+
+    pthread_once(&par_once, par_key_init);
+    pthread_mutex_lock(&par_pool.lock);
+    if (par_pool.list != NULL || par_pool.stop) {
+        pthread_mutex_unlock(&par_pool.lock);
+        return 0;
+    }
+    if (par_pool.keep >= 0 && helpers > (unsigned)par_pool.keep)
+        helpers = (unsigned)par_pool.keep;
+    if (par_pool.made < helpers) {
+        grow = (par_worker **)realloc(par_pool.worker,
+                                      helpers * sizeof(par_worker *));
+        if (grow != NULL)
+            par_pool.worker = grow;
+        while (grow != NULL && par_pool.made < helpers) {
+            me = (par_worker *)malloc(sizeof(par_worker));
+            if (me == NULL)
+                break;
+            me->index = par_pool.made;
+            me->states = Z_NULL;
+            if (pthread_create(&me->tid, NULL, par_work, me)) {
+                free(me);
+                break;
+            }
+            par_pool.worker[par_pool.made++] = me;
+        }
+    }
+    if (helpers > par_pool.made)
+        helpers = par_pool.made;
+    if (helpers) {
+        par_pool.list = list;
+        par_pool.want = helpers;
+        pthread_cond_broadcast(&par_pool.work);
+    }
+    pthread_mutex_unlock(&par_pool.lock);
+    return helpers;
+}
+
+/* Wait for the workers enlisted on list to finish, and release them. Any that
+   have not yet started on list will not, since the jobs are all taken. */
+local void par_release(void) {
+    pthread_mutex_lock(&par_pool.lock);
+    par_pool.want = 0;
+    while (par_pool.busy)
+        pthread_cond_wait(&par_pool.done, &par_pool.lock);
+    par_pool.list = NULL;
+    pthread_cond_broadcast(&par_pool.done);
+    pthread_mutex_unlock(&par_pool.lock);
+}
+
+int ZEXPORT zlibWorkers(int keep, int affinity) {
+    unsigned n, made;
+    par_worker **worker;
+
+    /* wait for the workers to be idle, and stop them */
+    pthread_mutex_lock(&par_pool.lock);
+    while (par_pool.list != NULL || par_pool.stop)
+        pthread_cond_wait(&par_pool.done, &par_pool.lock);
+    par_pool.stop = 1;
+    pthread_cond_broadcast(&par_pool.work);
+    worker = par_pool.worker;
+    made = par_pool.made;
+    par_pool.worker = NULL;
+    par_pool.made = 0;
+    pthread_mutex_unlock(&par_pool.lock);
+    for (n = 0; n < made; n++) {
+        pthread_join(worker[n]->tid, NULL);
+        free(worker[n]);
+    }
+    free(worker);
+
+    /* start over with the new settings, making workers as they are needed */
+    pthread_mutex_lock(&par_pool.lock);
+    par_pool.keep = keep < 0 ? -1 : keep;
+    par_pool.affinity = affinity != 0;
+    par_pool.stop = 0;
+    pthread_cond_broadcast(&par_pool.done);
+    pthread_mutex_unlock(&par_pool.lock);
+    return Z_OK;
+}
+
+/* Return the deflate state pool of the calling thread if it is a kept worker,
+   otherwise its stream cache, if any. */
+local z_poolp par_states(void) {
+    par_worker *me = NULL;
+
+    if (par_keyed)
+        me = (par_worker *)pthread_getspecific(par_key);
+    return me != NULL ? me->states : z_stream_cache();
+}
+
+#else /* !PAR_KEEP */
+
+int ZEXPORT zlibWorkers(int keep, int affinity) {
+    (void)keep;
+    (void)affinity;
+    return Z_STREAM_ERROR;
+}
+
+local z_poolp par_states(void) {
+    return z_stream_cache();
+}
+
+#endif
+
+void ZLIB_INTERNAL par_run(unsigned threads, unsigned jobs, job_func func,
+                           voidpf arg) {
+    job_list list;
+#ifdef Z_THREADS
+    z_executor exec = par_exec;
+    unsigned n, made, kept = 0;
+#  ifdef _WIN32
+    HANDLE *tid;
+#  else
+    pthread_t *tid;
+#  endif
+#endif
+
+    list.func = func;
+    list.arg = arg;
+    list.jobs = jobs;
+#ifdef Z_THREADS
+    if (threads > jobs)
+        threads = jobs;
+    if (threads > 1) {
+#  ifdef _WIN32
+        list.next = -1;
+#  else
+        list.next = 0;
+        pthread_mutex_init(&list.lock, NULL);
+#  endif
+        if (exec != Z_NULL) {
+            /* the executor's threads, then the calling thread for any jobs
+               the executor did not get to */
+            exec(par_opaque, threads, run_exec, &list);
+            run_list(&list);
+        }
+        else {
+#  ifdef PAR_KEEP
+            kept = par_enlist(&list, threads - 1);
+#  endif
+            made = 0;
+            tid = NULL;
+            if (kept < threads - 1)
+                tid = malloc((threads - 1 - kept) * sizeof(*tid));
+            for (; tid != NULL && made < threads - 1 - kept; made++) {
+#  ifdef _WIN32
+                tid[made] = CreateThread(NULL, 0, run_list, &list, 0, NULL);
+                if (tid[made] == NULL)
+                    break;
+#  else
+                if (pthread_create(tid + made, NULL, run_list, &list))
+                    break;
+#  endif
+            }
+            run_list(&list);
+            for (n = 0; n < made; n++) {
+#  ifdef _WIN32
+                WaitForSingleObject(tid[n], INFINITE);
+                CloseHandle(tid[n]);
+#  else
+                pthread_join(tid[n], NULL);
+#  endif
+            }
+            free(tid);
+#  ifdef PAR_KEEP
+            if (kept)
+                par_release();
+#  endif
+        }
+#  ifndef _WIN32
+        pthread_mutex_destroy(&list.lock);
+#  endif
+        return;
+    }
+#else
+    (void)threads;
+#endif
+    for (jobs = 0; jobs < list.jobs; jobs++)
+        func(arg, jobs);
+}
+
+/* ===========================================================================
+ * Return the number of processors available, or 1 if that is not known.
+ */
+unsigned ZLIB_INTERNAL par_cpus(void) {
+#if defined(Z_THREADS) && defined(_WIN32)
+    SYSTEM_INFO info;
+
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors ? (unsigned)info.dwNumberOfProcessors : 1;
+#elif defined(Z_THREADS) && defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+
+    return n > 0 ? (unsigned)n : 1;
+#else
+    return 1;
+#endif
+}
+
+/* ===========================================================================
+ * Parallel compression. One par_chunk is used for each thread, and is reused
+ * for each wave of chunks.
+ */
+typedef struct {
+    const Bytef *next;      /* uncompressed data */
+    uInt len;               /* length of uncompressed data */
+    uInt dict;              /* length of the dictionary preceding next */
+    int last;               /* true if this is the last chunk */
+    Bytef *out;             /* compressed data */
+    uLong size;             /* allocated size of out */
+    uLong have;             /* length of compressed data */
+    uLong check;            /* CRC-32 or Adler-32 of the uncompressed data */
+    int ret;                /* Z_OK or an error */
+} par_chunk;
+
+typedef struct {
+    par_chunk *chunk;       /* chunks in this wave */
+    int level;              /* compression level */
+    int bits;               /* log2 of the window size */
+    int wrap;               /* 0 for raw, 1 for zlib, 2 for gzip */
+} par_state;
+
+/* Compress one chunk as raw deflate data. */
+local void par_compress(voidpf arg, unsigned job) {
+    par_state *par = (par_state *)arg;
+    par_chunk *chunk = par->chunk + job;
+    z_poolp states = par_states();
+    z_stream strm;
+    int ret;
+
+    chunk->have = 0;
+    if (par->wrap == 1)
+        chunk->check = adler32(1L, chunk->next, chunk->len);
+    else if (par->wrap == 2)
+        chunk->check = crc32(0L, chunk->next, chunk->len);
+
+    strm.zalloc = Z_NULL;
+    strm.zfree = Z_NULL;
+    strm.opaque = Z_NULL;
+    ret = deflatePoolInit2(&strm, states, par->level, Z_DEFLATED, -par->bits,
+                           DEF_MEM_LEVEL, Z_DEFAULT_STRATEGY);
+    if (ret != Z_OK) {
+        chunk->ret = ret;
+        return;
+    }
+    if (chunk->dict)
+        ret = deflateSetDictionary(&strm, chunk->next - chunk->dict,
+                                   chunk->dict);
+    if (ret == Z_OK) {
+        strm.next_in = (z_const Bytef *)chunk->next;
+        strm.avail_in = chunk->len;
+        strm.next_out = chunk->out;
+        strm.avail_out = (uInt)chunk->size;
+        ret = deflate(&strm, chunk->last ? Z_FINISH : Z_SYNC_FLUSH);
+        if (chunk->last)
+            ret = ret == Z_STREAM_END ? Z_OK : Z_BUF_ERROR;
+        else if (ret == Z_OK && (strm.avail_in || strm.avail_out == 0))
+            ret = Z_BUF_ERROR;
+        chunk->have = strm.total_out;
+    }
+    deflatePoolEnd(&strm, states);
+    chunk->ret = ret;
+}
+
+/* Return the size of the buffer needed to compress len bytes as one chunk,
+   including the sync flush marker. */
+local uLong par_chunk_bound(uLong len, int bits) {
+    uLong bound;
+
+    if (bits == 15)
+        bound = len + (len >> 12) + (len >> 14) + (len >> 25) + 7;
+    else
+        bound = len + (len >> 3) + (len >> 8) + (len >> 9) + 4;
+    return bound + 5 + 5;
+}
+
+/* Append len bytes at buf to dest, if they fit. */
+local int par_put(Bytef *dest, uLong *have, uLong size, const Bytef *buf,
+                  uLong len) {
+    if (len > size - *have)
+        return Z_BUF_ERROR;
+    zmemcpy(dest + *have, buf, (uInt)len);
+    *have += len;
+    return Z_OK;
+}
+
+/* ========================================================================= */
+uLong ZEXPORT compressParallelBound(uLong sourceLen, int windowBits) {
+    uLong chunks, bound;
+    int bits;
+
+    bits = windowBits < 0 ? -windowBits :
+           windowBits > 15 ? windowBits - 16 : windowBits;
+    chunks = sourceLen / PAR_CHUNK + 1;
+    bound = par_chunk_bound(sourceLen, bits) + (chunks - 1) * 15;
+    return bound + (windowBits > 15 ? 18 : windowBits > 0 ? 6 : 0);
+}
+
+/* ========================================================================= */
+int ZEXPORT compressParallel(Bytef *dest, uLongf *destLen,
+                             const Bytef *source, uLong sourceLen,
+                             int level, int windowBits, int threads) {
+    par_state par;
+    par_chunk *chunk;
+    Bytef head[10];
+    uLong left, have, check, size, wsize;
+    z_combine ops;
+    unsigned n, wave;
+    int ret;
+
+    if (dest == Z_NULL || destLen == Z_NULL ||
+        (source == Z_NULL && sourceLen))
+        return Z_STREAM_ERROR;
+    if (level == Z_DEFAULT_COMPRESSION)
+        level = 6;
+    par.level = level;
+    par.wrap = 1;
+    par.bits = windowBits;
+    if (windowBits < 0) {
+        par.wrap = 0;
+        par.bits = -windowBits;
+    }
+#ifndef NO_GZIP
+    else if (windowBits > 15) {
+        par.wrap = 2;
+        par.bits -= 16;
+    }
+#endif
+    if (level < 0 || level > Z_OPTIMAL_COMPRESSION || par.bits < 9 ||
+        par.bits > 15)
+        return Z_STREAM_ERROR;
+    wsize = 1UL << par.bits;
+    if (threads <= 0)
+        threads = (int)par_cpus();
+    if ((uLong)threads > sourceLen / PAR_CHUNK + 1)
+        threads = (int)(sourceLen / PAR_CHUNK + 1);
+
+    /* allocate one chunk and its output buffer for each thread */
+    chunk = (par_chunk *)calloc((unsigned)threads, sizeof(par_chunk));
+    if (chunk == NULL)
+        return Z_MEM_ERROR;
+    size = par_chunk_bound(sourceLen < PAR_CHUNK ? sourceLen : PAR_CHUNK,
+                           par.bits);
+    for (n = 0; n < (unsigned)threads; n++) {
+        chunk[n].size = size;
+        chunk[n].out = (Bytef *)malloc(size);
+        if (chunk[n].out == NULL) {
+            while (n)
+                free(chunk[--n].out);
+            free(chunk);
+            return Z_MEM_ERROR;
+        }
+    }
+    par.chunk = chunk;
+
+    /* write the header */
+    have = 0;
+    ret = Z_OK;
+    if (par.wrap == 1) {
+        n = (Z_DEFLATED + ((unsigned)(par.bits - 8) << 4)) << 8;
+        n |= (level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6;
+        n += 31 - (n % 31);
+        head[0] = (Bytef)(n >> 8);
+        head[1] = (Bytef)n;
+        ret = par_put(dest, &have, *destLen, head, 2);
+    }
+    else if (par.wrap == 2) {
+        zmemzero(head, 10);
+        head[0] = 31;
+        head[1] = 139;
+        head[2] = 8;
+        head[8] = level >= 9 ? 2 : level < 2 ? 4 : 0;
+        head[9] = OS_CODE;
+        ret = par_put(dest, &have, *destLen, head, 10);
+    }
+
+    /* compress the chunks in waves of threads chunks */
+    check = par.wrap == 1 ? 1L : 0L;
+    crc32_combine_init(&ops);
+    left = sourceLen;
+    while (ret == Z_OK) {
+        for (wave = 0; wave < (unsigned)threads; wave++) {
+            chunk[wave].next = source + (sourceLen - left);
+            chunk[wave].len = (uInt)(left < PAR_CHUNK ? left : PAR_CHUNK);
+            chunk[wave].dict = (uInt)(sourceLen - left < wsize ?
+                                      sourceLen - left : wsize);
+            left -= chunk[wave].len;
+            chunk[wave].last = left == 0;
+            if (left == 0) {
+                wave++;
+                break;
+            }
+        }
+        par_run((unsigned)threads, wave, par_compress, &par);
+        for (n = 0; n < wave && ret == Z_OK; n++) {
+            ret = chunk[n].ret;
+            if (ret == Z_OK)
+                ret = par_put(dest, &have, *destLen, chunk[n].out,
+                              chunk[n].have);
+            if (par.wrap == 1)
+                check = adler32_combine(check, chunk[n].check,
+                                        (z_off_t)chunk[n].len);
+            else if (par.wrap == 2)
+                check = crc32_combine_ctx(&ops, check, chunk[n].check,
+                                          chunk[n].len);
+        }
+        if (chunk[wave - 1].last)
+            break;
+    }
+
+    /* write the trailer */
+    if (ret == Z_OK && par.wrap == 1) {
+        for (n = 0; n < 4; n++)
+            head[n] = (Bytef)(check >> (24 - (n << 3)));
+        ret = par_put(dest, &have, *destLen, head, 4);
+    }
+    else if (ret == Z_OK && par.wrap == 2) {
+        for (n = 0; n < 4; n++) {
+            head[n] = (Bytef)(check >> (n << 3));
+            head[n + 4] = (Bytef)(sourceLen >> (n << 3));
+        }
+        ret = par_put(dest, &have, *destLen, head, 8);
+    }
+
+    for (n = 0; n < (unsigned)threads; n++)
+        free(chunk[n].out);
+    free(chunk);
+    *destLen = have;
+    return ret;
+}
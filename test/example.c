@@ -60,6 +60,139 @@ static free_func zfree = myfree;
 static alloc_func zalloc = (alloc_func)0;
 static free_func zfree = (free_func)0;
 
+#endif /* Z_SOLO */
+
+/* ===========================================================================
+ * Return the next value of a simple linear congruential generator, so that
+ * the test data is the same everywhere
+ */
+static uLong rand_next(uLong *rnd) {
+    *rnd = (*rnd * 1103515245L + 12345) & 0x7fffffffL;
+    return *rnd;
+}
+
+/* ===========================================================================
+ * Allocate size bytes, exiting if out of memory
+ */
+static void *test_alloc(uLong size) {
+    void *p = malloc(size);
+
+    if (p == NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    return p;
+}
+
+/* ===========================================================================
+ * Fill data[0..len-1] with bytes that repeat themselves: past the first start
+ * bytes, all but one in odds bytes are copied from one to dist bytes back.
+ * The others are any of the first letters lower case letters, or any byte if
+ * letters is zero.
+ */
+static void fill_repeat(Byte *data, uLong len, uLong *rnd, uLong start,
+                        unsigned odds, unsigned dist, unsigned letters) {
+    uLong i;
+
+    for (i = 0; i < len; i++) {
+        rand_next(rnd);
+        data[i] = i > start && (*rnd >> 16) % odds ?
+                  data[i - 1 - (*rnd >> 8) % dist] :
+                  (Byte)(letters ? 'a' + (*rnd >> 23) % letters : *rnd >> 23);
+    }
+}
+
+/* ===========================================================================
+ * Initialize a deflate stream that uses zalloc and zfree
+ */
+static void deflate_init(z_stream *strm, int level, int windowBits,
+                         int memLevel, int strategy) {
+    int err;
+
+    strm->zalloc = zalloc;
+    strm->zfree = zfree;
+    strm->opaque = (voidpf)0;
+    err = deflateInit2(strm, level, Z_DEFLATED, windowBits, memLevel,
+                       strategy);
+    CHECK_ERR(err, "deflateInit2");
+}
+
+/* ===========================================================================
+ * Initialize an inflate stream that uses zalloc and zfree, with no input yet
+ */
+static void inflate_init(z_stream *strm, int windowBits) {
+    int err;
+
+    strm->zalloc = zalloc;
+    strm->zfree = zfree;
+    strm->opaque = (voidpf)0;
+    strm->next_in = Z_NULL;
+    strm->avail_in = 0;
+    err = inflateInit2(strm, windowBits);
+    CHECK_ERR(err, "inflateInit2");
+}
+
+/* ===========================================================================
+ * Compress len bytes at data to compr with one Z_FINISH, and return the
+ * number of bytes written to compr
+ */
+static uLong deflate_all(z_stream *strm, const Byte *data, uLong len,
+                         Byte *compr, uLong comprLen) {
+    int err;
+
+    strm->next_in = (z_const Bytef *)data;
+    strm->avail_in = (uInt)len;
+    strm->next_out = compr;
+    strm->avail_out = (uInt)comprLen;
+    err = deflate(strm, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "deflate should report Z_STREAM_END\n");
+        exit(1);
+    }
+    return (uLong)(strm->next_out - compr);
+}
+
+/* ===========================================================================
+ * Check that all comprLen bytes at compr inflate with windowBits to exactly
+ * the len bytes at data, else exit with "bad " and what
+ */
+static void check_inflate(const Byte *compr, uLong comprLen, int windowBits,
+                          const Byte *data, uLong len, const char *what) {
+    int err;
+    Byte *out;
+    z_stream d_stream; /* decompression stream */
+
+    out = test_alloc(len + 1);
+    inflate_init(&d_stream, windowBits);
+    d_stream.next_in = (z_const Bytef *)compr;
+    d_stream.avail_in = (uInt)comprLen;
+    d_stream.next_out = out;
+    d_stream.avail_out = (uInt)len + 1;
+    err = inflate(&d_stream, Z_FINISH);
+    if (err != Z_STREAM_END || d_stream.total_out != len ||
+        d_stream.avail_in != 0 || memcmp(data, out, len)) {
+        fprintf(stderr, "bad %s\n", what);
+        exit(1);
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+    free(out);
+}
+
+#ifndef Z_SOLO
+
+/* ===========================================================================
+ * Fill data[0..len-1] with a mix of hello's letters, adding the position to
+ * every every'th byte
+ */
+static void fill_hello(Byte *data, uLong len, unsigned every) {
+    uLong i;
+
+    for (i = 0; i < len; i++)
+        data[i] = (Byte)(hello[(i * 7 + i / 13) % 13] +
+                         (i % every == 0 ? i : 0));
+}
+
 /* ===========================================================================
  * Test compress() and uncompress()
  */
@@ -79,165 +212,3522 @@ static void test_compress(Byte *compr, uLong comprLen, Byte *uncompr,
     if (strcmp((char*)uncompr, hello)) {
         fprintf(stderr, "bad uncompress\n");
         exit(1);
-    } else {
-        printf("uncompress(): %s\n", (char *)uncompr);
+    } else {
+        printf("uncompress(): %s\n", (char *)uncompr);
+    }
+}
+
+/* ===========================================================================
+ * Test compressParallel() with gzip and zlib wrappers
+ */
+static void test_parallel(void) {
+    int err, wrap;
+    uLong len = 400000L, comprLen, comprLen1;
+    Byte *data, *compr, *compr1;
+
+    data = test_alloc(len);
+    comprLen = compressParallelBound(len, 31);
+    compr = test_alloc(comprLen);
+    compr1 = test_alloc(comprLen);
+    fill_hello(data, len, 251);
+
+    for (wrap = 0; wrap < 2; wrap++) {
+        comprLen = compressParallelBound(len, wrap ? 31 : 15);
+        err = compressParallel(compr, &comprLen, data, len, 6,
+                               wrap ? 31 : 15, 4);
+        CHECK_ERR(err, "compressParallel");
+        comprLen1 = compressParallelBound(len, wrap ? 31 : 15);
+        err = compressParallel(compr1, &comprLen1, data, len, 6,
+                               wrap ? 31 : 15, 1);
+        CHECK_ERR(err, "compressParallel");
+        if (comprLen != comprLen1 || memcmp(compr, compr1, comprLen)) {
+            fprintf(stderr, "compressParallel depends on thread count\n");
+            exit(1);
+        }
+        check_inflate(compr, comprLen, wrap ? 31 : 15, data, len,
+                      "parallel inflate");
+    }
+    printf("compressParallel(): OK\n");
+
+    free(data);
+    free(compr);
+    free(compr1);
+}
+
+/* ===========================================================================
+ * An executor for test_workers() that runs everything on the calling thread
+ */
+static void serial_exec(void *opaque, unsigned count, z_run_func run,
+                        void *arg) {
+    (void)count;
+    (*(int *)opaque)++;
+    run(arg);
+}
+
+/* ===========================================================================
+ * Test that compressParallel() gives the same result with an executor and
+ * with kept workers, with and without affinity, as on one thread
+ */
+static void test_workers(void) {
+    int err, pass, calls = 0;
+    uLong len = 700000L, comprLen, comprLen1;
+    Byte *data, *compr, *compr1;
+
+    comprLen = compressParallelBound(len, 31);
+    data = test_alloc(len);
+    compr = test_alloc(comprLen);
+    compr1 = test_alloc(comprLen);
+    fill_hello(data, len, 97);
+    comprLen1 = comprLen;
+    err = compressParallel(compr1, &comprLen1, data, len, 6, 31, 1);
+    CHECK_ERR(err, "compressParallel");
+
+    /* pass 0 with the executor, then kept workers with different limits */
+    for (pass = 0; pass < 5; pass++) {
+        if (pass == 0) {
+            err = zlibExecutor(serial_exec, &calls);
+            if (err == Z_STREAM_ERROR) {
+                printf("zlibExecutor(): not compiled\n");
+                break;
+            }
+            CHECK_ERR(err, "zlibExecutor");
+        }
+        else {
+            zlibExecutor(Z_NULL, Z_NULL);
+            err = zlibWorkers(pass == 4 ? 0 : pass, pass & 1);
+            if (err == Z_STREAM_ERROR) {
+                printf("zlibWorkers(): not compiled\n");
+                break;
+            }
+            CHECK_ERR(err, "zlibWorkers");
+        }
+        comprLen = compressParallelBound(len, 31);
+        err = compressParallel(compr, &comprLen, data, len, 6, 31, 4);
+        CHECK_ERR(err, "compressParallel");
+        if (comprLen != comprLen1 || memcmp(compr, compr1, comprLen)) {
+            fprintf(stderr, "compressParallel depends on workers\n");
+            exit(1);
+        }
+        if (pass == 0 && calls != 2) {
+            fprintf(stderr, "executor called %d times\n", calls);
+            exit(1);
+        }
+    }
+    zlibExecutor(Z_NULL, Z_NULL);
+    zlibWorkers(-1, 0);
+    if (pass == 5)
+        printf("zlibWorkers(): OK\n");
+
+    free(data);
+    free(compr);
+    free(compr1);
+}
+
+/* ===========================================================================
+ * Test compressJoin() on zlib streams and gzip members of assorted kinds
+ */
+static void test_join(void) {
+    static const int levels[4] = {6, 0, 1, 9};
+    static const int strategies[4] = {Z_DEFAULT_STRATEGY, Z_DEFAULT_STRATEGY,
+                                      Z_FIXED, Z_HUFFMAN_ONLY};
+    int err, wrap, n;
+    uLong len = 100000L, total, joinLen;
+    uLong partLen[4];
+    const Bytef *part[4];
+    Byte *data, *compr, *joined;
+    z_stream c_stream; /* compression stream */
+
+    data = test_alloc(len);
+    compr = test_alloc(4 * compressBound(len) + 100);
+    joined = test_alloc(4 * compressBound(len) + 100);
+    fill_hello(data, len, 251);
+
+    for (wrap = 0; wrap < 2; wrap++) {
+        /* compress four uneven pieces with different levels, strategies, and
+           window sizes */
+        total = 0;
+        for (n = 0; n < 4; n++) {
+            deflate_init(&c_stream, levels[n], (wrap ? 16 : 0) + 9 + 2 * n, 8,
+                         strategies[n]);
+            c_stream.next_in = data + (n ? len / 7 * (n + 2) : 0);
+            c_stream.avail_in = (uInt)(n == 3 ? len - len / 7 * 5 :
+                                       (n ? len / 7 : len / 7 * 3));
+            c_stream.next_out = compr + total;
+            c_stream.avail_out = (uInt)(2 * compressBound(len));
+            err = deflate(&c_stream, Z_FINISH);
+            if (err != Z_STREAM_END) {
+                fprintf(stderr, "join deflate: %d\n", err);
+                exit(1);
+            }
+            part[n] = compr + total;
+            partLen[n] = c_stream.total_out;
+            total += c_stream.total_out;
+            err = deflateEnd(&c_stream);
+            CHECK_ERR(err, "deflateEnd");
+        }
+
+        joinLen = total;
+        err = compressJoin(joined, &joinLen, part, partLen, 4);
+        CHECK_ERR(err, "compressJoin");
+        check_inflate(joined, joinLen, wrap ? 31 : 15, data, len,
+                      "join inflate");
+
+        /* a truncated source is rejected */
+        joinLen = total;
+        partLen[2]--;
+        err = compressJoin(joined, &joinLen, part, partLen, 4);
+        if (err != Z_DATA_ERROR) {
+            fprintf(stderr, "compressJoin on truncated data: %d\n", err);
+            exit(1);
+        }
+    }
+    printf("compressJoin(): OK\n");
+
+    free(data);
+    free(compr);
+
+    free(joined);
+}
+
+/* ===========================================================================
+ * Test gzipNormalize() on gzip members of assorted kinds, given in pieces of
+ * assorted sizes
+ */
+struct norm_io {
+    const Byte *next;       /* input not yet given out */
+    uLong left;             /* bytes at next */
+    unsigned calls;         /* number of norm_in() calls */
+    Byte *out;              /* output */
+    uLong have;             /* bytes at out */
+    uLong size;             /* room at out */
+};
+
+static unsigned norm_in(void *desc, z_const unsigned char **buf) {
+    struct norm_io *io = (struct norm_io *)desc;
+    uLong len = (io->calls++ * 37) % 500 + 1;
+
+    if (len > io->left)
+        len = io->left;
+    *buf = (z_const unsigned char *)io->next;
+    io->next += len;
+    io->left -= len;
+    return (unsigned)len;
+}
+
+static int norm_out(void *desc, unsigned char *buf, unsigned len) {
+    struct norm_io *io = (struct norm_io *)desc;
+
+    if (len > io->size - io->have)
+        return 1;
+    memcpy(io->out + io->have, buf, len);
+    io->have += len;
+    return 0;
+}
+
+static void test_gzip_normalize(void) {
+    static const int levels[3] = {6, 0, 1};
+    static const int strategies[3] = {Z_DEFAULT_STRATEGY, Z_DEFAULT_STRATEGY,
+                                      Z_FIXED};
+    int err, n;
+    uLong len = 100000L, total, size;
+    Byte *data, *compr, *norm;
+    struct norm_io io;
+    gz_header head;
+    z_stream c_stream; /* compression stream */
+
+    size = 3 * compressBound(len) + 100;
+    data = test_alloc(len);
+
+    compr = test_alloc(size);
+    norm = test_alloc(size);
+    fill_hello(data, len, 251);
+
+    /* compress three uneven pieces with different levels and strategies, one
+       with a file name and a sync flush */
+    total = 0;
+    for (n = 0; n < 3; n++) {
+        deflate_init(&c_stream, levels[n], 31, 8, strategies[n]);
+        if (n == 0) {
+            memset(&head, 0, sizeof(head));
+            head.name = (Bytef *)"hello.txt";
+            head.hcrc = 1;
+            err = deflateSetHeader(&c_stream, &head);
+            CHECK_ERR(err, "deflateSetHeader");
+        }
+        c_stream.next_in = data + (n ? len / 7 * (2 * n + 1) : 0);
+        c_stream.avail_in = (uInt)(n == 2 ? len - len / 7 * 5 :
+                                   len / 7 * (n ? 2 : 3));
+        c_stream.next_out = compr + total;
+        c_stream.avail_out = (uInt)(size - total);
+        if (n == 0) {
+            err = deflate(&c_stream, Z_SYNC_FLUSH);
+            CHECK_ERR(err, "deflate");
+        }
+        err = deflate(&c_stream, Z_FINISH);
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "normalize deflate: %d\n", err);
+            exit(1);
+        }
+        total += c_stream.total_out;
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+    }
+
+    /* normalize to one member, which must inflate to all of the data */
+    io.next = compr;
+    io.left = total;
+    io.calls = 0;
+    io.out = norm;
+    io.have = 0;
+    io.size = size;
+    err = gzipNormalize(norm_in, &io, norm_out, &io);
+    CHECK_ERR(err, "gzipNormalize");
+
+    check_inflate(norm, io.have, 31, data, len, "normalize inflate");
+
+    /* normalizing again changes nothing */
+    io.next = norm;
+    io.left = total = io.have;
+    io.out = compr;
+    io.have = 0;
+    err = gzipNormalize(norm_in, &io, norm_out, &io);
+    CHECK_ERR(err, "gzipNormalize");
+    if (io.have != total || memcmp(compr, norm, total)) {
+        fprintf(stderr, "gzipNormalize not repeatable\n");
+        exit(1);
+    }
+
+    /* a truncated member is rejected */
+    io.next = norm;
+    io.left = total - 1;
+    io.have = 0;
+    err = gzipNormalize(norm_in, &io, norm_out, &io);
+    if (err != Z_DATA_ERROR) {
+        fprintf(stderr, "gzipNormalize on truncated data: %d\n", err);
+        exit(1);
+    }
+    printf("gzipNormalize(): OK\n");
+
+    free(data);
+    free(compr);
+
+    free(norm);
+}
+
+/* ===========================================================================
+ * Test compressBatch() and uncompressBatch() against compress2()
+ */
+#define BATCH 40
+
+static void test_batch(void) {
+    int err;
+    unsigned n;
+    uLong len = 300L, slot, comprLen;
+    Byte *data, *compr, *uncompr;
+    z_buf bufs[BATCH];
+
+    slot = compressBound(len);
+    data = test_alloc(BATCH * len);
+    compr = test_alloc(BATCH * slot + slot);
+    uncompr = test_alloc(BATCH * len);
+    fill_hello(data, BATCH * len, 61);
+
+    for (n = 0; n < BATCH; n++) {
+        bufs[n].source = data + n * len;
+        bufs[n].sourceLen = len - n;
+        bufs[n].dest = compr + n * slot;
+        bufs[n].destLen = slot;
+    }
+    err = compressBatch(bufs, BATCH, 6);
+    CHECK_ERR(err, "compressBatch");
+    for (n = 0; n < BATCH; n++) {
+        comprLen = slot;
+        err = compress2(compr + BATCH * slot, &comprLen, data + n * len,
+                        len - n, 6);
+        CHECK_ERR(err, "compress2");
+        if (bufs[n].err != Z_OK || bufs[n].destLen != comprLen ||
+            memcmp(bufs[n].dest, compr + BATCH * slot, comprLen)) {
+            fprintf(stderr, "bad compressBatch at %u\n", n);
+            exit(1);
+        }
+        bufs[n].source = bufs[n].dest;
+        bufs[n].sourceLen = bufs[n].destLen;
+        bufs[n].dest = uncompr + n * len;
+        bufs[n].destLen = len;
+    }
+    err = uncompressBatch(bufs, BATCH);
+    CHECK_ERR(err, "uncompressBatch");
+    for (n = 0; n < BATCH; n++)
+        if (bufs[n].err != Z_OK || bufs[n].destLen != len - n ||
+            memcmp(bufs[n].dest, data + n * len, len - n)) {
+            fprintf(stderr, "bad uncompressBatch at %u\n", n);
+            exit(1);
+        }
+
+    /* a full output buffer is reported for that buffer only */
+    bufs[2].destLen = 10;
+    err = uncompressBatch(bufs, 4);
+    if (err != Z_BUF_ERROR || bufs[1].err != Z_OK ||
+        bufs[2].err != Z_BUF_ERROR || bufs[3].err != Z_OK ||
+        memcmp(bufs[3].dest, data + 3 * len, len - 3)) {
+        fprintf(stderr, "bad uncompressBatch error\n");
+        exit(1);
+    }
+    printf("compressBatch(): OK\n");
+
+    free(data);
+    free(compr);
+    free(uncompr);
+}
+
+/* ===========================================================================
+ * Test compressAsync() and uncompressAsync() with callbacks and reaping
+ */
+#define ASYNC 8
+
+static void async_done(z_job *job) {
+    *(int *)job->opaque = 1;
+}
+
+static void test_async(void) {
+    int err, called[ASYNC];
+    unsigned n, reaped;
+    uLong len = 3000L, slot, comprLen;
+    Byte *data, *compr, *uncompr;
+    z_job jobs[ASYNC], *job;
+    z_asyncp async;
+
+    slot = compressBound(len) + 18;
+    data = test_alloc(ASYNC * len);
+    compr = test_alloc(ASYNC * slot + slot);
+    uncompr = test_alloc(ASYNC * len);
+    async = zlibAsyncCreate(3);
+    if (async == Z_NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    if (zlibAsyncFd(async) < -1) {
+        fprintf(stderr, "bad zlibAsyncFd\n");
+        exit(1);
+    }
+    fill_hello(data, ASYNC * len, 61);
+
+    /* compress with zlib, gzip, and raw wrappers, half with callbacks, one
+       with compressParallel() */
+    for (n = 0; n < ASYNC; n++) {
+        memset(jobs + n, 0, sizeof(z_job));
+        jobs[n].source = data + n * len;
+        jobs[n].sourceLen = len - n;
+        jobs[n].dest = compr + n * slot;
+        jobs[n].destLen = slot;
+        jobs[n].level = 6;
+        jobs[n].windowBits = n % 3 == 0 ? 0 : n % 3 == 1 ? 31 : -15;
+        jobs[n].threads = n == ASYNC - 1 ? 2 : 1;
+        jobs[n].done = n & 1 ? async_done : Z_NULL;
+        jobs[n].opaque = called + n;
+        called[n] = 0;
+        err = compressAsync(async, jobs + n);
+        CHECK_ERR(err, "compressAsync");
+    }
+    reaped = 0;
+    while ((job = zlibAsyncReap(async, 1)) != Z_NULL) {
+        if (job->done != Z_NULL || (job - jobs) & 1) {
+            fprintf(stderr, "bad zlibAsyncReap\n");
+            exit(1);
+        }
+        reaped++;
+    }
+    if (reaped != ASYNC / 2) {
+        fprintf(stderr, "bad zlibAsyncReap count %u\n", reaped);
+        exit(1);
+    }
+    for (n = 0; n < ASYNC; n++) {
+        CHECK_ERR(jobs[n].err, "compressAsync job");
+        if (called[n] != (int)(n & 1)) {
+            fprintf(stderr, "bad compressAsync callback at %u\n", n);
+            exit(1);
+        }
+    }
+    comprLen = slot;
+    err = compress2(compr + ASYNC * slot, &comprLen, data, len, 6);
+    CHECK_ERR(err, "compress2");
+    if (jobs[0].destLen != comprLen ||
+        memcmp(jobs[0].dest, compr + ASYNC * slot, comprLen)) {
+        fprintf(stderr, "bad compressAsync\n");
+        exit(1);
+    }
+
+    /* decompress them all, and one truncated stream */
+    for (n = 0; n < ASYNC; n++) {
+        jobs[n].source = jobs[n].dest;
+        jobs[n].sourceLen = n == 3 ? jobs[n].destLen - 1 : jobs[n].destLen;
+        jobs[n].dest = uncompr + n * len;
+        jobs[n].destLen = len;
+        jobs[n].done = Z_NULL;
+        err = uncompressAsync(async, jobs + n);
+        CHECK_ERR(err, "uncompressAsync");
+    }
+    for (reaped = 0; zlibAsyncReap(async, 1) != Z_NULL; reaped++)
+        ;
+    if (reaped != ASYNC || zlibAsyncReap(async, 0) != Z_NULL) {
+        fprintf(stderr, "bad zlibAsyncReap count %u\n", reaped);
+        exit(1);
+    }
+    for (n = 0; n < ASYNC; n++)
+        if (n == 3 ? jobs[n].err != Z_DATA_ERROR :
+            jobs[n].err != Z_OK || jobs[n].destLen != len - n ||
+            memcmp(jobs[n].dest, data + n * len, len - n)) {
+            fprintf(stderr, "bad uncompressAsync at %u\n", n);
+            exit(1);
+        }
+    zlibAsyncDestroy(async);
+    printf("compressAsync(): OK\n");
+
+    free(data);
+    free(compr);
+    free(uncompr);
+}
+
+/* ===========================================================================
+ * Test that compress2() and uncompress2() give the same results with
+ * zlibStreamCache(), as the cached states are reused at different levels
+ */
+static void test_stream_cache(void) {
+    int err, level, pass;
+    uLong i, len = 5000L, comprLen[2][10], uncomprLen;
+    Byte *data, *compr, *uncompr;
+
+    err = zlibStreamCache(2);
+    if (err == Z_STREAM_ERROR) {
+        printf("zlibStreamCache(): not compiled\n");
+        return;
+    }
+    CHECK_ERR(err, "zlibStreamCache");
+    data = test_alloc(len);
+    compr = test_alloc(2 * 10 * compressBound(len));
+    uncompr = test_alloc(len);
+    fill_hello(data, len, 61);
+
+    /* pass 0 without the cache, pass 1 with it, twice through the levels */
+    for (pass = 0; pass < 2; pass++) {
+        zlibStreamCache(pass ? 2 : 0);
+        for (level = 0; level < 20; level++) {
+            Byte *out = compr + ((uLong)pass * 10 + level % 10) *
+                                compressBound(len);
+
+            comprLen[pass][level % 10] = compressBound(len);
+            err = compress2(out, &comprLen[pass][level % 10], data, len,
+                            level % 10);
+            CHECK_ERR(err, "compress2");
+            uncomprLen = len;
+            i = comprLen[pass][level % 10];
+            err = uncompress2(uncompr, &uncomprLen, out, &i);
+            CHECK_ERR(err, "uncompress2");
+            if (uncomprLen != len || memcmp(uncompr, data, len)) {
+                fprintf(stderr, "bad uncompress2 with cache\n");
+                exit(1);
+            }
+        }
+    }
+    for (level = 0; level < 10; level++)
+        if (comprLen[0][level] != comprLen[1][level] ||
+            memcmp(compr + level * compressBound(len),
+                   compr + (10 + level) * compressBound(len),
+                   comprLen[0][level])) {
+            fprintf(stderr, "bad compress2 with cache at level %d\n", level);
+            exit(1);
+        }
+    zlibStreamCache(0);
+    printf("zlibStreamCache(): OK\n");
+
+    free(data);
+    free(compr);
+    free(uncompr);
+}
+
+/* ===========================================================================
+ * Test crc32() against a byte at a time calculation, at every alignment and
+ * at lengths that exercise each of the paths through crc32_z()
+ */
+static void test_crc32(void) {
+    uLong crc, crc1;
+    unsigned i, off, len;
+    Byte *buf;
+
+    buf = test_alloc(4096 + 16);
+    for (i = 0; i < 4096 + 16; i++)
+        buf[i] = (Byte)((i * 2654435761U) >> 24);
+
+    if (crc32(0L, (const Bytef *)"123456789", 9) != 0xcbf43926UL) {
+        fprintf(stderr, "bad crc32 check value\n");
+        exit(1);
+    }
+    for (off = 0; off < 16; off++)
+        for (len = 0; len <= 4096; len += len < 300 ? 1 : 97) {
+            crc = crc32(0x12345678UL, buf + off, len);
+            crc1 = 0x12345678UL;
+            for (i = 0; i < len; i++)
+                crc1 = crc32(crc1, buf + off + i, 1);
+            if (crc != crc1) {
+                fprintf(stderr, "bad crc32 at offset %u length %u\n",
+                        off, len);
+                exit(1);
+            }
+        }
+    printf("crc32(): OK\n");
+
+    free(buf);
+}
+
+/* ===========================================================================
+ * Test adler32() against a byte at a time calculation, at every alignment,
+ * at lengths around the vector block sizes, and with all bytes 0xff to test
+ * the largest sums
+ */
+static void test_adler32(void) {
+    uLong adler, adler1;
+    unsigned i, off, len, fill;
+    Byte *buf;
+
+    buf = test_alloc(16384 + 16);
+    if (adler32(1L, (const Bytef *)"123456789", 9) != 0x091e01deUL) {
+        fprintf(stderr, "bad adler32 check value\n");
+        exit(1);
+    }
+    for (fill = 0; fill < 2; fill++) {
+        for (i = 0; i < 16384 + 16; i++)
+            buf[i] = fill ? 0xff : (Byte)((i * 2654435761U) >> 24);
+        for (off = 0; off < 16; off++)
+            for (len = 0; len <= 16384; len += len < 300 ? 1 : 1021) {
+                adler = adler32(0xfff0fff0UL, buf + off, len);
+                adler1 = 0xfff0fff0UL;
+                for (i = 0; i < len; i++)
+                    adler1 = adler32(adler1, buf + off + i, 1);
+                if (adler != adler1) {
+                    fprintf(stderr, "bad adler32 at offset %u length %u\n",
+                            off, len);
+                    exit(1);
+                }
+            }
+    }
+    printf("adler32(): OK\n");
+
+    free(buf);
+}
+
+/* ===========================================================================
+ * Test crc32_combine_ctx(), crc32_combine_vec(), and adler32_combine_vec()
+ * against the check values of whole buffers, with a long run of one piece
+ * length, and then more distinct lengths than the cache holds
+ */
+static void test_combine(void) {
+    z_check checks[100];
+    z_combine ctx;
+    uLong crc, check;
+    unsigned i, n, off;
+    Byte *buf;
+
+    buf = test_alloc(100 * 300);
+    for (i = 0; i < 100 * 300; i++)
+        buf[i] = (Byte)((i * 2654435761U) >> 24);
+    off = 0;
+    for (n = 0; n < 100; n++) {
+        checks[n].len = n < 80 ? 256 : n % 4 == 3 ? 300 - n : n - 70;
+        off += (unsigned)checks[n].len;
+    }
+
+    for (i = 0; i < 2; i++) {
+        check = i ? adler32(0L, Z_NULL, 0) : crc32(0L, Z_NULL, 0);
+        off = 0;
+        for (n = 0; n < 100; n++) {
+            checks[n].check = i ? adler32(1L, buf + off, (uInt)checks[n].len) :
+                                  crc32(0L, buf + off, (uInt)checks[n].len);
+            off += (unsigned)checks[n].len;
+        }
+        check = i ? adler32(check, buf, off) : crc32(check, buf, off);
+        if ((i ? adler32_combine_vec(1L, checks, 100) :
+                 crc32_combine_vec(0L, checks, 100)) != check) {
+            fprintf(stderr, "bad %s_combine_vec\n", i ? "adler32" : "crc32");
+            exit(1);
+        }
+    }
+    crc32_combine_init(&ctx);
+    crc = crc32(0L, Z_NULL, 0);
+    check = crc32(0L, Z_NULL, 0);
+    for (n = 0; n < 100; n++) {
+        crc = crc32_combine_ctx(&ctx, crc, crc32(0L, buf, (uInt)checks[n].len),
+                                checks[n].len);
+        check = crc32(check, buf, (uInt)checks[n].len);
+    }
+    if (crc != check) {
+        fprintf(stderr, "bad crc32_combine_ctx\n");
+        exit(1);
+    }
+    if (adler32_combine_vec(adler32(1L, buf, 100), checks, 0) !=
+        adler32(1L, buf, 100)) {
+        fprintf(stderr, "bad empty adler32_combine_vec\n");
+        exit(1);
+    }
+    printf("crc32_combine_vec(), adler32_combine_vec(): OK\n");
+
+    free(buf);
+}
+
+/* ===========================================================================
+ * Test read/write of .gz files
+ */
+static void test_gzio(const char *fname, Byte *uncompr, uLong uncomprLen) {
+#ifdef NO_GZCOMPRESS
+    fprintf(stderr, "NO_GZCOMPRESS -- gz* functions cannot compress\n");
+#else
+    int err;
+    int len = (int)strlen(hello)+1;
+    gzFile file;
+    z_off_t pos;
+
+    file = gzopen(fname, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    gzputc(file, 'h');
+    if (gzputs(file, "ello") != 4) {
+        fprintf(stderr, "gzputs err: %s\n", gzerror(file, &err));
+        exit(1);
+    }
+    if (gzprintf(file, ", %s!", "hello") != 8) {
+        fprintf(stderr, "gzprintf err: %s\n", gzerror(file, &err));
+        exit(1);
+    }
+    gzseek(file, 1L, SEEK_CUR); /* add one zero byte */
+    gzclose(file);
+
+    file = gzopen(fname, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    strcpy((char*)uncompr, "garbage");
+
+    if (gzread(file, uncompr, (unsigned)uncomprLen) != len) {
+        fprintf(stderr, "gzread err: %s\n", gzerror(file, &err));
+        exit(1);
+    }
+    if (strcmp((char*)uncompr, hello)) {
+        fprintf(stderr, "bad gzread: %s\n", (char*)uncompr);
+        exit(1);
+    } else {
+        printf("gzread(): %s\n", (char*)uncompr);
+    }
+
+    pos = gzseek(file, -8L, SEEK_CUR);
+    if (pos != 6 || gztell(file) != pos) {
+        fprintf(stderr, "gzseek error, pos=%ld, gztell=%ld\n",
+                (long)pos, (long)gztell(file));
+        exit(1);
+    }
+
+    if (gzgetc(file) != ' ') {
+        fprintf(stderr, "gzgetc error\n");
+        exit(1);
+    }
+
+    if (gzungetc(' ', file) != ' ') {
+        fprintf(stderr, "gzungetc error\n");
+        exit(1);
+    }
+
+    gzgets(file, (char*)uncompr, (int)uncomprLen);
+    if (strlen((char*)uncompr) != 7) { /* " hello!" */
+        fprintf(stderr, "gzgets err after gzseek: %s\n", gzerror(file, &err));
+        exit(1);
+    }
+    if (strcmp((char*)uncompr, hello + 6)) {
+        fprintf(stderr, "bad gzgets after gzseek\n");
+        exit(1);
+    } else {
+        printf("gzgets() after gzseek: %s\n", (char*)uncompr);
+    }
+
+    gzclose(file);
+#endif
+}
+
+/* ===========================================================================
+ * Test read/write of .gz files with asynchronous i/o
+ */
+static void test_gzio_async(const char *fname) {
+#ifdef NO_GZCOMPRESS
+    fprintf(stderr, "NO_GZCOMPRESS -- gz* functions cannot compress\n");
+#else
+    int err;
+    unsigned i, len = 300000;
+    unsigned char *data, *back;
+    gzFile file;
+
+    data = test_alloc(len);
+    back = test_alloc(len);
+    for (i = 0; i < len; i++)
+        data[i] = (unsigned char)(i % 251 < 200 ? i / 97 : i * 2654435761U >> 24);
+
+    /* compress in the background with small buffers, flushing midway */
+    file = gzopen(fname, "wbA");
+    if (file == NULL || gzbuffer(file, 1024)) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    if (gzwrite(file, data, 100000) != 100000 || gzflush(file, Z_SYNC_FLUSH) ||
+            gzwrite(file, data + 100000, len - 100000) != (int)(len - 100000) ||
+            gzsetasync(file, 0) != -1) {
+        fprintf(stderr, "async gzwrite err: %s\n", gzerror(file, &err));
+        exit(1);
+    }
+    if (gzclose(file) != Z_OK) {
+        fprintf(stderr, "async gzclose error\n");
+        exit(1);
+    }
+
+    /* read it back with read-ahead, seeking forward, then rewinding */
+    file = gzopen(fname, "rb");
+    if (file == NULL || gzsetasync(file, 1) || gzbuffer(file, 1024)) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    if (gzread(file, back, 1000) != 1000 || memcmp(back, data, 1000) ||
+            gzseek(file, 200000L, SEEK_SET) != 200000L ||
+            gzread(file, back, 5000) != 5000 ||
+            memcmp(back, data + 200000, 5000) || gzoffset(file) <= 0) {
+        fprintf(stderr, "async gzread/gzseek err: %s\n", gzerror(file, &err));
+        exit(1);
+    }
+    if (gzrewind(file) || gzread(file, back, len) != (int)len ||
+            memcmp(back, data, len) || gzread(file, back, 1) != 0 ||
+            !gzeof(file)) {
+        fprintf(stderr, "async gzrewind err: %s\n", gzerror(file, &err));
+        exit(1);
+    }
+    gzclose(file);
+
+    /* read a file that is not compressed, seeking in it directly */
+    file = gzopen(fname, "wbTA");
+    if (file == NULL || gzwrite(file, data, 50000) != 50000 ||
+            gzclose(file) != Z_OK) {
+        fprintf(stderr, "async transparent gzwrite error\n");
+        exit(1);
+    }
+    file = gzopen(fname, "rbA");
+    if (file == NULL || gzbuffer(file, 512)) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    if (gzread(file, back, 3000) != 3000 || memcmp(back, data, 3000) ||
+            gzseek(file, 40000L, SEEK_SET) != 40000L ||
+            gzread(file, back, 20000) != 10000 ||
+            memcmp(back, data + 40000, 10000) || gzoffset(file) != 50000) {
+        fprintf(stderr, "async direct gzread err: %s\n", gzerror(file, &err));
+        exit(1);
+    }
+    gzclose(file);
+    free(back);
+    free(data);
+    printf("gzio with asynchronous i/o\n");
+#endif
+}
+
+/* ===========================================================================
+ * Test reading .gz files through a memory mapping
+ */
+static void test_gzio_map(const char *fname) {
+#ifdef NO_GZCOMPRESS
+    fprintf(stderr, "NO_GZCOMPRESS -- gz* functions cannot compress\n");
+#else
+    int err;
+    unsigned i, len = 200000;
+    unsigned char *data, *back;
+    gzFile file;
+
+    data = test_alloc(len);
+    back = test_alloc(len);
+    for (i = 0; i < len; i++)
+        data[i] = (unsigned char)(i % 173 < 150 ? i / 61 : i * 2654435761U >> 24);
+
+    /* two gzip members, read with seeks and a rewind */
+    file = gzopen(fname, "wb");
+    if (file == NULL || gzwrite(file, data, 120000) != 120000 ||
+            gzclose(file) != Z_OK ||
+            (file = gzopen(fname, "ab")) == NULL ||
+            gzwrite(file, data + 120000, len - 120000) != (int)(len - 120000) ||
+            gzclose(file) != Z_OK) {
+        fprintf(stderr, "gzwrite error\n");
+        exit(1);
+    }
+    file = gzopen(fname, "rbm");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    if (gzread(file, back, 1000) != 1000 || memcmp(back, data, 1000) ||
+            gzseek(file, 150000L, SEEK_SET) != 150000L ||
+            gzread(file, back, len) != (int)(len - 150000) ||
+            memcmp(back, data + 150000, len - 150000) || !gzeof(file) ||
+            gzrewind(file) || gzread(file, back, len) != (int)len ||
+            memcmp(back, data, len) || gzoffset(file) <= 0) {
+        fprintf(stderr, "mapped gzread err: %s\n", gzerror(file, &err));
+        exit(1);
+    }
+    gzclose(file);
+
+    /* the same without the mapping, letting the buffers grow as it's read */
+    file = gzopen(fname, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    for (i = 0; i < len; i += 1000)
+        if (gzread(file, back + i, 1000) != 1000)
+            break;
+    if (i != len || memcmp(back, data, len) ||
+            gzseek(file, 5000L, SEEK_SET) != 5000L ||
+            gzread(file, back, len) != (int)(len - 5000) ||
+            memcmp(back, data + 5000, len - 5000)) {
+        fprintf(stderr, "growing gzread err: %s\n", gzerror(file, &err));
+        exit(1);
+    }
+    gzclose(file);
+
+    /* a file that is not compressed, which is copied out of the mapping */
+    file = gzopen(fname, "wbT");
+    if (file == NULL || gzwrite(file, data, 30000) != 30000 ||
+            gzclose(file) != Z_OK) {
+        fprintf(stderr, "transparent gzwrite error\n");
+        exit(1);
+    }
+    file = gzopen(fname, "rbm");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    if (gzread(file, back, 20000) != 20000 || memcmp(back, data, 20000) ||
+            gzseek(file, -10000L, SEEK_CUR) != 10000L ||
+            gzread(file, back, len) != 20000 ||
+            memcmp(back, data + 10000, 20000) || gzoffset(file) != 30000) {
+        fprintf(stderr, "mapped direct gzread err: %s\n", gzerror(file, &err));
+        exit(1);
+    }
+    gzclose(file);
+    free(back);
+    free(data);
+    printf("gzio with mapped and growing input\n");
+#endif
+}
+
+/* ===========================================================================
+ * Test random access to .gz files with an index
+ */
+static void test_gzindex(const char *fname) {
+#ifdef NO_GZCOMPRESS
+    fprintf(stderr, "NO_GZCOMPRESS -- gz* functions cannot compress\n");
+#else
+    int err, n;
+    unsigned i, len = 600000;
+    uLong r = 1;
+    unsigned char *data, *back;
+    char *iname;
+    long pos;
+    gzFile file;
+
+    data = test_alloc(len);
+    back = test_alloc(len);
+    iname = test_alloc(strlen(fname) + 5);
+    strcpy(iname, fname);
+    strcat(iname, ".idx");
+    for (i = 0; i < len; i++) {
+        rand_next(&r);
+        data[i] = (unsigned char)(i % 193 < 100 ? i / 89 : r >> 23);
+    }
+
+    /* two gzip members */
+    file = gzopen(fname, "wb");
+    if (file == NULL || gzwrite(file, data, 350000) != 350000 ||
+            gzclose(file) != Z_OK ||
+            (file = gzopen(fname, "ab")) == NULL ||
+            gzwrite(file, data + 350000, len - 350000) != (int)(len - 350000) ||
+            gzclose(file) != Z_OK) {
+        fprintf(stderr, "gzwrite error\n");
+        exit(1);
+    }
+
+    /* index it, and compare reads after seeking all over, some of which go
+       from the first member into the second */
+    file = gzopen(fname, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    n = gzindex_build(file, 32768L);
+    if (n < 4) {
+        fprintf(stderr, "gzindex_build error %d\n", n);
+        exit(1);
+    }
+    for (i = 0; i < 40; i++) {
+        pos = (long)((i * 2654435761U) % (len - 1000));
+        if (i == 7)
+            pos = 349000L;
+        if (gzseek(file, pos, SEEK_SET) != pos ||
+                gzread(file, back, 2000) != (len - pos < 2000 ?
+                                             (int)(len - pos) : 2000) ||
+                memcmp(back, data + pos, len - pos < 2000 ? len - pos : 2000)) {
+            fprintf(stderr, "indexed gzseek err at %ld: %s\n", pos,
+                    gzerror(file, &err));
+            exit(1);
+        }
+    }
+    if (gzseek(file, 100L, SEEK_SET) != 100L ||
+            gzread(file, back, len) != (int)(len - 100) ||
+            memcmp(back, data + 100, len - 100) || !gzeof(file) ||
+            gzindex_save(file, iname) != Z_OK) {
+        fprintf(stderr, "indexed gzread err: %s\n", gzerror(file, &err));
+        exit(1);
+    }
+    gzclose(file);
+
+    /* load the saved index, and read backwards through mapped input */
+    file = gzopen(fname, "rbm");
+    if (file == NULL || gzindex_load(file, iname) != n) {
+        fprintf(stderr, "gzindex_load error\n");
+        exit(1);
+    }
+    for (pos = (long)len - 5000; pos >= 0; pos -= 45000L)
+        if (gzseek(file, pos, SEEK_SET) != pos ||
+                gzread(file, back, 5000) != 5000 ||
+                memcmp(back, data + pos, 5000)) {
+            fprintf(stderr, "loaded index gzseek err at %ld: %s\n", pos,
+                    gzerror(file, &err));
+            exit(1);
+        }
+    gzclose(file);
+    remove(iname);
+    free(iname);
+    free(back);
+    free(data);
+    printf("gzindex: OK\n");
+#endif
+}
+
+/* ===========================================================================
+ * Test parallel decompression of several gzip members, with and without an
+ * index, and of one long member, and that a bad check value in a trailer is
+ * caught
+ */
+static int check_parallel(gzFile file, int threads, const unsigned char *data,
+                          unsigned len, unsigned char *back) {
+    int ret;
+    FILE *out;
+
+    out = tmpfile();
+    if (out == NULL) {
+        fprintf(stderr, "tmpfile error\n");
+        exit(1);
+    }
+    ret = gzuncompressParallel(file, fileno(out), threads);
+    if (ret == Z_OK && (fseek(out, 0L, SEEK_SET) ||
+                        fread(back, 1, len + 1, out) != len ||
+                        memcmp(back, data, len)))
+        ret = Z_ERRNO;
+    fclose(out);
+    return ret;
+}
+
+static void test_gzuncompress_parallel(const char *fname) {
+#ifdef NO_GZCOMPRESS
+    fprintf(stderr, "NO_GZCOMPRESS -- gz* functions cannot compress\n");
+#else
+    int ret;
+    unsigned i, len = 600000, most = 6000000;
+    uLong r = 1;
+    unsigned char *data, *back;
+    gzFile file;
+    FILE *in;
+
+    data = test_alloc(most);
+    back = test_alloc(most + 1);
+    for (i = 0; i < most; i++) {
+        rand_next(&r);
+        data[i] = (unsigned char)(i % 193 < 100 ? i / 89 : r >> 23);
+    }
+
+    /* six gzip members */
+    for (i = 0; i < 6; i++) {
+        file = gzopen(fname, i ? "ab" : "wb");
+        if (file == NULL || gzwrite(file, data + i * 100000, 100000) != 100000 ||
+                gzclose(file) != Z_OK) {
+            fprintf(stderr, "gzwrite error\n");
+            exit(1);
+        }
+    }
+
+    /* decompress the members in parallel, and then the spans of an index */
+    file = gzopen(fname, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    ret = check_parallel(file, 4, data, len, back);
+    if (ret != Z_OK) {
+        fprintf(stderr, "gzuncompressParallel members error %d\n", ret);
+        exit(1);
+    }
+    if (gzindex_build(file, 32768L) < 12 ||
+            (ret = check_parallel(file, 3, data, len, back)) != Z_OK ||
+            gzread(file, back, 1000) != 1000 || memcmp(back, data, 1000)) {
+        fprintf(stderr, "gzuncompressParallel index error %d\n", ret);
+        exit(1);
+    }
+
+    /* change the check value of the last member */
+    in = fopen(fname, "r+b");
+    if (in == NULL || fseek(in, -8L, SEEK_END) || (ret = getc(in)) == EOF ||
+            fseek(in, -8L, SEEK_END) || putc(ret ^ 1, in) == EOF ||
+            fclose(in)) {
+        fprintf(stderr, "could not change %s\n", fname);
+        exit(1);
+    }
+    ret = check_parallel(file, 3, data, len, back);
+    gzclose(file);
+    if (ret != Z_DATA_ERROR) {
+        fprintf(stderr, "gzuncompressParallel index check error %d\n", ret);
+        exit(1);
+    }
+    file = gzopen(fname, "rb");
+    if (file == NULL ||
+            (ret = check_parallel(file, 2, data, len, back)) != Z_DATA_ERROR) {
+        fprintf(stderr, "gzuncompressParallel members check error %d\n", ret);
+        exit(1);
+    }
+    gzclose(file);
+
+    /* one member long enough to be split when mapped */
+    file = gzopen(fname, "wb");
+    if (file == NULL || gzwrite(file, data, most) != (int)most ||
+            gzclose(file) != Z_OK) {
+        fprintf(stderr, "gzwrite error\n");
+        exit(1);
+    }
+    file = gzopen(fname, "rm");
+    if (file == NULL ||
+            (ret = check_parallel(file, 4, data, most, back)) != Z_OK) {
+        fprintf(stderr, "gzuncompressParallel long member error %d\n", ret);
+        exit(1);
+    }
+    gzclose(file);
+    free(back);
+    free(data);
+    printf("gzuncompressParallel: OK\n");
+#endif
+}
+
+/* ===========================================================================
+ * Test writing in block mode, and using the block lists as an index
+ */
+static void test_gzblock(const char *fname) {
+#ifdef NO_GZCOMPRESS
+    fprintf(stderr, "NO_GZCOMPRESS -- gz* functions cannot compress\n");
+#else
+    int err, n;
+    unsigned i, len = 740000;
+    uLong r = 1;
+    unsigned char *data, *back;
+    long pos;
+    gzFile file;
+
+    data = test_alloc(len);
+    back = test_alloc(len + 1);
+    for (i = 0; i < len; i++) {
+        rand_next(&r);
+        data[i] = (unsigned char)(i % 193 < 100 ? i / 89 : r >> 23);
+    }
+
+    /* two members in 50000-byte blocks, and then an appended member in
+       16-byte blocks, which has more than one list */
+    file = gzopen(fname, "wb");
+    if (file == NULL || gzsetblock(file, 50000) != 0 ||
+            gzwrite(file, data, 350000) != 350000 ||
+            gzflush(file, Z_FINISH) != Z_OK ||
+            gzwrite(file, data + 350000, 250000) != 250000 ||
+            gzclose(file) != Z_OK ||
+            (file = gzopen(fname, "ab")) == NULL ||
+            gzsetblock(file, 16) != 0 ||
+            gzwrite(file, data + 600000, 140000) != 140000 ||
+            gzsetblock(file, 16) != -1 || gzclose(file) != Z_OK) {
+        fprintf(stderr, "gzwrite block mode error\n");
+        exit(1);
+    }
+
+    /* the lists don't change the data, and give an access point per block */
+    file = gzopen(fname, "rb");
+    if (file == NULL || gzread(file, back, len + 1) != (int)len ||
+            memcmp(back, data, len)) {
+        fprintf(stderr, "gzread block mode error\n");
+        exit(1);
+    }
+    n = gzindex_load(file, NULL);
+    if (n != 7 + 5 + 8750) {
+        fprintf(stderr, "gzindex_load block lists error %d\n", n);
+        exit(1);
+    }
+    for (i = 0; i < 40; i++) {
+        pos = (long)((i * 2654435761U) % (len - 1000));
+        if (gzseek(file, pos, SEEK_SET) != pos ||
+                gzread(file, back, 1000) != 1000 ||
+                memcmp(back, data + pos, 1000)) {
+            fprintf(stderr, "block gzseek err at %ld: %s\n", pos,
+                    gzerror(file, &err));
+            exit(1);
+        }
+    }
+    n = check_parallel(file, 3, data, len, back);
+    gzclose(file);
+    if (n != Z_OK) {
+        fprintf(stderr, "gzuncompressParallel block error %d\n", n);
+        exit(1);
+    }
+
+    /* a file without lists at the end is not indexed */
+    file = gzopen(fname, "ab");
+    if (file == NULL || gzwrite(file, data, 1000) != 1000 ||
+            gzclose(file) != Z_OK || (file = gzopen(fname, "rb")) == NULL ||
+            gzindex_load(file, NULL) != Z_DATA_ERROR) {
+        fprintf(stderr, "gzindex_load without lists error\n");
+        exit(1);
+    }
+    gzclose(file);
+    free(back);
+    free(data);
+    printf("gzsetblock: OK\n");
+#endif
+}
+
+/* ===========================================================================
+ * Test gzwritev() and gzreadv() with fragments large and small
+ */
+static void test_gzvec(const char *fname) {
+#ifdef NO_GZCOMPRESS
+    fprintf(stderr, "NO_GZCOMPRESS -- gz* functions cannot compress\n");
+#else
+    int err;
+    unsigned i, k, off, start, len = 400000;
+    uLong r = 1;
+    unsigned char *data, *back;
+    z_iovec iov[16];
+    z_size_t got;
+    gzFile file;
+
+    data = test_alloc(len);
+    back = test_alloc(len + 1);
+    for (i = 0; i < len; i++) {
+        rand_next(&r);
+        data[i] = (unsigned char)(i % 211 < 150 ? i / 97 : r >> 23);
+    }
+
+    /* write fragments of every size class, including empty ones, between
+       plain writes */
+    file = gzopen(fname, "wb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    off = 0;
+    for (k = 0; off < len; k++) {
+        start = off;
+        for (i = 0; i < 16 && off < len; i++) {
+            unsigned n = (i * 7919U + k * 104729U) % (i & 1 ? 100 : 70000);
+            if (n > len - off)
+                n = len - off;
+            iov[i].base = data + off;
+            iov[i].len = n;
+            off += n;
+        }
+        if (gzwritev(file, iov, i) != off - start) {
+            fprintf(stderr, "gzwritev err: %s\n", gzerror(file, &err));
+            exit(1);
+        }
+    }
+    if (gzwritev(file, iov, 0) != 0 || gzclose(file) != Z_OK) {
+        fprintf(stderr, "gzwritev close error\n");
+        exit(1);
+    }
+
+    /* read it back in fragments, the last running past the end */
+    file = gzopen(fname, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    memset(back, 0, len + 1);
+    for (i = 0; i < 4; i++) {
+        iov[i].base = back + i * 13;
+        iov[i].len = 13;
+    }
+    iov[4].base = back + 52;
+    iov[4].len = 300000;
+    iov[5].base = back + 300052;
+    iov[5].len = 0;
+    iov[6].base = back + 300052;
+    iov[6].len = len - 300052 + 1;
+    got = gzreadv(file, iov, 7);
+    if (got != len || memcmp(back, data, len) || !gzeof(file)) {
+        fprintf(stderr, "gzreadv err %lu: %s\n", (unsigned long)got,
+                gzerror(file, &err));
+        exit(1);
+    }
+    iov[0].base = NULL;
+    if (gzreadv(file, iov, 1) != 0) {
+        fprintf(stderr, "gzreadv NULL fragment error\n");
+        exit(1);
+    }
+    gzerror(file, &err);
+    gzclose(file);
+    if (err != Z_STREAM_ERROR) {
+        fprintf(stderr, "gzreadv NULL fragment error %d\n", err);
+        exit(1);
+    }
+    free(back);
+    free(data);
+    printf("gzwritev/gzreadv: OK\n");
+#endif
+}
+
+/* ===========================================================================
+ * Test gzgetline() with lines in place and lines across buffer refills
+ */
+static void test_gzgetline(const char *fname) {
+#ifdef NO_GZCOMPRESS
+    fprintf(stderr, "NO_GZCOMPRESS -- gz* functions cannot compress\n");
+#else
+    int err;
+    unsigned i, k, off, len = 300000;
+    uLong r = 1;
+    unsigned char *data;
+    const char *line;
+    z_size_t n;
+    gzFile file;
+
+    /* lines of 1 to 100 bytes, one of 100000 bytes, and no final newline */
+    data = test_alloc(len);
+    for (i = 0; i < len; i++) {
+        rand_next(&r);
+        data[i] = (unsigned char)('a' + (r >> 23) % 26);
+        if ((r >> 8) % 50 == 0 && (i < 100000 || i > 200000))
+            data[i] = '\n';
+    }
+    data[len - 1] = 'z';
+    file = gzopen(fname, "wb");
+    if (file == NULL || gzwrite(file, data, len) != (int)len ||
+            gzclose(file) != Z_OK) {
+        fprintf(stderr, "gzwrite error\n");
+        exit(1);
+    }
+
+    /* read it back a line at a time, with a small buffer, mixed with gzgetc() */
+    file = gzopen(fname, "rb");
+    if (file == NULL || gzbuffer(file, 4096) != 0) {
+        fprintf(stderr, "gzopen error\n");
+        exit(1);
+    }
+    off = 0;
+    for (k = 0; off < len; k++) {
+        if (k % 7 == 3) {
+            if (gzgetc(file) != data[off]) {
+                fprintf(stderr, "gzgetc after gzgetline error\n");
+                exit(1);
+            }
+            off++;
+            continue;
+        }
+        n = gzgetline(file, &line);
+        if (n == 0 || n > len - off || memcmp(line, data + off, n) ||
+                (line[n - 1] != '\n' && off + n != len) ||
+                memchr(line, '\n', n - 1) != NULL) {
+            fprintf(stderr, "gzgetline error at %u: %s\n", off,
+                    gzerror(file, &err));
+            exit(1);
+        }
+        off += (unsigned)n;
+    }
+    if (gzgetline(file, &line) != 0 || line != NULL || !gzeof(file)) {
+        fprintf(stderr, "gzgetline end error\n");
+        exit(1);
+    }
+    gzclose(file);
+    free(data);
+    printf("gzgetline: OK\n");
+#endif
+}
+
+#endif /* Z_SOLO */
+
+/* ===========================================================================
+ * Test deflate() with small buffers
+ */
+static void test_deflate(Byte *compr, uLong comprLen) {
+    z_stream c_stream; /* compression stream */
+    int err;
+    uLong len = (uLong)strlen(hello)+1;
+
+    c_stream.zalloc = zalloc;
+    c_stream.zfree = zfree;
+    c_stream.opaque = (voidpf)0;
+
+    err = deflateInit(&c_stream, Z_DEFAULT_COMPRESSION);
+    CHECK_ERR(err, "deflateInit");
+
+    c_stream.next_in  = (z_const unsigned char *)hello;
+    c_stream.next_out = compr;
+
+    while (c_stream.total_in != len && c_stream.total_out < comprLen) {
+        c_stream.avail_in = c_stream.avail_out = 1; /* force small buffers */
+        err = deflate(&c_stream, Z_NO_FLUSH);
+        CHECK_ERR(err, "deflate");
+    }
+    /* Finish the stream, still forcing small buffers: */
+    for (;;) {
+        c_stream.avail_out = 1;
+        err = deflate(&c_stream, Z_FINISH);
+        if (err == Z_STREAM_END) break;
+        CHECK_ERR(err, "deflate");
+    }
+
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+}
+
+/* ===========================================================================
+ * Test inflate() with small buffers
+ */
+static void test_inflate(Byte *compr, uLong comprLen, Byte *uncompr,
+                  uLong uncomprLen) {
+    int err;
+    z_stream d_stream; /* decompression stream */
+
+    strcpy((char*)uncompr, "garbage");
+
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+
+    d_stream.next_in  = compr;
+    d_stream.avail_in = 0;
+    d_stream.next_out = uncompr;
+
+    err = inflateInit(&d_stream);
+    CHECK_ERR(err, "inflateInit");
+
+    while (d_stream.total_out < uncomprLen && d_stream.total_in < comprLen) {
+        d_stream.avail_in = d_stream.avail_out = 1; /* force small buffers */
+        err = inflate(&d_stream, Z_NO_FLUSH);
+        if (err == Z_STREAM_END) break;
+        CHECK_ERR(err, "inflate");
+    }
+
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+
+    if (strcmp((char*)uncompr, hello)) {
+        fprintf(stderr, "bad inflate\n");
+        exit(1);
+    } else {
+        printf("inflate(): %s\n", (char *)uncompr);
+    }
+}
+
+/* ===========================================================================
+ * Test inflate() on matches with every distance up to 40, using output
+ * buffers of many sizes with and without slack
+ */
+static void test_inflate_copy(void) {
+    int err;
+    unsigned i, dist, slack, size;
+    uLong len = 50000L, comprLen;
+    Byte *data, *compr, *uncompr;
+    z_stream d_stream; /* decompression stream */
+
+    comprLen = compressBound(len);
+    data = test_alloc(len);
+    compr = test_alloc(comprLen);
+    uncompr = test_alloc(len + 64);
+    for (i = 0, dist = 1; i < len; i++) {
+        if (i % 1000 == 0)
+            dist = dist % 40 + 1;
+        data[i] = i % 1000 < dist ? (Byte)(i * 131 + (i >> 8)) :
+                                    data[i - dist];
+    }
+    err = compress(compr, &comprLen, data, len);
+    CHECK_ERR(err, "compress");
+
+    for (slack = 0; slack <= 32; slack += 32)
+        for (size = 1; size <= 4096; size = size * 3 + 1) {
+            inflate_init(&d_stream, MAX_WBITS);
+            d_stream.next_in = compr;
+            d_stream.avail_in = (uInt)comprLen;
+            err = inflateSlack(&d_stream, slack);
+            CHECK_ERR(err, "inflateSlack");
+            do {
+                d_stream.next_out = uncompr + d_stream.total_out;
+                d_stream.avail_out = len - d_stream.total_out < size ?
+                                     (uInt)(len - d_stream.total_out) : size;
+                err = inflate(&d_stream, Z_NO_FLUSH);
+            } while (err == Z_OK);
+            if (err != Z_STREAM_END || d_stream.total_out != len ||
+                memcmp(data, uncompr, len)) {
+                fprintf(stderr, "bad inflate copy: %d, size %u slack %u\n",
+                        err, size, slack);
+                exit(1);
+            }
+            err = inflateEnd(&d_stream);
+            CHECK_ERR(err, "inflateEnd");
+        }
+    printf("inflate copies: OK\n");
+
+    free(data);
+    free(compr);
+    free(uncompr);
+}
+
+/* ===========================================================================
+ * Count the memory allocated for a stream
+ */
+static uLong allocated;
+
+static void *count_alloc(void *q, unsigned n, unsigned m) {
+    (void)q;
+    allocated += (uLong)n * m;
+    return calloc(n, m);
+}
+
+static void count_free(void *q, void *p) {
+    (void)q;
+    free(p);
+}
+
+/* ===========================================================================
+ * Test that inflate() with Z_FINISH and all of the output space does not
+ * allocate a window, for zlib and raw streams
+ */
+static void test_inflate_oneshot(void) {
+    int err, raw;
+    unsigned i;
+    uLong len = 100000L, comprLen;
+    Byte *data, *compr, *uncompr;
+    z_stream stream;
+
+    comprLen = compressBound(len);
+    data = test_alloc(len);
+    compr = test_alloc(comprLen);
+    uncompr = test_alloc(len);
+    for (i = 0; i < len; i++)
+        data[i] = (Byte)((i * i) >> 9);
+
+    for (raw = 0; raw < 2; raw++) {
+        deflate_init(&stream, 6, raw ? -15 : 15, 8, Z_DEFAULT_STRATEGY);
+        deflate_all(&stream, data, len, compr, comprLen);
+        err = deflateEnd(&stream);
+        CHECK_ERR(err, "deflateEnd");
+
+        allocated = 0;
+        stream.zalloc = count_alloc;
+        stream.zfree = count_free;
+        stream.next_in = compr;
+        stream.avail_in = (uInt)stream.total_out;
+        err = inflateInit2(&stream, raw ? -15 : 15);
+        CHECK_ERR(err, "inflateInit2");
+        stream.next_out = uncompr;
+        stream.avail_out = (uInt)len;
+        err = inflate(&stream, Z_FINISH);
+        if (err != Z_STREAM_END || stream.total_out != len ||
+            memcmp(data, uncompr, len)) {
+            fprintf(stderr, "bad inflate one shot\n");
+            exit(1);
+        }
+        err = inflateEnd(&stream);
+        CHECK_ERR(err, "inflateEnd");
+        if (allocated >= 1U << 15) {
+            fprintf(stderr, "inflate one shot allocated a window\n");
+            exit(1);
+        }
+    }
+    printf("inflate one shot: OK\n");
+
+    free(data);
+    free(compr);
+    free(uncompr);
+}
+
+/* ===========================================================================
+ * Test that streams released to a pool are reused without allocating
+ */
+static void test_stream_pool(void) {
+    int err, round;
+    unsigned i;
+    uLong len = 100000L, comprLen, total;
+    Byte *data, *compr, *uncompr;
+    z_stream stream;
+    z_poolp pool;
+
+    comprLen = compressBound(len);
+    data = test_alloc(len);
+    compr = test_alloc(comprLen);
+    uncompr = test_alloc(len);
+    pool = zlibPoolCreate(2);
+    if (pool == Z_NULL) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    for (i = 0; i < len; i++)
+        data[i] = (Byte)((i * i) >> 9);
+
+    allocated = 0;
+    for (round = 0; round < 4; round++) {
+        total = allocated;
+        stream.zalloc = count_alloc;
+        stream.zfree = count_free;
+        stream.opaque = (voidpf)0;
+        err = deflatePoolInit2(&stream, pool, round == 1 ? 9 : 1, Z_DEFLATED,
+                               round == 3 ? 14 : 15, 8, Z_DEFAULT_STRATEGY);
+        CHECK_ERR(err, "deflatePoolInit2");
+        if (round == 1) {
+            err = deflateTune(&stream, 4, 4, 8, 8);
+            CHECK_ERR(err, "deflateTune");
+        }
+        deflate_all(&stream, data, len, compr, comprLen);
+        err = deflatePoolEnd(&stream, pool);
+
+        CHECK_ERR(err, "deflatePoolEnd");
+
+        stream.next_in = compr;
+        stream.avail_in = (uInt)stream.total_out;
+        err = inflatePoolInit2(&stream, pool, 15);
+        CHECK_ERR(err, "inflatePoolInit2");
+        stream.next_out = uncompr;
+        do {
+            stream.avail_out = 1000;
+            err = inflate(&stream, Z_NO_FLUSH);
+        } while (err == Z_OK);
+        if (err != Z_STREAM_END || stream.total_out != len ||
+            memcmp(data, uncompr, len)) {
+            fprintf(stderr, "bad inflate from pool\n");
+            exit(1);
+        }
+        err = inflatePoolEnd(&stream, pool);
+        CHECK_ERR(err, "inflatePoolEnd");
+
+        /* the second and third rounds reuse everything from the first, and
+           the fourth needs a different deflate window */
+        if ((round == 1 || round == 2) != (allocated == total)) {
+            fprintf(stderr, "bad stream pool reuse\n");
+            exit(1);
+        }
+    }
+    zlibPoolDestroy(pool);
+    printf("stream pool: OK\n");
+
+    free(data);
+    free(compr);
+    free(uncompr);
+}
+
+/* ===========================================================================
+ * Test that deflateMemory() reports what deflateInit2() allocates
+ */
+static void test_deflate_memory(void) {
+    static const int params[][2] = {{15, 8}, {-9, 1}, {31, 9}, {8, 4}};
+    int err;
+    unsigned i;
+    z_stream stream, copy;
+
+    for (i = 0; i < sizeof(params) / sizeof(params[0]); i++) {
+        allocated = 0;
+        stream.zalloc = count_alloc;
+        stream.zfree = count_free;
+        stream.opaque = (voidpf)0;
+        err = deflateInit2(&stream, 6, Z_DEFLATED, params[i][0],
+                           params[i][1], Z_DEFAULT_STRATEGY);
+        CHECK_ERR(err, "deflateInit2");
+        err = deflateCopy(&copy, &stream);
+        CHECK_ERR(err, "deflateCopy");
+        if (deflateMemory(params[i][0], params[i][1]) == 0 ||
+            allocated != 2 * deflateMemory(params[i][0], params[i][1])) {
+            fprintf(stderr, "deflateMemory does not match\n");
+            exit(1);
+        }
+        err = deflateEnd(&copy);
+        CHECK_ERR(err, "deflateEnd");
+        err = deflateEnd(&stream);
+        CHECK_ERR(err, "deflateEnd");
+    }
+    if (deflateMemory(16, 8) != 0 || deflateMemory(15, 0) != 0) {
+        fprintf(stderr, "deflateMemory accepts bad parameters\n");
+        exit(1);
+    }
+    printf("deflate memory: OK\n");
+}
+
+/* ===========================================================================
+ * Test deflateInitCompact() and deflateIdle() with messages sent with
+ * Z_SYNC_FLUSH, checking that the idle streams are small and that the
+ * messages all decompress
+ */
+static void test_deflate_compact(void) {
+    static const int levels[] = {1, 6, 9, 10};
+    int err, k, m;
+    uLong msg = 600, rnd = 1, pos, have;
+    Byte *data, *compr, dict[32768];
+    uInt dictLen;
+    z_stream c_stream, copy;
+
+    data = test_alloc(20 * msg);
+    compr = test_alloc(20 * msg);
+    for (pos = 0; pos < 20 * msg; pos++) {
+        rand_next(&rnd);
+        data[pos] = (Byte)((rnd >> 16) % 5 ? 'a' + (rnd >> 23) % 8 : ' ');
+    }
+
+    for (k = 0; k < 5; k++) {
+        c_stream.zalloc = zalloc;
+        c_stream.zfree = zfree;
+        c_stream.opaque = (voidpf)0;
+        if (k < 4)
+            err = deflateInitCompact(&c_stream, levels[k], 12);
+        else
+            err = deflateInit(&c_stream, Z_DEFAULT_COMPRESSION);
+        CHECK_ERR(err, "deflateInitCompact");
+        if (k == 4 && deflateFootprint(&c_stream) != deflateMemory(15, 8)) {
+            fprintf(stderr, "bad deflateFootprint\n");
+            exit(1);
+        }
+        c_stream.next_out = compr;
+        c_stream.avail_out = (uInt)(20 * msg);
+        for (m = 0; m < 20; m++) {
+            c_stream.next_in = data + m * msg;
+            c_stream.avail_in = (uInt)msg;
+            if (k == 4 && m == 10) {
+                c_stream.avail_in = (uInt)(msg / 2);
+                err = deflate(&c_stream, Z_NO_FLUSH);
+                CHECK_ERR(err, "deflate");
+                c_stream.avail_in = (uInt)(msg - msg / 2);
+                err = deflateIdle(&c_stream);
+                if (err != Z_BUF_ERROR) {
+                    fprintf(stderr, "deflateIdle mid-message: %d\n", err);
+                    exit(1);
+                }
+            }
+            err = deflate(&c_stream, Z_SYNC_FLUSH);
+            CHECK_ERR(err, "deflate");
+            if (k == 4) {
+                err = deflateIdle(&c_stream);
+                CHECK_ERR(err, "deflateIdle");
+            }
+            if (m == 10) {
+                err = deflateCopy(&copy, &c_stream);
+                CHECK_ERR(err, "deflateCopy");
+                if (deflateEnd(&c_stream) != Z_DATA_ERROR) {
+                    fprintf(stderr, "deflateEnd should report "
+                            "Z_DATA_ERROR\n");
+                    exit(1);
+                }
+                err = deflateCopy(&c_stream, &copy);
+                CHECK_ERR(err, "deflateCopy");
+                deflateEnd(&copy);
+            }
+            if (deflateFootprint(&c_stream) > 32768L) {
+                fprintf(stderr, "idle stream of %lu bytes\n",
+                        deflateFootprint(&c_stream));
+                exit(1);
+            }
+        }
+        dictLen = sizeof(dict);
+        err = deflateGetDictionary(&c_stream, dict, &dictLen);
+        CHECK_ERR(err, "deflateGetDictionary");
+        if (dictLen != (k < 4 ? 4096 : 12000) ||
+            memcmp(dict, data + 20 * msg - dictLen, dictLen)) {
+            fprintf(stderr, "bad idle dictionary\n");
+            exit(1);
+        }
+        err = deflate(&c_stream, Z_FINISH);
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "deflate should report Z_STREAM_END\n");
+            exit(1);
+        }
+        have = c_stream.total_out;
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+        check_inflate(compr, have, MAX_WBITS, data, 20 * msg,
+                      "compact stream");
+    }
+    printf("deflate compact: OK\n");
+
+    free(data);
+    free(compr);
+}
+
+
+/* ===========================================================================
+ * Test deflateInit3() with hash table and symbol buffer sizes set apart
+ */
+static void test_deflate_config(void) {
+    static const int sizes[][3] = {{15, 15, 14}, {15, 9, 15}, {10, 16, 7},
+                                   {-9, 8, 12}, {31, 12, 9}, {15, 20, 14},
+                                   {-12, 24, 15}};
+    z_deflate_config config;
+    int err, k, pass;
+    unsigned i;
+    uLong len = 100000L, comprLen, size[2], rnd = 1;
+    Byte *data, *compr[2];
+    z_stream c_stream; /* compression stream */
+
+    comprLen = 2 * compressBound(len);
+    data = test_alloc(len);
+    compr[0] = test_alloc(comprLen);
+    compr[1] = test_alloc(comprLen);
+    for (i = 0; i < len; i++) {
+        rand_next(&rnd);
+        data[i] = i > 2000 && i < 70000 && (rnd >> 16) % 4 ?
+                  data[i - 1 - (rnd >> 8) % 2000] : (Byte)(rnd >> 23);
+    }
+
+    /* the default sizes give the same stream as deflateInit2(), and the others
+       round trip within deflateBound() whether the input compresses or not */
+    for (k = 0; k < (int)(sizeof(sizes) / sizeof(sizes[0])); k++) {
+        for (pass = 0; pass < 2; pass++) {
+            c_stream.zalloc = zalloc;
+            c_stream.zfree = zfree;
+            c_stream.opaque = (voidpf)0;
+            if (pass == 0) {
+                config.windowBits = sizes[k][0];
+                config.hashBits = sizes[k][1];
+                config.symBits = sizes[k][2];
+                config.good_length = config.max_lazy = 0;
+                config.nice_length = config.max_chain = 0;
+                err = deflateInit3(&c_stream, Z_NULL, 6, Z_DEFAULT_STRATEGY,
+                                   &config);
+                CHECK_ERR(err, "deflateInit3");
+            }
+            else
+                deflate_init(&c_stream, 6, 15, 8, Z_DEFAULT_STRATEGY);
+            size[pass] = deflate_all(&c_stream, data, len, compr[pass],
+                                     deflateBound(&c_stream, len));
+            err = deflateEnd(&c_stream);
+            CHECK_ERR(err, "deflateEnd");
+            if (k != 0)
+                break;
+        }
+        if (k == 0 && (size[0] != size[1] ||
+                       memcmp(compr[0], compr[1], size[0]))) {
+            fprintf(stderr, "deflateInit3 differs from deflateInit2\n");
+            exit(1);
+        }
+        check_inflate(compr[0], size[0], sizes[k][0] < 0 ? sizes[k][0] : 47,
+                      data, len, "deflate config");
+    }
+
+    /* search parameters are applied as by deflateTune(), and bad sizes are
+       refused */
+    config.windowBits = 15;
+    config.hashBits = 15;
+    config.symBits = 14;
+    config.good_length = 4;
+    config.max_lazy = config.nice_length = config.max_chain = 4;
+    for (pass = 0; pass < 2; pass++) {
+        if (pass == 0) {
+            err = deflateInit3(&c_stream, Z_NULL, 6, Z_DEFAULT_STRATEGY,
+                               &config);
+            CHECK_ERR(err, "deflateInit3");
+        }
+        else {
+            deflate_init(&c_stream, 6, MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+            err = deflateTune(&c_stream, 4, 4, 4, 4);
+            CHECK_ERR(err, "deflateTune");
+        }
+        size[pass] = deflate_all(&c_stream, data, len, compr[pass], comprLen);
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+    }
+    if (size[0] != size[1] || memcmp(compr[0], compr[1], size[0])) {
+        fprintf(stderr, "deflateInit3 did not tune the search\n");
+        exit(1);
+    }
+    config.hashBits = 25;
+    if (deflateInit3(&c_stream, Z_NULL, 6, Z_DEFAULT_STRATEGY, &config) !=
+            Z_STREAM_ERROR ||
+        deflateInit3(&c_stream, Z_NULL, 6, Z_DEFAULT_STRATEGY, Z_NULL) !=
+            Z_STREAM_ERROR) {
+        fprintf(stderr, "deflateInit3 accepts bad parameters\n");
+        exit(1);
+    }
+    config.hashBits = 15;
+    config.symBits = 6;
+    if (deflateInit3(&c_stream, Z_NULL, 6, Z_DEFAULT_STRATEGY, &config) !=
+            Z_STREAM_ERROR) {
+        fprintf(stderr, "deflateInit3 accepts bad parameters\n");
+        exit(1);
+    }
+    printf("deflate config: OK\n");
+
+    free(data);
+    free(compr[0]);
+    free(compr[1]);
+}
+
+/* ===========================================================================
+ * Test that deflateEstimate() follows the compressed size, and gives the exact
+ * size of the stored data
+ */
+static void test_deflate_estimate(void) {
+    static const int levels[] = {0, 1, 6, 9};
+    int err, k;
+    uLong len = 200000L, comprLen, estimate, stored, rnd = 1;
+    Byte *data, *compr;
+    z_stream c_stream; /* compression stream */
+
+    comprLen = compressBound(len);
+    data = test_alloc(len);
+    compr = test_alloc(comprLen);
+    fill_repeat(data, len, &rnd, 1000, 4, 1000, 26);
+
+    /* the estimate is exact at the end, and so is the stored size at level
+       0, and halfway the estimate is within a few percent of what finishing
+       there makes */
+    for (k = 0; k < 4; k++) {
+        deflate_init(&c_stream, levels[k], MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+        deflate_all(&c_stream, data, len, compr, comprLen);
+        err = deflateEstimate(&c_stream, &estimate, &stored);
+        CHECK_ERR(err, "deflateEstimate");
+        if (estimate != c_stream.total_out) {
+            fprintf(stderr, "deflateEstimate not exact at the end\n");
+            exit(1);
+        }
+        if (levels[k] == 0 && stored != c_stream.total_out) {
+            fprintf(stderr, "deflateEstimate stored size is not exact\n");
+            exit(1);
+        }
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+
+        deflate_init(&c_stream, levels[k], MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+        c_stream.next_in = data;
+        c_stream.avail_in = (uInt)(len / 2);
+
+        c_stream.next_out = compr;
+        c_stream.avail_out = (uInt)comprLen;
+        err = deflate(&c_stream, Z_NO_FLUSH);
+        CHECK_ERR(err, "deflate");
+        err = deflateEstimate(&c_stream, &estimate, &stored);
+        CHECK_ERR(err, "deflateEstimate");
+        c_stream.avail_in = 0;
+        err = deflate(&c_stream, Z_FINISH);
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "deflate estimate should report Z_STREAM_END\n");
+            exit(1);
+        }
+        if (estimate > c_stream.total_out + c_stream.total_out / 20 + 20 ||
+            estimate < c_stream.total_out - c_stream.total_out / 20) {
+            fprintf(stderr, "deflateEstimate %lu is far from %lu at level %d\n",
+                    estimate, c_stream.total_out, levels[k]);
+            exit(1);
+        }
+        if (stored != len / 2 + 5 * 2 + 6) {
+            fprintf(stderr, "bad deflateEstimate stored size\n");
+            exit(1);
+        }
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+    }
+    printf("deflate estimate: OK\n");
+
+    free(data);
+    free(compr);
+}
+
+/* ===========================================================================
+ * Test that random input, which is sent as literals without looking for
+ * matches, still round trips with the input around it, and that a copy of it
+ * is found
+ */
+static void test_deflate_random(void) {
+    int err, level;
+    uInt i;
+    uLong len = 100000L, comprLen, rnd = 1;
+    Byte *data, *compr;
+    z_stream c_stream; /* compression stream */
+
+    comprLen = compressBound(len);
+    data = test_alloc(len);
+    compr = test_alloc(comprLen);
+
+    /* text, then random bytes, then a copy of the end of the random bytes,
+       then more text */
+    for (i = 0; i < len; i++) {
+        rand_next(&rnd);
+        data[i] = i < 20000 || i >= 80000 ? (Byte)("hello, hello! "[i % 14]) :
+                  i < 60000 ? (Byte)(rnd >> 16) : data[i - 20000];
+    }
+
+    for (level = 1; level <= 9; level++) {
+        deflate_init(&c_stream, level, MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+        deflate_all(&c_stream, data, len, compr, comprLen);
+        if (c_stream.total_out > 40000L + 40000L / 50) {
+            fprintf(stderr, "deflate random at level %d is too large: %lu\n",
+                    level, c_stream.total_out);
+            exit(1);
+        }
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+        check_inflate(compr, c_stream.total_out, MAX_WBITS, data, len,
+                      "deflate random");
+    }
+    printf("deflate random: OK\n");
+
+    free(data);
+    free(compr);
+}
+
+/* ===========================================================================
+ * Test deflateFork() and inflateFork(), with the forks continued differently
+ * and ended in different orders
+ */
+static void test_deflate_fork(void) {
+    int err, i;
+    uLong len = 60000L, half = 25000L, comprLen, rnd = 1;
+    uLong prefix, total[3];
+    Byte *data, *compr[3], *uncompr;
+    z_stream c[3], d[2];
+
+    comprLen = compressBound(len);
+    data = test_alloc(len);
+    uncompr = test_alloc(len);
+    for (i = 0; i < 3; i++)
+        compr[i] = test_alloc(comprLen);
+    for (i = 0; i < (int)len; i++) {
+        rand_next(&rnd);
+        data[i] = i % 3000 < 2000 ? (Byte)hello[i % 13] :
+                                    (Byte)((rnd >> 16) & 7);
+    }
+
+    /* compress the first part, then fork twice, from the source and a fork */
+    deflate_init(&c[0], 6, MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    c[0].next_in = data;
+    c[0].avail_in = (uInt)half;
+    c[0].next_out = compr[0];
+    c[0].avail_out = (uInt)comprLen;
+    err = deflate(&c[0], Z_NO_FLUSH);
+    CHECK_ERR(err, "deflate");
+    prefix = c[0].total_out;
+    err = deflateFork(&c[1], &c[0]);
+    CHECK_ERR(err, "deflateFork");
+    err = deflateFork(&c[2], &c[1]);
+    CHECK_ERR(err, "deflateFork");
+
+    /* finish each one differently, the source first */
+    for (i = 0; i < 3; i++) {
+        if (i) {
+            memcpy(compr[i], compr[0], (size_t)prefix);
+            c[i].next_out = compr[i] + prefix;
+        }
+        c[i].next_in = data + half;
+        c[i].avail_in = (uInt)(len - half);
+        if (i == 1) {
+            err = deflateParams(&c[1], 1, Z_DEFAULT_STRATEGY);
+            CHECK_ERR(err, "deflateParams");
+        }
+        if (i == 2) {
+            err = deflate(&c[2], Z_FULL_FLUSH);
+            CHECK_ERR(err, "deflate");
+        }
+        err = deflate(&c[i], Z_FINISH);
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "deflate fork should report Z_STREAM_END\n");
+            exit(1);
+        }
+        total[i] = c[i].total_out;
+        if (i != 1) {
+            err = deflateEnd(&c[i]);
+            CHECK_ERR(err, "deflateEnd");
+        }
+    }
+    err = deflateEnd(&c[1]);
+    CHECK_ERR(err, "deflateEnd");
+
+    for (i = 0; i < 3; i++)
+        check_inflate(compr[i], total[i], MAX_WBITS, data, len, "deflate fork");
+
+
+    /* decompress the first part, fork, and finish both, the fork first */
+    inflate_init(&d[0], MAX_WBITS);
+    d[0].next_in = compr[0];
+    d[0].avail_in = (uInt)(total[0] / 2);
+    d[0].next_out = uncompr;
+    d[0].avail_out = (uInt)len;
+    err = inflate(&d[0], Z_NO_FLUSH);
+    CHECK_ERR(err, "inflate");
+    err = inflateFork(&d[1], &d[0]);
+    CHECK_ERR(err, "inflateFork");
+    prefix = d[0].total_out;
+    for (i = 1; i >= 0; i--) {
+        memset(uncompr + prefix, 0, (size_t)(len - prefix));
+        d[i].avail_in = (uInt)(total[0] - d[i].total_in);
+        err = inflate(&d[i], Z_FINISH);
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "inflate fork should report Z_STREAM_END\n");
+            exit(1);
+        }
+        if (d[i].total_out != len || memcmp(uncompr, data, (size_t)len)) {
+            fprintf(stderr, "bad inflate fork %d\n", i);
+            exit(1);
+        }
+        err = inflateEnd(&d[i]);
+        CHECK_ERR(err, "inflateEnd");
+    }
+    printf("deflate fork: OK\n");
+
+    free(data);
+    free(uncompr);
+    for (i = 0; i < 3; i++)
+        free(compr[i]);
+}
+
+/* ===========================================================================
+ * Test inflateSyncScan() against a byte-by-byte search, and by decompressing
+ * from each of the flush points it finds
+ */
+static void test_sync_scan(void) {
+    int err;
+    unsigned i, k, n, found[2];
+    uLong len = 100000L, step = 10000L, comprLen, rnd = 1;
+    z_size_t base, points[64], flush[10];
+    Byte *data, *compr;
+    z_stream c_stream; /* compression stream */
+
+    comprLen = compressBound(len) + 100;
+    data = test_alloc(len);
+    compr = test_alloc(comprLen);
+
+
+    /* patterns at every alignment, some overlapping zeros and 0xff runs, and
+       one cut off by the end */
+    for (i = 0; i < 1000; i++) {
+        rand_next(&rnd);
+        data[i] = (Byte)((rnd >> 16) & 1 ? 0 : 0xff);
+    }
+    for (i = 0; i < 1000; i += 37 + i % 5)
+        memcpy(data + i, "\0\0\377\377", 4);
+    memcpy(data + 996, "\0\0\377\377", 4);
+    for (n = 999; n <= 1000; n++) {
+        found[0] = found[1] = 0;
+        for (i = 0; i + 4 <= n; i++)
+            if (memcmp(data + i, "\0\0\377\377", 4) == 0)
+                found[0]++;
+        base = 0;
+        do {
+            k = inflateSyncScan(data + base, n - base, points, 8);
+            for (i = 0; i < k; i++) {
+                points[i] += base;
+                if (memcmp(data + points[i] - 4, "\0\0\377\377", 4)) {
+                    fprintf(stderr, "bad inflateSyncScan point\n");
+                    exit(1);
+                }
+            }
+            found[1] += k;
+            base = k ? points[k - 1] : n;
+        } while (k == 8);
+        if (found[0] != found[1]) {
+            fprintf(stderr, "inflateSyncScan found %u, not %u\n", found[1],
+                    found[0]);
+            exit(1);
+        }
+    }
+
+    /* compress with a full flush every step bytes, then decompress from each
+       flush point found */
+    for (i = 0; i < len; i++) {
+        rand_next(&rnd);
+        data[i] = i % 100 < 60 ? (Byte)hello[i % 13] :
+                                 (Byte)((rnd >> 16) & 0x3f);
+    }
+    deflate_init(&c_stream, 6, -15, 8, Z_DEFAULT_STRATEGY);
+    c_stream.next_out = compr;
+    c_stream.avail_out = (uInt)comprLen;
+    for (i = 0; i < 10; i++) {
+        c_stream.next_in = data + i * step;
+        c_stream.avail_in = (uInt)step;
+        err = deflate(&c_stream, i < 9 ? Z_FULL_FLUSH : Z_FINISH);
+        if (err != (i < 9 ? Z_OK : Z_STREAM_END)) {
+            fprintf(stderr, "deflate with flushes failed\n");
+            exit(1);
+        }
+        flush[i] = (z_size_t)c_stream.total_out;
+    }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+
+    n = inflateSyncScan(compr, flush[9], points, 64);
+    for (i = k = 0; i < 9; i++) {
+        while (k < n && points[k] < flush[i])
+            k++;
+        if (k == n || points[k] != flush[i]) {
+            fprintf(stderr, "inflateSyncScan missed a flush point\n");
+            exit(1);
+        }
+        check_inflate(compr + points[k], flush[9] - points[k], -15,
+                      data + (i + 1) * step, len - (i + 1) * step,
+                      "inflate from a flush point");
+    }
+    printf("inflateSyncScan(): OK\n");
+
+    free(data);
+    free(compr);
+}
+
+/* ===========================================================================
+ * Test inflateBackRing() with a ring that is not a power of two, input in
+ * lists of fragments of assorted sizes, and data after the deflate stream
+ */
+struct ring_io {
+    Byte *next;             /* input not yet given out */
+    uLong left;             /* bytes at next */
+    z_iovec vec[5];         /* fragments from the last ring_in() */
+    unsigned calls;         /* number of ring_in() calls */
+    Byte *ring;             /* output ring */
+    unsigned size;          /* bytes at ring */
+    Byte *out;              /* copy of the output */
+    uLong have;             /* bytes at out */
+};
+
+static unsigned ring_in(void *desc, z_iovec **vec) {
+    struct ring_io *io = (struct ring_io *)desc;
+    unsigned n = 0;
+    uLong len;
+
+    while (n < 5 && io->left) {
+        len = (io->calls * 7 + n * 131) % 1500;
+        if (len > io->left)
+            len = io->left;
+        io->vec[n].base = io->next;
+        io->vec[n].len = len;
+        io->next += len;
+        io->left -= len;
+        n++;
+    }
+    io->calls++;
+    *vec = io->vec;
+    return n;
+}
+
+static int ring_out(void *desc, unsigned char *buf, unsigned len) {
+    struct ring_io *io = (struct ring_io *)desc;
+
+    if (buf < io->ring || len > io->size - (unsigned)(buf - io->ring))
+        return 1;
+    memcpy(io->out + io->have, buf, len);
+    io->have += len;
+    return 0;
+}
+
+static void test_inflate_back_ring(void) {
+    int err;
+    uLong i, len = 200000L, comprLen, rnd = 1;
+    Byte *data, *compr, *window;
+    unsigned k;
+    struct ring_io io;
+    z_stream c_stream, d_stream;
+
+    comprLen = compressBound(len) + 100;
+    data = test_alloc(len);
+    compr = test_alloc(comprLen);
+    window = test_alloc(32768);
+    io.size = 40000;
+    io.ring = test_alloc(io.size);
+    io.out = test_alloc(len);
+    for (i = 0; i < len; i++) {
+        rand_next(&rnd);
+        data[i] = i % 1000 < 700 ? (Byte)hello[i % 13] :
+                                   (Byte)((rnd >> 16) & 0x3f);
+    }
+    deflate_init(&c_stream, 9, -15, 8, Z_DEFAULT_STRATEGY);
+    comprLen = deflate_all(&c_stream, data, len, compr, comprLen);
+    err = deflateEnd(&c_stream);
+
+    CHECK_ERR(err, "deflateEnd");
+    memcpy(compr + comprLen, "trailer", 7);
+
+    d_stream.zalloc = zalloc;
+    d_stream.zfree = zfree;
+    d_stream.opaque = (voidpf)0;
+    err = inflateBackInit(&d_stream, 15, window);
+    CHECK_ERR(err, "inflateBackInit");
+    io.next = compr;
+    io.left = comprLen + 7;
+    io.calls = 0;
+    io.have = 0;
+    d_stream.next_in = Z_NULL;
+    err = inflateBackRing(&d_stream, ring_in, &io, ring_out, &io, io.ring,
+                          io.size);
+    if (err != Z_STREAM_END || io.have != len || memcmp(io.out, data, len)) {
+        fprintf(stderr, "inflateBackRing error %d\n", err);
+        exit(1);
+    }
+    for (k = 0; k < 5 && io.vec[k].len == 0; k++)
+        ;
+    if (k == 5 || io.vec[k].base != d_stream.next_in ||
+        memcmp(d_stream.next_in, "trailer", d_stream.avail_in)) {
+        fprintf(stderr, "inflateBackRing bad unused input\n");
+        exit(1);
+    }
+    if (inflateBackRing(&d_stream, ring_in, &io, ring_out, &io, io.ring,
+                        32767) != Z_STREAM_ERROR) {
+        fprintf(stderr, "inflateBackRing accepted a small ring\n");
+        exit(1);
+    }
+    err = inflateBackEnd(&d_stream);
+    CHECK_ERR(err, "inflateBackEnd");
+    printf("inflateBackRing(): OK\n");
+
+    free(data);
+    free(compr);
+    free(window);
+    free(io.ring);
+    free(io.out);
+}
+
+/* ===========================================================================
+ * Test deflateOffload() and inflateOffload() with a stand-in device that is a
+ * raw deflate or inflate stream, makes no progress on every other call as if
+ * waiting for a request to complete, and can decline streams
+ */
+struct offload_dev {
+    z_stream raw;           /* the "device" */
+    int busy;               /* true to decline streams */
+    int open;               /* true if raw is in use */
+    unsigned calls;         /* calls for the current stream */
+    unsigned ends;          /* calls of the end function */
+};
+
+static int dev_run(struct offload_dev *dev, z_streamp strm, int flush,
+                   int deflating) {
+    int ret;
+
+    dev->raw.next_in = strm->next_in;
+    dev->raw.avail_in = strm->avail_in;
+    dev->raw.next_out = strm->next_out;
+    dev->raw.avail_out = strm->avail_out;
+    ret = deflating ? deflate(&dev->raw, flush) : inflate(&dev->raw, flush);
+    strm->next_in = dev->raw.next_in;
+    strm->avail_in = dev->raw.avail_in;
+    strm->next_out = dev->raw.next_out;
+    strm->avail_out = dev->raw.avail_out;
+    return ret == Z_BUF_ERROR ? Z_OK : ret;
+}
+
+static int dev_deflate(voidpf opaque, z_streamp strm, int flush, int level,
+                       int strategy, int windowBits) {
+    struct offload_dev *dev = (struct offload_dev *)opaque;
+
+    if (dev->busy)
+        return Z_BUF_ERROR;
+    if (!dev->open) {
+        memset(&dev->raw, 0, sizeof(z_stream));
+        if (deflateInit2(&dev->raw, level, Z_DEFLATED, -windowBits, 8,
+                         strategy) != Z_OK)
+            return Z_MEM_ERROR;
+        dev->open = 1;
+    }
+    if (dev->calls++ & 1)
+        return Z_OK;
+    return dev_run(dev, strm, flush, 1);
+}
+
+static int dev_inflate(voidpf opaque, z_streamp strm, int flush,
+                       int windowBits) {
+    struct offload_dev *dev = (struct offload_dev *)opaque;
+
+    if (dev->busy)
+        return Z_BUF_ERROR;
+    if (!dev->open) {
+        memset(&dev->raw, 0, sizeof(z_stream));
+        if (inflateInit2(&dev->raw, -windowBits) != Z_OK)
+            return Z_MEM_ERROR;
+        dev->open = 2;
+    }
+    if (dev->calls++ & 1)
+        return Z_OK;
+    return dev_run(dev, strm, flush, 0);
+}
+
+static void dev_end(voidpf opaque, z_streamp strm) {
+    struct offload_dev *dev = (struct offload_dev *)opaque;
+
+    (void)strm;
+    if (dev->open == 1)
+        deflateEnd(&dev->raw);
+    else if (dev->open == 2)
+        inflateEnd(&dev->raw);
+    dev->open = 0;
+    dev->calls = 0;
+    dev->ends++;
+}
+
+static void test_offload(void) {
+    int err, round;
+    uLong i, len = 100000L, comprLen, plainLen, rnd = 1;
+    Byte *data, *compr, *plain, *out;
+    struct offload_dev dev;
+    z_offload ops;
+    z_stream c_stream, d_stream;
+
+    comprLen = plainLen = compressBound(len);
+    data = test_alloc(len);
+    compr = test_alloc(comprLen);
+    plain = test_alloc(plainLen);
+    out = test_alloc(len);
+    for (i = 0; i < len; i++) {
+        rand_next(&rnd);
+        data[i] = i % 1000 < 700 ? (Byte)hello[i % 13] :
+                                   (Byte)((rnd >> 16) & 0x3f);
+    }
+    err = compress2(plain, &plainLen, data, len, 6);
+    CHECK_ERR(err, "compress2");
+
+    memset(&dev, 0, sizeof(dev));
+    ops.deflate = dev_deflate;
+    ops.inflate = dev_inflate;
+    ops.end = dev_end;
+    ops.opaque = &dev;
+
+    /* the device takes the first stream, and declines the second, which
+       deflate compresses itself -- both give the same zlib stream */
+    deflate_init(&c_stream, 6, MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    err = deflateOffload(&c_stream, &ops);
+    CHECK_ERR(err, "deflateOffload");
+    for (round = 0; round < 2; round++) {
+        dev.busy = round;
+        c_stream.next_in = data;
+        c_stream.avail_in = (uInt)len;
+        c_stream.next_out = compr;
+        do {
+            c_stream.avail_out = 1000;
+            err = deflate(&c_stream, Z_FINISH);
+        } while (err == Z_OK);
+        CHECK_ERR(err == Z_STREAM_END ? Z_OK : err, "deflate offload");
+        if (c_stream.total_in != len || c_stream.total_out != plainLen ||
+            memcmp(compr, plain, plainLen) || dev.open != !round) {
+            fprintf(stderr, "deflate offload mismatch\n");
+            exit(1);
+        }
+        if (round == 0 && deflateCopy(&d_stream, &c_stream) != Z_STREAM_ERROR) {
+            fprintf(stderr, "deflateCopy copied an offloaded stream\n");
+            exit(1);
+        }
+        err = deflateReset(&c_stream);
+        CHECK_ERR(err, "deflateReset");
+    }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+    if (dev.ends != 1) {
+        fprintf(stderr, "deflate offload end called %u times\n", dev.ends);
+        exit(1);
+    }
+
+    /* the same for inflate, whose check of the trailer catches any error in
+       the check value that it computes from the device's output */
+    inflate_init(&d_stream, MAX_WBITS);
+    err = inflateOffload(&d_stream, &ops);
+    CHECK_ERR(err, "inflateOffload");
+    for (round = 0; round < 2; round++) {
+        dev.busy = round;
+        d_stream.next_in = plain;
+        d_stream.avail_in = (uInt)plainLen;
+        d_stream.next_out = out;
+        do {
+            d_stream.avail_out = (uInt)(len - d_stream.total_out < 3000 ?
+                                        len - d_stream.total_out : 3000);
+            err = inflate(&d_stream, Z_NO_FLUSH);
+        } while (err == Z_OK || (err == Z_BUF_ERROR && d_stream.avail_in));
+        CHECK_ERR(err == Z_STREAM_END ? Z_OK : err, "inflate offload");
+        if (d_stream.total_out != len || d_stream.avail_in != 0 ||
+            memcmp(out, data, len) || dev.open != (round ? 0 : 2)) {
+            fprintf(stderr, "inflate offload mismatch\n");
+            exit(1);
+        }
+        err = inflateReset(&d_stream);
+        CHECK_ERR(err, "inflateReset");
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+    if (dev.ends != 2) {
+        fprintf(stderr, "inflate offload end called %u times\n", dev.ends);
+        exit(1);
+    }
+    printf("deflateOffload(), inflateOffload(): OK\n");
+
+    free(data);
+    free(compr);
+    free(plain);
+    free(out);
+}
+
+/* ===========================================================================
+ * Test that Z_HUFFMAN_ONLY, which tallies the literals in bulk, makes the same
+ * stream whether the input is provided all at once or a byte at a time
+ */
+static void test_deflate_huff(void) {
+    int err, step;
+    uInt i;
+    uLong len = 50000L, comprLen, total[2], rnd = 1;
+    Byte *data, *compr[2];
+    z_stream c_stream; /* compression stream */
+
+    comprLen = compressBound(len);
+    data = test_alloc(len);
+    compr[0] = test_alloc(comprLen);
+    compr[1] = test_alloc(comprLen);
+
+    /* runs of the same byte, text, and binary */
+    for (i = 0; i < len; i++) {
+        rand_next(&rnd);
+        data[i] = i < 10000 ? 0 : i < 30000 ? (Byte)hello[i % 13] :
+                  (Byte)((rnd >> 16) & (i < 40000 ? 0xff : 0x0f));
+    }
+
+    for (step = 0; step < 2; step++) {
+        deflate_init(&c_stream, 6, 15, 8, Z_HUFFMAN_ONLY);
+        c_stream.next_in = data;
+        c_stream.next_out = compr[step];
+        c_stream.avail_out = (uInt)comprLen;
+        if (step == 0) {
+            c_stream.avail_in = (uInt)len;
+            err = deflate(&c_stream, Z_FINISH);
+        } else {
+            for (i = 0; i < len; i++) {
+                c_stream.avail_in = 1;
+                err = deflate(&c_stream, Z_NO_FLUSH);
+                CHECK_ERR(err, "deflate");
+            }
+            err = deflate(&c_stream, Z_FINISH);
+        }
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "deflate huff should report Z_STREAM_END\n");
+            exit(1);
+        }
+        total[step] = c_stream.total_out;
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+    }
+    if (total[0] != total[1] || memcmp(compr[0], compr[1], (size_t)total[0])) {
+        fprintf(stderr, "deflate huff depends on the input pieces\n");
+        exit(1);
+    }
+
+    check_inflate(compr[0], total[0], MAX_WBITS, data, len, "deflate huff");
+    printf("deflate huff: OK\n");
+
+    free(data);
+    free(compr[0]);
+    free(compr[1]);
+}
+
+
+/* ===========================================================================
+ * Test that Z_RLE, which measures runs many bytes at a time, finds runs of all
+ * lengths, and makes the same stream whether the input is provided all at
+ * once or in small pieces
+ */
+static void test_deflate_rle(void) {
+    int err, step;
+    uInt i, run;
+    uLong len = 100000L, comprLen, total[2], rnd = 1;
+    Byte *data, *compr[2];
+    z_stream c_stream; /* compression stream */
+
+    comprLen = compressBound(len);
+    data = test_alloc(len);
+    compr[0] = test_alloc(comprLen);
+    compr[1] = test_alloc(comprLen);
+
+    /* runs from one byte to several times the longest match, then zeros */
+    for (i = 0; i < len - 20000; i += run) {
+        rand_next(&rnd);
+        run = 1 + (rnd >> 16) % ((rnd >> 8) & 1 ? 40 : 1000);
+        if (run > len - 20000 - i)
+            run = (uInt)(len - 20000 - i);
+        memset(data + i, (int)((rnd >> 4) & 3), run);
+    }
+    memset(data + i, 0, (size_t)(len - i));
+
+    for (step = 0; step < 2; step++) {
+        deflate_init(&c_stream, 6, 15, 8, Z_RLE);
+        c_stream.next_in = data;
+        c_stream.next_out = compr[step];
+        c_stream.avail_out = (uInt)comprLen;
+        if (step == 0) {
+            c_stream.avail_in = (uInt)len;
+            err = deflate(&c_stream, Z_FINISH);
+        } else {
+            for (i = 0; i < len; i += run) {
+                rand_next(&rnd);
+                run = 1 + (rnd >> 16) % 300;
+                if (run > len - i)
+                    run = (uInt)(len - i);
+                c_stream.avail_in = run;
+                err = deflate(&c_stream, Z_NO_FLUSH);
+                CHECK_ERR(err, "deflate");
+            }
+            err = deflate(&c_stream, Z_FINISH);
+        }
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "deflate rle should report Z_STREAM_END\n");
+            exit(1);
+        }
+        total[step] = c_stream.total_out;
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+    }
+    if (total[0] != total[1] || memcmp(compr[0], compr[1], (size_t)total[0])) {
+        fprintf(stderr, "deflate rle depends on the input pieces\n");
+        exit(1);
+    }
+
+    check_inflate(compr[0], total[0], MAX_WBITS, data, len, "deflate rle");
+    printf("deflate rle: OK\n");
+
+    free(data);
+    free(compr[0]);
+    free(compr[1]);
+}
+
+/* ===========================================================================
+ * Test inflate() with the larger root tables from inflateTune()
+ */
+static void test_inflate_tune(void) {
+    int err, bits;
+    unsigned i, back;
+    uLong len = 100000L, comprLen, rnd = 1;
+    Byte *data, *compr, *uncompr;
+    z_stream d_stream, d_copy; /* decompression streams */
+
+    comprLen = compressBound(len);
+    data = test_alloc(len);
+    compr = test_alloc(comprLen);
+    uncompr = test_alloc(len);
+    for (i = 0; i < len; i++) {
+        rand_next(&rnd);
+        back = (unsigned)(rnd >> 4) % 30000 + 1;
+        data[i] = (rnd & 3) == 0 && back <= i ? data[i - back] :
+                  (Byte)((rnd >> 16) & (rnd >> 23));
+    }
+    err = compress(compr, &comprLen, data, len);
+    CHECK_ERR(err, "compress");
+
+    inflate_init(&d_stream, MAX_WBITS);
+    d_stream.next_in = compr;
+    d_stream.avail_in = (uInt)comprLen;
+    if (inflateTune(&d_stream, 12, 6) != Z_STREAM_ERROR ||
+        inflateTune(&d_stream, 9, 5) != Z_STREAM_ERROR) {
+        fprintf(stderr, "inflateTune accepted bad bits\n");
+        exit(1);
+    }
+    for (bits = 0; bits < 3; bits++) {
+        err = inflateReset(&d_stream);
+        CHECK_ERR(err, "inflateReset");
+        err = inflateTune(&d_stream, 9 + bits, 6 + bits);
+        CHECK_ERR(err, "inflateTune");
+        d_stream.next_in = compr;
+        d_stream.avail_in = (uInt)comprLen;
+        d_stream.next_out = uncompr;
+        d_stream.avail_out = (uInt)len / 2;
+        err = inflate(&d_stream, Z_NO_FLUSH);
+        CHECK_ERR(err, "inflate");
+
+        err = inflateCopy(&d_copy, &d_stream);
+        CHECK_ERR(err, "inflateCopy");
+        d_copy.avail_out = (uInt)(len - d_copy.total_out);
+        err = inflate(&d_copy, Z_FINISH);
+        if (err != Z_STREAM_END || d_copy.total_out != len ||
+            memcmp(data, uncompr, len)) {
+            fprintf(stderr, "bad inflate tune: %d, bits %d\n", err, bits);
+            exit(1);
+        }
+        err = inflateEnd(&d_copy);
+        CHECK_ERR(err, "inflateEnd");
+
+        memset(uncompr + len / 2, 0, len - len / 2);
+        d_stream.avail_out = (uInt)(len - d_stream.total_out);
+        err = inflate(&d_stream, Z_FINISH);
+        if (err != Z_STREAM_END || d_stream.total_out != len ||
+            memcmp(data, uncompr, len)) {
+            fprintf(stderr, "bad inflate tune: %d, bits %d\n", err, bits);
+            exit(1);
+        }
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+    printf("inflate tune: OK\n");
+
+    free(data);
+    free(compr);
+    free(uncompr);
+}
+
+/* ===========================================================================
+ * Test inflate() without output after inflateVerify()
+ */
+static void test_inflate_verify(void) {
+    int err, wrap, flush;
+    unsigned i, piece;
+    uLong len = 300000L, comprLen, total, rnd = 1, check;
+    Byte *data, *compr;
+    z_stream c_stream, d_stream; /* compression and decompression streams */
+
+    comprLen = len + len / 100 + 64;
+    data = test_alloc(len);
+    compr = test_alloc(comprLen);
+    for (i = 0; i < len; i++) {
+        rand_next(&rnd);
+        data[i] = (rnd & 3) == 0 && i >= 1000 ? data[i - 1000 + (rnd >> 22)] :
+                  (Byte)((rnd >> 16) & (rnd >> 23));
+    }
+
+    for (wrap = 15; wrap <= 31; wrap += 16) {
+        deflate_init(&c_stream, 6, wrap, 8, Z_DEFAULT_STRATEGY);
+        total = deflate_all(&c_stream, data, len, compr, comprLen);
+        err = deflateEnd(&c_stream);
+
+        CHECK_ERR(err, "deflateEnd");
+        check = wrap == 15 ? adler32(adler32(0L, Z_NULL, 0), data, (uInt)len) :
+                             crc32(crc32(0L, Z_NULL, 0), data, (uInt)len);
+
+        inflate_init(&d_stream, 47);
+        err = inflateVerify(&d_stream, 1);
+        CHECK_ERR(err, "inflateVerify");
+
+        /* all at once with Z_FINISH, then in pieces, then corrupted */
+        for (piece = 0; piece <= 2; piece++) {
+            err = inflateReset(&d_stream);
+            CHECK_ERR(err, "inflateReset");
+            if (piece == 2)
+                compr[total - 3] ^= 1;
+            d_stream.next_in = compr;
+            d_stream.next_out = Z_NULL;
+            d_stream.avail_out = 0;
+            flush = piece == 1 ? Z_NO_FLUSH : Z_FINISH;
+            do {
+                d_stream.avail_in = piece == 1 ?
+                    (uInt)(total - d_stream.total_in < 1000 ?
+                           total - d_stream.total_in : 1000) :
+                    (uInt)total;
+                err = inflate(&d_stream, flush);
+            } while (err == Z_OK);
+            if (piece == 2) {
+                compr[total - 3] ^= 1;
+                if (err != Z_DATA_ERROR) {
+                    fprintf(stderr, "bad inflate verify of bad check: %d\n",
+                            err);
+                    exit(1);
+                }
+                continue;
+            }
+            if (err != Z_STREAM_END || d_stream.total_out != len ||
+                d_stream.adler != check || d_stream.next_out != Z_NULL) {
+                fprintf(stderr, "bad inflate verify: %d, wrap %d\n", err,
+                        wrap);
+                exit(1);
+            }
+        }
+
+        /* a truncated stream needs more input */
+        err = inflateReset(&d_stream);
+        CHECK_ERR(err, "inflateReset");
+        d_stream.next_in = compr;
+        d_stream.avail_in = (uInt)(total - 1);
+        err = inflate(&d_stream, Z_FINISH);
+        if (err != Z_BUF_ERROR || d_stream.total_out != len) {
+            fprintf(stderr, "bad inflate verify of truncated stream: %d\n",
+                    err);
+            exit(1);
+        }
+        err = inflateEnd(&d_stream);
+        CHECK_ERR(err, "inflateEnd");
+    }
+    printf("inflate verify: OK\n");
+
+    free(data);
+    free(compr);
+}
+
+/* ===========================================================================
+ * Test deflate() with the multiplicative hash from deflateHash()
+ */
+static void test_deflate_hash(void) {
+    static const int levels[] = {1, 4, 6, 9};
+    static const char dict[] = "binary record ";
+    int err, hash, lev;
+    unsigned i;
+    uLong len = 60000L, comprLen, rnd = 1;
+    Byte *data, *compr, *uncompr;
+    z_stream c_stream; /* compression stream */
+    z_stream d_stream; /* decompression stream */
+
+    comprLen = compressBound(len);
+    data = test_alloc(len);
+    compr = test_alloc(comprLen);
+    uncompr = test_alloc(len);
+    /* little-endian records of small integers that differ in a high byte */
+    for (i = 0; i < len; i += 4) {
+        rand_next(&rnd);
+        data[i] = (Byte)(i >> 2 & 0x3f);
+        data[i + 1] = (Byte)((rnd >> 16) & 7);
+        data[i + 2] = 0;
+        data[i + 3] = (Byte)((rnd >> 19) & 0xe0);
+    }
+
+    for (hash = Z_HASH_SHIFT; hash <= Z_HASH_MULTIPLY; hash++)
+        for (lev = 0; lev < 4; lev++) {
+            deflate_init(&c_stream, levels[lev], MAX_WBITS, 8,
+                         Z_DEFAULT_STRATEGY);
+            err = deflateHash(&c_stream, hash);
+            CHECK_ERR(err, "deflateHash");
+            err = deflateSetDictionary(&c_stream, (const Bytef*)dict,
+                                       (int)sizeof(dict) - 1);
+            CHECK_ERR(err, "deflateSetDictionary");
+            if (deflateHash(&c_stream, hash) != Z_STREAM_ERROR) {
+                fprintf(stderr, "deflateHash allowed after dictionary\n");
+                exit(1);
+            }
+            deflate_all(&c_stream, data, len, compr, comprLen);
+            err = deflateEnd(&c_stream);
+            CHECK_ERR(err, "deflateEnd");
+
+            inflate_init(&d_stream, MAX_WBITS);
+            d_stream.next_in = compr;
+            d_stream.avail_in = (uInt)c_stream.total_out;
+            d_stream.next_out = uncompr;
+            d_stream.avail_out = (uInt)len;
+            err = inflate(&d_stream, Z_NO_FLUSH);
+            if (err == Z_NEED_DICT)
+                err = inflateSetDictionary(&d_stream, (const Bytef*)dict,
+                                           (int)sizeof(dict) - 1);
+            CHECK_ERR(err, "inflateSetDictionary");
+            err = inflate(&d_stream, Z_FINISH);
+            if (err == Z_STREAM_END)
+                err = inflateEnd(&d_stream);
+            if (err != Z_OK || d_stream.total_out != len ||
+                memcmp(data, uncompr, len)) {
+                fprintf(stderr, "bad deflate hash: %d, hash %d level %d\n",
+                        err, hash, levels[lev]);
+                exit(1);
+            }
+        }
+    printf("deflate hash: OK\n");
+
+    free(data);
+    free(compr);
+    free(uncompr);
+}
+
+/* ===========================================================================
+ * Test deflate() with the Z_QUICK strategy, with flushes and parameter changes
+ */
+static void test_deflate_quick(void) {
+    static const int flushes[] = {Z_NO_FLUSH, Z_SYNC_FLUSH, Z_NO_FLUSH,
+                                  Z_PARTIAL_FLUSH, Z_BLOCK, Z_FULL_FLUSH};
+    int err;
+    unsigned chunk;
+    uLong len = 100000L, comprLen, rnd = 1;
+    Byte *data, *compr;
+    z_stream c_stream; /* compression stream */
+
+    comprLen = 2 * compressBound(len);
+    data = test_alloc(len);
+    compr = test_alloc(comprLen);
+    fill_repeat(data, len, &rnd, 1000, 8, 4, 0);
+
+    /* all at once, with the output space from deflateBound() */
+    deflate_init(&c_stream, 1, 15, 8, Z_QUICK);
+    check_inflate(compr, deflate_all(&c_stream, data, len, compr,
+                                     deflateBound(&c_stream, len)),
+                  MAX_WBITS, data, len, "deflate quick");
+
+    /* small pieces, with flushes and changes to and from Z_QUICK */
+    err = deflateReset(&c_stream);
+    CHECK_ERR(err, "deflateReset");
+    c_stream.next_in = data;
+    c_stream.next_out = compr;
+    for (chunk = 0; c_stream.total_in < len; chunk++) {
+        if (chunk == 30) {
+            err = deflateParams(&c_stream, 6, Z_DEFAULT_STRATEGY);
+            CHECK_ERR(err, "deflateParams");
+        }
+        if (chunk == 60) {
+            err = deflateParams(&c_stream, 1, Z_QUICK);
+            CHECK_ERR(err, "deflateParams");
+        }
+        c_stream.avail_in = len - c_stream.total_in < 1000 ?
+                            (uInt)(len - c_stream.total_in) : 1000;
+        do {
+            /* more than six bytes of output space for flushes, per zlib.h */
+            c_stream.avail_out = (flushes[chunk % 6] == Z_NO_FLUSH ? 1 : 7) +
+                                 chunk % 37;
+            err = deflate(&c_stream, flushes[chunk % 6]);
+            CHECK_ERR(err, "deflate");
+        } while (c_stream.avail_out == 0);
+    }
+    do {
+        c_stream.avail_out = 5;
+        err = deflate(&c_stream, Z_FINISH);
+    } while (err == Z_OK);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "deflate quick should report Z_STREAM_END\n");
+        exit(1);
     }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+
+    check_inflate(compr, c_stream.total_out, MAX_WBITS, data, len,
+                  "deflate quick with flushes");
+    printf("deflate quick: OK\n");
+
+    free(data);
+    free(compr);
 }
 
 /* ===========================================================================
- * Test read/write of .gz files
+ * Test deflate() at level 4 in small pieces, changing the level and strategy
  */
-static void test_gzio(const char *fname, Byte *uncompr, uLong uncomprLen) {
-#ifdef NO_GZCOMPRESS
-    fprintf(stderr, "NO_GZCOMPRESS -- gz* functions cannot compress\n");
-#else
+static void test_deflate_medium(void) {
+    static const int levels[] = {4, 3, 4, 6, 4, 4};
+    static const int strategies[] = {Z_DEFAULT_STRATEGY, Z_DEFAULT_STRATEGY,
+                                     Z_FILTERED, Z_DEFAULT_STRATEGY,
+                                     Z_DEFAULT_STRATEGY, Z_DEFAULT_STRATEGY};
     int err;
-    int len = (int)strlen(hello)+1;
-    gzFile file;
-    z_off_t pos;
+    unsigned i, chunk;
+    uLong len = 200000L, comprLen, rnd = 1;
+    Byte *data, *compr;
+    z_stream c_stream; /* compression stream */
 
-    file = gzopen(fname, "wb");
-    if (file == NULL) {
-        fprintf(stderr, "gzopen error\n");
-        exit(1);
+    comprLen = 2 * compressBound(len);
+    data = test_alloc(len);
+    compr = test_alloc(comprLen);
+    for (i = 0; i < len; i++) {
+        rand_next(&rnd);
+        data[i] = i > 5000 && (rnd >> 16) % 16 ?
+                  data[i - 1 - (rnd >> 8) % 4 * 1231] : (Byte)(rnd >> 26);
     }
-    gzputc(file, 'h');
-    if (gzputs(file, "ello") != 4) {
-        fprintf(stderr, "gzputs err: %s\n", gzerror(file, &err));
-        exit(1);
+
+    deflate_init(&c_stream, 4, MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    c_stream.next_in = data;
+    c_stream.next_out = compr;
+    for (chunk = 0; c_stream.total_in < len; chunk++) {
+        if (chunk % 40 == 39) {
+            err = deflateParams(&c_stream, levels[chunk / 40 % 6],
+                                strategies[chunk / 40 % 6]);
+            CHECK_ERR(err, "deflateParams");
+        }
+        c_stream.avail_in = len - c_stream.total_in < 997 ?
+                            (uInt)(len - c_stream.total_in) : 997;
+        do {
+            c_stream.avail_out = (chunk % 25 ? 1 : 7) + chunk % 53;
+            err = deflate(&c_stream, chunk % 25 ? Z_NO_FLUSH : Z_SYNC_FLUSH);
+            CHECK_ERR(err, "deflate");
+        } while (c_stream.avail_out == 0);
     }
-    if (gzprintf(file, ", %s!", "hello") != 8) {
-        fprintf(stderr, "gzprintf err: %s\n", gzerror(file, &err));
+    c_stream.avail_out = (uInt)(comprLen - c_stream.total_out);
+    err = deflate(&c_stream, Z_FINISH);
+    if (err != Z_STREAM_END) {
+        fprintf(stderr, "deflate medium should report Z_STREAM_END\n");
         exit(1);
     }
-    gzseek(file, 1L, SEEK_CUR); /* add one zero byte */
-    gzclose(file);
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
 
-    file = gzopen(fname, "rb");
-    if (file == NULL) {
-        fprintf(stderr, "gzopen error\n");
-        exit(1);
+    check_inflate(compr, c_stream.total_out, MAX_WBITS, data, len,
+                  "deflate medium");
+    printf("deflate medium: OK\n");
+
+    free(data);
+    free(compr);
+}
+
+
+/* ===========================================================================
+ * Test that level 10 compresses better than level 9, and gives the same
+ * compressed data however the input and output are provided
+ */
+static void test_deflate_optimal(void) {
+    int err, k;
+    unsigned i;
+    uLong len = 150000L, comprLen, size[5], rnd = 1;
+    Byte *data, *compr[5];
+    z_stream c_stream; /* compression stream */
+
+    comprLen = compressBound(len);
+    data = test_alloc(len);
+    for (k = 0; k < 5; k++)
+        compr[k] = test_alloc(comprLen);
+    for (i = 0; i < len; i++) {
+        rand_next(&rnd);
+        data[i] = i > 3000 && (rnd >> 16) % 8 ?
+                  data[i - 1 - (rnd >> 8) % ((rnd >> 4) % 2 ? 7 : 3000)] :
+                  (Byte)('a' + (rnd >> 23) % 16);
     }
-    strcpy((char*)uncompr, "garbage");
 
-    if (gzread(file, uncompr, (unsigned)uncomprLen) != len) {
-        fprintf(stderr, "gzread err: %s\n", gzerror(file, &err));
-        exit(1);
+    /* 0: level 9, 1: level 10, 2: level 10 in pieces, 3: level 10 with
+       deflateOneShot(), 4: level 10 with one pass, after deflateParams() */
+    for (k = 0; k < 5; k++) {
+        deflate_init(&c_stream,
+                     k == 0 ? 9 : k == 4 ? 1 : Z_OPTIMAL_COMPRESSION,
+                     MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+        if (k == 3) {
+            err = deflateOneShot(&c_stream);
+            CHECK_ERR(err, "deflateOneShot");
+        }
+        if (k == 4) {
+            err = deflateParams(&c_stream, Z_OPTIMAL_COMPRESSION,
+                                Z_DEFAULT_STRATEGY);
+            CHECK_ERR(err, "deflateParams");
+            err = deflateTune(&c_stream, 0, 1, 258, 4096);
+            CHECK_ERR(err, "deflateTune");
+        }
+        c_stream.next_in = data;
+        c_stream.next_out = compr[k];
+        if (k == 2) {
+            while (c_stream.total_in < len) {
+                c_stream.avail_in = len - c_stream.total_in < 3001 ?
+                                    (uInt)(len - c_stream.total_in) : 3001;
+                do {
+                    c_stream.avail_out = 77;
+                    err = deflate(&c_stream, Z_NO_FLUSH);
+                    CHECK_ERR(err, "deflate");
+                } while (c_stream.avail_out == 0);
+            }
+        }
+        c_stream.avail_in = (uInt)(len - c_stream.total_in);
+        do {
+            c_stream.avail_out = 1000;
+            err = deflate(&c_stream, Z_FINISH);
+        } while (err == Z_OK);
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "deflate optimal should report Z_STREAM_END\n");
+            exit(1);
+        }
+        size[k] = c_stream.total_out;
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+
+        check_inflate(compr[k], size[k], MAX_WBITS, data, len,
+                      "deflate optimal round trip");
     }
-    if (strcmp((char*)uncompr, hello)) {
-        fprintf(stderr, "bad gzread: %s\n", (char*)uncompr);
+    if (size[1] > size[0] || size[4] > size[0]) {
+        fprintf(stderr, "deflate optimal larger than level 9: %lu, %lu > %lu\n",
+                size[1], size[4], size[0]);
         exit(1);
-    } else {
-        printf("gzread(): %s\n", (char*)uncompr);
     }
+    for (k = 2; k < 4; k++)
+        if (size[k] != size[1] || memcmp(compr[k], compr[1], size[1])) {
+            fprintf(stderr, "bad deflate optimal %s\n",
+                    k == 2 ? "in pieces" : "one shot");
+            exit(1);
+        }
+    printf("deflate optimal: OK\n");
 
-    pos = gzseek(file, -8L, SEEK_CUR);
-    if (pos != 6 || gztell(file) != pos) {
-        fprintf(stderr, "gzseek error, pos=%ld, gztell=%ld\n",
-                (long)pos, (long)gztell(file));
-        exit(1);
-    }
+    free(data);
+    for (k = 0; k < 5; k++)
+        free(compr[k]);
+}
 
-    if (gzgetc(file) != ' ') {
-        fprintf(stderr, "gzgetc error\n");
-        exit(1);
+/* ===========================================================================
+ * Test deflateParams() leaving level 10 or Z_QUICK during a Z_FINISH with
+ * little output space, which must wait until the pending data is emitted
+ */
+static void test_deflate_switch(void) {
+    int err, k, changed;
+    uLong len = 70000L, comprLen, rnd = 1;
+    Byte *data, *compr;
+    z_stream c_stream; /* compression stream */
+
+    comprLen = 2 * compressBound(len);
+    data = test_alloc(len);
+    compr = test_alloc(comprLen);
+    fill_repeat(data, len, &rnd, len, 1, 1, 0);
+
+    /* 0: level 10 to 6 with Z_QUICK to 1, 1: Z_QUICK to level 0 */
+    for (k = 0; k < 2; k++) {
+        deflate_init(&c_stream, k ? 1 : Z_OPTIMAL_COMPRESSION, 11, 1,
+                     k ? Z_QUICK : Z_FIXED);
+        c_stream.next_in = data;
+        c_stream.avail_in = (uInt)len;
+        c_stream.next_out = compr;
+        changed = 0;
+        do {
+            if (c_stream.avail_in == 0 && !changed) {
+                /* Z_BUF_ERROR leaves the parameters alone */
+                err = deflateParams(&c_stream, k ? 0 : 6,
+                                    k ? Z_DEFAULT_STRATEGY : Z_QUICK);
+                if (err != Z_BUF_ERROR)
+                    CHECK_ERR(err, "deflateParams");
+                err = deflateParams(&c_stream, k ? 0 : 1, Z_FILTERED);
+                if (err != Z_BUF_ERROR)
+                    CHECK_ERR(err, "deflateParams");
+                changed = 1;
+            }
+            c_stream.avail_out = 1 + (uInt)(c_stream.total_out % 97);
+            err = deflate(&c_stream, Z_FINISH);
+        } while (err == Z_OK);
+        if (err != Z_STREAM_END || !changed) {
+            fprintf(stderr, "deflate switch should report Z_STREAM_END\n");
+            exit(1);
+        }
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+
+        check_inflate(compr, c_stream.total_out, MAX_WBITS, data, len,
+                      "deflate switch");
     }
+    printf("deflate switch: OK\n");
 
-    if (gzungetc(' ', file) != ' ') {
-        fprintf(stderr, "gzungetc error\n");
-        exit(1);
+    free(data);
+    free(compr);
+}
+
+/* ===========================================================================
+ * Test that deflateOneShot() gives the same compressed data as copying
+ */
+static void test_deflate_oneshot(void) {
+    static const int levels[] = {1, 4, 6, 9};
+    int err, k, one;
+    unsigned i;
+    uLong len = 150000L, comprLen, size[2], rnd = 1;
+    Byte *data, *compr[2];
+    z_stream c_stream; /* compression stream */
+
+    comprLen = compressBound(len);
+    data = test_alloc(len);
+    compr[0] = test_alloc(comprLen);
+    compr[1] = test_alloc(comprLen);
+    for (i = 0; i < len; i++) {
+        rand_next(&rnd);
+        data[i] = i > 40000 && (rnd >> 16) % 8 ?
+                  data[i - 1 - (rnd >> 8) % ((rnd >> 4) % 2 ? 9 : 40000)] :
+                  (Byte)(rnd >> 23);
     }
 
-    gzgets(file, (char*)uncompr, (int)uncomprLen);
-    if (strlen((char*)uncompr) != 7) { /* " hello!" */
-        fprintf(stderr, "gzgets err after gzseek: %s\n", gzerror(file, &err));
-        exit(1);
+    for (k = 0; k < 4; k++) {
+        for (one = 0; one < 2; one++) {
+            deflate_init(&c_stream, levels[k], MAX_WBITS, 8,
+                         Z_DEFAULT_STRATEGY);
+            if (one) {
+                err = deflateOneShot(&c_stream);
+                CHECK_ERR(err, "deflateOneShot");
+            }
+            c_stream.next_in = data;
+            c_stream.avail_in = (uInt)len;
+            c_stream.next_out = compr[one];
+            do {
+                c_stream.avail_out = 1000;
+                err = deflate(&c_stream, Z_FINISH);
+            } while (err == Z_OK);
+            if (err != Z_STREAM_END) {
+                fprintf(stderr, "deflate one shot should report Z_STREAM_END\n");
+                exit(1);
+            }
+            size[one] = c_stream.total_out;
+            err = deflateEnd(&c_stream);
+            CHECK_ERR(err, "deflateEnd");
+        }
+        if (size[0] != size[1] || memcmp(compr[0], compr[1], size[0])) {
+            fprintf(stderr, "bad deflate one shot at level %d\n", levels[k]);
+            exit(1);
+        }
     }
-    if (strcmp((char*)uncompr, hello + 6)) {
-        fprintf(stderr, "bad gzgets after gzseek\n");
-        exit(1);
-    } else {
-        printf("gzgets() after gzseek: %s\n", (char*)uncompr);
+    printf("deflate one shot: OK\n");
+
+    free(data);
+    free(compr[0]);
+    free(compr[1]);
+}
+
+/* ===========================================================================
+ * Test that a reused stream compresses messages as a new stream does
+ */
+static void test_deflate_reset(void) {
+    static const int levels[] = {1, 4, 6, 9, -1};
+    static const uInt sizes[] = {200, 7, 3000, 0, 90000, 200, 1, 150, 5000};
+    int err, k, level;
+    unsigned i, m;
+    uLong len = 100000L, comprLen, rnd = 1, size;
+    Byte *data, *compr[2];
+    z_stream reuse, fresh;
+
+    comprLen = compressBound(len);
+    data = test_alloc(len);
+    compr[0] = test_alloc(comprLen);
+    compr[1] = test_alloc(comprLen);
+    fill_repeat(data, len, &rnd, 20, 4, 20, 8);
+
+    for (k = 0; k < 5; k++) {
+        deflate_init(&reuse, levels[k] < 0 ? 0 : levels[k], MAX_WBITS, 8,
+                     Z_DEFAULT_STRATEGY);
+        for (m = 0; m < sizeof(sizes) / sizeof(sizes[0]); m++) {
+            /* alternate between stored and level 6 in the last round, so
+               that level 6 follows the stored window moves */
+            level = levels[k] < 0 ? (m & 1 ? 6 : 0) : levels[k];
+            if (levels[k] < 0) {
+                err = deflateParams(&reuse, level, Z_DEFAULT_STRATEGY);
+                CHECK_ERR(err, "deflateParams");
+            }
+            deflate_init(&fresh, level, MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+            for (i = 0; i < 2; i++)
+                deflate_all(i ? &fresh : &reuse, data + (m * 997) % 1000,
+                            sizes[m], compr[i], comprLen);
+
+
+            size = reuse.total_out;
+            if (size != fresh.total_out || memcmp(compr[0], compr[1], size)) {
+                fprintf(stderr, "bad deflate after reset at level %d\n",
+                        level);
+                exit(1);
+            }
+            err = deflateEnd(&fresh);
+            CHECK_ERR(err, "deflateEnd");
+            err = deflateReset(&reuse);
+            CHECK_ERR(err, "deflateReset");
+        }
+        err = deflateEnd(&reuse);
+        CHECK_ERR(err, "deflateEnd");
     }
+    printf("deflate reset: OK\n");
 
-    gzclose(file);
-#endif
+    free(data);
+    free(compr[0]);
+    free(compr[1]);
 }
 
-#endif /* Z_SOLO */
+/* ===========================================================================
+ * Test deflate() with Z_LATENCY_FLUSH, which must make all of each message
+ * available to inflate() on its own, for small and large messages
+ */
+static void test_latency_flush(void) {
+    static const int levels[] = {0, 1, 6, 9};
+    static const uInt sizes[] = {20, 0, 1, 90, 400, 3, 5000, 60, 40000, 7};
+    int err, k, strategy;
+    unsigned i, m;
+    uLong len = 100000L, comprLen, rnd = 1, pos, total[2];
+    Byte *data, *compr, *back;
+    z_stream c_stream, d_stream;
+
+    comprLen = compressBound(len) + 5 * 20;
+    data = test_alloc(len);
+    compr = test_alloc(comprLen);
+    back = test_alloc(len);
+    fill_repeat(data, len, &rnd, 20, 4, 20, 8);
+
+    for (k = 0; k < 5; k++) {
+        strategy = k == 4 ? Z_FIXED : Z_DEFAULT_STRATEGY;
+        total[0] = total[1] = 0;
+        for (i = 0; i < 2; i++) {
+            deflate_init(&c_stream, levels[k & 3], -15, 8, strategy);
+            inflate_init(&d_stream, -15);
+            pos = 0;
+            for (m = 0; m < 3 * sizeof(sizes) / sizeof(sizes[0]); m++) {
+                uInt size = sizes[m % (sizeof(sizes) / sizeof(sizes[0]))];
+
+                c_stream.next_in = data + pos;
+                c_stream.avail_in = size;
+                c_stream.next_out = compr;
+                c_stream.avail_out = (uInt)comprLen;
+                err = deflate(&c_stream,
+                              i ? Z_LATENCY_FLUSH : Z_SYNC_FLUSH);
+                if (err != Z_OK && !(err == Z_BUF_ERROR && size == 0)) {
+                    CHECK_ERR(err, "deflate");
+                }
+                if (c_stream.avail_in != 0) {
+                    fprintf(stderr, "deflate left input after flush\n");
+                    exit(1);
+                }
+                total[i] += comprLen - c_stream.avail_out;
+
+                /* the flushed output alone must decompress the message */
+                d_stream.next_in = compr;
+                d_stream.avail_in = (uInt)comprLen - c_stream.avail_out;
+                d_stream.next_out = back;
+                d_stream.avail_out = (uInt)len;
+                err = inflate(&d_stream, Z_SYNC_FLUSH);
+                if (err != Z_OK && !(err == Z_BUF_ERROR && size == 0)) {
+                    CHECK_ERR(err, "inflate");
+                }
+                if (d_stream.avail_in != 0 ||
+                    len - d_stream.avail_out != size ||
+                    memcmp(back, data + pos, size)) {
+                    fprintf(stderr, "bad latency flush at level %d\n",
+                            levels[k & 3]);
+                    exit(1);
+                }
+                pos = (pos + size) % (len - 40000);
+            }
+            err = inflateEnd(&d_stream);
+            CHECK_ERR(err, "inflateEnd");
+            (void)deflateEnd(&c_stream);    /* Z_DATA_ERROR, not finished */
+        }
+        if (levels[k & 3] == 0 && total[1] > total[0]) {
+            fprintf(stderr, "latency flush larger than sync flush\n");
+            exit(1);
+        }
+    }
+    printf("deflate Z_LATENCY_FLUSH: OK\n");
+
+    free(data);
+    free(compr);
+    free(back);
+}
 
 /* ===========================================================================
- * Test deflate() with small buffers
+ * Test deflateThroughput(). A target no rate can meet must step down to the
+ * fastest search, and a target any rate meets up to the slowest, which makes
+ * the output deterministic. Turning it off must restore the level.
  */
-static void test_deflate(Byte *compr, uLong comprLen) {
-    z_stream c_stream; /* compression stream */
-    int err;
-    uLong len = (uLong)strlen(hello)+1;
+static void test_deflate_throughput(void) {
+    static const int levels[] = {5, 9, 1, 3, 9};
+    static const uLong rates[] = {1, (uLong)-1, 1, (uLong)-1, 0};
+    int err, k;
+    uInt chunk = 16384;
+    uLong len = 1000000L, comprLen, rnd = 1, pos, run, size[2];
+    Byte *data, *compr;
+    z_stream c_stream;
 
-    c_stream.zalloc = zalloc;
-    c_stream.zfree = zfree;
-    c_stream.opaque = (voidpf)0;
+    comprLen = compressBound(len);
+    data = test_alloc(len);
+    compr = test_alloc(comprLen);
+    for (pos = 0; pos < len; pos += run) {
+        rand_next(&rnd);
+        run = 4 + (rnd >> 8) % 40;
+        if (run > len - pos)
+            run = len - pos;
+        if (pos > 30000 && (rnd >> 16) % 8) {
+            uLong from = pos - 1 - (rnd >> 4) % 30000, n;
 
-    err = deflateInit(&c_stream, Z_DEFAULT_COMPRESSION);
-    CHECK_ERR(err, "deflateInit");
+            for (n = 0; n < run; n++)
+                data[pos + n] = data[from + n];
+            data[pos + run - 1] ^= (Byte)((rnd >> 24) & 1);
+        }
+        else {
+            uLong n;
 
-    c_stream.next_in  = (z_const unsigned char *)hello;
-    c_stream.next_out = compr;
+            for (n = 0; n < run; n++) {
+                rand_next(&rnd);
+                data[pos + n] = (Byte)('a' + (rnd >> 23) % 26);
+            }
+        }
+    }
 
-    while (c_stream.total_in != len && c_stream.total_out < comprLen) {
-        c_stream.avail_in = c_stream.avail_out = 1; /* force small buffers */
-        err = deflate(&c_stream, Z_NO_FLUSH);
-        CHECK_ERR(err, "deflate");
+    deflate_init(&c_stream, Z_DEFAULT_COMPRESSION, MAX_WBITS, 8,
+                 Z_DEFAULT_STRATEGY);
+    err = deflateThroughput(&c_stream, 1);
+    if (err == Z_VERSION_ERROR) {
+        deflateEnd(&c_stream);
+        printf("deflateThroughput: not compiled\n");
+        free(data);
+        free(compr);
+        return;
     }
-    /* Finish the stream, still forcing small buffers: */
-    for (;;) {
-        c_stream.avail_out = 1;
-        err = deflate(&c_stream, Z_FINISH);
-        if (err == Z_STREAM_END) break;
-        CHECK_ERR(err, "deflate");
+    CHECK_ERR(err, "deflateThroughput");
+    if (deflateThroughput(Z_NULL, 1) != Z_STREAM_ERROR) {
+        fprintf(stderr, "deflateThroughput should reject a null stream\n");
+        exit(1);
     }
 
+    for (k = 0; k < 5; k++) {
+        int i;
+
+        for (i = 0; i < 2; i++) {
+            err = deflateReset(&c_stream);
+            CHECK_ERR(err, "deflateReset");
+            err = deflateParams(&c_stream, levels[k], Z_DEFAULT_STRATEGY);
+            CHECK_ERR(err, "deflateParams");
+            if (k == 4 && i) {
+                /* adapt a whole stream, then turn it off and start over */
+                err = deflateThroughput(&c_stream, (uLong)-1);
+                CHECK_ERR(err, "deflateThroughput");
+                deflate_all(&c_stream, data, len, compr, comprLen);
+                err = deflateReset(&c_stream);
+                CHECK_ERR(err, "deflateReset");
+            }
+            err = deflateThroughput(&c_stream, i ? rates[k] : 0);
+            CHECK_ERR(err, "deflateThroughput");
+            c_stream.next_in = data;
+            c_stream.next_out = compr;
+            c_stream.avail_out = (uInt)comprLen;
+            for (pos = 0; pos < len; pos += chunk) {
+                c_stream.avail_in = len - pos < chunk ? (uInt)(len - pos) :
+                                                        chunk;
+                err = deflate(&c_stream, pos + c_stream.avail_in == len ?
+                                         Z_FINISH : Z_NO_FLUSH);
+                if (err != Z_OK && err != Z_STREAM_END) {
+                    CHECK_ERR(err, "deflate");
+                }
+            }
+            if (err != Z_STREAM_END) {
+                fprintf(stderr, "deflate should report Z_STREAM_END\n");
+                exit(1);
+            }
+            size[i] = c_stream.total_out;
+            check_inflate(compr, size[i], MAX_WBITS, data, len,
+                          "deflateThroughput");
+        }
+        if (rates[k] == 0 ? size[1] != size[0] :
+            rates[k] == 1 ? size[1] >= size[0] : size[1] <= size[0]) {
+            fprintf(stderr, "deflateThroughput at level %d: %lu vs %lu\n",
+                    levels[k], size[1], size[0]);
+            exit(1);
+        }
+    }
     err = deflateEnd(&c_stream);
     CHECK_ERR(err, "deflateEnd");
+    printf("deflateThroughput: OK\n");
+
+    free(data);
+    free(compr);
 }
 
 /* ===========================================================================
- * Test inflate() with small buffers
+ * Test deflateFitBlock(). The stream must fit in the target, end where the
+ * input used ends, and come close to filling the target when the input does
+ * not all fit.
  */
-static void test_inflate(Byte *compr, uLong comprLen, Byte *uncompr,
-                  uLong uncomprLen) {
-    int err;
-    z_stream d_stream; /* decompression stream */
+static void test_deflate_fit_block(void) {
+    static const int levels[] = {0, 1, 6, 9};
+    static const uLong targets[] = {12, 100, 1000, 20000};
+    int err, k, t;
+    uLong len = 100000L, comprLen = 30000L, rnd = 1, pos;
+    Byte *data, *compr;
+    z_stream c_stream;
 
-    strcpy((char*)uncompr, "garbage");
+    data = test_alloc(len);
+    compr = test_alloc(comprLen);
+    for (pos = 0; pos < len; pos++) {
+        rand_next(&rnd);
+        data[pos] = (Byte)((rnd >> 16) % 5 ? 'a' + (rnd >> 23) % 8 : ' ');
+    }
 
-    d_stream.zalloc = zalloc;
-    d_stream.zfree = zfree;
-    d_stream.opaque = (voidpf)0;
+    deflate_init(&c_stream, Z_DEFAULT_COMPRESSION, MAX_WBITS, 8,
+                 Z_DEFAULT_STRATEGY);
+    c_stream.next_in = data;
+    c_stream.avail_in = (uInt)len;
+    c_stream.next_out = compr;
+    c_stream.avail_out = (uInt)comprLen;
+    if (deflateFitBlock(&c_stream, 6) != Z_BUF_ERROR) {
+        fprintf(stderr, "deflateFitBlock should not fit in 6 bytes\n");
+        exit(1);
+    }
 
-    d_stream.next_in  = compr;
-    d_stream.avail_in = 0;
-    d_stream.next_out = uncompr;
+    for (k = 0; k < 4; k++)
+        for (t = 0; t < 4; t++) {
+            err = deflateReset(&c_stream);
+            CHECK_ERR(err, "deflateReset");
+            err = deflateParams(&c_stream, levels[k], Z_DEFAULT_STRATEGY);
+            CHECK_ERR(err, "deflateParams");
+            c_stream.next_in = data;
+            c_stream.avail_in = (uInt)len;
+            c_stream.next_out = compr;
+            c_stream.avail_out = (uInt)comprLen;
+            err = deflateFitBlock(&c_stream, targets[t]);
+            if (err != Z_STREAM_END) {
+                fprintf(stderr, "deflateFitBlock error: %d\n", err);
+                exit(1);
+            }
+            if (c_stream.total_out > targets[t] ||
+                c_stream.next_in != data + c_stream.total_in ||
+                c_stream.avail_in != len - c_stream.total_in ||
+                (c_stream.total_in < len &&
+                 c_stream.total_out + 8 + targets[t] / 64 < targets[t])) {
+                fprintf(stderr, "bad deflateFitBlock at level %d: %lu of "
+                        "%lu bytes with %lu in\n", levels[k],
+                        c_stream.total_out, targets[t], c_stream.total_in);
+                exit(1);
+            }
+            check_inflate(compr, c_stream.total_out, MAX_WBITS, data,
+                          c_stream.total_in, "deflateFitBlock data");
+        }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+    printf("deflateFitBlock: OK\n");
 
-    err = inflateInit(&d_stream);
-    CHECK_ERR(err, "inflateInit");
+    free(data);
+    free(compr);
+}
 
-    while (d_stream.total_out < uncomprLen && d_stream.total_in < comprLen) {
-        d_stream.avail_in = d_stream.avail_out = 1; /* force small buffers */
-        err = inflate(&d_stream, Z_NO_FLUSH);
-        if (err == Z_STREAM_END) break;
-        CHECK_ERR(err, "inflate");
-    }
 
-    err = inflateEnd(&d_stream);
-    CHECK_ERR(err, "inflateEnd");
+/* ===========================================================================
+ * Test deflateGetStats() and inflateGetStats(), which must agree on a stream
+ */
+static void test_stats(void) {
+    int err, level;
+    uLong len = 100000L, comprLen, rnd = 1;
+    Byte *data, *compr;
+    z_stream c_stream, d_stream;
+    z_stats cst, dst;
 
-    if (strcmp((char*)uncompr, hello)) {
-        fprintf(stderr, "bad inflate\n");
-        exit(1);
-    } else {
-        printf("inflate(): %s\n", (char *)uncompr);
+    comprLen = compressBound(len);
+    data = test_alloc(len);
+    compr = test_alloc(comprLen);
+    fill_repeat(data, len, &rnd, 20, 4, 20, 8);
+
+    for (level = 1; level <= 9; level += 3) {
+        deflate_init(&c_stream, level, MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+        deflate_all(&c_stream, data, len, compr, comprLen);
+        err = deflateGetStats(&c_stream, &cst);
+
+        if (err == Z_VERSION_ERROR && (zlibCompileFlags() & (1UL << 11)) == 0) {
+            deflateEnd(&c_stream);
+            printf("stats: not compiled\n");
+            break;
+        }
+        CHECK_ERR(err, "deflateGetStats");
+
+        inflate_init(&d_stream, MAX_WBITS);
+        d_stream.next_in = compr;
+        d_stream.avail_in = (uInt)c_stream.total_out;
+        d_stream.next_out = data;
+        d_stream.avail_out = (uInt)len;
+        err = inflate(&d_stream, Z_FINISH);
+        if (err != Z_STREAM_END) {
+            fprintf(stderr, "inflate should report Z_STREAM_END\n");
+            exit(1);
+        }
+        err = inflateGetStats(&d_stream, &dst);
+        CHECK_ERR(err, "inflateGetStats");
+
+        if (cst.literals + cst.match_bytes != len || cst.chains == 0 ||
+            cst.stored != dst.stored || cst.fixed != dst.fixed ||
+            cst.dynamic != dst.dynamic || cst.literals != dst.literals ||
+            cst.matches != dst.matches || cst.match_bytes != dst.match_bytes) {
+            fprintf(stderr, "bad stats at level %d\n", level);
+            exit(1);
+        }
+
+        err = deflateReset(&c_stream);
+        CHECK_ERR(err, "deflateReset");
+        err = deflateGetStats(&c_stream, &cst);
+        CHECK_ERR(err, "deflateGetStats");
+        if (cst.literals || cst.matches || cst.dynamic) {
+            fprintf(stderr, "stats not cleared by deflateReset\n");
+            exit(1);
+        }
+        err = deflateEnd(&c_stream);
+        CHECK_ERR(err, "deflateEnd");
+        err = inflateEnd(&d_stream);
+        CHECK_ERR(err, "inflateEnd");
+        if (level == 7)
+            printf("stats: OK\n");
     }
+
+    free(data);
+    free(compr);
 }
 
 /* ===========================================================================
@@ -490,6 +3980,94 @@ static void test_dict_inflate(Byte *compr, uLong comprLen, Byte *uncompr,
     }
 }
 
+/* ===========================================================================
+ * Test that a compiled dictionary gives the same result as setting it
+ */
+static void test_dict_compile(void) {
+    static const int levels[] = {1, 4, 6, 9};
+    int err, k, use;
+    unsigned i;
+    uLong dictLen = 40000L, len = 3000L, comprLen, size[2], rnd = 1;
+    Byte *dict, *data, *compr[2], *uncompr;
+    z_stream c_stream, d_stream;
+    z_dictp compiled;
+
+    comprLen = compressBound(len);
+    dict = test_alloc(dictLen);
+    data = test_alloc(len);
+    compr[0] = test_alloc(comprLen);
+    compr[1] = test_alloc(comprLen);
+    uncompr = test_alloc(len);
+    fill_repeat(dict, dictLen, &rnd, 10, 4, 10, 16);
+    for (i = 0; i < len; i++)
+        data[i] = dict[dictLen - 20000 + (i * 7) % 9000];
+
+    deflate_init(&c_stream, Z_DEFAULT_COMPRESSION, MAX_WBITS, 8,
+                 Z_DEFAULT_STRATEGY);
+    err = deflateCompileDictionary(&c_stream, dict, (uInt)dictLen, &compiled);
+    CHECK_ERR(err, "deflateCompileDictionary");
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+
+    for (k = 0; k < 4; k++) {
+        for (use = 0; use < 2; use++) {
+            deflate_init(&c_stream, levels[k], MAX_WBITS, 8,
+                         Z_DEFAULT_STRATEGY);
+            err = use ? deflateUseDictionary(&c_stream, compiled) :
+                        deflateSetDictionary(&c_stream, dict, (uInt)dictLen);
+            CHECK_ERR(err, "deflate dictionary");
+            size[use] = deflate_all(&c_stream, data, len, compr[use],
+                                    comprLen);
+            err = deflateEnd(&c_stream);
+            CHECK_ERR(err, "deflateEnd");
+        }
+        if (size[0] != size[1] || memcmp(compr[0], compr[1], size[0])) {
+            fprintf(stderr, "bad compiled dictionary at level %d\n",
+                    levels[k]);
+            exit(1);
+        }
+    }
+
+    inflate_init(&d_stream, MAX_WBITS);
+    d_stream.next_in = compr[1];
+    d_stream.avail_in = (uInt)size[1];
+    d_stream.next_out = uncompr;
+    d_stream.avail_out = (uInt)len;
+    err = inflate(&d_stream, Z_NO_FLUSH);
+    if (err != Z_NEED_DICT) {
+        fprintf(stderr, "inflate should report Z_NEED_DICT\n");
+        exit(1);
+    }
+    err = inflateUseDictionary(&d_stream, compiled);
+    CHECK_ERR(err, "inflateUseDictionary");
+    err = inflate(&d_stream, Z_FINISH);
+    if (err != Z_STREAM_END || d_stream.total_out != len ||
+        memcmp(data, uncompr, len)) {
+        fprintf(stderr, "bad inflate with compiled dictionary\n");
+        exit(1);
+    }
+    err = inflateEnd(&d_stream);
+    CHECK_ERR(err, "inflateEnd");
+
+    /* the hash tables must be the same size */
+    deflate_init(&c_stream, 6, MAX_WBITS, 9, Z_DEFAULT_STRATEGY);
+    if (deflateUseDictionary
+(&c_stream, compiled) != Z_STREAM_ERROR) {
+        fprintf(stderr, "deflateUseDictionary accepted another memLevel\n");
+        exit(1);
+    }
+    err = deflateEnd(&c_stream);
+    CHECK_ERR(err, "deflateEnd");
+    deflateFreeDictionary(compiled);
+    printf("compiled dictionary: OK\n");
+
+    free(dict);
+    free(data);
+    free(compr[0]);
+    free(compr[1]);
+    free(uncompr);
+}
+
 /* ===========================================================================
  * Usage:  example [output.gz  [input.gz]]
  */
@@ -527,9 +4105,26 @@ int main(int argc, char *argv[]) {
     (void)argv;
 #else
     test_compress(compr, comprLen, uncompr, uncomprLen);
+    test_parallel();
+    test_workers();
+    test_join();
+    test_gzip_normalize();
+    test_batch();
+    test_async();
+    test_stream_cache();
+    test_crc32();
+    test_adler32();
+    test_combine();
 
     test_gzio((argc > 1 ? argv[1] : TESTFILE),
               uncompr, uncomprLen);
+    test_gzio_async((argc > 1 ? argv[1] : TESTFILE));
+    test_gzio_map((argc > 1 ? argv[1] : TESTFILE));
+    test_gzindex((argc > 1 ? argv[1] : TESTFILE));
+    test_gzuncompress_parallel((argc > 1 ? argv[1] : TESTFILE));
+    test_gzblock((argc > 1 ? argv[1] : TESTFILE));
+    test_gzvec((argc > 1 ? argv[1] : TESTFILE));
+    test_gzgetline((argc > 1 ? argv[1] : TESTFILE));
 #endif
 
     test_deflate(compr, comprLen);
@@ -537,6 +4132,33 @@ int main(int argc, char *argv[]) {
 
     test_large_deflate(compr, comprLen, uncompr, uncomprLen);
     test_large_inflate(compr, comprLen, uncompr, uncomprLen);
+    test_inflate_copy();
+    test_inflate_oneshot();
+    test_stream_pool();
+    test_deflate_memory();
+    test_deflate_compact();
+    test_deflate_config();
+    test_deflate_estimate();
+    test_deflate_random();
+    test_deflate_huff();
+    test_deflate_rle();
+    test_deflate_fork();
+    test_sync_scan();
+    test_inflate_back_ring();
+    test_offload();
+    test_inflate_tune();
+    test_inflate_verify();
+    test_deflate_hash();
+    test_deflate_quick();
+    test_deflate_medium();
+    test_deflate_optimal();
+    test_deflate_switch();
+    test_deflate_oneshot();
+    test_deflate_reset();
+    test_latency_flush();
+    test_deflate_throughput();
+    test_deflate_fit_block();
+    test_stats();
 
     test_flush(compr, &comprLen);
     test_sync(compr, comprLen, uncompr, uncomprLen);
@@ -544,6 +4166,7 @@ int main(int argc, char *argv[]) {
 
     test_dict_deflate(compr, comprLen);
     test_dict_inflate(compr, comprLen, uncompr, uncomprLen);
+    test_dict_compile();
 
     free(compr);
     free(uncompr);
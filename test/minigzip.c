@@ -34,6 +34,12 @@
 #  include <stdlib.h>
 #endif
 
+/* map regular input files into memory instead of reading them, where mmap()
+   is available -- define NO_MMAP to always read */
+#if !defined(USE_MMAP) && !defined(NO_MMAP) && \
+    (defined(__unix__) || defined(__APPLE__))
+#  define USE_MMAP
+#endif
 #ifdef USE_MMAP
 #  include <sys/types.h>
 #  include <sys/mman.h>
@@ -320,6 +326,13 @@ static const char *gzerror(gzFile gz, int *err) {
 
 static char *prog;
 
+#ifndef Z_SOLO
+static int par = 0;         /* threads from -p, or 0 to not use threads */
+#  define READ_MODE (par ? "rbm" : "rb")
+#else
+#  define READ_MODE "rb"
+#endif
+
 /* ===========================================================================
  * Display error message and exit
  */
@@ -330,32 +343,47 @@ static void error(const char *msg) {
 
 #ifdef USE_MMAP /* MMAP version, Miguel Albrecht <malbrech@eso.org> */
 
-/* Try compressing the input file at once using mmap. Return Z_OK if
- * success, Z_ERRNO otherwise.
+/* Map all of the input file in, or return NULL if it is empty or not a
+ * regular file, or if mmap fails.
  */
-static int gz_compress_mmap(FILE *in, gzFile out) {
-    int len;
-    int err;
-    int ifd = fileno(in);
-    caddr_t buf;    /* mmap'ed buffer for the entire input file */
-    off_t buf_len;  /* length of the input file */
+static unsigned char *map_input(FILE *in, z_size_t *len) {
+    void *buf;      /* mmap'ed buffer for the entire input file */
     struct stat sb;
 
     /* Determine the size of the file, needed for mmap: */
-    if (fstat(ifd, &sb) < 0) return Z_ERRNO;
-    buf_len = sb.st_size;
-    if (buf_len <= 0) return Z_ERRNO;
+    if (fstat(fileno(in), &sb) < 0 || !S_ISREG(sb.st_mode) ||
+        sb.st_size <= 0 || (off_t)(uLong)sb.st_size != sb.st_size)
+        return NULL;
+    *len = (z_size_t)sb.st_size;
 
     /* Now do the actual mmap: */
-    buf = mmap((caddr_t) 0, buf_len, PROT_READ, MAP_SHARED, ifd, (off_t)0);
-    if (buf == (caddr_t)(-1)) return Z_ERRNO;
+    buf = mmap(NULL, *len, PROT_READ, MAP_SHARED, fileno(in), 0);
+    if (buf == MAP_FAILED)
+        return NULL;
+    posix_madvise(buf, *len, POSIX_MADV_SEQUENTIAL);
+    return (unsigned char *)buf;
+}
 
-    /* Compress the whole file at once: */
-    len = gzwrite(out, (char *)buf, (unsigned)buf_len);
+/* Try compressing the input file at once using mmap. Return Z_OK if
+ * success, Z_ERRNO otherwise.
+ */
+static int gz_compress_mmap(FILE *in, gzFile out) {
+    unsigned char *buf;
+    z_size_t len, left;
+    unsigned n;
+    int err;
+
+    buf = map_input(in, &len);
+    if (buf == NULL) return Z_ERRNO;
 
-    if (len != (int)buf_len) error(gzerror(out, &err));
+    /* Compress the whole file, in pieces that gzwrite() can take: */
+    for (left = len; left; left -= n) {
+        n = left > (1U << 30) ? 1U << 30 : (unsigned)left;
+        if (gzwrite(out, buf + (len - left), n) != (int)n)
+            error(gzerror(out, &err));
+    }
 
-    munmap(buf, buf_len);
+    munmap(buf, len);
     fclose(in);
     if (gzclose(out) != Z_OK) error("failed gzclose");
     return Z_OK;
@@ -413,29 +441,128 @@ static void gz_uncompress(gzFile in, FILE *out) {
     if (gzclose(in) != Z_OK) error("failed gzclose");
 }
 
+#ifndef Z_SOLO
+
+#define PAR_SLICE (32L << 20)
+/* With -p, input that can't be mapped is read and compressed this many bytes
+ * at a time, each slice becoming its own gzip member.
+ */
+
+/* ===========================================================================
+ * Compress buf[0..len-1] to out as one gzip member, using par threads.
+ */
+static void par_member(const unsigned char *buf, z_size_t len, int level,
+                       FILE *out) {
+    static unsigned char *dest = NULL;
+    static uLong size = 0;
+    uLongf destLen;
+
+    destLen = compressParallelBound((uLong)len, 31);
+    if (destLen > size) {
+        free(dest);
+        size = destLen;
+        dest = (unsigned char *)malloc(size);
+        if (dest == NULL) error("out of memory");
+    }
+    if (compressParallel(dest, &destLen, buf, (uLong)len, level, 31,
+                         par) != Z_OK)
+        error("compressParallel failed");
+    if (fwrite(dest, 1, destLen, out) != destLen) error("failed fwrite");
+}
+
+/* ===========================================================================
+ * Compress input to output with par threads, then close both files.
+ */
+static void gz_compress_par(FILE *in, FILE *out, int level) {
+    unsigned char *buf;
+    z_size_t len;
+
+#ifdef USE_MMAP
+    buf = map_input(in, &len);
+    if (buf != NULL) {
+        par_member(buf, len, level, out);
+        munmap(buf, len);
+    }
+    else
+#endif
+    {
+        buf = (unsigned char *)malloc(PAR_SLICE);
+        if (buf == NULL) error("out of memory");
+        do {
+            len = fread(buf, 1, PAR_SLICE, in);
+            if (ferror(in)) {
+                perror("fread");
+                exit(1);
+            }
+            par_member(buf, len, level, out);
+        } while (len == PAR_SLICE);
+        free(buf);
+    }
+    fclose(in);
+    if (fclose(out)) error("failed fclose");
+}
+
+/* ===========================================================================
+ * Uncompress input to output with par threads, then close both files.
+ */
+static void gz_uncompress_par(gzFile in, FILE *out) {
+    int err;
+
+    fflush(out);
+    err = gzuncompressParallel(in, fileno(out), par);
+    if (err != Z_OK) error(err == Z_ERRNO ? "read or write error" :
+                           gzerror(in, &err));
+    if (fclose(out)) error("failed fclose");
+
+    if (gzclose(in) != Z_OK) error("failed gzclose");
+}
+#endif /* !Z_SOLO */
+
+
+/* ===========================================================================
+ * Put the name of the .gz file for file in outfile[0..MAX_NAME_LEN].
+ */
+static void gz_name(char *outfile, const char *file) {
+    char *end;
+
+    if (strlen(file) + strlen(GZ_SUFFIX) > MAX_NAME_LEN) {
+        fprintf(stderr, "%s: filename too long\n", prog);
+        exit(1);
+    }
+
+    end = string_copy(outfile, file, MAX_NAME_LEN+1);
+    string_copy(end, GZ_SUFFIX, MAX_NAME_LEN+1 - (z_size_t)(end - outfile));
+}
 
 /* ===========================================================================
  * Compress the given file: create a corresponding .gz file and remove the
  * original.
  */
 static void file_compress(char *file, char *mode) {
-    local char outfile[MAX_NAME_LEN+1], *end;
+    local char outfile[MAX_NAME_LEN+1];
     FILE  *in;
     gzFile out;
 
-    if (strlen(file) + strlen(GZ_SUFFIX) >= sizeof(outfile)) {
-        fprintf(stderr, "%s: filename too long\n", prog);
-        exit(1);
-    }
-
-    end = string_copy(outfile, file, sizeof(outfile));
-    string_copy(end, GZ_SUFFIX, sizeof(outfile) - (z_size_t)(end - outfile));
+    gz_name(outfile, file);
 
     in = fopen(file, "rb");
     if (in == NULL) {
         perror(file);
         exit(1);
     }
+#ifndef Z_SOLO
+    if (par && mode[3] == 0) {
+        FILE *pout = fopen(outfile, "wb");
+
+        if (pout == NULL) {
+            perror(outfile);
+            exit(1);
+        }
+        gz_compress_par(in, pout, mode[2] - '0');
+        unlink(file);
+        return;
+    }
+#endif
     out = gzopen(outfile, mode);
     if (out == NULL) {
         fprintf(stderr, "%s: can't gzopen %s\n", prog, outfile);
@@ -447,6 +574,123 @@ static void file_compress(char *file, char *mode) {
 }
 
 
+#ifndef Z_SOLO
+/* ===========================================================================
+ * A whole input file compressed by a compressAsync() job.
+ */
+typedef struct {
+    z_job job;
+    char name[MAX_NAME_LEN+1];  /* input file, removed when done */
+    unsigned char *buf;         /* contents of the input file */
+    int mapped;                 /* true if buf is mapped, else allocated */
+} file_job;
+
+/* ===========================================================================
+ * Load file and submit it to async for compression.
+ */
+static void file_submit(z_asyncp async, char *file, int level) {
+    file_job *fj;
+    FILE *in;
+    z_size_t len = 0, got;
+
+    fj = (file_job *)calloc(1, sizeof(file_job));
+    if (fj == NULL) error("out of memory");
+    string_copy(fj->name, file, sizeof(fj->name));
+    in = fopen(file, "rb");
+    if (in == NULL) {
+        perror(file);
+        exit(1);
+    }
+#ifdef USE_MMAP
+    fj->buf = map_input(in, &len);
+    fj->mapped = fj->buf != NULL;
+#endif
+    if (fj->buf == NULL) {
+        /* not mappable, so read it all */
+        z_size_t size = 0;
+
+        do {
+            if (len == size) {
+                size = size ? size << 1 : BUFLEN;
+                fj->buf = (unsigned char *)realloc(fj->buf, size);
+                if (fj->buf == NULL) error("out of memory");
+            }
+            got = fread(fj->buf + len, 1, size - len, in);
+            len += got;
+        } while (got);
+        if (ferror(in)) {
+            perror("fread");
+            exit(1);
+        }
+    }
+    fclose(in);
+
+    fj->job.source = fj->buf;
+    fj->job.sourceLen = (uLong)len;
+    fj->job.destLen = compressParallelBound((uLong)len, 31);
+    fj->job.dest = (Bytef *)malloc(fj->job.destLen);
+    if (fj->job.dest == NULL) error("out of memory");
+    fj->job.level = level;
+    fj->job.windowBits = 31;
+    fj->job.threads = 1;
+    fj->job.opaque = fj;
+    if (compressAsync(async, &fj->job) != Z_OK) error("compressAsync failed");
+}
+
+/* ===========================================================================
+ * Write the .gz file for a completed job and remove the original.
+ */
+static void file_finish(z_job *job) {
+    local char outfile[MAX_NAME_LEN+1];
+    file_job *fj = (file_job *)job->opaque;
+    FILE *out;
+
+    if (job->err != Z_OK) error("compressAsync failed");
+    gz_name(outfile, fj->name);
+    out = fopen(outfile, "wb");
+    if (out == NULL) {
+        perror(outfile);
+        exit(1);
+    }
+    if (fwrite(job->dest, 1, job->destLen, out) != job->destLen ||
+        fclose(out))
+        error("failed fwrite");
+#ifdef USE_MMAP
+    if (fj->mapped)
+        munmap(fj->buf, job->sourceLen);
+    else
+#endif
+        free(fj->buf);
+    free(job->dest);
+    unlink(fj->name);
+    free(fj);
+}
+
+/* ===========================================================================
+ * Compress count files at once with par threads, each to its .gz file, and
+ * remove the originals. No more than two jobs per thread are loaded at once.
+ */
+static void files_compress(char **files, int count, int level) {
+    z_asyncp async;
+    int busy = 0;
+
+    async = zlibAsyncCreate(par);
+    if (async == NULL) error("out of memory");
+    while (count || busy) {
+        if (count && busy < 2 * par) {
+            file_submit(async, *files++, level);
+            count--;
+            busy++;
+        }
+        else {
+            file_finish(zlibAsyncReap(async, 1));
+            busy--;
+        }
+    }
+    zlibAsyncDestroy(async);
+}
+#endif /* !Z_SOLO */
+
 /* ===========================================================================
  * Uncompress the given file and remove the original.
  */
@@ -473,7 +717,7 @@ static void file_uncompress(char *file) {
         infile = buf;
         string_copy(buf + len, GZ_SUFFIX, sizeof(buf) - len);
     }
-    in = gzopen(infile, "rb");
+    in = gzopen(infile, READ_MODE);
     if (in == NULL) {
         fprintf(stderr, "%s: can't gzopen %s\n", prog, infile);
         exit(1);
@@ -484,20 +728,27 @@ static void file_uncompress(char *file) {
         exit(1);
     }
 
-    gz_uncompress(in, out);
+#ifndef Z_SOLO
+    if (par)
+        gz_uncompress_par(in, out);
+    else
+#endif
+        gz_uncompress(in, out);
 
     unlink(infile);
 }
 
 
 /* ===========================================================================
- * Usage:  minigzip [-c] [-d] [-f] [-h] [-r] [-1 to -9] [files...]
+ * Usage:  minigzip [-c] [-d] [-f] [-h] [-r] [-1 to -9] [-p n] [files...]
  *   -c : write to standard output
  *   -d : decompress
  *   -f : compress with Z_FILTERED
  *   -h : compress with Z_HUFFMAN_ONLY
  *   -r : compress with Z_RLE
  *   -1 to -9 : compression level
+ *   -p n : use n threads, and compress several files at once -- not with
+ *          -f, -h, or -r
  */
 
 int main(int argc, char *argv[]) {
@@ -534,6 +785,13 @@ int main(int argc, char *argv[]) {
       else if ((*argv)[0] == '-' && (*argv)[1] >= '1' && (*argv)[1] <= '9' &&
                (*argv)[2] == 0)
         outmode[2] = (*argv)[1];
+#ifndef Z_SOLO
+      else if (strcmp(*argv, "-p") == 0 && argc > 1) {
+        argc--, argv++;
+        par = atoi(*argv);
+        if (par < 1) error("-p needs a number of threads");
+      }
+#endif
       else
         break;
       argc--, argv++;
@@ -546,7 +804,16 @@ int main(int argc, char *argv[]) {
         if (uncompr) {
             file = gzdopen(fileno(stdin), "rb");
             if (file == NULL) error("can't gzdopen stdin");
-            gz_uncompress(file, stdout);
+#ifndef Z_SOLO
+            if (par && ftell(stdin) != -1)      /* can't be a pipe */
+                gz_uncompress_par(file, stdout);
+            else
+#endif
+                gz_uncompress(file, stdout);
+#ifndef Z_SOLO
+        } else if (par && outmode[3] == 0) {
+            gz_compress_par(stdin, stdout, outmode[2] - '0');
+#endif
         } else {
             file = gzdopen(fileno(stdout), outmode);
             if (file == NULL) error("can't gzdopen stdout");
@@ -556,12 +823,22 @@ int main(int argc, char *argv[]) {
         if (copyout) {
             SET_BINARY_MODE(stdout);
         }
+#ifndef Z_SOLO
+        if (par && !uncompr && !copyout && outmode[3] == 0 && argc > 1) {
+            files_compress(argv, argc, outmode[2] - '0');
+            return 0;
+        }
+#endif
         do {
             if (uncompr) {
                 if (copyout) {
-                    file = gzopen(*argv, "rb");
+                    file = gzopen(*argv, READ_MODE);
                     if (file == NULL)
                         fprintf(stderr, "%s: can't gzopen %s\n", prog, *argv);
+#ifndef Z_SOLO
+                    else if (par)
+                        gz_uncompress_par(file, stdout);
+#endif
                     else
                         gz_uncompress(file, stdout);
                 } else {
@@ -573,6 +850,10 @@ int main(int argc, char *argv[]) {
 
                     if (in == NULL) {
                         perror(*argv);
+#ifndef Z_SOLO
+                    } else if (par && outmode[3] == 0) {
+                        gz_compress_par(in, stdout, outmode[2] - '0');
+#endif
                     } else {
                         file = gzdopen(fileno(stdout), outmode);
                         if (file == NULL) error("can't gzdopen stdout");
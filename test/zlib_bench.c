@@ -0,0 +1,519 @@
+/* zlib_bench.c -- benchmark of the zlib compression library
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/*
+   zlib_bench runs deflate and inflate over a corpus with a sweep of levels,
+   strategies, window sizes, and memory levels, and measures crc32() and
+   adler32(), writing the results as JSON to stdout.  The corpus is always the
+   same four synthetic buffers -- text, binary records, runs, and random bytes
+   -- made by a fixed pseudo-random generator, plus any files named on the
+   command line, such as those of the Silesia corpus.  So runs of the same
+   version on the same machine can be compared for regressions.
+
+   Speeds are in MB/s (10^6 bytes per second) of uncompressed data, from the
+   total time of as many repetitions as fit in the minimum time, at least one.
+   ratio is the compressed size over the uncompressed size.  Memory is the
+   peak number of bytes allocated by a stream, from its own zalloc, not the
+   memory of the process.  Every round trip is checked, with exit status 1 if
+   any fails.
+
+   Usage: zlib_bench [-q] [-t seconds] [-s bytes] [files...]
+
+     -q  quick: only levels 1, 6, and 9, and one repetition, to check that the
+         benchmark works (this is how ctest runs it)
+     -t  minimum time for each measurement in seconds (default 0.5)
+     -s  size of each synthetic buffer in bytes (default 4194304)
+ */
+
+#if defined(_WIN32) && !defined(_CRT_SECURE_NO_WARNINGS)
+#  define _CRT_SECURE_NO_WARNINGS
+#endif
+#if !defined(_WIN32) && !defined(_POSIX_C_SOURCE)
+#  define _POSIX_C_SOURCE 200112L
+#endif
+
+#include "zlib.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _WIN32
+#  ifndef WIN32_LEAN_AND_MEAN
+#    define WIN32_LEAN_AND_MEAN
+#  endif
+#  include <windows.h>
+#endif
+
+/* ===========================================================================
+ * Return the time in seconds from an arbitrary start.
+ */
+static double now(void) {
+#if defined(_WIN32)
+    LARGE_INTEGER freq, count;
+
+    QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&count);
+    return (double)count.QuadPart / (double)freq.QuadPart;
+#elif defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + ts.tv_nsec * 1e-9;
+#else
+    return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+/* ===========================================================================
+ * Allocation functions that keep track of the peak memory of a stream.  Each
+ * block has its size in front of it, in a union aligned for any use.
+ */
+typedef union {
+    size_t size;
+    double align_d;
+    void *align_p;
+} bench_head;
+
+typedef struct {
+    size_t used;        /* bytes allocated now */
+    size_t peak;        /* most bytes allocated at once */
+} bench_mem;
+
+static voidpf bench_alloc(voidpf opaque, uInt items, uInt size) {
+    bench_mem *mem = (bench_mem *)opaque;
+    size_t len = (size_t)items * size;
+    bench_head *head;
+
+    head = (bench_head *)malloc(sizeof(bench_head) + len);
+    if (head == NULL)
+        return Z_NULL;
+    head->size = len;
+    mem->used += len;
+    if (mem->used > mem->peak)
+        mem->peak = mem->used;
+    return (voidpf)(head + 1);
+}
+
+static void bench_free(voidpf opaque, voidpf ptr) {
+    bench_mem *mem = (bench_mem *)opaque;
+    bench_head *head = (bench_head *)ptr - 1;
+
+    mem->used -= head->size;
+    free(head);
+}
+
+/* ===========================================================================
+ * The corpus.
+ */
+typedef struct {
+    char name[64];
+    unsigned char *data;
+    size_t len;
+} bench_buf;
+
+/* 32-bit linear congruential generator, the same on every platform */
+static unsigned long bench_seed;
+
+static unsigned rnd(unsigned n) {
+    bench_seed = (bench_seed * 1103515245UL + 12345UL) & 0xffffffffUL;
+    return (unsigned)((bench_seed >> 8) % n);
+}
+
+/* Text of 4096 made-up words of two to four syllables, chosen with a skew
+   toward the first ones, with punctuation and lines of about 72 columns */
+static void make_text(unsigned char *buf, size_t len) {
+    static const char *syl[] = {
+        "the", "an", "in", "re", "con", "ing", "er", "ed", "es", "al",
+        "ti", "on", "at", "ou", "pre", "st", "de", "com", "ex", "ly",
+        "ma", "ter", "ri", "ve", "pro", "ble", "ca", "mo", "sa", "tion"
+    };
+    char words[4096][16];
+    size_t have = 0, n;
+    unsigned k, col = 0;
+    const char *word;
+
+    for (k = 0; k < 4096; k++) {
+        words[k][0] = 0;
+        n = 2 + rnd(3);
+        while (n--)
+            strcat(words[k], syl[rnd(sizeof(syl) / sizeof(syl[0]))]);
+    }
+    while (have < len) {
+        word = words[rnd(rnd(4096) + 1)];
+        for (n = 0; word[n] && have < len; n++)
+            buf[have++] = (unsigned char)word[n];
+        col += (unsigned)n + 1;
+        if (have < len && rnd(10) == 0)
+            buf[have++] = (unsigned char)(rnd(3) ? ',' : '.');
+        if (have < len)
+            buf[have++] = (unsigned char)(col > 72 ? '\n' : ' ');
+        if (col > 72)
+            col = 0;
+    }
+}
+
+/* 16-byte records with a counter, a small value, and one of a few tags */
+static void make_binary(unsigned char *buf, size_t len) {
+    size_t have;
+    unsigned long count = 0;
+    unsigned k, val = 0;
+
+    for (have = 0; have < len; have++) {
+        k = have & 15;
+        if (k == 0) {
+            count++;
+            val = rnd(1000);
+        }
+        buf[have] = (unsigned char)(k < 4 ? count >> (8 * k) :
+                                    k < 8 ? (val >> (8 * (k - 4))) * 3 :
+                                    (val & 7) * 16 + k);
+    }
+}
+
+/* Runs of random lengths of a few byte values */
+static void make_rle(unsigned char *buf, size_t len) {
+    size_t have = 0, run;
+    unsigned char val;
+
+    while (have < len) {
+        val = (unsigned char)(rnd(4) * 0x55);
+        run = 1 + rnd(rnd(300) + 1);
+        while (run-- && have < len)
+            buf[have++] = val;
+    }
+}
+
+/* Incompressible bytes */
+static void make_random(unsigned char *buf, size_t len) {
+    size_t have;
+
+    for (have = 0; have < len; have++)
+        buf[have] = (unsigned char)rnd(256);
+}
+
+/* Read the file at path into buf, returning 0 on success */
+static int load_file(bench_buf *buf, const char *path) {
+    FILE *in;
+    const char *base;
+    size_t size = 1 << 20, got;
+    unsigned char *mem;
+
+    in = fopen(path, "rb");
+    if (in == NULL)
+        return -1;
+    buf->data = NULL;
+    buf->len = 0;
+    for (;;) {
+        mem = (unsigned char *)realloc(buf->data, size);
+        if (mem == NULL) {
+            free(buf->data);
+            fclose(in);
+            return -1;
+        }
+        buf->data = mem;
+        got = fread(buf->data + buf->len, 1, size - buf->len, in);
+        buf->len += got;
+        if (buf->len < size)
+            break;
+        size <<= 1;
+    }
+    fclose(in);
+    base = strrchr(path, '/');
+    base = base == NULL ? path : base + 1;
+    strncpy(buf->name, base, sizeof(buf->name) - 1);
+    buf->name[sizeof(buf->name) - 1] = 0;
+    for (got = 0; buf->name[got]; got++)     /* keep the JSON simple */
+        if (buf->name[got] == '"' || buf->name[got] == '\\' ||
+            (unsigned char)buf->name[got] < 32)
+            buf->name[got] = '_';
+    return 0;
+}
+
+/* ===========================================================================
+ * The measurements.
+ */
+typedef struct {
+    int level;
+    int strategy;
+    int windowBits;
+    int memLevel;
+} bench_config;
+
+static const char *strategy_name(int strategy) {
+    switch (strategy) {
+    case Z_FILTERED:        return "filtered";
+    case Z_HUFFMAN_ONLY:    return "huffman_only";
+    case Z_RLE:             return "rle";
+    case Z_FIXED:           return "fixed";
+#ifdef Z_QUICK
+    case Z_QUICK:           return "quick";
+#endif
+    default:                return "default";
+    }
+}
+
+static double min_time = 0.5;
+
+/* Checksums go here, so that they are not optimized away */
+static volatile uLong bench_sink;
+
+/* Compress buf with cfg into out, which has room for deflateBound(), and
+   return the compressed length, or 0 on error */
+static uLong bench_deflate(const bench_buf *buf, const bench_config *cfg,
+                           unsigned char *out, uLong size, bench_mem *mem) {
+    z_stream strm;
+    uLong got;
+    int ret;
+
+    strm.zalloc = bench_alloc;
+    strm.zfree = bench_free;
+    strm.opaque = (voidpf)mem;
+    if (deflateInit2(&strm, cfg->level, Z_DEFLATED, cfg->windowBits,
+                     cfg->memLevel, cfg->strategy) != Z_OK)
+        return 0;
+    strm.next_in = buf->data;
+    strm.next_out = out;
+    got = 0;
+    do {
+        /* feed at most 1G at a time for uInt avail_in and avail_out */
+        strm.avail_in = (uInt)(buf->len - strm.total_in > 0x40000000UL ?
+                               0x40000000UL : buf->len - strm.total_in);
+        strm.avail_out = (uInt)(size - got > 0x40000000UL ? 0x40000000UL :
+                                size - got);
+        ret = deflate(&strm, strm.total_in + strm.avail_in == buf->len ?
+                      Z_FINISH : Z_NO_FLUSH);
+        got = strm.total_out;
+    } while (ret == Z_OK);
+    deflateEnd(&strm);
+    return ret == Z_STREAM_END ? got : 0;
+}
+
+/* Decompress the len bytes at in to out, which has room for buf, and return
+   0 if it is a copy of buf */
+static int bench_inflate(const bench_buf *buf, const unsigned char *in,
+                         uLong len, unsigned char *out, int windowBits,
+                         bench_mem *mem) {
+    z_stream strm;
+    int ret;
+
+    strm.zalloc = bench_alloc;
+    strm.zfree = bench_free;
+    strm.opaque = (voidpf)mem;
+    strm.next_in = Z_NULL;
+    strm.avail_in = 0;
+    if (inflateInit2(&strm, windowBits) != Z_OK)
+        return -1;
+    strm.next_in = (z_const Bytef *)in;
+    strm.next_out = out;
+    do {
+        strm.avail_in = (uInt)(len - strm.total_in > 0x40000000UL ?
+                               0x40000000UL : len - strm.total_in);
+        strm.avail_out = (uInt)(buf->len - strm.total_out > 0x40000000UL ?
+                                0x40000000UL : buf->len - strm.total_out);
+        ret = inflate(&strm, Z_NO_FLUSH);
+    } while (ret == Z_OK && strm.avail_in + strm.avail_out);
+    inflateEnd(&strm);
+    return ret == Z_STREAM_END && strm.total_out == buf->len &&
+           memcmp(out, buf->data, buf->len) == 0 ? 0 : -1;
+}
+
+/* Return MB/s for len bytes done reps times in secs seconds */
+static double rate(size_t len, unsigned long reps, double secs) {
+    return secs > 0 ? (double)len * reps / secs / 1e6 : 0;
+}
+
+/* Run and report one configuration on buf, returning 0 on success */
+static int bench_one(const bench_buf *buf, const bench_config *cfg,
+                     unsigned char *comp, uLong size, unsigned char *back,
+                     int first) {
+    bench_mem dmem, imem;
+    double start, secs, def, inf;
+    unsigned long reps;
+    uLong len = 0;
+
+    dmem.used = dmem.peak = 0;
+    reps = 0;
+    start = now();
+    do {
+        len = bench_deflate(buf, cfg, comp, size, &dmem);
+        if (len == 0)
+            return -1;
+        reps++;
+        secs = now() - start;
+    } while (secs < min_time);
+    def = rate(buf->len, reps, secs);
+
+    imem.used = imem.peak = 0;
+    reps = 0;
+    start = now();
+    do {
+        if (bench_inflate(buf, comp, len, back, cfg->windowBits, &imem))
+            return -1;
+        reps++;
+        secs = now() - start;
+    } while (secs < min_time);
+    inf = rate(buf->len, reps, secs);
+
+    printf("%s    {\"corpus\": \"%s\", \"level\": %d, \"strategy\": \"%s\", "
+           "\"windowBits\": %d, \"memLevel\": %d, \"ratio\": %.4f, "
+           "\"deflate_MBps\": %.1f, \"inflate_MBps\": %.1f, "
+           "\"deflate_mem\": %lu, \"inflate_mem\": %lu}",
+           first ? "" : ",\n", buf->name, cfg->level,
+           strategy_name(cfg->strategy), cfg->windowBits, cfg->memLevel,
+           buf->len ? (double)len / buf->len : 0, def, inf,
+           (unsigned long)dmem.peak, (unsigned long)imem.peak);
+    return 0;
+}
+
+/* Report the speeds of crc32_z() and adler32_z() on buf */
+static void bench_check(const bench_buf *buf, int first) {
+    double start, secs, crc, adler;
+    unsigned long reps;
+    uLong val = 0;
+
+    reps = 0;
+    start = now();
+    do {
+        val ^= crc32_z(0L, buf->data, buf->len);
+        reps++;
+        secs = now() - start;
+    } while (secs < min_time);
+    crc = rate(buf->len, reps, secs);
+    reps = 0;
+    start = now();
+    do {
+        val ^= adler32_z(1L, buf->data, buf->len);
+        reps++;
+        secs = now() - start;
+    } while (secs < min_time);
+    adler = rate(buf->len, reps, secs);
+    bench_sink = val;
+    printf("%s    {\"corpus\": \"%s\", \"bytes\": %lu, \"crc32_MBps\": %.1f, "
+           "\"adler32_MBps\": %.1f}", first ? "" : ",\n",
+           buf->name, (unsigned long)buf->len, crc, adler);
+}
+
+/* ===========================================================================
+ * Usage:  zlib_bench [-q] [-t seconds] [-s bytes] [files...]
+ */
+int main(int argc, char **argv) {
+    static const bench_config sweep[] = {
+        {0, Z_DEFAULT_STRATEGY, 15, 8}, {1, Z_DEFAULT_STRATEGY, 15, 8},
+        {2, Z_DEFAULT_STRATEGY, 15, 8}, {3, Z_DEFAULT_STRATEGY, 15, 8},
+        {4, Z_DEFAULT_STRATEGY, 15, 8}, {5, Z_DEFAULT_STRATEGY, 15, 8},
+        {6, Z_DEFAULT_STRATEGY, 15, 8}, {7, Z_DEFAULT_STRATEGY, 15, 8},
+        {8, Z_DEFAULT_STRATEGY, 15, 8}, {9, Z_DEFAULT_STRATEGY, 15, 8},
+        {6, Z_FILTERED, 15, 8}, {6, Z_HUFFMAN_ONLY, 15, 8},
+        {6, Z_RLE, 15, 8}, {6, Z_FIXED, 15, 8},
+#ifdef Z_QUICK
+        {1, Z_QUICK, 15, 8},
+#endif
+        {6, Z_DEFAULT_STRATEGY, 9, 8}, {6, Z_DEFAULT_STRATEGY, 12, 8},
+        {6, Z_DEFAULT_STRATEGY, 31, 8}, {6, Z_DEFAULT_STRATEGY, 15, 1},
+        {6, Z_DEFAULT_STRATEGY, 15, 9}
+    };
+    static const bench_config quick[] = {
+        {1, Z_DEFAULT_STRATEGY, 15, 8}, {6, Z_DEFAULT_STRATEGY, 15, 8},
+        {9, Z_DEFAULT_STRATEGY, 15, 8}
+    };
+    static void (*const make[])(unsigned char *, size_t) = {
+        make_text, make_binary, make_rle, make_random
+    };
+    static const char *const names[] = {"text", "binary", "rle", "random"};
+    const bench_config *cfg;
+    bench_buf *corpus;
+    unsigned char *comp, *back;
+    size_t synth = 4194304, most;
+    uLong size;
+    unsigned n, k, bufs, cfgs;
+    int arg, first, fast = 0, ret = 0;
+
+    /* options */
+    for (arg = 1; arg < argc && argv[arg][0] == '-'; arg++) {
+        if (strcmp(argv[arg], "-q") == 0) {
+            fast = 1;
+            min_time = 0;
+            synth = 262144;
+        }
+        else if (strcmp(argv[arg], "-t") == 0 && arg + 1 < argc)
+            min_time = atof(argv[++arg]);
+        else if (strcmp(argv[arg], "-s") == 0 && arg + 1 < argc)
+            synth = (size_t)strtoul(argv[++arg], NULL, 10);
+        else {
+            fputs("usage: zlib_bench [-q] [-t seconds] [-s bytes] [files...]\n",
+                  stderr);
+            return 1;
+        }
+    }
+    cfg = fast ? quick : sweep;
+    cfgs = fast ? sizeof(quick) / sizeof(quick[0]) :
+                  sizeof(sweep) / sizeof(sweep[0]);
+
+    /* make the corpus */
+    corpus = (bench_buf *)malloc((4 + (unsigned)(argc - arg)) *
+                                 sizeof(bench_buf));
+    if (corpus == NULL) {
+        fputs("zlib_bench: out of memory\n", stderr);
+        return 1;
+    }
+    bench_seed = 1;
+    most = 0;
+    for (bufs = 0; bufs < 4; bufs++) {
+        strcpy(corpus[bufs].name, names[bufs]);
+        corpus[bufs].data = (unsigned char *)malloc(synth ? synth : 1);
+        if (corpus[bufs].data == NULL) {
+            fputs("zlib_bench: out of memory\n", stderr);
+            return 1;
+        }
+        corpus[bufs].len = synth;
+        make[bufs](corpus[bufs].data, synth);
+    }
+    for (; arg < argc; arg++, bufs++)
+        if (load_file(corpus + bufs, argv[arg])) {
+            fprintf(stderr, "zlib_bench: could not read %s\n", argv[arg]);
+            return 1;
+        }
+    for (n = 0; n < bufs; n++)
+        if (corpus[n].len > most)
+            most = corpus[n].len;
+    /* room for stored blocks as short as memLevel 1 makes them, and a gzip
+       header and trailer */
+    size = (uLong)most + (uLong)(most >> 3) + 1024;
+    comp = (unsigned char *)malloc(size);
+    back = (unsigned char *)malloc(most ? most : 1);
+    if (comp == NULL || back == NULL) {
+        fputs("zlib_bench: out of memory\n", stderr);
+        return 1;
+    }
+
+    /* run */
+    printf("{\n  \"zlib\": \"%s\",\n  \"compile_flags\": %lu,\n"
+           "  \"min_time\": %g,\n  \"checks\": [\n", zlibVersion(),
+           zlibCompileFlags(), min_time);
+    for (n = 0; n < bufs; n++)
+        bench_check(corpus + n, n == 0);
+    printf("\n  ],\n  \"results\": [\n");
+    first = 1;
+    for (n = 0; n < bufs; n++)
+        for (k = 0; k < cfgs; k++) {
+            if (bench_one(corpus + n, cfg + k, comp, size, back, first)) {
+                fprintf(stderr, "zlib_bench: %s level %d %s failed\n",
+                        corpus[n].name, cfg[k].level,
+                        strategy_name(cfg[k].strategy));
+                ret = 1;
+            }
+            else
+                first = 0;
+            fflush(stdout);
+        }
+    printf("\n  ]\n}\n");
+
+    for (n = 0; n < bufs; n++)
+        free(corpus[n].data);
+    free(corpus);
+    free(comp);
+    free(back);
+    return ret;
+}
@@ -50,6 +50,12 @@
 #define END_BLOCK 256
 /* end of block literal code */
 
+#define SPLIT_FIRST 2048
+/* number of symbols in a block before _tr_block_end() may end it early */
+
+#define SPLIT_SHORT 8192
+/* blocks of fewer symbols than this need a larger change to end */
+
 #define REP_3_6      16
 /* repeat previous bit length 3-6 times (2 bits of repeat count) */
 
@@ -146,6 +152,21 @@ local TCONST static_tree_desc static_bl_desc =
     put_byte(s, (uch)((ush)(w) >> 8)); \
 }
 
+/* ===========================================================================
+ * Output the bit buffer w, which is full, LSB first on the stream.
+ * IN assertion: there is enough room in pendingBuf.
+ */
+#ifdef BI_BUF64
+#  define put_bits(s, w) { \
+    put_short(s, (w)); \
+    put_short(s, (w) >> 16); \
+    put_short(s, (w) >> 32); \
+    put_short(s, (w) >> 48); \
+}
+#else
+#  define put_bits(s, w) put_short(s, w)
+#endif
+
 /* ===========================================================================
  * Reverse the first len bits of a code, using straightforward code (a faster
  * method would use a table)
@@ -164,11 +185,12 @@ local unsigned bi_reverse(unsigned code, int len) {
  * Flush the bit buffer, keeping at most 7 bits in it.
  */
 local void bi_flush(deflate_state *s) {
-    if (s->bi_valid == 16) {
+    while (s->bi_valid >= 16) {
         put_short(s, s->bi_buf);
-        s->bi_buf = 0;
-        s->bi_valid = 0;
-    } else if (s->bi_valid >= 8) {
+        s->bi_buf >>= 16;
+        s->bi_valid -= 16;
+    }
+    if (s->bi_valid >= 8) {
         put_byte(s, (Byte)s->bi_buf);
         s->bi_buf >>= 8;
         s->bi_valid -= 8;
@@ -179,9 +201,12 @@ local void bi_flush(deflate_state *s) {
  * Flush the bit buffer and align the output on a byte boundary
  */
 local void bi_windup(deflate_state *s) {
-    if (s->bi_valid > 8) {
+    while (s->bi_valid > 8) {
         put_short(s, s->bi_buf);
-    } else if (s->bi_valid > 0) {
+        s->bi_buf >>= 16;
+        s->bi_valid -= 16;
+    }
+    if (s->bi_valid > 0) {
         put_byte(s, (Byte)s->bi_buf);
     }
     s->bi_buf = 0;
@@ -255,16 +280,17 @@ local void send_bits(deflate_state *s, int value, int length) {
     s->bits_sent += (ulg)length;
 
     /* If not enough room in bi_buf, use (valid) bits from bi_buf and
-     * (16 - bi_valid) bits from value, leaving (width - (16 - bi_valid))
-     * unused bits in value.
+     * (Buf_size - bi_valid) bits from value, leaving (width - (Buf_size -
+     * bi_valid)) unused bits in value.  bi_buf is written when it fills, so
+     * that bi_valid is always less than Buf_size.
      */
-    if (s->bi_valid > (int)Buf_size - length) {
-        s->bi_buf |= (ush)value << s->bi_valid;
-        put_short(s, s->bi_buf);
-        s->bi_buf = (ush)value >> (Buf_size - s->bi_valid);
+    if (s->bi_valid >= (int)Buf_size - length) {
+        s->bi_buf |= (bitbuf)value << s->bi_valid;
+        put_bits(s, s->bi_buf);
+        s->bi_buf = (bitbuf)value >> (Buf_size - s->bi_valid);
         s->bi_valid += length - Buf_size;
     } else {
-        s->bi_buf |= (ush)value << s->bi_valid;
+        s->bi_buf |= (bitbuf)value << s->bi_valid;
         s->bi_valid += length;
     }
 }
@@ -272,14 +298,14 @@ local void send_bits(deflate_state *s, int value, int length) {
 
 #define send_bits(s, value, length) \
 { int len = length;\
-  if (s->bi_valid > (int)Buf_size - len) {\
+  if (s->bi_valid >= (int)Buf_size - len) {\
     int val = (int)value;\
-    s->bi_buf |= (ush)val << s->bi_valid;\
-    put_short(s, s->bi_buf);\
-    s->bi_buf = (ush)val >> (Buf_size - s->bi_valid);\
+    s->bi_buf |= (bitbuf)val << s->bi_valid;\
+    put_bits(s, s->bi_buf);\
+    s->bi_buf = (bitbuf)val >> (Buf_size - s->bi_valid);\
     s->bi_valid += len - Buf_size;\
   } else {\
-    s->bi_buf |= (ush)(value) << s->bi_valid;\
+    s->bi_buf |= (bitbuf)(value) << s->bi_valid;\
     s->bi_valid += len;\
   }\
 }
@@ -433,6 +459,30 @@ void gen_trees_header(void) {
 }
 #endif /* GEN_TREES_H */
 
+/* ===========================================================================
+ * Return the bits written so far, counting from the start of the stream.
+ */
+#define fit_used(s) \
+    (((ulg)((s)->strm->total_out + (s)->pending) << 3) + (s)->bi_valid)
+
+/* ===========================================================================
+ * For deflateFitBlock(), set sym_end for the next check of the block, given
+ * the bits that the block takes so far. The check is when the room left could
+ * be used up, if the symbols take 16 bits each, and at most SPLIT_STEP
+ * symbols later.
+ */
+local void fit_step(deflate_state *s, ulg bits) {
+    ulg used = fit_used(s) + bits;
+    ulg step = s->fit_room > used ? (s->fit_room - used) >> 4 : 0;
+
+    if (step < 1)
+        step = 1;
+    if (step > SPLIT_STEP)
+        step = SPLIT_STEP;
+    s->sym_end = s->sym_next + step * SYM_SIZE < s->sym_max ?
+                 s->sym_next + (uInt)step * SYM_SIZE : s->sym_max;
+}
+
 /* ===========================================================================
  * Initialize a new block.
  */
@@ -447,6 +497,14 @@ local void init_block(deflate_state *s) {
     s->dyn_ltree[END_BLOCK].Freq = 1;
     s->opt_len = s->static_len = 0L;
     s->sym_next = s->matches = 0;
+    for (n = 0; n < SPLIT_TYPES; n++) s->split_seen[n] = 0;
+    s->sym_seen = s->sym_split = 0;
+    s->sym_end = SPLIT_FIRST * SYM_SIZE < s->sym_max ?
+                 SPLIT_FIRST * SYM_SIZE : s->sym_max;
+    s->fit_ok = 0;
+    s->fit_len = 0;
+    if (s->fit == FIT_ON)
+        fit_step(s, FIT_EMPTY);
 }
 
 /* ===========================================================================
@@ -466,6 +524,7 @@ void ZLIB_INTERNAL _tr_init(deflate_state *s) {
 
     s->bi_buf = 0;
     s->bi_valid = 0;
+    s->split_keep = 0;
 #ifdef ZLIB_DEBUG
     s->compressed_len = 0L;
     s->bits_sent = 0L;
@@ -857,6 +916,7 @@ local void send_all_trees(deflate_state *s, int lcodes, int dcodes,
  */
 void ZLIB_INTERNAL _tr_stored_block(deflate_state *s, charf *buf,
                                     ulg stored_len, int last) {
+    Stat(s->stats.stored++);
     send_bits(s, (STORED_BLOCK<<1) + last, 3);  /* send block type */
     bi_windup(s);        /* align on byte boundary */
     put_short(s, (ush)stored_len);
@@ -872,6 +932,141 @@ void ZLIB_INTERNAL _tr_stored_block(deflate_state *s, charf *buf,
 #endif
 }
 
+/* ===========================================================================
+ * Add sign to the frequencies of the symbols from sym_buf index sx up to
+ * sym_next, and return the number of input bytes that those symbols cover.
+ */
+local ulg tally_tail(deflate_state *s, unsigned sx, int sign) {
+    unsigned dist;      /* distance of matched string */
+    unsigned lc;        /* match length or unmatched char (if dist == 0) */
+    ulg len = 0;        /* bytes covered */
+
+    while (sx < s->sym_next) {
+#ifdef LIT_MEM
+        dist = s->d_buf[sx];
+        lc = s->l_buf[sx++];
+#else
+        dist = s->sym_buf[sx++] & 0xff;
+        dist += (unsigned)(s->sym_buf[sx++] & 0xff) << 8;
+        lc = s->sym_buf[sx++];
+#endif
+        if (dist == 0) {
+            s->dyn_ltree[lc].Freq += sign;
+            len++;
+        } else {
+            s->dyn_ltree[_length_code[lc] + LITERALS + 1].Freq += sign;
+            dist--;
+            s->dyn_dtree[d_code(dist)].Freq += sign;
+            len += lc + MIN_MATCH;
+        }
+    }
+    return len;
+}
+
+local int fit_check(deflate_state *s);
+
+/* ===========================================================================
+ * Decide whether to end the current block, once sym_next has reached sym_end.
+ * The block ends if the symbol buffer is full, or if the symbols tallied since
+ * the last check are distributed differently enough from those before them
+ * that new Huffman codes would likely pay for another block header. Otherwise
+ * set sym_end to the next check, and return false.
+ *
+ * When the block is ended early, it ends at the last check, and the symbols
+ * since then start the next block, by way of s->sym_split. For
+ * deflateFitBlock(), fit_check() decides instead.
+ *
+ * The symbols are sorted into a few types: literals by their top two bits and
+ * their low bit, so that text, binary, and base64 differ, and short and long
+ * matches. The counts come from the frequencies already tallied for the
+ * trees, so the checks, every SPLIT_STEP symbols, cost nothing per symbol.
+ */
+int ZLIB_INTERNAL _tr_block_end(deflate_state *s) {
+    uInt seen[SPLIT_TYPES];     /* counts for the block so far */
+    ulg old, new;               /* symbols before and since the last check */
+    ulg delta, cutoff;          /* measured and allowed difference */
+    int n;
+
+    if (s->fit != FIT_OFF)
+        return fit_check(s);
+    if (s->sym_next >= s->sym_max)
+        return 1;
+    if (s->strategy == Z_FIXED)
+        goto next;
+
+    for (n = 0; n < SPLIT_TYPES; n++) seen[n] = 0;
+    for (n = 0; n < LITERALS; n++)
+        seen[((n >> 5) & 6) | (n & 1)] += s->dyn_ltree[n].Freq;
+    for (n = LITERALS + 1; n < LITERALS + 7; n++)   /* lengths 3..8 */
+        seen[8] += s->dyn_ltree[n].Freq;
+    for (; n < L_CODES; n++)
+        seen[9] += s->dyn_ltree[n].Freq;
+
+    /* Compare the new and old proportions of each type, scaled to
+       new * old, without division. */
+    old = new = 0;
+    for (n = 0; n < SPLIT_TYPES; n++) {
+        old += s->split_seen[n];
+        new += seen[n] - s->split_seen[n];
+    }
+    if (old != 0 && new != 0) {
+        delta = 0;
+        for (n = 0; n < SPLIT_TYPES; n++) {
+            ulg now = (seen[n] - s->split_seen[n]) * old;
+            ulg was = s->split_seen[n] * new;
+            delta += now > was ? now - was : was - now;
+        }
+        cutoff = ((new * 200) >> 9) * old;
+        if (old + new < SPLIT_SHORT)        /* favor longer blocks */
+            cutoff += cutoff / SPLIT_SHORT * (SPLIT_SHORT - old - new);
+        if (delta >= cutoff) {
+            s->sym_split = s->sym_seen;
+            return 1;
+        }
+    }
+    for (n = 0; n < SPLIT_TYPES; n++)
+        s->split_seen[n] = seen[n];
+    s->sym_seen = s->sym_next;
+
+  next:
+    s->sym_end = s->sym_next + SPLIT_STEP * SYM_SIZE < s->sym_max ?
+                 s->sym_next + SPLIT_STEP * SYM_SIZE : s->sym_max;
+    return 0;
+}
+
+/* ===========================================================================
+ * Start fitting the block for deflateFitBlock(), which has set fit_room. No
+ * symbols may have been tallied yet.
+ */
+void ZLIB_INTERNAL _tr_fit(deflate_state *s) {
+    Assert(s->sym_next == 0, "fit started late");
+    s->fit = FIT_ON;
+    s->fit_ok = 0;
+    s->fit_len = 0;
+    fit_step(s, FIT_EMPTY);
+}
+
+/* ===========================================================================
+ * Start the new block with the symbols held back by _tr_flush_block(). This
+ * must be done once the pending output is flushed, before any more symbols are
+ * tallied.
+ */
+void ZLIB_INTERNAL _tr_split_restore(deflate_state *s) {
+    unsigned keep = s->split_keep;
+
+    Assert(s->pending == 0 && s->sym_next == 0, "split restore too late");
+#ifdef LIT_MEM
+    zmemcpy((Bytef *)s->d_buf, s->split_buf, keep << 1);
+    zmemcpy(s->l_buf, s->split_buf + (keep << 1), keep);
+#else
+    zmemcpy(s->sym_buf, s->split_buf, keep);
+#endif
+    s->sym_next = keep;
+    s->split_keep = 0;
+    tally_tail(s, 0, 1);
+    Assert(keep < s->sym_end, "kept too many symbols");
+}
+
 /* ===========================================================================
  * Flush the bits in the bit buffer to pending output (leaves at most 7 bits)
  */
@@ -884,6 +1079,7 @@ void ZLIB_INTERNAL _tr_flush_bits(deflate_state *s) {
  * This takes 10 bits, of which 7 may remain in the bit buffer.
  */
 void ZLIB_INTERNAL _tr_align(deflate_state *s) {
+    Stat(s->stats.fixed++);
     send_bits(s, STATIC_TREES<<1, 3);
     send_code(s, END_BLOCK, static_ltree);
 #ifdef ZLIB_DEBUG
@@ -893,7 +1089,230 @@ void ZLIB_INTERNAL _tr_align(deflate_state *s) {
 }
 
 /* ===========================================================================
- * Send the block data compressed using the given Huffman trees
+ * Align the output on a byte boundary after a completed block, for
+ * Z_LATENCY_FLUSH, with the fewest bits: none if it is already aligned, else
+ * one to three empty static blocks if the bits to the boundary are even, since
+ * each is ten bits long, else an empty stored block.
+ */
+void ZLIB_INTERNAL _tr_sync(deflate_state *s) {
+    int pad = -s->bi_valid & 7;     /* bits to the next byte boundary */
+
+    if (pad & 1) {
+        _tr_stored_block(s, (char *)0, 0L, 0);
+        return;
+    }
+    /* n empty static blocks are 10 * n bits, which is 2 * n mod 8 */
+    for (pad >>= 1; pad; pad--) {
+        Stat(s->stats.fixed++);
+        send_bits(s, STATIC_TREES<<1, 3);
+        send_code(s, END_BLOCK, static_ltree);
+#ifdef ZLIB_DEBUG
+        s->compressed_len += 10L;
+#endif
+    }
+    bi_flush(s);
+}
+
+/* ===========================================================================
+ * Start a block coded with the static trees, for deflate_quick(), which sends
+ * the symbols immediately with _tr_quick_lit() and _tr_quick_dist(), instead
+ * of saving them to sym_buf.
+ */
+void ZLIB_INTERNAL _tr_quick_start(deflate_state *s, int last) {
+    Stat(s->stats.fixed++);
+    send_bits(s, (STATIC_TREES<<1) + last, 3);
+}
+
+/* ===========================================================================
+ * Send a literal byte with the static trees.
+ */
+void ZLIB_INTERNAL _tr_quick_lit(deflate_state *s, unsigned c) {
+    Stat(s->stats.literals++);
+    send_code(s, c, static_ltree);
+    Tracecv(isgraph(c), (stderr," '%c' ", c));
+}
+
+/* ===========================================================================
+ * Send a match with the static trees.  dist is the distance and lc is the
+ * length - MIN_MATCH.
+ */
+void ZLIB_INTERNAL _tr_quick_dist(deflate_state *s, unsigned dist,
+                                  unsigned lc) {
+    unsigned code;      /* the code to send */
+    int extra;          /* number of extra bits to send */
+
+    Stat(s->stats.matches++; s->stats.match_bytes += lc + MIN_MATCH);
+    code = _length_code[lc];
+    send_code(s, code + LITERALS + 1, static_ltree);
+    extra = extra_lbits[code];
+    if (extra != 0)
+        send_bits(s, (int)(lc - (unsigned)base_length[code]), extra);
+    dist--;
+    code = d_code(dist);
+    Assert (code < D_CODES, "bad d_code");
+    send_code(s, code, static_dtree);
+    extra = extra_dbits[code];
+    if (extra != 0)
+        send_bits(s, (int)(dist - (unsigned)base_dist[code]), extra);
+}
+
+/* ===========================================================================
+ * End a block started with _tr_quick_start(), and if last, align the output
+ * on a byte boundary.
+ */
+void ZLIB_INTERNAL _tr_quick_end(deflate_state *s, int last) {
+    send_code(s, END_BLOCK, static_ltree);
+    if (last)
+        bi_windup(s);
+#ifdef ZLIB_DEBUG
+    s->compressed_len = s->bits_sent;
+#endif
+}
+
+/* ===========================================================================
+ * Set the costs in bits for deflate_optimal() of each literal in lit[], of
+ * each match length in len[], and of each match distance in dist[], indexed
+ * by the distance minus one as for d_code(). The costs include the extra bits.
+ * If count is zero, they are the costs with the fixed codes. Otherwise they
+ * are the costs with the dynamic codes for the symbols of the current block,
+ * followed by the count literals and matches of the parse plen[] and pdist[]
+ * of the input at buf. Each symbol is counted once more, so that all of the
+ * symbols have codes.
+ */
+void ZLIB_INTERNAL _tr_opt_cost(deflate_state *s, const Bytef *buf,
+                                const ushf *plen, const ushf *pdist,
+                                unsigned count, uchf *lit, uchf *len,
+                                uchf *dist) {
+    ct_data ltree[HEAP_SIZE];       /* literal and length tree */
+    ct_data dtree[2*D_CODES+1];     /* distance tree */
+    tree_desc desc;
+    const ct_data *lt = static_ltree, *dt = static_dtree;
+    ulg opt_len = s->opt_len, static_len = s->static_len;
+    unsigned n, code;
+
+    if (count) {
+        for (n = 0; n < L_CODES; n++)
+            ltree[n].Freq = s->dyn_ltree[n].Freq + 1;
+        for (n = 0; n < D_CODES; n++)
+            dtree[n].Freq = s->dyn_dtree[n].Freq + 1;
+        for (n = 0; n < count; n++) {
+            if (plen[n] == 1)
+                ltree[*buf].Freq++;
+            else {
+                ltree[_length_code[plen[n] - MIN_MATCH] + LITERALS + 1].Freq++;
+                dtree[d_code(pdist[n] - 1)].Freq++;
+            }
+            buf += plen[n];
+        }
+
+        /* Build the trees for their code lengths, leaving the block's totals
+           as they were */
+        desc.dyn_tree = ltree;
+        desc.stat_desc = &static_l_desc;
+        build_tree(s, &desc);
+        desc.dyn_tree = dtree;
+        desc.stat_desc = &static_d_desc;
+        build_tree(s, &desc);
+        s->opt_len = opt_len;
+        s->static_len = static_len;
+        lt = ltree;
+        dt = dtree;
+    }
+    for (n = 0; n < LITERALS; n++)
+        lit[n] = (uch)lt[n].Len;
+    for (n = MIN_MATCH; n <= MAX_MATCH; n++) {
+        code = _length_code[n - MIN_MATCH];
+        len[n] = (uch)(lt[code + LITERALS + 1].Len + extra_lbits[code]);
+    }
+    for (n = 0; n < DIST_CODE_LEN; n++) {
+        code = _dist_code[n];
+        dist[n] = (uch)(dt[code].Len + extra_dbits[code]);
+    }
+}
+
+/* ===========================================================================
+ * Return an estimate of the number of bits to send the symbols of the current
+ * block so far, with the smaller of the dynamic and the fixed codes. The trees
+ * are built on copies of the frequencies, leaving the block as it was. The
+ * dynamic trees themselves are estimated at four bits for each code in use.
+ */
+ulg ZLIB_INTERNAL _tr_estimate(deflate_state *s) {
+    ct_data ltree[HEAP_SIZE];       /* literal and length tree */
+    ct_data dtree[2*D_CODES+1];     /* distance tree */
+    tree_desc desc;
+    ulg opt_len = s->opt_len, static_len = s->static_len, dyn;
+    unsigned n, codes = 0;
+
+    for (n = 0; n < L_CODES; n++) {
+        ltree[n].Freq = s->dyn_ltree[n].Freq;
+        codes += ltree[n].Freq != 0;
+    }
+    for (n = 0; n < D_CODES; n++) {
+        dtree[n].Freq = s->dyn_dtree[n].Freq;
+        codes += dtree[n].Freq != 0;
+    }
+    s->opt_len = s->static_len = 0;
+    desc.dyn_tree = ltree;
+    desc.stat_desc = &static_l_desc;
+    build_tree(s, &desc);
+    desc.dyn_tree = dtree;
+    desc.stat_desc = &static_d_desc;
+    build_tree(s, &desc);
+    dyn = s->opt_len + 5 + 5 + 4 + 3 * BL_CODES + 4 * codes;
+    if (dyn > s->static_len)
+        dyn = s->static_len;
+    s->opt_len = opt_len;
+    s->static_len = static_len;
+    return 3 + dyn;
+}
+
+/* ===========================================================================
+ * Add a value on a given number of bits to the local bit buffer bits, with
+ * valid bits in it, writing it to out when it fills. This is send_bits() on
+ * local copies of bi_buf, bi_valid, and the pending pointer, which the
+ * compiler can keep in registers. With a 64-bit bit buffer, length can be up
+ * to 30, for two codes at once.
+ */
+#ifdef BI_BUF64
+#  define put_local(out, w) { \
+    out[0] = (uch)(w); \
+    out[1] = (uch)((w) >> 8); \
+    out[2] = (uch)((w) >> 16); \
+    out[3] = (uch)((w) >> 24); \
+    out[4] = (uch)((w) >> 32); \
+    out[5] = (uch)((w) >> 40); \
+    out[6] = (uch)((w) >> 48); \
+    out[7] = (uch)((w) >> 56); \
+    out += 8; \
+}
+#else
+#  define put_local(out, w) { \
+    out[0] = (uch)(w); \
+    out[1] = (uch)((w) >> 8); \
+    out += 2; \
+}
+#endif
+#ifdef ZLIB_DEBUG
+#  define sent_local(s, length) s->bits_sent += (ulg)(length)
+#else
+#  define sent_local(s, length)
+#endif
+#define send_local(s, value, length) { \
+    bitbuf val = (bitbuf)(value); \
+    int len = length; \
+    sent_local(s, len); \
+    bits |= val << valid; \
+    if (valid >= (int)Buf_size - len) { \
+        put_local(out, bits); \
+        bits = val >> (Buf_size - valid); \
+        valid += len - Buf_size; \
+    } else \
+        valid += len; \
+}
+
+/* ===========================================================================
+ * Send the block data compressed using the given Huffman trees. With a 64-bit
+ * bit buffer, two literals in a row are sent together.
  */
 local void compress_block(deflate_state *s, const ct_data *ltree,
                           const ct_data *dtree) {
@@ -902,50 +1321,81 @@ local void compress_block(deflate_state *s, const ct_data *ltree,
     unsigned sx = 0;    /* running index in symbol buffers */
     unsigned code;      /* the code to send */
     int extra;          /* number of extra bits to send */
+    unsigned sym_next = s->sym_next;
+#ifdef LIT_MEM
+    const ushf *d_buf = s->d_buf;
+    const uchf *l_buf = s->l_buf;
+#else
+    const uchf *sym_buf = s->sym_buf;
+#endif
+    bitbuf bits = s->bi_buf;    /* local bi_buf */
+    int valid = s->bi_valid;    /* local bi_valid */
+    uchf *out = s->pending_buf + s->pending;
 
-    if (s->sym_next != 0) do {
+    if (sym_next != 0) do {
 #ifdef LIT_MEM
-        dist = s->d_buf[sx];
-        lc = s->l_buf[sx++];
+        dist = d_buf[sx];
+        lc = l_buf[sx++];
 #else
-        dist = s->sym_buf[sx++] & 0xff;
-        dist += (unsigned)(s->sym_buf[sx++] & 0xff) << 8;
-        lc = s->sym_buf[sx++];
+        dist = sym_buf[sx++] & 0xff;
+        dist += (unsigned)(sym_buf[sx++] & 0xff) << 8;
+        lc = sym_buf[sx++];
 #endif
         if (dist == 0) {
-            send_code(s, lc, ltree); /* send a literal byte */
             Tracecv(isgraph(lc), (stderr," '%c' ", lc));
+#ifdef BI_BUF64
+#  ifdef LIT_MEM
+            if (sx < sym_next && d_buf[sx] == 0) {
+                code = l_buf[sx++];
+#  else
+            if (sx < sym_next && sym_buf[sx] == 0 && sym_buf[sx + 1] == 0) {
+                code = sym_buf[sx + 2];
+                sx += 3;
+#  endif
+                Tracecv(isgraph(code), (stderr," '%c' ", code));
+                send_local(s, ltree[lc].Code |
+                              (unsigned)ltree[code].Code << ltree[lc].Len,
+                           ltree[lc].Len + ltree[code].Len);
+            } else
+#endif
+            send_local(s, ltree[lc].Code, ltree[lc].Len);   /* literal */
         } else {
             /* Here, lc is the match length - MIN_MATCH */
             code = _length_code[lc];
-            send_code(s, code + LITERALS + 1, ltree);   /* send length code */
+            send_local(s, ltree[code + LITERALS + 1].Code,
+                       ltree[code + LITERALS + 1].Len);     /* length code */
             extra = extra_lbits[code];
             if (extra != 0) {
                 lc -= base_length[code];
-                send_bits(s, lc, extra);       /* send the extra length bits */
+                send_local(s, lc, extra);   /* send the extra length bits */
             }
             dist--; /* dist is now the match distance - 1 */
             code = d_code(dist);
             Assert (code < D_CODES, "bad d_code");
 
-            send_code(s, code, dtree);       /* send the distance code */
+            send_local(s, dtree[code].Code, dtree[code].Len);   /* distance */
             extra = extra_dbits[code];
             if (extra != 0) {
                 dist -= (unsigned)base_dist[code];
-                send_bits(s, dist, extra);   /* send the extra distance bits */
+                send_local(s, dist, extra); /* send the extra distance bits */
             }
         } /* literal or match pair ? */
 
         /* Check for no overlay of pending_buf on needed symbols */
 #ifdef LIT_MEM
-        Assert(s->pending < 2 * (s->lit_bufsize + sx), "pendingBuf overflow");
+        Assert((ulg)(out - s->pending_buf) < 2 * (s->lit_bufsize + sx),
+               "pendingBuf overflow");
 #else
-        Assert(s->pending < s->lit_bufsize + sx, "pendingBuf overflow");
+        Assert((ulg)(out - s->pending_buf) < s->lit_bufsize + sx,
+               "pendingBuf overflow");
 #endif
 
-    } while (sx < s->sym_next);
+    } while (sx < sym_next);
 
-    send_code(s, END_BLOCK, ltree);
+    send_local(s, ltree[END_BLOCK].Code, ltree[END_BLOCK].Len);
+    s->pending = (ulg)(out - s->pending_buf);
+    s->bi_buf = bits;
+    s->bi_valid = valid;
 }
 
 /* ===========================================================================
@@ -988,51 +1438,87 @@ local int detect_data_type(deflate_state *s) {
     return Z_BINARY;
 }
 
+/* ===========================================================================
+ * Set static_len for the current block from the symbol frequencies, without
+ * building the trees. This is used for a block ended by Z_LATENCY_FLUSH with
+ * no more than LATENCY_SHORT symbols, for which dynamic trees would rarely be
+ * chosen, and would take longer to build than the block took to compress.
+ */
+#define LATENCY_SHORT 64
+
+local void static_length(deflate_state *s) {
+    int n;
+    unsigned freq;
+
+    s->static_len = 0;
+    for (n = 0; n < L_CODES; n++)
+        if ((freq = s->dyn_ltree[n].Freq) != 0)
+            s->static_len += (ulg)freq * (static_ltree[n].Len +
+                (n > LITERALS ? extra_lbits[n - LITERALS - 1] : 0));
+    for (n = 0; n < D_CODES; n++)
+        if ((freq = s->dyn_dtree[n].Freq) != 0)
+            s->static_len += (ulg)freq * (static_dtree[n].Len +
+                                          extra_dbits[n]);
+}
+
 /* ===========================================================================
  * Determine the best encoding for the current block: dynamic trees, static
- * trees or store, and write out the encoded block.
+ * trees or store, and return STORED_BLOCK, STATIC_TREES, or DYN_TREES. The
+ * trees are built, and *max_blindex is set for send_all_trees().
  */
-void ZLIB_INTERNAL _tr_flush_block(deflate_state *s, charf *buf,
-                                   ulg stored_len, int last) {
+local int block_type(deflate_state *s, charf *buf, ulg stored_len,
+                     int *max_blindex) {
     ulg opt_lenb, static_lenb; /* opt_len and static_len in bytes */
-    int max_blindex = 0;  /* index of last bit length code of non zero freq */
+#if defined(ZLIB_STATS) && !defined(Z_SOLO)
+    clock_t start = clock();
+#endif
+
+    *max_blindex = 0;
 
     /* Build the Huffman trees unless a stored block is forced */
     if (s->level > 0) {
+        if (s->last_flush == Z_LATENCY_FLUSH &&
+            s->sym_next <= LATENCY_SHORT * SYM_SIZE) {
+            /* Short block ended by Z_LATENCY_FLUSH: static trees or stored */
+            static_length(s);
+            opt_lenb = static_lenb = (s->static_len + 3 + 7) >> 3;
+        } else {
+            /* Construct the literal and distance trees */
+            build_tree(s, (tree_desc *)(&(s->l_desc)));
+            Tracev((stderr, "\nlit data: dyn %ld, stat %ld", s->opt_len,
+                    s->static_len));
+
+            build_tree(s, (tree_desc *)(&(s->d_desc)));
+            Tracev((stderr, "\ndist data: dyn %ld, stat %ld", s->opt_len,
+                    s->static_len));
+            /* At this point, opt_len and static_len are the total bit
+             * lengths of the compressed block data, excluding the tree
+             * representations.
+             */
+
+            /* Build the bit length tree for the above two trees, and get the
+             * index in bl_order of the last bit length code to send.
+             */
+            *max_blindex = build_bl_tree(s);
+#if defined(ZLIB_STATS) && !defined(Z_SOLO)
+            s->tree_ticks += (ulg)(clock() - start);
+#endif
 
-        /* Check if the file is binary or text */
-        if (s->strm->data_type == Z_UNKNOWN)
-            s->strm->data_type = detect_data_type(s);
-
-        /* Construct the literal and distance trees */
-        build_tree(s, (tree_desc *)(&(s->l_desc)));
-        Tracev((stderr, "\nlit data: dyn %ld, stat %ld", s->opt_len,
-                s->static_len));
-
-        build_tree(s, (tree_desc *)(&(s->d_desc)));
-        Tracev((stderr, "\ndist data: dyn %ld, stat %ld", s->opt_len,
-                s->static_len));
-        /* At this point, opt_len and static_len are the total bit lengths of
-         * the compressed block data, excluding the tree representations.
-         */
-
-        /* Build the bit length tree for the above two trees, and get the index
-         * in bl_order of the last bit length code to send.
-         */
-        max_blindex = build_bl_tree(s);
-
-        /* Determine the best encoding. Compute the block lengths in bytes. */
-        opt_lenb = (s->opt_len + 3 + 7) >> 3;
-        static_lenb = (s->static_len + 3 + 7) >> 3;
+            /* Determine the best encoding. Compute the block lengths in
+             * bytes.
+             */
+            opt_lenb = (s->opt_len + 3 + 7) >> 3;
+            static_lenb = (s->static_len + 3 + 7) >> 3;
 
-        Tracev((stderr, "\nopt %lu(%lu) stat %lu(%lu) stored %lu lit %u ",
-                opt_lenb, s->opt_len, static_lenb, s->static_len, stored_len,
-                s->sym_next / 3));
+            Tracev((stderr, "\nopt %lu(%lu) stat %lu(%lu) stored %lu lit %u ",
+                    opt_lenb, s->opt_len, static_lenb, s->static_len,
+                    stored_len, s->sym_next / 3));
 
 #ifndef FORCE_STATIC
-        if (static_lenb <= opt_lenb || s->strategy == Z_FIXED)
+            if (static_lenb <= opt_lenb || s->strategy == Z_FIXED)
 #endif
-            opt_lenb = static_lenb;
+                opt_lenb = static_lenb;
+        }
 
     } else {
         Assert(buf != (char*)0, "lost buf");
@@ -1051,16 +1537,195 @@ void ZLIB_INTERNAL _tr_flush_block(deflate_state *s, charf *buf,
          * successful. If LIT_BUFSIZE <= WSIZE, it is never too late to
          * transform a block into a stored block.
          */
-        _tr_stored_block(s, buf, stored_len, last);
+        return STORED_BLOCK;
+    }
+    return static_lenb == opt_lenb ? STATIC_TREES : DYN_TREES;
+}
+
+/* ===========================================================================
+ * Return the bits that the current block would take if it were sent now. The
+ * frequencies are saved and restored, and the lengths cleared, since building
+ * the trees writes the codes over the frequencies and adds to the bit length
+ * tree frequencies and to the lengths.
+ */
+local ulg block_bits(deflate_state *s, charf *buf, ulg stored_len) {
+    ush freq[L_CODES + D_CODES];
+    int max_blindex, n;
+    ulg bits;
+
+    for (n = 0; n < L_CODES; n++) freq[n] = s->dyn_ltree[n].Freq;
+    for (n = 0; n < D_CODES; n++) freq[L_CODES + n] = s->dyn_dtree[n].Freq;
+    s->opt_len = s->static_len = 0L;
+    switch (block_type(s, buf, stored_len, &max_blindex)) {
+    case STORED_BLOCK:
+        bits = 3 + ((8 - ((s->bi_valid + 3) & 7)) & 7) + 32 +
+               (stored_len << 3);
+        break;
+    case STATIC_TREES:
+        bits = 3 + s->static_len;
+        break;
+    default:
+        bits = 3 + s->opt_len;
+    }
+    for (n = 0; n < L_CODES; n++) s->dyn_ltree[n].Freq = freq[n];
+    for (n = 0; n < D_CODES; n++) s->dyn_dtree[n].Freq = freq[L_CODES + n];
+    for (n = 0; n < BL_CODES; n++) s->bl_tree[n].Freq = 0;
+    s->opt_len = s->static_len = 0L;
+    return bits;
+}
+
+/* ===========================================================================
+ * Return the sym_next of the longest start of the current block that fits as
+ * the last block, searching between fit_ok, which fits, and sym_next, which
+ * does not. stored_len is the input covered by all of the symbols. The
+ * frequencies are left as they were.
+ */
+local uInt fit_search(deflate_state *s, charf *buf, ulg stored_len) {
+    uInt lo = s->fit_ok, hi = s->sym_next, full = s->sym_next, mid;
+    uInt cur = hi;              /* the frequencies are for sym_buf up to cur */
+
+    while (hi - lo > SYM_SIZE) {
+        mid = lo + (hi - lo) / (SYM_SIZE << 1) * SYM_SIZE;
+        if (mid < cur) {
+            s->sym_next = cur;
+            stored_len -= tally_tail(s, mid, -1);
+        } else {
+            s->sym_next = mid;
+            stored_len += tally_tail(s, cur, 1);
+        }
+        cur = mid;
+        if (fit_used(s) + block_bits(s, buf, stored_len) <= s->fit_room)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    s->sym_next = full;
+    tally_tail(s, cur, 1);
+    return lo;
+}
+
+/* ===========================================================================
+ * For deflateFitBlock(), decide whether to end the current block, once
+ * sym_next has reached sym_end. If the block so far fits as the last block,
+ * set sym_end to the next check and return false, or if sym_buf is full,
+ * return true to send the block as is, if an empty last block will still fit
+ * after it. Otherwise find the longest start of the block that fits, and set
+ * up _tr_flush_block() to send that as the last block. The checks are spaced
+ * by fit_step(), so the search only covers the symbols since the last check.
+ */
+local int fit_check(deflate_state *s) {
+    charf *buf = s->block_start >= 0L ?
+                 (charf *)&s->window[(unsigned)s->block_start] : Z_NULL;
+    ulg len = s->fit_len + tally_tail(s, s->fit_ok, 0);
+    ulg bits = block_bits(s, buf, len);
+
+    if (fit_used(s) + bits <= s->fit_room) {
+        if (s->sym_next >= s->sym_max) {
+            if (fit_used(s) + bits + FIT_EMPTY > s->fit_room) {
+                s->fit_sym = s->sym_next;
+                s->fit = FIT_END;
+            }
+            return 1;
+        }
+        s->fit_ok = s->sym_next;
+        s->fit_len = len;
+        fit_step(s, bits);
+        return 0;
+    }
+    s->fit_sym = fit_search(s, buf, len);
+    s->fit = FIT_END;
+    return 1;
+}
+
+/* ===========================================================================
+ * Determine the best encoding for the current block: dynamic trees, static
+ * trees or store, and write out the encoded block.
+ */
+void ZLIB_INTERNAL _tr_flush_block(deflate_state *s, charf *buf,
+                                   ulg stored_len, int last) {
+    int max_blindex;      /* index of last bit length code of non zero freq */
+#ifdef ZLIB_STATS
+    ulg matches = 0;
+    int n;
+#endif
+    unsigned split = s->sym_split;  /* where to end the block, if not 0 */
+
+    /* For deflateFitBlock(), end the stream with as much as fits */
+    if (s->fit == FIT_ON && last) {
+        s->fit_sym = fit_used(s) + block_bits(s, buf, stored_len) <=
+                     s->fit_room ? s->sym_next :
+                     fit_search(s, buf, stored_len);
+        s->fit = FIT_END;
+    }
+    if (s->fit == FIT_END) {
+        stored_len -= tally_tail(s, s->fit_sym, -1);
+        s->sym_next = s->fit_sym;
+        s->fit_rest = (ulg)((long)s->strstart + (long)s->lookahead -
+                            s->block_start - (long)stored_len) +
+                      s->strm->avail_in;
+        s->fit = FIT_DONE;
+        last = 1;
+    }
+
+    /* Hold back the symbols past an early end of the block */
+    s->split_tail = 0;
+    if (split && !last) {
+        unsigned keep = s->sym_next - split;
+
+        Assert(keep <= SPLIT_STEP * SYM_SIZE, "split tail too long");
+        s->split_tail = tally_tail(s, split, -1);
+#ifdef LIT_MEM
+        zmemcpy(s->split_buf, (Bytef *)(s->d_buf + split), keep << 1);
+        zmemcpy(s->split_buf + (keep << 1), s->l_buf + split, keep);
+#else
+        zmemcpy(s->split_buf, s->sym_buf + split, keep);
+#endif
+        s->split_keep = keep;
+        s->sym_next = split;
+        stored_len -= s->split_tail;
+    }
+
+    if (s->level > 0) {
+
+        /* Check if the file is binary or text */
+        if (s->strm->data_type == Z_UNKNOWN)
+            s->strm->data_type = detect_data_type(s);
 
-    } else if (static_lenb == opt_lenb) {
+#ifdef ZLIB_STATS
+        /* Count the symbols from their frequencies. Each input byte in the
+         * block is either a literal or is in a match.
+         */
+        for (n = LITERALS + 1; n < L_CODES; n++)
+            matches += s->dyn_ltree[n].Freq;
+#  ifdef LIT_MEM
+        s->stats.literals += s->sym_next - matches;
+        s->stats.match_bytes += stored_len - (s->sym_next - matches);
+#  else
+        s->stats.literals += s->sym_next / 3 - matches;
+        s->stats.match_bytes += stored_len - (s->sym_next / 3 - matches);
+#  endif
+        s->stats.matches += matches;
+#endif
+    }
+
+    switch (block_type(s, buf, stored_len, &max_blindex)) {
+    case STORED_BLOCK:
+        Probe3(flush_block, stored_len, 0, last);
+        _tr_stored_block(s, buf, stored_len, last);
+        break;
+    case STATIC_TREES:
+        Stat(s->stats.fixed++);
+        Probe3(flush_block, stored_len, 1, last);
         send_bits(s, (STATIC_TREES<<1) + last, 3);
         compress_block(s, (const ct_data *)static_ltree,
                        (const ct_data *)static_dtree);
 #ifdef ZLIB_DEBUG
         s->compressed_len += 3 + s->static_len;
 #endif
-    } else {
+        break;
+    default:
+        Stat(s->stats.dynamic++);
+        Probe3(flush_block, stored_len, 2, last);
         send_bits(s, (DYN_TREES<<1) + last, 3);
         send_all_trees(s, s->l_desc.max_code + 1, s->d_desc.max_code + 1,
                        max_blindex + 1);
@@ -1086,6 +1751,51 @@ void ZLIB_INTERNAL _tr_flush_block(deflate_state *s, charf *buf,
            s->compressed_len - 7*last));
 }
 
+/* ===========================================================================
+ * Tally the n literals at buf, for deflate_huff(). n must not take sym_next
+ * past sym_end. Return true if the current block must be flushed. The
+ * literals are counted four at a time in separate tables, so that runs of the
+ * same byte do not wait on each other's increments.
+ */
+int ZLIB_INTERNAL _tr_tally_lits(deflate_state *s, const Bytef *buf,
+                                 unsigned n) {
+    ush count[3][LITERALS];     /* counts for three of every four literals */
+    ct_data *ltree = s->dyn_ltree;
+    unsigned i, c;
+#ifdef LIT_MEM
+    ushf *d = s->d_buf + s->sym_next;
+    uchf *l = s->l_buf + s->sym_next;
+#else
+    uchf *sym = s->sym_buf + s->sym_next;
+#endif
+
+    Assert(s->sym_next + n * SYM_SIZE <= s->sym_end, "too many literals");
+#ifdef LIT_MEM
+    zmemzero((Bytef *)d, n * sizeof(ush));
+    zmemcpy(l, buf, n);
+#else
+    for (i = 0; i < n; i++) {
+        sym[0] = 0;
+        sym[1] = 0;
+        sym[2] = buf[i];
+        sym += 3;
+    }
+#endif
+    zmemzero(count, sizeof(count));
+    for (i = 0; i + 4 <= n; i += 4) {
+        ltree[buf[i]].Freq++;
+        count[0][buf[i + 1]]++;
+        count[1][buf[i + 2]]++;
+        count[2][buf[i + 3]]++;
+    }
+    for (; i < n; i++)
+        ltree[buf[i]].Freq++;
+    for (c = 0; c < LITERALS; c++)
+        ltree[c].Freq += count[0][c] + count[1][c] + count[2][c];
+    s->sym_next += n * SYM_SIZE;
+    return s->sym_next == s->sym_end && _tr_block_end(s);
+}
+
 /* ===========================================================================
  * Save the match info and tally the frequency counts. Return true if
  * the current block must be flushed.
@@ -1113,5 +1823,5 @@ int ZLIB_INTERNAL _tr_tally(deflate_state *s, unsigned dist, unsigned lc) {
         s->dyn_ltree[_length_code[lc] + LITERALS + 1].Freq++;
         s->dyn_dtree[d_code(dist)].Freq++;
     }
-    return (s->sym_next == s->sym_end);
+    return (s->sym_next == s->sym_end && _tr_block_end(s));
 }
@@ -5,8 +5,62 @@
 
 /* @(#) $Id$ */
 
-#define ZLIB_INTERNAL
-#include "zlib.h"
+#include "zutil.h"
+
+/* ===========================================================================
+     Decompress source to dest with stream, which has been initialized or
+   reset.  *destLen and *sourceLen are updated as for uncompress2().
+ */
+static int uncompress_stream(z_streamp stream, Bytef *dest, uLongf *destLen,
+                             const Bytef *source, uLong *sourceLen) {
+    int err;
+    const uInt max = (uInt)-1;
+    uLong len, left;
+    Byte buf[1];    /* for detection of incomplete stream when *destLen == 0 */
+
+    len = *sourceLen;
+    if (*destLen) {
+        left = *destLen;
+        if (left > max) return Z_MEM_ERROR; // Check for potential overflow
+        *destLen = 0;
+    } else {
+        left = 1;
+        dest = buf;
+    }
+
+    stream->next_in = (z_const Bytef *)source;
+    stream->avail_in = 0;
+    stream->next_out = dest;
+    stream->avail_out = 0;
+
+    do {
+        if (stream->avail_out == 0) {
+            stream->avail_out = left > (uLong)max ? max : (uInt)left;
+            if (left < (uLong)stream->avail_out) return Z_MEM_ERROR; // Check for potential underflow
+            left -= stream->avail_out;
+        }
+        if (stream->avail_in == 0) {
+            stream->avail_in = len > (uLong)max ? max : (uInt)len;
+            if (len < (uLong)stream->avail_in) return Z_MEM_ERROR; // Check for potential underflow
+            len -= stream->avail_in;
+        }
+        /* with all of the input and output space provided, Z_FINISH lets
+           inflate() copy matches directly from dest, and so never allocate
+           or update a window, if the stream completes */
+        err = inflate(stream, left == 0 && len == 0 ? Z_FINISH : Z_NO_FLUSH);
+    } while (err == Z_OK);
+
+    *sourceLen -= len + stream->avail_in;
+    if (dest != buf)
+        *destLen = stream->total_out;
+    else if (stream->total_out && err == Z_BUF_ERROR)
+        left = 1;
+
+    return err == Z_STREAM_END ? Z_OK :
+           err == Z_NEED_DICT ? Z_DATA_ERROR  :
+           err == Z_BUF_ERROR && left + stream->avail_out ? Z_DATA_ERROR :
+           err;
+}
 
 /* ===========================================================================
      Decompresses the source buffer into the destination buffer.  *sourceLen is
@@ -27,60 +81,60 @@
 int ZEXPORT uncompress2(Bytef *dest, uLongf *destLen, const Bytef *source,
                         uLong *sourceLen) {
     z_stream stream;
+    z_poolp cache;
     int err;
-    const uInt max = (uInt)-1;
-    uLong len, left;
-    Byte buf[1];    /* for detection of incomplete stream when *destLen == 0 */
 
     if (dest == NULL || destLen == NULL || source == NULL || sourceLen == NULL) return Z_STREAM_ERROR;
 
-    len = *sourceLen;
-    if (*destLen) {
-        left = *destLen;
-        if (left > max) return Z_MEM_ERROR; // Check for potential overflow
-        *destLen = 0;
-    } else {
-        left = 1;
-        dest = buf;
-    }
-
-    stream.next_in = (z_const Bytef *)source;
+    stream.next_in = Z_NULL;
     stream.avail_in = 0;
     stream.zalloc = (alloc_func)0;
     stream.zfree = (free_func)0;
     stream.opaque = (voidpf)0;
 
-    err = inflateInit(&stream);
+    /* reuse a state from this thread's cache if zlibStreamCache() enabled */
+    cache = z_stream_cache();
+    err = inflatePoolInit2(&stream, cache, DEF_WBITS);
     if (err != Z_OK) return err;
+    err = uncompress_stream(&stream, dest, destLen, source, sourceLen);
+    inflatePoolEnd(&stream, cache);
+    return err;
+}
 
-    stream.next_out = dest;
-    stream.avail_out = 0;
+/* ===========================================================================
+     Decompress each buffer with one inflate state, reset between buffers.
+ */
+int ZEXPORT uncompressBatch(z_bufp bufs, unsigned count) {
+    z_stream stream;
+    int err, ret;
+    unsigned n;
 
-    do {
-        if (stream.avail_out == 0) {
-            stream.avail_out = left > (uLong)max ? max : (uInt)left;
-            if (left < (uLong)stream.avail_out) return Z_MEM_ERROR; // Check for potential underflow
-            left -= stream.avail_out;
-        }
-        if (stream.avail_in == 0) {
-            stream.avail_in = len > (uLong)max ? max : (uInt)len;
-            if (len < (uLong)stream.avail_in) return Z_MEM_ERROR; // Check for potential underflow
-            len -= stream.avail_in;
-        }
-        err = inflate(&stream, Z_NO_FLUSH);
-    } while (err == Z_OK);
+    if (bufs == NULL && count)
+        return Z_STREAM_ERROR;
 
-    *sourceLen -= len + stream.avail_in;
-    if (dest != buf)
-        *destLen = stream.total_out;
-    else if (stream.total_out && err == Z_BUF_ERROR)
-        left = 1;
+    stream.next_in = Z_NULL;
+    stream.avail_in = 0;
+    stream.zalloc = (alloc_func)0;
+    stream.zfree = (free_func)0;
+    stream.opaque = (voidpf)0;
 
+    err = inflateInit(&stream);
+    if (err != Z_OK) return err;
+    ret = Z_OK;
+    for (n = 0; n < count; n++) {
+        if (n)
+            inflateReset(&stream);
+        if (bufs[n].dest == NULL || bufs[n].source == NULL)
+            bufs[n].err = Z_STREAM_ERROR;
+        else
+            bufs[n].err = uncompress_stream(&stream, bufs[n].dest,
+                                            &bufs[n].destLen, bufs[n].source,
+                                            &bufs[n].sourceLen);
+        if (ret == Z_OK)
+            ret = bufs[n].err;
+    }
     inflateEnd(&stream);
-    return err == Z_STREAM_END ? Z_OK :
-           err == Z_NEED_DICT ? Z_DATA_ERROR  :
-           err == Z_BUF_ERROR && left + stream.avail_out ? Z_DATA_ERROR :
-           err;
+    return ret;
 }
 
 int ZEXPORT uncompress(Bytef *dest, uLongf *destLen, const Bytef *source,
@@ -29,41 +29,79 @@
 #  define adler32               z_adler32
 #  define adler32_combine       z_adler32_combine
 #  define adler32_combine64     z_adler32_combine64
+#  define adler32_combine_vec   z_adler32_combine_vec
 #  define adler32_z             z_adler32_z
 #  ifndef Z_SOLO
 #    define compress              z_compress
 #    define compress2             z_compress2
+#    define compressAsync         z_compressAsync
+#    define compressBatch         z_compressBatch
 #    define compressBound         z_compressBound
+#    define compressJoin          z_compressJoin
+#    define compressParallel      z_compressParallel
+#    define compressParallelBound z_compressParallelBound
 #  endif
 #  define crc32                 z_crc32
 #  define crc32_combine         z_crc32_combine
 #  define crc32_combine64       z_crc32_combine64
+#  define crc32_combine_ctx     z_crc32_combine_ctx
 #  define crc32_combine_gen     z_crc32_combine_gen
 #  define crc32_combine_gen64   z_crc32_combine_gen64
+#  define crc32_combine_init    z_crc32_combine_init
 #  define crc32_combine_op      z_crc32_combine_op
+#  define crc32_combine_vec     z_crc32_combine_vec
 #  define crc32_z               z_crc32_z
 #  define deflate               z_deflate
 #  define deflateBound          z_deflateBound
+#  define deflateCompileDictionary z_deflateCompileDictionary
 #  define deflateCopy           z_deflateCopy
 #  define deflateEnd            z_deflateEnd
+#  define deflateEstimate       z_deflateEstimate
+#  define deflateFitBlock       z_deflateFitBlock
+#  define deflateFootprint      z_deflateFootprint
+#  define deflateFork           z_deflateFork
+#  define deflateFreeDictionary z_deflateFreeDictionary
 #  define deflateGetDictionary  z_deflateGetDictionary
+#  define deflateGetStats       z_deflateGetStats
+#  define deflateHash           z_deflateHash
+#  define deflateIdle           z_deflateIdle
 #  define deflateInit           z_deflateInit
 #  define deflateInit2          z_deflateInit2
 #  define deflateInit2_         z_deflateInit2_
+#  define deflateInit3          z_deflateInit3
+#  define deflateInit3_         z_deflateInit3_
+#  define deflateInitCompact    z_deflateInitCompact
+#  define deflateInitCompact_   z_deflateInitCompact_
 #  define deflateInit_          z_deflateInit_
+#  define deflateMemory         z_deflateMemory
+#  define deflateOneShot        z_deflateOneShot
+#  define deflateOffload        z_deflateOffload
 #  define deflateParams         z_deflateParams
 #  define deflatePending        z_deflatePending
+#  define deflatePoolEnd        z_deflatePoolEnd
+#  define deflatePoolInit2      z_deflatePoolInit2
+#  define deflatePoolInit2_     z_deflatePoolInit2_
 #  define deflatePrime          z_deflatePrime
 #  define deflateReset          z_deflateReset
 #  define deflateResetKeep      z_deflateResetKeep
 #  define deflateSetDictionary  z_deflateSetDictionary
 #  define deflateSetHeader      z_deflateSetHeader
+#  define deflateThroughput     z_deflateThroughput
 #  define deflateTune           z_deflateTune
+#  define deflateUseDictionary  z_deflateUseDictionary
 #  define deflate_copyright     z_deflate_copyright
 #  define get_crc_table         z_get_crc_table
 #  ifndef Z_SOLO
+#    define gz_async_end          z_gz_async_end
+#    define gz_async_read         z_gz_async_read
+#    define gz_async_start        z_gz_async_start
+#    define gz_async_wait         z_gz_async_wait
+#    define gz_async_write        z_gz_async_write
+#    define gz_autosize           z_gz_autosize
 #    define gz_error              z_gz_error
+#    define gz_index_seek         z_gz_index_seek
 #    define gz_intmax             z_gz_intmax
+#    define gz_seekfd             z_gz_seekfd
 #    define gz_strwinerror        z_gz_strwinerror
 #    define gzbuffer              z_gzbuffer
 #    define gzclearerr            z_gzclearerr
@@ -79,7 +117,12 @@
 #    define gzfwrite              z_gzfwrite
 #    define gzgetc                z_gzgetc
 #    define gzgetc_               z_gzgetc_
+#    define gzgetline             z_gzgetline
 #    define gzgets                z_gzgets
+#    define gzindex_build         z_gzindex_build
+#    define gzindex_load          z_gzindex_load
+#    define gzindex_save          z_gzindex_save
+#    define gzipNormalize         z_gzipNormalize
 #    define gzoffset              z_gzoffset
 #    define gzoffset64            z_gzoffset64
 #    define gzopen                z_gzopen
@@ -91,53 +134,84 @@
 #    define gzputc                z_gzputc
 #    define gzputs                z_gzputs
 #    define gzread                z_gzread
+#    define gzreadv               z_gzreadv
 #    define gzrewind              z_gzrewind
 #    define gzseek                z_gzseek
 #    define gzseek64              z_gzseek64
+#    define gzsetasync            z_gzsetasync
+#    define gzsetblock            z_gzsetblock
 #    define gzsetparams           z_gzsetparams
 #    define gztell                z_gztell
 #    define gztell64              z_gztell64
+#    define gzuncompressParallel  z_gzuncompressParallel
 #    define gzungetc              z_gzungetc
 #    define gzvprintf             z_gzvprintf
 #    define gzwrite               z_gzwrite
+#    define gzwritev              z_gzwritev
 #  endif
 #  define inflate               z_inflate
 #  define inflateBack           z_inflateBack
 #  define inflateBackEnd        z_inflateBackEnd
 #  define inflateBackInit       z_inflateBackInit
 #  define inflateBackInit_      z_inflateBackInit_
+#  define inflateBackRing       z_inflateBackRing
 #  define inflateCodesUsed      z_inflateCodesUsed
 #  define inflateCopy           z_inflateCopy
 #  define inflateEnd            z_inflateEnd
+#  define inflateFork           z_inflateFork
 #  define inflateGetDictionary  z_inflateGetDictionary
 #  define inflateGetHeader      z_inflateGetHeader
+#  define inflateGetStats       z_inflateGetStats
 #  define inflateInit           z_inflateInit
 #  define inflateInit2          z_inflateInit2
 #  define inflateInit2_         z_inflateInit2_
 #  define inflateInit_          z_inflateInit_
 #  define inflateMark           z_inflateMark
+#  define inflateOffload        z_inflateOffload
+#  define inflatePoolEnd        z_inflatePoolEnd
+#  define inflatePoolInit2      z_inflatePoolInit2
+#  define inflatePoolInit2_     z_inflatePoolInit2_
 #  define inflatePrime          z_inflatePrime
 #  define inflateReset          z_inflateReset
 #  define inflateReset2         z_inflateReset2
 #  define inflateResetKeep      z_inflateResetKeep
 #  define inflateSetDictionary  z_inflateSetDictionary
+#  define inflateSlack          z_inflateSlack
 #  define inflateSync           z_inflateSync
 #  define inflateSyncPoint      z_inflateSyncPoint
+#  define inflateSyncScan       z_inflateSyncScan
+#  define inflateTune           z_inflateTune
 #  define inflateUndermine      z_inflateUndermine
+#  define inflateUseDictionary  z_inflateUseDictionary
 #  define inflateValidate       z_inflateValidate
+#  define inflateVerify         z_inflateVerify
 #  define inflate_copyright     z_inflate_copyright
 #  define inflate_fast          z_inflate_fast
 #  define inflate_table         z_inflate_table
 #  ifndef Z_SOLO
+#    define par_cpus              z_par_cpus
+#    define par_inflate           z_par_inflate
+#    define par_run               z_par_run
 #    define uncompress            z_uncompress
 #    define uncompress2           z_uncompress2
+#    define uncompressAsync       z_uncompressAsync
+#    define uncompressBatch       z_uncompressBatch
 #  endif
 #  define zError                z_zError
 #  ifndef Z_SOLO
 #    define zcalloc               z_zcalloc
 #    define zcfree                z_zcfree
+#    define zlibAsyncCreate       z_zlibAsyncCreate
+#    define zlibAsyncDestroy      z_zlibAsyncDestroy
+#    define zlibAsyncFd           z_zlibAsyncFd
+#    define zlibAsyncReap         z_zlibAsyncReap
+#    define zlibExecutor          z_zlibExecutor
+#    define zlibWorkers           z_zlibWorkers
 #  endif
 #  define zlibCompileFlags      z_zlibCompileFlags
+#  define zlibPoolCreate        z_zlibPoolCreate
+#  define zlibPoolDestroy       z_zlibPoolDestroy
+#  define zlibStreamCache       z_zlibStreamCache
 #  define zlibVersion           z_zlibVersion
 
 /* all zlib typedefs in zlib.h and zconf.h */
@@ -152,6 +226,7 @@
 #  define gz_header             z_gz_header
 #  define gz_headerp            z_gz_headerp
 #  define in_func               z_in_func
+#  define in_vec_func           z_in_vec_func
 #  define intf                  z_intf
 #  define out_func              z_out_func
 #  define uInt                  z_uInt
@@ -161,10 +236,28 @@
 #  define voidp                 z_voidp
 #  define voidpc                z_voidpc
 #  define voidpf                z_voidpf
+#  define z_asyncp              z_z_asyncp
+#  define z_deflate_config      z_z_deflate_config
+#  define z_dictp               z_z_dictp
+#  define z_executor            z_z_executor
+#  define z_iovec               z_z_iovec
+#  define z_job                 z_z_job
+#  define z_offload             z_z_offload
+#  define z_poolp               z_z_poolp
+#  define z_run_func            z_z_run_func
+#  define z_stats               z_z_stats
 
 /* all zlib structs in zlib.h and zconf.h */
 #  define gz_header_s           z_gz_header_s
 #  define internal_state        z_internal_state
+#  define z_async_s             z_z_async_s
+#  define z_deflate_config_s    z_z_deflate_config_s
+#  define z_dict_s              z_z_dict_s
+#  define z_iovec_s             z_z_iovec_s
+#  define z_job_s               z_z_job_s
+#  define z_offload_s           z_z_offload_s
+#  define z_pool_s              z_z_pool_s
+#  define z_stats_s             z_z_stats_s
 
 #endif
 
@@ -107,6 +107,9 @@ typedef struct z_stream_s {
 
 typedef z_stream FAR *z_streamp;
 
+typedef struct z_pool_s FAR *z_poolp;  /* opaque, see zlibPoolCreate() */
+typedef struct z_dict_s FAR *z_dictp;  /* see deflateCompileDictionary() */
+
 /*
      gzip header information passed to and from zlib routines.  See RFC 1952
   for more details on the meanings of these fields.
@@ -172,6 +175,7 @@ typedef gz_header FAR *gz_headerp;
 #define Z_FINISH        4
 #define Z_BLOCK         5
 #define Z_TREES         6
+#define Z_LATENCY_FLUSH 7
 /* Allowed flush values; see deflate() and inflate() below for details */
 
 #define Z_OK            0
@@ -190,6 +194,7 @@ typedef gz_header FAR *gz_headerp;
 #define Z_NO_COMPRESSION         0
 #define Z_BEST_SPEED             1
 #define Z_BEST_COMPRESSION       9
+#define Z_OPTIMAL_COMPRESSION   10
 #define Z_DEFAULT_COMPRESSION  (-1)
 /* compression levels */
 
@@ -197,9 +202,14 @@ typedef gz_header FAR *gz_headerp;
 #define Z_HUFFMAN_ONLY        2
 #define Z_RLE                 3
 #define Z_FIXED               4
+#define Z_QUICK               5
 #define Z_DEFAULT_STRATEGY    0
 /* compression strategy; see deflateInit2() below for details */
 
+#define Z_HASH_SHIFT          0
+#define Z_HASH_MULTIPLY       1
+/* string hash function; see deflateHash() below for details */
+
 #define Z_BINARY   0
 #define Z_TEXT     1
 #define Z_ASCII    Z_TEXT   /* for compatibility with 1.2.2 and earlier */
@@ -236,7 +246,12 @@ ZEXTERN int ZEXPORT deflateInit(z_streamp strm, int level);
    1 gives best speed, 9 gives best compression, 0 gives no compression at all
    (the input data is simply copied a block at a time).  Z_DEFAULT_COMPRESSION
    requests a default compromise between speed and compression (currently
-   equivalent to level 6).
+   equivalent to level 6).  Level 10, Z_OPTIMAL_COMPRESSION, is for data that
+   is compressed once and decompressed many times.  It costs many times the
+   compression time of level 9, and about 400K more memory, to find the
+   sequence of literals and matches that codes in the fewest bits, usually a
+   few percent smaller than level 9.  Its speed and compression can be traded
+   using deflateTune().
 
      deflateInit returns Z_OK if success, Z_MEM_ERROR if there was not enough
    memory, Z_STREAM_ERROR if level is not a valid compression level, or
@@ -316,6 +331,19 @@ ZEXTERN int ZEXPORT deflate(z_streamp strm, int flush);
   random access is desired.  Using Z_FULL_FLUSH too often can seriously degrade
   compression.
 
+    If flush is set to Z_LATENCY_FLUSH, all output is flushed and aligned on a
+  byte boundary as with Z_SYNC_FLUSH, but with less overhead for applications
+  that flush after every small message.  No marker is added if the completed
+  block already ends on a byte boundary, and one to three empty fixed codes
+  blocks (10 bits each) are used instead of the empty stored block when that
+  takes fewer bits, saving 1.5 bytes per flush on average.  A short block
+  ended by Z_LATENCY_FLUSH is sent with the fixed codes, or stored, without
+  building the dynamic Huffman trees, which would take most of the time spent
+  on small messages for little or no gain.  The output therefore does not
+  always end with the four bytes 00 00 ff ff, as some protocols require (such
+  as the permessage-deflate WebSocket extension, which strips them), and it is
+  not found by inflateSync().  Those should use Z_SYNC_FLUSH.
+
     If deflate returns with avail_out == 0, this function must be called again
   with the same value of the flush parameter and more output space (updated
   avail_out), until the flush is complete (deflate returns with non-zero
@@ -601,7 +629,12 @@ ZEXTERN int ZEXPORT deflateInit2(z_streamp strm,
    the correctness of the compressed output, even if it is not set optimally
    for the given data.  Z_FIXED uses the default string matching, but prevents
    the use of dynamic Huffman codes, allowing for a simpler decoder for special
-   applications.
+   applications.  Z_QUICK is the fastest strategy that looks for matches.  It
+   checks only the most recent string with the same hash for a match, does not
+   insert strings inside matches into the hash table, and writes fixed Huffman
+   codes as it goes.  It can be up to twice as fast as level 1, for somewhat
+   less compression.  Any level other than zero gives the same result with
+   Z_QUICK.
 
      deflateInit2 returns Z_OK if success, Z_MEM_ERROR if there was not enough
    memory, Z_STREAM_ERROR if any parameter is invalid (such as an invalid
@@ -677,6 +710,50 @@ ZEXTERN int ZEXPORT deflateGetDictionary(z_streamp strm,
    stream state is inconsistent.
 */
 
+ZEXTERN int ZEXPORT deflateCompileDictionary(z_streamp strm,
+                                             const Bytef *dictionary,
+                                             uInt  dictLength,
+                                             z_dictp *dict);
+/*
+     Set the dictionary for strm with deflateSetDictionary(), and also save the
+   resulting window and hash tables in a new compiled dictionary returned in
+   *dict.  deflateUseDictionary() can then set the same dictionary for another
+   stream with a few memory copies, instead of inserting each string of the
+   dictionary into the hash tables again.  That helps an application that
+   compresses many short messages with the same dictionary.  strm must not
+   have been given any input or dictionary since deflateInit2() or
+   deflateReset().  The compiled dictionary is allocated with the zalloc of
+   strm, is not changed after this call, and so can be used by any number of
+   streams at once, in any threads.
+
+     deflateCompileDictionary returns Z_OK on success, Z_MEM_ERROR if there was
+   not enough memory for the compiled dictionary, in which case the dictionary
+   is still set for strm, or Z_STREAM_ERROR if a parameter is invalid or the
+   stream state is not as described above.
+*/
+
+ZEXTERN int ZEXPORT deflateUseDictionary(z_streamp strm, z_dictp dict);
+/*
+     Set the dictionary compiled by deflateCompileDictionary() for strm, with
+   the same result as deflateSetDictionary() with that dictionary, including
+   the value of strm->adler.  strm must have the same windowBits, memLevel,
+   and deflateHash() setting as the stream that compiled the dictionary, and
+   must not have been given any input or dictionary since deflateInit2() or
+   deflateReset().  The compression level and strategy may differ.
+
+     deflateUseDictionary returns Z_OK on success, or Z_STREAM_ERROR if the
+   parameters of strm do not match, the stream is gzip, or the stream state
+   is not as described above.
+*/
+
+ZEXTERN void ZEXPORT deflateFreeDictionary(z_dictp dict);
+/*
+     Free a dictionary made by deflateCompileDictionary(), using the zfree and
+   opaque of the stream that made it.  The dictionary must not be in use by a
+   deflateUseDictionary() or inflateUseDictionary() call.  Streams that have
+   already used it do not refer to it further.  dict may be Z_NULL.
+*/
+
 ZEXTERN int ZEXPORT deflateCopy(z_streamp dest,
                                 z_streamp source);
 /*
@@ -695,6 +772,31 @@ ZEXTERN int ZEXPORT deflateCopy(z_streamp dest,
    destination.
 */
 
+ZEXTERN int ZEXPORT deflateFork(z_streamp dest,
+                                z_streamp source);
+/*
+     Sets the destination stream as a copy of the source stream, as for
+   deflateCopy(), but with the sliding window, hash tables, and pending output
+   shared between the two streams instead of copied.  The shared buffers are
+   copied only when one of the streams next needs to change them, which is on
+   the next call of deflate(), deflateParams(), deflatePrime(),
+   deflateReset(), deflateSetDictionary(), or deflateUseDictionary() for that
+   stream.  The last stream left sharing the buffers takes them back without a
+   copy.  Forking then costs about the size of a z_stream and the small
+   compression state, regardless of the window and memory sizes, which is
+   useful when many forks are made and most are discarded without being used,
+   or when the source is discarded right after the fork.  At level 10 the
+   match data for the current input is copied as for deflateCopy().
+
+     deflateFork returns Z_OK if success, Z_MEM_ERROR if there was not enough
+   memory, Z_STREAM_ERROR if the source stream state was inconsistent (such as
+   zalloc being Z_NULL).  msg is left unchanged in both source and
+   destination.  Each of the functions above can return Z_MEM_ERROR for a
+   forked stream, before doing anything else, if there is not enough memory
+   for the copy of the buffers, in which case the stream is left unchanged.
+   The streams are freed with deflateEnd(), in any order.
+*/
+
 ZEXTERN int ZEXPORT deflateReset(z_streamp strm);
 /*
      This function is equivalent to deflateEnd followed by deflateInit, but
@@ -718,7 +820,7 @@ ZEXTERN int ZEXPORT deflateParams(z_streamp strm,
    strategy is changed, and if there have been any deflate() calls since the
    state was initialized or reset, then the input available so far is
    compressed with the old level and strategy using deflate(strm, Z_BLOCK).
-   There are three approaches for the compression levels 0, 1..3, and 4..9
+   There are four approaches for the compression levels 0, 1..3, 4..9, and 10
    respectively.  The new level and strategy will take effect at the next call
    of deflate().
 
@@ -736,7 +838,8 @@ ZEXTERN int ZEXPORT deflateParams(z_streamp strm,
    applied to the data compressed after deflateParams().
 
      deflateParams returns Z_OK on success, Z_STREAM_ERROR if the source stream
-   state was inconsistent or if a parameter was invalid, or Z_BUF_ERROR if
+   state was inconsistent or if a parameter was invalid, Z_MEM_ERROR if there
+   was not enough memory to change to level 10, or Z_BUF_ERROR if
    there was not enough output space to complete the compression of the
    available input data before a change in the strategy or approach.  Note that
    in the case of a Z_BUF_ERROR, the parameters are not changed.  A return
@@ -757,10 +860,240 @@ ZEXTERN int ZEXPORT deflateTune(z_streamp strm,
    specific input data.  Read the deflate.c source code for the meaning of the
    max_lazy, good_length, nice_length, and max_chain parameters.
 
+     For level 10, max_chain and nice_length limit the search for matches at
+   every input position, max_lazy is the number of times each 8K chunk of
+   input is parsed, each time with the codes that the parse before would get,
+   and good_length is not used.  The defaults are 4096, 258, and 15.  Most of
+   the time is in the search, which is about proportional to max_chain, and
+   the parsing stops early once it settles.  So max_chain sets the time to
+   compress, where 1024 takes about half the time of 4096 for little loss.
+
      deflateTune() can be called after deflateInit() or deflateInit2(), and
    returns Z_OK on success, or Z_STREAM_ERROR for an invalid deflate stream.
  */
 
+ZEXTERN int ZEXPORT deflateThroughput(z_streamp strm, uLong rate);
+/*
+     Ask deflate to adapt its search effort to compress rate bytes of input
+   per second of time spent in deflate().  deflate() times itself, and after
+   every 128K of input moves to the next faster search parameters if it fell
+   short of rate, or to the next slower ones if they are expected to keep up
+   with it.  This trades compression for speed only as much as needed on the
+   machine and data at hand, for example to keep up with a network link or to
+   stay within a share of a processor.  A rate of 0 turns adaptation off and
+   restores the parameters of the level.
+
+     The adapted parameters are those of deflateTune(), stepping among the
+   values used by nearby levels that compress with the same method, so levels
+   1 to 3 adapt between those of levels 1 and 3, and levels 5 to 9 between
+   those of a very fast lazy level below 5 and level 9.  Levels 0, 4, and 10,
+   and the Z_HUFFMAN_ONLY, Z_RLE, and Z_QUICK strategies are not adapted.
+   Parameters set by deflateTune() are replaced at the next adjustment.
+   deflateParams() with a new level restarts the adaptation at that level,
+   and deflateReset() keeps the parameters arrived at.
+
+     deflateThroughput returns Z_OK on success, Z_STREAM_ERROR if the stream
+   state was inconsistent, or Z_VERSION_ERROR if the library was compiled
+   with Z_SOLO or FASTEST, which have no adaptation.
+*/
+
+ZEXTERN int ZEXPORT deflateHash(z_streamp strm, int hash);
+/*
+     Select the hash function that deflate uses to find earlier occurrences of
+   each three-byte string.  Z_HASH_SHIFT, the default, is the original rolling
+   shift and exclusive-or hash.  It only keeps the low bits of the first byte
+   of a string, and so it can collide badly on binary data, making the hash
+   chains that deflate searches longer.  Z_HASH_MULTIPLY is a multiplicative
+   hash of all of the bits of the three bytes, which avoids that for a small
+   cost per byte.  The hash only affects the speed of deflate and which
+   matches are found within the search limits, so the compressed data can
+   differ, but is always valid and can be decompressed by any inflate.  The
+   compression levels using hash chains are 1 through 9.  The hash selection
+   is kept by deflateReset().
+
+     deflateHash() must be called after deflateInit(), deflateInit2(), or
+   deflateReset(), and before deflateSetDictionary() and the first deflate().
+   deflateHash() returns Z_OK on success, or Z_STREAM_ERROR if the stream
+   state was inconsistent, deflate has already been provided data, or hash is
+   not valid.  Z_HASH_MULTIPLY needs a memLevel of 3 or more, and is not
+   available for 16-bit int.
+*/
+
+ZEXTERN int ZEXPORT deflateOneShot(z_streamp strm);
+/*
+     Tell deflate that next_in and avail_in on the first deflate() call will
+   provide all of the input, and that the input will remain unchanged and
+   available until it has all been consumed.  deflate can then find matches
+   directly in the input, instead of first copying each byte into its sliding
+   window, which saves a copy of most of the input.  The compressed data is
+   the same either way.  If the first deflate() call does not provide more
+   than a few hundred bytes of input, or if later calls provide input that
+   does not continue from where the previous input left off, deflate copies
+   as usual.  The last few hundred bytes of input, and the window when
+   deflateCopy(), deflateFork(), or deflateParams() with level 0 is used, are
+   always copied.
+   deflateSetDictionary() cancels deflateOneShot(), and deflateReset() ends
+   it.
+
+     deflateOneShot() must be called after deflateInit(), deflateInit2(), or
+   deflateReset(), and before deflateSetDictionary() and the first deflate().
+   deflateOneShot() returns Z_OK on success, or Z_STREAM_ERROR if the stream
+   state was inconsistent or deflate has already been provided data.
+*/
+
+typedef struct z_offload_s {
+    int (*deflate)(voidpf opaque, z_streamp strm, int flush,
+                   int level, int strategy, int windowBits);
+    int (*inflate)(voidpf opaque, z_streamp strm, int flush, int windowBits);
+    void (*end)(voidpf opaque, z_streamp strm);
+    voidpf opaque;          /* first argument of the functions above */
+} z_offload;    /* a backend for deflateOffload() and inflateOffload() */
+
+ZEXTERN int ZEXPORT deflateOffload(z_streamp strm,
+                                   const z_offload FAR *offload);
+/*
+     Let a backend, such as a driver for a hardware compression accelerator,
+   produce the compressed data in place of deflate.  deflate() still writes the
+   zlib or gzip header and trailer, and computes the check value of the input,
+   so the backend provides only the raw deflate data, which must be a valid
+   deflate stream that uses no distances greater than 1 << windowBits.  The
+   backend is offered the stream once, on the first deflate() call after the
+   header is written, and only if no dictionary was set and deflatePrime() was
+   not used.
+
+     deflate() calls offload->deflate(offload->opaque, strm, flush, level,
+   strategy, windowBits) with the current compression level and strategy, and
+   with next_in, avail_in, next_out, and avail_out as provided by the
+   application.  The backend consumes input and writes output, updating those
+   four, and honors flush as deflate() does, except that deflate() leaves it to
+   the backend to ignore repeated flushes.  deflate() updates total_in and
+   total_out.  The backend returns Z_OK if it made progress, or if it has a
+   request in flight that will make progress on a later call, Z_STREAM_END
+   when flush is Z_FINISH and all of the deflate data has been written, or an
+   error, which deflate() returns.  A backend that completes asynchronously can
+   return Z_OK without progress until a request is done, and deflate() then
+   returns Z_OK so that the application calls again.
+
+     If the first call returns Z_BUF_ERROR without consuming input or writing
+   output, the backend has declined the stream, for example because the device
+   is busy or the level is one it does not do, and deflate compresses the
+   stream itself.  Otherwise the backend keeps the stream until deflateReset()
+   or deflateEnd(), which call offload->end(offload->opaque, strm), if end is
+   not Z_NULL, for the backend to release what it has for the stream.  The
+   backend is offered the next stream after deflateReset().  A stream that a
+   backend has can not be copied with deflateCopy() or deflateFork().
+
+     deflateOffload() must be called after deflateInit(), deflateInit2(), or
+   deflateReset(), and before the first deflate().  *offload is copied.  If
+   offload is Z_NULL, any backend is removed.  deflateOffload() returns Z_OK on
+   success, or Z_STREAM_ERROR if the stream state was inconsistent or a backend
+   has the stream.
+*/
+
+/*
+ZEXTERN int ZEXPORT deflatePoolInit2(z_streamp strm, z_poolp pool,
+                                     int level, int method, int windowBits,
+                                     int memLevel, int strategy);
+
+     This is the same as deflateInit2(), except that if pool has a state that
+   was released with deflatePoolEnd() with the same windowBits and memLevel
+   and by a stream with the same zalloc, zfree, and opaque, then that state and
+   its buffers are used instead of allocating new ones.  The result is the same
+   as a new deflateInit2() in every other respect.  In particular, the settings
+   of deflateParams(), deflateTune(), deflateHash(), deflateSetHeader(), and
+   deflateOneShot() are not carried over.  If pool is Z_NULL, or if there is no
+   such state in the pool, deflatePoolInit2() is the same as deflateInit2().
+   See zlibPoolCreate() for how to make a pool.
+*/
+
+ZEXTERN int ZEXPORT deflatePoolEnd(z_streamp strm, z_poolp pool);
+/*
+     This is the same as deflateEnd(), except that the state with all of its
+   buffers is put in pool for a later deflatePoolInit2(), instead of being
+   freed, if pool is not Z_NULL and not full.  Any stream made by deflateInit()
+   or deflateInit2() can be released to a pool.  The zfree and opaque of strm
+   are saved with the state, and must remain valid until the state is used
+   again or the pool is destroyed.  deflatePoolEnd() returns the same values as
+   deflateEnd().
+*/
+
+typedef struct z_deflate_config_s {
+    int windowBits;     /* as for deflateInit2(), with raw and gzip */
+    int hashBits;       /* log2 of the number of hash table entries, 8..24 */
+    int symBits;        /* log2 of the symbols buffered per block, 7..15 */
+    int good_length;    /* deflateTune() parameters, or all zero to use */
+    int max_lazy;       /*   those of the level */
+    int nice_length;
+    int max_chain;
+} z_deflate_config;
+
+/*
+ZEXTERN int ZEXPORT deflateInit3(z_streamp strm, z_poolp pool, int level,
+                                 int strategy,
+                                 const z_deflate_config *config);
+
+     This is the same as deflatePoolInit2() with method Z_DEFLATED, except
+   that the sizes of the hash table and of the symbol buffer are set
+   separately, instead of both by memLevel, and that the search parameters of
+   deflateTune() can be set at the same time.  deflateInit2() with memLevel is
+   the same as deflateInit3() with hashBits equal to memLevel + 7 and symBits
+   equal to memLevel + 6, so the default is hashBits 15 and symBits 14.
+
+     A larger hash table finds more and better matches in the same time for
+   large windows, and a smaller one saves memory and time for short messages.
+   hashBits can go past the 16 that memLevel allows, up to 24, which makes
+   the chains free of collisions between different strings for a server with
+   memory to spare.  However all of the hash table is updated each time the
+   window slides, once every 2^windowBits bytes of input, so more than about
+   20 bits costs more time than it saves.
+   The symbol buffer sets the maximum number of literals and matches in a
+   deflate block.  Larger blocks usually compress better, and smaller blocks
+   reduce the delay before compressed data is available.  The memory used by
+   deflate is then about 2^(windowBits+2) + 2^(hashBits+1) + 2^(symBits+2)
+   bytes.  For example, windowBits 15, hashBits 9, and symBits 15 use about
+   265K with a small hash and large blocks, and windowBits 10, hashBits 15,
+   and symBits 8 use about 77K with a large hash and short blocks.  The
+   states of deflateInit3() and deflateInit2() can share a pool when their
+   window, hash, and symbol buffer sizes are the same.
+
+     If any of good_length, max_lazy, nice_length, or max_chain is not zero,
+   then they are applied as by deflateTune() after the initialization.  As for
+   deflateTune(), they are replaced by those of the level by deflateReset() and
+   by a deflateParams() that changes the level.
+
+     deflateInit3() returns Z_OK if success, Z_MEM_ERROR if there was not
+   enough memory, Z_STREAM_ERROR if config is Z_NULL or if any parameter is
+   invalid, or Z_VERSION_ERROR if the zlib library version is incompatible
+   with the version assumed by the caller.
+*/
+
+/*
+ZEXTERN int ZEXPORT deflateInitCompact(z_streamp strm, int level,
+                                       int windowBits);
+
+     This is the same as deflateInit2() with method Z_DEFLATED and the
+   default strategy, but for a server that keeps a great many streams open,
+   each sending short messages with Z_SYNC_FLUSH or Z_FULL_FLUSH.  The hash
+   table and the symbol buffer are sized to the window instead of to the
+   default memLevel, with hashBits and symBits of windowBits - 3, or 8 for
+   windows of less than 2K.  For windowBits 12, a compact stream has about 27K
+   while it is compressing, where a deflateInit2() stream has 155K.
+
+     After each deflate() with Z_SYNC_FLUSH, Z_FULL_FLUSH, or Z_FINISH that
+   leaves no input or output pending, the stream is released as by
+   deflateIdle(), so that between messages it holds only the state and the
+   last window of history, about 12K for windowBits 12 and 40K for windowBits
+   15.  The buffers are allocated again by the next deflate() that has input,
+   which costs the time to fill the hash table from the history, about the
+   same as deflateSetDictionary() with that much.  The compression is within
+   about one percent of deflateInit2() with the same level and windowBits.
+   Streams that start with the same dictionary can share it with
+   deflateCompileDictionary() and deflateUseDictionary(), which adds nothing
+   to each stream until it is first used.
+
+     deflateInitCompact() returns the same values as deflateInit2().
+*/
+
 ZEXTERN uLong ZEXPORT deflateBound(z_streamp strm,
                                    uLong sourceLen);
 /*
@@ -774,6 +1107,117 @@ ZEXTERN uLong ZEXPORT deflateBound(z_streamp strm,
    to return Z_STREAM_END.  Note that it is possible for the compressed size to
    be larger than the value returned by deflateBound() if flush options other
    than Z_FINISH or Z_NO_FLUSH are used.
+
+     The bound is close to exact for the stream's level, windowBits, and
+   memLevel: the input plus five bytes for each stored block that deflate
+   would make of data that does not compress, plus a few bytes.  That is an
+   expansion of 0.03% for the default memLevel, and up to 4% for memLevel 1.
+   For windows that are small for their memLevel, such as windowBits 9 with
+   memLevel 2 or more, it is up to 13%.  See deflateEstimate() for a running
+   estimate of the compressed size.
+*/
+
+ZEXTERN int ZEXPORT deflateEstimate(z_streamp strm, uLong *estimate,
+                                    uLong *stored);
+/*
+     deflateEstimate() sets *estimate to an estimate of the total size of the
+   compressed stream, including the header and trailer, if deflate() were to
+   be called now with Z_FINISH and no more input.  It counts the output
+   already made, estimates the block being compressed from the frequencies of
+   its literals and matches as it would be coded, and assumes the same ratio
+   for the input not yet compressed.  The estimate is usually within one
+   percent, and is exact once deflate() has returned Z_STREAM_END.
+
+     deflateEstimate() sets *stored to the exact size of the stream that
+   deflate() at level 0 would make of all of the input provided so far, given
+   it in one call with Z_FINISH and enough output space, and with no
+   dictionary.  That is the input
+   plus five bytes for each 65535 bytes or part, plus the header and trailer.
+   Together these can be used to decide early whether to keep compressing the
+   data, or to send it stored, and to size an output buffer for the rest of
+   the data.  Either pointer may be Z_NULL.  deflateEstimate() returns Z_OK,
+   or Z_STREAM_ERROR if the stream state was inconsistent.
+
+     deflateEstimate() is not a bound.  Use deflateBound() for a guaranteed
+   size.
+*/
+
+ZEXTERN uLong ZEXPORT deflateMemory(int windowBits, int memLevel);
+/*
+     deflateMemory() returns the number of bytes that deflateInit2() allocates
+   with the given windowBits and memLevel, or zero if either is invalid.  The
+   state, the sliding window, the hash tables, and the pending output buffer
+   are all provided by a single zalloc() call of that many bytes, with 1 for
+   items.  An application can use this to provide the memory for deflate
+   from a pool of its own, or with larger than usual alignment or pages.
+   deflate aligns each of its buffers to a 64-byte cache line within that
+   memory.  (On 16-bit machines with 64K segments the buffers are allocated
+   separately, and deflateMemory() returns their total.)
+*/
+
+ZEXTERN int ZEXPORT deflateIdle(z_streamp strm);
+/*
+     deflateIdle() frees the buffers of a stream that is between messages,
+   keeping only the stream state and the last window of history, in a single
+   smaller allocation.  A stream is between messages after a deflate() with
+   Z_SYNC_FLUSH, Z_FULL_FLUSH, or Z_FINISH that used all of its input and
+   wrote all of the pending output.  Nothing about the stream is lost.  Any
+   later call that needs the buffers, such as deflate(), deflateParams(),
+   deflateReset(), or deflateSetDictionary(), allocates them again and
+   rebuilds the hash table from the history first.  An idle stream can be
+   copied with deflateCopy(), and ended with deflateEnd() or deflatePoolEnd().
+   Streams made by deflateInitCompact() are made idle by deflate() itself.
+
+     deflateIdle() returns Z_OK if the buffers were freed or were already
+   free, Z_BUF_ERROR if the stream is not between messages or is in the middle
+   of a deflateFitBlock() or an offload, Z_MEM_ERROR if there was not enough
+   memory for the smaller allocation, in which case the stream is unchanged,
+   or Z_STREAM_ERROR if the stream state was inconsistent or on 16-bit
+   machines with 64K segments.
+*/
+
+ZEXTERN uLong ZEXPORT deflateFootprint(z_streamp strm);
+/*
+     deflateFootprint() returns the number of bytes that the stream now has
+   from zalloc(), including its share of a compiled dictionary block that it
+   is using, or zero if the stream state was inconsistent.  This is
+   deflateMemory() for a stream from deflateInit2() that is not idle, plus the
+   match buffers of level 10 when they are allocated.
+*/
+
+typedef struct z_stats_s {
+    uLong stored;       /* number of stored blocks */
+    uLong fixed;        /* number of blocks coded with the fixed codes */
+    uLong dynamic;      /* number of blocks coded with dynamic codes */
+    uLong literals;     /* number of literal bytes coded */
+    uLong matches;      /* number of length/distance pairs coded */
+    uLong match_bytes;  /* total length of those matches */
+    uLong chains;       /* strings compared in the hash chains (deflate) */
+    uLong slides;       /* number of hash table slides (deflate) */
+    uLong tree_usec;    /* CPU time building Huffman trees, in microseconds
+                           (deflate) */
+} z_stats;
+
+ZEXTERN int ZEXPORT deflateGetStats(z_streamp strm, z_stats *stats);
+/*
+     deflateGetStats() copies the counts that deflate() has accumulated for
+   this stream since deflateInit() or the last deflateReset() to *stats.  The
+   average match length is match_bytes / matches.  stored, fixed, and dynamic
+   count the blocks emitted, including the empty blocks of Z_SYNC_FLUSH,
+   Z_FULL_FLUSH, and Z_PARTIAL_FLUSH.  chains is the number of earlier strings
+   compared when looking for matches, which with slides measures the search
+   effort of the level and the window size.  tree_usec is zero if the library
+   was compiled with Z_SOLO.  The counts wrap around if they exceed the range
+   of uLong.
+
+     The counting is only done if zlib was compiled with ZLIB_STATS defined,
+   which is bit 11 of zlibCompileFlags().  Otherwise the counting is compiled
+   out and costs nothing.
+
+     deflateGetStats returns Z_OK on success, Z_VERSION_ERROR with *stats set
+   to all zeros if the library was not compiled with ZLIB_STATS, or
+   Z_STREAM_ERROR if stats is Z_NULL or the source stream state was
+   inconsistent.
 */
 
 ZEXTERN int ZEXPORT deflatePending(z_streamp strm,
@@ -808,6 +1252,36 @@ ZEXTERN int ZEXPORT deflatePrime(z_streamp strm,
    source stream state was inconsistent.
 */
 
+ZEXTERN int ZEXPORT deflateFitBlock(z_streamp strm, uLong target);
+/*
+     deflateFitBlock() compresses as much of the input at next_in as fits in
+   target bytes of output, and completes the stream, as deflate() with
+   Z_FINISH would, including the zlib or gzip header and trailer if they have
+   not been written yet.  This is for filling fixed-size records or pages with
+   compressed data.  The output stops at the last symbol that fits, in one
+   pass over the input, where otherwise the input would need to be compressed
+   more than once to find how much fits.  As the block is compressed, its size
+   is checked with the Huffman codes that would be used for the symbols so
+   far, and if it is too large, the longest start of it that fits is sent as
+   the last block.  At level 0, as many bytes are stored as fit.
+
+     deflateFitBlock() is called once in place of the deflate() calls for the
+   stream, or after a deflate() call with a flush other than Z_NO_FLUSH or
+   Z_FINISH that consumed all of the input.  avail_out must be at least
+   target.  On return, next_in and avail_in are the input that did not fit,
+   and total_in, total_out, and the check value in adler account for only what
+   was written.  The stream must then be reset with deflateReset() before
+   using it again.  deflateFitBlock() is not available for the Z_QUICK
+   strategy, which does not hold on to the symbols of the block.
+
+     deflateFitBlock returns Z_STREAM_END if the stream was completed, with
+   next_out and avail_out updated as for deflate().  It returns Z_BUF_ERROR if
+   avail_out is less than target, or if target is too small for even an empty
+   stream, in which case any header written remains at next_out, and
+   Z_STREAM_ERROR if the stream state was inconsistent, the stream had been
+   finished or had input pending, or the strategy is Z_QUICK.
+*/
+
 ZEXTERN int ZEXPORT deflateSetHeader(z_streamp strm,
                                      gz_headerp head);
 /*
@@ -865,6 +1339,12 @@ ZEXTERN int ZEXPORT inflateInit2(z_streamp strm,
    most applications, the zlib format should be used as is.  Note that comments
    above on the use in deflateInit2() applies to the magnitude of windowBits.
 
+     windowBits can also be -16 for raw Deflate64 data, the "enhanced deflate"
+   compression method 9 of zip files, with a 64K window.  Deflate64 has the
+   same format as deflate, except that length code 285 takes 16 extra bits for
+   lengths of 3..65538, and distance codes 30 and 31 are used for distances up
+   to 65536.  There is no Deflate64 compression in deflate().
+
      windowBits can also be greater than 15 for optional gzip decoding.  Add
    32 to windowBits to enable zlib and gzip decoding with automatic header
    detection, or add 16 to decode only the gzip format (the zlib format will
@@ -926,6 +1406,17 @@ ZEXTERN int ZEXPORT inflateGetDictionary(z_streamp strm,
    stream state is inconsistent.
 */
 
+ZEXTERN int ZEXPORT inflateUseDictionary(z_streamp strm, z_dictp dict);
+/*
+     Set a dictionary compiled by deflateCompileDictionary() for inflate, as
+   inflateSetDictionary() would with the same dictionary, but without
+   computing its Adler-32 value again.  Only the part of the dictionary that
+   deflate could use is kept in the compiled dictionary, which is all that is
+   needed to decompress data compressed with it.  inflateUseDictionary() may
+   be called when inflateSetDictionary() may be, and has the same return
+   values.
+*/
+
 ZEXTERN int ZEXPORT inflateSync(z_streamp strm);
 /*
      Skips invalid compressed data until a possible full flush point (see above
@@ -945,6 +1436,26 @@ ZEXTERN int ZEXPORT inflateSync(z_streamp strm);
    time, until success or end of the input data.
 */
 
+ZEXTERN unsigned ZEXPORT inflateSyncScan(const Bytef *buf, z_size_t len,
+                                         z_size_t *points, unsigned max);
+/*
+     Finds the possible full flush points in buf[0..len-1], as inflateSync()
+   would, but all in one call and without a stream.  The offset just after
+   each 00 00 FF FF pattern, where inflateSync() would leave next_in, is
+   stored in points[], in increasing order, until max offsets are stored or
+   the end of buf is reached.  inflateSyncScan returns the number of offsets
+   stored.  If that is max, then there may be more, and the scan can be
+   continued from the last offset.  A pattern that starts before the end of
+   buf but ends after it is not found.
+
+     The search looks at 16 positions at a time where SIMD instructions are
+   available, which can be much faster than inflateSync() for locating the
+   flush points in a large damaged stream, or for dividing a stream made with
+   periodic Z_FULL_FLUSH into pieces to decompress in parallel.  A raw inflate
+   started at one of the offsets with inflateInit2() with negative windowBits
+   will decompress the data after the flush point if it is a true one.
+*/
+
 ZEXTERN int ZEXPORT inflateCopy(z_streamp dest,
                                 z_streamp source);
 /*
@@ -961,6 +1472,27 @@ ZEXTERN int ZEXPORT inflateCopy(z_streamp dest,
    destination.
 */
 
+ZEXTERN int ZEXPORT inflateFork(z_streamp dest,
+                                z_streamp source);
+/*
+     Sets the destination stream as a copy of the source stream, as for
+   inflateCopy(), but with the sliding window and the inflateTune() table
+   space shared between the two streams instead of copied.  The shared window
+   is copied only when one of the streams next needs to change it, which is
+   on the next call of inflate(), inflateSetDictionary(),
+   inflateUseDictionary(), inflateTune(), or inflateReset2() with a different
+   window size for that stream.  This makes recording many restart points for
+   random access cheap, since the window is copied only for the points that
+   are later used.
+
+     inflateFork returns Z_OK if success, Z_MEM_ERROR if there was not enough
+   memory, Z_STREAM_ERROR if the source stream state was inconsistent (such as
+   zalloc being Z_NULL).  msg is left unchanged in both source and
+   destination.  Each of the functions above can return Z_MEM_ERROR for a
+   forked stream if there is not enough memory for the copy of the window.
+   The streams are freed with inflateEnd(), in any order.
+*/
+
 ZEXTERN int ZEXPORT inflateReset(z_streamp strm);
 /*
      This function is equivalent to inflateEnd followed by inflateInit,
@@ -1035,6 +1567,126 @@ ZEXTERN long ZEXPORT inflateMark(z_streamp strm);
    source stream state was inconsistent.
 */
 
+ZEXTERN int ZEXPORT inflateSlack(z_streamp strm, unsigned slack);
+/*
+     This function promises inflate() that there are always at least slack
+   writable bytes following the next_out + avail_out bytes of the output buffer
+   provided on each call.  inflate() copies matches in chunks of up to 32
+   bytes, which can write some bytes past the end of a match.  It does that
+   only where those bytes fit in the output buffer plus the slack, and so with
+   enough slack, every match copy can be done in chunks.  A slack of 32 is
+   enough.  The slack is zero after inflateInit() and is not changed by
+   inflateReset().
+
+     With or without slack, the contents of the output buffer and of the slack
+   bytes past the output that inflate() reports are undefined after inflate()
+   returns.
+
+     inflateSlack returns Z_OK, or Z_STREAM_ERROR if the provided source stream
+   state was inconsistent.
+*/
+
+ZEXTERN int ZEXPORT inflateVerify(z_streamp strm, int verify);
+/*
+     If verify is true, then inflate() decodes and checks the stream without
+   writing any output, for testing the integrity of compressed data, as with
+   gzip -t.  inflate() then ignores next_out and avail_out, which are left as
+   they are and can be Z_NULL and zero, and decodes into space of its own of up
+   to 128K bytes, allocated on the first such call and freed by inflateEnd().
+   Each inflate() call decodes as much as the input allows, as if the output
+   space were unlimited.  total_out, adler, and data_type are updated, and the
+   check value and the gzip length in the trailer are verified as usual, unless
+   that was turned off with inflateValidate(), so that Z_STREAM_END means the
+   stream is intact.  The return values are the same as for inflate(), except
+   that Z_BUF_ERROR then only means that more input is needed.  The setting is
+   not changed by inflateReset(), and can be changed between inflate() calls.
+
+     inflateVerify returns Z_OK, or Z_STREAM_ERROR if the provided source
+   stream state was inconsistent.
+*/
+
+ZEXTERN int ZEXPORT inflateOffload(z_streamp strm,
+                                   const z_offload FAR *offload);
+/*
+     Let a backend, such as a driver for a hardware decompression accelerator,
+   decode the deflate data in place of inflate.  inflate() still processes the
+   zlib or gzip header and trailer, and computes and verifies the check value
+   of the output.  The backend is offered the stream once, when inflate()
+   reaches the first deflate block, and only if no dictionary was set and
+   inflatePrime() was not used.  Raw Deflate64 streams are not offered.
+
+     inflate() calls offload->inflate(offload->opaque, strm, flush,
+   windowBits), where windowBits is from the zlib header or inflateInit2(),
+   with next_in at the first deflate block.  The backend consumes input and
+   writes output, updating next_in, avail_in, next_out, and avail_out.  It
+   returns Z_OK if it made progress, or if it has a request in flight,
+   Z_STREAM_END after the last block, with next_in just past the byte with the
+   last bit of the deflate data, Z_DATA_ERROR with strm->msg set if the deflate
+   data is invalid, or another error, which inflate() returns.  As for any
+   inflate() call, no progress results in Z_BUF_ERROR, which is not fatal --
+   inflate() can be called again once the backend has completed its request.
+
+     Declining a stream, ending the backend's use of it, and copying work as
+   for deflateOffload(), with inflateReset(), inflateEnd(), inflateCopy(), and
+   inflateFork().  inflateOffload() must be called after inflateInit(),
+   inflateInit2(), or inflateReset(), and before the first inflate().
+   inflateOffload() returns Z_OK on success, or Z_STREAM_ERROR if the stream
+   state was inconsistent or a backend has the stream.
+*/
+
+ZEXTERN int ZEXPORT inflateTune(z_streamp strm, int lenbits, int distbits);
+/*
+     This function sets the number of bits decoded by the first lookup into the
+   literal/length and distance tables that inflate() builds for dynamic blocks.
+   lenbits can be 9..11 and distbits 6..8.  The defaults are 9 and 6, which are
+   what inflate() uses when inflateTune() is not called.  Larger root tables
+   resolve more codes with a single lookup, which speeds up the decoding of
+   data with many long codes, such as poorly compressible data, at the cost of
+   building larger tables for each dynamic block.  The first call that asks
+   for more than 9 or 6 bits allocates an additional 11,728 bytes, which is
+   freed by inflateEnd().  The setting is not changed by inflateReset(), and
+   takes effect with the next dynamic block header.  inflateTune() applies to
+   inflate() and not to inflateBack().
+
+     inflateTune returns Z_OK on success, Z_MEM_ERROR if there was not enough
+   memory, or Z_STREAM_ERROR if lenbits or distbits is out of range or the
+   provided source stream state was inconsistent.
+*/
+
+ZEXTERN int ZEXPORT inflateGetStats(z_streamp strm, z_stats *stats);
+/*
+     inflateGetStats() is the inflate() counterpart of deflateGetStats(),
+   copying the number of blocks of each type and the numbers of literals and
+   matches decoded since inflateInit() or the last inflateReset() to *stats.
+   chains, slides, and tree_usec are set to zero.  Blocks are counted when
+   their headers are decoded.  inflateGetStats() does not apply to
+   inflateBack().  The return values are the same as for deflateGetStats().
+*/
+
+/*
+ZEXTERN int ZEXPORT inflatePoolInit2(z_streamp strm, z_poolp pool,
+                                     int windowBits);
+
+     This is the same as inflateInit2(), except that if pool has a state that
+   was released with inflatePoolEnd() by a stream with the same zalloc, zfree,
+   and opaque, then that state is used instead of allocating a new one.  The
+   state keeps the window it had, if that window is the size that windowBits
+   calls for, and the space allocated by inflateTune(), if any.  It is
+   otherwise the same as a new inflateInit2(), so the settings of inflateTune()
+   and inflateSlack() are not carried over.  If pool is Z_NULL, or there is no
+   such state in the pool, inflatePoolInit2() is the same as inflateInit2().
+*/
+
+ZEXTERN int ZEXPORT inflatePoolEnd(z_streamp strm, z_poolp pool);
+/*
+     This is the same as inflateEnd(), except that the state, with its window
+   and tables, is put in pool for a later inflatePoolInit2(), instead of being
+   freed, if pool is not Z_NULL and not full.  Any stream made by
+   inflateInit() or inflateInit2() can be released to a pool.  The zfree and
+   opaque of strm must remain valid until the state is used again or the pool
+   is destroyed.  inflatePoolEnd() returns the same values as inflateEnd().
+*/
+
 ZEXTERN int ZEXPORT inflateGetHeader(z_streamp strm,
                                      gz_headerp head);
 /*
@@ -1171,6 +1823,48 @@ ZEXTERN int ZEXPORT inflateBack(z_streamp strm,
    cannot return Z_OK.
 */
 
+typedef struct z_iovec_s {
+    voidp    base;          /* start of the fragment */
+    z_size_t len;           /* number of bytes at base */
+} z_iovec;      /* one fragment for inflateBackRing(), gzreadv(), gzwritev() */
+
+typedef unsigned (*in_vec_func)(void FAR *, z_iovec FAR * FAR *);
+
+ZEXTERN int ZEXPORT inflateBackRing(z_streamp strm,
+                                    in_vec_func in, void FAR *in_desc,
+                                    out_func out, void FAR *out_desc,
+                                    unsigned char FAR *ring, unsigned size);
+/*
+     inflateBackRing() is the same as inflateBack(), except that the output is
+   decompressed into the size bytes at ring instead of into the window
+   provided to inflateBackInit(), and input is provided as lists of
+   fragments.  This permits a zero-copy proxy to send the output directly from
+   a large buffer of its own.  size must be at least 32768, and the deflate
+   stream may use distances up to 32768 regardless of the windowBits given to
+   inflateBackInit().  inflateBackInit() must still be called first, but its
+   window is not used by inflateBackRing() -- it may be the start of ring.
+
+     inflateBackRing() calls in(in_desc, &vec), which should set vec to point
+   to an array of fragments of input, and return how many there are.  The
+   array and the fragments must remain valid until in() is called again or
+   inflateBackRing() returns.  inflateBackRing() updates the fragments in
+   place as it consumes them, so on return the unused input, if any, starts at
+   the first fragment with a non-zero len in the array from the last in()
+   call.  That is also the input at strm->next_in and strm->avail_in, except
+   that strm->avail_in is limited to what fits in an unsigned.  Empty
+   fragments are skipped.  If in() returns zero, then inflateBackRing()
+   returns a buffer error.
+
+     out(out_desc, buf, len) is called with each completed span of output,
+   where buf is always in ring.  The output is written to ring in order,
+   wrapping to its start after its end, so the bytes of a span are not written
+   over until the output has wrapped around back to them.  The output is
+   given to out() when the end of ring is reached, before in() is called for
+   more input, and at the end of the deflate stream.  The return values are
+   the same as for inflateBack(), with Z_STREAM_ERROR also returned if in or
+   ring is Z_NULL, or size is less than 32768.
+*/
+
 ZEXTERN int ZEXPORT inflateBackEnd(z_streamp strm);
 /*
      All memory allocated by inflateBackInit() is freed.
@@ -1192,7 +1886,7 @@ ZEXTERN uLong ZEXPORT zlibCompileFlags(void);
      8: ZLIB_DEBUG
      9: ASMV or ASMINF -- use ASM code
      10: ZLIB_WINAPI -- exported functions use the WINAPI calling convention
-     11: 0 (reserved)
+     11: ZLIB_STATS -- deflate and inflate count for deflateGetStats()
 
     One-time table building (smaller code, but not thread-safe if true):
      12: BUILDFIXED -- build static block decoding tables when needed
@@ -1204,7 +1898,8 @@ ZEXTERN uLong ZEXPORT zlibCompileFlags(void);
                           deflate code when not needed)
      17: NO_GZIP -- deflate can't write gzip streams, and inflate can't detect
                     and decode gzip streams (to avoid linking crc code)
-     18-19: 0 (reserved)
+     18: NO_THREADS -- the parallel functions run on the calling thread only
+     19: 0 (reserved)
 
     Operation variations (changes in library functionality):
      20: PKZIP_BUG_WORKAROUND -- slightly more permissive inflate
@@ -1286,6 +1981,10 @@ ZEXTERN int ZEXPORT uncompress(Bytef *dest,   uLongf *destLen,
    buffer, or Z_DATA_ERROR if the input data was corrupted or incomplete.  In
    the case where there is not enough room, uncompress() will fill the output
    buffer with the uncompressed data up to that point.
+
+     When destLen is large enough, uncompress() inflates with Z_FINISH and all
+   of the output space at once, so matches are copied from within dest and no
+   sliding window is allocated.
 */
 
 ZEXTERN int ZEXPORT uncompress2(Bytef *dest,   uLongf *destLen,
@@ -1296,6 +1995,308 @@ ZEXTERN int ZEXPORT uncompress2(Bytef *dest,   uLongf *destLen,
    source bytes consumed.
 */
 
+typedef struct z_buf_s {
+    const Bytef *source;    /* input data */
+    uLong   sourceLen;      /* input length, updated by uncompressBatch */
+    Bytef   *dest;          /* output buffer */
+    uLongf  destLen;        /* size of dest, set to the length of the output */
+    int     err;            /* set to the result for this buffer */
+} z_buf;
+
+typedef z_buf FAR *z_bufp;
+
+ZEXTERN int ZEXPORT compressBatch(z_bufp bufs, unsigned count, int level);
+/*
+     Compresses each of the count buffers in bufs as compress2() would with
+   the given level, each to its own zlib stream.  One deflate state is used for
+   all of them, reset between buffers, which saves the allocation and
+   initialization of a state per buffer when there are many small buffers.
+   The result of compressing each buffer is stored in its err member:  Z_OK
+   if success, Z_BUF_ERROR if there was not enough room at dest, in which case
+   destLen is how much was written, or Z_STREAM_ERROR if source or dest is
+   Z_NULL.
+
+     compressBatch returns Z_OK if all of the buffers were compressed, the err
+   value of the first buffer that was not, Z_MEM_ERROR if there was not enough
+   memory for the deflate state, or Z_STREAM_ERROR if the level parameter is
+   invalid.  In the last two cases no buffer is processed.
+*/
+
+ZEXTERN int ZEXPORT uncompressBatch(z_bufp bufs, unsigned count);
+/*
+     Decompresses each of the count buffers in bufs as uncompress2() would,
+   using one inflate state for all of them.  For each buffer, destLen is set
+   to the length of the decompressed data, sourceLen to the number of source
+   bytes consumed, and err to what uncompress2() would have returned.
+   uncompressBatch returns Z_OK if all of the buffers were decompressed, the
+   err value of the first buffer that was not, or Z_MEM_ERROR if there was not
+   enough memory for the inflate state, in which case no buffer is processed.
+*/
+
+ZEXTERN int ZEXPORT compressParallel(Bytef *dest,   uLongf *destLen,
+                                     const Bytef *source, uLong sourceLen,
+                                     int level, int windowBits, int threads);
+/*
+     Compresses the source buffer into the destination buffer using up to
+   threads threads.  If threads is zero or negative, then one thread is used
+   for each available processor.  level has the same meaning as in
+   deflateInit, and windowBits has the same meaning as in deflateInit2,
+   including the selection of a zlib, gzip, or raw deflate wrapper, except
+   that windowBits must be in the range 9..15 (plus 16 for gzip, or negated
+   for raw deflate).  Upon entry, destLen is the total size of the destination
+   buffer, which must be at least the value returned by
+   compressParallelBound(sourceLen, windowBits).  Upon exit, destLen is the
+   actual size of the compressed data.
+
+     The input is divided into chunks of 128K bytes that are compressed
+   independently, each using the window of input that precedes it as a preset
+   dictionary.  The result is a single zlib stream, gzip member, or raw deflate
+   stream that inflate() decodes in the usual way.  It is slightly larger than
+   what compress2() would produce, since each chunk ends with the empty stored
+   block written by a Z_SYNC_FLUSH.  The compressed data does not depend on the
+   number of threads.  If zlib was compiled without thread support (see
+   zlibCompileFlags), then the chunks are compressed on the calling thread.
+   With level 10, this divides the slow optimal parsing among the threads.
+
+     compressParallel returns Z_OK if success, Z_MEM_ERROR if there was not
+   enough memory, Z_BUF_ERROR if there was not enough room in the output
+   buffer, or Z_STREAM_ERROR if a parameter is invalid.
+*/
+
+ZEXTERN uLong ZEXPORT compressParallelBound(uLong sourceLen, int windowBits);
+/*
+     compressParallelBound() returns an upper bound on the compressed size
+   after compressParallel() on sourceLen bytes with the given windowBits.
+*/
+
+ZEXTERN int ZEXPORT compressJoin(Bytef *dest,   uLongf *destLen,
+                                 const Bytef * const *sources,
+                                 const uLong *sourceLens, unsigned count);
+/*
+     Joins the count complete zlib streams or gzip members at sources, with
+   lengths sourceLens, into a single zlib stream or gzip member in dest that
+   decompresses to the concatenation of their uncompressed data.  The sources
+   must all be zlib streams or all be gzip members, with no preset
+   dictionaries, and with no data after each stream or member.  The header of
+   the first source is used for the result, except that a zlib header is given
+   the largest window size of the sources.  Upon entry, destLen is the total
+   size of the destination buffer, for which the sum of the sourceLens is
+   always enough.  Upon exit, destLen is the actual size of the joined data.
+
+     The deflate data is not decompressed.  It is scanned only to find where
+   each stream ends, and then copied, so joining runs at a small fraction of
+   the cost of inflate().  The check values of the sources are combined but
+   not verified, so the sources should be known to be valid.
+
+     compressJoin returns Z_OK if success, Z_MEM_ERROR if there was not enough
+   memory, Z_BUF_ERROR if there was not enough room in the output buffer,
+   Z_DATA_ERROR if a source is not a valid zlib stream or gzip member, or its
+   deflate data or gzip length is found to be invalid, or Z_STREAM_ERROR if a
+   parameter is invalid.
+*/
+
+ZEXTERN int ZEXPORT gzipNormalize(in_func in, void FAR *in_desc,
+                                  out_func out, void FAR *out_desc);
+/*
+     Converts a gzip stream of one or more members, read with in(), to a single
+   gzip member written with out(), as examples/gznorm.c does.  The result has a
+   gzip header with no file name, comment, extra field, or modification time,
+   and with the OS marked as unknown.  in() and out() are called as they are
+   by inflateBack().  in() returning zero ends the input, which must then be
+   at the end of a member.  No input makes an empty gzip stream.
+
+     As for compressJoin(), the deflate data is not decompressed.  It is
+   scanned for the block headers, and copied with the last-block bits
+   cleared, shifted to follow the previous member's data at any bit, and with
+   each stored block started at a byte boundary.  A final empty block with
+   fixed codes is dropped and one is added at the end, so normalizing the
+   result again does not change it.  The check value is made from those in
+   the trailers with crc32_combine(), and is not verified.  Input that is
+   byte-aligned in the result, such as stored blocks, is given to out()
+   directly from what in() returned, so out() must not modify it.
+
+     gzipNormalize returns Z_OK if success, Z_MEM_ERROR if there was not enough
+   memory, Z_BUF_ERROR if out() returned non-zero, Z_DATA_ERROR if the input
+   is not a gzip stream, or its deflate data or a gzip length is found to be
+   invalid, or the input ended in a member, or Z_STREAM_ERROR if in or out is
+   Z_NULL.
+*/
+
+ZEXTERN z_poolp ZEXPORT zlibPoolCreate(unsigned size);
+/*
+     Create a pool that can hold up to size released deflate and inflate
+   states, for deflatePoolInit2() and inflatePoolInit2() to reuse.  An
+   application that opens and closes many streams with the same parameters
+   can then avoid allocating and freeing the states, windows, and hash tables
+   for each stream.  A pool has no locking, so it must only be used by one
+   thread at a time.  A pool per thread lets each thread reuse its own states.
+
+     zlibPoolCreate() returns the new pool, or Z_NULL if size is zero or if
+   there was not enough memory.
+*/
+
+ZEXTERN void ZEXPORT zlibPoolDestroy(z_poolp pool);
+/*
+     Free all of the states held by pool, using the zfree and opaque of the
+   streams that released them, and then free pool itself.  Streams that are in
+   use when the pool is destroyed are not affected.  pool may be Z_NULL.
+*/
+
+ZEXTERN int ZEXPORT zlibStreamCache(unsigned size);
+/*
+     Let compress(), compress2(), uncompress(), uncompress2(), and the gzip
+   file functions that write keep released deflate and inflate states in a
+   cache of up to size states per thread, and reuse them for later calls on
+   the same thread, as deflatePoolInit2() and inflatePoolInit2() reuse states
+   from a pool.  A program, or a library built on zlib, that compresses or
+   decompresses many small messages with those functions then saves most of
+   the allocation and initialization of the states, without changing its
+   calls.  The cache is off until zlibStreamCache() is called, and is turned
+   off again with a size of zero.  It applies to all threads, each of which
+   makes its own cache on first use, with the size set at that time, and frees
+   it when the thread exits.  States in the cache of a thread that does not
+   exit, such as the main thread, are held until the program ends.
+
+     zlibStreamCache() returns Z_OK on success, Z_MEM_ERROR if the per-thread
+   storage could not be made, or Z_STREAM_ERROR if size is too large, or if
+   zlib was compiled without thread support (see zlibCompileFlags) or for
+   Windows, in which case there is no cache.
+*/
+
+ZEXTERN int ZEXPORT zlibWorkers(int keep, int affinity);
+/*
+     Set how the threads of compressParallel(), gzuncompressParallel(), and
+   parallel inflation are managed.  Those functions normally keep the threads
+   they start waiting for the next call, up to keep of them, or with no limit
+   if keep is negative, which is the default.  Each kept thread holds one
+   deflate state for reuse by compressParallel(), so that the state is
+   allocated and first written by the thread that uses it, and so is in
+   memory local to that thread's processor on a NUMA system.  Only one call at
+   a time uses the kept threads.  Others that run at the same time start and
+   stop threads of their own, as do all calls if keep is zero.  If affinity is
+   true, then each kept thread is bound to one of the processors that the
+   thread that started it was allowed to run on, in turn, which keeps its
+   state local.  Binding is only done on Linux.
+
+     zlibWorkers() first waits for any call using the kept threads to finish,
+   and then stops them and frees their states, so zlibWorkers(0, 0) releases
+   all of the resources held.  The new settings apply to threads started
+   later.  zlibWorkers() returns Z_OK, or Z_STREAM_ERROR if zlib was compiled
+   without thread support (see zlibCompileFlags) or for Windows, where threads
+   are not kept.
+*/
+
+typedef void (*z_run_func)(void FAR *arg);
+typedef void (*z_executor)(void FAR *opaque, unsigned count, z_run_func run,
+                           void FAR *arg);
+
+ZEXTERN int ZEXPORT zlibExecutor(z_executor exec, void FAR *opaque);
+/*
+     Have compressParallel(), gzuncompressParallel(), and parallel inflation
+   use the application's threads instead of their own.  When one of those
+   functions wants count threads, including the calling thread, it calls
+   exec(opaque, count, run, arg).  exec must call run(arg) on up to count
+   threads, which may include the calling thread, and must not return until
+   all of those calls have returned.  Each run(arg) takes jobs from a shared
+   list until there are none left, so it does not matter how many of the
+   calls run at once, or if exec calls run(arg) only once, or not at all, in
+   which case the calling thread does the jobs after exec returns.  A thread
+   pool that has exec wait on the calls it queues must not be one whose
+   threads are themselves waiting in exec, or it can deadlock.
+
+     zlibExecutor(Z_NULL, Z_NULL) goes back to zlib's own threads.  The
+   executor must not be changed while any of the parallel functions are
+   running.  zlibExecutor() returns Z_OK, or Z_STREAM_ERROR if zlib was
+   compiled without thread support, in which case the parallel functions run
+   on the calling thread.
+*/
+
+typedef struct z_job_s {
+    const Bytef *source;    /* input data */
+    uLong   sourceLen;      /* input length, updated by uncompressAsync */
+    Bytef   *dest;          /* output buffer */
+    uLongf  destLen;        /* size of dest, set to the length of the output */
+    int     level;          /* compression level for compressAsync */
+    int     windowBits;     /* as for deflateInit2 or inflateInit2, 0 for 15 */
+    int     threads;        /* threads for compressAsync, > 1 for parallel */
+    int     err;            /* set to the result of the job */
+    void (*done)(struct z_job_s FAR *job);  /* completion callback or Z_NULL */
+    voidpf  opaque;         /* for use by the application */
+    struct z_job_s FAR *next;   /* used by zlib */
+    int     op;                 /* used by zlib */
+} z_job;
+
+typedef struct z_async_s FAR *z_asyncp;    /* opaque, see zlibAsyncCreate() */
+
+ZEXTERN z_asyncp ZEXPORT zlibAsyncCreate(int threads);
+/*
+     Create a queue for compressAsync() and uncompressAsync() jobs, served by
+   threads worker threads.  If threads is zero or negative, then one worker is
+   started for each available processor.  If zlib was compiled without thread
+   support (see zlibCompileFlags), or on Windows, or if no worker could be
+   started, then the queue still works, but each job is run to completion on
+   the calling thread before compressAsync() or uncompressAsync() returns.
+
+     zlibAsyncCreate() returns the new queue, or Z_NULL if there was not enough
+   memory or a pipe could not be made.
+*/
+
+ZEXTERN int ZEXPORT compressAsync(z_asyncp async, z_job FAR *job);
+ZEXTERN int ZEXPORT uncompressAsync(z_asyncp async, z_job FAR *job);
+/*
+     Submit job to async, and return without waiting for it to be done.  The
+   source, sourceLen, dest, destLen, level, windowBits, threads, done, and
+   opaque members of job must be set by the application, and job, its source,
+   and its dest must remain valid and unchanged until the job is complete.
+   Jobs are started in the order submitted.
+
+     compressAsync() compresses source into dest as compress2() does, with the
+   given level, but with windowBits as for deflateInit2() to select a zlib,
+   gzip, or raw deflate wrapper.  If threads is greater than one, then the job
+   is instead done by compressParallel() with that many threads of its own.
+   uncompressAsync() decompresses source into dest as uncompress2() does, but
+   with windowBits as for inflateInit2(), which permits gzip and raw deflate
+   streams, and automatic detection with 32 added.  For both, a windowBits of
+   zero is taken as 15, for a zlib stream.  When the job is complete, err,
+   destLen, and for uncompressAsync() sourceLen, are set as the corresponding
+   function would return and update them.
+
+     When a job is complete, if done is not Z_NULL, then done(job) is called
+   on the worker thread that ran the job.  The callback may free the job, but
+   it must not destroy async.  Otherwise the job is put on a completion queue
+   for zlibAsyncReap().
+
+     compressAsync() and uncompressAsync() return Z_OK if the job was
+   submitted, or Z_STREAM_ERROR if async or job is Z_NULL.  The result of the
+   job itself is in job->err.
+*/
+
+ZEXTERN int ZEXPORT zlibAsyncFd(z_asyncp async);
+/*
+     Return a file descriptor that is readable while there are jobs on the
+   completion queue of async, for an event loop to wait on with poll(),
+   epoll, kqueue, or io_uring.  The application must not read from or close
+   the descriptor.  zlibAsyncFd() returns -1 if zlib was compiled without
+   thread support or on Windows, in which case completed jobs are ready for
+   zlibAsyncReap() as soon as compressAsync() or uncompressAsync() returns.
+*/
+
+ZEXTERN z_job FAR * ZEXPORT zlibAsyncReap(z_asyncp async, int wait);
+/*
+     Take the oldest job from the completion queue of async and return it, or
+   return Z_NULL if the queue is empty.  If wait is true and the queue is
+   empty, then first wait until a job is put on the queue, or until no jobs
+   are outstanding, in which case Z_NULL is returned.  Jobs with a done
+   callback are never returned.
+*/
+
+ZEXTERN void ZEXPORT zlibAsyncDestroy(z_asyncp async);
+/*
+     Wait for all of the submitted jobs to complete, including calling their
+   callbacks, then stop the workers and free async.  Jobs left on the
+   completion queue are simply forgotten.  async may be Z_NULL.
+*/
+
                         /* gzip file access functions */
 
 /*
@@ -1325,6 +2326,13 @@ ZEXTERN gzFile ZEXPORT gzopen(const char *path, const char *mode);
    "x" when writing will create the file exclusively, which fails if the file
    already exists.  On systems that support it, the addition of "e" when
    reading or writing will set the flag to close the file on an execve() call.
+   The addition of "A" requests asynchronous file i/o, as for gzsetasync().
+   The addition of "m" when reading requests that a regular file be memory
+   mapped, so that its compressed data is decompressed in place instead of
+   being read into a buffer.  The file must then not be truncated while it is
+   open, and data appended to it after the first read is not seen.  "m" is
+   ignored for pipes and other files that can't be mapped, as well as on
+   systems without mmap(), and takes precedence over "A".
 
      These functions, as well as gzip, will read and decode a sequence of gzip
    streams in a file.  The append function of gzopen() can be used to create
@@ -1371,12 +2379,18 @@ ZEXTERN gzFile ZEXPORT gzdopen(int fd, const char *mode);
 ZEXTERN int ZEXPORT gzbuffer(gzFile file, unsigned size);
 /*
      Set the internal buffer size used by this library's functions for file to
-   size.  The default buffer size is 8192 bytes.  This function must be called
-   after gzopen() or gzdopen(), and before any other calls that read or write
-   the file.  The buffer memory allocation is always deferred to the first read
-   or write.  Three times that size in buffer space is allocated.  A larger
-   buffer size of, for example, 64K or 128K bytes will noticeably increase the
-   speed of decompression (reading).
+   size.  This function must be called after gzopen() or gzdopen(), and before
+   any other calls that read or write the file.  The buffer memory allocation
+   is always deferred to the first read or write.  Three times that size in
+   buffer space is allocated.  A larger buffer size of, for example, 64K or
+   128K bytes will noticeably increase the speed of decompression (reading).
+
+     If gzbuffer() is not used, then the buffer size is 8192 bytes, or the
+   preferred i/o size reported by fstat() for the file if that is larger, up to
+   128K bytes.  When reading, the buffers are then doubled each time a read
+   from the file fills the input buffer, up to 128K bytes, so that a large
+   file is read with few system calls while a small one uses little memory.
+   gzbuffer() sets a fixed size.
 
      The new buffer size also affects the maximum length for gzprintf().
 
@@ -1384,6 +2398,56 @@ ZEXTERN int ZEXPORT gzbuffer(gzFile file, unsigned size);
    too late.
 */
 
+ZEXTERN int ZEXPORT gzsetasync(gzFile file, int async);
+/*
+     If async is not zero, have a helper thread do the reads or writes of the
+   underlying file for file, so that the file i/o overlaps the decompression or
+   compression done by the calling thread.  When reading, the next buffer of
+   input is read ahead while the current one is decompressed.  When writing,
+   a full buffer of compressed output is written while the next one is being
+   compressed.  This can speed up access to files on slow or high-latency
+   storage, at the cost of one more buffer of the gzbuffer() size.  Like
+   gzbuffer(), this function must be called after gzopen() or gzdopen(), and
+   before any other calls that read or write the file.  The "A" mode of
+   gzopen() is the same as calling gzsetasync(file, 1).
+
+     Reading may continue up to one buffer past where the application stops.
+   gzseek(), gzrewind(), and gzoffset() move the file offset back to where the
+   read data ends, which fails on a pipe.  When writing, gzflush() and
+   gzclose() do not return until all of the data has been written to the file,
+   so that a write error is reported by them if not earlier.  A write error can
+   otherwise be reported by the call after the one that provided the data.
+   Writing transparently with "T" never uses a helper thread.  If the library
+   was built without pthreads or with NO_THREADS defined, or if the thread
+   cannot be created, then the file i/o is done by the calling thread as usual.
+
+     gzsetasync() returns 0 on success, or -1 on failure, such as being called
+   too late.
+*/
+
+ZEXTERN int ZEXPORT gzsetblock(gzFile file, unsigned size);
+/*
+     Set block mode for file, which must be open for writing, so that every
+   size bytes of uncompressed data are compressed independently, each block
+   ending with a Z_FULL_FLUSH.  The offsets of the blocks are kept, and after
+   each gzip member is completed by gzclose() or gzflush() with Z_FINISH,
+   they are written in the extra field of an empty gzip member that follows
+   it, or as many such members as are needed at 8187 blocks per member.  Any
+   gzip decoder will decompress the result to the same data, since the empty
+   members decompress to nothing.  gzindex_load() with no path can then get a
+   random access index from the end of the file in a few reads, without
+   decompressing anything, for use by gzseek() and gzuncompressParallel().
+   This costs some compression, since each block starts with no history, more
+   so for smaller blocks -- a block size of 1 MB or more makes the loss small.
+   A size of zero, the default, turns block mode off.  Like gzbuffer(), this
+   function must be called after gzopen() or gzdopen(), and before any other
+   calls that write the file.  Block mode is ignored when writing
+   transparently with "T".
+
+     gzsetblock() returns 0 on success, or -1 on failure, such as file not
+   being open for writing, or being called too late.
+*/
+
 ZEXTERN int ZEXPORT gzsetparams(gzFile file, int level, int strategy);
 /*
      Dynamically update the compression level and strategy for file.  See the
@@ -1451,6 +2515,24 @@ ZEXTERN z_size_t ZEXPORT gzfread(voidp buf, z_size_t size, z_size_t nitems,
    file, resetting and retrying on end-of-file, when size is not 1.
 */
 
+ZEXTERN z_size_t ZEXPORT gzreadv(gzFile file, const z_iovec *iov,
+                                 unsigned count);
+/*
+     Read and decompress up to the total length of the count fragments in iov
+   from file, filling each fragment in order before moving on to the next,
+   duplicating the interface of POSIX readv().  Otherwise gzreadv() operates as
+   gzfread() does with size 1.  Fragments of at least twice the buffer size set
+   by gzbuffer() are decompressed into directly, as they are by gzread().
+
+     gzreadv() returns the total number of uncompressed bytes read, which is
+   less than the total length of the fragments only if the end of the file was
+   reached or there was an error.  gzerror() must be consulted if fewer bytes
+   were read in order to determine if there was an error.  If the total length
+   of the fragments does not fit in a z_size_t, or if a fragment with a
+   non-zero length has a NULL base, then nothing is read, zero is returned,
+   and the error state is set to Z_STREAM_ERROR.
+*/
+
 ZEXTERN int ZEXPORT gzwrite(gzFile file, voidpc buf, unsigned len);
 /*
      Compress and write the len uncompressed bytes at buf to file. gzwrite
@@ -1471,6 +2553,24 @@ ZEXTERN z_size_t ZEXPORT gzfwrite(voidpc buf, z_size_t size,
    is returned, and the error state is set to Z_STREAM_ERROR.
 */
 
+ZEXTERN z_size_t ZEXPORT gzwritev(gzFile file, const z_iovec *iov,
+                                  unsigned count);
+/*
+     Compress and write the count fragments in iov to file, in order, as if by
+   one gzfwrite() of their concatenation, duplicating the interface of POSIX
+   writev().  Fragments of at least 4K, or at least the buffer size set by
+   gzbuffer(), are compressed in place, without first being copied to the
+   input buffer.  Smaller fragments are gathered in the input buffer, as
+   gzwrite() does.  The fragments need not remain valid after gzwritev()
+   returns.
+
+     gzwritev() returns the total number of uncompressed bytes written, or zero
+   if there was an error or if there was nothing to write.  If the total length
+   of the fragments does not fit in a z_size_t, or if a fragment with a
+   non-zero length has a NULL base, then nothing is written, zero is returned,
+   and the error state is set to Z_STREAM_ERROR.
+*/
+
 ZEXTERN int ZEXPORTVA gzprintf(gzFile file, const char *format, ...);
 /*
      Convert, format, compress, and write the arguments (...) to file under
@@ -1508,6 +2608,23 @@ ZEXTERN char * ZEXPORT gzgets(gzFile file, char *buf, int len);
    buf are indeterminate.
 */
 
+ZEXTERN z_size_t ZEXPORT gzgetline(gzFile file, const char **line);
+/*
+     Read and decompress the next line from file, without copying it to a
+   buffer provided by the caller.  On return *line points to the line, which
+   includes its terminating newline character if there is one, and which is
+   not null-terminated.  The line is usually found in place in the gzFile
+   output buffer.  A line that continues past that buffer is gathered in a
+   buffer kept by file, grown as needed, so any length of line is returned
+   whole.  The line remains valid only until the next call with file.
+
+     gzgetline returns the length of the line, or zero for end-of-file or in
+   case of error, with *line set to NULL.  gzerror() must be consulted if zero
+   is returned in order to determine if there was an error.  It returns zero
+   with the error Z_MEM_ERROR if the line buffer could not be grown.  Calls of
+   gzgetline() may be mixed with those of the other reading functions.
+*/
+
 ZEXTERN int ZEXPORT gzputc(gzFile file, int c);
 /*
      Compress and write c, converted to an unsigned char, into file.  gzputc
@@ -1560,7 +2677,8 @@ ZEXTERN z_off_t ZEXPORT gzseek(gzFile file,
    the value SEEK_END is not supported.
 
      If the file is opened for reading, this function is emulated but can be
-   extremely slow.  If the file is opened for writing, only forward seeks are
+   extremely slow, unless the file has an index from gzindex_build() or
+   gzindex_load().  If the file is opened for writing, only forward seeks are
    supported; gzseek then compresses a sequence of zeroes up to the new
    starting position.
 
@@ -1634,6 +2752,88 @@ ZEXTERN int ZEXPORT gzdirect(gzFile file);
    gzip file reading and decompression, which may not be desired.)
 */
 
+ZEXTERN int ZEXPORT gzindex_build(gzFile file, z_off_t span);
+/*
+     Build a random access index for file, which must be open for reading, by
+   decompressing all of it from the start.  There will be an access point
+   about every span bytes of uncompressed data, or every 1 MB if span is zero
+   or negative.  Each access point keeps the 32K bytes of uncompressed data
+   that precede it compressed, which for typical data takes a few K bytes of
+   memory, and decompresses them only when a seek uses it.  Once file has an
+   index, gzseek() uses it to go backwards, or forwards past the next access
+   point, by starting decompression at the last access point before the
+   target, so that no more than about span bytes are decompressed to get
+   there.  The gzip check value and length of a member are not verified when
+   its decompression starts at an access point.  gzindex_build() replaces any
+   index that file already has, and leaves file at the start of its data.
+
+     gzindex_build() returns the number of access points (at least one) on
+   success, Z_DATA_ERROR if file is not gzip data or the gzip data is invalid,
+   Z_BUF_ERROR if the gzip data ends prematurely, Z_MEM_ERROR if there was not
+   enough memory, Z_ERRNO if there was an error reading the file or it can't
+   be rewound (such as for a pipe), or Z_STREAM_ERROR if file is not open for
+   reading or has an error.  On failure, any previous index is kept.
+*/
+
+ZEXTERN int ZEXPORT gzindex_save(gzFile file, const char *path);
+/*
+     Write the index of file to the file at path, from which gzindex_load() can
+   load it later for the same gzip file.  The index file has a version number,
+   and gzindex_load() can read all of the versions that were written by
+   previous versions of zlib.  gzindex_save() returns Z_OK on success,
+   Z_ERRNO on a file error, or Z_STREAM_ERROR if file does not have an index.
+*/
+
+ZEXTERN int ZEXPORT gzindex_load(gzFile file, const char *path);
+/*
+     Load the index saved at path by gzindex_save() for file, replacing any
+   index that file already has, so that the index does not need to be built
+   each time the gzip file is opened.  The index must be for the same data
+   that file has -- this is not checked, and a mismatch will result in bad or
+   invalid decompressed data after a seek.
+
+     If path is NULL, then the index is instead made from the lists of block
+   offsets that gzwrite() in block mode (see gzsetblock()) put after each gzip
+   member, which are read starting at the end of file.  All of the members in
+   file must have been written that way.  The index has an access point at the
+   start of every block.  file is then left at the start of its data.
+
+     gzindex_load() returns the number of access points on success, Z_ERRNO if
+   path can't be opened or on a read error, Z_DATA_ERROR if it isn't a valid
+   index or file doesn't end with block lists when path is NULL, Z_MEM_ERROR
+   if there was not enough memory, or Z_STREAM_ERROR if file is not open for
+   reading.
+*/
+
+ZEXTERN int ZEXPORT gzuncompressParallel(gzFile file, int fd, int threads);
+/*
+     Decompress all of file, which must be open for reading, from the start
+   and write the uncompressed data to the file descriptor fd, using up to
+   threads threads.  If threads is zero or negative, then one thread is used
+   for each available processor.  If file has an index from gzindex_build() or
+   gzindex_load(), then the data between each pair of access points is
+   decompressed by its own thread.  Otherwise each gzip member is decompressed
+   by its own thread, and the members are found by looking ahead for gzip
+   headers.  A single long member of a file opened with "m" is experimentally
+   split where its deflate blocks are guessed to start, with each part decoded
+   by its own thread and checked by its continuing exactly where the part
+   before it ended, so that a wrong guess costs time but not correctness.  A
+   single member is otherwise decompressed by one thread.  The output is
+   written in order, and the check value and length of every member are
+   verified, including the members that start or end between access points.
+   Data that is not gzip is copied to fd, and trailing garbage after a gzip
+   member is ignored, as for gzread().  If zlib was compiled without thread
+   support (see zlibCompileFlags), or if the input cannot be read from
+   several threads at once, then everything is decompressed on the calling
+   thread.  file is left at the start of its data.
+
+     gzuncompressParallel() returns Z_OK on success, Z_DATA_ERROR if the gzip
+   data is invalid or does not match the index, Z_BUF_ERROR if the gzip data
+   ends prematurely, Z_MEM_ERROR if there was not enough memory, Z_ERRNO if
+   there was an error reading file or writing fd, or Z_STREAM_ERROR if file is
+   not open for reading or has an error.
+*/
+
 ZEXTERN int ZEXPORT    gzclose(gzFile file);
 /*
      Flush all pending output for file, if necessary, close file and
@@ -1778,6 +2978,53 @@ ZEXTERN uLong ZEXPORT crc32_combine_op(uLong crc1, uLong crc2, uLong op);
    crc32_combine() if the generated op is used more than once.
 */
 
+typedef struct z_combine_s {
+    z_size_t len[8];        /* lengths of the cached operators */
+    uLong    op[8];         /* operators for those lengths */
+    unsigned used;          /* number of cached operators */
+    unsigned next;          /* operator to replace next when all are used */
+} z_combine;
+
+typedef z_combine FAR *z_combinep;
+
+ZEXTERN void ZEXPORT crc32_combine_init(z_combinep ctx);
+/*
+     Initialize ctx for crc32_combine_ctx(), with no cached operators.  A
+   z_combine needs no other set up or clean up.
+*/
+
+ZEXTERN uLong ZEXPORT crc32_combine_ctx(z_combinep ctx, uLong crc1,
+                                        uLong crc2, z_size_t len2);
+/*
+     Give the same result as crc32_combine(), using an operator for len2
+   cached in ctx, or generating it and caching it in ctx if it is not there.
+   Up to eight lengths are cached, so combining many CRC-32s of the same few
+   lengths, such as for equal chunks with a short last chunk, costs only one
+   multiplication each, with no operator to generate.
+*/
+
+typedef struct z_check_s {
+    uLong    check;         /* CRC-32 or Adler-32 of a piece of data */
+    z_size_t len;           /* length of that piece */
+} z_check;
+
+ZEXTERN uLong ZEXPORT crc32_combine_vec(uLong crc, const z_check *checks,
+                                        unsigned count);
+/*
+     Return the CRC-32 of the sequence of bytes with CRC-32 crc, followed by
+   each of the count pieces in checks in order.  The operators for the lengths
+   of the pieces are cached as with crc32_combine_ctx().  Use crc32(0, Z_NULL,
+   0) for crc if the first piece starts the data.
+*/
+
+ZEXTERN uLong ZEXPORT adler32_combine_vec(uLong adler, const z_check *checks,
+                                          unsigned count);
+/*
+     Return the Adler-32 of the sequence of bytes with Adler-32 adler, followed
+   by each of the count pieces in checks in order.  Use adler32(0, Z_NULL, 0)
+   for adler if the first piece starts the data.
+*/
+
 
                         /* various hacks, don't look :) */
 
@@ -1798,6 +3045,20 @@ ZEXTERN int ZEXPORT inflateBackInit_(z_streamp strm, int windowBits,
                                      unsigned char FAR *window,
                                      const char *version,
                                      int stream_size);
+ZEXTERN int ZEXPORT deflatePoolInit2_(z_streamp strm, z_poolp pool,
+                                      int level, int method, int windowBits,
+                                      int memLevel, int strategy,
+                                      const char *version, int stream_size);
+ZEXTERN int ZEXPORT inflatePoolInit2_(z_streamp strm, z_poolp pool,
+                                      int windowBits, const char *version,
+                                      int stream_size);
+ZEXTERN int ZEXPORT deflateInit3_(z_streamp strm, z_poolp pool, int level,
+                                  int strategy,
+                                  const z_deflate_config FAR *config,
+                                  const char *version, int stream_size);
+ZEXTERN int ZEXPORT deflateInitCompact_(z_streamp strm, int level,
+                                        int windowBits, const char *version,
+                                        int stream_size);
 #ifdef Z_PREFIX_SET
 #  define z_deflateInit(strm, level) \
           deflateInit_((strm), (level), ZLIB_VERSION, (int)sizeof(z_stream))
@@ -1812,6 +3073,20 @@ ZEXTERN int ZEXPORT inflateBackInit_(z_streamp strm, int windowBits,
 #  define z_inflateBackInit(strm, windowBits, window) \
           inflateBackInit_((strm), (windowBits), (window), \
                            ZLIB_VERSION, (int)sizeof(z_stream))
+#  define z_deflatePoolInit2(strm, pool, level, method, windowBits, \
+                            memLevel, strategy) \
+          deflatePoolInit2_((strm), (pool), (level), (method), (windowBits), \
+                            (memLevel), (strategy), ZLIB_VERSION, \
+                            (int)sizeof(z_stream))
+#  define z_inflatePoolInit2(strm, pool, windowBits) \
+          inflatePoolInit2_((strm), (pool), (windowBits), ZLIB_VERSION, \
+                            (int)sizeof(z_stream))
+#  define z_deflateInit3(strm, pool, level, strategy, config) \
+          deflateInit3_((strm), (pool), (level), (strategy), (config), \
+                        ZLIB_VERSION, (int)sizeof(z_stream))
+#  define z_deflateInitCompact(strm, level, windowBits) \
+          deflateInitCompact_((strm), (level), (windowBits), ZLIB_VERSION, \
+                              (int)sizeof(z_stream))
 #else
 #  define deflateInit(strm, level) \
           deflateInit_((strm), (level), ZLIB_VERSION, (int)sizeof(z_stream))
@@ -1826,6 +3101,20 @@ ZEXTERN int ZEXPORT inflateBackInit_(z_streamp strm, int windowBits,
 #  define inflateBackInit(strm, windowBits, window) \
           inflateBackInit_((strm), (windowBits), (window), \
                            ZLIB_VERSION, (int)sizeof(z_stream))
+#  define deflatePoolInit2(strm, pool, level, method, windowBits, \
+                            memLevel, strategy) \
+          deflatePoolInit2_((strm), (pool), (level), (method), (windowBits), \
+                            (memLevel), (strategy), ZLIB_VERSION, \
+                            (int)sizeof(z_stream))
+#  define inflatePoolInit2(strm, pool, windowBits) \
+          inflatePoolInit2_((strm), (pool), (windowBits), ZLIB_VERSION, \
+                            (int)sizeof(z_stream))
+#  define deflateInit3(strm, pool, level, strategy, config) \
+          deflateInit3_((strm), (pool), (level), (strategy), (config), \
+                        ZLIB_VERSION, (int)sizeof(z_stream))
+#  define deflateInitCompact(strm, level, windowBits) \
+          deflateInitCompact_((strm), (level), (windowBits), ZLIB_VERSION, \
+                              (int)sizeof(z_stream))
 #endif
 
 #ifndef Z_SOLO
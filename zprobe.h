@@ -0,0 +1,74 @@
+/* zprobe.h -- static tracepoints for the compression library
+ * For conditions of distribution and use, see copyright notice in zlib.h
+ */
+
+/* WARNING: this file should *not* be used by applications. It is
+   part of the implementation of the compression library and is
+   subject to change. Applications should only use zlib.h.
+ */
+
+#ifndef ZPROBE_H
+#define ZPROBE_H
+
+/* Define ZLIB_PROBES when compiling to place static tracepoints at deflate()
+   and inflate() entry and return, at each deflate block, window fill, and
+   hash slide, and at the gzip file reads and compressions. On Linux and other
+   systems with <sys/sdt.h> they are USDT probes in the "zlib" provider, which
+   cost a no-op instruction until a tracer such as bpftrace or perf attaches:
+
+       bpftrace -e 'usdt:./libz.so:zlib:deflate_return { @[arg0] = count(); }'
+
+   On Windows they are TraceLogging events of the "zlib" ETW provider, whose
+   GUID {dc026f78-cef3-540f-3621-75a1c823f1de} is derived from that name, with
+   the values in fields arg0, arg1, and arg2. Without ZLIB_PROBES, the probes
+   are compiled out.
+
+   The probes and their arguments are:
+
+       deflate_entry   avail_in, avail_out, flush
+       deflate_return  return code, bytes consumed, bytes produced
+       inflate_entry   avail_in, avail_out, flush
+       inflate_return  return code, bytes consumed, bytes produced
+       flush_block     input bytes, block type (0 stored, 1 fixed, 2 dynamic),
+                       last
+       fill_window     bytes read into the window, lookahead
+       slide_hash      window size
+       gz_load         bytes requested, bytes read
+       gz_comp         flush, bytes compressed by one deflate() call
+ */
+
+#ifdef ZLIB_PROBES
+#  if defined(_WIN32)
+#    include <windows.h>
+#    include <TraceLoggingProvider.h>
+     TRACELOGGING_DECLARE_PROVIDER(z_etw_provider);
+     extern volatile int ZLIB_INTERNAL z_etw_ready;
+     void ZLIB_INTERNAL z_etw_register(void);
+#    define Z_ETW_ARG(n, a) TraceLoggingUInt64((unsigned __int64)(a), n)
+#    define Z_ETW(args) \
+        do { \
+            if (!z_etw_ready) \
+                z_etw_register(); \
+            TraceLoggingWrite args; \
+        } while (0)
+#    define Probe1(name, a) \
+        Z_ETW((z_etw_provider, #name, Z_ETW_ARG("arg0", a)))
+#    define Probe2(name, a, b) \
+        Z_ETW((z_etw_provider, #name, Z_ETW_ARG("arg0", a), \
+                     Z_ETW_ARG("arg1", b)))
+#    define Probe3(name, a, b, c) \
+        Z_ETW((z_etw_provider, #name, Z_ETW_ARG("arg0", a), \
+                     Z_ETW_ARG("arg1", b), Z_ETW_ARG("arg2", c)))
+#  else
+#    include <sys/sdt.h>
+#    define Probe1(name, a) DTRACE_PROBE1(zlib, name, a)
+#    define Probe2(name, a, b) DTRACE_PROBE2(zlib, name, a, b)
+#    define Probe3(name, a, b, c) DTRACE_PROBE3(zlib, name, a, b, c)
+#  endif
+#else
+#  define Probe1(name, a)
+#  define Probe2(name, a, b)
+#  define Probe3(name, a, b, c)
+#endif
+
+#endif /* ZPROBE_H */
@@ -23,6 +23,29 @@ z_const char * const z_errmsg[10] = {
     (z_const char *)""
 };
 
+#if defined(ZLIB_PROBES) && defined(_WIN32)
+/* The ETW provider for the probes in zprobe.h, registered by the first probe
+   to fire.  It stays registered until the process exits. */
+TRACELOGGING_DEFINE_PROVIDER(z_etw_provider, "zlib",
+    (0xdc026f78, 0xcef3, 0x540f, 0x36, 0x21, 0x75, 0xa1, 0xc8, 0x23, 0xf1, 0xde));
+volatile int ZLIB_INTERNAL z_etw_ready = 0;
+
+local BOOL CALLBACK z_etw_once(PINIT_ONCE once, PVOID param, PVOID *context) {
+    (void)once;
+    (void)param;
+    (void)context;
+    TraceLoggingRegister(z_etw_provider);
+    return TRUE;
+}
+
+void ZLIB_INTERNAL z_etw_register(void) {
+    static INIT_ONCE once = INIT_ONCE_STATIC_INIT;
+
+    InitOnceExecuteOnce(&once, z_etw_once, NULL, NULL);
+    z_etw_ready = 1;
+}
+#endif
+
 
 const char * ZEXPORT zlibVersion(void) {
     if (ZLIB_VERSION == NULL) {
@@ -70,6 +93,9 @@ uLong ZEXPORT zlibCompileFlags(void) {
 #ifdef ZLIB_WINAPI
     flags += 1U << 10;
 #endif
+#ifdef ZLIB_STATS
+    flags += 1U << 11;
+#endif
 #ifdef BUILDFIXED
     flags += 1U << 12;
 #endif
@@ -82,6 +108,9 @@ uLong ZEXPORT zlibCompileFlags(void) {
 #ifdef NO_GZIP
     flags += 1UL << 17;
 #endif
+#ifndef Z_THREADS
+    flags += 1UL << 18;
+#endif
 #ifdef PKZIP_BUG_WORKAROUND
     flags += 1UL << 20;
 #endif
@@ -139,6 +168,75 @@ const char * ZEXPORT zError(int err) {
     return ERR_MSG(err);
 }
 
+/*
+  Detect the processor features once for all of the vector kernels. As for the
+  kernel selections that use it, there is no harm if more than one thread does
+  the detection at the same time, since they all store the same value.
+ */
+#if defined(__x86_64__) && (defined(__clang__) || \
+    (defined(__GNUC__) && (__GNUC__ > 4 || \
+                           (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+
+#include <cpuid.h>
+
+local unsigned cpu_detect(void) {
+    unsigned eax, ebx, ecx, edx, xcr0 = 0, feat = 0;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        return 0;
+    if (ecx & bit_SSSE3)
+        feat |= Z_CPU_SSSE3;
+    if (ecx & bit_PCLMUL)
+        feat |= Z_CPU_PCLMUL;
+    if ((ecx & bit_OSXSAVE) == 0 || __get_cpuid_max(0, Z_NULL) < 7)
+        return feat;
+    __asm__ ("xgetbv" : "=a"(xcr0), "=d"(edx) : "c"(0));
+    __cpuid_count(7, 0, eax, ebx, ecx, edx);
+    if (ebx & (1U << 8))
+        feat |= Z_CPU_BMI2;
+    if ((xcr0 & 6) == 6 && (ebx & (1U << 5)))
+        feat |= Z_CPU_AVX2;
+    if ((xcr0 & 0xe6) == 0xe6 && (ebx & (1U << 16))) {
+        /* the opmask, ymm, and zmm register states are all enabled */
+        feat |= Z_CPU_AVX512;
+        if (ebx & (1U << 30))
+            feat |= Z_CPU_AVX512BW;
+        if (ecx & (1U << 10))
+            feat |= Z_CPU_VPCLMUL;
+    }
+    return feat;
+}
+
+#elif defined(__aarch64__) && defined(__linux__) && !defined(Z_SOLO)
+
+#include <sys/auxv.h>
+#ifndef HWCAP_PMULL
+#  define HWCAP_PMULL (1 << 4)
+#endif
+
+local unsigned cpu_detect(void) {
+    return getauxval(AT_HWCAP) & HWCAP_PMULL ? Z_CPU_PMULL : 0;
+}
+
+#else
+
+local unsigned cpu_detect(void) {
+    return 0;
+}
+
+#endif
+
+local volatile unsigned cpu_features;
+local volatile int cpu_features_done;
+
+unsigned ZLIB_INTERNAL z_cpu_features(void) {
+    if (!cpu_features_done) {
+        cpu_features = cpu_detect();
+        cpu_features_done = 1;
+    }
+    return cpu_features;
+}
+
 #if defined(_WIN32_WCE) && _WIN32_WCE < 0x800
     /* The older Microsoft C Run-Time Library for Windows CE doesn't have
      * errno.  We define it as a global variable to simplify porting.
@@ -176,6 +274,48 @@ void ZLIB_INTERNAL zmemzero(Bytef* dest, uInt len) {
 }
 #endif
 
+/* Take a state of the given kind and key that was allocated by the allocator
+   of strm out of pool, or return Z_NULL if there is none. */
+voidpf ZLIB_INTERNAL z_pool_take(z_poolp pool, z_streamp strm, unsigned kind,
+                                 unsigned key) {
+    unsigned n;
+    voidpf state;
+
+    if (pool == Z_NULL)
+        return Z_NULL;
+    for (n = 0; n < pool->used; n++) {
+        if (pool->item[n].kind == kind && pool->item[n].key == key &&
+            pool->item[n].zalloc == strm->zalloc &&
+            pool->item[n].zfree == strm->zfree &&
+            pool->item[n].opaque == strm->opaque) {
+            state = pool->item[n].state;
+            pool->item[n] = pool->item[--pool->used];
+            return state;
+        }
+    }
+    return Z_NULL;
+}
+
+/* Put the state of strm in pool, unless pool is full. Return true if the
+   state was taken, in which case strm->state is set to Z_NULL. */
+int ZLIB_INTERNAL z_pool_put(z_poolp pool, z_streamp strm, unsigned kind,
+                             unsigned key, void (*release)(z_pooled FAR *)) {
+    z_pooled FAR *item;
+
+    if (pool == Z_NULL || pool->used == pool->size)
+        return 0;
+    item = pool->item + pool->used++;
+    item->state = (voidpf)strm->state;
+    item->kind = kind;
+    item->key = key;
+    item->zalloc = strm->zalloc;
+    item->zfree = strm->zfree;
+    item->opaque = strm->opaque;
+    item->release = release;
+    strm->state = Z_NULL;
+    return 1;
+}
+
 #ifndef Z_SOLO
 
 #ifdef SYS16BIT
@@ -336,4 +476,112 @@ void ZLIB_INTERNAL zcfree(voidpf opaque, voidpf ptr) {
 
 #endif /* MY_ZCALLOC */
 
+z_poolp ZEXPORT zlibPoolCreate(unsigned size) {
+    z_poolp pool;
+
+    if (size == 0 || size > UINT_MAX / sizeof(z_pooled))
+        return Z_NULL;
+    pool = (z_poolp)zcalloc(Z_NULL, 1, sizeof(struct z_pool_s));
+    if (pool == Z_NULL)
+        return Z_NULL;
+    pool->item = (z_pooled FAR *)zcalloc(Z_NULL, size, sizeof(z_pooled));
+    if (pool->item == Z_NULL) {
+        zcfree(Z_NULL, pool);
+        return Z_NULL;
+    }
+    pool->size = size;
+    pool->used = 0;
+    return pool;
+}
+
+void ZEXPORT zlibPoolDestroy(z_poolp pool) {
+    z_pooled FAR *item;
+
+    if (pool == Z_NULL)
+        return;
+    while (pool->used) {
+        item = pool->item + --pool->used;
+        item->release(item);
+    }
+    zcfree(Z_NULL, pool->item);
+    zcfree(Z_NULL, pool);
+}
+
+/* The stream cache used by compress2(), uncompress2(), and gzwrite() is a
+   pool per thread, made on first use and destroyed when the thread exits, so
+   no locking is needed. This uses pthread thread-specific data, for its
+   destructor. Elsewhere zlibStreamCache() reports that there is no cache. */
+#if defined(Z_THREADS) && !defined(_WIN32)
+#  include <pthread.h>
+
+local volatile unsigned cache_size;     /* size of new caches, 0 for none */
+local pthread_key_t cache_key;
+local pthread_once_t cache_once = PTHREAD_ONCE_INIT;
+local int cache_made;
+
+local void cache_free(void *pool) {
+    zlibPoolDestroy((z_poolp)pool);
+}
+
+local void cache_init(void) {
+    cache_made = pthread_key_create(&cache_key, cache_free) == 0;
+}
+
+int ZEXPORT zlibStreamCache(unsigned size) {
+    if (size > UINT_MAX / sizeof(z_pooled))
+        return Z_STREAM_ERROR;
+    pthread_once(&cache_once, cache_init);
+    if (!cache_made)
+        return Z_MEM_ERROR;
+    cache_size = size;
+    return Z_OK;
+}
+
+/* Return the stream cache of the calling thread, or Z_NULL if caching is off
+   or the cache could not be made. */
+z_poolp ZLIB_INTERNAL z_stream_cache(void) {
+    unsigned size = cache_size;
+    z_poolp pool;
+
+    if (size == 0)
+        return Z_NULL;
+    pthread_once(&cache_once, cache_init);
+    pool = (z_poolp)pthread_getspecific(cache_key);
+    if (pool == Z_NULL) {
+        pool = zlibPoolCreate(size);
+        if (pool != Z_NULL && pthread_setspecific(cache_key, pool)) {
+            zlibPoolDestroy(pool);
+            pool = Z_NULL;
+        }
+    }
+    return pool;
+}
+
+#else /* !(Z_THREADS && !_WIN32) */
+
+int ZEXPORT zlibStreamCache(unsigned size) {
+    (void)size;
+    return Z_STREAM_ERROR;
+}
+
+z_poolp ZLIB_INTERNAL z_stream_cache(void) {
+    return Z_NULL;
+}
+
+#endif
+
+/* Return the time in microseconds from a monotonic clock if there is one, else
+   from clock(). This wraps around, so only differences are meaningful. */
+#include <time.h>
+
+ulg ZLIB_INTERNAL z_micros(void) {
+#ifdef CLOCK_MONOTONIC
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_MONOTONIC, &ts) == 0)
+        return (ulg)ts.tv_sec * 1000000UL + (ulg)ts.tv_nsec / 1000;
+#endif
+    return (ulg)((double)clock() * 1e6 / CLOCKS_PER_SEC);
+}
+
 #endif /* !Z_SOLO */
@@ -20,6 +20,7 @@
 #endif
 
 #include "zlib.h"
+#include "zprobe.h"
 
 #if defined(STDC) && !defined(Z_SOLO)
 #  if !(defined(_WIN32_WCE) && defined(_MSC_VER))
@@ -87,6 +88,13 @@ extern z_const char * const z_errmsg[10]; /* indexed by 2-zlib_error */
 
 #define PRESET_DICT 0x20 /* preset dictionary flag in zlib header */
 
+/* Threads are used by the parallel functions if pthreads are available or on
+   Windows. Define NO_THREADS to run those functions on the calling thread. */
+#if !defined(NO_THREADS) && !defined(Z_SOLO) && \
+    (defined(HAVE_PTHREAD) || defined(_WIN32))
+#  define Z_THREADS
+#endif
+
         /* target dependencies */
 
 #if defined(MSDOS) || (defined(WINDOWS) && !defined(WIN32))
@@ -235,6 +243,13 @@ extern z_const char * const z_errmsg[10]; /* indexed by 2-zlib_error */
 #  define Tracecv(c,x)
 #endif
 
+/* Counters for deflateGetStats() and inflateGetStats() */
+#ifdef ZLIB_STATS
+#  define Stat(x) {x;}
+#else
+#  define Stat(x)
+#endif
+
 #ifndef Z_SOLO
    voidpf ZLIB_INTERNAL zcalloc(voidpf opaque, unsigned items,
                                 unsigned size);
@@ -246,6 +261,71 @@ extern z_const char * const z_errmsg[10]; /* indexed by 2-zlib_error */
 #define ZFREE(strm, addr)  (*((strm)->zfree))((strm)->opaque, (voidpf)(addr))
 #define TRY_FREE(s, p) {if (p) ZFREE(s, p);}
 
+/* A stream pool, from zlibPoolCreate(), holds up to size released deflate or
+   inflate states, each with the allocator that allocated it.  kind and key
+   identify what a state can be reused for, and release() frees the state and
+   all of its buffers with that allocator. */
+typedef struct z_pooled_s {
+    voidpf state;               /* internal state with all buffers attached */
+    unsigned kind;              /* Z_POOL_DEFLATE or Z_POOL_INFLATE */
+    unsigned key;               /* buffer sizes, as defined by kind */
+    alloc_func zalloc;          /* allocator that state came from */
+    free_func zfree;
+    voidpf opaque;
+    void (*release)(struct z_pooled_s FAR *);
+} z_pooled;
+
+struct z_pool_s {
+    unsigned size;              /* number of entries in item[] */
+    unsigned used;              /* number of states held */
+    z_pooled FAR *item;
+};
+
+/* A compiled dictionary, from deflateCompileDictionary().  It holds the
+   dictionary as it was put in the window and hashed by a deflate stream with
+   the parameters recorded here, and is not changed after it is made. */
+struct z_dict_s {
+    uInt w_bits;                /* parameters of the stream that made it */
+    uInt hash_bits;
+    uInt hash_shift;
+    ulg hash_mul;
+    uInt size;                  /* number of dictionary bytes in window */
+    uInt insert;                /* bytes at the end not yet hashed */
+    uInt ins_h;                 /* hash value after the last insertion */
+    uLong adler;                /* Adler-32 of the whole dictionary */
+    free_func zfree;            /* to free this with */
+    voidpf opaque;
+    ushf *head;                 /* copy of head[], 1 << hash_bits entries */
+    ushf *prev;                 /* copy of prev[0..size-1] */
+    Bytef *window;              /* copy of window[0..size-1] */
+};
+
+#define Z_POOL_DEFLATE 1
+#define Z_POOL_INFLATE 2
+
+voidpf ZLIB_INTERNAL z_pool_take(z_poolp pool, z_streamp strm, unsigned kind,
+                                 unsigned key);
+int ZLIB_INTERNAL z_pool_put(z_poolp pool, z_streamp strm, unsigned kind,
+                             unsigned key, void (*release)(z_pooled FAR *));
+#ifndef Z_SOLO
+   z_poolp ZLIB_INTERNAL z_stream_cache(void);
+   ulg ZLIB_INTERNAL z_micros(void);
+#endif
+
+/* Processor features found by z_cpu_features(), for the vector kernels to
+   select from at run time. The x86-64 AVX bits are set only if the operating
+   system has also enabled the register state those instructions use. */
+#define Z_CPU_SSSE3     0x01
+#define Z_CPU_PCLMUL    0x02
+#define Z_CPU_AVX2      0x04
+#define Z_CPU_AVX512    0x08    /* AVX512F */
+#define Z_CPU_VPCLMUL   0x10
+#define Z_CPU_PMULL     0x20
+#define Z_CPU_AVX512BW  0x40
+#define Z_CPU_BMI2      0x80
+
+unsigned ZLIB_INTERNAL z_cpu_features(void);
+
 /* Reverse the bytes in a 32-bit value */
 #define ZSWAP32(q) ((((q) >> 24) & 0xff) + (((q) >> 8) & 0xff00) + \
                     (((q) & 0xff00) << 8) + (((q) & 0xff) << 24))